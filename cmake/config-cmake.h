@@ -6,6 +6,9 @@
 /* Define if you have a PCAP compatible library */
 #cmakedefine HAVE_PCAP 1
 
+/* Define to 1 if you have the <linux/if_tun.h> header file. */
+#cmakedefine HAVE_LINUX_IF_TUN_H 1
+
 /* Define if you have a readline compatible library */
 #cmakedefine HAVE_LIBREADLINE 1
 
@@ -39,6 +42,9 @@
 /* Define to 1 if you have the <netinet/in.h> header file. */
 #cmakedefine HAVE_NETINET_IN_H 1
 
+/* Define to 1 if you have the <sys/mman.h> header file. */
+#cmakedefine HAVE_SYS_MMAN_H 1
+
 /* Define to 1 if you have the <byteswap.h> header file. */
 #cmakedefine HAVE_BYTESWAP_H 1
 
@@ -72,6 +78,9 @@
 /* Define to 1 if you have the 'ftello' function. */
 #cmakedefine HAVE_FTELLO 1
 
+/* Define to 1 if you have the 'pread' and 'pwrite' functions. */
+#cmakedefine HAVE_PREAD 1
+
 /* Define to 1 if you have the 'flock' function. */
 #cmakedefine HAVE_FLOCK 1
 
@@ -99,6 +108,9 @@
 /* Define to 1 to enable trace logs - undefine to slightly increase speed */
 #cmakedefine ENABLE_TRACING 1
 
+/* Define to 1 to count executed 68k opcodes (writes frequent.68k on exit) */
+#cmakedefine ENABLE_OPCODE_COUNTS 1
+
 /* Define to 1 to enable rendering threads for higher efficiency */
 #cmakedefine ENABLE_RENDERING_THREAD 1
 
@@ -5,11 +5,15 @@
   or at your option any later version. Read the file gpl.txt for details.
 */
 
+#include "main.h"
 #include "configuration.h"
 #include "m68000.h"
 #include "NextBus.hpp"
 #include "nbic.h"
+#include "mmu_common.h"
 #include "dimension.hpp"
+#include "nbdisk.hpp"
+#include "nbnet.hpp"
 
 static uint8_t bus_error(uint32_t addr, int read, int size, uint32_t val, const char* acc) {
     Log_Printf(LOG_WARN, "[NextBus] Bus error %s at %08X", acc, addr);
@@ -36,6 +40,19 @@ void NextBusSlot::board_lput(uint32_t addr, uint32_t val) {bus_error(addr, BUS_E
 void NextBusSlot::board_wput(uint32_t addr, uint16_t val) {bus_error(addr, BUS_ERROR_WRITE, BUS_ERROR_SIZE_WORD, val, "wput");}
 void NextBusSlot::board_bput(uint32_t addr, uint8_t val)  {bus_error(addr, BUS_ERROR_WRITE, BUS_ERROR_SIZE_BYTE, val, "bput");}
 
+void NextBusSlot::slot_copy_in(uint32_t addr, uint32_t len, uint8_t* buf) {
+    for (; len; len--) *buf++ = slot_bget(addr++);
+}
+void NextBusSlot::slot_copy_out(uint32_t addr, uint32_t len, const uint8_t* buf) {
+    for (; len; len--) slot_bput(addr++, *buf++);
+}
+void NextBusSlot::board_copy_in(uint32_t addr, uint32_t len, uint8_t* buf) {
+    for (; len; len--) *buf++ = board_bget(addr++);
+}
+void NextBusSlot::board_copy_out(uint32_t addr, uint32_t len, const uint8_t* buf) {
+    for (; len; len--) board_bput(addr++, *buf++);
+}
+
 void NextBusSlot::reset(void) {}
 void NextBusSlot::pause(bool pause) {}
 
@@ -163,6 +180,84 @@ extern "C" {
         nextbus[board]->board_bput(addr, val);
     }
     
+    /* Block transfers, return false if addr is not mapped to NeXTbus space.
+     * The region must not cross into the next slot or board. */
+    bool nextbus_copy_in(uaecptr addr, uae_u32 len, uae_u8* buf) {
+        if (len == 0) {
+            return true;
+        }
+        if (get_mem_bank(bank_lget, addr) == nextbus_slot_lget && SLOT(addr) == SLOT(addr+len-1)) {
+            Log_Printf(LOG_NEXTBUS_LEVEL, "[NextBus] Slot %i: copy in %i bytes at %08X",SLOT(addr),len,addr);
+            nextbus[SLOT(addr)]->slot_copy_in(addr, len, buf);
+            return true;
+        }
+        if (get_mem_bank(bank_lget, addr) == nextbus_board_lget && BOARD(addr) == BOARD(addr+len-1)) {
+            Log_Printf(LOG_NEXTBUS_LEVEL, "[NextBus] Board %i: copy in %i bytes at %08X",BOARD(addr),len,addr);
+            nextbus[BOARD(addr)]->board_copy_in(addr, len, buf);
+            return true;
+        }
+        return false;
+    }
+    
+    bool nextbus_copy_out(uaecptr addr, uae_u32 len, const uae_u8* buf) {
+        if (len == 0) {
+            return true;
+        }
+        if (get_mem_bank(bank_lput, addr) == nextbus_slot_lput && SLOT(addr) == SLOT(addr+len-1)) {
+            Log_Printf(LOG_NEXTBUS_LEVEL, "[NextBus] Slot %i: copy out %i bytes at %08X",SLOT(addr),len,addr);
+            nextbus[SLOT(addr)]->slot_copy_out(addr, len, buf);
+            return true;
+        }
+        if (get_mem_bank(bank_lput, addr) == nextbus_board_lput && BOARD(addr) == BOARD(addr+len-1)) {
+            Log_Printf(LOG_NEXTBUS_LEVEL, "[NextBus] Board %i: copy out %i bytes at %08X",BOARD(addr),len,addr);
+            nextbus[BOARD(addr)]->board_copy_out(addr, len, buf);
+            return true;
+        }
+        return false;
+    }
+    
+    /* Main memory access of boards that are bus masters. Only plain memory
+     * can be accessed, returns false for anything else. */
+    bool nextbus_master_read(uaecptr addr, uae_u8* buf, uae_u32 len) {
+        uae_u32 n;
+        uae_u8* src;
+        
+        while (len > 0) {
+            n = 0x10000 - (addr & 0xffff);
+            if (n > len) {
+                n = len;
+            }
+            if (!(src = phys_host_read(addr, n))) {
+                return false;
+            }
+            memcpy(buf, src, n);
+            addr += n;
+            buf  += n;
+            len  -= n;
+        }
+        return true;
+    }
+    
+    bool nextbus_master_write(uaecptr addr, const uae_u8* buf, uae_u32 len) {
+        uae_u32 n;
+        uae_u8* dst;
+        
+        while (len > 0) {
+            n = 0x10000 - (addr & 0xffff);
+            if (n > len) {
+                n = len;
+            }
+            if (!(dst = phys_host_write(addr, n))) {
+                return false;
+            }
+            memcpy(dst, buf, n);
+            addr += n;
+            buf  += n;
+            len  -= n;
+        }
+        return true;
+    }
+    
     static void remove_board(int slot) {
         delete nextbus[slot];
         nextbus[slot] = new NextBusSlot(slot);
@@ -184,6 +279,25 @@ extern "C" {
                 insert_board(new NextDimension(ND_SLOT(i)));
             }
         }
+        
+        if (ConfigureParams.NBDisk.bEnabled && ConfigureParams.System.nMachineType != NEXT_STATION) {
+            if (dynamic_cast<NextBusBoard*>(nextbus[ConfigureParams.NBDisk.nSlot])) {
+                Log_Printf(LOG_WARN, "[NextBus] Slot %i is in use, no disk board inserted", ConfigureParams.NBDisk.nSlot);
+            } else {
+                Log_Printf(LOG_WARN, "[NextBus] Paravirtual disk board at slot %i", ConfigureParams.NBDisk.nSlot);
+                insert_board(new NextBusDisk(ConfigureParams.NBDisk.nSlot, ConfigureParams.NBDisk.szImageName,
+                                             ConfigureParams.NBDisk.bWriteProtected));
+            }
+        }
+        
+        if (ConfigureParams.NBNet.bEnabled && ConfigureParams.System.nMachineType != NEXT_STATION) {
+            if (dynamic_cast<NextBusBoard*>(nextbus[ConfigureParams.NBNet.nSlot])) {
+                Log_Printf(LOG_WARN, "[NextBus] Slot %i is in use, no network board inserted", ConfigureParams.NBNet.nSlot);
+            } else {
+                Log_Printf(LOG_WARN, "[NextBus] Paravirtual network board at slot %i", ConfigureParams.NBNet.nSlot);
+                insert_board(new NextBusNet(ConfigureParams.NBNet.nSlot));
+            }
+        }
     }
     
     void NextBus_Reset(void) {
@@ -106,19 +106,33 @@ static void adb_keydown(uint8_t key) {
 }
 
 /* Mouse */
+#define ADB_MOUSE_EVENTS 8
+#define ADB_MOUSE_MAX    63 /* 7 bit signed movement per report */
+
+typedef struct {
+	int x;
+	int y;
+	bool left;
+	bool right;
+} adb_mouse_report;
+
+/* Movement is accumulated until the next poll. Button changes close the
+ * current report and queue it, so that short clicks are not lost. */
 static struct {
 	uint8_t addr;
 	uint8_t conf;
 	uint8_t id;
 	bool event;
-	bool right;
-	bool left;
-	int x;
-	int y;
+	adb_mouse_report state;
+	adb_mouse_report queue[ADB_MOUSE_EVENTS];
+	int write;
+	int read;
 } adb_mouse;
 
 static void adb_mouse_flush(void) {
 	adb_mouse.event = false;
+	adb_mouse.state.x = adb_mouse.state.y = 0;
+	adb_mouse.read = adb_mouse.write = 0;
 }
 
 static void adb_mouse_reset(void) {
@@ -129,47 +143,79 @@ static void adb_mouse_reset(void) {
 }
 
 static bool adb_mouse_request(void) {
-	return adb_mouse.event;
+	return adb_mouse.event || adb_mouse.write != adb_mouse.read;
+}
+
+static int adb_mouse_clamp(int delta) {
+	if (delta < -ADB_MOUSE_MAX-1) {
+		return -ADB_MOUSE_MAX-1;
+	}
+	if (delta > ADB_MOUSE_MAX) {
+		return ADB_MOUSE_MAX;
+	}
+	return delta;
+}
+
+/* Take the report of the accumulated state, leaving movement that did not fit */
+static adb_mouse_report adb_mouse_take(void) {
+	adb_mouse_report report = adb_mouse.state;
+	
+	report.x = adb_mouse_clamp(report.x);
+	report.y = adb_mouse_clamp(report.y);
+	adb_mouse.state.x -= report.x;
+	adb_mouse.state.y -= report.y;
+	adb_mouse.event = adb_mouse.state.x || adb_mouse.state.y;
+	return report;
 }
 
 static bool adb_mouse_get(uint8_t* event) {
-	if (adb_mouse.event) {
-		if (adb_mouse.y < 0) {
-			event[0] = (0x40 + adb_mouse.y) | 0x40;
-		} else {
-			event[0] = adb_mouse.y;
-		}
-		if (adb_mouse.x < 0) {
-			event[1] = (0x40 + adb_mouse.x) | 0x40;
-		} else {
-			event[1] = adb_mouse.x;
-		}
-		if (adb_mouse.left == 0) {
-			event[0] |= 0x80;
-		}
-		if (adb_mouse.right == 0) {
-			event[1] |= 0x80;
-		}
-		
-		adb_mouse.x = adb_mouse.y = 0;
-		adb_mouse.event = false;
-		
-		return true;
+	adb_mouse_report report;
+	
+	if (adb_mouse.write != adb_mouse.read) {
+		report = adb_mouse.queue[adb_mouse.read];
+		adb_mouse.read = (adb_mouse.read + 1) % ADB_MOUSE_EVENTS;
+	} else if (adb_mouse.event) {
+		report = adb_mouse_take();
+	} else {
+		return false;
 	}
-	return false;
+	
+	event[0] = report.y & 0x7f;
+	event[1] = report.x & 0x7f;
+	if (report.left == 0) {
+		event[0] |= 0x80;
+	}
+	if (report.right == 0) {
+		event[1] |= 0x80;
+	}
+	return true;
 }
 
 static void adb_mouse_move(int x, int y) {
-	adb_mouse.x = x;
-	adb_mouse.y = y;
+	adb_mouse.state.x += x;
+	adb_mouse.state.y += y;
 	adb_mouse.event = true;
 }
 
 static void adb_mouse_button(bool left, bool down) {
+	int next;
+	
+	if ((left ? adb_mouse.state.left : adb_mouse.state.right) == down) {
+		return;
+	}
+	if (adb_mouse.event) {
+		next = (adb_mouse.write + 1) % ADB_MOUSE_EVENTS;
+		if (next == adb_mouse.read) {
+			Log_Printf(LOG_WARN, "[ADB] Mouse events queue overflow");
+		} else {
+			adb_mouse.queue[adb_mouse.write] = adb_mouse_take();
+			adb_mouse.write = next;
+		}
+	}
 	if (left) {
-		adb_mouse.left  = down;
+		adb_mouse.state.left  = down;
 	} else {
-		adb_mouse.right = down;
+		adb_mouse.state.right = down;
 	}
 	adb_mouse.event = true;
 }
@@ -34,25 +34,47 @@ static bool bRecordingBuffer    = false; /* Is recording buffer? */
 /*-----------------------------------------------------------------------*/
 /**
  * Sound output functions.
+ *
+ * Samples are passed to the audio callback through a lock-free ring buffer
+ * of stereo frames. The callback reads the buffer at a slightly varying rate
+ * to keep its fill level near OUT_BUFFER_TARGET. This absorbs the drift
+ * between emulated and host time without underruns or growing latency.
  */
+#define OUT_BUFFER_SIZE   (1<<14) /* frames */
+#define OUT_BUFFER_MASK   (OUT_BUFFER_SIZE-1)
+#define OUT_BUFFER_TARGET (SOUND_BUFFER_SAMPLES*3/2)
+#define OUT_MAX_DRIFT     655     /* maximum rate adjustment (1%) in 16.16 */
+
+static int16_t    outBuffer[OUT_BUFFER_SIZE][2];
+static atomic_int outBufferWr;    /* frames written, owned by the emulator */
+static atomic_int outBufferRd;    /* frames read, owned by the callback */
+static uint32_t   outPhase  = 0;  /* position between two frames in 16.16 */
+static int32_t    outFill   = 0;  /* smoothed fill level in 24.8 */
+
 void Audio_Output_Queue_Put(uint8_t* data, int len) {
+	int      i, frames;
+	uint32_t wr;
+	
 	if (len > 0) {
 		Grab_Sound(data, len);
 		if (bSoundOutputWorking) {
-			int chunkSize = SOUND_BUFFER_SAMPLES;
-			do {
-				if (len < chunkSize) chunkSize = len;
-				SDL_QueueAudio(Audio_Output_Device, data, chunkSize);
-				data += chunkSize;
-				len  -= chunkSize;
-			} while (len > 0);
+			wr     = host_atomic_get(&outBufferWr);
+			frames = OUT_BUFFER_SIZE - 1 - (int)(wr - (uint32_t)host_atomic_get(&outBufferRd));
+			if (frames > len / 4) {
+				frames = len / 4;
+			}
+			for (i = 0; i < frames; i++, data += 4) {
+				outBuffer[(wr + i) & OUT_BUFFER_MASK][0] = (int16_t)((data[0]<<8)|data[1]);
+				outBuffer[(wr + i) & OUT_BUFFER_MASK][1] = (int16_t)((data[2]<<8)|data[3]);
+			}
+			host_atomic_set(&outBufferWr, wr + frames);
 		}
 	}
 }
 
 int Audio_Output_Queue_Size(void) {
 	if (bSoundOutputWorking) {
-		return SDL_GetQueuedAudioSize(Audio_Output_Device) / 4;
+		return (int)((uint32_t)host_atomic_get(&outBufferWr) - (uint32_t)host_atomic_get(&outBufferRd));
 	} else {
 		return 0;
 	}
@@ -60,78 +82,133 @@ int Audio_Output_Queue_Size(void) {
 
 void Audio_Output_Queue_Clear(void) {
 	if (bSoundOutputWorking) {
-		SDL_ClearQueuedAudio(Audio_Output_Device);
+		SDL_LockAudioDevice(Audio_Output_Device);
+		host_atomic_set(&outBufferRd, host_atomic_get(&outBufferWr));
+		outPhase = 0;
+		SDL_UnlockAudioDevice(Audio_Output_Device);
+	}
+}
+
+/* Return how many microseconds the emulation is ahead of the audio device.
+ * Returns false if no samples are being played, the caller then has to use
+ * another clock. */
+bool Audio_Output_Clock_Offset(int64_t* offset) {
+	if (!bSoundOutputWorking || !bPlayingBuffer || !snd_output_active()) {
+		return false;
+	}
+	*offset = (int64_t)(Audio_Output_Queue_Size() - OUT_BUFFER_TARGET) * 1000000 / SOUND_OUT_FREQUENCY;
+	return true;
+}
+
+static void Audio_Output_CallBack(void *userdata, uint8_t *stream, int len) {
+	int16_t* out = (int16_t*)stream;
+	uint32_t rd;
+	int      avail, frames, c;
+	int32_t  step;
+	const int16_t *a, *b;
+
+	rd    = host_atomic_get(&outBufferRd);
+	avail = (int)((uint32_t)host_atomic_get(&outBufferWr) - rd);
+
+	/* Read faster if the buffer fills up, slower if it runs empty */
+	outFill += ((avail << 8) - outFill) / 16;
+	step = ((outFill >> 8) - OUT_BUFFER_TARGET) * OUT_MAX_DRIFT / OUT_BUFFER_TARGET;
+	if (step >  OUT_MAX_DRIFT) step =  OUT_MAX_DRIFT;
+	if (step < -OUT_MAX_DRIFT) step = -OUT_MAX_DRIFT;
+	step += 0x10000;
+
+	for (frames = len / 4; frames > 0; frames--, out += 2) {
+		if (avail < 2) {
+			/* Underrun, play silence */
+			out[0] = out[1] = 0;
+			continue;
+		}
+		a = outBuffer[rd & OUT_BUFFER_MASK];
+		b = outBuffer[(rd + 1) & OUT_BUFFER_MASK];
+		for (c = 0; c < 2; c++) {
+			out[c] = a[c] + (((b[c] - a[c]) * (int32_t)(outPhase >> 1)) >> 15);
+		}
+		outPhase += step;
+		rd       += outPhase >> 16;
+		avail    -= outPhase >> 16;
+		outPhase &= 0xFFFF;
 	}
+	host_atomic_set(&outBufferRd, rd);
 }
 
 /*-----------------------------------------------------------------------*/
 /**
  * Sound input functions.
  *
- * Initialize recording buffer with silence to compensate for time gap
- * between Audio_Input_Enable and first availability of recorded data.
+ * Recorded samples are passed from the audio callback to the emulator
+ * through a lock-free ring buffer. Initialize it with silence to compensate
+ * for time gap between Audio_Input_Enable and first availability of
+ * recorded data.
  */
-#define AUDIO_RECBUF_INIT 32 /* 16000 byte = 1 second */
+#define AUDIO_RECBUF_INIT 16 /* 8000 samples = 1 second */
 
-#define REC_BUFFER_SIZE (1<<16)
+#define REC_BUFFER_SIZE (1<<15) /* samples */
 #define REC_BUFFER_MASK (REC_BUFFER_SIZE-1)
-static uint8_t  recBuffer[REC_BUFFER_SIZE];
-static uint32_t recBufferWr = 0;
-static uint32_t recBufferRd = 0;
-static lock_t   recBufferLock;
+static int16_t    recBuffer[REC_BUFFER_SIZE];
+static atomic_int recBufferWr; /* samples written, owned by the callback */
+static atomic_int recBufferRd; /* samples read, owned by the emulator */
 
 static void Audio_Input_InitBuf(void) {
-	Log_Printf(LOG_WARN, "[Audio] Initializing input buffer with %d ms of silence.", AUDIO_RECBUF_INIT>>4);
-	recBufferRd = 0;
-	for (recBufferWr = 0; recBufferWr < AUDIO_RECBUF_INIT; recBufferWr++) {
-		recBuffer[recBufferWr] = 0;
-	}
+	Log_Printf(LOG_WARN, "[Audio] Initializing input buffer with %d ms of silence.", AUDIO_RECBUF_INIT>>3);
+	memset(recBuffer, 0, AUDIO_RECBUF_INIT * sizeof(int16_t));
+	host_atomic_set(&recBufferRd, 0);
+	host_atomic_set(&recBufferWr, AUDIO_RECBUF_INIT);
 }
 
 int Audio_Input_Buffer_Size(void) {
 	if (bSoundInputWorking) {
-		if (recBufferRd <= recBufferWr) {
-			return recBufferWr - recBufferRd;
-		} else {
-			return REC_BUFFER_SIZE - (recBufferRd - recBufferWr);
-		}
+		return (int)((uint32_t)host_atomic_get(&recBufferWr) - (uint32_t)host_atomic_get(&recBufferRd));
 	}
 	return 0;
 }
 
-int Audio_Input_Buffer_Get(int16_t* sample) {
+/* Copy up to count samples without removing them from the buffer.
+ * Returns the number of samples copied. */
+int Audio_Input_Buffer_Get(int16_t* samples, int count) {
+	uint32_t rd;
+	int i, avail;
+
 	if (bSoundInputWorking) {
-		if ((recBufferRd&REC_BUFFER_MASK)==(recBufferWr&REC_BUFFER_MASK)) {
-			return -1;
-		} else {
-			*sample = ((recBuffer[recBufferRd&REC_BUFFER_MASK]<<8)|recBuffer[(recBufferRd&REC_BUFFER_MASK)+1]);
-			recBufferRd += 2;
-			recBufferRd &= REC_BUFFER_MASK;
+		rd    = host_atomic_get(&recBufferRd);
+		avail = (int)((uint32_t)host_atomic_get(&recBufferWr) - rd);
+		if (count > avail) {
+			count = avail;
+		}
+		for (i = 0; i < count; i++) {
+			samples[i] = recBuffer[(rd + i) & REC_BUFFER_MASK];
 		}
 	} else {
-		*sample = 0; /* silence */
+		/* silence */
+		memset(samples, 0, count * sizeof(int16_t));
 	}
-	return 0;
+	return count;
 }
 
-static void Audio_Input_CallBack(void *userdata, uint8_t *stream, int len) {
-	Log_Printf(LOG_WARN, "Audio_Input_CallBack %d", len);
-	if(len == 0) return;
-	Audio_Input_Lock();
-	while(len--) {
-		recBuffer[recBufferWr++&REC_BUFFER_MASK] = *stream++;
+/* Remove samples that have been processed from the buffer */
+void Audio_Input_Buffer_Advance(int count) {
+	if (bSoundInputWorking) {
+		host_atomic_add(&recBufferRd, count);
 	}
-	recBufferWr &= REC_BUFFER_MASK;
-	recBufferWr &= ~1; /* Just to be sure */
-	Audio_Input_Unlock();
 }
 
-void Audio_Input_Lock(void) {
-	host_lock(&recBufferLock);
-}
+static void Audio_Input_CallBack(void *userdata, uint8_t *stream, int len) {
+	uint32_t wr = host_atomic_get(&recBufferWr);
+	int i, count;
 
-void Audio_Input_Unlock(void) {
-	host_unlock(&recBufferLock);
+	/* Samples that do not fit are dropped */
+	count = REC_BUFFER_SIZE - (int)(wr - (uint32_t)host_atomic_get(&recBufferRd));
+	if (count > len / 2) {
+		count = len / 2;
+	}
+	for (i = 0; i < count; i++, stream += 2) {
+		recBuffer[(wr + i) & REC_BUFFER_MASK] = (int16_t)((stream[0]<<8)|stream[1]);
+	}
+	host_atomic_set(&recBufferWr, wr + count);
 }
 
 static bool check_audio(int requested, int granted, const char* attribute) {
@@ -162,9 +239,9 @@ void Audio_Output_Init(void)
 
 	/* Set up SDL audio: */
 	request.freq     = SOUND_OUT_FREQUENCY; /* 44,1 kHz */
-	request.format   = AUDIO_S16MSB;        /* 16-Bit signed, big endian */
+	request.format   = AUDIO_S16SYS;        /* 16-Bit signed, host byte order */
 	request.channels = 2;                   /* stereo */
-	request.callback = NULL;
+	request.callback = Audio_Output_CallBack;
 	request.userdata = NULL;
 	request.samples  = SOUND_BUFFER_SAMPLES; /* buffer size in samples */
 
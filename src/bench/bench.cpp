@@ -0,0 +1,425 @@
+//
+//  bench.cpp
+//  Previous
+//
+//  Headless micro benchmarks of emulator components that can be linked
+//  without the rest of the emulator. Results are written as JSON, so that
+//  runs of different releases can be compared.
+//
+//  With -fp the host floating point paths, the i860 host FPU mode and the
+//  native 68k FPU, are also checked against softfloat on random operands.
+//
+
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <cstring>
+#include <algorithm>
+#include <thread>
+#include <cmath>
+
+#include "main.h"
+#include "rs.h"
+#include "DiskImage.h"
+#include "UFS.h"
+
+extern "C" {
+#include "softfloat.h"
+}
+
+using namespace std;
+
+struct Result {
+    string   name;
+    uint64_t iterations;
+    double   seconds;
+    string   unit;
+    double   units;  // processed units per iteration
+};
+
+struct Check {
+    string   name;
+    uint64_t ops;
+    uint64_t mismatches;
+    uint64_t a, b;   // operands of the first mismatch
+};
+
+static vector<Result> results;
+static vector<Check>  checks;
+static double         minSeconds = 1.0;
+
+static uint32_t rnd(uint32_t& state) {
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+}
+
+// Runs func in growing batches until minSeconds have passed
+template<typename F>
+static void run(const string& name, const string& unit, double units, F func) {
+    typedef chrono::steady_clock clock;
+    uint64_t iterations = 0;
+    uint64_t batch      = 1;
+    double   seconds    = 0;
+
+    clock::time_point start = clock::now();
+    while(seconds < minSeconds) {
+        for(uint64_t i = 0; i < batch; i++)
+            func();
+        iterations += batch;
+        if(batch < (1 << 20)) batch *= 2;
+        seconds = chrono::duration<double>(clock::now() - start).count();
+    }
+
+    Result r = {name, iterations, seconds, unit, units};
+    results.push_back(r);
+    cerr << name << ": " << (iterations * units / seconds) << " " << unit << "/s" << endl;
+}
+
+// ----- MO disk error correction
+
+static const size_t RS_SECTOR      = 1296; // 36 * 36 bytes with check bytes
+static const size_t RS_SECTOR_DATA = 1024;
+
+static void bench_rs(void) {
+    uint8_t  data[RS_SECTOR_DATA];
+    uint8_t  sector[RS_SECTOR];
+    uint8_t  encoded[RS_SECTOR];
+    uint32_t seed = 1;
+
+    for(size_t i = 0; i < sizeof(data); i++)
+        data[i] = rnd(seed);
+
+    run("rs_encode", "bytes", RS_SECTOR_DATA, [&] {
+        memcpy(sector, data, sizeof(data));
+        rs_encode(sector);
+    });
+    memcpy(encoded, sector, sizeof(encoded));
+
+    run("rs_decode_clean", "bytes", RS_SECTOR_DATA, [&] {
+        memcpy(sector, encoded, sizeof(encoded));
+        rs_decode(sector);
+    });
+    run("rs_decode_errors", "bytes", RS_SECTOR_DATA, [&] {
+        memcpy(sector, encoded, sizeof(encoded));
+        // one wrong byte in each of a few rows
+        for(int row = 0; row < 36; row += 5)
+            sector[row * 36 + (rnd(seed) % 36)] ^= 0x5a;
+        rs_decode(sector);
+    });
+}
+
+// ----- FPU arithmetic
+
+static void bench_softfloat(void) {
+    const int     N = 256;
+    floatx80      a[N], b[N], r;
+    float_status  status;
+    uint32_t      seed = 2;
+
+    memset(&status, 0, sizeof(status));
+    set_float_rounding_mode(float_round_nearest_even, &status);
+    set_floatx80_rounding_precision(80, &status);
+    for(int i = 0; i < N; i++) {
+        a[i] = int32_to_floatx80((int32_t)(rnd(seed) >> 1) + 1);
+        b[i] = int32_to_floatx80((int32_t)(rnd(seed) >> 8) + 1);
+    }
+
+    run("floatx80_add", "ops", N, [&] {
+        for(int i = 0; i < N; i++) r = floatx80_add(a[i], b[i], &status);
+    });
+    run("floatx80_mul", "ops", N, [&] {
+        for(int i = 0; i < N; i++) r = floatx80_mul(a[i], b[i], &status);
+    });
+    run("floatx80_div", "ops", N, [&] {
+        for(int i = 0; i < N; i++) r = floatx80_div(a[i], b[i], &status);
+    });
+    run("floatx80_sqrt", "ops", N, [&] {
+        for(int i = 0; i < N; i++) r = floatx80_sqrt(a[i], &status);
+    });
+    run("floatx80_sin", "ops", N, [&] {
+        for(int i = 0; i < N; i++) r = floatx80_sin(b[i], &status);
+    });
+    (void)r;
+}
+
+// ----- Host floating point against softfloat
+
+// The i860 host mode computes with host float and double in round to
+// nearest. The native 68k FPU computes with host double, which matches
+// floatx80 operations with double rounding precision in the double range.
+// Results are compared bit for bit, except that any NaN matches any NaN.
+
+static float  f32(uint32_t x) { float  f; memcpy(&f, &x, sizeof(f)); return f; }
+static double f64(uint64_t x) { double d; memcpy(&d, &x, sizeof(d)); return d; }
+static uint32_t b32(float f)  { uint32_t x; memcpy(&x, &f, sizeof(x)); return x; }
+static uint64_t b64(double d) { uint64_t x; memcpy(&x, &d, sizeof(x)); return x; }
+
+struct FpOp {
+    const char* name;
+    bool        dbl;  // operands and result are float64, else float32
+    uint64_t  (*soft)(uint64_t a, uint64_t b, float_status* s);
+    uint64_t  (*host)(uint64_t a, uint64_t b);
+};
+
+static floatx80 x80(uint64_t a, float_status* s) { return float64_to_floatx80(a, s); }
+
+static const FpOp fpOps[] = {
+    { "i860_fadd_ss", false,
+      [](uint64_t a, uint64_t b, float_status* s) -> uint64_t { return float32_add(a, b, s); },
+      [](uint64_t a, uint64_t b) -> uint64_t { return b32(f32(a) + f32(b)); } },
+    { "i860_fsub_ss", false,
+      [](uint64_t a, uint64_t b, float_status* s) -> uint64_t { return float32_sub(a, b, s); },
+      [](uint64_t a, uint64_t b) -> uint64_t { return b32(f32(a) - f32(b)); } },
+    { "i860_fmul_ss", false,
+      [](uint64_t a, uint64_t b, float_status* s) -> uint64_t { return float32_mul(a, b, s); },
+      [](uint64_t a, uint64_t b) -> uint64_t { return b32(f32(a) * f32(b)); } },
+    { "i860_frcp_ss", false,
+      [](uint64_t a, uint64_t b, float_status* s) -> uint64_t { return float32_div(a, b, s); },
+      [](uint64_t a, uint64_t b) -> uint64_t { return b32(f32(a) / f32(b)); } },
+    { "i860_fsqrt_ss", false,
+      [](uint64_t a, uint64_t b, float_status* s) -> uint64_t { return float32_sqrt(a, s); },
+      [](uint64_t a, uint64_t b) -> uint64_t { return b32(sqrtf(f32(a))); } },
+    { "i860_fadd_dd", true,
+      [](uint64_t a, uint64_t b, float_status* s) -> uint64_t { return float64_add(a, b, s); },
+      [](uint64_t a, uint64_t b) -> uint64_t { return b64(f64(a) + f64(b)); } },
+    { "i860_fmul_dd", true,
+      [](uint64_t a, uint64_t b, float_status* s) -> uint64_t { return float64_mul(a, b, s); },
+      [](uint64_t a, uint64_t b) -> uint64_t { return b64(f64(a) * f64(b)); } },
+    { "i860_frcp_dd", true,
+      [](uint64_t a, uint64_t b, float_status* s) -> uint64_t { return float64_div(a, b, s); },
+      [](uint64_t a, uint64_t b) -> uint64_t { return b64(f64(a) / f64(b)); } },
+    { "i860_fsqrt_dd", true,
+      [](uint64_t a, uint64_t b, float_status* s) -> uint64_t { return float64_sqrt(a, s); },
+      [](uint64_t a, uint64_t b) -> uint64_t { return b64(sqrt(f64(a))); } },
+    { "fpu_fadd_d", true,
+      [](uint64_t a, uint64_t b, float_status* s) -> uint64_t { return floatx80_to_float64(floatx80_add(x80(a, s), x80(b, s), s), s); },
+      [](uint64_t a, uint64_t b) -> uint64_t { return b64(f64(a) + f64(b)); } },
+    { "fpu_fmul_d", true,
+      [](uint64_t a, uint64_t b, float_status* s) -> uint64_t { return floatx80_to_float64(floatx80_mul(x80(a, s), x80(b, s), s), s); },
+      [](uint64_t a, uint64_t b) -> uint64_t { return b64(f64(a) * f64(b)); } },
+    { "fpu_fdiv_d", true,
+      [](uint64_t a, uint64_t b, float_status* s) -> uint64_t { return floatx80_to_float64(floatx80_div(x80(a, s), x80(b, s), s), s); },
+      [](uint64_t a, uint64_t b) -> uint64_t { return b64(f64(a) / f64(b)); } },
+    { "fpu_fsqrt_d", true,
+      [](uint64_t a, uint64_t b, float_status* s) -> uint64_t { return floatx80_to_float64(floatx80_sqrt(x80(a, s), s), s); },
+      [](uint64_t a, uint64_t b) -> uint64_t { return b64(sqrt(f64(a))); } },
+};
+
+static void fp_status(float_status* s, bool fpu) {
+    memset(s, 0, sizeof(*s));
+    set_float_rounding_mode(float_round_nearest_even, s);
+    set_float_detect_tininess(float_tininess_before_rounding, s);
+    set_floatx80_rounding_precision(fpu ? 64 : 80, s);
+}
+
+// Random operand: mostly numbers of moderate magnitude, some with any
+// bit pattern to reach denormals, infinities and NaNs.
+static uint64_t fp_operand(uint32_t& seed, bool dbl) {
+    uint64_t r = (uint64_t)rnd(seed) << 32 | rnd(seed);
+    if((r & 7) == 0) return dbl ? r : (uint32_t)r;
+    if(dbl) return b64(f64((r & 0x800FFFFFFFFFFFFFULL) | 0x3C00000000000000ULL) * (double)(1 << (r >> 52 & 15)));
+    return b32(f32(((uint32_t)r & 0x807FFFFF) | 0x3C000000) * (float)(1 << (r >> 23 & 15)));
+}
+
+static bool fp_same(uint64_t x, uint64_t y, bool dbl) {
+    if(x == y) return true;
+    return dbl ? (std::isnan(f64(x)) && std::isnan(f64(y))) : (std::isnan(f32(x)) && std::isnan(f32(y)));
+}
+
+static void fp_verify(uint64_t ops) {
+    unsigned threads = max(1u, thread::hardware_concurrency());
+
+    for(const FpOp& op : fpOps) {
+        vector<Check>  part(threads);
+        vector<thread> pool;
+        bool           fpu = op.name[0] == 'f';
+
+        for(unsigned t = 0; t < threads; t++) {
+            pool.push_back(thread([&, t] {
+                Check&       c    = part[t];
+                uint32_t     seed = 0x9E3779B9u * (t + 1);
+                float_status s;
+                fp_status(&s, fpu);
+                c.ops = ops / threads + (t < ops % threads);
+                c.mismatches = 0;
+                for(uint64_t i = 0; i < c.ops; i++) {
+                    uint64_t a = fp_operand(seed, op.dbl);
+                    uint64_t b = fp_operand(seed, op.dbl);
+                    if(!fp_same(op.soft(a, b, &s), op.host(a, b), op.dbl) && !c.mismatches++) {
+                        c.a = a;
+                        c.b = b;
+                    }
+                }
+            }));
+        }
+        Check c = {op.name, 0, 0, 0, 0};
+        for(unsigned t = 0; t < threads; t++) {
+            pool[t].join();
+            if(part[t].mismatches && !c.mismatches) {
+                c.a = part[t].a;
+                c.b = part[t].b;
+            }
+            c.ops += part[t].ops;
+            c.mismatches += part[t].mismatches;
+        }
+        checks.push_back(c);
+        cerr << op.name << ": " << c.mismatches << " of " << c.ops << " differ";
+        if(c.mismatches)
+            cerr << hex << " (first 0x" << c.a << ", 0x" << c.b << ")" << dec;
+        cerr << endl;
+
+        // Throughput of both implementations on the same operands
+        const int    N = 256;
+        uint64_t     a[N], b[N], r = 0;
+        uint32_t     seed = 3;
+        float_status s;
+        fp_status(&s, fpu);
+        for(int i = 0; i < N; i++) {
+            a[i] = fp_operand(seed, op.dbl);
+            b[i] = fp_operand(seed, op.dbl);
+        }
+        run(string(op.name) + "_soft", "ops", N, [&] {
+            for(int i = 0; i < N; i++) r += op.soft(a[i], b[i], &s);
+        });
+        run(string(op.name) + "_host", "ops", N, [&] {
+            for(int i = 0; i < N; i++) r += op.host(a[i], b[i]);
+        });
+        (void)r;
+    }
+}
+
+// ----- UFS reading, as done by the NFS server for disk images
+
+static void walk(UFS& ufs, uint32_t ino, vector<uint32_t>& dirs, vector<icommon>& files) {
+    vector<direct> entries = ufs.list(ino);
+    dirs.push_back(ino);
+    for(size_t i = 0; i < entries.size(); i++) {
+        string   name(entries[i].d_name);
+        uint32_t child = fsv(entries[i].d_inonum);
+        icommon  inode;
+        if(name == "." || name == ".." || ufs.readInode(inode, child)) continue;
+        switch(fsv(inode.ic_mode) & IFMT) {
+            case IFDIR: walk(ufs, child, dirs, files); break;
+            case IFREG: files.push_back(inode); break;
+        }
+    }
+}
+
+static bool bench_ufs(const string& path) {
+    DiskImage im(path);
+    if(!(im.valid())) {
+        cerr << "Can't open disk image " << path << ": " << im.error << endl;
+        return false;
+    }
+    for(size_t p = 0; p < im.parts.size(); p++) {
+        if(!(im.parts[p].isUFS())) continue;
+
+        UFS              ufs(im.parts[p]);
+        vector<uint32_t> dirs;
+        vector<icommon>  files;
+        vector<uint8_t>  buffer(8192);
+        size_t           d = 0, f = 0;
+
+        walk(ufs, ROOTINO, dirs, files);
+        if(files.empty()) break;
+
+        run("ufs_readdir", "dirs", 1, [&] {
+            ufs.list(dirs[d++ % dirs.size()]);
+        });
+        run("ufs_read", "bytes", buffer.size(), [&] {
+            const icommon& inode = files[f++ % files.size()];
+            uint32_t len = min<uint32_t>(ufs.fileSize(inode), buffer.size());
+            ufs.readFile(inode, 0, len, buffer.data());
+        });
+        return true;
+    }
+    cerr << "No UFS partition with files in " << path << endl;
+    return false;
+}
+
+// ----- JSON output
+
+static void write_json(ostream& os) {
+    os << "{" << endl;
+    os << "  \"version\": \"" << PROG_NAME << "\"," << endl;
+    os << "  \"benchmarks\": [" << endl;
+    for(size_t i = 0; i < results.size(); i++) {
+        const Result& r = results[i];
+        os << "    {\"name\": \"" << r.name << "\", \"iterations\": " << r.iterations
+           << ", \"seconds\": " << r.seconds << ", \"unit\": \"" << r.unit
+           << "\", \"per_second\": " << (r.iterations * r.units / r.seconds) << "}"
+           << (i + 1 < results.size() ? "," : "") << endl;
+    }
+    os << "  ]";
+    if(!checks.empty()) {
+        os << "," << endl << "  \"fp_checks\": [" << endl;
+        for(size_t i = 0; i < checks.size(); i++) {
+            const Check& c = checks[i];
+            os << "    {\"name\": \"" << c.name << "\", \"ops\": " << c.ops
+               << ", \"mismatches\": " << c.mismatches << "}"
+               << (i + 1 < checks.size() ? "," : "") << endl;
+        }
+        os << "  ]";
+    }
+    os << endl << "}" << endl;
+}
+
+static void print_help(void) {
+    cout << "usage : previous-bench [options]" << endl;
+    cout << "Options:" << endl;
+    cout << "  -h          Print this help." << endl;
+    cout << "  -t <sec>    Minimum run time of each benchmark (default 1)." << endl;
+    cout << "  -im <file>  Also read directories and files of a NeXT disk image." << endl;
+    cout << "  -fp <n>     Also check n random operations of each host FPU path" << endl;
+    cout << "              against softfloat, exit status 2 if any differ." << endl;
+    cout << "  -out <file> Write JSON results to file instead of stdout." << endl;
+}
+
+int main(int argc, const char * argv[]) {
+    const char* image = NULL;
+    const char* out   = NULL;
+    uint64_t    fpOps = 0;
+
+    for(int i = 1; i < argc; i++) {
+        string arg(argv[i]);
+        if(arg == "-t" && i + 1 < argc) {
+            minSeconds = atof(argv[++i]);
+        } else if(arg == "-im" && i + 1 < argc) {
+            image = argv[++i];
+        } else if(arg == "-fp" && i + 1 < argc) {
+            fpOps = strtoull(argv[++i], NULL, 0);
+        } else if(arg == "-out" && i + 1 < argc) {
+            out = argv[++i];
+        } else {
+            print_help();
+            return arg == "-h" ? 0 : 1;
+        }
+    }
+
+    bench_rs();
+    bench_softfloat();
+    if(image && !(bench_ufs(image)))
+        return 1;
+    if(fpOps)
+        fp_verify(fpOps);
+
+    if(out) {
+        ofstream os(out);
+        if(!(os)) {
+            cerr << "Can't write " << out << endl;
+            return 1;
+        }
+        write_json(os);
+    } else {
+        write_json(cout);
+    }
+    for(size_t i = 0; i < checks.size(); i++) {
+        if(checks[i].mismatches)
+            return 2;
+    }
+    return 0;
+}
@@ -0,0 +1,432 @@
+/*
+  Previous - bootbench.c
+
+  This file is distributed under the GNU General Public License, version 2
+  or at your option any later version. Read the file gpl.txt for details.
+
+  Boot macro benchmark. A script is run from the event loop while the
+  machine cold-boots: it feeds keyboard and mouse input to the guest, waits
+  for known screen contents and reports wall and emulated time per phase.
+
+  Script commands, one per line ('#' starts a comment):
+    phase <name>        start a new timed phase, ends the previous one
+    wait <hash> [sec]   wait until the framebuffer hash matches (default 600s)
+    sleep <ms>          wait for some real time
+    key <name>          press and release a key, SDL key names ("Return")
+    type <text>         type the rest of the line
+    mouse <dx> <dy>     move the mouse
+    click [right]       press and release a mouse button
+    hash                print the current framebuffer hash
+    commit              write the overlays of write protected disks to
+                        their images, fails the script if one fails
+    end                 report and quit
+
+  The report also lists the time taken by each startup step until the
+  first event is handled by the running machine.
+
+  A typical script waits for the ROM monitor, kernel console, Window Server
+  and login window screens in four phases. Hashes are found by running a
+  script with "sleep" and "hash" lines first; a timed out wait also prints
+  the last hash it has seen.
+*/
+const char Bootbench_fileid[] = "Previous bootbench.c";
+
+#include "main.h"
+#include "configuration.h"
+#include "keymap.h"
+#include "log.h"
+#include "m68000.h"
+#include "host.h"
+#include "str.h"
+#include "scsi.h"
+#include "bootbench.h"
+
+#include <SDL.h>
+#include <inttypes.h>
+
+
+#define BB_MAX_STEPS   256
+#define BB_MAX_PHASES  16
+#define BB_MAX_STARTUP 16
+#define BB_HASH_US     100000 /* hash the screen at most 10 times a second */
+
+typedef enum {
+	BB_PHASE,
+	BB_WAIT,
+	BB_SLEEP,
+	BB_KEY,
+	BB_TYPE,
+	BB_MOUSE,
+	BB_CLICK,
+	BB_HASH,
+	BB_COMMIT,
+	BB_END
+} bb_op_t;
+
+typedef struct {
+	bb_op_t  op;
+	uint64_t hash;
+	int      a, b;
+	char     text[64];
+} bb_step_t;
+
+static struct {
+	char     name[32];
+	uint64_t real;
+	uint64_t host;
+} phases[BB_MAX_PHASES];
+
+static struct {
+	const char *name;
+	double      sec;
+} startup[BB_MAX_STARTUP];
+
+static bb_step_t steps[BB_MAX_STEPS];
+static int       numSteps;
+static int       numPhases;
+static int       current;
+static int       textPos;
+static bool      keyPending;
+static bool      buttonPending;
+static uint64_t  stepStart;
+static uint64_t  lastHashTime;
+static uint64_t  lastHash;
+static uint64_t  startReal;
+static uint64_t  startHost;
+static int       numStartup;
+static uint64_t  startupLast;
+
+bool bBootbench = false;
+static bool bFailed = false;
+
+
+/*-----------------------------------------------------------------------*/
+/**
+ * FNV-1a hash of the visible part of the framebuffer.
+ */
+static uint64_t Bootbench_Hash(void)
+{
+	uint64_t hash = 0xcbf29ce484222325ULL;
+	int pitch, width, x, y;
+
+	if (!NEXTVideo)
+		return 0;
+
+	pitch = 1120 + (ConfigureParams.System.bTurbo ? 0 : 32);
+	if (ConfigureParams.System.bColor) {
+		pitch *= 2;
+		width  = 1120 * 2;
+	} else {
+		pitch /= 4;
+		width  = 1120 / 4;
+	}
+	for (y = 0; y < 832; y++) {
+		const uint8_t *line = NEXTVideo + y * pitch;
+		for (x = 0; x < width; x++) {
+			hash ^= line[x];
+			hash *= 0x100000001b3ULL;
+		}
+	}
+	return hash;
+}
+
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Load a script. Returns false and prints the reason if it is invalid.
+ */
+bool Bootbench_Load(const char *path)
+{
+	char line[256], cmd[16], arg[128];
+	FILE *file;
+	int n = 0;
+
+	file = fopen(path, "r");
+	if (!file) {
+		fprintf(stderr, "Bootbench: can't open %s\n", path);
+		return false;
+	}
+	numSteps = 0;
+	while (fgets(line, sizeof(line), file)) {
+		bb_step_t *step = &steps[numSteps];
+		char *s = Str_Trim(line);
+
+		n++;
+		if (!s[0] || s[0] == '#')
+			continue;
+		if (numSteps >= BB_MAX_STEPS - 1) {
+			fprintf(stderr, "Bootbench: too many steps in %s\n", path);
+			fclose(file);
+			return false;
+		}
+		memset(step, 0, sizeof(*step));
+		arg[0] = 0;
+		sscanf(s, "%15s %127[^\n]", cmd, arg);
+
+		if (!strcmp(cmd, "phase") && arg[0]) {
+			step->op = BB_PHASE;
+			Str_Copy(step->text, arg, sizeof(step->text));
+		} else if (!strcmp(cmd, "wait") && sscanf(arg, "%" SCNx64 " %d", &step->hash, &step->a) >= 1) {
+			step->op = BB_WAIT;
+			if (step->a <= 0)
+				step->a = 600;
+		} else if (!strcmp(cmd, "sleep") && sscanf(arg, "%d", &step->a) == 1) {
+			step->op = BB_SLEEP;
+		} else if (!strcmp(cmd, "key") && Keymap_GetKeyFromName(arg) != SDLK_UNKNOWN) {
+			step->op = BB_KEY;
+			step->a  = Keymap_GetKeyFromName(arg);
+		} else if (!strcmp(cmd, "type") && arg[0]) {
+			step->op = BB_TYPE;
+			Str_Copy(step->text, arg, sizeof(step->text));
+		} else if (!strcmp(cmd, "mouse") && sscanf(arg, "%d %d", &step->a, &step->b) == 2) {
+			step->op = BB_MOUSE;
+		} else if (!strcmp(cmd, "click")) {
+			step->op = BB_CLICK;
+			step->a  = strcmp(arg, "right") != 0;
+		} else if (!strcmp(cmd, "hash")) {
+			step->op = BB_HASH;
+		} else if (!strcmp(cmd, "commit")) {
+			step->op = BB_COMMIT;
+		} else if (!strcmp(cmd, "end")) {
+			step->op = BB_END;
+		} else {
+			fprintf(stderr, "Bootbench: invalid line %d in %s: %s\n", n, path, s);
+			fclose(file);
+			return false;
+		}
+		numSteps++;
+	}
+	fclose(file);
+
+	/* Always finish with a report */
+	steps[numSteps++].op = BB_END;
+
+	current     = 0;
+	numPhases   = 0;
+	textPos     = 0;
+	stepStart   = 0;
+	numStartup  = 0;
+	startupLast = SDL_GetPerformanceCounter();
+	bBootbench  = true;
+	return true;
+}
+
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Record the time taken by a startup step since the previous one.
+ */
+void Bootbench_StartupStep(const char *name)
+{
+	uint64_t now;
+
+	if (!bBootbench)
+		return;
+
+	now = SDL_GetPerformanceCounter();
+	if (numStartup < BB_MAX_STARTUP) {
+		startup[numStartup].name = name;
+		startup[numStartup].sec  = (double)(now - startupLast) / SDL_GetPerformanceFrequency();
+		numStartup++;
+	}
+	startupLast = now;
+}
+
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Press or release a key through the same path as host key events.
+ */
+static void Bootbench_Key(int keycode, bool shift, bool down)
+{
+	SDL_Keysym key;
+
+	memset(&key, 0, sizeof(key));
+	key.sym      = keycode;
+	key.scancode = SDL_GetScancodeFromKey(keycode);
+	key.mod      = shift ? KMOD_LSHIFT : KMOD_NONE;
+	if (down)
+		Keymap_KeyDown(&key);
+	else
+		Keymap_KeyUp(&key);
+}
+
+static void Bootbench_TypeChar(char c, bool down)
+{
+	static const char shifted[] = "~!@#$%^&*()_+{}|:\"<>?";
+	static const char plain[]   = "`1234567890-=[]\\;',./";
+	const char *p = strchr(shifted, c);
+
+	if (c >= 'A' && c <= 'Z')
+		Bootbench_Key(c - 'A' + 'a', true, down);
+	else if (c && p)
+		Bootbench_Key(plain[p - shifted], true, down);
+	else
+		Bootbench_Key((unsigned char)c, false, down);
+}
+
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Close the running phase and print the report.
+ */
+static void Bootbench_EndPhase(uint64_t real, uint64_t host)
+{
+	if (numPhases > 0) {
+		phases[numPhases - 1].real = real - phases[numPhases - 1].real;
+		phases[numPhases - 1].host = host - phases[numPhases - 1].host;
+	}
+}
+
+static void Bootbench_Report(uint64_t real, uint64_t host, bool ok)
+{
+	int i;
+
+	fprintf(stdout, "Bootbench %s:\n", ok ? "complete" : "FAILED");
+	fprintf(stdout, "  %-20s %10s\n", "startup", "wall [s]");
+	for (i = 0; i < numStartup; i++) {
+		fprintf(stdout, "  %-20s %10.3f\n", startup[i].name, startup[i].sec);
+	}
+	fprintf(stdout, "  %-20s %10s %10s\n", "phase", "wall [s]", "guest [s]");
+	for (i = 0; i < numPhases; i++) {
+		fprintf(stdout, "  %-20s %10.3f %10.3f\n", phases[i].name,
+		        phases[i].real / 1000000.0, phases[i].host / 1000000.0);
+	}
+	fprintf(stdout, "  %-20s %10.3f %10.3f\n", "total",
+	        (real - startReal) / 1000000.0, (host - startHost) / 1000000.0);
+	fflush(stdout);
+}
+
+
+static void Bootbench_Fail(uint64_t real, uint64_t host)
+{
+	Bootbench_EndPhase(real, host);
+	Bootbench_Report(real, host, false);
+	bBootbench = false;
+	bFailed    = true;
+	Main_RequestQuit(false);
+}
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Exit status of the program, non-zero if a script has failed.
+ */
+int Bootbench_ExitCode(void)
+{
+	return bFailed ? 1 : 0;
+}
+
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Run the script. Called from the emulator event loop, one input event is
+ * sent per call so that the guest sees separate key down and up events.
+ */
+void Bootbench_Poll(void)
+{
+	uint64_t real, host;
+	bb_step_t *step;
+	int i;
+
+	host_time(&real, &host);
+
+	if (!stepStart) {
+		Bootbench_StartupStep("first event");
+		startReal = stepStart = real;
+		startHost = host;
+	}
+	if (keyPending) {
+		step = &steps[current];
+		if (step->op == BB_TYPE)
+			Bootbench_TypeChar(step->text[textPos++], false);
+		else
+			Bootbench_Key(step->a, false, false);
+		keyPending = false;
+		if (step->op == BB_TYPE && step->text[textPos])
+			return;
+		current++;
+		textPos   = 0;
+		stepStart = real;
+		return;
+	}
+	if (buttonPending) {
+		Keymap_MouseUp(steps[current].a);
+		buttonPending = false;
+		current++;
+		stepStart = real;
+		return;
+	}
+
+	while (current < numSteps) {
+		step = &steps[current];
+		switch (step->op) {
+			case BB_PHASE:
+				Bootbench_EndPhase(real, host);
+				if (numPhases < BB_MAX_PHASES) {
+					Str_Copy(phases[numPhases].name, step->text, sizeof(phases[numPhases].name));
+					phases[numPhases].real = real;
+					phases[numPhases].host = host;
+					numPhases++;
+				}
+				fprintf(stdout, "Bootbench: phase %s at %.3f s\n", step->text, (real - startReal) / 1000000.0);
+				break;
+			case BB_WAIT:
+				if (real - lastHashTime >= BB_HASH_US) {
+					lastHashTime = real;
+					lastHash     = Bootbench_Hash();
+				}
+				if (lastHash != step->hash) {
+					if (real - stepStart < step->a * 1000000ULL)
+						return;
+					fprintf(stdout, "Bootbench: timeout waiting for %016" PRIx64 ", screen is %016" PRIx64 "\n",
+					        step->hash, lastHash);
+					Bootbench_Fail(real, host);
+					return;
+				}
+				break;
+			case BB_SLEEP:
+				if (real - stepStart < step->a * 1000ULL)
+					return;
+				break;
+			case BB_KEY:
+				Bootbench_Key(step->a, false, true);
+				keyPending = true;
+				return;
+			case BB_TYPE:
+				Bootbench_TypeChar(step->text[textPos], true);
+				keyPending = true;
+				return;
+			case BB_MOUSE:
+				Keymap_MouseMove(step->a, step->b);
+				break;
+			case BB_CLICK:
+				Keymap_MouseDown(step->a);
+				buttonPending = true;
+				return;
+			case BB_HASH:
+				fprintf(stdout, "Bootbench: screen hash %016" PRIx64 " at %.3f s\n",
+				        Bootbench_Hash(), (real - startReal) / 1000000.0);
+				break;
+			case BB_COMMIT:
+				for (i = 0; i < ESP_MAX_DEVS; i++) {
+					if (SCSI_OverlayCount(i) > 0 && !SCSI_OverlayCommit(i)) {
+						fprintf(stdout, "Bootbench: commit of SCSI disk %d failed\n", i);
+						Bootbench_Fail(real, host);
+						return;
+					}
+				}
+				fprintf(stdout, "Bootbench: disks committed at %.3f s\n", (real - startReal) / 1000000.0);
+				break;
+			case BB_END:
+				Bootbench_EndPhase(real, host);
+				Bootbench_Report(real, host, true);
+				bBootbench = false;
+				Main_RequestQuit(false);
+				return;
+		}
+		current++;
+		textPos      = 0;
+		stepStart    = real;
+		lastHashTime = 0;
+	}
+}
@@ -67,13 +67,10 @@ const char CfgOpts_fileid[] = "Hatari cfgopts.c";
 #include "log.h"
 
 
-static int parse_input_config_entry(const struct Config_Tag *ptr)
+static int parse_input_config_entry(const struct Config_Tag *ptr, const char *next)
 {
-	const char *next;
 	int type = ptr->type;
 
-	/* get actual config value */
-	next = Str_Trim(strtok(NULL, ""));
 	if (next == NULL)
 	{
 		if (type == String_Tag || type == Key_Tag)
@@ -185,7 +182,7 @@ int input_config(const char *filename, const struct Config_Tag configs[], const
 			{
 				if (!strcmp(tok, ptr->code))    /* got a match? */
 				{
-					if (parse_input_config_entry(ptr) == 0)
+					if (parse_input_config_entry(ptr, Str_Trim(strtok(NULL, ""))) == 0)
 						count++;
 					else
 						Log_Printf(LOG_WARN, "Error in Config file %s on line %d\n",
@@ -200,6 +197,83 @@ int input_config(const char *filename, const struct Config_Tag configs[], const
 }
 
 
+/**
+ * Read all sections of a configuration (INI) file in one pass.
+ * Returns the number of records read or -1 on error.
+ */
+int input_config_sections(const char *filename, const struct Config_Section sections[])
+{
+	const struct Config_Section *section;
+	const struct Config_Tag *configs = NULL, *ptr;
+	int count = 0, lineno = 0;
+	FILE *file;
+	char *fptr, *tok;
+	char line[1024];
+
+	file = fopen(filename, "r");
+	if (file == NULL)
+		return -1;
+
+	while ((fptr = Str_Trim(fgets(line, sizeof(line), file))) != NULL)
+	{
+		lineno++;
+		if (fptr[0] == '#')
+			continue;                       /* skip comments */
+		if (fptr[0] == '[')
+		{
+			/* switch to the tokens of this section, if known */
+			configs = NULL;
+			for (section = sections; section->header; ++section)
+			{
+				if (!strncmp(fptr, section->header, strlen(section->header)))
+				{
+					configs = section->configs;
+					break;
+				}
+			}
+			continue;
+		}
+		if (configs == NULL)
+			continue;
+		tok = Str_Trim(strtok(fptr, "="));      /* get first token */
+		if (tok == NULL)
+			continue;
+		for (ptr = configs; ptr->buf; ++ptr)    /* scan for token */
+		{
+			if (!strcmp(tok, ptr->code))
+			{
+				if (parse_input_config_entry(ptr, Str_Trim(strtok(NULL, ""))) == 0)
+					count++;
+				else
+					Log_Printf(LOG_WARN, "Error in Config file %s on line %d\n",
+					       filename, lineno);
+				break;
+			}
+		}
+	}
+
+	fclose(file);
+	return count;
+}
+
+
+/**
+ * Set a single option 'key' of the given section to 'value'.
+ * Returns 0 on success, -1 if the option is unknown or the value invalid.
+ */
+int set_config_option(const struct Config_Tag configs[], const char *key, const char *value)
+{
+	const struct Config_Tag *ptr;
+
+	for (ptr = configs; ptr->buf; ++ptr)
+	{
+		if (!strcmp(key, ptr->code))
+			return parse_input_config_entry(ptr, value);
+	}
+	return -1;
+}
+
+
 /**
  *  Write out an settings line
  */
@@ -29,6 +29,10 @@ const char Change_fileid[] = "Previous change.c";
 #include "floppy.h"
 #include "ethernet.h"
 #include "snd.h"
+#include "host.h"
+#include "dsp.h"
+#include "rfb.h"
+#include "metrics.h"
 
 #define DEBUG 1
 #if DEBUG
@@ -91,19 +95,13 @@ bool Change_DoNeedReset(CNF_PARAMS *current, CNF_PARAMS *changed)
 		return true;
 	}
 
-	/* Did we change CPU type? */
-	if ((current->System.nCpuLevel != changed->System.nCpuLevel) ||
-		(current->System.nCpuFreq != changed->System.nCpuFreq)) {
+	/* Did we change CPU type? CPU frequency, realtime and fast forward
+	 * flags are applied without reset. */
+	if (current->System.nCpuLevel != changed->System.nCpuLevel) {
 		printf("cpu type reset\n");
 		return true;
 	}
 
-	/* Did we change the realtime flag? */
-	if (current->System.bRealtime != changed->System.bRealtime) {
-		printf("realtime flag reset\n");
-		return true;
-	}
-
 	/* Did we change FPU type? */
 	if (current->System.n_FPUType != changed->System.n_FPUType) {
 		printf("fpu type reset\n");
@@ -160,7 +158,8 @@ bool Change_DoNeedReset(CNF_PARAMS *current, CNF_PARAMS *changed)
 		(current->Boot.bLoopPot != changed->Boot.bLoopPot) ||
 		(current->Boot.bVerbose != changed->Boot.bVerbose) ||
 		(current->Boot.bExtendedPot != changed->Boot.bExtendedPot) ||
-		(current->Boot.bVisible != changed->Boot.bVisible)) {
+		(current->Boot.bVisible != changed->Boot.bVisible) ||
+		(current->Boot.bFastBoot != changed->Boot.bFastBoot)) {
 		printf("boot options reset\n");
 		return true;
 	}
@@ -170,7 +169,8 @@ bool Change_DoNeedReset(CNF_PARAMS *current, CNF_PARAMS *changed)
 		if (current->SCSI.target[i].nDeviceType != changed->SCSI.target[i].nDeviceType ||
 			(current->SCSI.target[i].nDeviceType == SD_HARDDISK &&
 			 (current->SCSI.target[i].bWriteProtected != changed->SCSI.target[i].bWriteProtected ||
-			  strcmp(current->SCSI.target[i].szImageName, changed->SCSI.target[i].szImageName)))) {
+			  strcmp(current->SCSI.target[i].szImageName, changed->SCSI.target[i].szImageName) ||
+			  strcmp(current->SCSI.target[i].szOverlayName, changed->SCSI.target[i].szOverlayName)))) {
 				 printf("scsi disk reset\n");
 				 return true;
 			 }
@@ -179,6 +179,14 @@ bool Change_DoNeedReset(CNF_PARAMS *current, CNF_PARAMS *changed)
 		printf("scsi disk reset\n");
 		return true;
 	}
+	if (current->System.bMapDiskImages != changed->System.bMapDiskImages) {
+		printf("disk image mapping reset\n");
+		return true;
+	}
+	if (current->System.nDiskCacheSize != changed->System.nDiskCacheSize) {
+		printf("disk cache reset\n");
+		return true;
+	}
 
 	/* Did we change MO drive? */
 	for (i = 0; i < MO_MAX_DRIVES; i++) {
@@ -202,6 +210,15 @@ bool Change_DoNeedReset(CNF_PARAMS *current, CNF_PARAMS *changed)
 		return true;
 	}
 
+	/* Did we change the serial port bridge? */
+	if (current->Serial.nHost != changed->Serial.nHost ||
+		current->Serial.nChannel != changed->Serial.nChannel ||
+		current->Serial.nTcpPort != changed->Serial.nTcpPort ||
+		strcmp(current->Serial.szPtyLink, changed->Serial.szPtyLink)) {
+		printf("serial reset\n");
+		return true;
+	}
+
 	/* Did we change NeXTdimension? */
 	for (i = 0; i < ND_MAX_BOARDS; i++) {
 		if (current->Dimension.board[i].bEnabled != changed->Dimension.board[i].bEnabled ||
@@ -217,12 +234,35 @@ bool Change_DoNeedReset(CNF_PARAMS *current, CNF_PARAMS *changed)
 		}
 	}
 	if (current->Dimension.bI860Thread != changed->Dimension.bI860Thread ||
+		current->Dimension.bI860CompatibleFPU != changed->Dimension.bI860CompatibleFPU ||
 		current->Dimension.bMainDisplay != changed->Dimension.bMainDisplay ||
 		current->Dimension.nMainDisplay != changed->Dimension.nMainDisplay) {
 		printf("dimension display reset\n");
 		return true;
 	}
 
+	/* Did we change the paravirtual NeXTbus disk? */
+	if (current->NBDisk.bEnabled != changed->NBDisk.bEnabled ||
+		current->NBDisk.nSlot != changed->NBDisk.nSlot ||
+		current->NBDisk.bWriteProtected != changed->NBDisk.bWriteProtected ||
+		strcmp(current->NBDisk.szImageName, changed->NBDisk.szImageName)) {
+		printf("nextbus disk reset\n");
+		return true;
+	}
+	if (current->NBNet.bEnabled != changed->NBNet.bEnabled ||
+		current->NBNet.nSlot != changed->NBNet.nSlot) {
+		printf("nextbus network reset\n");
+		return true;
+	}
+
+	/* Did we change the co-processor thread skew? The DSP thread is
+	 * restarted without reset, the i860 thread only starts on reset. */
+	if (current->System.nThreadSkew != changed->System.nThreadSkew &&
+		current->Dimension.bI860Thread) {
+		printf("thread skew reset\n");
+		return true;
+	}
+
 	/* Else no reset is required */
 	printf("No Reset needed!\n");
 	return false;
@@ -238,7 +278,11 @@ void Change_CopyChangedParamsToConfiguration(CNF_PARAMS *current, CNF_PARAMS *ch
 	bool NeedReset;
 	bool bReInitEnetEmu = false;
 	bool bReInitSoundEmu = false;
+	bool bReInitRfb = false;
+	bool bReInitMetrics = false;
 	bool bScreenModeChange = false;
+	bool bSpeedChange = false;
+	bool bDSPThreadChange = false;
 
 	Dprintf("Changes for:\n");
 	/* Do we need to warn user that changes will only take effect after reset? */
@@ -253,6 +297,7 @@ void Change_CopyChangedParamsToConfiguration(CNF_PARAMS *current, CNF_PARAMS *ch
 	if (!NeedReset &&
 		(current->Ethernet.bEthernetConnected != changed->Ethernet.bEthernetConnected ||
 		 strcmp(current->Ethernet.szInterfaceName, changed->Ethernet.szInterfaceName) ||
+		 strcmp(current->Ethernet.szTapInterface, changed->Ethernet.szTapInterface) ||
 		 strcmp(current->Ethernet.szNFSroot, changed->Ethernet.szNFSroot))) {
 		bReInitEnetEmu = true;
 	}
@@ -272,6 +317,42 @@ void Change_CopyChangedParamsToConfiguration(CNF_PARAMS *current, CNF_PARAMS *ch
 		bScreenModeChange = true;
 	}
 
+	/* Do we need to restart the RFB server? It does not depend on the machine */
+	if (current->Screen.bRfbServer != changed->Screen.bRfbServer ||
+		current->Screen.nRfbPort != changed->Screen.nRfbPort ||
+		current->Screen.bRfbLocalOnly != changed->Screen.bRfbLocalOnly) {
+		bReInitRfb = true;
+	}
+
+	/* Do we need to restart the metrics server? */
+	if (current->Log.bMetricsServer != changed->Log.bMetricsServer ||
+		current->Log.nMetricsPort != changed->Log.nMetricsPort ||
+		current->Log.bMetricsLocalOnly != changed->Log.bMetricsLocalOnly) {
+		bReInitMetrics = true;
+	}
+
+	/* Do we need to change CPU speed or time base? */
+	if (!NeedReset &&
+		(current->System.nCpuFreq != changed->System.nCpuFreq ||
+		 current->System.bRealtime != changed->System.bRealtime ||
+		 current->System.bFastForward != changed->System.bFastForward)) {
+		bSpeedChange = true;
+	}
+
+	/* Sound output is off in fast forward mode */
+	if (!NeedReset &&
+		current->System.bFastForward != changed->System.bFastForward) {
+		bReInitSoundEmu = true;
+	}
+
+	/* Do we need to restart the DSP thread? */
+	if (!NeedReset &&
+		(current->System.bDSPThread != changed->System.bDSPThread ||
+		 current->System.nThreadSkew != changed->System.nThreadSkew ||
+		 (current->System.bDSPThread && current->System.nCpuFreq != changed->System.nCpuFreq))) {
+		bDSPThreadChange = true;
+	}
+
 	/* Copy details to configuration,
 	 * so it can be saved out or set on reset
 	 */
@@ -283,12 +364,38 @@ void Change_CopyChangedParamsToConfiguration(CNF_PARAMS *current, CNF_PARAMS *ch
 	/* Copy details to global, if we reset copy them all */
 	Configuration_Apply(NeedReset);
 
+	/* Change CPU speed? */
+	if (bSpeedChange) {
+		Dprintf("- CPU speed\n");
+		host_set_speed();
+	}
+
+	/* Restart DSP thread? */
+	if (bDSPThreadChange) {
+		Dprintf("- DSP thread\n");
+		DSP_SetThreading();
+	}
+
 	/* Re-init Ethernet? */
 	if (bReInitEnetEmu) {
 		Dprintf("- Ethernet\n");
 		Ethernet_Reset(false);
 	}
 
+	/* Restart RFB server? */
+	if (bReInitRfb) {
+		Dprintf("- RFB server\n");
+		Rfb_UnInit();
+		Rfb_Init();
+	}
+
+	/* Restart metrics server? */
+	if (bReInitMetrics) {
+		Dprintf("- Metrics server\n");
+		Metrics_UnInit();
+		Metrics_Init();
+	}
+
 	/* Re-init Sound? */
 	if (bReInitSoundEmu) {
 		Dprintf("- Sound\n");
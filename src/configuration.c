@@ -39,6 +39,9 @@ static const struct Config_Tag configs_Log[] =
 	{ "nAlertDlgLogLevel", Int_Tag, &ConfigureParams.Log.nAlertDlgLogLevel },
 	{ "bConfirmQuit", Bool_Tag, &ConfigureParams.Log.bConfirmQuit },
 	{ "bConsoleWindow", Bool_Tag, &ConfigureParams.Log.bConsoleWindow },
+	{ "bMetricsServer", Bool_Tag, &ConfigureParams.Log.bMetricsServer },
+	{ "nMetricsPort", Int_Tag, &ConfigureParams.Log.nMetricsPort },
+	{ "bMetricsLocalOnly", Bool_Tag, &ConfigureParams.Log.bMetricsLocalOnly },
 	{ NULL , Error_Tag, NULL }
 };
 
@@ -71,6 +74,15 @@ static const struct Config_Tag configs_Screen[] =
 	{ "bFullScreen", Bool_Tag, &ConfigureParams.Screen.bFullScreen },
 	{ "bShowStatusbar", Bool_Tag, &ConfigureParams.Screen.bShowStatusbar },
 	{ "bShowDriveLed", Bool_Tag, &ConfigureParams.Screen.bShowDriveLed },
+	{ "nFrameSkips", Int_Tag, &ConfigureParams.Screen.nFrameSkips },
+	{ "nFrameRateCap", Int_Tag, &ConfigureParams.Screen.nFrameRateCap },
+	{ "nPrescale", Int_Tag, &ConfigureParams.Screen.nPrescale },
+	{ "bNDInMainWindow", Bool_Tag, &ConfigureParams.Screen.bNDInMainWindow },
+	{ "szRecordCommand", String_Tag, ConfigureParams.Screen.szRecordCommand },
+	{ "bHeadless", Bool_Tag, &ConfigureParams.Screen.bHeadless },
+	{ "bRfbServer", Bool_Tag, &ConfigureParams.Screen.bRfbServer },
+	{ "nRfbPort", Int_Tag, &ConfigureParams.Screen.nRfbPort },
+	{ "bRfbLocalOnly", Bool_Tag, &ConfigureParams.Screen.bRfbLocalOnly },
 	{ NULL , Error_Tag, NULL }
 };
 
@@ -141,6 +153,7 @@ static const struct Config_Tag configs_Sound[] =
 {
 	{ "bEnableMicrophone", Bool_Tag, &ConfigureParams.Sound.bEnableMicrophone },
   	{ "bEnableSound", Bool_Tag, &ConfigureParams.Sound.bEnableSound },
+	{ "szRecordCommand", String_Tag, ConfigureParams.Sound.szRecordCommand },
 	{ NULL , Error_Tag, NULL }
 };
 
@@ -152,6 +165,8 @@ static const struct Config_Tag configs_Memory[] =
 	{ "nMemoryBankSize2", Int_Tag, &ConfigureParams.Memory.nMemoryBankSize[2] },
 	{ "nMemoryBankSize3", Int_Tag, &ConfigureParams.Memory.nMemoryBankSize[3] },
 	{ "nMemorySpeed", Int_Tag, &ConfigureParams.Memory.nMemorySpeed },
+	{ "bMergeablePages", Bool_Tag, &ConfigureParams.Memory.bMergeablePages },
+	{ "bHugePages", Bool_Tag, &ConfigureParams.Memory.bHugePages },
 	{ NULL , Error_Tag, NULL }
 };
 
@@ -167,6 +182,7 @@ static const struct Config_Tag configs_Boot[] =
 	{ "bVerbose", Bool_Tag, &ConfigureParams.Boot.bVerbose },
 	{ "bExtendedPot", Bool_Tag, &ConfigureParams.Boot.bExtendedPot },
 	{ "bVisible", Bool_Tag, &ConfigureParams.Boot.bVisible },
+	{ "bFastBoot", Bool_Tag, &ConfigureParams.Boot.bFastBoot },
 	{ NULL , Error_Tag, NULL }
 };
 
@@ -177,36 +193,43 @@ static const struct Config_Tag configs_SCSI[] =
 	{ "nDeviceType0", Int_Tag, &ConfigureParams.SCSI.target[0].nDeviceType },
 	{ "bDiskInserted0", Bool_Tag, &ConfigureParams.SCSI.target[0].bDiskInserted },
 	{ "bWriteProtected0", Bool_Tag, &ConfigureParams.SCSI.target[0].bWriteProtected },
+	{ "szOverlayName0", String_Tag, ConfigureParams.SCSI.target[0].szOverlayName },
 	
 	{ "szImageName1", String_Tag, ConfigureParams.SCSI.target[1].szImageName },
 	{ "nDeviceType1", Int_Tag, &ConfigureParams.SCSI.target[1].nDeviceType },
 	{ "bDiskInserted1", Bool_Tag, &ConfigureParams.SCSI.target[1].bDiskInserted },
 	{ "bWriteProtected1", Bool_Tag, &ConfigureParams.SCSI.target[1].bWriteProtected },
+	{ "szOverlayName1", String_Tag, ConfigureParams.SCSI.target[1].szOverlayName },
 
 	{ "szImageName2", String_Tag, ConfigureParams.SCSI.target[2].szImageName },
 	{ "nDeviceType2", Int_Tag, &ConfigureParams.SCSI.target[2].nDeviceType },
 	{ "bDiskInserted2", Bool_Tag, &ConfigureParams.SCSI.target[2].bDiskInserted },
 	{ "bWriteProtected2", Bool_Tag, &ConfigureParams.SCSI.target[2].bWriteProtected },
+	{ "szOverlayName2", String_Tag, ConfigureParams.SCSI.target[2].szOverlayName },
 
 	{ "szImageName3", String_Tag, ConfigureParams.SCSI.target[3].szImageName },
 	{ "nDeviceType3", Int_Tag, &ConfigureParams.SCSI.target[3].nDeviceType },
 	{ "bDiskInserted3", Bool_Tag, &ConfigureParams.SCSI.target[3].bDiskInserted },
 	{ "bWriteProtected3", Bool_Tag, &ConfigureParams.SCSI.target[3].bWriteProtected },
+	{ "szOverlayName3", String_Tag, ConfigureParams.SCSI.target[3].szOverlayName },
 
 	{ "szImageName4", String_Tag, ConfigureParams.SCSI.target[4].szImageName },
 	{ "nDeviceType4", Int_Tag, &ConfigureParams.SCSI.target[4].nDeviceType },
 	{ "bDiskInserted4", Bool_Tag, &ConfigureParams.SCSI.target[4].bDiskInserted },
 	{ "bWriteProtected4", Bool_Tag, &ConfigureParams.SCSI.target[4].bWriteProtected },
+	{ "szOverlayName4", String_Tag, ConfigureParams.SCSI.target[4].szOverlayName },
 
 	{ "szImageName5", String_Tag, ConfigureParams.SCSI.target[5].szImageName },
 	{ "nDeviceType5", Int_Tag, &ConfigureParams.SCSI.target[5].nDeviceType },
 	{ "bDiskInserted5", Bool_Tag, &ConfigureParams.SCSI.target[5].bDiskInserted },
 	{ "bWriteProtected5", Bool_Tag, &ConfigureParams.SCSI.target[5].bWriteProtected },
+	{ "szOverlayName5", String_Tag, ConfigureParams.SCSI.target[5].szOverlayName },
 
 	{ "szImageName6", String_Tag, ConfigureParams.SCSI.target[6].szImageName },
 	{ "nDeviceType6", Int_Tag, &ConfigureParams.SCSI.target[6].nDeviceType },
 	{ "bDiskInserted6", Bool_Tag, &ConfigureParams.SCSI.target[6].bDiskInserted },
 	{ "bWriteProtected6", Bool_Tag, &ConfigureParams.SCSI.target[6].bWriteProtected },
+	{ "szOverlayName6", String_Tag, ConfigureParams.SCSI.target[6].szOverlayName },
 
 	{ "nWriteProtection", Int_Tag, &ConfigureParams.SCSI.nWriteProtection },
 
@@ -226,6 +249,8 @@ static const struct Config_Tag configs_MO[] =
 	{ "bDiskInserted1", Bool_Tag, &ConfigureParams.MO.drive[1].bDiskInserted },
 	{ "bWriteProtected1", Bool_Tag, &ConfigureParams.MO.drive[1].bWriteProtected },
 
+	{ "bTrustImage", Bool_Tag, &ConfigureParams.MO.bTrustImage },
+
 	{ NULL , Error_Tag, NULL }
 };
 
@@ -253,8 +278,12 @@ static const struct Config_Tag configs_Ethernet[] =
 
 	{ "nHostInterface", Int_Tag, &ConfigureParams.Ethernet.nHostInterface },
 	{ "szInterfaceName", String_Tag, ConfigureParams.Ethernet.szInterfaceName },
+	{ "szTapInterface", String_Tag, ConfigureParams.Ethernet.szTapInterface },
 	{ "szNFSroot", String_Tag, ConfigureParams.Ethernet.szNFSroot },
 	{ "bNetworkTime", Bool_Tag, &ConfigureParams.Ethernet.bNetworkTime },
+	{ "nSlirpBufferSize", Int_Tag, &ConfigureParams.Ethernet.nSlirpBufferSize },
+	{ "bSlirpNoDelay", Bool_Tag, &ConfigureParams.Ethernet.bSlirpNoDelay },
+	{ "bUnlimitedSpeed", Bool_Tag, &ConfigureParams.Ethernet.bUnlimitedSpeed },
 
 	{ NULL , Error_Tag, NULL }
 };
@@ -283,6 +312,20 @@ static const struct Config_Tag configs_Printer[] =
 	{ "bPrinterConnected", Bool_Tag, &ConfigureParams.Printer.bPrinterConnected },
 	{ "nPaperSize", Int_Tag, &ConfigureParams.Printer.nPaperSize },
 	{ "szPrintToFileName", String_Tag, ConfigureParams.Printer.szPrintToFileName },
+	{ "nOutputFormat", Int_Tag, &ConfigureParams.Printer.nOutputFormat },
+	{ "nCompression", Int_Tag, &ConfigureParams.Printer.nCompression },
+	{ "nPngFilter", Int_Tag, &ConfigureParams.Printer.nPngFilter },
+	{ NULL , Error_Tag, NULL }
+};
+
+/* Used to load/save serial port options */
+static const struct Config_Tag configs_Serial[] =
+{
+	{ "nHost", Int_Tag, &ConfigureParams.Serial.nHost },
+	{ "nChannel", Int_Tag, &ConfigureParams.Serial.nChannel },
+	{ "nTcpPort", Int_Tag, &ConfigureParams.Serial.nTcpPort },
+	{ "szPtyLink", String_Tag, ConfigureParams.Serial.szPtyLink },
+	{ "bHighSpeed", Bool_Tag, &ConfigureParams.Serial.bHighSpeed },
 	{ NULL , Error_Tag, NULL }
 };
 
@@ -300,9 +343,22 @@ static const struct Config_Tag configs_System[] =
 	{ "nCpuLevel", Int_Tag, &ConfigureParams.System.nCpuLevel },
 	{ "nCpuFreq", Int_Tag, &ConfigureParams.System.nCpuFreq },
 	{ "bCompatibleCpu", Bool_Tag, &ConfigureParams.System.bCompatibleCpu },
+	{ "bBlockCache", Bool_Tag, &ConfigureParams.System.bBlockCache },
+	{ "bHostTLB", Bool_Tag, &ConfigureParams.System.bHostTLB },
+	{ "bFastLoops", Bool_Tag, &ConfigureParams.System.bFastLoops },
+	{ "bCpuCaches", Bool_Tag, &ConfigureParams.System.bCpuCaches },
+	{ "bKernelIdle", Bool_Tag, &ConfigureParams.System.bKernelIdle },
 	{ "bRealtime", Bool_Tag, &ConfigureParams.System.bRealtime },
+	{ "bFastForward", Bool_Tag, &ConfigureParams.System.bFastForward },
+	{ "bAudioSync", Bool_Tag, &ConfigureParams.System.bAudioSync },
+	{ "nMaxSpeed", Int_Tag, &ConfigureParams.System.nMaxSpeed },
+	{ "nThreadSkew", Int_Tag, &ConfigureParams.System.nThreadSkew },
+	{ "nIOTiming", Int_Tag, &ConfigureParams.System.nIOTiming },
+	{ "bMapDiskImages", Bool_Tag, &ConfigureParams.System.bMapDiskImages },
+	{ "nDiskCacheSize", Int_Tag, &ConfigureParams.System.nDiskCacheSize },
 	{ "nDSPType", Int_Tag, &ConfigureParams.System.nDSPType },
 	{ "bDSPMemoryExpansion", Bool_Tag, &ConfigureParams.System.bDSPMemoryExpansion },
+	{ "bDSPThread", Bool_Tag, &ConfigureParams.System.bDSPThread },
 	{ "n_FPUType", Int_Tag, &ConfigureParams.System.n_FPUType },
 	{ "bCompatibleFPU", Bool_Tag, &ConfigureParams.System.bCompatibleFPU },
 	{ "bMMU", Bool_Tag, &ConfigureParams.System.bMMU },
@@ -313,8 +369,10 @@ static const struct Config_Tag configs_System[] =
 static const struct Config_Tag configs_Dimension[] =
 {
 	{ "bI860Thread",       Bool_Tag, &ConfigureParams.Dimension.bI860Thread },
+	{ "bI860CompatibleFPU", Bool_Tag, &ConfigureParams.Dimension.bI860CompatibleFPU },
 	{ "bMainDisplay",      Bool_Tag, &ConfigureParams.Dimension.bMainDisplay },
 	{ "nMainDisplay",      Int_Tag,  &ConfigureParams.Dimension.nMainDisplay },
+	{ "szStatsFileName",   String_Tag, ConfigureParams.Dimension.szStatsFileName },
 
 	{ "bEnabled0",         Bool_Tag, &ConfigureParams.Dimension.board[0].bEnabled },
 	{ "nMemoryBankSize00", Int_Tag,  &ConfigureParams.Dimension.board[0].nMemoryBankSize[0] },
@@ -340,6 +398,26 @@ static const struct Config_Tag configs_Dimension[] =
 	{ NULL , Error_Tag, NULL }
 };
 
+/* Used to load/save paravirtual NeXTbus disk options */
+static const struct Config_Tag configs_NBDisk[] =
+{
+	{ "bEnabled",        Bool_Tag,   &ConfigureParams.NBDisk.bEnabled },
+	{ "nSlot",           Int_Tag,    &ConfigureParams.NBDisk.nSlot },
+	{ "bWriteProtected", Bool_Tag,   &ConfigureParams.NBDisk.bWriteProtected },
+	{ "szImageName",     String_Tag, ConfigureParams.NBDisk.szImageName },
+
+	{ NULL , Error_Tag, NULL }
+};
+
+/* Used to load/save paravirtual NeXTbus network options */
+static const struct Config_Tag configs_NBNet[] =
+{
+	{ "bEnabled",        Bool_Tag,   &ConfigureParams.NBNet.bEnabled },
+	{ "nSlot",           Int_Tag,    &ConfigureParams.NBNet.nSlot },
+
+	{ NULL , Error_Tag, NULL }
+};
+
 /*-----------------------------------------------------------------------*/
 /**
  * Set default configuration values.
@@ -363,6 +441,9 @@ void Configuration_SetDefault(void)
 	ConfigureParams.Log.nAlertDlgLogLevel = LOG_ERROR;
 	ConfigureParams.Log.bConfirmQuit = true;
 	ConfigureParams.Log.bConsoleWindow = false;
+	ConfigureParams.Log.bMetricsServer = false;
+	ConfigureParams.Log.nMetricsPort = 9180;
+	ConfigureParams.Log.bMetricsLocalOnly = true;
 
 	/* Set defaults for config dialog */
 	ConfigureParams.ConfigDialog.bShowConfigDialogAtStartup = true;
@@ -389,6 +470,7 @@ void Configuration_SetDefault(void)
 	ConfigureParams.Boot.bVerbose = true;
 	ConfigureParams.Boot.bExtendedPot = false;
 	ConfigureParams.Boot.bVisible = false;
+	ConfigureParams.Boot.bFastBoot = false;
 
 	/* Set defaults for SCSI disks */
 	for (i = 0; i < ESP_MAX_DEVS; i++) {
@@ -396,6 +478,7 @@ void Configuration_SetDefault(void)
 		ConfigureParams.SCSI.target[i].nDeviceType = SD_NONE;
 		ConfigureParams.SCSI.target[i].bDiskInserted = false;
 		ConfigureParams.SCSI.target[i].bWriteProtected = false;
+		ConfigureParams.SCSI.target[i].szOverlayName[0] = '\0';
 	}
 	ConfigureParams.SCSI.nWriteProtection = WRITEPROT_OFF;
 
@@ -406,6 +489,7 @@ void Configuration_SetDefault(void)
 		ConfigureParams.MO.drive[i].bDiskInserted = false;
 		ConfigureParams.MO.drive[i].bWriteProtected = false;
 	}
+	ConfigureParams.MO.bTrustImage = false;
 
 	/* Set defaults for floppy drives */
 	for (i = 0; i < FLP_MAX_DRIVES; i++) {
@@ -419,8 +503,12 @@ void Configuration_SetDefault(void)
 	ConfigureParams.Ethernet.bEthernetConnected = false;
 	ConfigureParams.Ethernet.bTwistedPair = false;
 	ConfigureParams.Ethernet.bNetworkTime = false;
+	ConfigureParams.Ethernet.nSlirpBufferSize = 64;
+	ConfigureParams.Ethernet.bSlirpNoDelay = true;
+	ConfigureParams.Ethernet.bUnlimitedSpeed = false;
 	ConfigureParams.Ethernet.nHostInterface = ENET_SLIRP;
 	strcpy(ConfigureParams.Ethernet.szInterfaceName, "");
+	strcpy(ConfigureParams.Ethernet.szTapInterface, "tap0");
 	File_MakePathBuf(ConfigureParams.Ethernet.szNFSroot,
 	                 sizeof(ConfigureParams.Ethernet.szNFSroot),
 	                 Paths_GetUserHome(), "", NULL);
@@ -462,6 +550,8 @@ void Configuration_SetDefault(void)
 	memset(ConfigureParams.Memory.nMemoryBankSize, 16, 
 	       sizeof(ConfigureParams.Memory.nMemoryBankSize)); /* 64 MiB */
 	ConfigureParams.Memory.nMemorySpeed = MEMORY_100NS;
+	ConfigureParams.Memory.bMergeablePages = false;
+	ConfigureParams.Memory.bHugePages = false;
 
 	/* Set defaults for Printer */
 	ConfigureParams.Printer.bPrinterConnected = false;
@@ -469,6 +559,16 @@ void Configuration_SetDefault(void)
 	File_MakePathBuf(ConfigureParams.Printer.szPrintToFileName,
 	                 sizeof(ConfigureParams.Printer.szPrintToFileName),
 	                 Paths_GetUserHome(), "", NULL);
+	ConfigureParams.Printer.nOutputFormat = PRINT_PNG;
+	ConfigureParams.Printer.nCompression = 6;
+	ConfigureParams.Printer.nPngFilter = IMG_FILTER_ADAPTIVE;
+
+	/* Set defaults for Serial */
+	ConfigureParams.Serial.nHost = SERIAL_NONE;
+	ConfigureParams.Serial.nChannel = 0;
+	ConfigureParams.Serial.nTcpPort = 5023;
+	ConfigureParams.Serial.szPtyLink[0] = '\0';
+	ConfigureParams.Serial.bHighSpeed = false;
 
 	/* Set defaults for Screen */
 	ConfigureParams.Screen.bFullScreen = false;
@@ -476,10 +576,20 @@ void Configuration_SetDefault(void)
 	ConfigureParams.Screen.nMonitorNum = 0;
 	ConfigureParams.Screen.bShowStatusbar = true;
 	ConfigureParams.Screen.bShowDriveLed = false;
+	ConfigureParams.Screen.nFrameSkips = 15;
+	ConfigureParams.Screen.nFrameRateCap = 0;
+	ConfigureParams.Screen.nPrescale = 1;
+	ConfigureParams.Screen.bNDInMainWindow = false;
+	ConfigureParams.Screen.szRecordCommand[0] = '\0';
+	ConfigureParams.Screen.bHeadless = false;
+	ConfigureParams.Screen.bRfbServer = false;
+	ConfigureParams.Screen.nRfbPort = 5900;
+	ConfigureParams.Screen.bRfbLocalOnly = true;
 
 	/* Set defaults for Sound */
 	ConfigureParams.Sound.bEnableMicrophone = true;
 	ConfigureParams.Sound.bEnableSound = true;
+	ConfigureParams.Sound.szRecordCommand[0] = '\0';
 
 	/* Set defaults for Rom */
 	File_MakePathBuf(ConfigureParams.Rom.szRom030FileName,
@@ -509,17 +619,32 @@ void Configuration_SetDefault(void)
 	ConfigureParams.System.nCpuLevel = 3;
 	ConfigureParams.System.nCpuFreq = 25;
 	ConfigureParams.System.bCompatibleCpu = false;
+	ConfigureParams.System.bBlockCache = false;
+	ConfigureParams.System.bHostTLB = false;
+	ConfigureParams.System.bFastLoops = false;
+	ConfigureParams.System.bCpuCaches = true;
+	ConfigureParams.System.bKernelIdle = false;
 	ConfigureParams.System.bRealtime = false;
+	ConfigureParams.System.bFastForward = false;
+	ConfigureParams.System.bAudioSync = false;
+	ConfigureParams.System.nMaxSpeed = 100;
+	ConfigureParams.System.nThreadSkew = 10000;
+	ConfigureParams.System.nIOTiming = IO_TIMING_ACCURATE;
+	ConfigureParams.System.bMapDiskImages = false;
+	ConfigureParams.System.nDiskCacheSize = 16;
 	ConfigureParams.System.nDSPType = DSP_TYPE_EMU;
 	ConfigureParams.System.bDSPMemoryExpansion = false;
+	ConfigureParams.System.bDSPThread = false;
 	ConfigureParams.System.n_FPUType = FPU_68882;
 	ConfigureParams.System.bCompatibleFPU = true;
 	ConfigureParams.System.bMMU = true;
 
 	/* Set defaults for Dimension */
 	ConfigureParams.Dimension.bI860Thread  = host_num_cpus() != 1;
+	ConfigureParams.Dimension.bI860CompatibleFPU = false;
 	ConfigureParams.Dimension.bMainDisplay = false;
 	ConfigureParams.Dimension.nMainDisplay = 0;
+	ConfigureParams.Dimension.szStatsFileName[0] = '\0';
 	for (i = 0; i < ND_MAX_BOARDS; i++) {
 		ConfigureParams.Dimension.board[i].bEnabled           = false;
 		ConfigureParams.Dimension.board[i].nMemoryBankSize[0] = 4;
@@ -531,6 +656,16 @@ void Configuration_SetDefault(void)
 		                 Paths_GetDataDir(), "ND_step1_v43", "BIN");
 	}
 
+	/* Set defaults for paravirtual NeXTbus disk */
+	ConfigureParams.NBDisk.bEnabled = false;
+	ConfigureParams.NBDisk.nSlot = 6;
+	ConfigureParams.NBDisk.bWriteProtected = false;
+	strcpy(ConfigureParams.NBDisk.szImageName, psWorkingDir);
+
+	/* Set defaults for paravirtual NeXTbus network */
+	ConfigureParams.NBNet.bEnabled = false;
+	ConfigureParams.NBNet.nSlot = 4;
+
 	/* Initialize the configuration file name */
 	if (File_MakePathBuf(sConfigFileName, sizeof(sConfigFileName),
 	                     psHomeDir, "previous", "cfg"))
@@ -589,6 +724,38 @@ void Configuration_Apply(bool bReset)
 	/* Make sure NBIC is only used on Cubes and ADB only on Turbo */
 	Configuration_CheckPeripheralSettings();
 
+	/* Fast forward mode only runs on cycle time */
+	if (ConfigureParams.System.bFastForward) {
+		ConfigureParams.System.bRealtime = false;
+	}
+	if (ConfigureParams.System.nMaxSpeed < 100) {
+		ConfigureParams.System.nMaxSpeed = 100;
+	}
+	if (ConfigureParams.Screen.nFrameSkips < 0) {
+		ConfigureParams.Screen.nFrameSkips = 0;
+	}
+	if (ConfigureParams.Screen.nFrameRateCap < 0) {
+		ConfigureParams.Screen.nFrameRateCap = 0;
+	}
+	if (ConfigureParams.Screen.nPrescale < 1) {
+		ConfigureParams.Screen.nPrescale = 1;
+	}
+	if (ConfigureParams.Screen.nPrescale > 4) {
+		ConfigureParams.Screen.nPrescale = 4;
+	}
+
+	if (ConfigureParams.System.nDiskCacheSize < 0) {
+		ConfigureParams.System.nDiskCacheSize = 0;
+	}
+	if (ConfigureParams.System.nDiskCacheSize > 1024) {
+		ConfigureParams.System.nDiskCacheSize = 1024;
+	}
+
+	/* Co-processor threads need some room to run ahead */
+	if (ConfigureParams.System.nThreadSkew < 100) {
+		ConfigureParams.System.nThreadSkew = 100;
+	}
+
 	/* Make sure we start with statusbar enabled (required for proper screen init) */
 	ConfigureParams.Screen.bShowStatusbar = true;
 
@@ -604,8 +771,13 @@ void Configuration_Apply(bool bReset)
 
 	for (i = 0; i < ESP_MAX_DEVS; i++) {
 		File_MakeAbsoluteName(ConfigureParams.SCSI.target[i].szImageName);
+		if (ConfigureParams.SCSI.target[i].szOverlayName[0]) {
+			File_MakeAbsoluteName(ConfigureParams.SCSI.target[i].szOverlayName);
+		}
 	}
 
+	File_MakeAbsoluteName(ConfigureParams.NBDisk.szImageName);
+
 	for (i = 0; i < MO_MAX_DRIVES; i++) {
 		File_MakeAbsoluteName(ConfigureParams.MO.drive[i].szImageName);
 	}
@@ -841,9 +1013,19 @@ void Configuration_CheckEthernetSettings(void) {
 	if (ConfigureParams.System.nMachineType == NEXT_CUBE030) {
 		ConfigureParams.Ethernet.bTwistedPair = false;
 	}
-	if (ConfigureParams.Ethernet.nHostInterface == ENET_PCAP) {
+#if !HAVE_LINUX_IF_TUN_H
+	if (ConfigureParams.Ethernet.nHostInterface == ENET_TAP) {
+		ConfigureParams.Ethernet.nHostInterface = ENET_SLIRP;
+	}
+#endif
+	if (ConfigureParams.Ethernet.nHostInterface != ENET_SLIRP) {
 		ConfigureParams.Ethernet.bNetworkTime = false;
 	}
+	if (ConfigureParams.Ethernet.nSlirpBufferSize < 8) {
+		ConfigureParams.Ethernet.nSlirpBufferSize = 8;
+	} else if (ConfigureParams.Ethernet.nSlirpBufferSize > 1024) {
+		ConfigureParams.Ethernet.nSlirpBufferSize = 1024;
+	}
 }
 
 void Configuration_CheckPeripheralSettings(void) {
@@ -851,33 +1033,69 @@ void Configuration_CheckPeripheralSettings(void) {
 		ConfigureParams.System.bADB = false;
 	}
 	if (ConfigureParams.System.nMachineType == NEXT_STATION) {
+		ConfigureParams.NBDisk.bEnabled = false;
+		ConfigureParams.NBNet.bEnabled = false;
 		ConfigureParams.System.bNBIC = false;
 	}
+	if (ConfigureParams.NBDisk.nSlot != 2 && ConfigureParams.NBDisk.nSlot != 4) {
+		ConfigureParams.NBDisk.nSlot = 6;
+	}
+	if (ConfigureParams.NBNet.nSlot != 2 && ConfigureParams.NBNet.nSlot != 6) {
+		ConfigureParams.NBNet.nSlot = 4;
+	}
+	if ((int)ConfigureParams.Serial.nHost < SERIAL_NONE || ConfigureParams.Serial.nHost > SERIAL_TCP) {
+		ConfigureParams.Serial.nHost = SERIAL_NONE;
+	}
+	ConfigureParams.Serial.nChannel &= 1;
+	if (ConfigureParams.Printer.nOutputFormat != PRINT_PDF) {
+		ConfigureParams.Printer.nOutputFormat = PRINT_PNG;
+	}
+	if (ConfigureParams.Printer.nCompression < 0 || ConfigureParams.Printer.nCompression > 9) {
+		ConfigureParams.Printer.nCompression = 6;
+	}
+	if ((int)ConfigureParams.Printer.nPngFilter < IMG_FILTER_NONE || ConfigureParams.Printer.nPngFilter > IMG_FILTER_ADAPTIVE) {
+		ConfigureParams.Printer.nPngFilter = IMG_FILTER_ADAPTIVE;
+	}
+	if (ConfigureParams.NBDisk.bEnabled || ConfigureParams.NBNet.bEnabled) {
+		ConfigureParams.System.bNBIC = true;
+	}
 }
 
 
-/*-----------------------------------------------------------------------*/
-/**
- * Load a settings section from the configuration file.
- */
-static int Configuration_LoadSection(const char *pFilename, const struct Config_Tag configs[], const char *pSection)
+/* Sections of the configuration file, in the order they are saved */
+static const struct Config_Section configs_Sections[] =
 {
-	int ret;
-
-	ret = input_config(pFilename, configs, pSection);
-
-	if (ret < 0)
-		Log_Printf(LOG_ERROR, "cannot load configuration file %s (section %s).\n",
-		        pFilename, pSection);
-
-	return ret;
-}
+	{ "[Log]", configs_Log },
+	{ "[ConfigDialog]", configs_ConfigDialog },
+	{ "[Debugger]", configs_Debugger },
+	{ "[Screen]", configs_Screen },
+	{ "[Keyboard]", configs_Keyboard },
+	{ "[ShortcutsWithModifiers]", configs_ShortCutWithMod },
+	{ "[ShortcutsWithoutModifiers]", configs_ShortCutWithoutMod },
+	{ "[Mouse]", configs_Mouse },
+	{ "[Sound]", configs_Sound },
+	{ "[Memory]", configs_Memory },
+	{ "[Boot]", configs_Boot },
+	{ "[HardDisk]", configs_SCSI },
+	{ "[MagnetoOptical]", configs_MO },
+	{ "[Floppy]", configs_Floppy },
+	{ "[Ethernet]", configs_Ethernet },
+	{ "[ROM]", configs_Rom },
+	{ "[Printer]", configs_Printer },
+	{ "[Serial]", configs_Serial },
+	{ "[System]", configs_System },
+	{ "[Dimension]", configs_Dimension },
+	{ "[NeXTbusDisk]", configs_NBDisk },
+	{ "[NeXTbusNet]", configs_NBNet },
+	{ NULL, NULL }
+};
 
 
 /*-----------------------------------------------------------------------*/
 /**
  * Load program setting from configuration file. If psFileName is NULL, use
  * the configuration file given in configuration / last selected by user.
+ * All sections are read in a single pass over the file.
  */
 void Configuration_Load(const char *psFileName)
 {
@@ -890,25 +1108,46 @@ void Configuration_Load(const char *psFileName)
 		return;
 	}
 
-	Configuration_LoadSection(psFileName, configs_Log, "[Log]");
-	Configuration_LoadSection(psFileName, configs_ConfigDialog, "[ConfigDialog]");
-	Configuration_LoadSection(psFileName, configs_Debugger, "[Debugger]");
-	Configuration_LoadSection(psFileName, configs_Screen, "[Screen]");
-	Configuration_LoadSection(psFileName, configs_Keyboard, "[Keyboard]");
-	Configuration_LoadSection(psFileName, configs_ShortCutWithMod, "[ShortcutsWithModifiers]");
-	Configuration_LoadSection(psFileName, configs_ShortCutWithoutMod, "[ShortcutsWithoutModifiers]");
-	Configuration_LoadSection(psFileName, configs_Mouse, "[Mouse]");
-	Configuration_LoadSection(psFileName, configs_Sound, "[Sound]");
-	Configuration_LoadSection(psFileName, configs_Memory, "[Memory]");
-	Configuration_LoadSection(psFileName, configs_Boot, "[Boot]");
-	Configuration_LoadSection(psFileName, configs_SCSI, "[HardDisk]");
-	Configuration_LoadSection(psFileName, configs_MO, "[MagnetoOptical]");
-	Configuration_LoadSection(psFileName, configs_Floppy, "[Floppy]");
-	Configuration_LoadSection(psFileName, configs_Ethernet, "[Ethernet]");
-	Configuration_LoadSection(psFileName, configs_Rom, "[ROM]");
-	Configuration_LoadSection(psFileName, configs_Printer, "[Printer]");
-	Configuration_LoadSection(psFileName, configs_System, "[System]");
-	Configuration_LoadSection(psFileName, configs_Dimension, "[Dimension]");
+	if (input_config_sections(psFileName, configs_Sections) < 0)
+		Log_Printf(LOG_ERROR, "cannot load configuration file %s.\n", psFileName);
+}
+
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Set a single option given as "Section.key=value", i.e. from the command
+ * line. The section name is the one used in the configuration file.
+ * Returns false if the option is unknown or the value is invalid.
+ */
+bool Configuration_SetOption(const char *option)
+{
+	const struct Config_Section *section;
+	const char *dot, *eq;
+	char key[64];
+	size_t len;
+
+	dot = strchr(option, '.');
+	eq  = strchr(option, '=');
+	if (dot == NULL || eq == NULL || eq < dot)
+		return false;
+
+	len = dot - option;
+	for (section = configs_Sections; section->header; ++section)
+	{
+		if (strlen(section->header) == len + 2 &&
+		    !strncmp(section->header + 1, option, len))
+			break;
+	}
+	if (section->header == NULL)
+		return false;
+
+	len = eq - dot - 1;
+	if (len >= sizeof(key))
+		return false;
+	memcpy(key, dot + 1, len);
+	key[len] = '\0';
+
+	return set_config_option(section->configs, key, eq + 1) == 0;
 }
 
 
@@ -957,6 +1196,9 @@ void Configuration_Save(void)
 	Configuration_SaveSection(sConfigFileName, configs_Ethernet, "[Ethernet]");
 	Configuration_SaveSection(sConfigFileName, configs_Rom, "[ROM]");
 	Configuration_SaveSection(sConfigFileName, configs_Printer, "[Printer]");
+	Configuration_SaveSection(sConfigFileName, configs_Serial, "[Serial]");
 	Configuration_SaveSection(sConfigFileName, configs_System, "[System]");
 	Configuration_SaveSection(sConfigFileName, configs_Dimension, "[Dimension]");
+	Configuration_SaveSection(sConfigFileName, configs_NBDisk, "[NeXTbusDisk]");
+	Configuration_SaveSection(sConfigFileName, configs_NBNet, "[NeXTbusNet]");
 }
@@ -0,0 +1,244 @@
+/*
+  Previous - coproc.c
+
+  This file is distributed under the GNU General Public License, version 2
+  or at your option any later version. Read the file gpl.txt for details.
+
+  Support for co-processors that run on their own host thread. The m68k
+  thread talks to a co-processor through a message port (a set of bits
+  that are collected by the co-processor thread) and hands it cycles to
+  run. The co-processor thread consumes these cycles and sleeps once they
+  are used up. If the co-processor falls behind by more than its maximum
+  skew the m68k thread waits for it, which keeps both sides within a
+  bounded distance of each other.
+
+  A co-processor that runs out of cycles first polls for new work for a
+  while, because the m68k thread usually grants more within microseconds.
+  The length of that spin phase adapts to how often it pays off. Only then
+  the thread is parked on a semaphore, which every message and grant
+  posts to, so wakeups do not depend on a timeout.
+*/
+const char CoProc_fileid[] = "Previous coproc.c";
+
+#include "main.h"
+#include "host.h"
+#include "coproc.h"
+
+#define COPROC_SPIN_MIN     16
+#define COPROC_SPIN_MAX     8192
+
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Initialise the message port. A co-processor can use its port without
+ * ever starting a thread.
+ */
+void CoProc_Init(COPROC* cp)
+{
+	cp->thread  = NULL;
+	cp->wake    = NULL;
+	cp->drained = NULL;
+	cp->maxSkew = 0;
+	cp->spin    = COPROC_SPIN_MIN;
+	cp->stalls  = 0;
+	host_atomic_set(&cp->port, 0);
+	host_atomic_set(&cp->credit, 0);
+	host_atomic_set(&cp->idle, 0);
+	host_atomic_set(&cp->stalled, 0);
+}
+
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Start the co-processor thread. The m68k thread is blocked as soon as
+ * more than maxSkew cycles are waiting to be run.
+ */
+void CoProc_Start(COPROC* cp, thread_func_t func, const char* name, void* data, int maxSkew)
+{
+	host_atomic_set(&cp->credit, 0);
+	cp->maxSkew = maxSkew;
+	cp->wake    = SDL_CreateSemaphore(0);
+	cp->drained = SDL_CreateSemaphore(0);
+	cp->thread  = host_thread_create(func, name, data);
+}
+
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Send killMsg to the co-processor thread and wait until it has ended.
+ */
+void CoProc_Stop(COPROC* cp, int killMsg)
+{
+	if (cp->thread) {
+		CoProc_Send(cp, killMsg, 0);
+		host_thread_wait(cp->thread);
+		cp->thread = NULL;
+	}
+	if (cp->wake) {
+		SDL_DestroySemaphore(cp->wake);
+		cp->wake = NULL;
+	}
+	if (cp->drained) {
+		SDL_DestroySemaphore(cp->drained);
+		cp->drained = NULL;
+	}
+	host_atomic_set(&cp->credit, 0);
+}
+
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Post a message. The bits in set are added to the port, the bits in
+ * clear are removed. This allows messages to cancel each other.
+ */
+void CoProc_Send(COPROC* cp, int set, int clear)
+{
+	int old_value, new_value;
+	do {
+		old_value = host_atomic_get(&cp->port);
+		new_value = (old_value & ~clear) | set;
+	} while (!host_atomic_cas(&cp->port, old_value, new_value));
+
+	if (cp->wake && host_atomic_get(&cp->idle)) {
+		SDL_SemPost(cp->wake);
+	}
+}
+
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Fetch and clear all pending messages. Called by the co-processor.
+ * The port is read first, so polling an empty port needs no locked
+ * read-modify-write.
+ */
+int CoProc_Receive(COPROC* cp)
+{
+	if (!host_atomic_get(&cp->port)) {
+		return 0;
+	}
+	return host_atomic_set(&cp->port, 0);
+}
+
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Give the co-processor cycles to run. Called by the m68k thread. Waits
+ * until the co-processor has caught up if it lags too far behind.
+ */
+void CoProc_Grant(COPROC* cp, int cycles)
+{
+	int credit;
+
+	if (!cp->thread) {
+		return;
+	}
+
+	credit = host_atomic_add(&cp->credit, cycles) + cycles;
+	if (host_atomic_get(&cp->idle)) {
+		SDL_SemPost(cp->wake);
+	}
+
+	if (credit > cp->maxSkew) {
+		cp->stalls++;
+		host_atomic_set(&cp->stalled, 1);
+		while (host_atomic_get(&cp->credit) > cp->maxSkew && !bQuitProgram) {
+			SDL_SemWaitTimeout(cp->drained, 1);
+		}
+		host_atomic_set(&cp->stalled, 0);
+	}
+}
+
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Return the number of cycles the co-processor may run.
+ */
+int CoProc_Credit(COPROC* cp)
+{
+	return host_atomic_get(&cp->credit);
+}
+
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Account for cycles that the co-processor has run.
+ */
+void CoProc_Take(COPROC* cp, int cycles)
+{
+	int credit = host_atomic_add(&cp->credit, -cycles) - cycles;
+
+	if (credit <= cp->maxSkew && host_atomic_get(&cp->stalled)) {
+		SDL_SemPost(cp->drained);
+	}
+}
+
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Drop all cycles that are waiting to be run, for example while the
+ * co-processor is halted.
+ */
+void CoProc_Discard(COPROC* cp)
+{
+	host_atomic_set(&cp->credit, 0);
+
+	if (host_atomic_get(&cp->stalled)) {
+		SDL_SemPost(cp->drained);
+	}
+}
+
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Return true if the co-processor has messages or cycles to run.
+ */
+static inline bool coproc_has_work(COPROC* cp)
+{
+	return host_atomic_get(&cp->port) || host_atomic_get(&cp->credit) > 0;
+}
+
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Wait until there are messages or cycles to run, at most ms milli
+ * seconds. Called by the co-processor thread when it is out of cycles.
+ * Spins before parking the thread, the spin length is doubled when work
+ * arrives during the spin phase and halved when the thread had to sleep.
+ */
+void CoProc_Wait(COPROC* cp, uint32_t ms)
+{
+	int i;
+
+	for (i = cp->spin; i > 0; i--) {
+		if (coproc_has_work(cp)) {
+			if (cp->spin < COPROC_SPIN_MAX) {
+				cp->spin *= 2;
+			}
+			return;
+		}
+	}
+	if (cp->spin > COPROC_SPIN_MIN) {
+		cp->spin /= 2;
+	}
+
+	host_atomic_set(&cp->idle, 1);
+	if (!coproc_has_work(cp)) {
+		SDL_SemWaitTimeout(cp->wake, ms);
+	}
+	host_atomic_set(&cp->idle, 0);
+}
+
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Park the co-processor thread until a message arrives. Called while the
+ * co-processor is halted, when no cycles will be granted.
+ */
+void CoProc_Idle(COPROC* cp)
+{
+	host_atomic_set(&cp->idle, 1);
+	if (!host_atomic_get(&cp->port)) {
+		SDL_SemWait(cp->wake);
+	}
+	host_atomic_set(&cp->idle, 0);
+}
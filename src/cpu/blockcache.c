@@ -0,0 +1,566 @@
+/*
+  Previous - blockcache.c
+
+  This file is distributed under the GNU General Public License, version 2
+  or at your option any later version. Read the file gpl.txt for details.
+
+  Translation cache for the 68030/68040 interpreter loops. Code pages are
+  kept as blocks keyed by their host (physical) page. Each block holds the
+  opcode handlers of the instructions that have been executed from it,
+  so the main loop can dispatch straight from the block (threaded code).
+  A small direct mapped table translates logical code pages to blocks,
+  which lets opcode fetches skip the ATC search and the memory bank
+  indirection. Blocks are invalidated word by word when a write lands in
+  a translated page, the translation table is flushed whenever the MMU
+  mapping changes.
+
+  The same page flags also mark the pages holding the MMU descriptors of
+  the 68040 walk cache, a write to one of them drops that cache.
+
+  Every main memory page also has a write generation. It is bumped by a
+  write to a page that holds translated code or that has been watched by
+  another cache of decoded code since the last bump. Such a cache keeps
+  the generation it has seen and compares it before it uses its entries,
+  so it needs no invalidation hook of its own. CPU stores, DMA and writes
+  by NeXTbus masters all go through blockcache_check_write.
+
+  Optionally the handlers of copy and fill loops are replaced when they
+  are entered into a block. A one word move or clr with postincrement
+  addressing followed by "dbf Dn,loop" is the inner loop of most bcopy,
+  bzero and memcpy routines in the ROM, the kernel and libc. On the 68040
+  such a loop is run on host memory for all iterations that stay within
+  the current page of source and destination, if both pages are in the
+  host TLB. The TLB only has entries for pages that have passed the MMU
+  checks and are not watched by the debugger, every other case takes the
+  normal path for one iteration.
+*/
+const char BlockCache_fileid[] = "Previous blockcache.c";
+
+#include "sysconfig.h"
+#include "sysdeps.h"
+#include "main.h"
+#include "options_cpu.h"
+#include "memory.h"
+#include "newcpu.h"
+#include "cpummu.h"
+#include "cpummu030.h"
+#include "maccess.h"
+#include "blockcache.h"
+#include "hosttlb.h"
+
+
+#define BLOCKCACHE_BLOCKS       512
+#define BLOCKCACHE_TABLE_PAGES  256
+#define BLOCKCACHE_TAG_INVALID  0xffffffff
+
+#define BC_LOOP_DBF             0x51c8  /* dbf Dn */
+#define BC_LOOP_DISP            0xfffc  /* back to the word before the dbf */
+#define BC_LOOP_CYCLES          (8 * CYCLE_UNIT / 2) /* per iteration */
+
+bool blockcache_enabled = false;
+static bool blockcache_loops = false;
+uae_u8 blockcache_ram_page[BLOCKCACHE_RAM_PAGES + 1];
+uae_u32 blockcache_page_gen[BLOCKCACHE_RAM_PAGES + 1];
+BC_XLATE blockcache_xlate[BLOCKCACHE_XLATE];
+
+static BC_BLOCK *bc_block;
+
+static uae_u8 *bc_ram;
+static uae_u32 bc_ram_size;
+
+static uae_u32 bc_table_page[BLOCKCACHE_TABLE_PAGES];
+static int bc_table_pages;
+
+
+static inline BC_BLOCK *blockcache_block(uae_u8 *host)
+{
+	return &bc_block[((uintptr_t)host >> BLOCKCACHE_PAGE_SHIFT) & (BLOCKCACHE_BLOCKS - 1)];
+}
+
+static inline bool blockcache_is_ram(uae_u8 *host)
+{
+	return host >= bc_ram && host < bc_ram + bc_ram_size;
+}
+
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Forget all logical to block translations. Called whenever the MMU
+ * mapping may have changed.
+ */
+void blockcache_flush_translations(void)
+{
+	int i;
+
+	for (i = 0; i < BLOCKCACHE_XLATE; i++) {
+		blockcache_xlate[i].tag = BLOCKCACHE_TAG_INVALID;
+	}
+}
+
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Drop all blocks and translations.
+ */
+void blockcache_flush(void)
+{
+	int i;
+
+	blockcache_flush_translations();
+
+	if (bc_block) {
+		for (i = 0; i < BLOCKCACHE_BLOCKS; i++) {
+			if (bc_block[i].host && blockcache_is_ram(bc_block[i].host)) {
+				blockcache_ram_page[(bc_block[i].host - bc_ram) >> BLOCKCACHE_PAGE_SHIFT] &= ~BC_PAGE_CODE;
+			}
+			bc_block[i].host = NULL;
+		}
+	}
+}
+
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Drop blocks and translations of pages in banks that are about to be
+ * remapped.
+ */
+static void blockcache_unmap(int first, int count)
+{
+	uae_u8 *base;
+	int bnr, i;
+
+	for (bnr = first; bnr < first + count; bnr++) {
+		base = bank_host[bnr];
+		if (!base) {
+			continue;
+		}
+		for (i = 0; i < BLOCKCACHE_XLATE; i++) {
+			if (blockcache_xlate[i].host >= base && blockcache_xlate[i].host < base + 0x10000) {
+				blockcache_xlate[i].tag = BLOCKCACHE_TAG_INVALID;
+			}
+		}
+		if (!bc_block) {
+			continue;
+		}
+		for (i = 0; i < BLOCKCACHE_BLOCKS; i++) {
+			if (bc_block[i].host >= base && bc_block[i].host < base + 0x10000) {
+				if (blockcache_is_ram(bc_block[i].host)) {
+					blockcache_ram_page[(bc_block[i].host - bc_ram) >> BLOCKCACHE_PAGE_SHIFT] &= ~BC_PAGE_CODE;
+				}
+				bc_block[i].host = NULL;
+			}
+		}
+	}
+}
+
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Tell the block cache where main memory lives. Called from memory_init
+ * after (re-)allocating main memory.
+ */
+void blockcache_init(uae_u8 *ram, uae_u32 size)
+{
+	int i;
+
+	bc_ram = ram;
+	bc_ram_size = size;
+	bc_table_pages = 0;
+	memset(blockcache_ram_page, 0, sizeof(blockcache_ram_page));
+	/* Watches are gone, make all pages look written */
+	for (i = 0; i <= BLOCKCACHE_RAM_PAGES; i++) {
+		blockcache_page_gen[i]++;
+	}
+	blockcache_flush();
+	memory_add_map_listener(blockcache_unmap);
+}
+
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Switch the block cache on or off.
+ */
+void blockcache_enable(bool enable)
+{
+	if (enable && !bc_block) {
+		bc_block = malloc(BLOCKCACHE_BLOCKS * sizeof(BC_BLOCK));
+		if (!bc_block) {
+			write_log("Block cache: Cannot allocate memory\n");
+			enable = false;
+		}
+	} else if (!enable && bc_block) {
+		free(bc_block);
+		bc_block = NULL;
+	}
+	blockcache_flush();
+
+	if (enable != blockcache_enabled) {
+		write_log("Block cache %s\n", enable ? "enabled" : "disabled");
+	}
+	blockcache_enabled = enable;
+}
+
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Switch the copy and fill loop handlers on or off.
+ */
+void blockcache_enable_loops(bool enable)
+{
+	if (enable != blockcache_loops) {
+		write_log("Block cache loop acceleration %s\n", enable ? "enabled" : "disabled");
+		blockcache_loops = enable;
+		blockcache_flush();
+	}
+}
+
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Invalidate the handlers of all instruction words touched by a write
+ * to main memory and bump the generation of the pages holding code.
+ */
+void blockcache_invalidate_ram(uae_u32 offset, int size)
+{
+	uae_u32 o, end, last = offset + size - 1;
+	uae_u32 page;
+	uae_u8 flags, *host;
+	bool table = false;
+	BC_BLOCK *b;
+
+	for (page = offset >> BLOCKCACHE_PAGE_SHIFT; page <= last >> BLOCKCACHE_PAGE_SHIFT; page++) {
+		flags = blockcache_ram_page[page];
+		if (!flags) {
+			continue;
+		}
+		table |= flags & BC_PAGE_TABLE;
+		if (!(flags & (BC_PAGE_CODE | BC_PAGE_WATCH))) {
+			continue;
+		}
+		blockcache_page_gen[page]++;
+		blockcache_ram_page[page] &= ~BC_PAGE_WATCH;
+		if (!(flags & BC_PAGE_CODE)) {
+			continue;
+		}
+		host = bc_ram + (page << BLOCKCACHE_PAGE_SHIFT);
+		b = blockcache_block(host);
+		if (b->host != host) {
+			continue;
+		}
+		o   = (page << BLOCKCACHE_PAGE_SHIFT) > offset ? (page << BLOCKCACHE_PAGE_SHIFT) : (offset & ~1);
+		end = (page << BLOCKCACHE_PAGE_SHIFT) + BLOCKCACHE_PAGE_MASK;
+		if (end > last) {
+			end = last;
+		}
+		for (; o <= end; o += 2) {
+			b->func[(o & BLOCKCACHE_PAGE_MASK) >> 1] = NULL;
+		}
+	}
+	if (table) {
+		mmu_walk_table_written();
+	}
+}
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Return the write generation of the main memory page at offset and
+ * watch the page until the next write to it. Called by caches of decoded
+ * code when they fill or revalidate entries of that page.
+ */
+uae_u32 blockcache_watch_code(uae_u32 offset)
+{
+	uae_u32 page = offset >> BLOCKCACHE_PAGE_SHIFT;
+
+	blockcache_ram_page[page] |= BC_PAGE_WATCH;
+	return blockcache_page_gen[page];
+}
+
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Mark the page of an MMU descriptor at phys, so that writes to it are
+ * reported to the walk cache. Returns false if the descriptor is not in
+ * main memory or too many pages are marked.
+ */
+bool blockcache_watch_table(uaecptr phys)
+{
+	uae_u8 *host;
+	uae_u32 page;
+
+	if (!bank_host[bankindex(phys)]) {
+		return false;
+	}
+	host = get_host_address(phys);
+	if (!blockcache_is_ram(host)) {
+		return false;
+	}
+	page = (host - bc_ram) >> BLOCKCACHE_PAGE_SHIFT;
+	if (!(blockcache_ram_page[page] & BC_PAGE_TABLE)) {
+		if (bc_table_pages == BLOCKCACHE_TABLE_PAGES) {
+			return false;
+		}
+		bc_table_page[bc_table_pages++] = page;
+		blockcache_ram_page[page] |= BC_PAGE_TABLE;
+	}
+	return true;
+}
+
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Remove the marks of all descriptor pages.
+ */
+void blockcache_unwatch_tables(void)
+{
+	int i;
+
+	for (i = 0; i < bc_table_pages; i++) {
+		blockcache_ram_page[bc_table_page[i]] &= ~BC_PAGE_TABLE;
+	}
+	bc_table_pages = 0;
+}
+
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Translate an instruction address without side effects beyond those of
+ * the instruction fetch that has just been done for the same address.
+ */
+static uaecptr blockcache_translate(uaecptr pc)
+{
+	if (currprefs.mmu_model == 68030) {
+		return mmu030_translate(pc, regs.s != 0, false, false);
+	}
+	if ((!mmu_ttr_enabled_ins || mmu_match_ttr_ins(pc, regs.s != 0) == TTR_NO_MATCH) && regs.mmu_enabled) {
+		return mmu_translate(pc, 0, regs.s != 0, false, false, sz_word);
+	}
+	return pc;
+}
+
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Set up a translation from the logical page of pc to a block. Returns
+ * false if the page can not be cached (I/O space or MMU pages smaller
+ * than the block cache page size).
+ */
+static bool blockcache_map(uaecptr pc, uae_u32 fc, BC_XLATE *x)
+{
+	uaecptr phys;
+	uae_u8 *host;
+	BC_BLOCK *b;
+
+	if (regs.mmu_page_size && regs.mmu_page_size < BLOCKCACHE_PAGE_SIZE) {
+		return false;
+	}
+
+	phys = blockcache_translate(pc) & ~BLOCKCACHE_PAGE_MASK;
+	if (!bank_host[bankindex(phys)]) {
+		return false;
+	}
+	host = get_host_address(phys);
+
+	b = blockcache_block(host);
+	if (b->host != host) {
+		if (b->host && blockcache_is_ram(b->host)) {
+			blockcache_ram_page[(b->host - bc_ram) >> BLOCKCACHE_PAGE_SHIFT] &= ~BC_PAGE_CODE;
+		}
+		memset(b->func, 0, sizeof(b->func));
+		b->host = host;
+		if (blockcache_is_ram(host)) {
+			blockcache_ram_page[(host - bc_ram) >> BLOCKCACHE_PAGE_SHIFT] |= BC_PAGE_CODE;
+		}
+	}
+
+	x->tag = (pc & ~BLOCKCACHE_PAGE_MASK) | fc;
+	x->host = host;
+	x->block = b;
+	return true;
+}
+
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Return the operand size of a loop body instruction, 0 if opcode is not
+ * move (Ay)+,(Ax)+, move Dy,(Ax)+ or clr (Ax)+. A7 is left out, because
+ * it is incremented by two for bytes.
+ */
+static int blockcache_loop_size(uae_u32 opcode)
+{
+	int size = 0;
+
+	if ((opcode & 0xc1f8) == 0x00d8 || (opcode & 0xc1f8) == 0x00c0) {
+		switch (opcode & 0x3000) {
+			case 0x1000: size = 1; break;
+			case 0x3000: size = 2; break;
+			case 0x2000: size = 4; break;
+			default: return 0;
+		}
+		if ((opcode & 0x0e00) == 0x0e00 || (opcode & 0x003f) == 0x001f) {
+			return 0;
+		}
+	} else if ((opcode & 0xff38) == 0x4218) {
+		switch (opcode & 0x00c0) {
+			case 0x0000: size = 1; break;
+			case 0x0040: size = 2; break;
+			case 0x0080: size = 4; break;
+			default: return 0;
+		}
+		if ((opcode & 7) == 7) {
+			return 0;
+		}
+	}
+	return size;
+}
+
+/**
+ * Handler for a loop body instruction that was followed by a dbf when it
+ * was entered into the block. Runs as many iterations as possible on host
+ * memory, falls back to the normal handler if the loop has changed or a
+ * page is not in the host TLB.
+ */
+static uae_u32 REGPARAM2 blockcache_loop(uae_u32 opcode)
+{
+	uaecptr pc = regs.instruction_pc;
+	uae_u8 *code = blockcache_get_code(pc + 2, 4);
+	int size = blockcache_loop_size(opcode);
+	bool clr = (opcode & 0xf000) == 0x4000;
+	bool copy = !clr && (opcode & 0x0038);
+	int dst = clr ? (opcode & 7) : ((opcode >> 9) & 7);
+	int src = opcode & 7;
+	int cnt, i;
+	uae_u32 fc = regs.s ? 5 : 1;
+	uae_u32 n, k, bytes, val, last;
+	uaecptr daddr, saddr = 0;
+	HOSTTLB_ENTRY *we, *re = NULL;
+	uae_u8 *d, *s = NULL;
+
+	if (!code || !hosttlb_enabled || regs.t1 || regs.t0 || regs.spcflags ||
+	    (do_get_mem_word(code) & 0xfff8) != BC_LOOP_DBF || do_get_mem_word(code + 2) != BC_LOOP_DISP) {
+		return (*cpufunctbl[opcode])(opcode);
+	}
+	cnt = do_get_mem_word(code) & 7;
+	if ((copy && src == dst) || (!copy && !clr && src == cnt)) {
+		return (*cpufunctbl[opcode])(opcode);
+	}
+
+	/* Iterations left in this page */
+	n = (m68k_dreg(regs, cnt) & 0xffff) + 1;
+	daddr = m68k_areg(regs, dst);
+	k = (HOSTTLB_PAGE_SIZE - (daddr & HOSTTLB_PAGE_MASK)) / size;
+	if (copy) {
+		saddr = m68k_areg(regs, src);
+		i = (HOSTTLB_PAGE_SIZE - (saddr & HOSTTLB_PAGE_MASK)) / size;
+		if (k > (uae_u32)i) {
+			k = i;
+		}
+	}
+	if (k > n) {
+		k = n;
+	}
+	bytes = k * size;
+	if (k < 2 || !(we = hosttlb_lookup(hosttlb_write, daddr, fc, bytes)) ||
+	    (copy && !(re = hosttlb_lookup(hosttlb_read, saddr, fc, bytes)) &&
+	             !(re = hosttlb_lookup(hosttlb_write, saddr, fc, bytes)))) {
+		return (*cpufunctbl[opcode])(opcode);
+	}
+
+	blockcache_check_write(we->offset + (daddr & HOSTTLB_PAGE_MASK), bytes);
+	d = we->host + (daddr & HOSTTLB_PAGE_MASK);
+
+	if (copy) {
+		s = re->host + (saddr & HOSTTLB_PAGE_MASK);
+		if (d > s && d < s + bytes) {
+			/* Overlapping forward copy repeats the first elements */
+			for (i = 0; i < (int)bytes; i++) {
+				d[i] = s[i];
+			}
+		} else {
+			memmove(d, s, bytes);
+		}
+		switch (size) {
+			case 1: last = d[bytes - 1]; break;
+			case 2: last = do_get_mem_word(d + bytes - 2); break;
+			default: last = do_get_mem_long(d + bytes - 4); break;
+		}
+		m68k_areg(regs, src) += bytes;
+	} else {
+		val = clr ? 0 : m68k_dreg(regs, src);
+		switch (size) {
+			case 1:
+				last = val & 0xff;
+				memset(d, last, bytes);
+				break;
+			case 2:
+				last = val & 0xffff;
+				for (i = 0; i < (int)bytes; i += 2) {
+					do_put_mem_word(d + i, last);
+				}
+				break;
+			default:
+				last = val;
+				for (i = 0; i < (int)bytes; i += 4) {
+					do_put_mem_long(d + i, last);
+				}
+				break;
+		}
+	}
+	m68k_areg(regs, dst) += bytes;
+	m68k_dreg(regs, cnt) = (m68k_dreg(regs, cnt) & 0xffff0000) | ((m68k_dreg(regs, cnt) - k) & 0xffff);
+
+	CLEAR_CZNV();
+	SET_ZFLG(last == 0);
+	SET_NFLG(last >> (size * 8 - 1));
+
+	/* Continue after the dbf or run the next page */
+	m68k_setpci(k == n ? pc + 6 : pc);
+	return k * BC_LOOP_CYCLES;
+}
+
+/**
+ * Handler for the instruction at offset of a block.
+ */
+static cpuop_func *blockcache_handler(uae_u8 *host, uae_u32 offset, uae_u32 opcode)
+{
+	if (blockcache_loops && currprefs.mmu_model == 68040 &&
+	    offset <= BLOCKCACHE_PAGE_SIZE - 6 && blockcache_loop_size(opcode) &&
+	    (do_get_mem_word(host + offset + 2) & 0xfff8) == BC_LOOP_DBF &&
+	    do_get_mem_word(host + offset + 4) == BC_LOOP_DISP) {
+		return blockcache_loop;
+	}
+	return cpufunctbl[opcode];
+}
+
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Fetch the opcode at pc and return its handler in func. On a miss the
+ * opcode is fetched the normal way, so access faults are taken exactly
+ * like without the cache. func is set to NULL if the page is not cached.
+ */
+uae_u32 blockcache_fetch(uaecptr pc, cpuop_func **func)
+{
+	uae_u32 fc = regs.s ? 6 : 2;
+	uae_u32 offset = pc & BLOCKCACHE_PAGE_MASK;
+	uae_u32 opcode;
+	BC_XLATE *x = &blockcache_xlate[(pc >> BLOCKCACHE_PAGE_SHIFT) & (BLOCKCACHE_XLATE - 1)];
+	cpuop_func *f;
+
+	if (unlikely(x->tag != ((pc & ~BLOCKCACHE_PAGE_MASK) | fc) ||
+	             x->block->host != x->host || (pc & 1))) {
+		opcode = x_prefetch(0);
+		if ((pc & 1) || !blockcache_map(pc, fc, x)) {
+			*func = NULL;
+			return opcode;
+		}
+	} else {
+		opcode = do_get_mem_word(x->host + offset);
+	}
+
+	f = x->block->func[offset >> 1];
+	if (unlikely(!f)) {
+		f = x->block->func[offset >> 1] = blockcache_handler(x->host, offset, opcode);
+	}
+	*func = f;
+	return opcode;
+}
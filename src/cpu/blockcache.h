@@ -0,0 +1,88 @@
+/*
+  Previous - blockcache.h
+
+  This file is distributed under the GNU General Public License, version 2
+  or at your option any later version. Read the file gpl.txt for details.
+*/
+
+#ifndef BLOCKCACHE_H
+#define BLOCKCACHE_H
+
+#include "sysdeps.h"
+#include "newcpu.h"
+
+#define BLOCKCACHE_PAGE_SHIFT   12
+#define BLOCKCACHE_PAGE_SIZE    (1 << BLOCKCACHE_PAGE_SHIFT)
+#define BLOCKCACHE_PAGE_MASK    (BLOCKCACHE_PAGE_SIZE - 1)
+
+/* Enough pages to cover the largest main memory configuration (128 MB) */
+#define BLOCKCACHE_RAM_PAGES    (0x08000000 >> BLOCKCACHE_PAGE_SHIFT)
+
+#define BLOCKCACHE_XLATE        256
+
+/* Flags in blockcache_ram_page */
+#define BC_PAGE_CODE            1   /* page has a block of translated code */
+#define BC_PAGE_TABLE           2   /* page has descriptors in the MMU walk cache */
+#define BC_PAGE_WATCH           4   /* another cache has code from the page */
+
+typedef struct {
+	uae_u8 *host;
+	cpuop_func *func[BLOCKCACHE_PAGE_SIZE / 2];
+} BC_BLOCK;
+
+typedef struct {
+	uae_u32 tag;
+	uae_u8 *host;
+	BC_BLOCK *block;
+} BC_XLATE;
+
+extern bool blockcache_enabled;
+extern BC_XLATE blockcache_xlate[BLOCKCACHE_XLATE];
+extern uae_u8 blockcache_ram_page[BLOCKCACHE_RAM_PAGES + 1];
+extern uae_u32 blockcache_page_gen[BLOCKCACHE_RAM_PAGES + 1];
+
+extern void blockcache_init(uae_u8 *ram, uae_u32 size);
+extern void blockcache_enable(bool enable);
+extern void blockcache_enable_loops(bool enable);
+extern void blockcache_flush(void);
+extern void blockcache_flush_translations(void);
+extern void blockcache_invalidate_ram(uae_u32 offset, int size);
+extern uae_u32 blockcache_watch_code(uae_u32 offset);
+extern uae_u32 blockcache_fetch(uaecptr pc, cpuop_func **func);
+extern bool blockcache_watch_table(uaecptr phys);
+extern void blockcache_unwatch_tables(void);
+
+/* Called by the main memory write functions with the offset into NEXTRam.
+ * Bulk writes may span more than two pages, these always take the slow path. */
+static inline void blockcache_check_write(uae_u32 offset, int size)
+{
+	if (unlikely(size > BLOCKCACHE_PAGE_SIZE ||
+	             (blockcache_ram_page[offset >> BLOCKCACHE_PAGE_SHIFT] |
+	              blockcache_ram_page[(offset + size - 1) >> BLOCKCACHE_PAGE_SHIFT])))
+		blockcache_invalidate_ram(offset, size);
+}
+
+/* True if the main memory page at offset has not been written since its
+ * generation gen has been returned by blockcache_watch_code */
+static inline bool blockcache_code_valid(uae_u32 offset, uae_u32 gen)
+{
+	return blockcache_page_gen[offset >> BLOCKCACHE_PAGE_SHIFT] == gen;
+}
+
+/**
+ * Return the host address of size bytes of code at addr if its page is
+ * translated, NULL otherwise. Used for the extension word fetches of the
+ * instruction handlers, which then read straight from the cached page.
+ */
+static inline uae_u8 *blockcache_get_code(uaecptr addr, int size)
+{
+	BC_XLATE *x = &blockcache_xlate[(addr >> BLOCKCACHE_PAGE_SHIFT) & (BLOCKCACHE_XLATE - 1)];
+
+	if (x->tag == ((addr & ~BLOCKCACHE_PAGE_MASK) | (regs.s ? 6 : 2)) &&
+	    x->block->host == x->host &&
+	    (addr & BLOCKCACHE_PAGE_MASK) <= (uae_u32)(BLOCKCACHE_PAGE_SIZE - size))
+		return x->host + (addr & BLOCKCACHE_PAGE_MASK);
+	return NULL;
+}
+
+#endif /* BLOCKCACHE_H */
@@ -35,6 +35,9 @@
 #include "memory.h"
 #include "newcpu.h"
 #include "cpummu.h"
+#include "blockcache.h"
+#include "hosttlb.h"
+#include "host.h"
 #include "debug.h"
 #include "log.h"
 
@@ -82,6 +85,55 @@ struct mmufastcache atc_data_cache_read[MMUFASTCACHE_ENTRIES];
 struct mmufastcache atc_data_cache_write[MMUFASTCACHE_ENTRIES];
 #endif
 
+#ifdef WINUAE_FOR_PREVIOUS
+/* Walk cache: results of 68040 table searches, tagged with the root
+ * pointer that was used. Unlike the ATC they are kept across PFLUSH, so
+ * a task that runs again after a task switch finds its translations
+ * without searching the tables again. An entry is only made if all its
+ * descriptors are in main memory. Their pages are marked in the block
+ * cache and a write to any of them from outside of a table search drops
+ * the whole cache. Table searches only set U and M bits, so an entry
+ * stays valid as long as the descriptors are not written otherwise. */
+#define MMU_WALK_ENTRIES 4096
+
+struct mmu_walk_line {
+	uae_u32 root;    /* root pointer | 1, 0 if invalid */
+	uaecptr tag;
+	uae_u32 status;
+	uaecptr phys;
+};
+
+static struct mmu_walk_line mmu_walk_cache[MMU_WALK_ENTRIES];
+static bool mmu_walk_used;
+static bool mmu_walk_busy;
+
+static ALWAYS_INLINE struct mmu_walk_line *mmu_walk_line(uae_u32 root, uaecptr tag)
+{
+	return &mmu_walk_cache[((tag >> 11) ^ (tag >> 27) ^ (root >> 9)) & (MMU_WALK_ENTRIES - 1)];
+}
+
+static void mmu_walk_flush(void)
+{
+	if (mmu_walk_used) {
+		memset(mmu_walk_cache, 0, sizeof(mmu_walk_cache));
+		blockcache_unwatch_tables();
+		mmu_walk_used = false;
+	}
+}
+
+static void mmu_walk_unmap(int first, int count)
+{
+	mmu_walk_flush();
+}
+
+/* Called by the block cache on writes to marked descriptor pages */
+void mmu_walk_table_written(void)
+{
+	if (!mmu_walk_busy)
+		mmu_walk_flush();
+}
+#endif
+
 #if CACHE_HIT_COUNT
 int mmu_ins_hit, mmu_ins_miss;
 int mmu_data_read_hit, mmu_data_read_miss;
@@ -135,6 +187,10 @@ void mmu_tt_modified (void)
 	mmu_ttr_enabled_ins = ((regs.itt0 | regs.itt1) & MMU_TTR_BIT_ENABLED) != 0;
 	mmu_ttr_enabled_data = ((regs.dtt0 | regs.dtt1) & MMU_TTR_BIT_ENABLED) != 0;
 	mmu_ttr_enabled = mmu_ttr_enabled_ins || mmu_ttr_enabled_data;
+#ifdef WINUAE_FOR_PREVIOUS
+	blockcache_flush_translations();
+	hosttlb_flush();
+#endif
 }
 
 
@@ -665,6 +721,27 @@ static uae_u32 mmu_fill_atc(uaecptr addr, bool super, uae_u32 tag, bool write, s
     uae_u32 status = 0;
     int i;
 	int old_s;
+#ifdef WINUAE_FOR_PREVIOUS
+	uae_u32 root = super ? regs.srp : regs.urp;
+	struct mmu_walk_line *w = NULL;
+	uaecptr walk_addr[4];
+	int walk_num = 0;
+
+	if (hosttlb_enabled && currprefs.mmu_model == 68040) {
+		w = mmu_walk_line(root, tag);
+		// a first write has to search the tables to set the M bit
+		if (w->root == (root | 1) && w->tag == tag &&
+		    (!write || (w->status & (MMU_MMUSR_M | MMU_MMUSR_W)))) {
+			l->status = w->status;
+			l->phys = w->phys;
+			l->valid = 1;
+			l->tag = tag;
+			flush_shortcut_cache(addr, super);
+			return l->phys | l->status;
+		}
+		mmu_walk_busy = true;
+	}
+#endif
     
     // Use supervisor mode to access descriptors (really is fc = 7)
     old_s = regs.s;
@@ -679,6 +756,9 @@ static uae_u32 mmu_fill_atc(uaecptr addr, bool super, uae_u32 tag, bool write, s
     
     SAVE_EXCEPTION;
     TRY(prb) {
+#ifdef WINUAE_FOR_PREVIOUS
+        walk_addr[walk_num++] = desc_addr;
+#endif
         desc = desc_get_long(desc_addr);
         if ((desc & 2) == 0) {
 #if MMUDEBUG > 1
@@ -697,6 +777,9 @@ static uae_u32 mmu_fill_atc(uaecptr addr, bool super, uae_u32 tag, bool write, s
         /* fetch pointer table descriptor */
         i = (addr >> 16) & 0x1fc;
         desc_addr = (desc & MMU_ROOT_PTR_ADDR_MASK) | i;
+#ifdef WINUAE_FOR_PREVIOUS
+        walk_addr[walk_num++] = desc_addr;
+#endif
         desc = desc_get_long(desc_addr);
         if ((desc & 2) == 0) {
 #if MMUDEBUG > 1
@@ -719,10 +802,16 @@ static uae_u32 mmu_fill_atc(uaecptr addr, bool super, uae_u32 tag, bool write, s
             desc_addr = (desc & MMU_PTR_PAGE_ADDR_MASK_4) + i;
         }
         
+#ifdef WINUAE_FOR_PREVIOUS
+        walk_addr[walk_num++] = desc_addr;
+#endif
         desc = desc_get_long(desc_addr);
         if ((desc & 3) == 2) {
             /* indirect */
             desc_addr = desc & MMU_PAGE_INDIRECT_MASK;
+#ifdef WINUAE_FOR_PREVIOUS
+            walk_addr[walk_num++] = desc_addr;
+#endif
             desc = desc_get_long(desc_addr);
         }
         if ((desc & 1) == 1) {
@@ -776,6 +865,22 @@ fail:
 			l->valid = 1;
 			l->tag = tag;
 			status = l->phys | l->status;
+#ifdef WINUAE_FOR_PREVIOUS
+			// only resident pages are kept, the others are soon changed anyway
+			if (w && (desc & MMU_MMUSR_R)) {
+				for (i = 0; i < walk_num; i++) {
+					if (!blockcache_watch_table(walk_addr[i]))
+						break;
+				}
+				if (i == walk_num) {
+					w->root = root | 1;
+					w->tag = tag;
+					w->status = l->status;
+					w->phys = l->phys;
+					mmu_walk_used = true;
+				}
+			}
+#endif
 		}
 
 		RESTORE_EXCEPTION;
@@ -799,6 +904,9 @@ fail:
 
     // Restore original supervisor state
     regs.s = old_s;
+#ifdef WINUAE_FOR_PREVIOUS
+    mmu_walk_busy = false;
+#endif
 
 #if MMUDEBUG > 2
     write_log(_T("translate: %x,%u,%u -> %x\n"), addr, super, write, desc);
@@ -811,6 +919,10 @@ fail:
 
 static void mmu_add_cache(uaecptr addr, uaecptr phys, bool super, bool data, bool write)
 {
+#ifdef WINUAE_FOR_PREVIOUS
+	if (data)
+		hosttlb_fill(addr, phys | (addr & mmu_pagemask), super ? 5 : 1, write);
+#endif
 	if (!data) {
 #if MMU_IPAGECACHE
 		uae_u32 laddr = (addr & mmu_pagemaski) | (super ? 1 : 0);
@@ -847,6 +959,7 @@ uaecptr mmu_translate(uaecptr addr, uae_u32 val, bool super, bool data, bool wri
 	struct mmu_atc_line *l;
 	uae_u32 status060 = 0;
 	uae_u32 tag = ((super ? 0x80000000 : 0x00000000) | (addr >> 1)) & mmu_tagmask;
+	uint64_t start;
 
 	if (mmu_pagesize_8k)
 		index=(addr & 0x0001E000)>>13;
@@ -912,7 +1025,9 @@ atc_retry:
 	
 	// then initiate table search and create a new entry
 	l = &mmu_atc_array[data][index][way];
+	start = host_prof_now();
 	mmu_fill_atc(addr, super, tag, write, l, &status060);
+	host_prof_end(HOST_PROF_MMU, start);
 
 	if (status060 && currprefs.mmu_model == 68060) {
 		mmu_bus_error(addr, val, mmu_get_fc(super, data), write, size, status060, false);
@@ -1443,6 +1558,10 @@ void REGPARAM2 mmu_flush_atc(uaecptr addr, bool super, bool global)
 	}	
 	flush_shortcut_cache(addr, super);
 	mmu_flush_cache();
+#ifdef WINUAE_FOR_PREVIOUS
+	blockcache_flush_translations();
+	hosttlb_flush();
+#endif
 }
 
 void REGPARAM2 mmu_flush_atc_all(bool global)
@@ -1460,6 +1579,10 @@ void REGPARAM2 mmu_flush_atc_all(bool global)
 	}
 	flush_shortcut_cache(0xffffffff, 0);
 	mmu_flush_cache();
+#ifdef WINUAE_FOR_PREVIOUS
+	blockcache_flush_translations();
+	hosttlb_flush();
+#endif
 }
 
 void REGPARAM2 mmu_set_funcs(void)
@@ -1500,6 +1623,10 @@ void REGPARAM2 mmu_reset(void)
 {
 	mmu_flush_atc_all(true);
 	mmu_set_funcs();
+#ifdef WINUAE_FOR_PREVIOUS
+	mmu_walk_flush();
+	memory_add_map_listener(mmu_walk_unmap);
+#endif
 }
 
 uae_u16 REGPARAM2 mmu_set_tc(uae_u16 tc)
@@ -1535,6 +1662,9 @@ uae_u16 REGPARAM2 mmu_set_tc(uae_u16 tc)
 	}
 
 	mmu_flush_atc_all(true);
+#ifdef WINUAE_FOR_PREVIOUS
+	mmu_walk_flush();
+#endif
 
 	write_log(_T("%d MMU: TC=%04x enabled=%d page8k=%d PC=%08x\n"), currprefs.mmu_model, tc, regs.mmu_enabled, mmu_pagesize_8k, m68k_getpc());
 	return tc;
@@ -1743,37 +1873,13 @@ void REGPARAM2 mmu060_put_rmw_bitfield (uae_u32 dst, uae_u32 bdata[2], uae_u32 v
 
 
 #ifndef __cplusplus
-jmp_buf __exbuf;
+jmp_buf __exstack[MAX_TRY_STACK];
+int     __exdepth=0;
 int     __exvalue;
-#define MAX_TRY_STACK 256
-static int s_try_stack_size=0;
-static jmp_buf s_try_stack[MAX_TRY_STACK];
-jmp_buf* __poptry(void) {
-	if (s_try_stack_size>0) {
-		s_try_stack_size--;
-		if (s_try_stack_size == 0)
-			return NULL;
-		memcpy(&__exbuf,&s_try_stack[s_try_stack_size-1],sizeof(jmp_buf));
-		// fprintf(stderr,"pop jmpbuf=%08x\n",s_try_stack[s_try_stack_size][0]);
-		return &s_try_stack[s_try_stack_size-1];
-	}
-	else {
-		fprintf(stderr,"try stack underflow...\n");
-		// return (NULL);
-		abort();
-	}
-}
-void __pushtry(jmp_buf* j) {
-	if (s_try_stack_size<MAX_TRY_STACK) {
-		// fprintf(stderr,"push jmpbuf=%08x\n",(*j)[0]);
-		memcpy(&s_try_stack[s_try_stack_size],j,sizeof(jmp_buf));
-		s_try_stack_size++;
-	} else {
-		fprintf(stderr,"try stack overflow...\n");
-		abort();
-	}
+void __tryoverflow(void) {
+	fprintf(stderr,"try stack overflow...\n");
+	abort();
 }
-int __is_catched(void) {return (s_try_stack_size>0); }
 #endif
 
 #else
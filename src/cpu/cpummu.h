@@ -36,6 +36,8 @@
 #define CACHE_HIT_COUNT 0
 
 #include "mmu_common.h"
+#include "blockcache.h"
+#include "hosttlb.h"
 
 #ifndef FULLMMU
 #define FULLMMU
@@ -172,6 +174,7 @@ extern uae_u32 mmu_tagmask, mmu_pagemask, mmu_pagemaski;
 extern struct mmu_atc_line mmu_atc_array[ATC_TYPE][ATC_SLOTS][ATC_WAYS];
 
 extern void mmu_tt_modified(void);
+extern void mmu_walk_table_written(void);
 extern int mmu_match_ttr_ins(uaecptr addr, bool super);
 extern int mmu_match_ttr(uaecptr addr, bool super, bool data);
 extern void mmu_bus_error_ttr_write_fault(uaecptr addr, bool super, bool data, uae_u32 val, int size);
@@ -688,6 +691,13 @@ static ALWAYS_INLINE uae_u16 uae_mmu040_getc_iword(uaecptr addr)
 
 static ALWAYS_INLINE uae_u16 uae_mmu040_get_iword(uaecptr addr)
 {
+#ifdef WINUAE_FOR_PREVIOUS
+	if (blockcache_enabled) {
+		uae_u8 *p = blockcache_get_code(addr, 2);
+		if (p)
+			return do_get_mem_word(p);
+	}
+#endif
 #if MMU_ICACHE
 	return uae_mmu040_getc_iword(addr);
 #else
@@ -696,6 +706,13 @@ static ALWAYS_INLINE uae_u16 uae_mmu040_get_iword(uaecptr addr)
 }
 static ALWAYS_INLINE uae_u32 uae_mmu040_get_ilong(uaecptr addr)
 {
+#ifdef WINUAE_FOR_PREVIOUS
+	if (blockcache_enabled) {
+		uae_u8 *p = blockcache_get_code(addr, 4);
+		if (p)
+			return do_get_mem_long(p);
+	}
+#endif
 #if MMU_ICACHE
 	uae_u32 result = uae_mmu040_getc_iword(addr);
 	result <<= 16;
@@ -718,23 +735,43 @@ static ALWAYS_INLINE uae_u16 uae_mmu040_get_ibyte(uaecptr addr)
 }
 static ALWAYS_INLINE uae_u32 uae_mmu040_get_long(uaecptr addr)
 {
+#ifdef WINUAE_FOR_PREVIOUS
+	uae_u32 v;
+	if (hosttlb_get(addr, regs.s ? 5 : 1, 4, &v))
+		return v;
+#endif
 	if (unlikely(is_unaligned_page(addr, 4)))
 		return mmu_get_long_unaligned(addr, true);
 	return mmu_get_long(addr, true, sz_long);
 }
 static ALWAYS_INLINE uae_u16 uae_mmu040_get_word(uaecptr addr)
 {
+#ifdef WINUAE_FOR_PREVIOUS
+	uae_u32 v;
+	if (hosttlb_get(addr, regs.s ? 5 : 1, 2, &v))
+		return v;
+#endif
 	if (unlikely(is_unaligned_page(addr, 2)))
 		return mmu_get_word_unaligned(addr, true);
 	return mmu_get_word(addr, true, sz_word);
 }
 static ALWAYS_INLINE uae_u8 uae_mmu040_get_byte(uaecptr addr)
 {
+#ifdef WINUAE_FOR_PREVIOUS
+	uae_u32 v;
+	if (hosttlb_get(addr, regs.s ? 5 : 1, 1, &v))
+		return v;
+#endif
 	return mmu_get_byte(addr, true, sz_byte);
 }
 
 static ALWAYS_INLINE void uae_mmu040_put_word(uaecptr addr, uae_u16 val)
 {
+#ifdef WINUAE_FOR_PREVIOUS
+	if (hosttlb_put(addr, regs.s ? 5 : 1, 2, val))
+		return;
+	hosttlb_watch_write(addr, 2);
+#endif
 	if (unlikely(is_unaligned_page(addr, 2)))
 		mmu_put_word_unaligned(addr, val, true);
 	else
@@ -742,10 +779,20 @@ static ALWAYS_INLINE void uae_mmu040_put_word(uaecptr addr, uae_u16 val)
 }
 static ALWAYS_INLINE void uae_mmu040_put_byte(uaecptr addr, uae_u8 val)
 {
+#ifdef WINUAE_FOR_PREVIOUS
+	if (hosttlb_put(addr, regs.s ? 5 : 1, 1, val))
+		return;
+	hosttlb_watch_write(addr, 1);
+#endif
 	mmu_put_byte(addr, val, true, sz_byte);
 }
 static ALWAYS_INLINE void uae_mmu040_put_long(uaecptr addr, uae_u32 val)
 {
+#ifdef WINUAE_FOR_PREVIOUS
+	if (hosttlb_put(addr, regs.s ? 5 : 1, 4, val))
+		return;
+	hosttlb_watch_write(addr, 4);
+#endif
 	if (unlikely(is_unaligned_page(addr, 4)))
 		mmu_put_long_unaligned(addr, val, true);
 	else
@@ -42,6 +42,9 @@
 #include "newcpu.h"
 #include "debug.h"
 #include "cpummu030.h"
+#include "blockcache.h"
+#include "hosttlb.h"
+#include "host.h"
 #include "cputbl.h"
 #include "savestate.h"
 
@@ -224,6 +227,10 @@ static struct {
 
 static void mmu030_flush_cache(uaecptr addr)
 {
+#ifdef WINUAE_FOR_PREVIOUS
+	blockcache_flush_translations();
+	hosttlb_flush();
+#endif
 #if MMU_IPAGECACHE030
 	mmu030.mmu030_last_logical_address = 0xffffffff;
 #endif
@@ -458,6 +465,12 @@ int mmu_op30_pmove(uaecptr pc, uae_u32 opcode, uae_u16 next, uaecptr extra)
     if (!fd && !rw && preg != 0x18) {
         mmu030_flush_atc_all();
     }
+#ifdef WINUAE_FOR_PREVIOUS
+	if (!rw) {
+		blockcache_flush_translations();
+		hosttlb_flush();
+	}
+#endif
 	tt_enabled = (tt0_030 & TT_ENABLE) || (tt1_030 & TT_ENABLE);
 	return 0;
 }
@@ -1227,7 +1240,16 @@ static void desc_get_quad(uaecptr addr, uae_u32 *descr)
 /* This functions searches through the translation tables. It can be used 
  * for PTEST (levels 1 to 7). Using level 0 creates an ATC entry. */
 
+static uae_u32 mmu030_table_walk(uaecptr addr, uae_u32 fc, bool write, int level);
+
 static uae_u32 mmu030_table_search(uaecptr addr, uae_u32 fc, bool write, int level) {
+    uint64_t start = host_prof_now();
+    uae_u32 ret = mmu030_table_walk(addr, fc, write, level);
+    host_prof_end(HOST_PROF_MMU, start);
+    return ret;
+}
+
+static uae_u32 mmu030_table_walk(uaecptr addr, uae_u32 fc, bool write, int level) {
     /* During table walk up to 7 different descriptors are used:
      * root pointer, descriptors fetched from function code lookup table,
      * tables A, B, C and D and one indirect descriptor */
@@ -1906,6 +1928,9 @@ bool mmu030_is_super_access(bool read)
 
 static void mmu030_add_data_read_cache(uaecptr addr, uaecptr phys, uae_u32 fc)
 {
+#ifdef WINUAE_FOR_PREVIOUS
+	hosttlb_fill(addr, phys | (addr & mmu030.translation.page.mask), fc, false);
+#endif
 #if MMU_DPAGECACHE030
 	uae_u32 idx1 = ((addr & mmu030.translation.page.imask) >>  mmu030.translation.page.size3m) | fc;
 	uae_u32 idx2 = idx1 & (MMUFASTCACHE_ENTRIES030 - 1);
@@ -1919,6 +1944,9 @@ static void mmu030_add_data_read_cache(uaecptr addr, uaecptr phys, uae_u32 fc)
 
 static void mmu030_add_data_write_cache(uaecptr addr, uaecptr phys, uae_u32 fc)
 {
+#ifdef WINUAE_FOR_PREVIOUS
+	hosttlb_fill(addr, phys | (addr & mmu030.translation.page.mask), fc, true);
+#endif
 #if MMU_DPAGECACHE030
 	uae_u32 idx1 = ((addr & mmu030.translation.page.imask) >>  mmu030.translation.page.size3m) | fc;
 	uae_u32 idx2 = idx1 & (MMUFASTCACHE_ENTRIES030 - 1);
@@ -2648,6 +2676,10 @@ void mmu030_reset(int hardreset)
 		mmu030.mmu030_last_logical_address = 0xffffffff;
 	#endif
 		regs.mmu_page_size = 0;
+#ifdef WINUAE_FOR_PREVIOUS
+		blockcache_flush_translations();
+		hosttlb_flush();
+#endif
 		if (hardreset >= 0) {
 			tc_030 &= ~TC_ENABLE_TRANSLATION;
 			tt0_030 &= ~TT_ENABLE;
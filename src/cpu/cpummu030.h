@@ -6,6 +6,8 @@
 #include "uae/types.h"
 
 #include "mmu_common.h"
+#include "blockcache.h"
+#include "hosttlb.h"
 
 #define MMU_DPAGECACHE030 0
 #define MMU_IPAGECACHE030 0
@@ -111,6 +113,13 @@ static ALWAYS_INLINE uae_u32 uae_mmu030_get_ilong(uaecptr addr)
 {
 	uae_u32 fc = uae_mmu030_get_fc_code();
 
+#ifdef WINUAE_FOR_PREVIOUS
+	if (blockcache_enabled) {
+		uae_u8 *p = blockcache_get_code(addr, 4);
+		if (p)
+			return do_get_mem_long(p);
+	}
+#endif
 	if (unlikely(is_unaligned_bus(addr, 4)))
 		return mmu030_get_ilong_unaligned(addr, fc, 0);
 	return mmu030_get_ilong(addr, fc);
@@ -119,6 +128,13 @@ static ALWAYS_INLINE uae_u16 uae_mmu030_get_iword(uaecptr addr)
 {
 	uae_u32 fc = uae_mmu030_get_fc_code();
 
+#ifdef WINUAE_FOR_PREVIOUS
+	if (blockcache_enabled) {
+		uae_u8 *p = blockcache_get_code(addr, 2);
+		if (p)
+			return do_get_mem_word(p);
+	}
+#endif
 	return mmu030_get_iword(addr, fc);
 }
 static ALWAYS_INLINE uae_u16 uae_mmu030_get_ibyte(uaecptr addr)
@@ -132,6 +148,11 @@ static ALWAYS_INLINE uae_u32 uae_mmu030_get_long(uaecptr addr)
 {
 	uae_u32 fc = uae_mmu030_get_fc_data();
 
+#ifdef WINUAE_FOR_PREVIOUS
+	uae_u32 v;
+	if (hosttlb_get(addr, fc, 4, &v))
+		return v;
+#endif
 	if (unlikely(is_unaligned_bus(addr, 4)))
 		return mmu030_get_long_unaligned(addr, fc, 0);
 	return mmu030_get_long(addr, fc);
@@ -140,6 +161,11 @@ static ALWAYS_INLINE uae_u32 uae_mmu030_get_word(uaecptr addr)
 {
 	uae_u32 fc = uae_mmu030_get_fc_data();
 
+#ifdef WINUAE_FOR_PREVIOUS
+	uae_u32 v;
+	if (hosttlb_get(addr, fc, 2, &v))
+		return v;
+#endif
 	if (unlikely(is_unaligned_bus(addr, 2)))
 		return mmu030_get_word_unaligned(addr, fc, 0);
 	return mmu030_get_word(addr, fc);
@@ -148,6 +174,11 @@ static ALWAYS_INLINE uae_u32 uae_mmu030_get_byte(uaecptr addr)
 {
 	uae_u32 fc = uae_mmu030_get_fc_data();
 
+#ifdef WINUAE_FOR_PREVIOUS
+	uae_u32 v;
+	if (hosttlb_get(addr, fc, 1, &v))
+		return v;
+#endif
 	return mmu030_get_byte(addr, fc);
 }
 
@@ -155,6 +186,11 @@ static ALWAYS_INLINE void uae_mmu030_put_long(uaecptr addr, uae_u32 val)
 {
 	uae_u32 fc = uae_mmu030_get_fc_data();
 
+#ifdef WINUAE_FOR_PREVIOUS
+	if (hosttlb_put(addr, fc, 4, val))
+		return;
+	hosttlb_watch_write(addr, 4);
+#endif
 	if (unlikely(is_unaligned_bus(addr, 4)))
 		mmu030_put_long_unaligned(addr, val, fc, 0);
 	else
@@ -164,6 +200,11 @@ static ALWAYS_INLINE void uae_mmu030_put_word(uaecptr addr, uae_u32 val)
 {
 	uae_u32 fc = uae_mmu030_get_fc_data();
 
+#ifdef WINUAE_FOR_PREVIOUS
+	if (hosttlb_put(addr, fc, 2, val))
+		return;
+	hosttlb_watch_write(addr, 2);
+#endif
 	if (unlikely(is_unaligned_bus(addr, 2)))
 		mmu030_put_word_unaligned(addr, val, fc, 0);
 	else
@@ -173,6 +214,11 @@ static ALWAYS_INLINE void uae_mmu030_put_byte(uaecptr addr, uae_u32 val)
 {
 	uae_u32 fc = uae_mmu030_get_fc_data();
 
+#ifdef WINUAE_FOR_PREVIOUS
+	if (hosttlb_put(addr, fc, 1, val))
+		return;
+	hosttlb_watch_write(addr, 1);
+#endif
 	mmu030_put_byte(addr, val, fc);
 }
 
@@ -208,6 +254,9 @@ static ALWAYS_INLINE uae_u32 uae_mmu030_get_byte_fc(uaecptr addr)
 }
 static ALWAYS_INLINE void uae_mmu030_put_long_fc(uaecptr addr, uae_u32 val)
 {
+#ifdef WINUAE_FOR_PREVIOUS
+	hosttlb_watch_write(addr, 4);
+#endif
 	if (unlikely(is_unaligned_bus(addr, 4)))
 		mmu030_put_long_unaligned(addr, val, regs.fc030, 0);
 	else
@@ -215,6 +264,9 @@ static ALWAYS_INLINE void uae_mmu030_put_long_fc(uaecptr addr, uae_u32 val)
 }
 static ALWAYS_INLINE void uae_mmu030_put_word_fc(uaecptr addr, uae_u32 val)
 {
+#ifdef WINUAE_FOR_PREVIOUS
+	hosttlb_watch_write(addr, 2);
+#endif
 	if (unlikely(is_unaligned_bus(addr, 2)))
 		mmu030_put_word_unaligned(addr, val,  regs.fc030, 0);
 	else
@@ -222,6 +274,9 @@ static ALWAYS_INLINE void uae_mmu030_put_word_fc(uaecptr addr, uae_u32 val)
 }
 static ALWAYS_INLINE void uae_mmu030_put_byte_fc(uaecptr addr, uae_u32 val)
 {
+#ifdef WINUAE_FOR_PREVIOUS
+	hosttlb_watch_write(addr, 1);
+#endif
 	mmu030_put_byte(addr, val, regs.fc030);
 }
 uae_u8 uae_mmu030_check_fc(uaecptr addr, bool write, uae_u32 size);
@@ -244,6 +299,9 @@ static ALWAYS_INLINE uae_u32 uae_mmu030_get_byte_fcx(uaecptr addr, int fc)
 }
 static ALWAYS_INLINE void uae_mmu030_put_long_fcx(uaecptr addr, uae_u32 val, int fc)
 {
+#ifdef WINUAE_FOR_PREVIOUS
+	hosttlb_watch_write(addr, 4);
+#endif
 	if (unlikely(is_unaligned_bus(addr, 4)))
 		mmu030_put_long_unaligned(addr, val, fc, 0);
 	else
@@ -251,6 +309,9 @@ static ALWAYS_INLINE void uae_mmu030_put_long_fcx(uaecptr addr, uae_u32 val, int
 }
 static ALWAYS_INLINE void uae_mmu030_put_word_fcx(uaecptr addr, uae_u32 val, int fc)
 {
+#ifdef WINUAE_FOR_PREVIOUS
+	hosttlb_watch_write(addr, 2);
+#endif
 	if (unlikely(is_unaligned_bus(addr, 2)))
 		mmu030_put_word_unaligned(addr, val, fc, 0);
 	else
@@ -258,6 +319,9 @@ static ALWAYS_INLINE void uae_mmu030_put_word_fcx(uaecptr addr, uae_u32 val, int
 }
 static ALWAYS_INLINE void uae_mmu030_put_byte_fcx(uaecptr addr, uae_u32 val, int fc)
 {
+#ifdef WINUAE_FOR_PREVIOUS
+	hosttlb_watch_write(addr, 1);
+#endif
 	mmu030_put_byte(addr, val, fc);
 }
 
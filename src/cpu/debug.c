@@ -362,9 +362,38 @@ static int debug_out (const TCHAR *format, ...)
 
 #endif	/* ! WINUAE_FOR_HATARI */
 
+#ifdef WINUAE_FOR_HATARI
+/* Code bytes that the debug accessors return instead of memory, to
+ * disassemble instructions that were recorded in a CPU trace file */
+static uaecptr debug_code_addr;
+static const uae_u8 *debug_code;
+static int debug_code_size;
+
+void debug_set_code (uaecptr addr, const uae_u8 *code, int size)
+{
+	debug_code_addr = addr;
+	debug_code = code;
+	debug_code_size = size;
+}
+
+static bool debug_get_code (uaecptr addr, int size, uae_u32 *v)
+{
+	uae_u32 offset = addr - debug_code_addr;
+	if (!debug_code || offset > (uae_u32)(debug_code_size - size))
+		return false;
+	for (*v = 0; size > 0; size--)
+		*v = (*v << 8) | debug_code[offset++];
+	return true;
+}
+#else
+#define debug_get_code(addr, size, v) false
+#endif
+
 uae_u32 get_byte_debug (uaecptr addr)
 {
 	uae_u32 v = 0xff;
+	if (debug_get_code(addr, 1, &v))
+		return v;
 	if (debug_mmu_mode) {
 		flagtype olds = regs.s;
 		regs.s = (debug_mmu_mode & 4) != 0;
@@ -399,6 +428,8 @@ uae_u32 get_byte_debug (uaecptr addr)
 uae_u32 get_word_debug (uaecptr addr)
 {
 	uae_u32 v = 0xffff;
+	if (debug_get_code(addr, 2, &v))
+		return v;
 	if (debug_mmu_mode) {
 		flagtype olds = regs.s;
 		regs.s = (debug_mmu_mode & 4) != 0;
@@ -427,6 +458,8 @@ uae_u32 get_word_debug (uaecptr addr)
 uae_u32 get_long_debug (uaecptr addr)
 {
 	uae_u32 v = 0xffffffff;
+	if (debug_get_code(addr, 4, &v))
+		return v;
 	if (debug_mmu_mode) {
 		flagtype olds = regs.s;
 		regs.s = (debug_mmu_mode & 4) != 0;
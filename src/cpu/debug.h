@@ -203,6 +203,9 @@ uae_u32 get_word_debug (uaecptr addr);
 uae_u32 get_long_debug (uaecptr addr);
 uae_u32 get_ilong_debug (uaecptr addr);
 uae_u32 get_iword_debug (uaecptr addr);
+#ifdef WINUAE_FOR_HATARI
+void debug_set_code (uaecptr addr, const uae_u8 *code, int size);
+#endif
 
 uae_u32 get_byte_cache_debug(uaecptr addr, bool *cached);
 uae_u32 get_word_cache_debug(uaecptr addr, bool *cached);
@@ -337,6 +340,7 @@ uae_u32 get_word_debug (uaecptr addr);
 uae_u32 get_long_debug (uaecptr addr);
 uae_u32 get_ilong_debug (uaecptr addr);
 uae_u32 get_iword_debug (uaecptr addr);
+void debug_set_code (uaecptr addr, const uae_u8 *code, int size);
 extern void mmu_do_hit (void);
 #endif
 
@@ -299,12 +299,6 @@ static bool fpu_mmu_fixup;
 #define FPSR_QUOT_SIGN  0x00800000
 #define FPSR_QUOT_LSB   0x007F0000
 
-#define FPSR_AE_IOP     0x00000080
-#define FPSR_AE_OVFL    0x00000040
-#define FPSR_AE_UNFL    0x00000020
-#define FPSR_AE_DZ      0x00000010
-#define FPSR_AE_INEX    0x00000008
-
 static struct {
 	// 6888x and 68060
 	uae_u32 ccr;
@@ -687,6 +681,11 @@ static void fpsr_get_quotient(uae_u64 *quot, uae_u8 *sign)
 
 uae_u32 fpp_get_fpsr (void)
 {
+#ifdef WINUAE_FOR_PREVIOUS
+	// the native FPU collects accrued exceptions until FPSR is read
+	if (currprefs.fpu_mode <= 0)
+		fp_native_update_fpsr();
+#endif
 #ifdef JIT
 	if (currprefs.cachesize && currprefs.compfpu) {
 		regs.fpsr &= 0x00fffff8; // clear cc
@@ -732,6 +731,11 @@ static void fpset (fpdata *fpd, uae_s32 val)
 
 void fpp_set_fpsr (uae_u32 val)
 {
+#ifdef WINUAE_FOR_PREVIOUS
+	// drop accrued exceptions collected by the native FPU
+	if (currprefs.fpu_mode <= 0)
+		fp_native_update_fpsr();
+#endif
 	regs.fpsr = val & fpsr_mask;
 
 #ifdef JIT
@@ -3638,7 +3642,16 @@ void fpu_modechange(void)
 		fpp_from_exten_fmovem(&regs.fp[i], &temp_ext[i][0], &temp_ext[i][1], &temp_ext[i][2]);
 	}
 
+#ifdef WINUAE_FOR_PREVIOUS
+	if (currprefs.fpu_mode > 0) {
+		fp_exit_native();
+		fp_init_softfloat(currprefs.fpu_model);
+	} else {
+		fp_init_native();
+	}
+#else
 	fp_init_softfloat(currprefs.fpu_model);
+#endif
 	use_long_double = false;
 
 	get_features();
@@ -3667,7 +3680,16 @@ static void fpu_test(void)
 
 void fpu_reset (void)
 {
+#ifdef WINUAE_FOR_PREVIOUS
+	if (currprefs.fpu_mode > 0) {
+		fp_exit_native();
+		fp_init_softfloat(currprefs.fpu_model);
+	} else {
+		fp_init_native();
+	}
+#else
 	fp_init_softfloat(currprefs.fpu_model);
+#endif
 	use_long_double = false;
 	regs.fpu_exp_state = 0;
 	regs.fp_unimp_pend = 0;
@@ -16,7 +16,17 @@
 #define FPSR_INEX2      0x00000200
 #define FPSR_INEX1      0x00000100
 
+#define FPSR_AE_IOP     0x00000080
+#define FPSR_AE_OVFL    0x00000040
+#define FPSR_AE_UNFL    0x00000020
+#define FPSR_AE_DZ      0x00000010
+#define FPSR_AE_INEX    0x00000008
+
 extern void fp_init_native(void);
+#ifdef WINUAE_FOR_PREVIOUS
+extern void fp_exit_native(void);
+extern void fp_native_update_fpsr(void);
+#endif
 #ifdef MSVC_LONG_DOUBLE
 extern bool fp_init_native_80(void);
 #endif
@@ -175,8 +175,14 @@ static void native_set_fpucw(uae_u32 m68k_cw)
 /* Functions for setting host/library modes and getting status */
 static void fp_set_mode(uae_u32 mode_control)
 {
+#ifdef WINUAE_FOR_PREVIOUS
+	// the host FPU is only reprogrammed if FPCR changes
+	if (mode_control == fpu_mode_control)
+		return;
+#else
 	if (mode_control == fpu_mode_control && !currprefs.compfpu)
 		return;
+#endif
     switch(mode_control & FPCR_ROUNDING_PRECISION) {
         case FPCR_PRECISION_EXTENDED: // X
 			fpu_prec = PREC_EXTENDED;
@@ -233,6 +239,30 @@ static void fp_get_status(uae_u32 *status)
 #endif
 }
 
+#ifdef WINUAE_FOR_PREVIOUS
+/* The host exception flags are not checked after each operation. They
+ * are folded into the accrued exception byte when the guest reads FPSR
+ * and cleared when it reads or writes FPSR. */
+void fp_native_update_fpsr(void)
+{
+	int exp_flags = fetestexcept(FE_ALL_EXCEPT);
+
+	if (exp_flags) {
+		if (exp_flags & FE_INVALID)
+			regs.fpsr |= FPSR_AE_IOP;
+		if (exp_flags & FE_OVERFLOW)
+			regs.fpsr |= FPSR_AE_OVFL;
+		if ((exp_flags & FE_UNDERFLOW) && (exp_flags & FE_INEXACT))
+			regs.fpsr |= FPSR_AE_UNFL;
+		if (exp_flags & FE_DIVBYZERO)
+			regs.fpsr |= FPSR_AE_DZ;
+		if (exp_flags & (FE_INEXACT | FE_OVERFLOW))
+			regs.fpsr |= FPSR_AE_INEX;
+		feclearexcept(FE_ALL_EXCEPT);
+	}
+}
+#endif
+
 static uae_u32 fp_get_support_flags(void)
 {
 	return 0;
@@ -1284,8 +1314,22 @@ static void fp_to_pack (fpdata *fpd, uae_u32 *wrd, int dummy)
 }
 
 
+#ifdef WINUAE_FOR_PREVIOUS
+/* Return the host FPU to its default state when leaving native mode */
+void fp_exit_native(void)
+{
+	if (fpu_mode_control & FPCR_ROUNDING_MODE)
+		fesetround(FE_TONEAREST);
+	fpu_mode_control = 0;
+}
+#endif
+
 void fp_init_native(void)
 {
+#ifdef WINUAE_FOR_PREVIOUS
+	fp_exit_native();
+	feclearexcept(FE_ALL_EXCEPT);
+#endif
 #ifdef SOFTFLOAT_CONVERSIONS
 	set_floatx80_rounding_precision(80, &fs);
 	set_float_rounding_mode(float_round_to_zero, &fs);
@@ -364,6 +364,13 @@ NORETURN static void term_err (const char *err)
 	term();
 }
 
+#ifdef WINUAE_FOR_PREVIOUS
+/* Handlers that make up this share of all executed instructions in the
+ * profile are marked hot, which makes the compiler group them together. */
+#define HOT_OPCODE_SHARE 90
+static int nr_hot_funcs;
+#endif
+
 static void read_counts (void)
 {
 	FILE *file;
@@ -375,6 +382,27 @@ static void read_counts (void)
 	count = 0;
 	file = fopen ("frequent.68k", "r");
 	if (file) {
+#ifdef WINUAE_FOR_PREVIOUS
+		/* Written by dump_counts() in newcpu.c, sorted by count */
+		unsigned long lcount, ltotal, sum = 0;
+		nr_hot_funcs = 0;
+		if (fscanf (file, "Total: %lu\n", &ltotal) != 1) {
+			abort();
+		}
+		while (fscanf (file, "%x: %lu %19s\n", &opcode, &lcount, name) == 3) {
+			if (opcode > 0xffff || table68k[opcode].handler != -1
+				|| table68k[opcode].mnemo == i_ILLG || counts[opcode])
+				continue;
+			opcode_next_clev[nr] = 5;
+			opcode_last_postfix[nr] = -1;
+			opcode_map[nr++] = opcode;
+			counts[opcode] = lcount;
+			if (sum < ltotal / 100 * HOT_OPCODE_SHARE)
+				nr_hot_funcs = nr;
+			sum += lcount;
+		}
+		fprintf (stderr, "gencpu: %d opcode handlers from frequent.68k, %d hot\n", nr, nr_hot_funcs);
+#else
 		if (fscanf (file, "Total: %u\n", &total) == 0) {
 			abort();
 		}
@@ -384,6 +412,7 @@ static void read_counts (void)
 			opcode_map[nr++] = opcode;
 			counts[opcode] = count;
 		}
+#endif
 		fclose (file);
 	}
 	if (nr == nr_cpuop_funcs)
@@ -9651,6 +9680,14 @@ static void generate_macros(FILE *f)
 	fprintf(f,
 		"#define SET_ALWAYS_CFLG(x) SET_CFLG(x)\n"
 		"#define SET_ALWAYS_NFLG(x) SET_NFLG(x)\n");
+#ifdef WINUAE_FOR_PREVIOUS
+	fprintf(f,
+		"#ifdef __GNUC__\n"
+		"#define OPCODE_HOT __attribute__((hot))\n"
+		"#else\n"
+		"#define OPCODE_HOT\n"
+		"#endif\n");
+#endif
 }
 
 static void generate_includes (FILE *f, int id)
@@ -9928,6 +9965,10 @@ static void generate_one_opcode (int rp, const char *extra)
 	out("/* %s */\n", outopcode (opcode));
 	if (i68000)
 		out("#ifndef CPUEMU_68000_ONLY\n");
+#ifdef WINUAE_FOR_PREVIOUS
+	if (rp < nr_hot_funcs)
+		out("OPCODE_HOT ");
+#endif
 	out("%s REGPARAM2 op_%04x_%d%s_ff(uae_u32 opcode)\n{\n", func_noret ? "void" : "uae_u32", opcode, postfix, extra);
 	if ((using_simple_cycles || do_always_dynamic_cycles) && !using_nocycles)
 		out("int count_cycles = 0;\n");
@@ -10449,9 +10490,14 @@ int main(int argc, char *argv[])
 	generate_includes(stblfile, 0);
 
 	for (int i = 0; i <= 55; i++) {
-		if (i!=31 && i!=32) // Previous
+#ifdef WINUAE_FOR_PREVIOUS
+		/* Previous only runs the 68040 MMU (31) and 68030 MMU (32) tables.
+		 * They are generated without prefetch, cycle-exact and cycle
+		 * counting code, so no other table is needed. */
+		if (i != 31 && i != 32)
 			continue;
-		using_nocycles = 1; // Previous
+		using_nocycles = 1;
+#endif
 		generate_stbl = 1;
 		generate_cpu (i, 0);
 	}
@@ -39,6 +39,7 @@ int Init680x0(void)
  */
 void Exit680x0(void)
 {
+	dump_counts();
 	memory_uninit();
 
 	free(table68k);
@@ -0,0 +1,224 @@
+/*
+  Previous - hosttlb.c
+
+  This file is distributed under the GNU General Public License, version 2
+  or at your option any later version. Read the file gpl.txt for details.
+
+  Direct mapped host side TLB for the 68030/68040 MMU. It is indexed by
+  logical page and function code and caches host pointers for pages that
+  are backed by plain memory. Data accesses that hit skip both the ATC
+  search and the memory bank indirection. Entries are filled from the
+  ATC hit paths, where access rights have already been checked, and the
+  TLB is flushed whenever the ATC is flushed or the MMU setup changes.
+
+  Debugger memory watches mark logical pages as watched. Those pages get
+  no write entries, so writes to them always take the slow path, where
+  they are checked against the watched pages.
+*/
+const char HostTLB_fileid[] = "Previous hosttlb.c";
+
+#include "sysconfig.h"
+#include "sysdeps.h"
+#include "main.h"
+#include "memory.h"
+#include "newcpu.h"
+#include "hosttlb.h"
+
+
+#define HOSTTLB_TAG_INVALID     0xffffffff
+
+bool hosttlb_enabled = false;
+HOSTTLB_ENTRY hosttlb_read[HOSTTLB_ENTRIES];
+HOSTTLB_ENTRY hosttlb_write[HOSTTLB_ENTRIES];
+
+bool hosttlb_watching = false;
+bool hosttlb_watch_hit = false;
+
+static uae_u8 *tlb_ram;
+static uae_u32 tlb_ram_size;
+
+static uaecptr watch_page[HOSTTLB_WATCH_PAGES];
+static int watch_count;
+
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Invalidate all entries.
+ */
+void hosttlb_flush(void)
+{
+	int i;
+
+	for (i = 0; i < HOSTTLB_ENTRIES; i++) {
+		hosttlb_read[i].tag = HOSTTLB_TAG_INVALID;
+		hosttlb_write[i].tag = HOSTTLB_TAG_INVALID;
+	}
+}
+
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Invalidate entries that point into banks that are about to be remapped.
+ */
+static void hosttlb_unmap(int first, int count)
+{
+	uae_u8 *base;
+	int bnr, i;
+
+	for (bnr = first; bnr < first + count; bnr++) {
+		base = bank_host[bnr];
+		if (!base) {
+			continue;
+		}
+		for (i = 0; i < HOSTTLB_ENTRIES; i++) {
+			if (hosttlb_read[i].host >= base && hosttlb_read[i].host < base + 0x10000) {
+				hosttlb_read[i].tag = HOSTTLB_TAG_INVALID;
+			}
+			if (hosttlb_write[i].host >= base && hosttlb_write[i].host < base + 0x10000) {
+				hosttlb_write[i].tag = HOSTTLB_TAG_INVALID;
+			}
+		}
+	}
+}
+
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Tell the TLB where main memory lives. Called from memory_init after
+ * (re-)allocating main memory.
+ */
+void hosttlb_init(uae_u8 *ram, uae_u32 size)
+{
+	tlb_ram = ram;
+	tlb_ram_size = size;
+	hosttlb_flush();
+	memory_add_map_listener(hosttlb_unmap);
+}
+
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Switch the TLB on or off.
+ */
+void hosttlb_enable(bool enable)
+{
+	hosttlb_flush();
+
+	if (enable != hosttlb_enabled) {
+		write_log("Host TLB %s\n", enable ? "enabled" : "disabled");
+	}
+	hosttlb_enabled = enable;
+}
+
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Return true if the logical page of addr is watched.
+ */
+static bool hosttlb_is_watched(uaecptr addr)
+{
+	int i;
+
+	addr &= ~HOSTTLB_PAGE_MASK;
+	for (i = 0; i < watch_count; i++) {
+		if (watch_page[i] == addr) {
+			return true;
+		}
+	}
+	return false;
+}
+
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Remove all watched pages.
+ */
+void hosttlb_watch_clear(void)
+{
+	watch_count = 0;
+	hosttlb_watching = false;
+	hosttlb_watch_hit = false;
+}
+
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Watch writes to the size bytes at logical address addr. Sets
+ * hosttlb_watch_hit, so that the watcher checks the current value once.
+ * Returns false if there are too many watched pages.
+ */
+bool hosttlb_watch_add(uaecptr addr, int size)
+{
+	uaecptr page, last = (addr + size - 1) & ~HOSTTLB_PAGE_MASK;
+	int i;
+
+	for (page = addr & ~HOSTTLB_PAGE_MASK; ; page += HOSTTLB_PAGE_SIZE) {
+		if (!hosttlb_is_watched(page)) {
+			if (watch_count == HOSTTLB_WATCH_PAGES) {
+				return false;
+			}
+			watch_page[watch_count++] = page;
+		}
+		if (page == last) {
+			break;
+		}
+	}
+	for (i = 0; i < HOSTTLB_ENTRIES; i++) {
+		if (hosttlb_is_watched(hosttlb_write[i].tag)) {
+			hosttlb_write[i].tag = HOSTTLB_TAG_INVALID;
+		}
+	}
+	hosttlb_watching = true;
+	hosttlb_watch_hit = true;
+	return true;
+}
+
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Set hosttlb_watch_hit if a write touches a watched page.
+ */
+void hosttlb_watch_check(uaecptr addr, int size)
+{
+	if (hosttlb_is_watched(addr) || hosttlb_is_watched(addr + size - 1)) {
+		hosttlb_watch_hit = true;
+	}
+}
+
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Add a translation for the page of addr. Called after the MMU checked
+ * that the access is allowed. Only pages that are backed by plain memory
+ * are cached, write entries are only made for main memory.
+ */
+void hosttlb_fill(uaecptr addr, uaecptr phys, uae_u32 fc, bool write)
+{
+	HOSTTLB_ENTRY *e;
+	uae_u8 *host;
+
+	if (!hosttlb_enabled || regs.mmu_page_size < HOSTTLB_PAGE_SIZE) {
+		return;
+	}
+
+	phys &= ~HOSTTLB_PAGE_MASK;
+	if (!bank_host[bankindex(phys)]) {
+		return;
+	}
+	host = get_host_address(phys);
+
+	if (write) {
+		if (unlikely(hosttlb_watching) && hosttlb_is_watched(addr)) {
+			return;
+		}
+		if (host < tlb_ram || host >= tlb_ram + tlb_ram_size) {
+			return;
+		}
+		e = &hosttlb_write[(addr >> HOSTTLB_PAGE_SHIFT) & (HOSTTLB_ENTRIES - 1)];
+		e->offset = host - tlb_ram;
+	} else {
+		e = &hosttlb_read[(addr >> HOSTTLB_PAGE_SHIFT) & (HOSTTLB_ENTRIES - 1)];
+	}
+	e->tag = (addr & ~HOSTTLB_PAGE_MASK) | fc;
+	e->host = host;
+}
@@ -0,0 +1,123 @@
+/*
+  Previous - hosttlb.h
+
+  This file is distributed under the GNU General Public License, version 2
+  or at your option any later version. Read the file gpl.txt for details.
+*/
+
+#ifndef HOSTTLB_H
+#define HOSTTLB_H
+
+#include "sysdeps.h"
+#include "maccess.h"
+#include "blockcache.h"
+
+#define HOSTTLB_PAGE_SHIFT      12
+#define HOSTTLB_PAGE_SIZE       (1 << HOSTTLB_PAGE_SHIFT)
+#define HOSTTLB_PAGE_MASK       (HOSTTLB_PAGE_SIZE - 1)
+#define HOSTTLB_ENTRIES         256
+#define HOSTTLB_WATCH_PAGES     16
+
+typedef struct {
+	uae_u32 tag;        /* logical page | function code */
+	uae_u8 *host;       /* host address of the page */
+	uae_u32 offset;     /* offset of the page in main memory (write entries) */
+} HOSTTLB_ENTRY;
+
+extern bool hosttlb_enabled;
+extern HOSTTLB_ENTRY hosttlb_read[HOSTTLB_ENTRIES];
+extern HOSTTLB_ENTRY hosttlb_write[HOSTTLB_ENTRIES];
+extern bool hosttlb_watching;
+extern bool hosttlb_watch_hit;
+
+extern void hosttlb_init(uae_u8 *ram, uae_u32 size);
+extern void hosttlb_enable(bool enable);
+extern void hosttlb_flush(void);
+extern void hosttlb_fill(uaecptr addr, uaecptr phys, uae_u32 fc, bool write);
+extern void hosttlb_watch_clear(void);
+extern bool hosttlb_watch_add(uaecptr addr, int size);
+extern void hosttlb_watch_check(uaecptr addr, int size);
+
+static inline HOSTTLB_ENTRY *hosttlb_lookup(HOSTTLB_ENTRY *tlb, uaecptr addr, uae_u32 fc, int size)
+{
+	HOSTTLB_ENTRY *e = &tlb[(addr >> HOSTTLB_PAGE_SHIFT) & (HOSTTLB_ENTRIES - 1)];
+
+	if (e->tag == ((addr & ~HOSTTLB_PAGE_MASK) | fc) &&
+	    (addr & HOSTTLB_PAGE_MASK) <= (uae_u32)(HOSTTLB_PAGE_SIZE - size))
+		return e;
+	return NULL;
+}
+
+/**
+ * Fast data read. Returns true and the value in v if the page of addr
+ * is in the TLB for the given function code.
+ */
+static inline bool hosttlb_get(uaecptr addr, uae_u32 fc, int size, uae_u32 *v)
+{
+	HOSTTLB_ENTRY *e;
+	uae_u8 *p;
+
+	if (!hosttlb_enabled || !(e = hosttlb_lookup(hosttlb_read, addr, fc, size)))
+		return false;
+
+	p = e->host + (addr & HOSTTLB_PAGE_MASK);
+	switch (size) {
+		case 4: *v = do_get_mem_long(p); break;
+		case 2: *v = do_get_mem_word(p); break;
+		default: *v = *p; break;
+	}
+	return true;
+}
+
+/**
+ * Fast data write. Returns true if the page of addr is in the TLB for
+ * the given function code and the value has been written.
+ */
+static inline bool hosttlb_put(uaecptr addr, uae_u32 fc, int size, uae_u32 v)
+{
+	HOSTTLB_ENTRY *e;
+	uae_u8 *p;
+
+	if (!hosttlb_enabled || !(e = hosttlb_lookup(hosttlb_write, addr, fc, size)))
+		return false;
+
+	blockcache_check_write(e->offset + (addr & HOSTTLB_PAGE_MASK), size);
+	p = e->host + (addr & HOSTTLB_PAGE_MASK);
+	switch (size) {
+		case 4: do_put_mem_long(p, v); break;
+		case 2: do_put_mem_word(p, v); break;
+		default: *p = v; break;
+	}
+	return true;
+}
+
+/**
+ * Read a long through either TLB without falling back to the MMU. For
+ * looking at guest memory from outside of an instruction, where a miss
+ * must not cause a fault.
+ */
+static inline bool hosttlb_peek_long(uaecptr addr, uae_u32 fc, uae_u32 *v)
+{
+	HOSTTLB_ENTRY *e;
+
+	if (!hosttlb_enabled)
+		return false;
+	if (!(e = hosttlb_lookup(hosttlb_read, addr, fc, 4)) &&
+	    !(e = hosttlb_lookup(hosttlb_write, addr, fc, 4)))
+		return false;
+
+	*v = do_get_mem_long(e->host + (addr & HOSTTLB_PAGE_MASK));
+	return true;
+}
+
+/**
+ * Note a data write that missed the TLB. Watched pages never get write
+ * entries, so every write to them ends up here.
+ */
+static inline void hosttlb_watch_write(uaecptr addr, int size)
+{
+	if (unlikely(hosttlb_watching))
+		hosttlb_watch_check(addr, size);
+}
+
+#endif /* HOSTTLB_H */
@@ -16,6 +16,10 @@
 
 #include "sysdeps.h"
 
+#if HAVE_SYS_MMAN_H
+#include <sys/mman.h>
+#endif
+
 #if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
 
 #define be_swap32(x) ((uint32_t)(x))
@@ -148,4 +152,19 @@ static inline uint8_t* malloc_aligned(size_t size) {
 #endif
 }
 
+/* Allocate guest memory. With 'huge' it is aligned to 2 MB and the host is
+ * asked to back it with transparent huge pages where that is supported. */
+static inline uint8_t* malloc_guest(size_t size, bool huge) {
+#if HAVE_SYS_MMAN_H && defined(MADV_HUGEPAGE)
+	if (huge) {
+		void* result = NULL;
+		if (posix_memalign(&result, 0x200000, size))
+			return NULL;
+		madvise(result, size, MADV_HUGEPAGE);
+		return (uint8_t*)result;
+	}
+#endif
+	return malloc_aligned(size);
+}
+
 #endif /* UAE_MACCESS_H */
@@ -28,7 +28,10 @@ const char Memory_fileid[] = "Previous memory.c";
 #include "nbic.h"
 #include "reset.h"
 #include "m68000.h"
+#include "blockcache.h"
+#include "hosttlb.h"
 #include "configuration.h"
+#include "host.h"
 #include "NextBus.hpp"
 
 #include "newcpu.h"
@@ -79,6 +82,7 @@ const char Memory_fileid[] = "Previous memory.c";
 
 /* Pointers to memory */
 uae_u8* NEXTVideo = NULL;
+uae_u8  NEXTVideo_dirty[NEXT_VRAM_DIRTY_BLOCKS];
 uae_u8* NEXTRam   = NULL;
 uae_u8* NEXTRom   = NULL;
 uae_u8* NEXTIo    = NULL;
@@ -345,18 +349,21 @@ static uae_u32 mem_ram_bank0_bget(uaecptr addr)
 static void mem_ram_bank0_lput(uaecptr addr, uae_u32 l)
 {
 	addr &= next_ram_bank0_mask;
+	blockcache_check_write(addr, 4);
 	do_put_mem_long(NEXTRam + addr, l);
 }
 
 static void mem_ram_bank0_wput(uaecptr addr, uae_u32 w)
 {
 	addr &= next_ram_bank0_mask;
+	blockcache_check_write(addr, 2);
 	do_put_mem_word(NEXTRam + addr, w);
 }
 
 static void mem_ram_bank0_bput(uaecptr addr, uae_u32 b)
 {
 	addr &= next_ram_bank0_mask;
+	blockcache_check_write(addr, 1);
 	NEXTRam[addr] = b;
 }
 
@@ -382,18 +389,21 @@ static uae_u32 mem_ram_bank1_bget(uaecptr addr)
 static void mem_ram_bank1_lput(uaecptr addr, uae_u32 l)
 {
 	addr &= next_ram_bank1_mask;
+	blockcache_check_write(addr, 4);
 	do_put_mem_long(NEXTRam + addr, l);
 }
 
 static void mem_ram_bank1_wput(uaecptr addr, uae_u32 w)
 {
 	addr &= next_ram_bank1_mask;
+	blockcache_check_write(addr, 2);
 	do_put_mem_word(NEXTRam + addr, w);
 }
 
 static void mem_ram_bank1_bput(uaecptr addr, uae_u32 b)
 {
 	addr &= next_ram_bank1_mask;
+	blockcache_check_write(addr, 1);
 	NEXTRam[addr] = b;
 }
 
@@ -419,18 +429,21 @@ static uae_u32 mem_ram_bank2_bget(uaecptr addr)
 static void mem_ram_bank2_lput(uaecptr addr, uae_u32 l)
 {
 	addr &= next_ram_bank2_mask;
+	blockcache_check_write(addr, 4);
 	do_put_mem_long(NEXTRam + addr, l);
 }
 
 static void mem_ram_bank2_wput(uaecptr addr, uae_u32 w)
 {
 	addr &= next_ram_bank2_mask;
+	blockcache_check_write(addr, 2);
 	do_put_mem_word(NEXTRam + addr, w);
 }
 
 static void mem_ram_bank2_bput(uaecptr addr, uae_u32 b)
 {
 	addr &= next_ram_bank2_mask;
+	blockcache_check_write(addr, 1);
 	NEXTRam[addr] = b;
 }
 
@@ -456,18 +469,21 @@ static uae_u32 mem_ram_bank3_bget(uaecptr addr)
 static void mem_ram_bank3_lput(uaecptr addr, uae_u32 l)
 {
 	addr &= next_ram_bank3_mask;
+	blockcache_check_write(addr, 4);
 	do_put_mem_long(NEXTRam + addr, l);
 }
 
 static void mem_ram_bank3_wput(uaecptr addr, uae_u32 w)
 {
 	addr &= next_ram_bank3_mask;
+	blockcache_check_write(addr, 2);
 	do_put_mem_word(NEXTRam + addr, w);
 }
 
 static void mem_ram_bank3_bput(uaecptr addr, uae_u32 b)
 {
 	addr &= next_ram_bank3_mask;
+	blockcache_check_write(addr, 1);
 	NEXTRam[addr] = b;
 }
 
@@ -519,6 +535,10 @@ static void mem_ram_empty_bput(uaecptr addr, uae_u32 b)
 
 /* **** VRAM for monochrome systems **** */
 
+#define VRAM_MARK(addr, size) \
+	NEXTVideo_dirty[(addr) >> NEXT_VRAM_DIRTY_SHIFT] = \
+	NEXTVideo_dirty[((addr) + (size) - 1) >> NEXT_VRAM_DIRTY_SHIFT] = 1
+
 static uae_u32 mem_video_lget(uaecptr addr)
 {
 	addr &= NEXT_VRAM_MASK;
@@ -540,93 +560,67 @@ static uae_u32 mem_video_bget(uaecptr addr)
 static void mem_video_lput(uaecptr addr, uae_u32 l)
 {
 	addr &= NEXT_VRAM_MASK;
+	VRAM_MARK(addr, 4);
 	do_put_mem_long(NEXTVideo + addr, l);
 }
 
 static void mem_video_wput(uaecptr addr, uae_u32 w)
 {
 	addr &= NEXT_VRAM_MASK;
+	VRAM_MARK(addr, 2);
 	do_put_mem_word(NEXTVideo + addr, w);
 }
 
 static void mem_video_bput(uaecptr addr, uae_u32 b)
 {
 	addr &= NEXT_VRAM_MASK;
+	NEXTVideo_dirty[addr >> NEXT_VRAM_DIRTY_SHIFT] = 1;
 	NEXTVideo[addr] = b;
 }
 
 
 /* **** Memory banks with write functions **** */
 
-static uae_u8 mwf0[4][4] = { /* AB */
-	{ 0, 0, 0, 0 },
-	{ 0, 0, 1, 1 },
-	{ 0, 1, 1, 2 },
-	{ 0, 1, 2, 3 }
-};
-
-static uae_u8 mwf1[4][4] = { /* ceil(A+B) */
-	{ 0, 1, 2, 3 },
-	{ 1, 2, 3, 3 },
-	{ 2, 3, 3, 3 },
-	{ 3, 3, 3, 3 }
-};
-
-static uae_u8 mwf2[4][4] = { /* (1-A)B */
-	{ 0, 0, 0, 0 },
-	{ 1, 1, 0, 0 },
-	{ 2, 1, 1, 0 },
-	{ 3, 2, 1, 0 }
-};
+/* The functions operate on 2-bit pixels. All pixels of a value are processed
+ * at once by splitting it into a plane of low bits and a plane of high bits.
+ *
+ * Function0: AB
+ * Function1: ceil(A+B)
+ * Function2: (1-A)B
+ * Function3: A+B-AB
+ */
+#define MWF_LO 0x55555555
 
-static uae_u8 mwf3[4][4] = { /* A+B-AB */
-	{ 0, 1, 2, 3 },
-	{ 1, 2, 2, 3 },
-	{ 2, 2, 3, 3 },
-	{ 3, 3, 3, 3 }
-};
+/* round(A*B/3) */
+static inline uae_u32 mwf_mul(uae_u32 a, uae_u32 b)
+{
+	uae_u32 a0 = a & MWF_LO, a1 = (a >> 1) & MWF_LO;
+	uae_u32 b0 = b & MWF_LO, b1 = (b >> 1) & MWF_LO;
+	uae_u32 r1 = a1 & b1 & (a0 | b0);
+	uae_u32 r0 = (~a1 & a0 & b1) | (a1 & ~a0 & (b1 ^ b0)) | (a1 & a0 & b0);
+	
+	return (r1 << 1) | r0;
+}
 
-static uae_u32 memory_write_func(uae_u32 old, uae_u32 new, int function, int size)
+/* min(A+B,3) */
+static inline uae_u32 mwf_add(uae_u32 a, uae_u32 b)
 {
-	int a,b,i;
-	uae_u32 v=0;
-#if 0
-	write_log("[MWF] Function%i: size=%i, old=%08X, new=%08X\n",function,size,old,new);
-#endif
+	uae_u32 a0 = a & MWF_LO, a1 = (a >> 1) & MWF_LO;
+	uae_u32 b0 = b & MWF_LO, b1 = (b >> 1) & MWF_LO;
+	uae_u32 c0 = a0 & b0;
+	uae_u32 ov = (a1 & b1) | (c0 & (a1 ^ b1));
 	
+	return (((a1 ^ b1 ^ c0) | ov) << 1) | (a0 ^ b0) | ov;
+}
+
+/* Bits above the access size are don't care, they are cut off by put_* */
+static inline uae_u32 memory_write_func(uae_u32 old, uae_u32 new, int function)
+{
 	switch (function) {
-		case 0:
-			for (i=0; i<(size*4); i++) {
-				a=old>>(i*2)&3;
-				b=new>>(i*2)&3;
-				v|=mwf0[a][b]<<(i*2);
-			}
-			return v;
-		case 1:
-			for (i=0; i<(size*4); i++) {
-				a=old>>(i*2)&3;
-				b=new>>(i*2)&3;
-				v|=mwf1[a][b]<<(i*2);
-			}
-			return v;
-		case 2:
-			for (i=0; i<(size*4); i++) {
-				a=old>>(i*2)&3;
-				b=new>>(i*2)&3;
-				v|=mwf2[a][b]<<(i*2);
-			}
-			return v;
-		case 3:
-			for (i=0; i<(size*4); i++) {
-				a=old>>(i*2)&3;
-				b=new>>(i*2)&3;
-				v|=mwf3[a][b]<<(i*2);
-			}
-			return v;
-			
-		default:
-			write_log("Unknown memory write function!\n");
-			abort();
+		case 0: return mwf_mul(old, new);
+		case 1: return mwf_add(old, new);
+		case 2: return mwf_mul(old, ~new);
+		default: return ~mwf_mul(~old, ~new);
 	}
 }
 
@@ -654,40 +648,6 @@ static uae_u32 mem_ram_mwf_bget(uaecptr addr)
 	return function==0?0xFF:0;
 }
 
-static void mem_ram_mwf_lput(uaecptr addr, uae_u32 l)
-{
-	int function = (addr>>26)&0x3;
-	addr = NEXT_RAM_START|(addr&NEXT_RAM_MASK);
-	
-	uae_u32 old = get_long(addr);
-	uae_u32 val = memory_write_func(old, l, function, 4);
-	
-	put_long(addr, val);
-}
-
-static void mem_ram_mwf_wput(uaecptr addr, uae_u32 w)
-{
-	int function = (addr>>26)&0x3;
-	addr = NEXT_RAM_START|(addr&NEXT_RAM_MASK);
-	
-	uae_u32 old = get_word(addr);
-	uae_u32 val = memory_write_func(old, w, function, 2);
-	
-	put_word(addr, val);
-}
-
-static void mem_ram_mwf_bput(uaecptr addr, uae_u32 b)
-{
-	int function = (addr>>26)&0x3;
-	addr = NEXT_RAM_START|(addr&NEXT_RAM_MASK);
-	
-	uae_u32 old = get_byte(addr);
-	uae_u32 val = memory_write_func(old, b, function, 1);
-	
-	put_byte(addr, val);
-}
-
-
 static uae_u32 mem_video_mwf_lget(uaecptr addr)
 {
 	int function = (addr>>24)&0x3;
@@ -712,38 +672,34 @@ static uae_u32 mem_video_mwf_bget(uaecptr addr)
 	return function==0?0xFF:0;
 }
 
-static void mem_video_mwf_lput(uaecptr addr, uae_u32 l)
-{
-	int function = (addr>>24)&0x3;
-	addr = NEXT_VRAM_START|(addr&NEXT_VRAM_MASK);
-	
-	uae_u32 old = get_long(addr);
-	uae_u32 val = memory_write_func(old, l, function, 4);
-	
-	put_long(addr, val);
-}
-
-static void mem_video_mwf_wput(uaecptr addr, uae_u32 w)
-{
-	int function = (addr>>24)&0x3;
-	addr = NEXT_VRAM_START|(addr&NEXT_VRAM_MASK);
-	
-	uae_u32 old = get_word(addr);
-	uae_u32 val = memory_write_func(old, w, function, 2);
-	
-	put_word(addr, val);
-}
-
-static void mem_video_mwf_bput(uaecptr addr, uae_u32 b)
-{
-	int function = (addr>>24)&0x3;
-	addr = NEXT_VRAM_START|(addr&NEXT_VRAM_MASK);
-	
-	uae_u32 old = get_byte(addr);
-	uae_u32 val = memory_write_func(old, b, function, 1);
-	
-	put_byte(addr, val);
-}
+/* Each function has its own write handlers, so that it is resolved at
+ * compile time instead of on every access. */
+#define MEM_MWF_PUT(mem, n, start, mask) \
+static void mem_##mem##_mwf##n##_lput(uaecptr addr, uae_u32 l) \
+{ \
+	addr = start|(addr&mask); \
+	put_long(addr, memory_write_func(get_long(addr), l, n)); \
+} \
+static void mem_##mem##_mwf##n##_wput(uaecptr addr, uae_u32 w) \
+{ \
+	addr = start|(addr&mask); \
+	put_word(addr, memory_write_func(get_word(addr), w, n)); \
+} \
+static void mem_##mem##_mwf##n##_bput(uaecptr addr, uae_u32 b) \
+{ \
+	addr = start|(addr&mask); \
+	put_byte(addr, memory_write_func(get_byte(addr), b, n)); \
+}
+
+MEM_MWF_PUT(ram, 0, NEXT_RAM_START, NEXT_RAM_MASK)
+MEM_MWF_PUT(ram, 1, NEXT_RAM_START, NEXT_RAM_MASK)
+MEM_MWF_PUT(ram, 2, NEXT_RAM_START, NEXT_RAM_MASK)
+MEM_MWF_PUT(ram, 3, NEXT_RAM_START, NEXT_RAM_MASK)
+
+MEM_MWF_PUT(video, 0, NEXT_VRAM_START, NEXT_VRAM_MASK)
+MEM_MWF_PUT(video, 1, NEXT_VRAM_START, NEXT_VRAM_MASK)
+MEM_MWF_PUT(video, 2, NEXT_VRAM_START, NEXT_VRAM_MASK)
+MEM_MWF_PUT(video, 3, NEXT_VRAM_START, NEXT_VRAM_MASK)
 
 
 /* **** VRAM for color systems **** */
@@ -769,18 +725,21 @@ static uae_u32 mem_color_video_bget(uaecptr addr)
 static void mem_color_video_lput(uaecptr addr, uae_u32 l)
 {
 	addr &= NEXT_VRAM_COLOR_MASK;
+	VRAM_MARK(addr, 4);
 	do_put_mem_long(NEXTVideo + addr, l);
 }
 
 static void mem_color_video_wput(uaecptr addr, uae_u32 w)
 {
 	addr &= NEXT_VRAM_COLOR_MASK;
+	VRAM_MARK(addr, 2);
 	do_put_mem_word(NEXTVideo + addr, w);
 }
 
 static void mem_color_video_bput(uaecptr addr, uae_u32 b)
 {
 	addr &= NEXT_VRAM_COLOR_MASK;
+	NEXTVideo_dirty[addr >> NEXT_VRAM_DIRTY_SHIFT] = 1;
 	NEXTVideo[addr] = b;
 }
 
@@ -898,13 +857,28 @@ static addrbank RAM_bank3 =
 static addrbank RAM_empty_bank =
 {
 	mem_ram_empty_lget, mem_ram_empty_wget, mem_ram_empty_bget,
-	mem_ram_empty_lput, mem_ram_empty_wput, mem_ram_empty_bput
+	mem_ram_empty_lput, mem_ram_empty_wput, mem_ram_empty_bput,
+	BANK_EMPTY
 };
 
-static addrbank RAM_mwf_bank =
-{
-	mem_ram_mwf_lget, mem_ram_mwf_wget, mem_ram_mwf_bget,
-	mem_ram_mwf_lput, mem_ram_mwf_wput, mem_ram_mwf_bput
+static addrbank RAM_mwf_bank[4] =
+{
+	{
+		mem_ram_mwf_lget, mem_ram_mwf_wget, mem_ram_mwf_bget,
+		mem_ram_mwf0_lput, mem_ram_mwf0_wput, mem_ram_mwf0_bput
+	},
+	{
+		mem_ram_mwf_lget, mem_ram_mwf_wget, mem_ram_mwf_bget,
+		mem_ram_mwf1_lput, mem_ram_mwf1_wput, mem_ram_mwf1_bput
+	},
+	{
+		mem_ram_mwf_lget, mem_ram_mwf_wget, mem_ram_mwf_bget,
+		mem_ram_mwf2_lput, mem_ram_mwf2_wput, mem_ram_mwf2_bput
+	},
+	{
+		mem_ram_mwf_lget, mem_ram_mwf_wget, mem_ram_mwf_bget,
+		mem_ram_mwf3_lput, mem_ram_mwf3_wput, mem_ram_mwf3_bput
+	}
 };
 
 static addrbank VRAM_bank =
@@ -913,10 +887,24 @@ static addrbank VRAM_bank =
 	mem_video_lput, mem_video_wput, mem_video_bput
 };
 
-static addrbank VRAM_mwf_bank =
-{
-	mem_video_mwf_lget, mem_video_mwf_wget, mem_video_mwf_bget,
-	mem_video_mwf_lput, mem_video_mwf_wput, mem_video_mwf_bput
+static addrbank VRAM_mwf_bank[4] =
+{
+	{
+		mem_video_mwf_lget, mem_video_mwf_wget, mem_video_mwf_bget,
+		mem_video_mwf0_lput, mem_video_mwf0_wput, mem_video_mwf0_bput
+	},
+	{
+		mem_video_mwf_lget, mem_video_mwf_wget, mem_video_mwf_bget,
+		mem_video_mwf1_lput, mem_video_mwf1_wput, mem_video_mwf1_bput
+	},
+	{
+		mem_video_mwf_lget, mem_video_mwf_wget, mem_video_mwf_bget,
+		mem_video_mwf2_lput, mem_video_mwf2_wput, mem_video_mwf2_bput
+	},
+	{
+		mem_video_mwf_lget, mem_video_mwf_wget, mem_video_mwf_bget,
+		mem_video_mwf3_lput, mem_video_mwf3_wput, mem_video_mwf3_bput
+	}
 };
 
 static addrbank VRAM_color_bank =
@@ -925,10 +913,57 @@ static addrbank VRAM_color_bank =
 	mem_color_video_lput, mem_color_video_wput, mem_color_video_bput
 };
 
+/* IO register accesses, with host time accounting */
+#define MEM_IO_GET(s) \
+static uae_u32 mem_io_##s##get(uaecptr addr) \
+{ \
+	uint64_t start = host_prof_now(); \
+	uae_u32 val = IoMem_##s##get(addr); \
+	host_prof_end(HOST_PROF_IO, start); \
+	return val; \
+}
+#define MEM_IO_PUT(s) \
+static void mem_io_##s##put(uaecptr addr, uae_u32 val) \
+{ \
+	uint64_t start = host_prof_now(); \
+	IoMem_##s##put(addr, val); \
+	host_prof_end(HOST_PROF_IO, start); \
+}
+
+MEM_IO_GET(l)
+MEM_IO_GET(w)
+MEM_IO_GET(b)
+MEM_IO_PUT(l)
+MEM_IO_PUT(w)
+MEM_IO_PUT(b)
+
+/* Traced IO register accesses. They are only mapped while IO tracing is
+ * enabled, so normal accesses do not check the trace flags. */
+#define MEM_IO_GET_TRACE(s, mask, fmt) \
+static uae_u32 mem_io_##s##get_trace(uaecptr addr) \
+{ \
+	uae_u32 val = mem_io_##s##get(addr); \
+	LOG_TRACE_RING(TRACE_IOMEM_RD, "IO read." #s " $%08x = $" fmt "\n", addr, val & mask); \
+	return val; \
+}
+#define MEM_IO_PUT_TRACE(s, mask, fmt) \
+static void mem_io_##s##put_trace(uaecptr addr, uae_u32 val) \
+{ \
+	LOG_TRACE_RING(TRACE_IOMEM_WR, "IO write." #s " $%08x = $" fmt "\n", addr, val & mask); \
+	mem_io_##s##put(addr, val); \
+}
+
+MEM_IO_GET_TRACE(l, 0xffffffff, "%08x")
+MEM_IO_GET_TRACE(w, 0xffff,     "%04x")
+MEM_IO_GET_TRACE(b, 0xff,       "%02x")
+MEM_IO_PUT_TRACE(l, 0xffffffff, "%08x")
+MEM_IO_PUT_TRACE(w, 0xffff,     "%04x")
+MEM_IO_PUT_TRACE(b, 0xff,       "%02x")
+
 static addrbank IO_bank =
 {
-	IoMem_lget, IoMem_wget, IoMem_bget,
-	IoMem_lput, IoMem_wput, IoMem_bput
+	mem_io_lget, mem_io_wget, mem_io_bget,
+	mem_io_lput, mem_io_wput, mem_io_bput
 };
 
 static addrbank BMAP_bank =
@@ -991,6 +1026,7 @@ static void init_mem_banks (void)
 		put_mem_bank (bank_lput, i<<16, BusErrMem_bank.lput);
 		put_mem_bank (bank_wput, i<<16, BusErrMem_bank.wput);
 		put_mem_bank (bank_bput, i<<16, BusErrMem_bank.bput);
+		bank_type[i] = BusErrMem_bank.type;
 	}
 }
 
@@ -1007,6 +1043,38 @@ mem_put_func bank_lput[65536];
 mem_get_func bank_bget[65536];
 mem_put_func bank_bput[65536];
 
+/* Host addresses of banks that map plain memory, NULL for all others */
+uae_u8 *bank_host[65536];
+/* Same for banks that map main memory and can be written directly */
+uae_u8 *bank_host_write[65536];
+/* Type of the bank, see memory.h */
+uae_u8 bank_type[65536];
+
+static void map_banks_host(uae_u8 *base, uae_u32 mask, int start, int size, bool writable)
+{
+	int bnr;
+	
+	for (bnr = start; bnr < start + size; bnr++) {
+		bank_host[bnr] = base + ((bnr << 16) & mask);
+		bank_host_write[bnr] = writable ? bank_host[bnr] : NULL;
+	}
+}
+
+/*
+ * Let the host kernel merge identical pages of this memory with other
+ * processes. Only has an effect on Linux with KSM enabled.
+ */
+static void memory_merge_pages(void *base, int size)
+{
+#if HAVE_SYS_MMAN_H && defined(MADV_MERGEABLE)
+	if (madvise(base, size, MADV_MERGEABLE)) {
+		write_log("Memory init: Cannot mark memory mergeable: %s\n", strerror(errno));
+	}
+#else
+	write_log("Memory init: Mergeable memory is not supported on this host\n");
+#endif
+}
+
 /*
  * Initialize the memory banks
  */
@@ -1044,8 +1112,8 @@ int memory_init (void)
 	memory_uninit();
 	
 	/* Allocate memory */
-	NEXTRam   = malloc_aligned(ram_size);
-	NEXTVideo = malloc_aligned(vram_size);
+	NEXTRam   = malloc_guest(ram_size, ConfigureParams.Memory.bHugePages);
+	NEXTVideo = malloc_guest(vram_size, ConfigureParams.Memory.bHugePages);
 	NEXTIo    = malloc_aligned(NEXT_IO_ALLOC);
 	NEXTRom   = malloc_aligned(NEXT_EPROM_ALLOC);
 	
@@ -1055,9 +1123,16 @@ int memory_init (void)
 		return 1;
 	}
 	
+	/* Share identical ROM and RAM pages with other instances */
+	if (ConfigureParams.Memory.bMergeablePages) {
+		memory_merge_pages(NEXTRom, NEXT_EPROM_ALLOC);
+		memory_merge_pages(NEXTRam, ram_size);
+	}
+	
 	/* Initialise memory */
 	memset(NEXTRom, 0, NEXT_EPROM_ALLOC);
 	memset(NEXTVideo, 0, vram_size);
+	memset(NEXTVideo_dirty, 1, sizeof(NEXTVideo_dirty));
 	memset(NEXTRam, 0, ram_size);
 	memset(NEXTIo, 0, NEXT_IO_ALLOC);
 	
@@ -1081,9 +1156,11 @@ int memory_init (void)
 	
 	/* Map ROM */
 	map_banks(&ROM_bank, NEXT_EPROM_START>>16, NEXT_EPROM_SIZE>>16);
+	map_banks_host(NEXTRom, NEXT_EPROM_MASK, NEXT_EPROM_START>>16, NEXT_EPROM_SIZE>>16, false);
 	write_log("Mapping ROM at $%08x: %ikB\n", NEXT_EPROM_START, NEXT_EPROM_ALLOC>>10);
 	if (ConfigureParams.System.nMachineType != NEXT_CUBE030) {
 		map_banks(&ROM_bank, NEXT_EPROM_BMAP_START>>16, NEXT_EPROM_SIZE>>16);
+		map_banks_host(NEXTRom, NEXT_EPROM_MASK, NEXT_EPROM_BMAP_START>>16, NEXT_EPROM_SIZE>>16, false);
 		write_log("Mapping ROM through BMAP at $%08x: %ikB\n", NEXT_EPROM_BMAP_START, NEXT_EPROM_ALLOC>>10);
 	}
 	
@@ -1091,6 +1168,7 @@ int memory_init (void)
 	if (banksize[0]) {
 		next_ram_bank0_mask = next_ram_bank_mask|(banksize[0]-1);
 		map_banks(&RAM_bank0, bankstart[0]>>16, next_ram_bank_size>>16);
+		map_banks_host(NEXTRam, next_ram_bank0_mask, bankstart[0]>>16, next_ram_bank_size>>16, true);
 		write_log("Mapping main memory bank0 at $%08x: %iMB\n", bankstart[0], banksize[0]>>20);
 	} else {
 		next_ram_bank0_mask = 0;
@@ -1101,6 +1179,7 @@ int memory_init (void)
 	if (banksize[1]) {
 		next_ram_bank1_mask = next_ram_bank_mask|(banksize[1]-1);
 		map_banks(&RAM_bank1, bankstart[1]>>16, next_ram_bank_size>>16);
+		map_banks_host(NEXTRam, next_ram_bank1_mask, bankstart[1]>>16, next_ram_bank_size>>16, true);
 		write_log("Mapping main memory bank1 at $%08x: %iMB\n", bankstart[1], banksize[1]>>20);
 	} else {
 		next_ram_bank1_mask = 0;
@@ -1111,6 +1190,7 @@ int memory_init (void)
 	if (banksize[2]) {
 		next_ram_bank2_mask = next_ram_bank_mask|(banksize[2]-1);
 		map_banks(&RAM_bank2, bankstart[2]>>16, next_ram_bank_size>>16);
+		map_banks_host(NEXTRam, next_ram_bank2_mask, bankstart[2]>>16, next_ram_bank_size>>16, true);
 		write_log("Mapping main memory bank2 at $%08x: %iMB\n", bankstart[2], banksize[2]>>20);
 	} else {
 		next_ram_bank2_mask = 0;
@@ -1121,6 +1201,7 @@ int memory_init (void)
 	if (banksize[3]) {
 		next_ram_bank3_mask = next_ram_bank_mask|(banksize[3]-1);
 		map_banks(&RAM_bank3, bankstart[3]>>16, next_ram_bank_size>>16);
+		map_banks_host(NEXTRam, next_ram_bank3_mask, bankstart[3]>>16, next_ram_bank_size>>16, true);
 		write_log("Mapping main memory bank3 at $%08x: %iMB\n", bankstart[3], banksize[3]>>20);
 	} else {
 		next_ram_bank3_mask = 0;
@@ -1130,10 +1211,10 @@ int memory_init (void)
 	
 	/* Map mirrors of main memory for memory write functions */
 	if (!ConfigureParams.System.bColor && !ConfigureParams.System.bTurbo) {
-		map_banks(&RAM_mwf_bank, NEXT_RAM_MWF0_START>>16, NEXT_RAM_SIZE>>16);
-		map_banks(&RAM_mwf_bank, NEXT_RAM_MWF1_START>>16, NEXT_RAM_SIZE>>16);
-		map_banks(&RAM_mwf_bank, NEXT_RAM_MWF2_START>>16, NEXT_RAM_SIZE>>16);
-		map_banks(&RAM_mwf_bank, NEXT_RAM_MWF3_START>>16, NEXT_RAM_SIZE>>16);
+		map_banks(&RAM_mwf_bank[0], NEXT_RAM_MWF0_START>>16, NEXT_RAM_SIZE>>16);
+		map_banks(&RAM_mwf_bank[1], NEXT_RAM_MWF1_START>>16, NEXT_RAM_SIZE>>16);
+		map_banks(&RAM_mwf_bank[2], NEXT_RAM_MWF2_START>>16, NEXT_RAM_SIZE>>16);
+		map_banks(&RAM_mwf_bank[3], NEXT_RAM_MWF3_START>>16, NEXT_RAM_SIZE>>16);
 		write_log("Mapping mirrors of main memory for memory write functions:\n");
 		for (i = 0; i < 4; i++) {
 			write_log("Function%i at $%08x\n",i,NEXT_RAM_MWF0_START+NEXT_RAM_SIZE*i);
@@ -1154,10 +1235,10 @@ int memory_init (void)
 		map_banks(&VRAM_bank, NEXT_VRAM_START>>16, NEXT_VRAM_SIZE>>16);
 		write_log("Mapping video memory at $%08x: %ikB\n", NEXT_VRAM_START, NEXT_VRAM_ALLOC>>10);
 		
-		map_banks(&VRAM_mwf_bank, NEXT_VRAM_MWF0_START>>16, NEXT_VRAM_SIZE>>16);
-		map_banks(&VRAM_mwf_bank, NEXT_VRAM_MWF1_START>>16, NEXT_VRAM_SIZE>>16);
-		map_banks(&VRAM_mwf_bank, NEXT_VRAM_MWF2_START>>16, NEXT_VRAM_SIZE>>16);
-		map_banks(&VRAM_mwf_bank, NEXT_VRAM_MWF3_START>>16, NEXT_VRAM_SIZE>>16);
+		map_banks(&VRAM_mwf_bank[0], NEXT_VRAM_MWF0_START>>16, NEXT_VRAM_SIZE>>16);
+		map_banks(&VRAM_mwf_bank[1], NEXT_VRAM_MWF1_START>>16, NEXT_VRAM_SIZE>>16);
+		map_banks(&VRAM_mwf_bank[2], NEXT_VRAM_MWF2_START>>16, NEXT_VRAM_SIZE>>16);
+		map_banks(&VRAM_mwf_bank[3], NEXT_VRAM_MWF3_START>>16, NEXT_VRAM_SIZE>>16);
 		write_log("Mapping mirrors of video memory for memory write functions:\n");
 		for (i = 0; i<4; i++) {
 			write_log("Function%i at $%08x\n",i,NEXT_VRAM_MWF0_START+NEXT_VRAM_SIZE*i);
@@ -1212,6 +1293,10 @@ int memory_init (void)
 	/* Initialise boards on the NextBus */
 	nextbus_init();
 	
+	/* Drop cached code and data translations of the old memory */
+	blockcache_init(NEXTRam, ram_size);
+	hosttlb_init(NEXTRam, ram_size);
+	
 	return 0;
 }
 
@@ -1240,9 +1325,53 @@ void memory_uninit (void)
 }
 
 
+/* Consumers that need to know about mapping changes */
+#define MEMORY_MAP_LISTENERS 8
+static memory_map_func map_listener[MEMORY_MAP_LISTENERS];
+static int map_listeners = 0;
+
+void memory_add_map_listener(memory_map_func func)
+{
+	int i;
+	
+	for (i = 0; i < map_listeners; i++) {
+		if (map_listener[i] == func) {
+			return;
+		}
+	}
+	if (map_listeners < MEMORY_MAP_LISTENERS) {
+		map_listener[map_listeners++] = func;
+	} else {
+		write_log("Memory: Too many map listeners\n");
+		abort();
+	}
+}
+
+/* Switch IO register accesses between the plain and the traced functions */
+void memory_trace_io(bool enable) {
+	if (enable == (IO_bank.lget == mem_io_lget_trace))
+		return;
+	
+	IO_bank.lget = enable ? mem_io_lget_trace : mem_io_lget;
+	IO_bank.wget = enable ? mem_io_wget_trace : mem_io_wget;
+	IO_bank.bget = enable ? mem_io_bget_trace : mem_io_bget;
+	IO_bank.lput = enable ? mem_io_lput_trace : mem_io_lput;
+	IO_bank.wput = enable ? mem_io_wput_trace : mem_io_wput;
+	IO_bank.bput = enable ? mem_io_bput_trace : mem_io_bput;
+	
+	map_banks(&IO_bank, NEXT_IO_START>>16, NEXT_IO_SIZE>>16);
+	if (ConfigureParams.System.nMachineType != NEXT_CUBE030) {
+		map_banks(&IO_bank, NEXT_IO_BMAP_START>>16, NEXT_IO_SIZE>>16);
+	}
+}
+
 void map_banks (addrbank *bank, int start, int size) {
-	int bnr;
+	int bnr, i;
 	
+	/* Cached code and data translations may point to the old banks */
+	for (i = 0; i < map_listeners; i++) {
+		map_listener[i](start, size);
+	}
 	for (bnr = start; bnr < start + size; bnr++) {
 		put_mem_bank (bank_lget, bnr << 16, bank->lget);
 		put_mem_bank (bank_wget, bnr << 16, bank->wget);
@@ -1250,5 +1379,8 @@ void map_banks (addrbank *bank, int start, int size) {
 		put_mem_bank (bank_lput, bnr << 16, bank->lput);
 		put_mem_bank (bank_wput, bnr << 16, bank->wput);
 		put_mem_bank (bank_bput, bnr << 16, bank->bput);
+		bank_host[bnr] = NULL;
+		bank_host_write[bnr] = NULL;
+		bank_type[bnr] = bank->type;
 	}
 }
@@ -26,13 +26,24 @@ extern uae_u8* NEXTRam;
 extern uae_u8* NEXTRom;
 extern uae_u8* NEXTIo;
 
+/* One flag per 256 bytes of VRAM, set on every write */
+#define NEXT_VRAM_DIRTY_SHIFT   8
+#define NEXT_VRAM_DIRTY_BLOCKS  (0x00200000 >> NEXT_VRAM_DIRTY_SHIFT)
+extern uae_u8 NEXTVideo_dirty[NEXT_VRAM_DIRTY_BLOCKS];
+
 typedef uae_u32 (*mem_get_func)(uaecptr) REGPARAM;
 typedef void (*mem_put_func)(uaecptr, uae_u32) REGPARAM;
 
+/* Bank classification for accesses that can be handled without calling
+ * the bank functions */
+#define BANK_SPECIAL    0   /* Accesses go through the bank functions */
+#define BANK_EMPTY      1   /* Reads return the address, writes are ignored */
+
 typedef struct {
 	/* These ones should be self-explanatory... */
 	mem_get_func lget, wget, bget;
 	mem_put_func lput, wput, bput;
+	uae_u8 type;
 } addrbank;
 
 #define bankindex(addr) (((uaecptr)(addr)) >> 16)
@@ -45,12 +56,23 @@ extern mem_put_func bank_lput[65536];
 extern mem_put_func bank_wput[65536];
 extern mem_put_func bank_bput[65536];
 
+extern uae_u8 *bank_host[65536];
+extern uae_u8 *bank_host_write[65536];
+extern uae_u8 bank_type[65536];
+
 #define get_mem_bank(bank, addr)    (bank[bankindex(addr)])
 #define put_mem_bank(bank, addr, b) (bank[bankindex(addr)] = (b))
+#define get_host_address(addr)      (bank_host[bankindex(addr)] + ((addr) & 0xffff))
 
 int  memory_init (void);
 void memory_uninit (void);
 void map_banks(addrbank *bank, int first, int count);
+void memory_trace_io(bool enable);
+
+/* Called with a range of banks before their mapping changes. Caches of
+ * host addresses use this to drop entries that point into these banks. */
+typedef void (*memory_map_func)(int first, int count);
+void memory_add_map_listener(memory_map_func func);
 
 #define get_long(addr)   (call_mem_get_func(get_mem_bank(bank_lget, addr), addr))
 #define get_word(addr)   (call_mem_get_func(get_mem_bank(bank_wget, addr), addr))
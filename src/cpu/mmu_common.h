@@ -3,6 +3,9 @@
 
 #include "uae/types.h"
 #include "uae/likely.h"
+#ifdef WINUAE_FOR_PREVIOUS
+#include "blockcache.h"
+#endif
 
 #define MMUDEBUG 0
 #define MMUINSDEBUG 0
@@ -25,20 +28,31 @@ struct m68k_exception {
 #else
 /* we are in plain C, just use a stack of long jumps */
 #include <setjmp.h>
-extern jmp_buf __exbuf;
+/* _setjmp does not save the signal mask, which costs a system call on
+ * BSD and macOS. Entering a TRY block only stores the registers into the
+ * next slot of the try stack, so the no-fault path stays cheap. */
+#ifdef _WIN32
+#define TRY_SETJMP(buf)       setjmp(buf)
+#define TRY_LONGJMP(buf, x)   longjmp(buf, x)
+#else
+#define TRY_SETJMP(buf)       _setjmp(buf)
+#define TRY_LONGJMP(buf, x)   _longjmp(buf, x)
+#endif
+#define MAX_TRY_STACK 256
+extern jmp_buf __exstack[MAX_TRY_STACK];
+extern int     __exdepth;
 extern int     __exvalue;
-#define TRY(DUMMY)       __exvalue=setjmp(__exbuf);       \
-                  if (__exvalue==0) { __pushtry(&__exbuf);
-#define CATCH(x)  __poptry(); } else {m68k_exception x=__exvalue; x=x;
-#define ENDTRY    __poptry();}
-#define STOPTRY   __poptry()
-#define THROW(x) if (__is_catched()) {longjmp(__exbuf,x);}
-#define THROW_AGAIN(var) if (__is_catched()) longjmp(*__poptry(),__exvalue)
+#define TRY(DUMMY)       if (__exdepth>=MAX_TRY_STACK) __tryoverflow(); \
+                  __exvalue=TRY_SETJMP(__exstack[__exdepth]); \
+                  if (__exvalue==0) { __exdepth++;
+#define CATCH(x)  __exdepth--; } else {m68k_exception x=__exvalue; x=x;
+#define ENDTRY    __exdepth--;}
+#define STOPTRY   __exdepth--
+#define THROW(x) if (__exdepth>0) {TRY_LONGJMP(__exstack[__exdepth-1],x);}
+#define THROW_AGAIN(var) if (__exdepth>1) {__exdepth--; TRY_LONGJMP(__exstack[__exdepth-1],__exvalue);}
 #define SAVE_EXCEPTION
 #define RESTORE_EXCEPTION
-jmp_buf* __poptry(void);
-void __pushtry(jmp_buf *j);
-int __is_catched(void);
+void __tryoverflow(void);
 
 typedef int m68k_exception;
 
@@ -118,6 +132,90 @@ static ALWAYS_INLINE bool is_unaligned_bus(uaecptr addr, int size)
     return (addr & (size - 1));
 }
 
+#ifdef WINUAE_FOR_PREVIOUS
+/* Banks that map plain memory are accessed through their host address.
+ * Accesses crossing a bank boundary take the slow path, because the next
+ * bank does not need to be adjacent on the host. Empty banks are handled
+ * inline, everything else calls the bank functions. */
+#define phys_is_direct(addr, size)  (((addr) & 0xffff) <= 0x10000 - (size))
+
+static ALWAYS_INLINE uae_u8 *phys_host_write(uaecptr addr, int size)
+{
+	uae_u8 *p = bank_host_write[bankindex(addr)];
+
+	if (!p || !phys_is_direct(addr, size))
+		return NULL;
+	p += addr & 0xffff;
+	blockcache_check_write(p - NEXTRam, size);
+	return p;
+}
+static ALWAYS_INLINE uae_u8 *phys_host_read(uaecptr addr, int size)
+{
+	uae_u8 *p = bank_host[bankindex(addr)];
+
+	if (!p || !phys_is_direct(addr, size))
+		return NULL;
+	return p + (addr & 0xffff);
+}
+
+static ALWAYS_INLINE void phys_put_long(uaecptr addr, uae_u32 l)
+{
+	uae_u8 *p = phys_host_write(addr, 4);
+
+	if (likely(p))
+		do_put_mem_long(p, l);
+	else if (bank_type[bankindex(addr)] != BANK_EMPTY)
+		put_long(addr, l);
+}
+static ALWAYS_INLINE void phys_put_word(uaecptr addr, uae_u32 w)
+{
+	uae_u8 *p = phys_host_write(addr, 2);
+
+	if (likely(p))
+		do_put_mem_word(p, w);
+	else if (bank_type[bankindex(addr)] != BANK_EMPTY)
+		put_word(addr, w);
+}
+static ALWAYS_INLINE void phys_put_byte(uaecptr addr, uae_u32 b)
+{
+	uae_u8 *p = phys_host_write(addr, 1);
+
+	if (likely(p))
+		*p = b;
+	else if (bank_type[bankindex(addr)] != BANK_EMPTY)
+		put_byte(addr, b);
+}
+static ALWAYS_INLINE uae_u32 phys_get_long(uaecptr addr)
+{
+	uae_u8 *p = phys_host_read(addr, 4);
+
+	if (likely(p))
+		return do_get_mem_long(p);
+	if (bank_type[bankindex(addr)] == BANK_EMPTY)
+		return addr;
+	return get_long(addr);
+}
+static ALWAYS_INLINE uae_u32 phys_get_word(uaecptr addr)
+{
+	uae_u8 *p = phys_host_read(addr, 2);
+
+	if (likely(p))
+		return do_get_mem_word(p);
+	if (bank_type[bankindex(addr)] == BANK_EMPTY)
+		return addr;
+	return get_word(addr);
+}
+static ALWAYS_INLINE uae_u32 phys_get_byte(uaecptr addr)
+{
+	uae_u8 *p = phys_host_read(addr, 1);
+
+	if (likely(p))
+		return *p;
+	if (bank_type[bankindex(addr)] == BANK_EMPTY)
+		return addr;
+	return get_byte(addr);
+}
+#else
 static ALWAYS_INLINE void phys_put_long(uaecptr addr, uae_u32 l)
 {
     put_long(addr, l);
@@ -143,6 +241,8 @@ static ALWAYS_INLINE uae_u32 phys_get_byte(uaecptr addr)
     return get_byte(addr);
 }
 
+#endif
+
 extern uae_u32(*x_phys_get_iword)(uaecptr);
 extern uae_u32(*x_phys_get_ilong)(uaecptr);
 extern uae_u32(*x_phys_get_byte)(uaecptr);
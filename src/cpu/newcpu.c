@@ -33,6 +33,7 @@
 #include "disasm.h"
 #include "cpummu.h"
 #include "cpummu030.h"
+#include "blockcache.h"
 #include "cputbl.h"
 #include "cpu_prefetch.h"
 #include "debugmem.h"
@@ -44,6 +45,7 @@
 #include "m68000.h"
 #include "reset.h"
 #include "cycInt.h"
+#include "host.h"
 #include "dsp.h"
 #include "dimension.hpp"
 #include "sysReg.h"
@@ -134,7 +136,16 @@ static struct cputbl_data cpudatatbl[65536];
 
 struct mmufixup mmufixup[2];
 
+#ifdef WINUAE_FOR_PREVIOUS
+/* Opcode counts for the gencpu handler layout, see ENABLE_OPCODE_COUNTS */
+#if ENABLE_OPCODE_COUNTS
+#define COUNT_INSTRS 2
+#else
 #define COUNT_INSTRS 0
+#endif
+#else
+#define COUNT_INSTRS 0
+#endif
 #define MC68060_PCR   0x04300000
 #define MC68EC060_PCR 0x04310000
 
@@ -150,6 +161,10 @@ static int dcachelinecnt;
 static struct cache040 icaches040[CACHESETS060];
 static struct cache040 dcaches040[CACHESETS060];
 static int cache_lastline; 
+#ifdef WINUAE_FOR_PREVIOUS
+/* Cache lines are only ever filled by the prefetch and cycle exact loops */
+static bool caches040_used = true;
+#endif
 
 static int fallback_cpu_model, fallback_mmu_model, fallback_fpu_model;
 static bool fallback_cpu_compatible, fallback_cpu_address_space_24;
@@ -174,10 +189,16 @@ static uae_u16 opcodenums[65536];
 
 static int compfn (const void *el1, const void *el2)
 {
+#ifdef WINUAE_FOR_PREVIOUS
+	unsigned long int c1 = instrcount[*(const uae_u16 *)el1];
+	unsigned long int c2 = instrcount[*(const uae_u16 *)el2];
+	return c1 < c2 ? 1 : c1 > c2 ? -1 : 0;
+#else
 	return instrcount[*(const uae_u16 *)el1] < instrcount[*(const uae_u16 *)el2];
+#endif
 }
 
-static TCHAR *icountfilename (void)
+static const TCHAR *icountfilename (void)
 {
 	TCHAR *name = getenv ("INSNCOUNT");
 	if (name)
@@ -188,9 +209,15 @@ static TCHAR *icountfilename (void)
 void dump_counts (void)
 {
 	FILE *f = fopen (icountfilename (), "w");
-	unsigned long int total;
+	unsigned long int total = 0;
 	int i;
 
+#ifdef WINUAE_FOR_PREVIOUS
+	if (!f) {
+		write_log (_T("Cannot write instruction count file %s\n"), icountfilename ());
+		return;
+	}
+#endif
 	write_log (_T("Writing instruction count file...\n"));
 	for (i = 0; i < 65536; i++) {
 		opcodenums[i] = i;
@@ -924,21 +951,6 @@ static void set_x_ifetches(void)
 
 #ifdef WINUAE_FOR_HATARI
 
-static void trace_cpu_disasm(void)
-{
-#ifndef WINUAE_FOR_PREVIOUS
-	if (LOG_TRACE_LEVEL(TRACE_CPU_VIDEO_CYCLES)) {
-		int FrameCycles, HblCounterVideo, LineCycles;
-		Video_GetPosition ( &FrameCycles, &HblCounterVideo, &LineCycles );
-		LOG_TRACE_DIRECT_INIT ();
-		LOG_TRACE_DIRECT ( "cpu video_cyc=%6d %3d@%3d %"PRIu64" : ",
-				   FrameCycles, LineCycles, HblCounterVideo,
-				   CyclesGlobalClockCounter );
-	}
-#endif
-	m68k_disasm_file(TraceFile, m68k_getpc (), NULL, m68k_getpc (), 1);
-}
-
 void (*x_do_cycles_hatari_blitter_save)(int);
 void (*x_do_cycles_pre_hatari_blitter_save)(int);
 void (*x_do_cycles_post_hatari_blitter_save)(int, uae_u32);
@@ -1757,6 +1769,11 @@ static void flush_cpu_caches_040_2(int cache, int scope, uaecptr addr, bool push
 	if (cache & 2) {
 		regs.prefetch020addr = 0xffffffff;
 	}
+#ifdef WINUAE_FOR_PREVIOUS
+	if (!caches040_used) {
+		return;
+	}
+#endif
 	for (int k = 0; k < 2; k++) {
 		if (cache & (1 << k)) {
 			if (scope == 3) {
@@ -1891,6 +1908,15 @@ void set_cpu_caches (bool flush)
 
 STATIC_INLINE void count_instr (uae_u32 opcode)
 {
+#if COUNT_INSTRS == 2
+	/* gencpu lays out the handlers, so count per handler */
+	if (table68k[opcode].handler != -1)
+		instrcount[table68k[opcode].handler]++;
+	else
+		instrcount[opcode]++;
+#elif COUNT_INSTRS == 1
+	instrcount[opcode]++;
+#endif
 }
 
 static uae_u32 opcode_swap(uae_u16 opcode)
@@ -2017,6 +2043,13 @@ static void build_cpufunctbl (void)
 		cpudatatbl[opcode].branch = tbl[i].branch;
 	}
 
+#ifdef WINUAE_FOR_PREVIOUS
+	caches040_used = !currprefs.cpu_no_caches || currprefs.cpu_compatible ||
+	                 currprefs.cpu_memory_cycle_exact || currprefs.cpu_data_cache;
+	if (currprefs.cpu_model >= 68040) {
+		write_log(_T("68040 cache line emulation %s\n"), caches040_used ? _T("enabled") : _T("disabled"));
+	}
+#endif
 	/* hack fpu to 68000/68010 mode */
 #ifndef WINUAE_FOR_PREVIOUS
 	if (currprefs.fpu_model && currprefs.cpu_model < 68020) {
@@ -2114,6 +2147,10 @@ static void build_cpufunctbl (void)
 	write_log(_T("JIT: &build_comp = %p\n"), &build_comp);
 	build_comp ();
 #endif
+#ifdef WINUAE_FOR_PREVIOUS
+	/* Cached handlers refer to the old table */
+	blockcache_flush();
+#endif
 
 	write_log(_T("CPU=%d, FPU=%d, MMU=%d."),
 		currprefs.cpu_model,
@@ -2277,6 +2314,9 @@ static void prefs_changed_cpu (void)
 	currprefs.cpu_model = changed_prefs.cpu_model;
 	currprefs.fpu_model = changed_prefs.fpu_model;
 	currprefs.fpu_revision = changed_prefs.fpu_revision;
+	currprefs.fpu_mode = changed_prefs.fpu_mode;
+	currprefs.fpu_strict = changed_prefs.fpu_strict;
+	currprefs.cpu_no_caches = changed_prefs.cpu_no_caches;
 	if (currprefs.mmu_model != changed_prefs.mmu_model) {
 		int oldmmu = currprefs.mmu_model;
 		currprefs.mmu_model = changed_prefs.mmu_model;
@@ -2333,9 +2373,12 @@ static int check_prefs_changed_cpu2(void)
 		|| currprefs.cpu_model != changed_prefs.cpu_model
 		|| currprefs.fpu_model != changed_prefs.fpu_model
 		|| currprefs.fpu_revision != changed_prefs.fpu_revision
+		|| currprefs.fpu_mode != changed_prefs.fpu_mode
+		|| currprefs.fpu_strict != changed_prefs.fpu_strict
 		|| currprefs.mmu_model != changed_prefs.mmu_model
 		|| currprefs.mmu_ec != changed_prefs.mmu_ec
 		|| currprefs.cpu_data_cache != changed_prefs.cpu_data_cache
+		|| currprefs.cpu_no_caches != changed_prefs.cpu_no_caches
 		|| currprefs.address_space_24 != changed_prefs.address_space_24  /* WINUAE_FOR_HATARI */
 		|| currprefs.int_no_unimplemented != changed_prefs.int_no_unimplemented
 		|| currprefs.fpu_no_unimplemented != changed_prefs.fpu_no_unimplemented
@@ -2402,8 +2445,9 @@ void init_m68k (void)
 			uae_u32 opcode, count, total;
 			TCHAR name[20];
 			write_log (_T("Reading instruction count file...\n"));
-			fscanf (f, "Total: %lu\n", &total);
-			while (fscanf (f, "%x: %lu %s\n", &opcode, &count, name) == 3) {
+			if (fscanf (f, "Total: %u\n", &total) != 1)
+				total = 0;
+			while (fscanf (f, "%x: %u %19s\n", &opcode, &count, name) == 3) {
 				instrcount[opcode] = count;
 			}
 			fclose (f);
@@ -2416,8 +2460,15 @@ void init_m68k (void)
 	write_log (_T("%d CPU functions\n"), nr_cpuop_funcs);
 }
 
+#if defined(WINUAE_FOR_PREVIOUS) && defined(__GNUC__)
+/* Start the hot registers and the flags on their own cache lines */
+struct regstruct regs __attribute__((aligned(64)));
+struct regstruct mmu_backup_regs;
+struct flag_struct regflags __attribute__((aligned(64)));
+#else
 struct regstruct regs, mmu_backup_regs;
 struct flag_struct regflags;
+#endif
 static int m68kpc_offset;
 
 #ifndef WINUAE_FOR_HATARI
@@ -5079,6 +5130,7 @@ static void debug_cpu_stop(void)
 }
 
 // give other MPUs (DSP, i860) some time to run on m68k thread
+#define ND_RUN_CYCLES 100
 static inline void run_other_MPUs(void)
 {
 	static int ndCycles = 0;
@@ -5086,17 +5138,29 @@ static inline void run_other_MPUs(void)
 	ndCycles += cpu_cycles;
 	// bundle some 68k cycles for MPUs
 #if ENABLE_DSP_EMU
-	if(dsp_core.running)
-		DSP_Run(cpu_cycles);
+	if(dsp_core.running) {
+		// the DSP adapts its batch size to the 68k's host port activity
+		DSP_BatchCycles += cpu_cycles;
+		if(DSP_BatchCycles > DSP_Quantum) {
+			uint64_t start = host_prof_now();
+			DSP_Run(0);
+			host_prof_end(HOST_PROF_DSP, start);
+		}
+	}
 #endif
-	if(ndCycles > 100) {
+	if(ndCycles > ND_RUN_CYCLES) {
 		i860_Run(ndCycles);
+		// NeXTbus boards update their interrupt lines from any thread
+		nd_nbic_interrupt();
 		ndCycles = 0;
 	}
 
 	/* We can have several events at the same time before the next CPU instruction */
 	while (PendingInterrupt.time <= 0 && PendingInterrupt.pFunction) {
+		int subsystem = CycInt_ActiveSubsystem();
+		uint64_t start = host_prof_now();
 		CALL_VAR(PendingInterrupt.pFunction); /* call the event handler */
+		host_prof_end(subsystem, start);
 	}
 }
 
@@ -5299,14 +5363,6 @@ static void m68k_run_1 (void)
 
 				count_instr (r->opcode);
 
-#ifdef WINUAE_FOR_HATARI
-				//m68k_dumpstate_file(stderr, NULL, 0xffffffff);
-				if ((LOG_TRACE_LEVEL(TRACE_CPU_DISASM)) && (!regs.stopped))
-				{
-					trace_cpu_disasm();
-				}
-#endif
-
 #if DEBUG_CD32CDTVIO
 				out_cd32io (m68k_getpc ());
 #endif
@@ -5440,14 +5496,6 @@ static void m68k_run_1_ce (void)
 			while (!exit) {
 				r->opcode = r->ir;
 
-#ifdef WINUAE_FOR_HATARI
-				//m68k_dumpstate_file(stderr, NULL, 0xffffffff);
-				if ((LOG_TRACE_LEVEL(TRACE_CPU_DISASM)) && (!regs.stopped))
-				{
-					trace_cpu_disasm();
-				}
-#endif
-
 #if DEBUG_CD32CDTVIO
 				out_cd32io (m68k_getpc ());
 #endif
@@ -6041,14 +6089,6 @@ static void m68k_run_jit(void)
 		__try {
 #endif
 			for (;;) {
-#ifdef WINUAE_FOR_HATARI
-				//m68k_dumpstate_file(stderr, NULL, 0xffffffff);
-				if ((LOG_TRACE_LEVEL(TRACE_CPU_DISASM)) && (!regs.stopped))
-				{
-					trace_cpu_disasm();
-				}
-#endif
-
 				((compiled_handler*)(pushall_call_handler))();
 				/* Whenever we return from that, we should check spcflags */
 				check_uae_int_request();
@@ -6201,13 +6241,6 @@ static void m68k_run_mmu060 (void)
 		check_debugger();
 		TRY (prb) {
 			for (;;) {
-#ifdef WINUAE_FOR_HATARI
-				//m68k_dumpstate_file(stderr, NULL, 0xffffffff);
-				if ((LOG_TRACE_LEVEL(TRACE_CPU_DISASM)) && (!regs.stopped))
-				{
-					trace_cpu_disasm();
-				}
-#endif
 				f.cznv = regflags.cznv;
 				f.x = regflags.x;
 				regs.instruction_pc = m68k_getpc ();
@@ -6279,6 +6312,9 @@ static void m68k_run_mmu040 (void)
 {
 	struct flag_struct f;
 	int halt = 0;
+#ifdef WINUAE_FOR_PREVIOUS
+	cpuop_func *opfunc;
+#endif
 
 	check_halt();
 #ifdef WINUAE_FOR_HATARI
@@ -6297,10 +6333,31 @@ static void m68k_run_mmu040 (void)
 				do_cycles (cpu_cycles);
 
 				mmu_opcode = -1;
+#ifdef WINUAE_FOR_PREVIOUS
+				opfunc = NULL;
+				if (blockcache_enabled)
+					mmu_opcode = regs.opcode = blockcache_fetch (regs.instruction_pc, &opfunc);
+				else
+#endif
 				mmu_opcode = regs.opcode = x_prefetch (0);
 				count_instr (regs.opcode);
+#ifdef WINUAE_FOR_PREVIOUS
+				if (opfunc)
+					cpu_cycles = (*opfunc)(regs.opcode);
+				else
+#endif
 				cpu_cycles = (*cpufunctbl[regs.opcode])(regs.opcode);
 
+#ifdef WINUAE_FOR_PREVIOUS
+				/* Skip cycles while stopped or branching to itself */
+				if (unlikely(regs.stopped || regs.opcode == 0x60fe) &&
+				    !(regs.spcflags & (SPCFLAG_INT | SPCFLAG_DOINT)))
+					cpu_cycles = CycInt_Idle(cpu_cycles);
+				/* or while the kernel idles with interrupts enabled */
+				else if (unlikely(M68000_InKernelIdle(regs.instruction_pc)) && regs.intmask == 0 &&
+				         !(regs.spcflags & (SPCFLAG_INT | SPCFLAG_DOINT)))
+					cpu_cycles = M68000_KernelIdle(cpu_cycles);
+#endif
 #ifdef WINUAE_FOR_HATARI
 				M68000_AddCycles(cpu_cycles);
 
@@ -6342,6 +6399,9 @@ static void m68k_run_mmu030 (void)
 {
 	struct flag_struct f;
 	int halt = 0;
+#ifdef WINUAE_FOR_PREVIOUS
+	cpuop_func *opfunc;
+#endif
 
 #ifdef WINUAE_FOR_HATARI
 	Log_Printf(LOG_DEBUG,  "m68k_run_mmu030\n");
@@ -6359,6 +6419,9 @@ insretry:
 				regs.instruction_pc = m68k_getpc ();
 				f.cznv = regflags.cznv;
 				f.x = regflags.x;
+#ifdef WINUAE_FOR_PREVIOUS
+				opfunc = NULL;
+#endif
 
 				mmu030_state[0] = mmu030_state[1] = mmu030_state[2] = 0;
 				mmu030_opcode = -1;
@@ -6380,6 +6443,10 @@ insretry:
 				} else if (mmu030_opcode_stageb < 0) {
 					if (currprefs.cpu_compatible)
 						regs.opcode = regs.irc;
+#ifdef WINUAE_FOR_PREVIOUS
+					else if (blockcache_enabled)
+						regs.opcode = blockcache_fetch (regs.instruction_pc, &opfunc);
+#endif
 					else
 						regs.opcode = x_prefetch (0);
 				} else {
@@ -6397,6 +6464,11 @@ insretry:
 
 					mmu030_retry = false;
 
+#ifdef WINUAE_FOR_PREVIOUS
+					if (opfunc)
+						cpu_cycles = (*opfunc)(regs.opcode);
+					else
+#endif
 					cpu_cycles = (*cpufunctbl[regs.opcode])(regs.opcode);
 
 					cnt--; // so that we don't get in infinite loop if things go horribly wrong
@@ -6412,6 +6484,16 @@ insretry:
 
 				mmu030_opcode = -1;
 
+#ifdef WINUAE_FOR_PREVIOUS
+				/* Skip cycles while stopped or branching to itself */
+				if (unlikely(regs.stopped || regs.opcode == 0x60fe) &&
+				    !(regs.spcflags & (SPCFLAG_INT | SPCFLAG_DOINT)))
+					cpu_cycles = CycInt_Idle(cpu_cycles);
+				/* or while the kernel idles with interrupts enabled */
+				else if (unlikely(M68000_InKernelIdle(regs.instruction_pc)) && regs.intmask == 0 &&
+				         !(regs.spcflags & (SPCFLAG_INT | SPCFLAG_DOINT)))
+					cpu_cycles = M68000_KernelIdle(cpu_cycles);
+#endif
 #ifdef WINUAE_FOR_HATARI
 				M68000_AddCycles(cpu_cycles);
 
@@ -6475,11 +6557,6 @@ static void m68k_run_3ce (void)
 		TRY(prb) {
 			while (!exit) {
 #ifdef WINUAE_FOR_HATARI
-				//m68k_dumpstate_file(stderr, NULL, 0xffffffff);
-				if ((LOG_TRACE_LEVEL(TRACE_CPU_DISASM)) && (!regs.stopped))
-				{
-					trace_cpu_disasm();
-				}
 				currcycle = CYCLE_UNIT / 2;	/* Assume at least 1 cycle per instruction */
 #endif
 				evt_t c = get_cycles();
@@ -6573,13 +6650,6 @@ static void m68k_run_3p(void)
 		check_debugger();
 		TRY(prb) {
 			while (!exit) {
-#ifdef WINUAE_FOR_HATARI
-				//m68k_dumpstate_file(stderr, NULL, 0xffffffff);
-				if ((LOG_TRACE_LEVEL(TRACE_CPU_DISASM)) && (!regs.stopped))
-				{
-					trace_cpu_disasm();
-				}
-#endif
 				r->instruction_pc = m68k_getpc();
 				r->opcode = get_iword_cache_040(0);
 				// "prefetch"
@@ -6710,10 +6780,6 @@ static void m68k_run_2ce (void)
 				static int prevopcode;
 #endif
 #ifdef WINUAE_FOR_HATARI
-				//m68k_dumpstate_file(stderr, NULL, 0xffffffff);
-				if ((LOG_TRACE_LEVEL(TRACE_CPU_DISASM)) && (!regs.stopped))
-				{
-					trace_cpu_disasm();
 #if 0
 // logs to debug data cache issues
 struct cache030 *c1 ,*c2;
@@ -6724,7 +6790,6 @@ c2 = getcache030 (dcaches030, (uaecptr)0x7f8192+4, &tag2, &lws2);
 fprintf ( stderr , "cache valid %d tag1 %x lws1 %x ctag %x data %x mem=%x\n" , c1->valid[lws1] , tag1 , lws1 , c1->tag , c1->data[lws1] , get_long(0x27ece) );
 //fprintf ( stderr , "cache valid %d tag2 %x lws2 %x ctag %x data %x mem=%x\n" , c2->valid[lws2] , tag2 , lws2 , c2->tag , c2->data[lws2] , get_long(0x7f8192+4) );
 #endif
-				}
 
 				currcycle = 0;
 #endif
@@ -6906,13 +6971,6 @@ static void m68k_run_2p (void)
 			}
 
 			while (!exit) {
-#ifdef WINUAE_FOR_HATARI
-				//m68k_dumpstate_file(stderr, NULL, 0xffffffff);
-				if ((LOG_TRACE_LEVEL(TRACE_CPU_DISASM)) && (!regs.stopped))
-				{
-					trace_cpu_disasm();
-				}
-#endif
 				r->instruction_pc = m68k_getpc ();
 				r->opcode = regs.irc;
 
@@ -7101,13 +7159,6 @@ static void m68k_run_2_000(void)
 		check_debugger();
 		TRY(prb) {
 			while (!exit) {
-#ifdef WINUAE_FOR_HATARI
-				//m68k_dumpstate_file(stderr, NULL, 0xffffffff);
-				if ((LOG_TRACE_LEVEL(TRACE_CPU_DISASM)) && (!regs.stopped))
-				{
-					trace_cpu_disasm();
-				}
-#endif
 				r->instruction_pc = m68k_getpc ();
 
 				r->opcode = x_get_iword(0);
@@ -7191,13 +7242,6 @@ static void m68k_run_2_020(void)
 		check_debugger();
 		TRY(prb) {
 			while (!exit) {
-#ifdef WINUAE_FOR_HATARI
-				//m68k_dumpstate_file(stderr, NULL, 0xffffffff);
-				if ((LOG_TRACE_LEVEL(TRACE_CPU_DISASM)) && (!regs.stopped))
-				{
-					trace_cpu_disasm();
-				}
-#endif
 				r->instruction_pc = m68k_getpc();
 
 				r->opcode = x_get_iword(0);
@@ -7265,13 +7309,6 @@ static void m68k_run_2_020(void)
 static void m68k_run_mmu (void)
 {
 	for (;;) {
-#ifdef WINUAE_FOR_HATARI
-		//m68k_dumpstate_file(stderr, NULL, 0xffffffff);
-		if ((LOG_TRACE_LEVEL(TRACE_CPU_DISASM)) && (!regs.stopped))
-		{
-			trace_cpu_disasm();
-		}
-#endif
 		regs.opcode = get_iiword (0);
 		do_cycles (cpu_cycles);
 		mmu_backup_regs = regs;
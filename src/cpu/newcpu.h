@@ -192,6 +192,41 @@ typedef struct
 
 struct regstruct
 {
+#ifdef WINUAE_FOR_PREVIOUS
+	/* Used by every instruction, kept together in the first two cache lines */
+	uae_u32 regs[16];
+
+	uae_u32 pc;
+	volatile uae_atomic spcflags;
+	uae_u8 *pc_p;
+	uae_u8 *pc_oldp;
+	uae_u32 instruction_pc;
+	uae_u16 opcode;
+	uae_u16 irc, ir, ird;
+	int loop_mode;
+	int instruction_cnt;
+	uae_u32 address_space_mask;
+	uae_u16 sr;
+	flagtype t1;
+	flagtype t0;
+	flagtype s;
+	flagtype m;
+	flagtype stopped;
+	int intmask;
+
+	uae_u32 instruction_pc_user_exception;
+	uae_u32 trace_pc;
+
+	uae_u32 last_prefetch;
+	uae_u32 chipset_latch_rw;
+	uae_u32 chipset_latch_read;
+	uae_u32 chipset_latch_write;
+	uae_u16 db, write_buffer, read_buffer;
+
+	uaecptr usp, isp, msp;
+	int halted;
+	int exception;
+#else
 	uae_u32 regs[16];
 
 	uae_u32 pc;
@@ -222,6 +257,7 @@ struct regstruct
 	int halted;
 	int exception;
 	int intmask;
+#endif
 	int ipl[2], ipl_pin, ipl_pin_p;
 	int lastipl;
 	evt_t ipl_pin_change_evt, ipl_pin_change_evt_p;
@@ -260,7 +296,9 @@ struct regstruct
 #endif
 
 	uae_u32 pcr;
+#ifndef WINUAE_FOR_PREVIOUS
 	uae_u32 address_space_mask;
+#endif
 
 	uae_u16 prefetch020[CPU_PIPELINE_MAX];
 	uae_u8 prefetch020_valid[CPU_PIPELINE_MAX];
@@ -1404,10 +1404,68 @@ uae_u32 exception_pc(int nr)
 	return m68k_getpc();
 }
 
+#ifdef WINUAE_FOR_PREVIOUS
+/* NeXTSTEP takes TRAP #0 for every system call and 68040 access errors for
+ * page faults. Their frames are assembled first and then stored with
+ * aligned long writes, which halves the number of translated stack accesses.
+ * Returns false if the frame has to be built the generic way. */
+static bool Exception_build_stack_frame_fast(uae_u32 oldpc, uae_u32 currpc, uae_u32 ssw, int nr, int format)
+{
+	uae_u16 frame[30];
+	int n = 30, i;
+	uaecptr sp;
+
+	if (currprefs.cpu_model < 68030 || currprefs.cpu_cycle_exact || (m68k_areg(regs, 7) & 3))
+		return false;
+
+#define FRAME_WORD(v) frame[--n] = (uae_u16)(v)
+#define FRAME_LONG(v) do { uae_u32 l_ = (v); frame[--n] = (uae_u16)l_; frame[--n] = (uae_u16)(l_ >> 16); } while (0)
+	switch (format) {
+	case 0x0: // four word stack frame
+		break;
+	case 0x7: // access error stack frame (68040)
+		for (i = 3; i >= 0; i--)
+			FRAME_LONG(mmu040_move16[i]); // WB1D/PD0,PD1,PD2,PD3
+		FRAME_LONG(0); // WB1A
+		FRAME_LONG(0); // WB2D
+		FRAME_LONG(regs.wb2_address); // WB2A
+		FRAME_LONG(regs.wb3_data); // WB3D
+		FRAME_LONG(regs.mmu_fault_addr); // WB3A
+		FRAME_LONG(regs.mmu_fault_addr); // FA
+		FRAME_WORD(0);
+		FRAME_WORD(regs.wb2_status);
+		FRAME_WORD(regs.wb3_status);
+		FRAME_WORD(ssw);
+		FRAME_LONG(regs.mmu_effective_addr);
+		break;
+	default:
+		return false;
+	}
+	FRAME_WORD((format << 12) | (nr * 4));
+	FRAME_LONG(currpc);
+	FRAME_WORD(regs.sr);
+#undef FRAME_WORD
+#undef FRAME_LONG
+
+	// same order as the word pushes, highest address first
+	sp = m68k_areg(regs, 7) - (30 - n) * 2;
+	m68k_areg(regs, 7) = sp;
+	for (i = 28; i >= n; i -= 2)
+		x_put_long(sp + (i - n) * 2, ((uae_u32)frame[i] << 16) | frame[i + 1]);
+	if (format == 0x7)
+		regs.wb2_status = regs.wb3_status = 0;
+	return true;
+}
+#endif
+
 void Exception_build_stack_frame(uae_u32 oldpc, uae_u32 currpc, uae_u32 ssw, int nr, int format)
 {
 	int i;
 
+#ifdef WINUAE_FOR_PREVIOUS
+	if (Exception_build_stack_frame_fast(oldpc, currpc, ssw, nr, format))
+		return;
+#endif
 	switch (format) {
 	case 0x0: // four word stack frame
 	case 0x1: // throwaway four word stack frame
@@ -25,11 +25,14 @@ struct uae_prefs {
 	int cpu060_revision;
 	int fpu_model;
 	int fpu_revision;
+	int fpu_mode;
+	bool fpu_strict;
 	bool cpu_compatible;
 	bool int_no_unimplemented;
 	bool fpu_no_unimplemented;
 	bool address_space_24;
 	bool cpu_data_cache;
+	bool cpu_no_caches;
 };
 
 
@@ -963,7 +963,9 @@ void init_table68k(void)
 {
 	int i;
 
-	free(table68k);
+	/* Only depends on the opcode definitions, build it once */
+	if (table68k)
+		return;
 	table68k = xmalloc(struct instr, 65536);
 	for (i = 0; i < 65536; i++) {
 		table68k[i].mnemo = i_ILLG;
@@ -5,12 +5,14 @@
   or at your option any later version. Read the file gpl.txt for details.
 
   This code handles our table with callbacks for cycle accurate program
-  interruption. We add any pending callback handler into a table so that we do
-  not need to test for every possible interrupt event. We then scan
-  the list if used entries in the table and copy the one with the least cycle
-  count into the global 'PendingInterrupt' variable. This is then
-  decremented by the execution loop - rather than decrement each and every
-  entry (as the others cannot occur before this one).
+  interruption. Pending callback handlers are kept in a binary min-heap
+  ordered by the absolute cycle count at which they are due, so adding and
+  acknowledging an interrupt costs O(log n) and no pending entry has to be
+  adjusted while time passes. The first one is copied into the global
+  'PendingInterrupt' variable with its time relative to now. This is then
+  decremented by the execution loop.
+  Microsecond handlers in real-time mode are kept in a second heap that is
+  ordered by their absolute host time.
   We support three time units: CPU cycles, ticks, and microseconds.
   Ticks are bound to CPU cycles and run at TICK_RATE MHz. Microseconds are either
   bound to the host CPU's performance counter in real-time mode or to the emulated
@@ -40,12 +42,14 @@ const char CycInt_fileid[] = "Previous cycInt.c";
 #include "configuration.h"
 #include "main.h"
 #include "dimension.hpp"
+#include "nbdisk.hpp"
+#include "nbnet.hpp"
+#include "profile.h"
 
 void (*PendingInterruptFunction)(void);
 int64_t PendingInterruptCounter;
 int     usCheckCycles;
 
-int64_t nCyclesOver;
 int64_t nCyclesMainCounter; /* Main cycles counter, counts emulated CPU cycles since reset */
 
 
@@ -71,15 +75,179 @@ static void (* const pIntHandlerFunctions[MAX_INTERRUPTS])(void) =
 	SCC_IO_Handler,
 	Main_EventHandlerInterrupt,
 	nd_display_vbl_handler,
-	nd_video_vbl_handler
+	nd_video_vbl_handler,
+	Profile_CpuSampleHandler,
+	NBDisk_IO_Handler,
+	NBNet_IO_Handler,
+	SCC_RX_Handler
 };
 
+/* Host time accounting subsystem of each handler */
+static const uint8_t IntHandlerSubsystem[MAX_INTERRUPTS] =
+{
+	HOST_PROF_EVENT,
+	HOST_PROF_EVENT,    /* INTERRUPT_VIDEO_VBL */
+	HOST_PROF_EVENT,    /* INTERRUPT_HARDCLOCK */
+	HOST_PROF_EVENT,    /* INTERRUPT_MOUSE */
+	HOST_PROF_DMA,      /* INTERRUPT_ESP */
+	HOST_PROF_DMA,      /* INTERRUPT_ESP_IO */
+	HOST_PROF_DMA,      /* INTERRUPT_M2M_IO */
+	HOST_PROF_DMA,      /* INTERRUPT_MO */
+	HOST_PROF_DMA,      /* INTERRUPT_MO_IO */
+	HOST_PROF_DMA,      /* INTERRUPT_ECC_IO */
+	HOST_PROF_DMA,      /* INTERRUPT_ENET_IO */
+	HOST_PROF_DMA,      /* INTERRUPT_FLP_IO */
+	HOST_PROF_SND,      /* INTERRUPT_SND_OUT */
+	HOST_PROF_SND,      /* INTERRUPT_SND_IN */
+	HOST_PROF_DMA,      /* INTERRUPT_LP_IO */
+	HOST_PROF_DMA,      /* INTERRUPT_SCC_IO */
+	HOST_PROF_EVENT,    /* INTERRUPT_EVENT_LOOP */
+	HOST_PROF_EVENT,    /* INTERRUPT_ND_VBL */
+	HOST_PROF_EVENT,    /* INTERRUPT_ND_VIDEO_VBL */
+	HOST_PROF_EVENT,    /* INTERRUPT_PROFILE */
+	HOST_PROF_DMA,      /* INTERRUPT_NBDISK_IO */
+	HOST_PROF_DMA,      /* INTERRUPT_NBNET_IO */
+	HOST_PROF_DMA       /* INTERRUPT_SCC_RX */
+};
+
+/* Names of the handlers for the metrics endpoint */
+static const char* const IntHandlerName[MAX_INTERRUPTS] =
+{
+	"null",
+	"video_vbl",
+	"hardclock",
+	"mouse",
+	"esp",
+	"esp_io",
+	"m2m_io",
+	"mo",
+	"mo_io",
+	"ecc_io",
+	"enet_io",
+	"flp_io",
+	"snd_out",
+	"snd_in",
+	"lp_io",
+	"scc_io",
+	"event_loop",
+	"nd_vbl",
+	"nd_video_vbl",
+	"profile",
+	"nbdisk_io",
+	"nbnet_io",
+	"scc_rx"
+};
+
+/* Handler calls since start, only written by the m68k thread */
+static uint64_t IntHandlerCount[MAX_INTERRUPTS];
+
+/* The host clock is only read for microsecond interrupts when the earliest
+ * one could be due. The number of CPU cycles until then is estimated from
+ * the measured ratio of emulated cycles to host time. */
+#define US_GATE_MAX_US     1000   /* check the host clock at least every ms */
+#define US_CALIBRATE_US    10000  /* update the cycles per host microsecond */
+
+static int64_t usGateCycles;      /* cycle counter at last calibration */
+static int64_t usGateTime;        /* host time at last calibration */
+static int64_t usCyclesPerUs;
+
+/* Limits for skipping cycles while the CPU is idle */
+#define IDLE_MAX_US        1000   /* skip at most 1 ms of emulated time at once */
+#define IDLE_MIN_SLEEP_US  100    /* shorter host sleeps are not worth it */
+#define IDLE_MAX_SLEEP_US  10000
+
 static INTERRUPTHANDLER InterruptHandlers[MAX_INTERRUPTS];
 INTERRUPTHANDLER        PendingInterrupt;
 static int              ActiveInterrupt=0;
 
+/* Binary min-heap of handlers, ordered by time and then by handler number */
+typedef struct {
+	int          count;
+	interrupt_id handler[MAX_INTERRUPTS];
+} INTERRUPTHEAP;
+
+static INTERRUPTHEAP CpuHeap;   /* CYC_INT_CPU, absolute cycle count */
+static INTERRUPTHEAP UsHeap;    /* CYC_INT_US, absolute host microseconds */
+static int           HeapPos[MAX_INTERRUPTS]; /* index in its heap or -1 */
+
 static void CycInt_SetNewInterrupt(void);
 
+static inline bool CycInt_HeapLess(interrupt_id a, interrupt_id b) {
+	return InterruptHandlers[a].time < InterruptHandlers[b].time ||
+	      (InterruptHandlers[a].time == InterruptHandlers[b].time && a < b);
+}
+
+static inline void CycInt_HeapSet(INTERRUPTHEAP* heap, int i, interrupt_id h) {
+	heap->handler[i] = h;
+	HeapPos[h]       = i;
+}
+
+static void CycInt_HeapUp(INTERRUPTHEAP* heap, int i) {
+	interrupt_id h = heap->handler[i];
+
+	while (i > 0 && CycInt_HeapLess(h, heap->handler[(i-1)/2])) {
+		CycInt_HeapSet(heap, i, heap->handler[(i-1)/2]);
+		i = (i-1)/2;
+	}
+	CycInt_HeapSet(heap, i, h);
+}
+
+static void CycInt_HeapDown(INTERRUPTHEAP* heap, int i) {
+	interrupt_id h = heap->handler[i];
+	int          c;
+
+	while ((c = 2*i+1) < heap->count) {
+		if (c+1 < heap->count && CycInt_HeapLess(heap->handler[c+1], heap->handler[c])) {
+			c++;
+		}
+		if (!CycInt_HeapLess(heap->handler[c], h)) {
+			break;
+		}
+		CycInt_HeapSet(heap, i, heap->handler[c]);
+		i = c;
+	}
+	CycInt_HeapSet(heap, i, h);
+}
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Take a handler out of the heap it is in, if any, and disable it.
+ */
+static void CycInt_Unschedule(interrupt_id Handler) {
+	INTERRUPTHEAP* heap;
+	interrupt_id   last;
+	int            i = HeapPos[Handler];
+
+	if (i >= 0) {
+		heap = (InterruptHandlers[Handler].type == CYC_INT_US) ? &UsHeap : &CpuHeap;
+		HeapPos[Handler] = -1;
+		if (--heap->count > i) {
+			/* Move the last entry into the gap and restore heap order */
+			last = heap->handler[heap->count];
+			CycInt_HeapSet(heap, i, last);
+			CycInt_HeapDown(heap, i);
+			CycInt_HeapUp(heap, HeapPos[last]);
+		}
+	}
+	InterruptHandlers[Handler].type = CYC_INT_NONE;
+	InterruptHandlers[Handler].time = INT64_MAX;
+}
+
+/*-----------------------------------------------------------------------*/
+/**
+ * (Re-)schedule a handler at an absolute time of the given type.
+ */
+static void CycInt_Schedule(interrupt_id Handler, int type, int64_t time) {
+	INTERRUPTHEAP* heap = (type == CYC_INT_US) ? &UsHeap : &CpuHeap;
+
+	CycInt_Unschedule(Handler);
+
+	InterruptHandlers[Handler].type = type;
+	InterruptHandlers[Handler].time = time;
+	CycInt_HeapSet(heap, heap->count, Handler);
+	CycInt_HeapUp(heap, heap->count++);
+}
+
 /*-----------------------------------------------------------------------*/
 /**
  * Reset interrupts, handlers
@@ -90,7 +258,6 @@ void CycInt_Reset(void) {
 	/* Reset counts */
 	PendingInterrupt.time = 0;
 	ActiveInterrupt       = 0;
-	nCyclesOver           = 0;
 	nCyclesMainCounter    = 0;
 	usCheckCycles         = 0;
 
@@ -99,7 +266,14 @@ void CycInt_Reset(void) {
 		InterruptHandlers[i].type      = CYC_INT_NONE;
 		InterruptHandlers[i].time      = INT64_MAX;
 		InterruptHandlers[i].pFunction = pIntHandlerFunctions[i];
+		HeapPos[i]                     = -1;
 	}
+	CpuHeap.count = 0;
+	UsHeap.count  = 0;
+
+	usGateCycles  = 0;
+	usGateTime    = host_time_us();
+	usCyclesPerUs = ConfigureParams.System.nCpuFreq > 0 ? ConfigureParams.System.nCpuFreq : 1;
 }
 
 /*-----------------------------------------------------------------------*/
@@ -109,73 +283,111 @@ void CycInt_Reset(void) {
  * (SC) Microsecond interrupts are skipped here and handled in the decode loop.
  */
 static void CycInt_SetNewInterrupt(void) {
-	int64_t      LowestCycleCount = INT64_MAX;
-	interrupt_id LowestInterrupt  = INTERRUPT_NULL;
-
-	/* Find next interrupt to go off */
-	for(int i = INTERRUPT_NULL+1; i < MAX_INTERRUPTS; i++) {
-		/* Is interrupt pending? */
-		if(InterruptHandlers[i].type == CYC_INT_CPU && InterruptHandlers[i].time < LowestCycleCount) {
-			LowestCycleCount = InterruptHandlers[i].time;
-			LowestInterrupt  = i;
-		}
+	interrupt_id LowestInterrupt = INTERRUPT_NULL;
+
+	if (CpuHeap.count > 0) {
+		LowestInterrupt = CpuHeap.handler[0];
 	}
 
 	/* Set new counts, active interrupt */
 	PendingInterrupt = InterruptHandlers[LowestInterrupt];
+	if (LowestInterrupt != INTERRUPT_NULL) {
+		PendingInterrupt.time -= nCyclesMainCounter;
+	}
 	ActiveInterrupt  = LowestInterrupt;
 }
 
 /*-----------------------------------------------------------------------*/
 /**
- * Adjust all interrupt timings, MUST call CycInt_SetNewInterrupt after this.
+ * Set the number of CPU cycles until the host clock has to be checked for
+ * the earliest microsecond interrupt. Only half of the estimated cycles are
+ * used, so that a slowdown of the emulation does not delay the interrupt.
  */
-static void CycInt_UpdateInterrupt(void) {
-	int i;
+static void CycInt_SetUsGate(int64_t now) {
+	int64_t us, ratio;
 
-	/* Adjust table by subtracting cycles that have passed since last update */
-	for (i = 0; i < MAX_INTERRUPTS; i++) {
-		if (InterruptHandlers[i].type == CYC_INT_CPU)
-			InterruptHandlers[i].time -= nCyclesOver;
+	if (!ConfigureParams.System.bRealtime || UsHeap.count == 0) {
+		usCheckCycles = INT32_MAX;
+		return;
 	}
-	nCyclesOver = 0;
+
+	if (now - usGateTime >= US_CALIBRATE_US) {
+		/* Follow slowdowns at once and speedups slowly */
+		ratio = (nCyclesMainCounter - usGateCycles) / (now - usGateTime);
+		usCyclesPerUs = (ratio < usCyclesPerUs) ? ratio : (usCyclesPerUs + ratio) / 2;
+		if (usCyclesPerUs < 1) {
+			usCyclesPerUs = 1;
+		}
+		usGateCycles = nCyclesMainCounter;
+		usGateTime   = now;
+	}
+
+	us = InterruptHandlers[UsHeap.handler[0]].time - now;
+	if (us > US_GATE_MAX_US) {
+		us = US_GATE_MAX_US;
+	}
+	usCheckCycles = (us > 0) ? (int)(us * usCyclesPerUs / 2) : -1;
 }
 
 /*-----------------------------------------------------------------------*/
 /**
- * Check all microsecond interrupt timings
+ * Check the earliest microsecond interrupt. Called by the CPU loop when
+ * usCheckCycles has run out.
  */
 bool CycInt_SetNewInterruptUs(void) {
-	int64_t now = host_time_us();
-	if (ConfigureParams.System.bRealtime) {
-		for(int i = 0; i < MAX_INTERRUPTS; i++) {
-			if (InterruptHandlers[i].type == CYC_INT_US && now > InterruptHandlers[i].time) {
-				PendingInterrupt = InterruptHandlers[i];
-				PendingInterrupt.time = -1;
-				ActiveInterrupt       = i;
-				return true;
-			}
+	interrupt_id i;
+	int64_t      now;
+
+	if (ConfigureParams.System.bRealtime && UsHeap.count > 0) {
+		i   = UsHeap.handler[0];
+		now = host_time_us();
+		if (now > InterruptHandlers[i].time) {
+			PendingInterrupt = InterruptHandlers[i];
+			PendingInterrupt.time = -1;
+			ActiveInterrupt       = i;
+			/* Check again after this one has been acknowledged */
+			usCheckCycles = -1;
+			return true;
 		}
+		CycInt_SetUsGate(now);
+	} else {
+		usCheckCycles = INT32_MAX;
 	}
 	return false;
 }
 
 /*-----------------------------------------------------------------------*/
 /**
- * Adjust all interrupt timings as 'ActiveInterrupt' has occured, and
- * remove from active list.
+ * Remove 'ActiveInterrupt' from the active list as it has occured.
  */
 void CycInt_AcknowledgeInterrupt(void) {
-	/* Update list cycle counts */
-	CycInt_UpdateInterrupt();
+	IntHandlerCount[ActiveInterrupt]++;
 
 	/* Disable interrupt entry which has just occured */
-	InterruptHandlers[ActiveInterrupt].type = CYC_INT_NONE;
+	CycInt_Unschedule(ActiveInterrupt);
 
 	/* Set new */
 	CycInt_SetNewInterrupt();
 }
 
+/*-----------------------------------------------------------------------*/
+/**
+ * Return host time accounting subsystem of the pending interrupt handler.
+ */
+int CycInt_ActiveSubsystem(void) {
+	return IntHandlerSubsystem[ActiveInterrupt];
+}
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Return the number of calls of an interrupt handler since start and
+ * its name. Can be called from any thread.
+ */
+uint64_t CycInt_HandlerCount(interrupt_id Handler, const char** name) {
+	*name = IntHandlerName[Handler];
+	return IntHandlerCount[Handler];
+}
+
 /*-----------------------------------------------------------------------*/
 /**
  * Add interrupt to occur from now.
@@ -183,13 +395,7 @@ void CycInt_AcknowledgeInterrupt(void) {
 void CycInt_AddRelativeInterruptCycles(int64_t CycleTime, interrupt_id Handler) {
 	assert(CycleTime >= 0);
 
-	/* Update list cycle counts with current PendingInterruptCount before adding a new int, */
-	/* because CycInt_SetNewInterrupt can change the active int / PendingInterruptCount */
-	if ( ActiveInterrupt > 0 )
-		CycInt_UpdateInterrupt();
-
-	InterruptHandlers[Handler].type = CYC_INT_CPU;
-	InterruptHandlers[Handler].time = CycleTime;
+	CycInt_Schedule(Handler, CYC_INT_CPU, nCyclesMainCounter + CycleTime);
 
 	/* Set new active int and compute a new value for PendingInterruptCount*/
 	CycInt_SetNewInterrupt();
@@ -204,14 +410,12 @@ void CycInt_AddRelativeInterruptUs(int64_t us, int64_t usreal, interrupt_id Hand
 	assert(us >= 0);
 
 	if(ConfigureParams.System.bRealtime) {
-		/* Update list cycle counts with current PendingInterruptCount before adding a new int, */
-		/* because CycInt_SetNewInterrupt can change the active int / PendingInterruptCount */
-		if ( ActiveInterrupt > 0 ) CycInt_UpdateInterrupt();
+		int64_t now = host_time_us();
 
 		if ( usreal > 0 ) us = usreal;
 
-		InterruptHandlers[Handler].type = CYC_INT_US;
-		InterruptHandlers[Handler].time = host_time_us() + us;
+		CycInt_Schedule(Handler, CYC_INT_US, now + us);
+		CycInt_SetUsGate(now);
 
 		/* Set new active int and compute a new value for PendingInterruptCount*/
 		CycInt_SetNewInterrupt();
@@ -239,12 +443,8 @@ void CycInt_AddRelativeInterruptUsCycles(int64_t us, int64_t usreal, interrupt_i
  * Remove a pending interrupt from our table
  */
 void CycInt_RemovePendingInterrupt(interrupt_id Handler) {
-	/* Update list cycle counts, including the handler we want to remove */
-	/* to be able to resume it later */
-	CycInt_UpdateInterrupt();
-
-	/* Stop interrupt after CycInt_UpdateInterrupt */
-	InterruptHandlers[Handler].type = CYC_INT_NONE;
+	/* Stop interrupt */
+	CycInt_Unschedule(Handler);
 
 	/* Set new */
 	CycInt_SetNewInterrupt();
@@ -259,3 +459,43 @@ bool CycInt_InterruptActive(interrupt_id Handler)
 {
 	return InterruptHandlers[Handler].type != CYC_INT_NONE;
 }
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Called when the CPU is idle (stopped or branching to itself). Return the
+ * number of cycles the CPU can skip because no interrupt is due before,
+ * but at least the given number of cycles. In real-time mode sleep on the
+ * host as long as emulated time is ahead of real time.
+ */
+int CycInt_Idle(int cycles) {
+	int64_t skip = IDLE_MAX_US * ConfigureParams.System.nCpuFreq;
+	int64_t next;
+	int64_t ahead;
+
+	if (PendingInterrupt.type == CYC_INT_CPU && PendingInterrupt.time < skip) {
+		skip = PendingInterrupt.time;
+	}
+
+	if (ConfigureParams.System.bRealtime) {
+		if (UsHeap.count > 0) {
+			next = InterruptHandlers[UsHeap.handler[0]].time;
+			next -= host_time_us();
+			if (next * ConfigureParams.System.nCpuFreq < skip) {
+				skip = next * ConfigureParams.System.nCpuFreq;
+			}
+			/* Check microsecond interrupts with the next instruction */
+			usCheckCycles = -1;
+		}
+		if (skip < cycles) {
+			skip = cycles;
+		}
+		ahead = host_real_time_offset() + skip / ConfigureParams.System.nCpuFreq;
+		if (ahead > IDLE_MIN_SLEEP_US) {
+			uint64_t start = host_prof_now();
+			host_sleep_us(ahead < IDLE_MAX_SLEEP_US ? ahead : IDLE_MAX_SLEEP_US);
+			host_prof_end(HOST_PROF_IDLE, start);
+		}
+	}
+
+	return skip < cycles ? cycles : (int)skip;
+}
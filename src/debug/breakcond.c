@@ -33,6 +33,7 @@ const char BreakCond_fileid[] = "Hatari breakcond.c";
 #include "history.h"
 #include "symbols.h"
 #include "68kDisass.h"
+#include "hosttlb.h"
 
 
 /* set to 1 to enable parsing function tracing / debug output */
@@ -43,7 +44,11 @@ const char BreakCond_fileid[] = "Hatari breakcond.c";
 
 #define BC_DEFAULT_DSP_SPACE 'P'
 
-typedef struct {
+/* hashed addresses of breakpoints that only check PC */
+#define BC_PC_FILTER	1024
+#define BC_PC_HASH(pc)	(((pc) ^ ((pc) >> 10)) & (BC_PC_FILTER-1))
+
+typedef struct bc_value_s {
 	bool is_indirect;
 	char dsp_space;	/* DSP has P, X, Y address spaces, zero if not DSP */
 	value_t valuetype;	/* Hatari value variable type */
@@ -56,6 +61,7 @@ typedef struct {
 	} value;
 	uint32_t bits;	/* CPU has 8/16/32 bit address widths */
 	uint32_t mask;	/* <width mask> && <value mask> */
+	uint32_t (*get)(const struct bc_value_s *bc_value);	/* accessor set up for the value type */
 } bc_value_t;
 
 typedef struct {
@@ -93,6 +99,10 @@ typedef struct {
 	int allocated;
 	bool delayed_change;
 	const debug_reason_t reason;
+	int pc_count;	/* breakpoints that only compare PC to an address */
+	bc_value_t pc;	/* PC value of these breakpoints */
+	uint8_t pc_filter[BC_PC_FILTER];	/* their addresses, hashed */
+	int watch_count;	/* CPU breakpoints that only check a memory value */
 } bc_breakpoints_t;
 
 static bc_breakpoints_t CpuBreakPoints = {
@@ -233,6 +243,59 @@ static uint32_t BreakCond_GetValue(const bc_value_t *bc_value)
 	return (value & bc_value->mask);
 }
 
+/**
+ * Accessors for direct values, so that conditions don't need to
+ * check the value type on every instruction
+ */
+static uint32_t BreakCond_GetNumber(const bc_value_t *bc_value)
+{
+	return bc_value->value.number & bc_value->mask;
+}
+
+static uint32_t BreakCond_GetFunction32(const bc_value_t *bc_value)
+{
+	return bc_value->value.func32() & bc_value->mask;
+}
+
+static uint32_t BreakCond_GetReg16(const bc_value_t *bc_value)
+{
+	return *(bc_value->value.reg16) & bc_value->mask;
+}
+
+static uint32_t BreakCond_GetReg32(const bc_value_t *bc_value)
+{
+	return *(bc_value->value.reg32) & bc_value->mask;
+}
+
+/**
+ * Select accessor for given value
+ */
+static void BreakCond_CompileValue(bc_value_t *bc_value)
+{
+	if (bc_value->is_indirect) {
+		bc_value->get = BreakCond_GetValue;
+		return;
+	}
+	switch (bc_value->valuetype) {
+	case VALUE_TYPE_NUMBER:
+		bc_value->get = BreakCond_GetNumber;
+		break;
+	case VALUE_TYPE_FUNCTION32:
+		bc_value->get = BreakCond_GetFunction32;
+		break;
+	case VALUE_TYPE_REG16:
+		bc_value->get = BreakCond_GetReg16;
+		break;
+	case VALUE_TYPE_VAR32:
+	case VALUE_TYPE_REG32:
+		bc_value->get = BreakCond_GetReg32;
+		break;
+	default:
+		bc_value->get = BreakCond_GetValue;
+		break;
+	}
+}
+
 
 /**
  * Show & update rvalue for a tracked breakpoint condition to lvalue
@@ -267,8 +330,8 @@ static bool BreakCond_MatchConditions(bc_condition_t *condition, int count)
 
 	for (i = 0; i < count; condition++, i++) {
 
-		lvalue = BreakCond_GetValue(&(condition->lvalue));
-		rvalue = BreakCond_GetValue(&(condition->rvalue));
+		lvalue = condition->lvalue.get(&(condition->lvalue));
+		rvalue = condition->rvalue.get(&(condition->rvalue));
 
 		switch (condition->comparison) {
 		case '<':
@@ -310,8 +373,26 @@ static bool BreakCond_MatchBreakPoints(bc_breakpoints_t *bps)
 	bc_breakpoint_t *bp;
 	bool changes = false;
 	bool hit = false;
+	uint32_t pc;
 	int i;
 
+	/* only PC and memory watch breakpoints: skip addresses that none
+	 * of them matches, unless a watched page was written to
+	 */
+	if (bps->count && bps->pc_count + bps->watch_count == bps->count) {
+		if (bps->watch_count && hosttlb_watch_hit) {
+			hosttlb_watch_hit = false;
+		} else {
+			if (!bps->pc_count) {
+				return false;
+			}
+			pc = bps->pc.get(&(bps->pc));
+			if (likely(!bps->pc_filter[BC_PC_HASH(pc)])) {
+				return false;
+			}
+		}
+	}
+
 	/* array should not be changed while it's being traversed */
 	assert(likely(!bps->delayed_change));
 	bps->delayed_change = true;
@@ -1164,6 +1245,79 @@ static void BreakCond_CheckTracking(bc_breakpoint_t *bp)
 }
 
 
+/**
+ * Return true if breakpoint has a single condition comparing PC
+ * to an address
+ */
+static bool BreakCond_IsPcOnly(bc_breakpoint_t *bp)
+{
+	bc_condition_t *condition = bp->conditions;
+	uint32_t *addr, mask;
+
+	if (bp->ccount != 1 || condition->comparison != '=' || condition->track ||
+	    condition->lvalue.is_indirect || condition->rvalue.is_indirect ||
+	    condition->rvalue.valuetype != VALUE_TYPE_NUMBER) {
+		return false;
+	}
+	if (condition->lvalue.dsp_space) {
+		return DSP_GetRegisterAddress("PC", &addr, &mask) &&
+			condition->lvalue.value.reg32 == addr;
+	}
+	return condition->lvalue.valuetype == VALUE_TYPE_FUNCTION32 &&
+		condition->lvalue.value.func32 == GetCpuPC;
+}
+
+/**
+ * Return true if breakpoint has a single condition comparing
+ * the CPU memory value at a fixed address to a number
+ */
+static bool BreakCond_IsMemWatch(bc_breakpoint_t *bp)
+{
+	bc_condition_t *condition = bp->conditions;
+
+	return bp->ccount == 1 && !condition->lvalue.dsp_space &&
+		condition->lvalue.is_indirect &&
+		condition->lvalue.valuetype == VALUE_TYPE_NUMBER &&
+		!condition->rvalue.is_indirect &&
+		condition->rvalue.valuetype == VALUE_TYPE_NUMBER;
+}
+
+/**
+ * Rebuild the hashed addresses of PC breakpoints and the watched
+ * memory pages after breakpoints were added or removed
+ */
+static void BreakCond_UpdateFilters(bc_breakpoints_t *bps)
+{
+	bc_breakpoint_t *bp;
+	uint32_t pc;
+	int i;
+
+	memset(bps->pc_filter, 0, sizeof(bps->pc_filter));
+	bps->pc_count = 0;
+	bps->watch_count = 0;
+	if (bps == &CpuBreakPoints) {
+		hosttlb_watch_clear();
+	}
+
+	bp = bps->breakpoint;
+	for (i = 0; i < bps->count; bp++, i++) {
+		if (bps == &CpuBreakPoints && BreakCond_IsMemWatch(bp) &&
+		    hosttlb_watch_add(bp->conditions->lvalue.value.number,
+				      bp->conditions->lvalue.bits / 8)) {
+			bps->watch_count++;
+			continue;
+		}
+		if (!BreakCond_IsPcOnly(bp)) {
+			continue;
+		}
+		pc = bp->conditions->rvalue.get(&(bp->conditions->rvalue));
+		bps->pc_filter[BC_PC_HASH(pc)] = 1;
+		bps->pc = bp->conditions->lvalue;
+		bps->pc_count++;
+	}
+}
+
+
 /**
  * Parse given breakpoint expression and store it.
  * Return true for success and false for failure.
@@ -1174,7 +1328,7 @@ static bool BreakCond_Parse(const char *expression, bc_options_t *options, bool
 	bc_breakpoints_t *bps;
 	bc_breakpoint_t *bp;
 	char *normalized;
-	int ccount;
+	int ccount, c;
 
 	bps = BreakCond_GetListInfo(bForDsp);
 
@@ -1230,6 +1384,11 @@ static bool BreakCond_Parse(const char *expression, bc_options_t *options, bool
 			}
 		}
 		BreakCond_CheckTracking(bp);
+		for (c = 0; c < ccount; c++) {
+			BreakCond_CompileValue(&(bp->conditions[c].lvalue));
+			BreakCond_CompileValue(&(bp->conditions[c].rvalue));
+		}
+		BreakCond_UpdateFilters(bps);
 
 		bp->options.quiet = options->quiet;
 		bp->options.skip = options->skip;
@@ -1363,6 +1522,7 @@ static bool BreakCond_Remove(bc_breakpoints_t *bps, int position)
 		memmove(bp, bp + 1, (bps->count - position) * sizeof(bc_breakpoint_t));
 	}
 	bps->count--;
+	BreakCond_UpdateFilters(bps);
 	return true;
 }
 
@@ -0,0 +1,220 @@
+/*
+ * Previous - cputrace.c
+ *
+ * This file is distributed under the GNU General Public License, version 2
+ * or at your option any later version. Read the file gpl.txt for details.
+ *
+ * cputrace.c - binary CPU instruction trace
+ *
+ * Disassembling every executed instruction to text makes a traced run
+ * about hundred times slower. This trace only stores the PC and the raw
+ * instruction words of each instruction in a file. The file is turned
+ * into text later with the normal disassembler, reading the instruction
+ * words from the file instead of memory, and with symbols as they are
+ * loaded at that time.
+ *
+ * File layout: "PRVCTR01", then per instruction the PC (4 bytes, big
+ * endian), the number of instruction bytes that could be read (1 byte)
+ * and these bytes.
+ */
+const char CpuTrace_fileid[] = "Previous cputrace.c";
+
+#include <errno.h>
+#include <inttypes.h>
+#include "main.h"
+#include "sysdeps.h"
+#include "debugui.h"
+#include "debug_priv.h"
+#include "file.h"
+#include "m68000.h"
+#include "newcpu.h"
+#include "mmu_common.h"
+#include "debug.h"
+#include "symbols.h"
+#include "68kDisass.h"
+#include "cputrace.h"
+
+#define CPUTRACE_MAGIC "PRVCTR01"
+#define CPUTRACE_CODE 22	/* longest 68k instruction */
+#define CPUTRACE_BUF (1024 * 1024)
+
+bool bCpuTrace;
+
+static struct {
+	FILE *fp;
+	uint8_t *buf;
+	unsigned used;
+	uint64_t count;
+} Trace;
+
+
+/**
+ * Write buffered records to the trace file
+ */
+static void CpuTrace_Flush(void)
+{
+	if (Trace.used && fwrite(Trace.buf, Trace.used, 1, Trace.fp) != 1)
+		fprintf(stderr, "ERROR: writing CPU trace failed (%d).\n", errno);
+	Trace.used = 0;
+}
+
+/**
+ * Add the current instruction to the trace. The instruction words are
+ * read until the maximum instruction size or a bus error.
+ */
+void CpuTrace_Add(void)
+{
+	uint32_t pc = M68000_GetPC();
+	uint8_t *p, *len;
+	volatile int n;
+	uint32_t w;
+
+	if (Trace.used > CPUTRACE_BUF - (5 + CPUTRACE_CODE))
+		CpuTrace_Flush();
+
+	p = Trace.buf + Trace.used;
+	p[0] = pc >> 24;
+	p[1] = pc >> 16;
+	p[2] = pc >> 8;
+	p[3] = pc;
+	len = p + 4;
+	p += 5;
+
+	n = 0;
+	TRY(prb) {
+		for (; n < CPUTRACE_CODE; n += 2) {
+			w = get_iword_debug(pc + n);
+			p[n] = w >> 8;
+			p[n + 1] = w;
+		}
+	} CATCH(prb) {
+	} ENDTRY
+
+	*len = n;
+	Trace.used += 5 + n;
+	Trace.count++;
+}
+
+/**
+ * Start writing the trace to given file
+ */
+static void CpuTrace_Start(const char *name)
+{
+	if (bCpuTrace) {
+		fprintf(stderr, "ERROR: CPU trace is already written!\n");
+		return;
+	}
+	if (!Trace.buf && !(Trace.buf = malloc(CPUTRACE_BUF))) {
+		fprintf(stderr, "ERROR: CPU trace alloc failed!\n");
+		return;
+	}
+	if (!(Trace.fp = fopen(name, "wb"))) {
+		fprintf(stderr, "ERROR: opening '%s' failed (%d).\n", name, errno);
+		return;
+	}
+	fwrite(CPUTRACE_MAGIC, 8, 1, Trace.fp);
+	Trace.used = 0;
+	Trace.count = 0;
+	bCpuTrace = true;
+	fprintf(stderr, "CPU trace written to '%s'.\n", name);
+}
+
+/**
+ * Stop the trace and close the file
+ */
+void CpuTrace_Stop(void)
+{
+	if (!bCpuTrace)
+		return;
+	CpuTrace_Flush();
+	fclose(Trace.fp);
+	Trace.fp = NULL;
+	bCpuTrace = false;
+	fprintf(stderr, "%"PRIu64" traced instructions written.\n", Trace.count);
+}
+
+/**
+ * Disassemble a trace file to text, one instruction per line and
+ * preceded by its symbol if there is one.
+ * Return number of decoded instructions.
+ */
+static uint64_t CpuTrace_Decode(FILE *in, FILE *out)
+{
+	uint8_t rec[5 + CPUTRACE_CODE];
+	char magic[8];
+	const char *symbol;
+	uint64_t count = 0;
+	uint32_t pc;
+	int n;
+
+	if (fread(magic, 8, 1, in) != 1 || memcmp(magic, CPUTRACE_MAGIC, 8)) {
+		fprintf(stderr, "ERROR: not a CPU trace file!\n");
+		return 0;
+	}
+	while (fread(rec, 5, 1, in) == 1) {
+		n = rec[4];
+		if (n > CPUTRACE_CODE || (n && fread(rec + 5, n, 1, in) != 1))
+			break;
+		pc = (uint32_t)rec[0] << 24 | rec[1] << 16 | rec[2] << 8 | rec[3];
+
+		symbol = Symbols_GetByCpuAddress(pc, SYMTYPE_ALL);
+		if (symbol)
+			fprintf(out, "%s\n", symbol);
+		debug_set_code(pc, rec + 5, n);
+		Disasm(out, pc, NULL, 1);
+		count++;
+	}
+	debug_set_code(0, NULL, 0);
+	return count;
+}
+
+
+char *CpuTrace_Match(const char *text, int state)
+{
+	static const char* names[] = { "decode", "off", "on" };
+	return DebugUI_MatchHelper(names, ARRAY_SIZE(names), text, state);
+}
+
+const char CpuTrace_Description[] =
+	  "<on <file>|off|decode <file> <text file>>\n"
+	  "\t'on' writes the PC and instruction words of each executed\n"
+	  "\tinstruction to a binary file, 'off' closes it. 'decode'\n"
+	  "\tdisassembles such a file into a text file. Symbols and values\n"
+	  "\tshown for operands are those at decoding time.";
+
+/**
+ * Command: binary CPU trace control and decoding.
+ * Returns DEBUGGER_CMDDONE.
+ */
+int CpuTrace_Command(int nArgc, char *psArgs[])
+{
+	FILE *in, *out;
+	uint64_t count;
+
+	if (nArgc == 3 && strcmp(psArgs[1], "on") == 0) {
+		CpuTrace_Start(psArgs[2]);
+		return DEBUGGER_CMDDONE;
+	}
+	if (nArgc == 2 && strcmp(psArgs[1], "off") == 0) {
+		CpuTrace_Stop();
+		return DEBUGGER_CMDDONE;
+	}
+	if (nArgc == 4 && strcmp(psArgs[1], "decode") == 0) {
+		if (File_Exists(psArgs[3])) {
+			fprintf(stderr, "ERROR: file '%s' already exists!\n", psArgs[3]);
+		} else if (!(in = fopen(psArgs[2], "rb"))) {
+			fprintf(stderr, "ERROR: opening '%s' failed (%d).\n", psArgs[2], errno);
+		} else {
+			if ((out = fopen(psArgs[3], "w"))) {
+				count = CpuTrace_Decode(in, out);
+				fclose(out);
+				fprintf(stderr, "%"PRIu64" instructions decoded to '%s'.\n", count, psArgs[3]);
+			} else {
+				fprintf(stderr, "ERROR: opening '%s' failed (%d).\n", psArgs[3], errno);
+			}
+			fclose(in);
+		}
+		return DEBUGGER_CMDDONE;
+	}
+	return DebugUI_PrintCmdHelp(psArgs[0]);
+}
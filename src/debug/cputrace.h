@@ -0,0 +1,20 @@
+/*
+ * Previous - cputrace.h
+ *
+ * This file is distributed under the GNU General Public License, version 2
+ * or at your option any later version. Read the file gpl.txt for details.
+ */
+
+#ifndef PREV_CPUTRACE_H
+#define PREV_CPUTRACE_H
+
+extern bool bCpuTrace;
+
+extern const char CpuTrace_Description[];
+extern char *CpuTrace_Match(const char *text, int state);
+extern int CpuTrace_Command(int nArgc, char *psArgs[]);
+
+extern void CpuTrace_Add(void);
+extern void CpuTrace_Stop(void);
+
+#endif /* PREV_CPUTRACE_H */
@@ -35,6 +35,9 @@ extern void DebugCpu_InitSession(void);
 
 extern bool DebugUI_ParseFile(const char *path, bool reinit, bool verbose);
 
+/* Read a root directory file from a NeXT disk image (symbols_image.cpp) */
+extern uint8_t *Symbols_ReadImageFile(const char *image, const char *name, uint32_t *size);
+
 #ifdef ENABLE_DSP_EMU
 extern int DebugDsp_Init(const dbgcommand_t **table);
 extern void DebugDsp_InitSession(void);
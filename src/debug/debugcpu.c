@@ -18,6 +18,7 @@ const char DebugCpu_fileid[] = "Hatari debugcpu.c";
 #include "main.h"
 #include "breakcond.h"
 #include "configuration.h"
+#include "cputrace.h"
 #include "debugui.h"
 #include "debug_priv.h"
 #include "debugcpu.h"
@@ -1108,6 +1109,14 @@ void DebugCpu_Check(void)
 		LOG_TRACE_DIRECT_INIT ();
 		m68k_dumpstate_file(TraceFile, &nextpc, 0xffffffff);
 	}
+	if (LOG_TRACE_LEVEL(TRACE_CPU_DISASM) && !regs.stopped)
+	{
+		m68k_disasm_file(TraceFile, M68000_GetPC(), NULL, M68000_GetPC(), 1);
+	}
+	if (bCpuTrace && !regs.stopped)
+	{
+		CpuTrace_Add();
+	}
 	if (nCpuActiveCBs)
 	{
 		if (BreakCond_MatchCpu())
@@ -1130,6 +1139,10 @@ void DebugCpu_Check(void)
 	{
 		History_AddCpu();
 	}
+	if (HistoryTrace)
+	{
+		History_AddTrace();
+	}
 }
 
 /**
@@ -1142,7 +1155,10 @@ void DebugCpu_SetDebugging(void)
 	bCpuProfiling = Profile_CpuStart();
 	nCpuActiveCBs = BreakCond_CpuBreakPointCount();
 
-	if (nCpuActiveCBs || nCpuSteps || bCpuProfiling || History_TrackCpu()
+	/* Only traced IO accesses check the trace flags */
+	memory_trace_io(LOG_TRACE_LEVEL(TRACE_IOMEM_ALL) != 0);
+
+	if (nCpuActiveCBs || nCpuSteps || bCpuProfiling || History_TrackCpu() || HistoryTrace || bCpuTrace
 	    || LOG_TRACE_LEVEL((TRACE_CPU_DISASM|TRACE_CPU_SYMBOLS|TRACE_CPU_REGS)))
 	{
 		M68000_SetSpecial(SPCFLAG_DEBUGGER);
@@ -1174,6 +1190,11 @@ static const dbgcommand_t cpucommands[] =
 	  "\tWhen no address is given, disassemble from the last disasm\n"
 	  "\taddress, or from current PC when debugger is (re-)entered.",
 	  false },
+	{ CpuTrace_Command, CpuTrace_Match,
+	  "cputrace", "",
+	  "write CPU trace to a binary file and decode it",
+	  CpuTrace_Description,
+	  false },
 	{ DebugCpu_Profile, Profile_Match,
 	  "profile", "",
 	  "profile CPU code",
@@ -11,6 +11,7 @@
 const char DebugUI_fileid[] = "Hatari debugui.c";
 
 #include <ctype.h>
+#include <inttypes.h>
 #include <stdio.h>
 #include <unistd.h>
 
@@ -24,16 +25,21 @@ const char DebugUI_fileid[] = "Hatari debugui.c";
 #include "main.h"
 #include "change.h"
 #include "configuration.h"
+#include "diskcache.h"
+#include "ethernet.h"
+#include "enet_slirp.h"
 #include "file.h"
 #include "log.h"
 #include "m68000.h"
 #include "reset.h"
+#include "scsi.h"
 #include "screen.h"
 #include "statusbar.h"
 #include "str.h"
 
 #include "debug_priv.h"
 #include "breakcond.h"
+#include "cputrace.h"
 #include "debugcpu.h"
 #include "debugdsp.h"
 #include "68kDisass.h"
@@ -440,6 +446,101 @@ static int DebugUI_Reset(int argc, char *argv[])
 }
 
 
+/**
+ * Command: Commit or discard SCSI disk overlays
+ */
+static char *DebugUI_MatchOverlay(const char *text, int state)
+{
+	static const char* types[] = {	"commit", "discard" };
+	return DebugUI_MatchHelper(types, ARRAY_SIZE(types), text, state);
+}
+static int DebugUI_Overlay(int argc, char *argv[])
+{
+	int i, count;
+	bool ok;
+
+	if (argc == 1)
+	{
+		for (i = 0; i < ESP_MAX_DEVS; i++)
+		{
+			count = SCSI_OverlayCount(i);
+			if (count >= 0)
+				fprintf(debugOutput, "SCSI disk %d: %d changed blocks\n", i, count);
+		}
+		return DEBUGGER_CMDDONE;
+	}
+	if (argc != 3)
+		return DebugUI_PrintCmdHelp(argv[0]);
+
+	i = atoi(argv[2]);
+	if (i < 0 || i >= ESP_MAX_DEVS)
+		return DebugUI_PrintCmdHelp(argv[0]);
+
+	if (strcmp(argv[1], "commit") == 0)
+		ok = SCSI_OverlayCommit(i);
+	else if (strcmp(argv[1], "discard") == 0)
+		ok = SCSI_OverlayDiscard(i);
+	else
+		return DebugUI_PrintCmdHelp(argv[0]);
+
+	if (!ok)
+		fprintf(stderr, "ERROR: SCSI disk %d has no usable overlay\n", i);
+	return DEBUGGER_CMDDONE;
+}
+
+
+/**
+ * Command: Show disk cache statistics
+ */
+static int DebugUI_DiskCache(int argc, char *argv[])
+{
+	DISKCACHE_STATS s;
+	int dev;
+
+	fprintf(debugOutput, "%d MB disk cache\n", ConfigureParams.System.nDiskCacheSize);
+	for (dev = 0; dev < DISKCACHE_DEVS; dev++)
+	{
+		DiskCache_Stats(dev, &s);
+		if (s.hits + s.misses == 0)
+			continue;
+		fprintf(debugOutput, "%-6s %10"PRIu64" hits %10"PRIu64" misses %10"PRIu64" evictions (%.1f%% hit rate)\n",
+		        DiskCache_Name(dev), s.hits, s.misses, s.evictions, 100.0 * s.hits / (s.hits + s.misses));
+	}
+	return DEBUGGER_CMDDONE;
+}
+
+
+/**
+ * Command: Write captured Ethernet packets to a file
+ */
+static int DebugUI_EnetDump(int argc, char *argv[])
+{
+	int count;
+
+	if (argc != 2)
+	{
+		DebugUI_PrintCmdHelp(argv[0]);
+		return DEBUGGER_CMDDONE;
+	}
+	count = Ethernet_CaptureDump(argv[1]);
+	if (count < 0)
+		fprintf(stderr, "Cannot write '%s'\n", argv[1]);
+	else
+		fprintf(debugOutput, "%d packets written to '%s'\n", count, argv[1]);
+	return DEBUGGER_CMDDONE;
+}
+
+
+/**
+ * Command: Show NFS server statistics
+ */
+static int DebugUI_NFSStats(int argc, char *argv[])
+{
+	nfsd_print_stats(debugOutput);
+	return DEBUGGER_CMDDONE;
+}
+
+
 /**
  * Command: Read debugger commands from a file
  */
@@ -942,12 +1043,15 @@ static const dbgcommand_t uicommand[] =
 	{ History_Parse, History_Match,
 	  "history", "hi",
 	  "show last CPU and/or DSP PC values + instructions",
-	  "cpu|dsp|on|off|<count> [limit]|save <file>\n"
+	  "cpu|dsp|on|off|<count> [limit]|save <file>|trace [<MB>|off|save <file>]\n"
 	  "\t'cpu' and 'dsp' enable program counter history tracking for given\n"
 	  "\tprocessor, 'on' tracks them both, 'off' will disable history.\n"
 	  "\tOptional 'limit' will set how many past addresses are tracked.\n"
 	  "\tGiving just count will show (at max) given number of last saved PC\n"
-	  "\tvalues and instructions currently at corresponding RAM addresses.",
+	  "\tvalues and instructions currently at corresponding RAM addresses.\n"
+	  "\t'trace' records CPU PC values compactly into a ring of given size\n"
+	  "\t(default 16 MB, usually millions of instructions), 'trace save'\n"
+	  "\twrites the decoded PC values to a file.",
 	  false },
 	{ DebugInfo_Command, DebugInfo_MatchInfo,
 	  "info", "i",
@@ -970,6 +1074,35 @@ static const dbgcommand_t uicommand[] =
 	  "\tOpen log file, no argument closes the log file. Output of\n"
 	  "\tregister & memory dumps and disassembly will be written to it.",
 	  false },
+	{ DebugUI_DiskCache, NULL,
+	  "diskcache", "",
+	  "show disk cache statistics",
+	  "\n"
+	  "\tShow block cache hits, misses and evictions of each disk.",
+	  false },
+	{ DebugUI_EnetDump, NULL,
+	  "enetdump", "",
+	  "write captured Ethernet packets to a file",
+	  "<filename>\n"
+	  "\tWrite the last packets sent and received by the guest to a\n"
+	  "\tpcapng file. Packets are only captured while the enet_packets\n"
+	  "\ttrace is enabled.",
+	  false },
+	{ DebugUI_NFSStats, NULL,
+	  "nfsstats", "",
+	  "show NFS server statistics",
+	  "\n"
+	  "\tShow calls, bytes moved and latencies of each procedure of the\n"
+	  "\tbuilt-in NFS, mount and NetInfo servers.",
+	  false },
+	{ DebugUI_Overlay, DebugUI_MatchOverlay,
+	  "overlay", "",
+	  "commit or discard SCSI disk overlays",
+	  "[commit|discard <target>]\n"
+	  "\tWith 'SCSI write protection' on, writes go to a copy-on-write\n"
+	  "\toverlay. 'commit' writes its blocks to the disk image, 'discard'\n"
+	  "\tdrops them. Without arguments, the overlays are listed.",
+	  false },
 	{ DebugUI_CommandsFromFile, NULL,
 	  "parse", "p",
 	  "get debugger commands from file",
@@ -1068,6 +1201,7 @@ void DebugUI_Init(void)
  */
 void DebugUI_UnInit(void)
 {
+	CpuTrace_Stop();
 	Profile_CpuFree();
 	Profile_DspFree();
 	Symbols_FreeAll();
@@ -7,11 +7,17 @@
  * or at your option any later version. Read the file gpl.txt for details.
  *
  * history.c - functions for debugger entry & breakpoint history
+ *
+ * Besides the item history, the CPU PC can be recorded into a compact
+ * trace ring. It is split into fixed size chunks that start with an
+ * absolute PC followed by PC deltas, so that the oldest chunk can be
+ * dropped without losing the start of the others.
  */
 const char History_fileid[] = "Hatari history.c";
 
 #include <assert.h>
 #include <errno.h>
+#include <inttypes.h>
 #include "main.h"
 #include "configuration.h"
 #include "debugui.h"
@@ -26,7 +32,12 @@ const char History_fileid[] = "Hatari history.c";
 
 #define HISTORY_ITEMS_MIN 64
 
+#define TRACE_CHUNK_SIZE 4096	/* bytes in trace chunk */
+#define TRACE_DELTA_MAX 5	/* max bytes for one encoded delta */
+#define TRACE_SIZE_DEFAULT 16	/* MB */
+
 history_type_t HistoryTracking;
+bool HistoryTrace;
 
 typedef struct {
 	bool shown:1;
@@ -48,6 +59,16 @@ static struct {
 	hist_item_t *item; /* ring-buffer */
 } History;
 
+static struct {
+	uint8_t *buf;      /* chunks */
+	uint16_t *used;    /* bytes used in each chunk */
+	unsigned chunks;   /* ring-buffer size in chunks */
+	unsigned cur;      /* index of current chunk */
+	bool wrapped;      /* all chunks are in use */
+	uint32_t pc;       /* last recorded PC */
+	uint64_t count;    /* recorded instructions */
+} Trace;
+
 
 /**
  * Convert debugger entry/breakpoint entry reason to a string
@@ -163,6 +184,140 @@ void History_AddDsp(void)
 	History.item[History.idx].pc.dsp = pc;
 }
 
+/**
+ * Add CPU PC to trace, as zigzag encoded (halved) delta to previous PC
+ * in 7-bit groups. Sequential instructions and short branches take one
+ * byte.
+ */
+void History_AddTrace(void)
+{
+	uint32_t pc = M68000_GetPC();
+	int32_t delta = (int32_t)(pc - Trace.pc) >> 1;
+	uint32_t zz = ((uint32_t)delta << 1) ^ (uint32_t)(delta >> 31);
+	unsigned used = Trace.used[Trace.cur];
+	uint8_t *p;
+
+	if (((pc | Trace.pc) & 1) || used > TRACE_CHUNK_SIZE - TRACE_DELTA_MAX) {
+		/* odd delta would not survive halving, start new chunk for it */
+		Trace.cur++;
+		if (Trace.cur == Trace.chunks) {
+			Trace.cur = 0;
+			Trace.wrapped = true;
+		}
+		used = 0;
+	}
+	if (!used) {
+		p = Trace.buf + Trace.cur * TRACE_CHUNK_SIZE;
+		p[0] = pc >> 24;
+		p[1] = pc >> 16;
+		p[2] = pc >> 8;
+		p[3] = pc;
+		Trace.used[Trace.cur] = 4;
+	} else {
+		p = Trace.buf + Trace.cur * TRACE_CHUNK_SIZE + used;
+		while (zz >= 0x80) {
+			*p++ = zz | 0x80;
+			zz >>= 7;
+		}
+		*p++ = zz;
+		Trace.used[Trace.cur] = p - (Trace.buf + Trace.cur * TRACE_CHUNK_SIZE);
+	}
+	Trace.pc = pc;
+	Trace.count++;
+}
+
+/**
+ * Enable trace with given size in MB, or disable it with zero size
+ */
+static void History_EnableTrace(unsigned size)
+{
+	free(Trace.buf);
+	free(Trace.used);
+	memset(&Trace, 0, sizeof(Trace));
+	HistoryTrace = false;
+	if (!size) {
+		fprintf(stderr, "CPU trace disabled.\n");
+		return;
+	}
+	Trace.chunks = size * (1024 * 1024 / TRACE_CHUNK_SIZE);
+	Trace.buf = malloc(Trace.chunks * TRACE_CHUNK_SIZE);
+	Trace.used = calloc(Trace.chunks, sizeof(Trace.used[0]));
+	if (!Trace.buf || !Trace.used) {
+		fprintf(stderr, "ERROR: CPU trace alloc failed!\n");
+		History_EnableTrace(0);
+		return;
+	}
+	HistoryTrace = true;
+	fprintf(stderr, "CPU trace enabled (%d MB).\n", size);
+}
+
+/**
+ * Decode trace to given file, one PC per line, oldest first.
+ * Return number of decoded PCs.
+ */
+static uint64_t History_DecodeTrace(FILE *fp)
+{
+	unsigned chunk, n, used, shift;
+	const uint8_t *p, *end;
+	uint64_t count = 0;
+	uint32_t pc, zz;
+
+	if (!HistoryTrace || !Trace.count) {
+		return 0;
+	}
+	chunk = Trace.wrapped ? Trace.cur + 1 : 0;
+	for (n = Trace.wrapped ? Trace.chunks : Trace.cur + 1; n > 0; n--, chunk++) {
+		if (chunk == Trace.chunks) {
+			chunk = 0;
+		}
+		used = Trace.used[chunk];
+		if (!used) {
+			continue;
+		}
+		p = Trace.buf + chunk * TRACE_CHUNK_SIZE;
+		end = p + used;
+		pc = (uint32_t)p[0] << 24 | p[1] << 16 | p[2] << 8 | p[3];
+		p += 4;
+		fprintf(fp, "$%08x\n", pc);
+		count++;
+		while (p < end) {
+			zz = shift = 0;
+			do {
+				zz |= (uint32_t)(*p & 0x7f) << shift;
+				shift += 7;
+			} while (*p++ & 0x80);
+			pc += ((zz >> 1) ^ -(zz & 1)) << 1;
+			fprintf(fp, "$%08x\n", pc);
+			count++;
+		}
+	}
+	return count;
+}
+
+/*
+ * Save decoded trace to given file
+ */
+static void History_SaveTrace(const char *name)
+{
+	uint64_t count;
+	FILE *fp;
+
+	if (!HistoryTrace) {
+		fprintf(stderr, "ERROR: CPU trace is not enabled!\n");
+
+	} else if (File_Exists(name)) {
+		fprintf(stderr, "ERROR: file '%s' already exists!\n", name);
+
+	} else if ((fp = fopen(name, "w"))) {
+		count = History_DecodeTrace(fp);
+		fprintf(stderr, "%"PRIu64" of %"PRIu64" traced PC values saved to '%s'.\n",
+			count, Trace.count, name);
+		fclose(fp);
+	} else {
+		fprintf(stderr, "ERROR: opening '%s' failed (%d).\n", name, errno);
+	}
+}
+
 /**
  * Flag last history entry as debugger entry point, with given reason
  */
@@ -312,7 +467,7 @@ static void History_Save(const char *name)
  */
 char *History_Match(const char *text, int state)
 {
-	static const char* cmds[] = { "cpu", "dsp", "off", "save" };
+	static const char* cmds[] = { "cpu", "dsp", "off", "save", "trace" };
 	return DebugUI_MatchHelper(cmds, ARRAY_SIZE(cmds), text, state);
 }
 
@@ -326,6 +481,22 @@ int History_Parse(int nArgc, char *psArgs[])
 	if (nArgc < 2) {
 		return DebugUI_PrintCmdHelp(psArgs[0]);
 	}
+	if (strcmp(psArgs[1], "trace") == 0) {
+		if (nArgc == 4 && strcmp(psArgs[2], "save") == 0) {
+			History_SaveTrace(psArgs[3]);
+		} else if (nArgc == 3 && strcmp(psArgs[2], "off") == 0) {
+			History_EnableTrace(0);
+		} else if (nArgc <= 3) {
+			limit = nArgc == 3 ? atoi(psArgs[2]) : TRACE_SIZE_DEFAULT;
+			if (limit <= 0) {
+				return DebugUI_PrintCmdHelp(psArgs[0]);
+			}
+			History_EnableTrace(limit);
+		} else {
+			return DebugUI_PrintCmdHelp(psArgs[0]);
+		}
+		return DEBUGGER_CMDDONE;
+	}
 	if (nArgc > 2) {
 		limit = atoi(psArgs[2]);
 	}
@@ -17,6 +17,7 @@ typedef enum {
 } history_type_t;
 
 extern history_type_t HistoryTracking;
+extern bool HistoryTrace;
 
 static inline bool History_TrackCpu(void)
 {
@@ -30,6 +31,7 @@ static inline bool History_TrackDsp(void)
 /* for debugcpu/dsp.c */
 extern void History_AddCpu(void);
 extern void History_AddDsp(void);
+extern void History_AddTrace(void);
 extern uint32_t History_DisasmAddr(uint32_t pc, uint32_t offset, bool for_dsp);
 
 /* for debugInfo.c */
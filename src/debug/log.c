@@ -28,6 +28,7 @@ const char Log_fileid[] = "Hatari log.c";
 #include "log.h"
 #include "screen.h"
 #include "file.h"
+#include "host.h"
 #include "str.h"
 
 int ExceptionDebugMask;
@@ -86,6 +87,8 @@ static flagname_t TraceFlags[] = {
 	{ TRACE_IOMEM_ALL	 , "io_all" },
 	{ TRACE_IOMEM_RD	 , "io_read" },
 	{ TRACE_IOMEM_WR	 , "io_write" },
+
+	{ TRACE_ENET_PACKETS	 , "enet_packets" },
 };
 #endif /* ENABLE_TRACING */
 
@@ -114,8 +117,32 @@ static struct {
 
 static FILE *hLogFile = NULL;
 
+#if ENABLE_TRACING
+/* Ring buffer for LOG_TRACE_RING() messages, formatted by a thread */
+#define TRACE_RING_SIZE (1<<16)
+
+typedef struct {
+	atomic_int seq;
+	const char *format;
+	uint32_t a, b;
+} TraceRingEntry;
+
+static struct {
+	TraceRingEntry entry[TRACE_RING_SIZE];
+	atomic_int write;
+	atomic_int read;
+	atomic_int dropped;
+	atomic_int running;
+	thread_t *thread;
+} TraceRing;
+
+static int Log_TraceRingThread(void *data);
+#endif
+
+static void Log_TraceRingStop(void);
+
 /* local settings, to be able change them temporarily */
-static LOGTYPE TextLogLevel;
+LOGTYPE LogTextLevel;
 static LOGTYPE AlertDlgLogLevel;
 
 /*-----------------------------------------------------------------------*/
@@ -126,7 +153,7 @@ void Log_Default(void)
 {
 	hLogFile = stderr;
 	TraceFile = stderr;
-	TextLogLevel = LOG_INFO;
+	LogTextLevel = LOG_INFO;
 	MsgState.limit = REPEAT_LIMIT_INIT;
 }
 
@@ -135,7 +162,7 @@ void Log_Default(void)
  */
 void Log_SetLevels(void)
 {
-	TextLogLevel = ConfigureParams.Log.nTextLogLevel;
+	LogTextLevel = ConfigureParams.Log.nTextLogLevel;
 	AlertDlgLogLevel = ConfigureParams.Log.nAlertDlgLogLevel;
 }
 
@@ -179,6 +206,8 @@ int Log_SetAlertLevel(int level)
  */
 void Log_UnInit(void)
 {
+	Log_TraceRingStop();
+
 	/* Flush pending msg & drop cached prev msg FILE pointer
 	 * before log & trace FILE pointers change
 	 */
@@ -318,7 +347,7 @@ static void addMissingNewline(char *msg, int size)
  */
 void Log_PrintfInt(LOGTYPE nType, const char *psFormat, ...)
 {
-	if (!(hLogFile && nType <= TextLogLevel))
+	if (!(hLogFile && nType <= LogTextLevel))
 		return;
 
 	char line[sizeof(MsgState.prev)];
@@ -353,7 +382,7 @@ void Log_AlertDlg(LOGTYPE nType, const char *psFormat, ...)
 	va_list argptr;
 
 	/* Output to log file: */
-	if (hLogFile && nType <= TextLogLevel)
+	if (hLogFile && nType <= LogTextLevel)
 	{
 		char line[sizeof(MsgState.prev)];
 		int count, len = sizeof(line);
@@ -550,6 +579,10 @@ const char* Log_SetTraceOptions (const char *FlagsStr)
 
 	errstr = Log_ParseOptionFlags(FlagsStr, TraceFlags, ARRAY_SIZE(TraceFlags), &LogTraceFlags);
 
+	if (LogTraceFlags && !TraceRing.thread) {
+		host_atomic_set(&TraceRing.running, 1);
+		TraceRing.thread = host_thread_create(Log_TraceRingThread, "[Previous] Trace", NULL);
+	}
 	return errstr;
 }
 
@@ -602,6 +635,81 @@ void Log_Trace(const char *format, ...)
 	va_end(argptr);
 }
 
+/*-----------------------------------------------------------------------*/
+/**
+ * Store a trace message in the ring buffer. Writers reserve an entry
+ * and publish it by setting its sequence number, nothing is locked.
+ */
+void Log_TraceRing(const char *format, uint32_t a, uint32_t b)
+{
+	TraceRingEntry *entry;
+	int w;
+
+	if (!TraceRing.thread) {
+		Log_Trace(format, a, b);
+		return;
+	}
+	do {
+		w = host_atomic_get(&TraceRing.write);
+		if ((unsigned)(w - host_atomic_get(&TraceRing.read)) >= TRACE_RING_SIZE) {
+			host_atomic_add(&TraceRing.dropped, 1);
+			return;
+		}
+	} while (!host_atomic_cas(&TraceRing.write, w, w + 1));
+
+	entry = &TraceRing.entry[w & (TRACE_RING_SIZE - 1)];
+	entry->format = format;
+	entry->a      = a;
+	entry->b      = b;
+	host_atomic_set(&entry->seq, w + 1);
+}
+
+/**
+ * Format all published messages. Return true if there were any.
+ */
+static bool Log_TraceRingFlush(void)
+{
+	TraceRingEntry *entry;
+	int r = host_atomic_get(&TraceRing.read);
+	int dropped;
+	bool any = false;
+
+	for (;;) {
+		entry = &TraceRing.entry[r & (TRACE_RING_SIZE - 1)];
+		if (host_atomic_get(&entry->seq) != r + 1)
+			break;
+		if (TraceFile)
+			fprintf(TraceFile, entry->format, entry->a, entry->b);
+		host_atomic_set(&TraceRing.read, ++r);
+		any = true;
+	}
+	dropped = host_atomic_set(&TraceRing.dropped, 0);
+	if (dropped && TraceFile)
+		fprintf(TraceFile, "%d trace messages dropped\n", dropped);
+	if ((any || dropped) && TraceFile)
+		fflush(TraceFile);
+	return any;
+}
+
+static int Log_TraceRingThread(void *data)
+{
+	while (host_atomic_get(&TraceRing.running)) {
+		if (!Log_TraceRingFlush())
+			host_sleep_ms(5);
+	}
+	Log_TraceRingFlush();
+	return 0;
+}
+
+static void Log_TraceRingStop(void)
+{
+	if (TraceRing.thread) {
+		host_atomic_set(&TraceRing.running, 0);
+		host_thread_wait(TraceRing.thread);
+		TraceRing.thread = NULL;
+	}
+}
+
 #else	/* !ENABLE_TRACING */
 
 /** dummy */
@@ -619,4 +727,9 @@ char *Log_MatchTrace(const char *text, int state)
 /** dummy */
 void Log_Trace(const char *format, ...) {}
 
+/** dummy */
+void Log_TraceRing(const char *format, uint32_t a, uint32_t b) {}
+
+static void Log_TraceRingStop(void) {}
+
 #endif	/* !ENABLE_TRACING */
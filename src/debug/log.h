@@ -91,14 +91,23 @@ extern void Log_ToggleMsgRepeat(void);
 extern void Log_ResetMsgRepeat(void);
 extern void Log_Trace(const char *format, ...)
 	__attribute__ ((format (printf, 1, 2)));
+extern void Log_TraceRing(const char *format, uint32_t a, uint32_t b);
+
+extern LOGTYPE LogTextLevel;
 
 #ifndef __GNUC__
 #undef __attribute__
 #endif
 
-#define _Log_LOG_FATAL(nType, psFormat, ...) Log_PrintfInt(nType, psFormat, ## __VA_ARGS__)
-#define _Log_LOG_ERROR(nType, psFormat, ...) Log_PrintfInt(nType, psFormat, ## __VA_ARGS__)
-#define _Log_LOG_WARN(nType, psFormat, ...)  Log_PrintfInt(nType, psFormat, ## __VA_ARGS__)
+/* The level is checked before the arguments are evaluated, INFO, TODO
+ * and DEBUG messages are removed at compile time.
+ */
+#define _Log_LOG_CHECKED(nType, psFormat, ...) \
+	do { if (nType <= LogTextLevel) Log_PrintfInt(nType, psFormat, ## __VA_ARGS__); } while (0)
+
+#define _Log_LOG_FATAL(nType, psFormat, ...) _Log_LOG_CHECKED(nType, psFormat, ## __VA_ARGS__)
+#define _Log_LOG_ERROR(nType, psFormat, ...) _Log_LOG_CHECKED(nType, psFormat, ## __VA_ARGS__)
+#define _Log_LOG_WARN(nType, psFormat, ...)  _Log_LOG_CHECKED(nType, psFormat, ## __VA_ARGS__)
 #define _Log_LOG_INFO(nType, psFormat, ...)
 #define _Log_LOG_TODO(nType, psFormat, ...)
 #define _Log_LOG_DEBUG(nType, psFormat, ...)
@@ -140,6 +149,8 @@ enum {
 
 	TRACE_BIT_IOMEM_RD,
 	TRACE_BIT_IOMEM_WR,
+
+	TRACE_BIT_ENET_PACKETS,
 };
 
 #define TRACE_CPU_DISASM         (1ll<<TRACE_BIT_CPU_DISASM)
@@ -162,6 +173,8 @@ enum {
 #define TRACE_IOMEM_RD           (1ll<<TRACE_BIT_IOMEM_RD)
 #define TRACE_IOMEM_WR           (1ll<<TRACE_BIT_IOMEM_WR)
 
+#define TRACE_ENET_PACKETS       (1ll<<TRACE_BIT_ENET_PACKETS)
+
 #define	TRACE_NONE		 (0)
 #define	TRACE_ALL		 (~0ll)
 
@@ -183,12 +196,21 @@ extern uint64_t LogTraceFlags;
 #define	LOG_TRACE(level, ...) \
 	if (LOG_TRACE_LEVEL(level))	{ Log_Trace(__VA_ARGS__); }
 
+/* For high-rate traces with two integer arguments. Messages are stored
+ * in a ring buffer and formatted by a background thread, they are dropped
+ * if it can't keep up.
+ */
+#define	LOG_TRACE_RING(level, format, a, b) \
+	if (LOG_TRACE_LEVEL(level))	{ Log_TraceRing(format, a, b); }
+
 #define LOG_TRACE_VAR
 
 #else		/* ENABLE_TRACING */
 
 #define LOG_TRACE(level, ...)	{}
 
+#define LOG_TRACE_RING(level, ...)	{}
+
 #define LOG_TRACE_LEVEL( level )	(0)
 
 #ifdef __GNUC__
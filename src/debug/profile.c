@@ -10,8 +10,11 @@
  */
 const char Profile_fileid[] = "Hatari profile.c";
 
+#include <errno.h>
 #include "main.h"
 #include "debugui.h"
+#include "debug_priv.h"
+#include "file.h"
 #include "profile.h"
 
 
@@ -24,11 +27,16 @@ const char Profile_fileid[] = "Hatari profile.c";
  */
 char *Profile_Match(const char *text, int state)
 {
-	return NULL;
+	static const char* names[] = { "off", "on", "save", "stacks" };
+	return DebugUI_MatchHelper(names, ARRAY_SIZE(names), text, state);
 }
 
 const char Profile_Description[] =
-	  "<profile command is not supported on Previous>";
+	  "<on|stacks [rate]|off|save <file>>\n"
+	  "\tPrevious supports only sampling CPU profiling. 'on' samples the\n"
+	  "\tPC given times per second (default 1000), 'stacks' also follows\n"
+	  "\tthe A6 frame chain. 'save' writes the samples in folded stack\n"
+	  "\tformat, as used by the flamegraph tools.";
 
 
 /**
@@ -37,5 +45,41 @@ const char Profile_Description[] =
  */
 int Profile_Command(int nArgc, char *psArgs[], bool bForDsp)
 {
-	return DEBUGGER_CMDDONE;
+	int rate = 1000;
+	FILE *fp;
+
+	if (bForDsp) {
+		fprintf(stderr, "DSP profiling is not supported.\n");
+		return DEBUGGER_CMDDONE;
+	}
+	if (nArgc < 2) {
+		return DebugUI_PrintCmdHelp(psArgs[0]);
+	}
+	if (strcmp(psArgs[1], "on") == 0 || strcmp(psArgs[1], "stacks") == 0) {
+		if (nArgc > 2) {
+			rate = atoi(psArgs[2]);
+		}
+		if (rate <= 0 || rate > 100000) {
+			fprintf(stderr, "Sampling rate range is 1-100000 Hz\n");
+			return DEBUGGER_CMDDONE;
+		}
+		Profile_CpuSampleStart(rate, psArgs[1][0] == 's');
+		return DEBUGGER_CMDDONE;
+	}
+	if (strcmp(psArgs[1], "off") == 0) {
+		Profile_CpuSampleStop();
+		return DEBUGGER_CMDDONE;
+	}
+	if (strcmp(psArgs[1], "save") == 0 && nArgc == 3) {
+		if (File_Exists(psArgs[2])) {
+			fprintf(stderr, "ERROR: file '%s' already exists!\n", psArgs[2]);
+		} else if ((fp = fopen(psArgs[2], "w"))) {
+			Profile_CpuSampleSave(fp);
+			fclose(fp);
+		} else {
+			fprintf(stderr, "ERROR: opening '%s' failed (%d).\n", psArgs[2], errno);
+		}
+		return DEBUGGER_CMDDONE;
+	}
+	return DebugUI_PrintCmdHelp(psArgs[0]);
 }
@@ -32,6 +32,12 @@ extern bool Profile_CpuStart(void);
 extern void Profile_CpuUpdate(void);
 extern void Profile_CpuStop(void);
 
+/* CPU sampling profiler */
+extern void Profile_CpuSampleHandler(void);
+extern void Profile_CpuSampleStart(int rate, bool stacks);
+extern void Profile_CpuSampleStop(void);
+extern void Profile_CpuSampleSave(FILE *fp);
+
 /* CPU profile results */
 extern bool Profile_CpuAddr_HasData(uint32_t addr);
 extern int Profile_CpuAddr_DataStr(char *buffer, int maxlen, uint32_t addr);
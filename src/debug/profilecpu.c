@@ -7,11 +7,219 @@
  * or at your option any later version. Read the file gpl.txt for details.
  *
  * profilecpu.c - functions for profiling CPU and showing the results.
+ *
+ * The sampling profiler records the PC, and optionally the return
+ * addresses of the A6 frame chain, at a fixed rate from a microsecond
+ * interrupt, which follows host time in realtime mode. Identical stacks
+ * are counted in a hash table and saved in the folded stack format of
+ * the flamegraph tools.
  */
 const char Profilecpu_fileid[] = "Hatari profilecpu.c";
 
+#include <inttypes.h>
 #include "main.h"
+#include "cycInt.h"
+#include "m68000.h"
+#include "hosttlb.h"
 #include "profile.h"
+#include "symbols.h"
+
+#define SAMPLE_DEPTH_MAX	32	/* max. stack depth per sample */
+#define SAMPLE_TABLE_MIN	4096	/* initial hash table size */
+
+typedef struct {
+	uint32_t count;		/* zero for an empty slot */
+	uint32_t depth;
+	uint32_t pc[SAMPLE_DEPTH_MAX];	/* leaf first */
+} sample_t;
+
+static struct {
+	int rate;		/* samples per second, zero if not sampling */
+	bool stacks;		/* walk A6 frames */
+	uint64_t total;		/* samples taken */
+	unsigned size;		/* hash table size, power of two */
+	unsigned used;		/* used hash table slots */
+	sample_t *table;
+} Samples;
+
+
+/* ------------------ CPU sampling profiler ----------------- */
+
+static uint32_t Profile_SampleHash(const uint32_t *pc, uint32_t depth)
+{
+	uint32_t h = depth;
+
+	while (depth--) {
+		h = (h ^ *pc++) * 0x9e3779b1;
+	}
+	return h ^ (h >> 16);
+}
+
+/**
+ * Find slot for given stack, or free slot where to add it
+ */
+static sample_t *Profile_SampleFind(const uint32_t *pc, uint32_t depth)
+{
+	unsigned mask = Samples.size - 1;
+	unsigned i = Profile_SampleHash(pc, depth) & mask;
+	sample_t *s;
+
+	for (;; i = (i + 1) & mask) {
+		s = &Samples.table[i];
+		if (!s->count || (s->depth == depth &&
+		    memcmp(s->pc, pc, depth * sizeof(pc[0])) == 0)) {
+			return s;
+		}
+	}
+}
+
+/**
+ * Double hash table size, return false if that fails
+ */
+static bool Profile_SampleGrow(void)
+{
+	sample_t *old = Samples.table;
+	unsigned i, size = Samples.size;
+
+	Samples.table = calloc(size * 2, sizeof(sample_t));
+	if (!Samples.table) {
+		Samples.table = old;
+		return false;
+	}
+	Samples.size = size * 2;
+	for (i = 0; i < size; i++) {
+		if (old[i].count) {
+			*Profile_SampleFind(old[i].pc, old[i].depth) = old[i];
+		}
+	}
+	free(old);
+	return true;
+}
+
+/**
+ * Record current PC and caller return addresses. Frames are only
+ * followed through pages that are in the host TLB, so that sampling
+ * never causes MMU faults.
+ */
+static void Profile_CpuSample(void)
+{
+	uint32_t pc[SAMPLE_DEPTH_MAX];
+	uint32_t depth = 0, fp, next, ret;
+	uint32_t fc = regs.s ? 5 : 1;
+	sample_t *s;
+
+	pc[depth++] = M68000_GetPC();
+	if (Samples.stacks) {
+		fp = regs.regs[REG_A6];
+		while (depth < SAMPLE_DEPTH_MAX && fp && !(fp & 1) &&
+		       hosttlb_peek_long(fp, fc, &next) &&
+		       hosttlb_peek_long(fp + 4, fc, &ret)) {
+			pc[depth++] = ret;
+			/* caller frames are at higher addresses */
+			if (next <= fp) {
+				break;
+			}
+			fp = next;
+		}
+	}
+
+	if (Samples.used * 2 >= Samples.size && !Profile_SampleGrow()) {
+		return;
+	}
+	s = Profile_SampleFind(pc, depth);
+	if (!s->count) {
+		s->depth = depth;
+		memcpy(s->pc, pc, depth * sizeof(pc[0]));
+		Samples.used++;
+	}
+	s->count++;
+	Samples.total++;
+}
+
+/**
+ * Interrupt handler for taking samples
+ */
+void Profile_CpuSampleHandler(void)
+{
+	CycInt_AcknowledgeInterrupt();
+	if (!Samples.rate) {
+		return;
+	}
+	Profile_CpuSample();
+	CycInt_AddRelativeInterruptUs(1000000 / Samples.rate, 1000000 / Samples.rate, INTERRUPT_PROFILE);
+}
+
+/**
+ * Start sampling given times per second, discarding earlier samples
+ */
+void Profile_CpuSampleStart(int rate, bool stacks)
+{
+	Profile_CpuSampleStop();
+	free(Samples.table);
+	memset(&Samples, 0, sizeof(Samples));
+
+	Samples.table = calloc(SAMPLE_TABLE_MIN, sizeof(sample_t));
+	if (!Samples.table) {
+		fprintf(stderr, "ERROR: allocating sample table failed!\n");
+		return;
+	}
+	Samples.size = SAMPLE_TABLE_MIN;
+	Samples.rate = rate;
+	Samples.stacks = stacks;
+	CycInt_AddRelativeInterruptUs(1000000 / rate, 1000000 / rate, INTERRUPT_PROFILE);
+	fprintf(stderr, "CPU sampling enabled (%d Hz%s).\n", rate, stacks ? ", A6 stacks" : "");
+}
+
+/**
+ * Stop sampling, keep samples for saving
+ */
+void Profile_CpuSampleStop(void)
+{
+	if (Samples.rate) {
+		CycInt_RemovePendingInterrupt(INTERRUPT_PROFILE);
+		Samples.rate = 0;
+		fprintf(stderr, "CPU sampling stopped, %"PRIu64" samples.\n", Samples.total);
+	}
+}
+
+/**
+ * Write name of the function containing address if there's one for it
+ */
+static void Profile_SampleAddr(FILE *fp, uint32_t addr)
+{
+	uint32_t offset;
+	const char *name = Symbols_GetCpuFunction(addr, &offset);
+
+	if (name) {
+		fputs(name, fp);
+	} else {
+		fprintf(fp, "$%08x", addr);
+	}
+}
+
+/**
+ * Save samples in folded stack format, outermost caller first
+ */
+void Profile_CpuSampleSave(FILE *fp)
+{
+	const sample_t *s;
+	unsigned i;
+	int d;
+
+	for (i = 0; i < Samples.size; i++) {
+		s = &Samples.table[i];
+		if (!s->count) {
+			continue;
+		}
+		for (d = s->depth - 1; d >= 0; d--) {
+			Profile_SampleAddr(fp, s->pc[d]);
+			fputc(d ? ';' : ' ', fp);
+		}
+		fprintf(fp, "%u\n", s->count);
+	}
+	fprintf(stderr, "%u different stacks from %"PRIu64" samples saved.\n",
+		Samples.used, Samples.total);
+}
 
 
 /* ------------------ CPU profile results ----------------- */
@@ -1,33 +1,378 @@
 /*
  * Hatari - symbols.c
- * 
+ *
  * Copyright (C) 2010-2024 by Eero Tamminen
- * 
+ *
  * This file is distributed under the GNU General Public License, version 2
  * or at your option any later version. Read the file gpl.txt for details.
- * 
+ *
  * symbols.c - Hatari debugger symbol/address handling; parsing, sorting,
  * matching, TAB completion support etc.
- * 
+ *
  * Symbol/address information is read either from:
- * - A program file's symbol table (in DRI/GST, a.out, or ELF format), or
+ * - A Mach-O file's symbol table, for example the NeXTSTEP kernel, or
  * - ASCII file which contents are subset of "nm" output i.e. composed of
  *   a hexadecimal addresses followed by a space, letter indicating symbol
  *   type (T = text/code, D = data, B = BSS), space and the symbol name.
  *   Empty lines and lines starting with '#' are ignored.  It's AHCC SYM
  *   output compatible.
+ *
+ * Previous only has CPU symbols. When the debugger is invoked without
+ * symbols, the kernel symbol table is read from the boot disk image.
+ *
+ * Symbols are kept sorted by address, with the addresses in a separate
+ * array so that the binary search for the profiler and the disassembler
+ * touches as little memory as possible.
  */
 const char Symbols_fileid[] = "Hatari symbols.c";
 
+#include <ctype.h>
+
 #include "main.h"
+#include "configuration.h"
 #include "symbols.h"
 #include "debugui.h"
+#include "debug_priv.h"
+#include "file.h"
+#include "str.h"
+
+typedef struct {
+	symbol_t *addresses;	/* sorted by address, code first */
+	symbol_t **names;	/* sorted by name */
+	uint32_t *keys;		/* addresses[].address for the search */
+	int count;
+	int codecount;
+} symbol_list_t;
+
+static symbol_list_t *CpuSymbols;
+static bool KernelTried;
+
+/* Mach-O constants */
+#define MH_MAGIC	0xfeedface
+#define LC_SEGMENT	0x1
+#define LC_SYMTAB	0x2
+#define N_STAB		0xe0
+#define N_TYPE		0x0e
+#define N_ABS		0x02
+#define N_SECT		0x0e
+#define MAX_SECTS	32
+
+
+/* ---------------- list handling ------------------ */
+
+static void Symbols_Free(symbol_list_t *list)
+{
+	int i;
+
+	if (!list)
+		return;
+	for (i = 0; i < list->count; i++) {
+		if (list->addresses[i].name_allocated)
+			free(list->addresses[i].name);
+	}
+	free(list->addresses);
+	free(list->names);
+	free(list->keys);
+	free(list);
+}
+
+static int symbols_by_address(const void *s1, const void *s2)
+{
+	const symbol_t *sym1 = s1, *sym2 = s2;
+
+	if (sym1->address != sym2->address)
+		return sym1->address < sym2->address ? -1 : 1;
+	/* code symbols before other types at the same address */
+	return (int)sym1->type - (int)sym2->type;
+}
+
+static int symbols_by_name(const void *s1, const void *s2)
+{
+	const symbol_t *sym1 = *(const symbol_t * const *)s1;
+	const symbol_t *sym2 = *(const symbol_t * const *)s2;
+
+	return strcmp(sym1->name, sym2->name);
+}
+
+/**
+ * Sort given symbols and build the lookup arrays. Takes ownership
+ * of the symbols. Return NULL if there are none.
+ */
+static symbol_list_t *Symbols_Build(symbol_t *symbols, int count)
+{
+	symbol_list_t *list;
+	int i;
+
+	if (!count) {
+		free(symbols);
+		return NULL;
+	}
+	list = calloc(1, sizeof(*list));
+	list->addresses = symbols;
+	list->count = count;
+	list->names = malloc(count * sizeof(*list->names));
+	list->keys = malloc(count * sizeof(*list->keys));
+
+	qsort(symbols, count, sizeof(*symbols), symbols_by_address);
+	for (i = 0; i < count; i++) {
+		list->keys[i] = symbols[i].address;
+		list->names[i] = &symbols[i];
+		if (symbols[i].type & SYMTYPE_CODE)
+			list->codecount++;
+	}
+	qsort(list->names, count, sizeof(*list->names), symbols_by_name);
+	return list;
+}
+
+/**
+ * Return index of first symbol with address >= addr
+ */
+static int Symbols_LowerBound(const symbol_list_t *list, uint32_t addr)
+{
+	int lo = 0, hi = list->count;
+
+	while (lo < hi) {
+		int mid = (lo + hi) / 2;
+		if (list->keys[mid] < addr)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+/**
+ * Return index of first symbol with name >= text
+ */
+static int Symbols_NameBound(const symbol_list_t *list, const char *text)
+{
+	int lo = 0, hi = list->count;
+
+	while (lo < hi) {
+		int mid = (lo + hi) / 2;
+		if (strcmp(list->names[mid]->name, text) < 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+
+/* ---------------- loading ------------------ */
+
+static inline uint32_t be32(const uint8_t *p)
+{
+	return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+/**
+ * Parse symbol table of a big-endian Mach-O file. Return NULL if
+ * there is none.
+ */
+static symbol_list_t *Symbols_ParseMachO(const uint8_t *buf, uint32_t size)
+{
+	symtype_t sects[MAX_SECTS + 1];
+	uint32_t ncmds, cmd, cmdsize, off, symoff = 0, nsyms = 0, stroff = 0, strsize = 0;
+	int nsects = 0, count = 0;
+	symbol_t *symbols;
+	uint32_t i, j;
+
+	if (size < 28 || be32(buf) != MH_MAGIC)
+		return NULL;
+
+	ncmds = be32(buf + 16);
+	off = 28;
+	for (i = 0; i < ncmds && off + 8 <= size; i++, off += cmdsize) {
+		cmd = be32(buf + off);
+		cmdsize = be32(buf + off + 4);
+		if (cmdsize < 8 || off + cmdsize > size)
+			return NULL;
+		if (cmd == LC_SEGMENT && cmdsize >= 56) {
+			/* sections are numbered in load command order, from 1 */
+			uint32_t n = be32(buf + off + 48);
+			for (j = 0; j < n && 56 + (j + 1) * 68 <= cmdsize; j++) {
+				const char *sectname = (const char *)buf + off + 56 + j * 68;
+				if (nsects >= MAX_SECTS)
+					break;
+				if (!strncmp(sectname, "__text", 16))
+					sects[++nsects] = SYMTYPE_TEXT;
+				else if (!strncmp(sectname, "__bss", 16))
+					sects[++nsects] = SYMTYPE_BSS;
+				else
+					sects[++nsects] = SYMTYPE_DATA;
+			}
+		} else if (cmd == LC_SYMTAB && cmdsize >= 24) {
+			symoff = be32(buf + off + 8);
+			nsyms = be32(buf + off + 12);
+			stroff = be32(buf + off + 16);
+			strsize = be32(buf + off + 20);
+		}
+	}
+	if (!nsyms || nsyms > size / 12 || symoff > size - nsyms * 12 ||
+	    stroff > size || strsize > size - stroff)
+		return NULL;
+
+	symbols = malloc(nsyms * sizeof(*symbols));
+	for (i = 0; i < nsyms; i++) {
+		const uint8_t *nl = buf + symoff + i * 12;
+		uint32_t strx = be32(nl);
+		uint8_t type = nl[4], sect = nl[5];
+		symtype_t symtype;
+
+		if ((type & N_STAB) || strx == 0 || strx >= strsize)
+			continue;
+		if ((type & N_TYPE) == N_SECT && sect > 0 && sect <= nsects)
+			symtype = sects[sect];
+		else if ((type & N_TYPE) == N_ABS)
+			symtype = SYMTYPE_ABS;
+		else
+			continue;
+		/* names end within the string table */
+		if (!memchr(buf + stroff + strx, 0, strsize - strx))
+			continue;
+		symbols[count].name = Str_Dup((const char *)buf + stroff + strx);
+		symbols[count].address = be32(nl + 8);
+		symbols[count].type = symtype;
+		symbols[count].name_allocated = true;
+		count++;
+	}
+	return Symbols_Build(symbols, count);
+}
+
+/**
+ * Parse ASCII "nm" style symbol file. Return NULL on error.
+ */
+static symbol_list_t *Symbols_ParseAscii(const char *path)
+{
+	char line[256], name[200], typechar;
+	symbol_t *symbols = NULL;
+	int count = 0, alloc = 0, lineno = 0;
+	uint32_t address;
+	symtype_t symtype;
+	FILE *fp;
+
+	fp = fopen(path, "r");
+	if (!fp)
+		return NULL;
+	while (fgets(line, sizeof(line), fp)) {
+		char *s = Str_Trim(line);
+
+		lineno++;
+		if (!s[0] || s[0] == '#')
+			continue;
+		if (sscanf(s, "%x %c %199s", &address, &typechar, name) != 3) {
+			fprintf(stderr, "WARNING: syntax error in '%s' on line %d, skipping.\n", path, lineno);
+			continue;
+		}
+		switch (toupper((unsigned char)typechar)) {
+			case 'T': symtype = SYMTYPE_TEXT; break;
+			case 'W': symtype = SYMTYPE_WEAK; break;
+			case 'D':
+			case 'R': symtype = SYMTYPE_DATA; break;
+			case 'B': symtype = SYMTYPE_BSS; break;
+			case 'A': symtype = SYMTYPE_ABS; break;
+			default: continue;
+		}
+		if (count == alloc) {
+			alloc = alloc ? 2 * alloc : 1024;
+			symbols = realloc(symbols, alloc * sizeof(*symbols));
+		}
+		symbols[count].name = Str_Dup(name);
+		symbols[count].address = address;
+		symbols[count].type = symtype;
+		symbols[count].name_allocated = true;
+		count++;
+	}
+	fclose(fp);
+	return Symbols_Build(symbols, count);
+}
+
+/**
+ * Load symbols from a Mach-O or ASCII symbol file
+ */
+static symbol_list_t *Symbols_LoadFile(const char *path)
+{
+	symbol_list_t *list;
+	long size;
+	uint8_t *buf;
+
+	buf = File_ReadAsIs(path, &size);
+	if (!buf)
+		return NULL;
+	if (size >= 4 && be32(buf) == MH_MAGIC)
+		list = Symbols_ParseMachO(buf, size);
+	else
+		list = Symbols_ParseAscii(path);
+	free(buf);
+	return list;
+}
+
+/**
+ * Read kernel symbols from the first SCSI disk with a kernel on it.
+ * The image file is read as is, changes in an overlay are not seen.
+ */
+static symbol_list_t *Symbols_LoadKernel(void)
+{
+	static const char *kernels[] = { "mach", "sdmach", "odmach" };
+	symbol_list_t *list;
+	uint32_t size;
+	uint8_t *buf;
+	int i, k;
+
+	for (i = 0; i < ESP_MAX_DEVS; i++) {
+		const SCSIDISK *disk = &ConfigureParams.SCSI.target[i];
+		if (disk->nDeviceType != SD_HARDDISK || !disk->bDiskInserted)
+			continue;
+		for (k = 0; k < ARRAY_SIZE(kernels); k++) {
+			buf = Symbols_ReadImageFile(disk->szImageName, kernels[k], &size);
+			if (!buf)
+				continue;
+			list = Symbols_ParseMachO(buf, size);
+			free(buf);
+			if (list) {
+				fprintf(stderr, "Loaded %d symbols from /%s in '%s'.\n",
+				        list->count, kernels[k], disk->szImageName);
+				return list;
+			}
+		}
+	}
+	return NULL;
+}
 
 /**
  * Free all symbols (at exit).
  */
 void Symbols_FreeAll(void)
 {
+	Symbols_Free(CpuSymbols);
+	CpuSymbols = NULL;
+}
+
+
+/* ---------------- matching ------------------ */
+
+/**
+ * Helper for symbol name completion of given types.
+ */
+static char* Symbols_MatchByType(symbol_list_t *list, symtype_t symtype, const char *text, int state)
+{
+	static int i, len;
+
+	if (!list)
+		return NULL;
+	if (!state) {
+		i = Symbols_NameBound(list, text);
+		len = strlen(text);
+	}
+	while (i < list->count) {
+		const symbol_t *sym = list->names[i++];
+		if (strncmp(sym->name, text, len) != 0)
+			return NULL;
+		if (sym->type & symtype)
+			return strdup(sym->name);
+	}
+	return NULL;
 }
 
 /**
@@ -37,15 +382,15 @@ void Symbols_FreeAll(void)
  */
 char* Symbols_MatchCpuAddress(const char *text, int state)
 {
-	return NULL;
+	return Symbols_MatchByType(CpuSymbols, SYMTYPE_ALL, text, state);
 }
 char* Symbols_MatchCpuCodeAddress(const char *text, int state)
 {
-	return NULL;
+	return Symbols_MatchByType(CpuSymbols, SYMTYPE_CODE, text, state);
 }
 char* Symbols_MatchCpuDataAddress(const char *text, int state)
 {
-	return NULL;
+	return Symbols_MatchByType(CpuSymbols, SYMTYPE_DATA|SYMTYPE_BSS, text, state);
 }
 
 /**
@@ -72,6 +417,19 @@ char* Symbols_MatchDspDataAddress(const char *text, int state)
  */
 bool Symbols_GetCpuAddress(symtype_t symtype, const char *name, uint32_t *addr)
 {
+	int i;
+
+	if (!CpuSymbols)
+		return false;
+	for (i = Symbols_NameBound(CpuSymbols, name); i < CpuSymbols->count; i++) {
+		const symbol_t *sym = CpuSymbols->names[i];
+		if (strcmp(sym->name, name) != 0)
+			break;
+		if (sym->type & symtype) {
+			*addr = sym->address;
+			return true;
+		}
+	}
 	return false;
 }
 bool Symbols_GetDspAddress(symtype_t symtype, const char *name, uint32_t *addr)
@@ -79,6 +437,27 @@ bool Symbols_GetDspAddress(symtype_t symtype, const char *name, uint32_t *addr)
 	return false;
 }
 
+/**
+ * Set start and end of the named code symbol, the end being the address of
+ * the following code symbol. Kernel symbols are loaded if there are none.
+ * Return true if the symbol was found and has a following symbol.
+ */
+bool Symbols_GetCpuFunctionRange(const char *name, uint32_t *start, uint32_t *end)
+{
+	int i;
+
+	Symbols_LoadCurrentProgram();
+	if (!Symbols_GetCpuAddress(SYMTYPE_CODE, name, start))
+		return false;
+	for (i = Symbols_LowerBound(CpuSymbols, *start + 1); i < CpuSymbols->count; i++) {
+		if (CpuSymbols->addresses[i].type & SYMTYPE_CODE) {
+			*end = CpuSymbols->keys[i];
+			return true;
+		}
+	}
+	return false;
+}
+
 /**
  * Search symbol in given list by type & address.
  * Return symbol name if there's a match, NULL otherwise.
@@ -87,6 +466,15 @@ bool Symbols_GetDspAddress(symtype_t symtype, const char *name, uint32_t *addr)
  */
 const char* Symbols_GetByCpuAddress(uint32_t addr, symtype_t type)
 {
+	int i;
+
+	if (!CpuSymbols)
+		return NULL;
+	for (i = Symbols_LowerBound(CpuSymbols, addr);
+	     i < CpuSymbols->count && CpuSymbols->keys[i] == addr; i++) {
+		if (CpuSymbols->addresses[i].type & type)
+			return CpuSymbols->addresses[i].name;
+	}
 	return NULL;
 }
 const char* Symbols_GetByDspAddress(uint32_t addr, symtype_t type)
@@ -94,17 +482,44 @@ const char* Symbols_GetByDspAddress(uint32_t addr, symtype_t type)
 	return NULL;
 }
 
+/**
+ * Search the code symbol at or before given address, i.e. the function
+ * containing it. Offset from the symbol is stored to 'offset'.
+ * Return NULL if there is none.
+ */
+const char* Symbols_GetCpuFunction(uint32_t addr, uint32_t *offset)
+{
+	int i;
+
+	if (!CpuSymbols || !CpuSymbols->codecount)
+		return NULL;
+	i = Symbols_LowerBound(CpuSymbols, addr);
+	if (i == CpuSymbols->count || CpuSymbols->keys[i] != addr)
+		i--;
+	for (; i >= 0; i--) {
+		const symbol_t *sym = &CpuSymbols->addresses[i];
+		if (sym->type & SYMTYPE_CODE) {
+			*offset = addr - sym->address;
+			return sym->name;
+		}
+	}
+	return NULL;
+}
+
 /**
  * Load symbols for last opened program when symbol autoloading is enabled.
  *
- * If there's file with same name as the program, but with '.sym'
- * extension, that overrides / is loaded instead of the symbol table
- * in the program.
+ * On Previous this loads the kernel symbols from the boot disk once,
+ * if no symbols have been loaded.
  *
  * Called when debugger is invoked.
  */
 void Symbols_LoadCurrentProgram(void)
 {
+	if (CpuSymbols || KernelTried)
+		return;
+	KernelTried = true;
+	CpuSymbols = Symbols_LoadKernel();
 }
 
 /* ---------------- command parsing ------------------ */
@@ -116,16 +531,80 @@ void Symbols_LoadCurrentProgram(void)
  */
 char *Symbols_MatchCommand(const char *text, int state)
 {
-	return NULL;
+	static const char* subs[] = {
+		"addr", "free", "kernel", "name"
+	};
+	return DebugUI_MatchHelper(subs, ARRAY_SIZE(subs), text, state);
 }
 
 const char Symbols_Description[] =
-	"<symbols command is not supported on Previous>";
+	"<filename|kernel|addr|name|free>\n"
+	"\tLoads symbols from a Mach-O file or an 'nm' style ASCII file,\n"
+	"\tor the kernel symbols from the first SCSI disk image with 'kernel'.\n"
+	"\tKernel symbols are loaded automatically when there are none.\n"
+	"\t'addr' and 'name' list the symbols sorted by address or name,\n"
+	"\t'free' removes them. Only CPU symbols are supported.";
+
+/**
+ * List loaded symbols in address or name order
+ */
+static void Symbols_Show(bool byname)
+{
+	int i;
+
+	if (!CpuSymbols) {
+		fprintf(stderr, "No symbols loaded.\n");
+		return;
+	}
+	for (i = 0; i < CpuSymbols->count; i++) {
+		const symbol_t *sym = byname ? CpuSymbols->names[i] : &CpuSymbols->addresses[i];
+		char type = 'A';
+		switch (sym->type) {
+			case SYMTYPE_TEXT: type = 'T'; break;
+			case SYMTYPE_WEAK: type = 'W'; break;
+			case SYMTYPE_DATA: type = 'D'; break;
+			case SYMTYPE_BSS:  type = 'B'; break;
+			default: break;
+		}
+		fprintf(debugOutput, "0x%08x %c %s\n", sym->address, type, sym->name);
+	}
+	fprintf(debugOutput, "%d symbols.\n", CpuSymbols->count);
+}
 
 /**
  * Handle debugger 'symbols' command and its arguments
  */
 int Symbols_Command(int nArgc, char *psArgs[])
 {
+	symbol_list_t *list;
+
+	if (nArgc < 2) {
+		DebugUI_PrintCmdHelp(psArgs[0]);
+		return DEBUGGER_CMDDONE;
+	}
+	if (strcmp(psArgs[1], "addr") == 0 || strcmp(psArgs[1], "name") == 0) {
+		Symbols_Show(psArgs[1][0] == 'n');
+		return DEBUGGER_CMDDONE;
+	}
+	if (strcmp(psArgs[1], "free") == 0) {
+		Symbols_FreeAll();
+		return DEBUGGER_CMDDONE;
+	}
+	if (strcmp(psArgs[1], "kernel") == 0) {
+		list = Symbols_LoadKernel();
+		if (!list) {
+			fprintf(stderr, "No kernel with symbols found on SCSI disk images.\n");
+			return DEBUGGER_CMDDONE;
+		}
+	} else {
+		list = Symbols_LoadFile(psArgs[1]);
+		if (!list) {
+			fprintf(stderr, "No symbols loaded from '%s'.\n", psArgs[1]);
+			return DEBUGGER_CMDDONE;
+		}
+		fprintf(stderr, "Loaded %d symbols from '%s'.\n", list->count, psArgs[1]);
+	}
+	Symbols_FreeAll();
+	CpuSymbols = list;
 	return DEBUGGER_CMDDONE;
 }
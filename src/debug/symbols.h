@@ -42,6 +42,9 @@ extern bool Symbols_GetDspAddress(symtype_t symtype, const char *name, uint32_t
 /* symbol address -> name search */
 extern const char* Symbols_GetByCpuAddress(uint32_t addr, symtype_t symtype);
 extern const char* Symbols_GetByDspAddress(uint32_t addr, symtype_t symtype);
+/* code address -> containing function search */
+extern const char* Symbols_GetCpuFunction(uint32_t addr, uint32_t *offset);
+extern bool Symbols_GetCpuFunctionRange(const char *name, uint32_t *start, uint32_t *end);
 /* handlers for automatic program symbol loading */
 extern void Symbols_LoadCurrentProgram(void);
 extern void Symbols_FreeAll(void);
@@ -0,0 +1,65 @@
+/*
+  Previous - symbols_image.cpp
+
+  This file is distributed under the GNU General Public License, version 2
+  or at your option any later version. Read the file gpl.txt for details.
+
+  Read a file from the root directory of a NeXT disk image, used to load
+  the kernel symbol table without extracting the kernel first.
+*/
+
+#include <cstdlib>
+#include <string>
+
+#include "DiskImage.h"
+#include "UFS.h"
+
+using namespace std;
+
+// Look up name in the root directory, following symbolic links to other
+// root directory entries.
+static bool findRootFile(UFS& ufs, string name, icommon& inode) {
+    for(int links = 0; links < 8; links++) {
+        vector<direct> entries = ufs.list(ROOTINO);
+        size_t i;
+        for(i = 0; i < entries.size(); i++) {
+            if(name == entries[i].d_name) break;
+        }
+        if(i == entries.size() || ufs.readInode(inode, fsv(entries[i].d_inonum)))
+            return false;
+
+        switch(fsv(inode.ic_mode) & IFMT) {
+            case IFREG:
+                return true;
+            case IFLNK:
+                name = ufs.readlink(inode);
+                while(!(name.empty()) && name[0] == '/') name.erase(0, 1);
+                if(name.find('/') != string::npos) return false;
+                break;
+            default:
+                return false;
+        }
+    }
+    return false;
+}
+
+extern "C" uint8_t* Symbols_ReadImageFile(const char* image, const char* name, uint32_t* size) {
+    DiskImage im(image);
+    if(!(im.valid())) return NULL;
+
+    for(size_t p = 0; p < im.parts.size(); p++) {
+        if(!(im.parts[p].isUFS())) continue;
+
+        UFS     ufs(im.parts[p]);
+        icommon inode;
+        if(!(findRootFile(ufs, name, inode))) continue;
+
+        *size = ufs.fileSize(inode);
+        uint8_t* data = (uint8_t*)malloc(*size ? *size : 1);
+        if(data && ufs.readFile(inode, 0, *size, data) == 0)
+            return data;
+        free(data);
+        return NULL;
+    }
+    return NULL;
+}
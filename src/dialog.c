@@ -174,8 +174,9 @@ void Dialog_CheckFiles(void) {
 		}
 	}
 	
-	/* Check if NFS shared direcory and printer output directory exist. */
-	while (!bQuitProgram && !File_DirExists(ConfigureParams.Ethernet.szNFSroot)) {
+	/* Check if NFS shared direcory (or disk image) and printer output directory exist. */
+	while (!bQuitProgram && !File_DirExists(ConfigureParams.Ethernet.szNFSroot) &&
+	       !File_Exists(ConfigureParams.Ethernet.szNFSroot)) {
 		DlgMissing_Dir("NFS shared", ConfigureParams.Ethernet.szNFSroot, Paths_GetUserHome());
 	}
 	while (!bQuitProgram && !File_DirExists(ConfigureParams.Printer.szPrintToFileName)) {
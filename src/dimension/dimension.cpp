@@ -6,6 +6,7 @@
 */
 
 #include <stdlib.h>
+#include <inttypes.h>
 
 #include "main.h"
 #include "configuration.h"
@@ -37,24 +38,25 @@
 NextDimension::NextDimension(int slot) :
     NextBusBoard(slot),
     mem_banks(new ND_Addrbank*[65536]),
-    ram(malloc_aligned(64*1024*1024)),
-    vram(malloc_aligned(4*1024*1024)),
+    ram(malloc_guest(64*1024*1024, ConfigureParams.Memory.bHugePages)),
+    vram(malloc_guest(4*1024*1024, ConfigureParams.Memory.bHugePages)),
     rom(malloc_aligned(128*1024)),
     dmem(malloc_aligned(512)),
     rom_command(0),
     rom_last_addr(0),
     display_vbl(false),
     video_vbl(false),
-    sdl(slot, (uint32_t*)vram),
+    sdl(slot, (uint32_t*)vram, vram_dirty[ND_VRAM_WINDOW]),
     i860(this),
     nbic(slot, ND_NBIC_ID),
     mc(this),
     dp(this),
     dmcd(this),
     dcsc0(this, 0),
-    dcsc1(this, 1)
+    dcsc1(this, 1),
+    vio(this),
+    ramdac()
 {
-    host_atomic_set(&m_port, 0);
     i860.uninit();
     nbic.init();
     mc.init();
@@ -65,6 +67,7 @@ NextDimension::NextDimension(int slot) :
 }
 
 NextDimension::~NextDimension() {
+    vio.set_sink(NULL, NULL);
     i860.uninit();
     sdl.destroy();
     
@@ -178,17 +181,68 @@ void NextDimension::slot_bput(uint32_t addr, uint8_t b) {
     }
 }
 
-void NextDimension::send_msg(int msg) {
-    int old_value, new_value;
-    do {
-        old_value = host_atomic_get(&m_port);
-        new_value = old_value | msg;
-        switch (msg) {
-            case MSG_LOWER_INTR: new_value &= ~MSG_RAISE_INTR; break;
-            case MSG_RAISE_INTR: new_value &= ~MSG_LOWER_INTR; break;
-            default: break;
+/* NeXTdimension block access (m68k, DMA). The bank is resolved once per
+ * 64 KB, memory with a host pointer is copied directly. */
+void NextDimension::copy_in(uint32_t addr, uint32_t len, uint8_t* buf, bool slot) {
+    while (len) {
+        uint32_t n     = 0x10000 - (addr & 0xFFFF);
+        uint8_t* host  = nd68k_get_mem_bank(addr)->host(addr);
+        if (n > len) n = len;
+        
+        if (host) {
+            memcpy(buf, host, n);
+        } else if (!slot || addr < ND_NBIC_SPACE) {
+            for (uint32_t i = 0; i < n; i++) buf[i] = nd68k_byteget(addr+i);
+        } else {
+            for (uint32_t i = 0; i < n; i++) buf[i] = nbic.bget(addr+i);
+        }
+        addr += n;
+        buf  += n;
+        len  -= n;
+    }
+}
+
+void NextDimension::copy_out(uint32_t addr, uint32_t len, const uint8_t* buf, bool slot) {
+    while (len) {
+        uint32_t n     = 0x10000 - (addr & 0xFFFF);
+        uint8_t* host  = nd68k_get_mem_bank(addr)->host(addr);
+        if (n > len) n = len;
+        
+        if (host) {
+            memcpy(host, buf, n);
+        } else if (!slot || addr < ND_NBIC_SPACE) {
+            for (uint32_t i = 0; i < n; i++) nd68k_byteput(addr+i, buf[i]);
+        } else {
+            for (uint32_t i = 0; i < n; i++) nbic.bput(addr+i, buf[i]);
         }
-    } while (!host_atomic_cas(&m_port, old_value, new_value));
+        addr += n;
+        buf  += n;
+        len  -= n;
+    }
+}
+
+void NextDimension::board_copy_in(uint32_t addr, uint32_t len, uint8_t* buf) {
+    copy_in(addr | ND_BOARD_BITS, len, buf, false);
+}
+
+void NextDimension::board_copy_out(uint32_t addr, uint32_t len, const uint8_t* buf) {
+    copy_out(addr | ND_BOARD_BITS, len, buf, false);
+}
+
+void NextDimension::slot_copy_in(uint32_t addr, uint32_t len, uint8_t* buf) {
+    copy_in(addr | ND_SLOT_BITS, len, buf, true);
+}
+
+void NextDimension::slot_copy_out(uint32_t addr, uint32_t len, const uint8_t* buf) {
+    copy_out(addr | ND_SLOT_BITS, len, buf, true);
+}
+
+void NextDimension::send_msg(int msg) {
+    switch (msg) {
+        case MSG_LOWER_INTR: CoProc_Send(&i860.coproc, msg, MSG_RAISE_INTR); break;
+        case MSG_RAISE_INTR: CoProc_Send(&i860.coproc, msg, MSG_LOWER_INTR); break;
+        default:             CoProc_Send(&i860.coproc, msg, 0); break;
+    }
 }
 
 /* NeXTdimension board memory access (i860) */
@@ -197,6 +251,11 @@ uint8_t  NextDimension::i860_cs8get(const NextDimension* nd, uint32_t addr) {
     return nd_cs8get(addr);
 }
 
+/* Host address of plain memory (ND RAM) or NULL */
+uint8_t* NextDimension::i860_host(const NextDimension* nd, uint32_t addr) {
+    return nd_get_mem_bank(addr)->host(addr);
+}
+
 void   NextDimension::i860_rd8_be(const NextDimension* nd, uint32_t addr, uint32_t* val) {
     *((uint8_t*)val) = nd_byteget(addr);
 }
@@ -303,7 +362,7 @@ void   NextDimension::i860_wr128_le(const NextDimension* nd, uint32_t addr, cons
 
 /* Message disaptcher - executed on i860 thread, safe to call i860 methods */
 bool NextDimension::handle_msgs(void) {
-    int msg = host_atomic_set(&m_port, 0);
+    int msg = CoProc_Receive(&i860.coproc);
     
     if(msg & MSG_DISPLAY_BLANK)
         set_blank_state(ND_DISPLAY, display_vbl);
@@ -344,7 +403,6 @@ extern "C" {
             IF_NEXT_DIMENSION(slot, nd) {
                 nd->display_vbl = bBlankToggle;
                 nd->send_msg(MSG_DISPLAY_BLANK);
-                host_atomic_set(&nd->i860.i860cycles, (1000*1000*33)/136);
             }
         }
         bBlankToggle = !bBlankToggle;
@@ -370,6 +428,9 @@ extern "C" {
             IF_NEXT_DIMENSION(slot, nd) {
                 nd->video_vbl = bBlankToggle;
                 nd->send_msg(MSG_VIDEO_BLANK);
+                if (bBlankToggle) {
+                    nd->vio.vbl();
+                }
             }
         }
         bBlankToggle = !bBlankToggle;
@@ -386,6 +447,12 @@ extern "C" {
         }
     }
 
+    void nd_video_set_sink(int slot, nd_video_sink sink, void* arg) {
+        IF_NEXT_DIMENSION(slot, nd) {
+            nd->vio.set_sink(sink, arg);
+        }
+    }
+
     uint32_t* nd_vram_for_slot(int slot) {
         IF_NEXT_DIMENSION(slot, nd) {
             return (uint32_t*)nd->vram;
@@ -394,6 +461,22 @@ extern "C" {
         }
     }
 
+    uint8_t* nd_vram_dirty_for_slot(int slot) {
+        IF_NEXT_DIMENSION(slot, nd) {
+            return nd->vram_dirty[ND_VRAM_MAIN];
+        } else {
+            return NULL;
+        }
+    }
+
+    const bt463* nd_ramdac_for_slot(int slot) {
+        IF_NEXT_DIMENSION(slot, nd) {
+            return &nd->ramdac;
+        } else {
+            return NULL;
+        }
+    }
+
     void nd_start_debugger(void) {
         FOR_EACH_SLOT(slot) {
             IF_NEXT_DIMENSION(slot, nd) {
@@ -410,4 +493,47 @@ extern "C" {
         }
         return "";
     }
+
+    bool nd_stats(int slot, ND_STATS* stats) {
+        IF_NEXT_DIMENSION(slot, nd) {
+            nd->i860.stats(stats);
+            return ENABLE_PERF_COUNTERS;
+        }
+        return false;
+    }
+
+    /* Append one CSV line per board to the statistics file, if configured */
+    void nd_stats_dump(uint64_t hostTime) {
+        static FILE* file;
+        static char  name[FILENAME_MAX];
+        ND_STATS     s;
+
+        if (strcmp(name, ConfigureParams.Dimension.szStatsFileName)) {
+            if (file) {
+                fclose(file);
+                file = NULL;
+            }
+            strcpy(name, ConfigureParams.Dimension.szStatsFileName);
+            if (name[0]) {
+                file = fopen(name, "a");
+                if (!file) {
+                    Log_Printf(LOG_WARN, "[ND] Cannot open statistics file %s", name);
+                } else if (ftell(file) == 0) {
+                    fprintf(file, "time_us,slot,insns,insns_dim,icache_hit,icache_miss,icache_inval,"
+                            "tlb_hit,tlb_search,tlb_miss,tlb_inval,intrs,waits,stalls,halted\n");
+                }
+            }
+        }
+        if (!file) return;
+
+        FOR_EACH_SLOT(slot) {
+            if (nd_stats(slot, &s)) {
+                fprintf(file, "%" PRIu64 ",%d,%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64
+                        ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%d\n",
+                        hostTime, slot, s.insns, s.insns_dim, s.icache_hit, s.icache_miss, s.icache_inval,
+                        s.tlb_hit, s.tlb_search, s.tlb_miss, s.tlb_inval, s.intrs, s.waits, s.stalls, s.halted);
+            }
+        }
+        fflush(file);
+    }
 }
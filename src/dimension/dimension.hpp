@@ -19,9 +19,28 @@
 #define ND_LOG_IO_RD LOG_NONE
 #define ND_LOG_IO_WR LOG_NONE
 
+#include "ramdac.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif /* __cplusplus */
+    /* i860 counters, running totals since the board was initialised */
+    typedef struct nd_stats {
+        uint64_t insns;         /* instructions executed */
+        uint64_t insns_dim;     /* of these, in dual instruction mode */
+        uint64_t icache_hit;
+        uint64_t icache_miss;
+        uint64_t icache_inval;
+        uint64_t tlb_hit;
+        uint64_t tlb_search;
+        uint64_t tlb_miss;
+        uint64_t tlb_inval;
+        uint64_t intrs;         /* external interrupts */
+        uint64_t waits;         /* i860 thread ran out of cycles */
+        uint64_t stalls;        /* m68k thread waited for the i860 */
+        bool     halted;
+    } ND_STATS;
+
     typedef void (*i860_run_func)(int);
     extern i860_run_func i860_Run;
 
@@ -30,9 +49,19 @@ extern "C" {
     extern void        nd_display_repaint(void);
     extern void        nd_video_vbl_handler(void);
     extern bool        nd_video_enabled(int slot);
+
+    /* Receives video output frames on the video output thread. The frame
+     * stays valid until the next call returns. */
+    typedef void (*nd_video_sink)(int slot, const uint32_t* frame, int width, int height, void* arg);
+    extern void        nd_video_set_sink(int slot, nd_video_sink sink, void* arg);
     extern uint32_t*   nd_vram_for_slot(int slot);
+    extern uint8_t*    nd_vram_dirty_for_slot(int slot);
+    extern const bt463* nd_ramdac_for_slot(int slot);
     extern void        nd_start_debugger(void);
     extern const char* nd_reports(uint64_t realTime, uint64_t hostTime);
+    extern bool        nd_stats(int slot, ND_STATS* stats);
+    extern void        nd_stats_dump(uint64_t hostTime);
+    extern void        nd_nbic_interrupt(void);
 #ifdef __cplusplus
 }
 
@@ -40,7 +69,6 @@ extern "C" {
 #include "i860.hpp"
 #include "nd_nbic.hpp"
 #include "nd_mem.hpp"
-#include "ramdac.h"
 
 class NextDimension;
 
@@ -127,13 +155,42 @@ public:
     void write(uint32_t step, uint8_t data);
 };
 
+/* Video output, double buffered frames for a host capture or encoder sink */
+#define ND_VIO_WIDTH    640
+#define ND_VIO_HEIGHT   480
+class VIO {
+    NextDimension* nd;
+    uint32_t*      frame[2];
+    uint8_t        stale[2][ND_VIO_HEIGHT]; /* lines that lag behind VRAM */
+    int            back;                    /* frame being filled */
+    thread_t*      thread;
+    SDL_sem*       wake;
+    atomic_int     pending;                 /* frames counted since the worker last woke up */
+    volatile bool  running;
+    nd_video_sink  sink;
+    void*          sink_arg;
+
+    static int     worker(void* _this);
+    int            worker(void);
+    void           scanout(void);
+public:
+    uint64_t       frames;
+    uint64_t       dropped;
+
+    VIO(NextDimension* nd);
+    ~VIO();
+    void set_sink(nd_video_sink sink, void* arg);
+    void vbl(void);
+};
+
 class NextDimension : public NextBusBoard {
-    /* Message port for host->dimension communication */
-    atomic_int      m_port;
+    void copy_in(uint32_t addr, uint32_t len, uint8_t* buf, bool slot);
+    void copy_out(uint32_t addr, uint32_t len, const uint8_t* buf, bool slot);
 public:
     ND_Addrbank**   mem_banks;
     uint8_t*        ram;
     uint8_t*        vram;
+    uint8_t         vram_dirty[ND_VRAM_USERS][ND_VRAM_LINES];
     uint8_t*        rom;
     uint8_t*        dmem;
     
@@ -152,6 +209,7 @@ public:
     DMCD            dmcd;
     DCSC            dcsc0;
     DCSC            dcsc1;
+    VIO             vio;
     bt463           ramdac;
     
     NextDimension(int slot);
@@ -173,10 +231,16 @@ public:
     virtual void     slot_wput(uint32_t addr, uint16_t val);
     virtual void     slot_bput(uint32_t addr, uint8_t val);
 
+    virtual void     board_copy_in(uint32_t addr, uint32_t len, uint8_t* buf);
+    virtual void     board_copy_out(uint32_t addr, uint32_t len, const uint8_t* buf);
+    virtual void     slot_copy_in(uint32_t addr, uint32_t len, uint8_t* buf);
+    virtual void     slot_copy_out(uint32_t addr, uint32_t len, const uint8_t* buf);
+
     virtual void     reset(void);
     virtual void     pause(bool pause);
 
     static uint8_t   i860_cs8get  (const NextDimension* nd, uint32_t addr);
+    static uint8_t*  i860_host    (const NextDimension* nd, uint32_t addr);
     static void      i860_rd8_be  (const NextDimension* nd, uint32_t addr, uint32_t* val);
     static void      i860_rd16_be (const NextDimension* nd, uint32_t addr, uint32_t* val);
     static void      i860_rd32_be (const NextDimension* nd, uint32_t addr, uint32_t* val);
@@ -48,7 +48,7 @@
 #define TRACE_EXT_INT          LOG_NONE
 #define TRACE_ADDR_TRANSLATION LOG_NONE
 #define ENABLE_I860_DB_BREAK   0
-#define ENABLE_PERF_COUNTERS   0
+#define ENABLE_PERF_COUNTERS   1
 #define ENABLE_DEBUGGER        0
 
 
@@ -168,6 +168,30 @@ void i860_cpu_device::debugger(char cmd, const char* format, ...) {
                 }
                 fprintf (stderr, "Bad format for memory address (expected hex with leading zero, got '%s').\n", buf + 1);
                 break;
+            case 'i': {
+                ND_STATS s;
+                stats(&s);
+                fprintf (stderr, "insns=%llu (dim=%llu) icache hit=%llu miss=%llu inval=%llu\n"
+                         "tlb hit=%llu search=%llu miss=%llu inval=%llu intrs=%llu waits=%llu stalls=%llu\n",
+                         (unsigned long long)s.insns, (unsigned long long)s.insns_dim,
+                         (unsigned long long)s.icache_hit, (unsigned long long)s.icache_miss,
+                         (unsigned long long)s.icache_inval, (unsigned long long)s.tlb_hit,
+                         (unsigned long long)s.tlb_search, (unsigned long long)s.tlb_miss,
+                         (unsigned long long)s.tlb_inval, (unsigned long long)s.intrs,
+                         (unsigned long long)s.waits, (unsigned long long)s.stalls);
+                break;
+            }
+            case 'f': {
+                int count = 20;
+                if(buf[1])
+                    sscanf(buf + 1, "%d", &count);
+                if(m_prof)
+                    prof_stop(count);
+                else
+                    prof_start();
+                buf[1] = 0;
+                break;
+            }
             case '?':
                 fprintf (stderr,
                          "   m: dump bytes (m[0xaddress])\n"
@@ -181,7 +205,9 @@ void i860_cpu_device::debugger(char cmd, const char* format, ...) {
                          "   p: dump pipelines (p{0-4} for all, add, mul, load, graphics)\n"
                          "   b: break - set trap on next instruction\n"
                          "   t: dump traceback buffer (t[count])\n"
-                         "   x: give virt->phys translation (x{0xaddress})\n");
+                         "   x: give virt->phys translation (x{0xaddress})\n"
+                         "   i: print performance counters\n"
+                         "   f: start profiling, stop and show hottest instructions (f[count])\n");
                 nd->dbg_cmd(0);
                 break;
             default:
@@ -201,6 +227,91 @@ void i860_cpu_device::debugger(char cmd, const char* format, ...) {
 }
 
 /* Disassemble `len' instructions starting at `addr'.  */
+/* PC profiler. Each executed instruction is counted in a table hashed by
+   its address, together with the icache misses of its fetch and the TLB
+   misses caused while it executed. The table is never resized, once it is
+   3/4 full new addresses are only counted as a total. */
+#define I860_PROF_SZ    16
+#define I860_PROF_MASK  ((1 << I860_PROF_SZ) - 1)
+
+void i860_cpu_device::prof_start() {
+    m_prof = (prof_entry*)calloc(1 << I860_PROF_SZ, sizeof(prof_entry));
+    if(!m_prof) {
+        fprintf(stderr, "Cannot allocate profiler memory.\n");
+        return;
+    }
+    for(int i = 0; i <= I860_PROF_MASK; i++)
+        m_prof[i].pc = 1; // never a valid instruction address
+    m_prof_prev        = NULL;
+    m_prof_used        = 0;
+    m_prof_other       = 0;
+    m_prof_icache_miss = m_perf.icache_miss;
+    m_prof_tlb_miss    = m_perf.tlb_miss;
+    fprintf(stderr, "Profiling started.\n");
+}
+
+void i860_cpu_device::prof_update() {
+    UINT32 idx = ((m_pc >> 2) * 2654435761U) >> (32 - I860_PROF_SZ);
+    
+    /* TLB misses since the last call belong to the previous instruction */
+    if(m_prof_prev)
+        m_prof_prev->tlb_miss += m_perf.tlb_miss - m_prof_tlb_miss;
+    m_prof_tlb_miss = m_perf.tlb_miss;
+    
+    while(m_prof[idx].pc != m_pc) {
+        if(m_prof[idx].pc == 1) {
+            if(m_prof_used >= (3 << I860_PROF_SZ) / 4) {
+                m_prof_other++;
+                m_prof_prev = NULL;
+                return;
+            }
+            m_prof[idx].pc = m_pc;
+            m_prof_used++;
+            break;
+        }
+        idx = (idx + 1) & I860_PROF_MASK;
+    }
+    m_prof[idx].count++;
+    m_prof[idx].icache_miss += m_perf.icache_miss - m_prof_icache_miss;
+    m_prof_icache_miss       = m_perf.icache_miss;
+    m_prof_prev              = &m_prof[idx];
+}
+
+void i860_cpu_device::prof_stop(int count) {
+    prof_entry** sorted = (prof_entry**)malloc(m_prof_used * sizeof(prof_entry*));
+    UINT64       total  = m_prof_other;
+    UINT32       n      = 0;
+    
+    for(int i = 0; i <= I860_PROF_MASK; i++) {
+        if(m_prof[i].pc != 1) {
+            total += m_prof[i].count;
+            if(sorted) sorted[n++] = &m_prof[i];
+        }
+    }
+    fprintf(stderr, "Profiling stopped, %llu instructions at %u addresses (%llu not recorded).\n",
+            (unsigned long long)total, m_prof_used, (unsigned long long)m_prof_other);
+    
+    if(sorted && total) {
+        qsort(sorted, n, sizeof(prof_entry*), [](const void* a, const void* b) {
+            UINT64 ca = (*(prof_entry* const*)a)->count;
+            UINT64 cb = (*(prof_entry* const*)b)->count;
+            return ca < cb ? 1 : ca > cb ? -1 : 0;
+        });
+        if((UINT32)count > n) count = n;
+        fprintf(stderr, "addr      percent      count  icache_miss   tlb_miss  instruction\n");
+        for(int i = 0; i < count; i++) {
+            char buf[DISASM_BUF_SIZE];
+            i860_disassembler(sorted[i]->pc, ifetch_notrap(sorted[i]->pc), buf);
+            fprintf(stderr, "%08X %6.2f%% %10llu %12llu %10llu  %s\n", sorted[i]->pc,
+                    100.0 * sorted[i]->count / total, (unsigned long long)sorted[i]->count,
+                    (unsigned long long)sorted[i]->icache_miss, (unsigned long long)sorted[i]->tlb_miss, buf);
+        }
+    }
+    free(sorted);
+    free(m_prof);
+    m_prof = NULL;
+}
+
 UINT32 i860_cpu_device::disasm (UINT32 addr, int len)
 {
 	UINT32 insn;
@@ -99,7 +99,7 @@ void i860_cpu_device::gen_interrupt()
 
     Log_Printf(TRACE_EXT_INT, "[i860] i860_gen_interrupt: External interrupt received %s", GET_PSR_IM() ? "[PSR.IN set, preparing to trap]" : "[ignored (interrupts disabled)]");
 #if ENABLE_PERF_COUNTERS
-    m_intrs++;
+    m_perf.intrs++;
 #endif
 }
 
@@ -107,18 +107,46 @@ void i860_cpu_device::gen_interrupt()
 void i860_cpu_device::invalidate_icache() {
     memset(m_icache_vaddr, 0xff, sizeof(UINT32) * (1<<I860_ICACHE_SZ));
 #if ENABLE_PERF_COUNTERS
-    m_icache_inval++;
+    m_perf.icache_inval++;
 #endif
 }
 
 void i860_cpu_device::invalidate_tlb() {
     m_way = 0;
     memset(m_tlb_vaddr, 0, sizeof(UINT32) * (1<<I860_TLB_WAYS) * (1<<I860_TLB_SETS));
+    invalidate_htlb();
 #if ENABLE_PERF_COUNTERS
-    m_tlb_inval++;
+    m_perf.tlb_inval++;
 #endif
 }
 
+/* Host TLB. After an access to ND RAM went through address translation
+   without a trap, the host address of its page is cached here. Entries
+   are kept apart for reads and writes and tagged with PSR.U, so a hit has
+   the same outcome as the architectural checks. The host TLB is flushed
+   together with the TLB and whenever DIRBASE or EPSR (WP bit) change. */
+#define HTLB_TAG(vaddr) (((vaddr) & I860_PAGE_FRAME_MASK) | (GET_PSR_U() << 1) | 1)
+
+void i860_cpu_device::invalidate_htlb() {
+    memset(m_htlb_vaddr, 0, sizeof(m_htlb_vaddr));
+}
+
+inline UINT8* i860_cpu_device::htlb_lookup(UINT32 vaddr, int size, int is_write) {
+    const int idx = (vaddr >> I860_PAGE_SZ) & I860_HTLB_MASK;
+    if (m_htlb_vaddr[is_write][idx] == HTLB_TAG(vaddr) && (vaddr & I860_PAGE_OFF_MASK) <= (1<<I860_PAGE_SZ) - size)
+        return m_htlb_host[is_write][idx];
+    return NULL;
+}
+
+void i860_cpu_device::htlb_fill(UINT32 vaddr, UINT32 paddr, int is_write) {
+    UINT8* host = NextDimension::i860_host(nd, paddr & I860_PAGE_FRAME_MASK);
+    if (host) {
+        const int idx = (vaddr >> I860_PAGE_SZ) & I860_HTLB_MASK;
+        m_htlb_vaddr[is_write][idx] = HTLB_TAG(vaddr);
+        m_htlb_host[is_write][idx]  = host;
+    }
+}
+
 UINT32 i860_cpu_device::ifetch_notrap(const UINT32 pc) {
     UINT32 before     = m_flow;
     m_flow &= ~TRAP_MASK;
@@ -133,7 +161,7 @@ UINT32 i860_cpu_device::ifetch(const UINT32 pc) {
 
 UINT64 i860_cpu_device::ifetch64(const UINT32 pc, const UINT32 vaddr, int const cidx) {
 #if ENABLE_PERF_COUNTERS
-    m_icache_miss++;
+    m_perf.icache_miss++;
 #endif
     UINT32 paddr;
     
@@ -162,6 +190,8 @@ UINT64 i860_cpu_device::ifetch64(const UINT32 pc, const UINT32 vaddr, int const
         NextDimension::i860_rd64_be(nd, paddr, (UINT32*)&insn64);
     }
     m_icache[cidx] = insn64;
+    m_icache_func[cidx][0] = decoder_tbl[I860_DECODER_IDX((UINT32)insn64)];
+    m_icache_func[cidx][1] = decoder_tbl[I860_DECODER_IDX((UINT32)(insn64 >> 32))];
     
     return insn64;
 }
@@ -173,7 +203,7 @@ inline UINT64 i860_cpu_device::ifetch64(const UINT32 pc) {
         return ifetch64(pc, vaddr, cidx);
     } else {
 #if ENABLE_PERF_COUNTERS
-        m_icache_hit++;
+        m_perf.icache_hit++;
 #endif
         return m_icache[cidx];
     }
@@ -250,21 +280,21 @@ inline UINT32 i860_cpu_device::get_address_translation (UINT32 vaddr, int is_dat
             }
             
 #if ENABLE_PERF_COUNTERS
-            m_tlb_hit++;
+            m_perf.tlb_hit++;
 #endif
             
             return (m_tlb_paddr[m_way][vset] & TLB_PAGE_MASK) | voffset;
         }
         
 #if ENABLE_PERF_COUNTERS
-        m_tlb_search++;
+        m_perf.tlb_search++;
 #endif
 
         m_way = (m_way + 1) & TLB_WAY_MASK;
     }
     
 #if ENABLE_PERF_COUNTERS
-    m_tlb_miss++;
+    m_perf.tlb_miss++;
 #endif
     
     return get_address_translation(vaddr, voffset, vset, is_dataref, is_write);
@@ -403,6 +433,43 @@ UINT32 i860_cpu_device::get_address_translation(UINT32 vaddr, UINT32 voffset, UI
 	return ret;
 }
 
+/* Access a host TLB page with the byte order of the NextDimension::i860_rd/wr
+   functions. ND RAM holds big endian longs. The byte order is a template
+   parameter, so each instantiation has no byte order checks left.  */
+template <bool BE> inline void i860_cpu_device::rdhost(UINT8* page, UINT32 off, int size, UINT8* dest) {
+    UINT32* val = (UINT32*)dest;
+    const UINT32 x8 = BE ? 0 : 7, x16 = BE ? 0 : 6, x32 = BE ? 0 : 4;
+    const UINT32 lo = BE ? 4 : 0, hi = BE ? 0 : 4;
+    switch (size) {
+        case 1:  *dest = page[off^x8]; break;
+        case 2:  *((UINT16*)dest) = do_get_mem_word(page+(off^x16)); break;
+        case 4:  val[0] = do_get_mem_long(page+(off^x32)); break;
+        case 8:  val[0] = do_get_mem_long(page+off+lo);
+                 val[1] = do_get_mem_long(page+off+hi); break;
+        case 16: val[0] = do_get_mem_long(page+off+lo);
+                 val[1] = do_get_mem_long(page+off+hi);
+                 val[2] = do_get_mem_long(page+off+8+lo);
+                 val[3] = do_get_mem_long(page+off+8+hi); break;
+    }
+}
+
+template <bool BE> inline void i860_cpu_device::wrhost(UINT8* page, UINT32 off, int size, const UINT8* data) {
+    const UINT32* val = (const UINT32*)data;
+    const UINT32 x8 = BE ? 0 : 7, x16 = BE ? 0 : 6, x32 = BE ? 0 : 4;
+    const UINT32 lo = BE ? 4 : 0, hi = BE ? 0 : 4;
+    switch (size) {
+        case 1:  page[off^x8] = *data; break;
+        case 2:  do_put_mem_word(page+(off^x16), *((const UINT16*)data)); break;
+        case 4:  do_put_mem_long(page+(off^x32), val[0]); break;
+        case 8:  do_put_mem_long(page+off+lo, val[0]);
+                 do_put_mem_long(page+off+hi, val[1]); break;
+        case 16: do_put_mem_long(page+off+lo,   val[0]);
+                 do_put_mem_long(page+off+hi,   val[1]);
+                 do_put_mem_long(page+off+8+lo, val[2]);
+                 do_put_mem_long(page+off+8+hi, val[3]); break;
+    }
+}
+
 /* Write memory emulation.
      addr = address to write.
      size = size of write in bytes.
@@ -414,6 +481,17 @@ inline void i860_cpu_device::writemem_emu (UINT32 addr, int size, UINT8 *data) {
     dbg_check_wr(addr, size, data);
 #endif
 
+#if !ENABLE_I860_DB_BREAK
+    /* Integer stores, size is at most 4 */
+    UINT8* page = htlb_lookup(addr, size, 1);
+    if (page && size <= 4) {
+        if (m_mem_be) wrhost<true> (page, addr & I860_PAGE_OFF_MASK, size, data);
+        else          wrhost<false>(page, addr & I860_PAGE_OFF_MASK, size, data);
+        return;
+    }
+#endif
+    UINT32 vaddr = addr;
+
 	/* If virtual mode, do translation.  */
 	if (GET_DIRBASE_ATE ())
 	{
@@ -439,6 +517,7 @@ inline void i860_cpu_device::writemem_emu (UINT32 addr, int size, UINT8 *data) {
     
 	/* Now do the actual write.  */
     wrmem[size](nd, addr, (UINT32*)data);
+    htlb_fill(vaddr, addr, 1);
 }
 
 
@@ -450,6 +529,16 @@ inline void i860_cpu_device::readmem_emu (UINT32 addr, int size, UINT8 *dest)
 {
 	Log_Printf(TRACE_RDWR_MEM, "[i860] fp_rdmem (ATE=%d) addr = %08X, size = %d\n", GET_DIRBASE_ATE (), addr, size);
     
+#if !ENABLE_I860_DB_BREAK
+    UINT8* page = htlb_lookup(addr, size, 0);
+    if (page) {
+        if (m_mem_be) rdhost<true> (page, addr & I860_PAGE_OFF_MASK, size, dest);
+        else          rdhost<false>(page, addr & I860_PAGE_OFF_MASK, size, dest);
+        return;
+    }
+#endif
+    UINT32 vaddr = addr;
+
 	/* If virtual mode, do translation.  */
 	if (GET_DIRBASE_ATE ())
 	{
@@ -474,6 +563,7 @@ inline void i860_cpu_device::readmem_emu (UINT32 addr, int size, UINT8 *dest)
 	}
 #endif
     rdmem[size](nd, addr, (UINT32*)dest);
+    htlb_fill(vaddr, addr, 0);
 }
 
 
@@ -486,6 +576,25 @@ inline void i860_cpu_device::writemem_emu (UINT32 addr, int size, UINT8 *data, U
 {
 	Log_Printf(TRACE_RDWR_MEM, "[i860] fp_wrmem (ATE=%d) addr = %08X, size = %d", GET_DIRBASE_ATE (), addr, size);
 
+#if !ENABLE_I860_DB_BREAK
+    UINT8* page = htlb_lookup(addr, size, 1);
+    if (page) {
+        UINT32 off = addr & I860_PAGE_OFF_MASK;
+        if(size == 8 && wmask != 0xff) {
+            for (int i = 0; i < 8; i++)
+                if (wmask & (0x80 >> i)) {
+                    if (m_mem_be) wrhost<true> (page, off+i, 1, &data[i]);
+                    else          wrhost<false>(page, off+i, 1, &data[i]);
+                }
+        } else {
+            if (m_mem_be) wrhost<true> (page, off, size, data);
+            else          wrhost<false>(page, off, size, data);
+        }
+        return;
+    }
+#endif
+    UINT32 vaddr = addr;
+
 	/* If virtual mode, do translation.  */
 	if (GET_DIRBASE_ATE ())
 	{
@@ -522,6 +631,7 @@ inline void i860_cpu_device::writemem_emu (UINT32 addr, int size, UINT8 *data, U
     } else {
         wrmem[size](nd, addr, (UINT32*)data);
     }
+    htlb_fill(vaddr, addr, 1);
 }
 
 /* Sign extend N-bit number.  */
@@ -611,6 +721,10 @@ void i860_cpu_device::insn_st_ctrl (UINT32 insn)
 		Log_Printf(LOG_WARN, "[i860:%08X]** Switching to virtual addressing (ATE=1)", m_pc);
 	}
 
+	/* Address space, user access or write protection may change */
+	if (csrc2 == CR_DIRBASE || csrc2 == CR_EPSR)
+		invalidate_htlb();
+
 	/* Update the register -- unless it is fir which cannot be updated.  */
 	if (csrc2 == CR_EPSR)
 	{
@@ -652,7 +766,7 @@ void i860_cpu_device::insn_st_ctrl (UINT32 insn)
 		UINT32 tmp = m_cregs[CR_FSR] & ~0x003e01ef;
 		m_cregs[CR_FSR] = enew | tmp;
 
-		float_set_rounding_mode (GET_FSR_RM(), &m_fpcs);
+		update_fp_mode();
 	}
 	else if (csrc2 != CR_FIR)
 		m_cregs[csrc2] = get_iregval (isrc1);
@@ -943,6 +1057,46 @@ void i860_cpu_device::insn_fldy (UINT32 insn)
 }
 
 
+/* Packed pixel helpers. The 64-bit operands are handled as four 16-bit or
+   two 32-bit lanes inside one host register, without a loop over pixels.  */
+
+/* fzchks: per 16-bit lane minimum, PM gets a bit for each lane where
+   fsrc2 <= fsrc1. The lanes are split into two groups with 16 spare bits
+   each, so one subtraction compares two lanes without a borrow crossing.  */
+static inline UINT64 i860_fzchks(UINT64 iv1, UINT64 iv2, int *pm)
+{
+	const UINT64 lanes = 0x0000ffff0000ffffULL;
+	const UINT64 carry = 0x0001000000010000ULL;
+	UINT64 ge_e = ((((iv1 & lanes) | carry) - (iv2 & lanes)) >> 16) & 0x0000000100000001ULL;
+	UINT64 ge_o = (((((iv1 >> 16) & lanes) | carry) - ((iv2 >> 16) & lanes)) >> 16) & 0x0000000100000001ULL;
+	UINT64 m = (ge_e * 0xffff) | ((ge_o * 0xffff) << 16);
+	*pm = ((*pm >> 4) & 0x0f) | (int)(((ge_e & 1) | ((ge_o & 1) << 1) | ((ge_e >> 32) << 2) | ((ge_o >> 32) << 3)) << 4);
+	return (iv2 & m) | (iv1 & ~m);
+}
+
+/* fzchkl: same for two 32-bit lanes.  */
+static inline UINT64 i860_fzchkl(UINT64 iv1, UINT64 iv2, int *pm)
+{
+	UINT32 a0 = iv1, a1 = iv1 >> 32;
+	UINT32 b0 = iv2, b1 = iv2 >> 32;
+	int ge0 = b0 <= a0, ge1 = b1 <= a1;
+	*pm = ((*pm >> 2) & 0x3f) | (ge0 << 6) | (ge1 << 7);
+	return ((UINT64)(ge1 ? b1 : a1) << 32) | (ge0 ? b0 : a0);
+}
+
+/* Byte write mask for pst.d: spread each PM bit over the bytes of its pixel.  */
+static inline UINT32 i860_pixel_wmask(int ps, int pm)
+{
+	UINT32 x;
+	switch (ps) {
+		case 0: return pm & 0xff;
+		case 1: x = pm & 0x0f; x = (x | (x << 2)) & 0x33; x = (x | (x << 1)) & 0x55; return x * 0x3;
+		case 2: x = pm & 0x03; x = (x | (x << 3)) & 0x11; return x * 0xf;
+		default: return 0xff;
+	}
+}
+
+
 /* Execute "pst.d fdest,#const(isrc2)" or "fst.d fdest,#const(isrc2)++"
    instruction.  */
 void i860_cpu_device::insn_pstd (UINT32 insn)
@@ -953,7 +1107,6 @@ void i860_cpu_device::insn_pstd (UINT32 insn)
 	UINT32 eff = 0;
 	int auto_inc = (insn & 1);
 	int pm = GET_PSR_PM ();
-	int i;
 	UINT32 wmask;
 	int orig_pm = pm;
 
@@ -1009,34 +1162,7 @@ void i860_cpu_device::insn_pstd (UINT32 insn)
 	/* Write data (value of freg fdest) to memory at eff-- but only those
 	   bytes that are enabled by the bits in PSR.PM.  Bit 0 of PM selects
 	   the pixel at the lowest address.  */
-	wmask = 0;
-	for (i = 0; i < 8; )
-	{
-		if (ps == 0)
-		{
-			if (orig_pm & 0x80)
-				wmask |= 1 << (7-i);
-			i += 1;
-		}
-		else if (ps == 1)
-		{
-			if (orig_pm & 0x08)
-				wmask |= 0x3 << (6-i);
-			i += 2;
-		}
-		else if (ps == 2)
-		{
-			if (orig_pm & 0x02)
-				wmask |= 0xf << (4-i);
-			i += 4;
-		}
-		else
-		{
-			wmask = 0xff;
-			break;
-		}
-		orig_pm <<= 1;
-	}
+	wmask = i860_pixel_wmask (ps, orig_pm);
 	writemem_emu (eff, 8, (UINT8 *)(&m_fregs[4 * fdest]), wmask);
 }
 
@@ -3453,13 +3579,12 @@ void i860_cpu_device::insn_fzchk (UINT32 insn)
 	int piped = insn & 0x400;        /* 1 = pipelined, 0 = scalar.  */
 	int is_fzchks = insn & 8;        /* 1 = fzchks, 0 = fzchkl.  */
 	FLOAT64 dbl_tmp_dest = FLOAT64_ZERO;
-	int i;
 	FLOAT64 v1 = get_fregval_d (fsrc1);
 	FLOAT64 v2 = get_fregval_d (fsrc2);
 	UINT64 iv1 = *(UINT64 *)&v1;
 	UINT64 iv2 = *(UINT64 *)&v2;
 	UINT64 r = 0;
-	char pm = GET_PSR_PM ();
+	int pm = GET_PSR_PM ();
 
 #if TRACE_UNDEFINED_I860
 	/* Check for S and R bits set.  */
@@ -3474,43 +3599,9 @@ void i860_cpu_device::insn_fzchk (UINT32 insn)
 	   four 16-bit pixels, while the fzchkl operates on two 32-bit
 	   pixels (pixels are unsigned ordinals in this context).  */
 	if (is_fzchks)
-	{
-		pm = (pm >> 4) & 0x0f;
-		for (i = 3; i >= 0; i--)
-		{
-			UINT16 ps1 = (iv1 >> (i * 16)) & 0xffff;
-			UINT16 ps2 = (iv2 >> (i * 16)) & 0xffff;
-			if (ps2 <= ps1)
-			{
-				r |= ((UINT64)ps2 << (i * 16));
-				pm |= (1 << (7 - (3 - i)));
-			}
-			else
-			{
-				r |= ((UINT64)ps1 << (i * 16));
-				pm &= ~(1 << (7 - (3 - i)));
-			}
-		}
-	}
+		r = i860_fzchks (iv1, iv2, &pm);
 	else
-	{
-		pm = (pm >> 2) & 0x3f;
-		for (i = 1; i >= 0; i--)
-		{
-			UINT32 ps1 = (iv1 >> (i * 32)) & 0xffffffff;
-			UINT32 ps2 = (iv2 >> (i * 32)) & 0xffffffff;
-			if (ps2 <= ps1)
-			{
-				r |= ((UINT64)ps2 << (i * 32));
-				pm |= (1 << (7 - (1 - i)));
-			}
-			else
-			{
-				r |= ((UINT64)ps1 << (i * 32));
-				pm &= ~(1 << (7 - (1 - i)));
-			}
-		}
-	}
+		r = i860_fzchkl (iv1, iv2, &pm);
 
 	dbl_tmp_dest = *(FLOAT64 *)&r;
 	SET_PSR_PM (pm);
@@ -3699,8 +3790,12 @@ void i860_cpu_device::insn_faddz (UINT32 insn)
 	}
 }
 
+/* The decode tables are evaluated at compile time to build decoder_tbl.  */
+struct i860_decoder {
+typedef i860_cpu_device::insn_func insn_func;
+
 /* First-level decode table (i.e., for the 6 primary opcode bits).  */
-const i860_cpu_device::insn_func i860_cpu_device::decode_tbl[64] = {
+static constexpr insn_func decode_tbl[64] = {
 	/* A slight bit of decoding for loads and stores is done in the
 	   execution routines (operand size and addressing mode), which
 	   is why their respective entries are identical.  */
@@ -3772,7 +3867,7 @@ const i860_cpu_device::insn_func i860_cpu_device::decode_tbl[64] = {
 
 
 /* Second-level decode table (i.e., for the 3 core escape opcode bits).  */
-const i860_cpu_device::insn_func i860_cpu_device::core_esc_decode_tbl[8] = {
+static constexpr insn_func core_esc_decode_tbl[8] = {
 	&i860_cpu_device::dec_unrecog,
 	&i860_cpu_device::dec_unrecog, /* lock  (FIXME: unimplemented).  */
 	&i860_cpu_device::insn_calli,        /* calli isrc1ni.                 */
@@ -3785,7 +3880,7 @@ const i860_cpu_device::insn_func i860_cpu_device::core_esc_decode_tbl[8] = {
 
 
 /* Second-level decode table (i.e., for the 7 FP extended opcode bits).  */
-const i860_cpu_device::insn_func i860_cpu_device::fp_decode_tbl[128] = {
+static constexpr insn_func fp_decode_tbl[128] = {
 	/* Floating point instructions.  The least significant 7 bits are
 	   the (extended) opcode and bits 10:7 are P,D,S,R respectively
 	   ([p]ipelined, [d]ual, [s]ource prec., [r]esult prec.).
@@ -3921,27 +4016,62 @@ const i860_cpu_device::insn_func i860_cpu_device::fp_decode_tbl[128] = {
 	&i860_cpu_device::dec_unrecog, /* 0x7F */
 };
 
-i860_cpu_device::insn_func i860_cpu_device::decoder_tbl[8192];
+/* Entry of decoder_tbl, see I860_DECODER_IDX.  */
+static constexpr insn_func entry(int idx) {
+	return (idx >> 7) == 0x12 ? fp_decode_tbl[idx & 0x7f]
+	     : (idx >> 7) == 0x13 ? core_esc_decode_tbl[idx & 3]
+	     : decode_tbl[idx >> 7];
+}
+};
+
+constexpr i860_decoder::insn_func i860_decoder::decode_tbl[64];
+constexpr i860_decoder::insn_func i860_decoder::core_esc_decode_tbl[8];
+constexpr i860_decoder::insn_func i860_decoder::fp_decode_tbl[128];
+
+#define I860_DEC1(i)    i860_decoder::entry(i),
+#define I860_DEC2(i)    I860_DEC1(i)    I860_DEC1((i)+1)
+#define I860_DEC4(i)    I860_DEC2(i)    I860_DEC2((i)+2)
+#define I860_DEC8(i)    I860_DEC4(i)    I860_DEC4((i)+4)
+#define I860_DEC16(i)   I860_DEC8(i)    I860_DEC8((i)+8)
+#define I860_DEC32(i)   I860_DEC16(i)   I860_DEC16((i)+16)
+#define I860_DEC64(i)   I860_DEC32(i)   I860_DEC32((i)+32)
+#define I860_DEC128(i)  I860_DEC64(i)   I860_DEC64((i)+64)
+#define I860_DEC256(i)  I860_DEC128(i)  I860_DEC128((i)+128)
+#define I860_DEC512(i)  I860_DEC256(i)  I860_DEC256((i)+256)
+#define I860_DEC1024(i) I860_DEC512(i)  I860_DEC512((i)+512)
+#define I860_DEC2048(i) I860_DEC1024(i) I860_DEC1024((i)+1024)
+#define I860_DEC4096(i) I860_DEC2048(i) I860_DEC2048((i)+2048)
+
+/* Combined decode table, constant initialized and shared by all boards.  */
+const i860_cpu_device::insn_func i860_cpu_device::decoder_tbl[8192] = {
+	I860_DEC4096(0) I860_DEC4096(4096)
+};
 
 /*
  * Main decoder driver.
  *  insn = instruction at the current PC to execute.
  *  non_shadow = This insn is not in the shadow of a delayed branch - (SC) unused, removed).
  */
-void i860_cpu_device::decode_exec (UINT32 insn) {
+inline void i860_cpu_device::decode_exec (UINT32 insn, insn_func func) {
     if(m_flow & EXITING_IFETCH) return;
     
 #if ENABLE_PERF_COUNTERS
-    m_insn_decoded++;
+    m_perf.insn_decoded++;
+    if(m_dim != DIM_NONE) m_perf.insn_dim++;
 #endif
     
 #if ENABLE_DEBUGGER
     m_traceback[m_traceback_idx++] = m_pc;
     if(m_traceback_idx >= (sizeof(m_traceback) / sizeof(m_traceback[0])))
         m_traceback_idx = 0;
-#endif    
+#endif
+    if(m_prof) prof_update();    
 //    (this->*decode_tbl[(insn >> 26) & 0x3f])(insn);
-    (this->*decoder_tbl[((insn >> 19) & 0x1F80) | (insn & 0x7F)])(insn);
+    (this->*func)(insn);
+}
+
+void i860_cpu_device::decode_exec (UINT32 insn) {
+    decode_exec(insn, decoder_tbl[I860_DECODER_IDX(insn)]);
 }
 
 void i860_cpu_device::dec_unrecog(UINT32 insn) {
@@ -4022,5 +4152,7 @@ void i860_cpu_device::reset() {
     /* memory access is little endian */
     set_mem_access(false);
     
+    update_fp_mode();
+    
     halt(false);
 }
@@ -323,6 +323,10 @@ void MC::write(uint32_t addr, uint32_t val) {
             Log_Printf(ND_LOG_IO_WR, MC_WR_FORMAT,"sid", val,addr);
             sid = val;
             break;
+        /* Video DMA registers. They describe how the MC refreshes the visible
+         * and blanked parts of the frame from VRAM and are only latched here,
+         * VRAM is scanned out by the display code. Host to ND transfers are
+         * done by the NeXTbus master, see NextDimension::copy_in/out. */
         case 0x1000:
             Log_Printf(ND_LOG_IO_WR, MC_WR_FORMAT_S,"dma_csr", decodeBits(ND_DMA_CSR_BITS, val),addr);
             dma_csr = val;
@@ -103,6 +103,10 @@ public:
     void bput(uint32_t addr, uint32_t b) const {
         base[addr & mask] = b;
     }
+
+    uint8_t* host(uint32_t addr) const {
+        return base + (addr & mask);
+    }
 };
 
 class ND_Empty : public ND_Addrbank {
@@ -142,8 +146,19 @@ public:
 
 class ND_VRAM : public ND_Addrbank {
     uint8_t* base;
+    uint8_t (*dirty)[ND_VRAM_LINES];
+
+    /* Unaligned accesses may touch bytes up to addr+5 */
+    void mark(uint32_t addr) const {
+        uint32_t line = addr / ND_VRAM_PITCH;
+        dirty[ND_VRAM_MAIN][line] = dirty[ND_VRAM_WINDOW][line] = dirty[ND_VRAM_VIDEO][line] = 1;
+        if (addr & 3) {
+            line = (addr + 5) / ND_VRAM_PITCH;
+            dirty[ND_VRAM_MAIN][line] = dirty[ND_VRAM_WINDOW][line] = dirty[ND_VRAM_VIDEO][line] = 1;
+        }
+    }
 public:
-    ND_VRAM(NextDimension* nd) : ND_Addrbank(nd), base(nd->vram) {
+    ND_VRAM(NextDimension* nd) : ND_Addrbank(nd), base(nd->vram), dirty(nd->vram_dirty) {
         // sanity checks for ARGB mem access
         lput(0, 0x12345678);
         if(lget(0) != 0x12345678) {fprintf(stderr, "ND_VRAM: 32 bit access check failed\n");  goto error;}
@@ -184,6 +199,7 @@ public:
 
     void lput(uint32_t addr, uint32_t l) const {
         addr &= ND_VRAM_MASK;
+        mark(addr);
         switch (addr&3) {
             case 0: base[addr+2] = l >> 24; base[addr+1] = l >> 16; base[addr+0] = l >> 8; base[addr+3] = l; break;
             case 1: base[addr+0] = l >> 24; base[addr-1] = l >> 16; base[addr+2] = l >> 8; base[addr+5] = l; break;
@@ -205,6 +221,7 @@ public:
 
     void wput(uint32_t addr, uint32_t w) const {
         addr &= ND_VRAM_MASK;
+        mark(addr);
         switch (addr&3) {
             case 0: base[addr+2] = w >> 8; base[addr+1] = w; break;
             case 1: base[addr+0] = w >> 8; base[addr-1] = w; break;
@@ -226,6 +243,7 @@ public:
 
     void bput(uint32_t addr, uint32_t b) const {
         addr &= ND_VRAM_MASK;
+        mark(addr);
         switch(addr&3) {
             case 0: base[addr+2] = b; break;
             case 1: base[addr+0] = b; break;
@@ -383,6 +401,10 @@ uint32_t ND_Addrbank::cs8get(uint32_t addr) const {
     return 0;
 }
 
+uint8_t* ND_Addrbank::host(uint32_t addr) const {
+    return NULL;
+}
+
 void ND_Addrbank::lput(uint32_t addr, uint32_t l) const {
     Log_Printf(LOG_ND_MEM, "[ND] Slot %i: Illegal lput at %08X\n",nd->slot,addr);
 }
@@ -470,6 +492,7 @@ void NextDimension::mem_init(void) {
     /* Clear at least first 4k of main memory for m68k ROM polling code */
     memset(ram, 0, 64*1024*1024);
     memset(vram, 0, 4*1024*1024);
+    memset(vram_dirty, 1, sizeof(vram_dirty));
     memset(rom, 0, 128*1024);
     memset(dmem, 0, 512);
 
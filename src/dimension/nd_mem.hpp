@@ -28,6 +28,14 @@ extern "C" {
     
 #define ND_NBIC_SPACE   0xFFFFFFE8
 
+/* VRAM scanlines, writes mark them dirty for each display showing VRAM */
+#define ND_VRAM_PITCH   ((1120+32)*4)
+#define ND_VRAM_LINES   ((0x00400000+ND_VRAM_PITCH-1)/ND_VRAM_PITCH)
+#define ND_VRAM_MAIN    0   /* main window in NeXTdimension monitor mode */
+#define ND_VRAM_WINDOW  1   /* NeXTdimension window */
+#define ND_VRAM_VIDEO   2   /* video output frames */
+#define ND_VRAM_USERS   3
+
 #define LOG_ND_MEM      LOG_NONE
     
 typedef uae_u32 (*nd_mem_get_func)(int, uaecptr) REGPARAM;
@@ -49,6 +57,7 @@ public:
     virtual uint32_t wget(uint32_t addr) const;
     virtual uint32_t bget(uint32_t addr) const;
     virtual uint32_t cs8get(uint32_t addr) const;
+    virtual uint8_t* host(uint32_t addr) const;
     
     virtual void lput(uint32_t addr, uint32_t val) const;
     virtual void wput(uint32_t addr, uint32_t val) const;
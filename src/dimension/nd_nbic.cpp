@@ -63,10 +63,7 @@ void  NBIC::write(int addr, uint8_t val) {
         case 0x0C:
             Log_Printf(ND_LOG_IO_WR, "[ND] Slot %i: NBIC Interrupt mask write %02X at %08X", slot,val,addr);
             intmask = val;
-            if(val & ND_NBIC_INTR)
-                remInterMask |= 1 << slot;
-            else
-                remInterMask &= ~(1 << slot);
+            set_line_bit(slot + 16, val & ND_NBIC_INTR);
             break;
         case 0x0D:
         case 0x0E:
@@ -140,11 +137,19 @@ void NBIC::bput(uint32_t addr, uint8_t b) {
 void NBIC::set_intstatus(bool set) {
     if (set) {
         intstatus |= ND_NBIC_INTR;
-        remInter  |= 1 << slot;
     } else {
         intstatus &= ~ND_NBIC_INTR;
-        remInter  &= ~(1 << slot);
     }
+    set_line_bit(slot, set);
+}
+
+/* Lock-free update of one line bit, boards may run on different threads */
+void NBIC::set_line_bit(int bit, bool set) {
+    int old_value, new_value;
+    do {
+        old_value = host_atomic_get(&remInter);
+        new_value = set ? (old_value | (1u << bit)) : (old_value & ~(1u << bit));
+    } while (old_value != new_value && !host_atomic_cas(&remInter, old_value, new_value));
 }
 
 
@@ -154,19 +159,21 @@ void NBIC::init(void) {
     /* Release any interrupt that may be pending */
     intmask      = 0;
     intstatus    = 0;
-    remInter     = 0;
-    remInterMask = 0;
-    set_interrupt(INT_REMOTE, RELEASE_INT);
+    set_line_bit(slot, false);
+    set_line_bit(slot + 16, false);
+    nd_nbic_interrupt();
 }
 
-volatile uint32_t NBIC::remInter;
-volatile uint32_t NBIC::remInterMask;
+atomic_int NBIC::remInter;
 
-/* Interrupt function, called from m68k thread */
+/* Interrupt check, called from m68k thread. Producers on other threads
+ * only update NBIC::remInter, this forwards a change of the combined
+ * line to the interrupt status register. */
 void nd_nbic_interrupt(void) {
-    if (NBIC::remInter&NBIC::remInterMask) {
-        set_interrupt(INT_REMOTE, SET_INT);
-    } else {
-        set_interrupt(INT_REMOTE, RELEASE_INT);
+    uint32_t lines = host_atomic_get(&NBIC::remInter);
+    bool     set   = lines & (lines >> 16) & 0xFFFF;
+
+    if (set != ((scrIntStat & INT_REMOTE) != 0)) {
+        set_interrupt(INT_REMOTE, set ? SET_INT : RELEASE_INT);
     }
 }
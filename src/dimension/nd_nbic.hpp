@@ -14,15 +14,20 @@
 
 #ifdef __cplusplus
 
+#include "host.h"
+
 class NBIC {
     int    slot;
   //  uint32_t control; // unused
     uint32_t id;
     uint8_t  intstatus;
     uint8_t  intmask;
+
+    static void set_line_bit(int bit, bool set);
 public:
-    static volatile uint32_t remInter;
-    static volatile uint32_t remInterMask;
+    /* Interrupt lines of all slots in one word, bit n is the line of slot n
+     * and bit 16+n its interrupt mask. Written by the m68k and i860 threads. */
+    static atomic_int remInter;
 
     NBIC(int slot, int id);
     
@@ -15,7 +15,7 @@
 
 
 #ifdef ENABLE_RENDERING_THREAD
-NDSDL::NDSDL(int slot, uint32_t* vram) : slot(slot), vram(vram), ndWindow(NULL), ndRenderer(NULL), ndTexture(NULL), doRepaint(true), repaintThread(NULL) {}
+NDSDL::NDSDL(int slot, uint32_t* vram, uint8_t* dirty) : slot(slot), vram(vram), dirty(dirty), blitFull(true), lutGen(0), lastFrame(0), ndWindow(NULL), ndRenderer(NULL), ndTexture(NULL), doRepaint(true), repaintThread(NULL) {}
 
 int NDSDL::repainter(void *_this) {
     return ((NDSDL*)_this)->repainter();
@@ -26,7 +26,9 @@ int NDSDL::repainter(void) {
 
     while (doRepaint) {
         if (SDL_AtomicGet(&blitNDFB)) {
-            repaint();
+            if (!repaint()) {
+                host_sleep_ms(10);
+            }
         } else {
             host_sleep_ms(100);
         }
@@ -35,18 +37,27 @@ int NDSDL::repainter(void) {
     return 0;
 }
 #else // !ENABLE_RENDERING_THREAD
-NDSDL::NDSDL(int slot, uint32_t* vram) : slot(slot), vram(vram), ndWindow(NULL), ndRenderer(NULL), ndTexture(NULL) {}
+NDSDL::NDSDL(int slot, uint32_t* vram, uint8_t* dirty) : slot(slot), vram(vram), dirty(dirty), blitFull(true), lutGen(0), lastFrame(0), ndWindow(NULL), ndRenderer(NULL), ndTexture(NULL) {}
 #endif // !ENABLE_RENDERING_THREAD
 
-void NDSDL::repaint(void) {
+/* Returns false if there was nothing new to show */
+bool NDSDL::repaint(void) {
+    if (!ndRenderer || Screen_FrameWait(&lastFrame)) {
+        return false;
+    }
     if (nd_video_enabled(slot)) {
-        Screen_BlitDimension(vram, ndTexture);
+        if (!Screen_BlitDimension(vram, dirty, blitFull, ndTexture, nd_ramdac_for_slot(slot), &lutGen)) {
+            return false;
+        }
+        blitFull = false;
     } else {
         Screen_Blank(ndTexture);
+        blitFull = true;
     }
     SDL_RenderClear(ndRenderer);
     SDL_RenderCopy(ndRenderer, ndTexture, NULL, NULL);
     SDL_RenderPresent(ndRenderer);
+    return true;
 }
 
 void NDSDL::init(void) {
@@ -60,6 +71,10 @@ void NDSDL::init(void) {
     uint32_t vsync_flag = 0;
 #endif
 
+    if (ConfigureParams.Screen.bHeadless) {
+        return;
+    }
+
     if (!ndWindow) {
         SDL_GetWindowPosition(sdlWindow, &x, &y);
         SDL_GetWindowSize(sdlWindow, &w, &h);
@@ -73,7 +88,7 @@ void NDSDL::init(void) {
         }
     }
     
-    if (ConfigureParams.Screen.nMonitorType == MONITOR_TYPE_DUAL) {
+    if (ConfigureParams.Screen.nMonitorType == MONITOR_TYPE_DUAL && !Screen_NDInMainWindow()) {
         if (!ndRenderer) {
             ndRenderer = SDL_CreateRenderer(ndWindow, -1, SDL_RENDERER_ACCELERATED | vsync_flag);
             if (!ndRenderer) {
@@ -95,21 +110,30 @@ void NDSDL::init(void) {
         }
 
         SDL_ShowWindow(ndWindow);
+        blitFull = true;
     } else {
+        pause(true);
         SDL_HideWindow(ndWindow);
     }
 }
 
 void NDSDL::uninit(void) {
-    SDL_HideWindow(ndWindow);
+    if (ndWindow) {
+        SDL_HideWindow(ndWindow);
+    }
 }
 
 void NDSDL::destroy(void) {
 #ifdef ENABLE_RENDERING_THREAD
     doRepaint = false; // stop repaint thread
     int s;
-    SDL_WaitThread(repaintThread, &s);
+    if (repaintThread) {
+        SDL_WaitThread(repaintThread, &s);
+    }
 #endif
+    if (!ndWindow) {
+        return;
+    }
     SDL_DestroyTexture(ndTexture);
     SDL_DestroyRenderer(ndRenderer);
     SDL_DestroyWindow(ndWindow);
@@ -118,7 +142,7 @@ void NDSDL::destroy(void) {
 
 void NDSDL::pause(bool pause) {
 #ifdef ENABLE_RENDERING_THREAD
-    if (!pause && ConfigureParams.Screen.nMonitorType == MONITOR_TYPE_DUAL) {
+    if (!pause && ConfigureParams.Screen.nMonitorType == MONITOR_TYPE_DUAL && !Screen_NDInMainWindow()) {
         SDL_AtomicSet(&blitNDFB, 1);
     } else {
         SDL_AtomicSet(&blitNDFB, 0);
@@ -129,6 +153,7 @@ void NDSDL::pause(bool pause) {
 void NDSDL::resize(float scale) {
     if (ndWindow) {
         SDL_SetWindowSize(ndWindow, 1120*scale, 832*scale);
+        blitFull = true;
     }
 }
 
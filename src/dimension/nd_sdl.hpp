@@ -19,6 +19,10 @@
 class NDSDL {
     int           slot;
     uint32_t*     vram;
+    uint8_t*      dirty;
+    bool          blitFull;  /* texture does not hold VRAM contents */
+    int           lutGen;    /* RAMDAC palette the texture holds */
+    uint64_t      lastFrame; /* time of the last frame for the frame rate cap */
     SDL_Window*   ndWindow;
     SDL_Renderer* ndRenderer;
     SDL_Texture*  ndTexture;
@@ -31,8 +35,8 @@ class NDSDL {
     int           repainter(void);
 #endif
 public:
-    NDSDL(int slot, uint32_t* vram);
-    void    repaint(void);
+    NDSDL(int slot, uint32_t* vram, uint8_t* dirty);
+    bool    repaint(void);
     void    init(void);
     void    uninit(void);
     void    destroy(void);
@@ -23,8 +23,9 @@
 
 /* --------- NEXTDIMENSION VIDEO I/O ---------- *
  *                                              *
- * Code for NeXTdimension video I/O. For now    *
- * only some dummy devices.                     */
+ * Code for NeXTdimension video I/O. The video  *
+ * decoder and converters only hold registers,  *
+ * video output is captured for a host sink.    */
 
 
 #define ND_VID_DMCD     0x8A
@@ -113,3 +114,123 @@ void NextDimension::video_dev_write(uint8_t addr, uint32_t step, uint8_t data) {
             break;
     }
 }
+
+
+/* Video output
+ *
+ * Each video VBL the m68k thread counts a frame and wakes the video output
+ * thread. That thread brings the back buffer up to date with VRAM, copying
+ * only the lines written since this buffer was last filled, hands it to the
+ * sink and makes the other buffer the back buffer. The sink may keep using
+ * a frame until it is called with the next one. Frames that arrive while
+ * the sink is busy are dropped, the m68k thread never waits for the sink.
+ * The frame is the top left corner of VRAM, colour conversion by the DCSC
+ * is not emulated.
+ */
+
+VIO::VIO(NextDimension* nd) : nd(nd), back(0), thread(NULL), wake(NULL), running(false),
+                              sink(NULL), sink_arg(NULL), frames(0), dropped(0) {
+    frame[0] = frame[1] = NULL;
+    host_atomic_set(&pending, 0);
+}
+
+VIO::~VIO() {
+    set_sink(NULL, NULL);
+    if (wake) {
+        SDL_DestroySemaphore(wake);
+    }
+    free(frame[0]);
+    free(frame[1]);
+}
+
+void VIO::scanout(void) {
+#if ND_STEP
+    const uint8_t* src = nd->vram;
+#else
+    const uint8_t* src = nd->vram + 16;
+#endif
+    uint8_t* dirty = nd->vram_dirty[ND_VRAM_VIDEO];
+    
+    for (int y = 0; y < ND_VIO_HEIGHT; y++) {
+        /* Clear flags before copying, writes from now on show up next time */
+        if (dirty[y]) {
+            dirty[y] = 0;
+            stale[0][y] = stale[1][y] = 1;
+        }
+        if (stale[back][y]) {
+            stale[back][y] = 0;
+            memcpy(frame[back] + y * ND_VIO_WIDTH, src + y * ND_VRAM_PITCH, ND_VIO_WIDTH * 4);
+        }
+    }
+}
+
+int VIO::worker(void* _this) {
+    return ((VIO*)_this)->worker();
+}
+
+int VIO::worker(void) {
+    int n;
+    
+    while (running) {
+        SDL_SemWait(wake);
+        n = host_atomic_set(&pending, 0);
+        if (n <= 0 || !running) {
+            continue;
+        }
+        dropped += n - 1;
+        scanout();
+        sink(nd->slot, frame[back], ND_VIO_WIDTH, ND_VIO_HEIGHT, sink_arg);
+        back ^= 1;
+    }
+    return 0;
+}
+
+/* Start or stop feeding frames to a sink, NULL stops */
+void VIO::set_sink(nd_video_sink s, void* arg) {
+    if (thread) {
+        running = false;
+        SDL_SemPost(wake);
+        host_thread_wait(thread);
+        thread = NULL;
+        Log_Printf(LOG_WARN, "[ND] Slot %i: Video output stopped (%llu frames, %llu dropped)",
+                   nd->slot, (unsigned long long)frames, (unsigned long long)dropped);
+    }
+    sink     = s;
+    sink_arg = arg;
+    if (!sink) {
+        return;
+    }
+    
+    if (!frame[0]) {
+        frame[0] = (uint32_t*)malloc(ND_VIO_WIDTH * ND_VIO_HEIGHT * 4);
+        frame[1] = (uint32_t*)malloc(ND_VIO_WIDTH * ND_VIO_HEIGHT * 4);
+    }
+    if (!wake) {
+        wake = SDL_CreateSemaphore(0);
+    }
+    if (!frame[0] || !frame[1] || !wake) {
+        Log_Printf(LOG_WARN, "[ND] Slot %i: Cannot start video output", nd->slot);
+        sink = NULL;
+        return;
+    }
+    memset(stale, 1, sizeof(stale));
+    host_atomic_set(&pending, 0);
+    frames  = 0;
+    dropped = 0;
+    running = true;
+    thread  = host_thread_create(worker, "[Previous] ND video out", this);
+    if (!thread) {
+        running = false;
+        sink    = NULL;
+    }
+}
+
+/* Count a frame, called at the start of each video blank on the m68k thread */
+void VIO::vbl(void) {
+    if (running) {
+        frames++;
+        if (host_atomic_add(&pending, 1) == 0) {
+            SDL_SemPost(wake);
+        }
+    }
+}
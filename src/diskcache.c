@@ -0,0 +1,407 @@
+/*
+  Previous - diskcache.c
+
+  This file is distributed under the GNU General Public License, version 2
+  or at your option any later version. Read the file gpl.txt for details.
+
+  Host side block cache for disk images. SCSI, MO and floppy images share
+  one pool of 4 KB blocks that is managed least recently used first. Boot
+  and application launches read the same blocks again and again, these
+  reads are served from the cache instead of the image file. Writes go
+  straight to the image and update blocks that are in the cache. Hits,
+  misses and evictions are counted per device, so the cache can be sized
+  to the working set of a machine.
+
+  Reads may come from the SCSI I/O thread and the m68k thread at the same
+  time. The cache structures are protected by a mutex, image files are
+  accessed outside of it. Each device is only accessed from one thread.
+*/
+const char DiskCache_fileid[] = "Previous diskcache.c";
+
+#include "main.h"
+#include "configuration.h"
+#include "file.h"
+#include "host.h"
+#include "log.h"
+#include "diskcache.h"
+
+
+#define DISKCACHE_SHIFT     12
+#define DISKCACHE_BLOCK     (1 << DISKCACHE_SHIFT)
+#define DISKCACHE_RUN       16      /* Max. blocks read from an image at once */
+#define DISKCACHE_NONE      (-1)
+
+typedef struct {
+	int      dev;           /* DISKCACHE_NONE if the entry is free */
+	uint64_t block;
+	int      prev, next;    /* LRU list, most recently used first */
+	int      hnext;         /* Hash chain */
+} DISKCACHE_ENTRY;
+
+static struct {
+	DISKCACHE_ENTRY *entry;
+	uint8_t *data;
+	int     *hash;
+	int      entries;
+	int      hashmask;
+	int      head, tail;
+	int      size;          /* Configured size in MB */
+	mutex_t *mutex;
+	DISKCACHE_STATS stats[DISKCACHE_DEVS];
+} cache;
+
+/* Requests per device. Only written by the thread that owns the device,
+ * so they are counted outside of the mutex. */
+static struct {
+	uint64_t reads, writes;
+	uint64_t bytes_read, bytes_written;
+} io[DISKCACHE_DEVS];
+
+static char report[256];
+
+
+static int DiskCache_Hash(int dev, uint64_t block)
+{
+	return (int)((block * 0x9E3779B1u) ^ (dev * 0x85EBCA6Bu)) & cache.hashmask;
+}
+
+static void DiskCache_Unlink(int i)
+{
+	DISKCACHE_ENTRY *e = &cache.entry[i];
+
+	if (e->prev != DISKCACHE_NONE) cache.entry[e->prev].next = e->next; else cache.head = e->next;
+	if (e->next != DISKCACHE_NONE) cache.entry[e->next].prev = e->prev; else cache.tail = e->prev;
+}
+
+static void DiskCache_PushFront(int i)
+{
+	DISKCACHE_ENTRY *e = &cache.entry[i];
+
+	e->prev = DISKCACHE_NONE;
+	e->next = cache.head;
+	if (cache.head != DISKCACHE_NONE) cache.entry[cache.head].prev = i; else cache.tail = i;
+	cache.head = i;
+}
+
+static void DiskCache_PushBack(int i)
+{
+	DISKCACHE_ENTRY *e = &cache.entry[i];
+
+	e->next = DISKCACHE_NONE;
+	e->prev = cache.tail;
+	if (cache.tail != DISKCACHE_NONE) cache.entry[cache.tail].next = i; else cache.head = i;
+	cache.tail = i;
+}
+
+/**
+ * Remove an entry from its hash chain and mark it free.
+ */
+static void DiskCache_Remove(int i)
+{
+	DISKCACHE_ENTRY *e = &cache.entry[i];
+	int *p = &cache.hash[DiskCache_Hash(e->dev, e->block)];
+
+	while (*p != i) {
+		p = &cache.entry[*p].hnext;
+	}
+	*p = e->hnext;
+	e->dev = DISKCACHE_NONE;
+}
+
+static int DiskCache_Find(int dev, uint64_t block)
+{
+	int i = cache.hash[DiskCache_Hash(dev, block)];
+
+	while (i != DISKCACHE_NONE && (cache.entry[i].dev != dev || cache.entry[i].block != block)) {
+		i = cache.entry[i].hnext;
+	}
+	return i;
+}
+
+/**
+ * Store a block, replacing the least recently used one.
+ */
+static void DiskCache_Insert(int dev, uint64_t block, const uint8_t *data)
+{
+	int i = cache.tail;
+	DISKCACHE_ENTRY *e = &cache.entry[i];
+	int h = DiskCache_Hash(dev, block);
+
+	if (DiskCache_Find(dev, block) != DISKCACHE_NONE) {
+		return;
+	}
+	if (e->dev != DISKCACHE_NONE) {
+		cache.stats[e->dev].evictions++;
+		DiskCache_Remove(i);
+	}
+	e->dev   = dev;
+	e->block = block;
+	e->hnext = cache.hash[h];
+	cache.hash[h] = i;
+	memcpy(cache.data + ((size_t)i << DISKCACHE_SHIFT), data, DISKCACHE_BLOCK);
+
+	DiskCache_Unlink(i);
+	DiskCache_PushFront(i);
+}
+
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Drop all blocks and counters. The cache is resized if its configured
+ * size has changed. Called on reset, when no disk I/O is in flight.
+ */
+void DiskCache_Reset(void)
+{
+	int i;
+
+	if (!cache.mutex) {
+		cache.mutex = host_mutex_create();
+	}
+	host_mutex_lock(cache.mutex);
+
+	if (cache.size != ConfigureParams.System.nDiskCacheSize) {
+		free(cache.entry);
+		free(cache.data);
+		free(cache.hash);
+		cache.entry   = NULL;
+		cache.data    = NULL;
+		cache.hash    = NULL;
+		cache.entries = 0;
+		cache.size    = ConfigureParams.System.nDiskCacheSize;
+
+		if (cache.size > 0) {
+			cache.entries = cache.size << (20 - DISKCACHE_SHIFT);
+			for (cache.hashmask = 1; cache.hashmask < cache.entries; cache.hashmask <<= 1) {}
+			cache.entry = malloc(cache.entries * sizeof(DISKCACHE_ENTRY));
+			cache.data  = malloc((size_t)cache.entries << DISKCACHE_SHIFT);
+			cache.hash  = malloc(cache.hashmask * sizeof(int));
+			cache.hashmask--;
+
+			if (!cache.entry || !cache.data || !cache.hash) {
+				Log_Printf(LOG_WARN, "Disk cache: Cannot allocate %d MB", cache.size);
+				free(cache.entry);
+				free(cache.data);
+				free(cache.hash);
+				cache.entry   = NULL;
+				cache.data    = NULL;
+				cache.hash    = NULL;
+				cache.entries = 0;
+			} else {
+				Log_Printf(LOG_WARN, "Disk cache: %d MB", cache.size);
+			}
+		}
+	}
+
+	cache.head = cache.tail = DISKCACHE_NONE;
+	for (i = 0; i < cache.entries; i++) {
+		cache.entry[i].dev = DISKCACHE_NONE;
+		DiskCache_PushBack(i);
+	}
+	for (i = 0; cache.hash && i <= cache.hashmask; i++) {
+		cache.hash[i] = DISKCACHE_NONE;
+	}
+	memset(cache.stats, 0, sizeof(cache.stats));
+
+	host_mutex_unlock(cache.mutex);
+}
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Drop all blocks of a device. Called when a disk is inserted or ejected
+ * and after its image has been changed behind the cache.
+ */
+void DiskCache_Drop(int dev)
+{
+	int i;
+
+	if (!cache.entries) {
+		return;
+	}
+	host_mutex_lock(cache.mutex);
+	for (i = 0; i < cache.entries; i++) {
+		if (cache.entry[i].dev == dev) {
+			DiskCache_Remove(i);
+			DiskCache_Unlink(i);
+			DiskCache_PushBack(i);
+		}
+	}
+	host_mutex_unlock(cache.mutex);
+}
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Read from a disk image through the cache. Runs of missing blocks are
+ * read with one File_Read. Regions that do not fill a whole block, like
+ * the end of an image, are read directly.
+ */
+bool DiskCache_Read(int dev, uint8_t *data, uint32_t size, uint64_t offset, FILE *fp)
+{
+	uint64_t block, first, last;
+	uint32_t pos, len, run, j;
+	uint8_t *buf = NULL;
+	int i;
+
+	io[dev].reads++;
+	io[dev].bytes_read += size;
+
+	if (!cache.entries) {
+		return File_Read(data, size, offset, fp);
+	}
+
+	first = offset >> DISKCACHE_SHIFT;
+	last  = (offset + size - 1) >> DISKCACHE_SHIFT;
+
+	for (block = first; block <= last; block += run) {
+		pos = (block == first) ? (offset & (DISKCACHE_BLOCK - 1)) : 0;
+		len = DISKCACHE_BLOCK - pos;
+		if (len > size) {
+			len = size;
+		}
+
+		host_mutex_lock(cache.mutex);
+		i = DiskCache_Find(dev, block);
+		if (i != DISKCACHE_NONE) {
+			memcpy(data, cache.data + ((size_t)i << DISKCACHE_SHIFT) + pos, len);
+			DiskCache_Unlink(i);
+			DiskCache_PushFront(i);
+			cache.stats[dev].hits++;
+			host_mutex_unlock(cache.mutex);
+			data += len;
+			size -= len;
+			run = 1;
+			continue;
+		}
+		/* Collect the following missing blocks */
+		for (run = 1; run < DISKCACHE_RUN && block + run <= last; run++) {
+			if (DiskCache_Find(dev, block + run) != DISKCACHE_NONE) {
+				break;
+			}
+		}
+		cache.stats[dev].misses += run;
+		host_mutex_unlock(cache.mutex);
+
+		if (!buf && !(buf = malloc(DISKCACHE_RUN << DISKCACHE_SHIFT))) {
+			return File_Read(data, size, (block << DISKCACHE_SHIFT) + pos, fp);
+		}
+		if (!File_Read(buf, run << DISKCACHE_SHIFT, block << DISKCACHE_SHIFT, fp)) {
+			/* Partial block at the end of the image */
+			free(buf);
+			return File_Read(data, size, (block << DISKCACHE_SHIFT) + pos, fp);
+		}
+
+		host_mutex_lock(cache.mutex);
+		for (j = 0; j < run; j++) {
+			DiskCache_Insert(dev, block + j, buf + (j << DISKCACHE_SHIFT));
+		}
+		host_mutex_unlock(cache.mutex);
+
+		len = (run << DISKCACHE_SHIFT) - pos;
+		if (len > size) {
+			len = size;
+		}
+		memcpy(data, buf + pos, len);
+		data += len;
+		size -= len;
+	}
+	free(buf);
+	return true;
+}
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Write to a disk image and update the blocks that are in the cache.
+ */
+bool DiskCache_Write(int dev, uint8_t *data, uint32_t size, uint64_t offset, FILE *fp)
+{
+	uint64_t block, first, last;
+	uint32_t pos, len;
+	int i;
+
+	io[dev].writes++;
+	io[dev].bytes_written += size;
+
+	if (!File_Write(data, size, offset, fp)) {
+		DiskCache_Drop(dev);
+		return false;
+	}
+	if (!cache.entries) {
+		return true;
+	}
+
+	first = offset >> DISKCACHE_SHIFT;
+	last  = (offset + size - 1) >> DISKCACHE_SHIFT;
+
+	host_mutex_lock(cache.mutex);
+	for (block = first; block <= last; block++) {
+		pos = (block == first) ? (offset & (DISKCACHE_BLOCK - 1)) : 0;
+		len = DISKCACHE_BLOCK - pos;
+		if (len > size) {
+			len = size;
+		}
+		i = DiskCache_Find(dev, block);
+		if (i != DISKCACHE_NONE) {
+			memcpy(cache.data + ((size_t)i << DISKCACHE_SHIFT) + pos, data, len);
+		}
+		data += len;
+		size -= len;
+	}
+	host_mutex_unlock(cache.mutex);
+	return true;
+}
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Return the counters of a device.
+ */
+void DiskCache_Stats(int dev, DISKCACHE_STATS *stats)
+{
+	if (cache.mutex) {
+		host_mutex_lock(cache.mutex);
+		*stats = cache.stats[dev];
+		host_mutex_unlock(cache.mutex);
+	} else {
+		memset(stats, 0, sizeof(*stats));
+	}
+	stats->reads         = io[dev].reads;
+	stats->writes        = io[dev].writes;
+	stats->bytes_read    = io[dev].bytes_read;
+	stats->bytes_written = io[dev].bytes_written;
+}
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Return a short name of a device.
+ */
+const char *DiskCache_Name(int dev)
+{
+	static char name[16];
+
+	if (dev < DISKCACHE_MO(0)) {
+		snprintf(name, sizeof(name), "SCSI%d", dev);
+	} else if (dev < DISKCACHE_FLOPPY(0)) {
+		snprintf(name, sizeof(name), "MO%d", dev - DISKCACHE_MO(0));
+	} else {
+		snprintf(name, sizeof(name), "FD%d", dev - DISKCACHE_FLOPPY(0));
+	}
+	return name;
+}
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Return the hit rate of all devices that have been accessed.
+ */
+const char *DiskCache_Report(uint64_t realTime, uint64_t hostTime)
+{
+	DISKCACHE_STATS s;
+	char *r = report;
+	int dev;
+
+	report[0] = '\0';
+	for (dev = 0; dev < DISKCACHE_DEVS; dev++) {
+		DiskCache_Stats(dev, &s);
+		if (s.hits + s.misses && r < report + sizeof(report) - 32) {
+			r += sprintf(r, " %s:%.1f%%", DiskCache_Name(dev), 100.0 * s.hits / (s.hits + s.misses));
+		}
+	}
+	return report;
+}
@@ -40,6 +40,8 @@ int32_t  fsv(int32_t v)  { return ntohl(v); }
 
 DiskImage::DiskImage(const string& path)
 : imf(path, ios::binary | ios::in)
+, zimf(NULL)
+, zim(NULL)
 , diskOffset(0)
 , blockSize(BLOCKSZ)
 , rawOptical(false)
@@ -50,6 +52,15 @@ DiskImage::DiskImage(const string& path)
         return;
     }
     
+#if HAVE_LIBZ
+    zimf = fopen(path.c_str(), "rb");
+    zim  = ZImage_Open(zimf);
+    if(!(zim) && zimf) {
+        fclose(zimf);
+        zimf = NULL;
+    }
+#endif
+    
     read(0, sizeof(dl), &dl);
     if(
        strncmp(dl.dl_version, "NeXT", 4) &&
@@ -71,8 +82,8 @@ DiskImage::DiskImage(const string& path)
            strncmp(dl.dl_version, "dlV2", 4) &&
            strncmp(dl.dl_version, "dlV3", 4)
            ) {
-            cout << "Unknown version: " << dl.dl_version << endl;
-            exit(1);
+            error = "unknown disk label";
+            return;
         }
         cout << "Magneto-optical disk detected" << endl;
         
@@ -113,6 +124,7 @@ DiskImage::DiskImage(const string& path)
             }
             if (bbt[i] > 0) {
                 bad++;
+                badBlocks.insert(make_pair(fsv(bbt[i]), i));
             }
         }
         if (bad > 0) {
@@ -127,8 +139,8 @@ DiskImage::DiskImage(const string& path)
     }
     sectorSize = fsv(dl.dl_dt.d_secsize);
     if(sectorSize != 0x400) {
-        cout << "Unsupported sector size: " << sectorSize;
-        exit(1);
+        error = "unsupported sector size";
+        return;
     }
     for(int p = 0; p < NPART; p++) {
         if(fsv(dl.dl_dt.d_partitions[p].p_bsize) == 0 || fsv(dl.dl_dt.d_partitions[p].p_bsize) == ~0)
@@ -137,69 +149,82 @@ DiskImage::DiskImage(const string& path)
     }
 }
 
+// Decode a raw optical block in place, bad blocks are read from their
+// alternate location.
+void DiskImage::decode(int64_t block, char* buffer) {
+    size_t bmIndex = block / spa;
+    int    bmShift = (bmIndex & 0xF) << 1;
+    int    bmValue = (fsv(bm[bmIndex>>4]) >> bmShift) & 3;
+    switch(bmValue) {
+        case BM_UNTESTED:
+        case BM_WRITTEN:
+            if(rs_decode((uint8_t*)buffer) >= 0)
+                break;
+            if(bmValue != BM_UNTESTED)
+                cout << "Warning: block " << block << " not decodable" << endl;
+        case BM_BAD:
+        {
+            map<uint32_t, size_t>::const_iterator it = badBlocks.find(block);
+            if(it != badBlocks.end()) {
+                size_t   bbtIndex = it->second;
+                uint32_t reserve  = bbtIndex / apag;
+                if(reserve < fsv(dl.dl_dt.d_ngroups)) {
+                    reserve *= fsv(dl.dl_dt.d_ag_size);
+                    reserve += fsv(dl.dl_dt.d_ag_off) + (bbtIndex % apag) * spa;
+                } else {
+                    reserve = fsv(dl.dl_dt.d_ngroups) * fsv(dl.dl_dt.d_ag_size);
+                    reserve += (bbtIndex - fsv(dl.dl_dt.d_ngroups) * apag) * spa;
+                }
+                reserve += block % spa;
+                reserve += fsv(dl.dl_dt.d_front);
+                
+                cout << "Mapping bad block " << block << " to " << reserve << endl;
+                read(reserve * BLOCKSZ, BLOCKSZ, buffer);
+                break;
+            }
+            if(bmValue != BM_UNTESTED)
+                cout << "Unable to re-map bad block " << block << endl;
+        }
+        case BM_ERASED:
+            memset(buffer, 0, blockSize);
+            break;
+            
+        default:
+            break;
+    }
+}
+
+// Consecutive blocks are read with one call, up to READ_BLOCKS at a time
 ios_base::iostate DiskImage::read(streampos offset, streamsize size, void* data) {
     int64_t block     = offset / BLOCKSZ;
     int64_t blockOff  = offset % BLOCKSZ;
     ios_base::iostate result(ios_base::goodbit);
     char*   dataPtr   = (char*)data;
-    char    buffer[blockSize];
+    vector<char> buffer;
     while(size > 0) {
-        int64_t rdSize = std::min((int64_t)size, BLOCKSZ - blockOff);
-        imf.seekg(block * blockSize + diskOffset, ios::beg);
-        imf.read(buffer, blockSize);
-        if(rawOptical) {
-            size_t bmIndex = block / spa;
-            int    bmShift = (bmIndex & 0xF) << 1;
-            int    bmValue = (fsv(bm[bmIndex>>4]) >> bmShift) & 3;
-            switch(bmValue) {
-                case BM_UNTESTED:
-                case BM_WRITTEN:
-                    if(rs_decode((uint8_t*)buffer) >= 0)
-                        break;
-                    if(bmValue != BM_UNTESTED)
-                        cout << "Warning: block " << block << " not decodable" << endl;
-                case BM_BAD:
-                {
-                    bool mappedBlock(false);
-                    for(size_t bbtIndex = 0; bbtIndex < bbt_size; bbtIndex++) {
-                        if(fsv(bbt[bbtIndex]) == 0)
-                            continue;
-                        if(fsv(bbt[bbtIndex]) == block) {
-                            uint32_t reserve = bbtIndex / apag;
-                            if(reserve < fsv(dl.dl_dt.d_ngroups)) {
-                                reserve *= fsv(dl.dl_dt.d_ag_size);
-                                reserve += fsv(dl.dl_dt.d_ag_off) + (bbtIndex % apag) * spa;
-                            } else {
-                                reserve = fsv(dl.dl_dt.d_ngroups) * fsv(dl.dl_dt.d_ag_size);
-                                reserve += (bbtIndex - fsv(dl.dl_dt.d_ngroups) * apag) * spa;
-                            }
-                            reserve += block % spa;
-                            reserve += fsv(dl.dl_dt.d_front);
-                            
-                            cout << "Mapping bad block " << block << " to " << reserve << endl;
-                            read(reserve * BLOCKSZ, BLOCKSZ, buffer);
-                            mappedBlock = true;
-                            break;
-                        }
-                    }
-                    if(mappedBlock)
-                        break;
-                    if(bmValue != BM_UNTESTED)
-                        cout << "Unable to re-map bad block " << block << endl;
-                }
-                case BM_ERASED:
-                    memset(buffer, 0, blockSize);
-                    break;
-                    
-                default:
-                    break;
-            }
+        int64_t count = std::min((blockOff + (int64_t)size + BLOCKSZ - 1) / BLOCKSZ, (int64_t)READ_BLOCKS);
+        buffer.resize(count * blockSize);
+#if HAVE_LIBZ
+        if(zim) {
+            if(!(ZImage_Read(zim, (uint8_t*)&buffer[0], count * blockSize, block * blockSize + diskOffset)))
+                imf.setstate(ios::failbit);
+        } else
+#endif
+        {
+            imf.seekg(block * blockSize + diskOffset, ios::beg);
+            imf.read(&buffer[0], count * blockSize);
+        }
+        for(int64_t i = 0; i < count; i++) {
+            char*   blockPtr = &buffer[i * blockSize];
+            int64_t rdSize   = std::min((int64_t)size, BLOCKSZ - blockOff);
+            if(rawOptical)
+                decode(block, blockPtr);
+            memcpy(dataPtr, blockPtr + blockOff, rdSize);
+            blockOff = 0;
+            size    -= rdSize;
+            dataPtr += rdSize;
+            block++;
         }
-        memcpy(dataPtr, buffer + blockOff, rdSize);
-        blockOff = 0;
-        size    -= rdSize;
-        dataPtr += rdSize;
-        block++;
         ios_base::iostate result = imf.rdstate();
         if(result != ios_base::goodbit) {
             cout << "Can't read " << size << " bytes at offset " << offset << endl;
@@ -210,7 +235,12 @@ ios_base::iostate DiskImage::read(streampos offset, streamsize size, void* data)
     return result;
 }
 
-DiskImage::~DiskImage() {}
+DiskImage::~DiskImage() {
+    if(zim) {
+        ZImage_Close(zim);
+        fclose(zimf);
+    }
+}
 
 bool DiskImage::valid() {
     return error.empty();
@@ -10,8 +10,10 @@
 #define DiskImage_h
 
 #include <fstream>
+#include <map>
 #include <vector>
 #include <stdint.h>
+#include "zimage.h"
 
 #include "Partition.h"
 
@@ -93,11 +95,18 @@ class Partition;
 #define BM_WRITTEN  2
 #define BM_ERASED   3
 
+#define READ_BLOCKS 64 /* Blocks read from the image at once */
+
 class DiskImage {
     std::ifstream          imf;
+    FILE*                  zimf;
+    ZIMAGE*                zim;
     int64_t                diskOffset;
     int64_t                blockSize;
     bool                   rawOptical;
+    std::map<uint32_t, size_t> badBlocks; /* block -> bbt index */
+
+    void decode(int64_t block, char* buffer);
 public:
     struct disk_label      dl;
     uint32_t               bm[16*BLOCKSZ];
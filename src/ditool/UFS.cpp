@@ -13,14 +13,41 @@
 
 using namespace std;
 
-const uint32_t BLOCK_INVALID = ~0;
+uint8_t* UFSBlockCache::get(uint32_t blkNo) {
+    unordered_map<uint32_t, list<Entry>::iterator>::iterator it = index.find(blkNo);
+    if(it == index.end())
+        return NULL;
+    entries.splice(entries.begin(), entries, it->second);
+    return &it->second->data[0];
+}
 
-UFS::UFS(const Partition& part) : part(part) {
-    for(int i = 0; i <= BCACHE_SIZE; i++) {
-        blockCache[i]   = NULL;
-        cacheBlockNo[i] = BLOCK_INVALID;
+// Returns the buffer for a new block, the oldest block is dropped when full
+uint8_t* UFSBlockCache::add(uint32_t blkNo, size_t size) {
+    drop(blkNo);
+    if(entries.size() >= capacity) {
+        index.erase(entries.back().blkNo);
+        entries.splice(entries.begin(), entries, --entries.end());
+    } else {
+        entries.push_front(Entry());
     }
-    
+    entries.front().blkNo = blkNo;
+    entries.front().data.resize(size);
+    index[blkNo] = entries.begin();
+    return &entries.front().data[0];
+}
+
+void UFSBlockCache::drop(uint32_t blkNo) {
+    unordered_map<uint32_t, list<Entry>::iterator>::iterator it = index.find(blkNo);
+    if(it != index.end()) {
+        entries.erase(it->second);
+        index.erase(it);
+    }
+}
+
+UFS::UFS(const Partition& part, uint32_t cacheBlocks)
+: part(part)
+, metaCache(cacheBlocks)
+, dataCache(UFS_DATA_BLOCKS) {
     if(strncmp(&part.part.p_type[1], "4.3BSD", 6) != 0)
         return;
     
@@ -38,17 +65,9 @@ UFS::UFS(const Partition& part) : part(part) {
     fsBMask  = fsv(~superBlock.fs_bmask);
     fsBSize  = fsv(superBlock.fs_bsize);
     fsFrag   = fsv(superBlock.fs_frag);
-    
-    for(int i = 0; i <= BCACHE_SIZE; i++) {
-        blockCache[i]   = new uint8_t[part.im->sectorSize * fsFrag];
-        cacheBlockNo[i] = BLOCK_INVALID;
-    }
 }
 
-UFS::~UFS(void) {
-    for(int i = 0; i <= BCACHE_SIZE; i++)
-        delete[] blockCache[i];
-}
+UFS::~UFS(void) {}
 
 int UFS::readInode(icommon& inode, uint32_t ino) {
     struct inb indsb;
@@ -66,41 +85,45 @@ int UFS::readInode(icommon& inode, uint32_t ino) {
     return ERR_NO;
 }
 
-int UFS::fillCacheWithBlock(uint32_t blockNum) {
-    int cacheIndex = blockNum & BCACHE_MASK;
-    if(cacheBlockNo[cacheIndex] != blockNum) {
-        if(int err = part.readSectors(blockNum, fsFrag, blockCache[cacheIndex]))
-            return err;
-        cacheBlockNo[cacheIndex] = blockNum;
+uint8_t* UFS::fillCacheWithBlock(UFSBlockCache& cache, uint32_t blockNum, int& err) {
+    uint8_t* result = cache.get(blockNum);
+    if(!(result)) {
+        result = cache.add(blockNum, part.im->sectorSize * fsFrag);
+        if((err = part.readSectors(blockNum, fsFrag, result))) {
+            cache.drop(blockNum);
+            return NULL;
+        }
     }
-    return cacheIndex;
+    err = ERR_NO;
+    return result;
 }
 
 int32_t UFS::bmap(const icommon& inode, uint32_t fBlk) {
     uint32_t iPtrCnt = fsBSize >> 2;
     if(fBlk >= NDADDR) {
-        int lvl1CacheIndex = -1;
-        int lvl2CacheIndex = -1;
+        uint8_t* lvl1Block;
+        uint8_t* lvl2Block;
+        int      err;
         fBlk -= NDADDR;
         if(fBlk >= iPtrCnt) {
             fBlk -= iPtrCnt;
             uint32_t lvl2Idx = fBlk & (fsBMask >> 2);
             uint32_t lvl1Idx = fBlk >> (fsBShift - 2);
-            if((lvl1CacheIndex = fillCacheWithBlock(fsv(inode.ic_ib[1]))) < 0 ) {
+            if(!(lvl1Block = fillCacheWithBlock(metaCache, fsv(inode.ic_ib[1]), err))) {
                 cout << "error in lvl1 bmap(" << fBlk << ")" << endl;
                 return -1;
             }
-            if((lvl2CacheIndex = fillCacheWithBlock(fsv(((idb*)blockCache[lvl1CacheIndex])->idbs[lvl1Idx]))) < 0)  {
+            if(!(lvl2Block = fillCacheWithBlock(metaCache, fsv(((idb*)lvl1Block)->idbs[lvl1Idx]), err)))  {
                 cout << "error in lvl2 bmap(" << fBlk << ")" << endl;
                 return -1;
             }
-            return fsv(((idb*)blockCache[lvl2CacheIndex])->idbs[lvl2Idx]);
+            return fsv(((idb*)lvl2Block)->idbs[lvl2Idx]);
         } else {
-            if((lvl1CacheIndex = fillCacheWithBlock(fsv(inode.ic_ib[0]))) < 0 ) {
+            if(!(lvl1Block = fillCacheWithBlock(metaCache, fsv(inode.ic_ib[0]), err))) {
                 cout << "error in lvl1 bmap(" << fBlk << ")" << endl;
                 return(-1);
             }
-            return fsv(((idb*)blockCache[lvl1CacheIndex])->idbs[fBlk]);
+            return fsv(((idb*)lvl1Block)->idbs[fBlk]);
         }
     }
     else return fsv(inode.ic_db[fBlk]);
@@ -161,6 +184,8 @@ int UFS::readFile(const icommon& inode, uint32_t start, uint32_t len, uint8_t* d
     int32_t  dBlk;
     uint32_t sOff;
     uint32_t tLen;
+    uint8_t* block;
+    int      err;
     
     if(start + len > fsv(inode.ic_size))
         len = fsv(inode.ic_size) - start;
@@ -172,51 +197,48 @@ int UFS::readFile(const icommon& inode, uint32_t start, uint32_t len, uint8_t* d
         return ERR_BMAP;
     
     if(sOff + len < fsBSize) {
-        if(int err = readBlock(dBlk))
+        if(!(block = fillCacheWithBlock(dataCache, dBlk, err)))
             return err;
-        memcpy(data, blockCache[BCACHE_SIZE] + sOff, len);
+        memcpy(data, block + sOff, len);
         return ERR_NO;
     } else {
         tLen = fsBSize - sOff;
-        if(int err = readBlock(dBlk))
+        if(!(block = fillCacheWithBlock(dataCache, dBlk, err)))
             return err;
-        memcpy(data, blockCache[BCACHE_SIZE] + sOff, tLen);
+        memcpy(data, block + sOff, tLen);
         data += tLen;
         len -= tLen;
         fBlk ++;
     }
     
+    // whole blocks go straight to the destination, physically contiguous
+    // blocks are read together
     tLen = fsBSize;
     while(len >= tLen) {
         if((dBlk = bmap(inode, fBlk)) < 0)
             return dBlk;
-        if(int err = part.readSectors(dBlk, fsFrag, data))
+        uint32_t run = 1;
+        while(run < UFS_RUN_BLOCKS && len >= (run + 1) * tLen && dBlk &&
+              bmap(inode, fBlk + run) == static_cast<int32_t>(dBlk + run * fsFrag))
+            run++;
+        if(int err = part.readSectors(dBlk, run * fsFrag, data))
             return err;
-        data += tLen;
-        len -= tLen;
-        fBlk++;
+        data += run * tLen;
+        len  -= run * tLen;
+        fBlk += run;
     }
     
     if(len > 0) {
         if((dBlk = bmap(inode, fBlk)) < 0)
             return dBlk;
-        if(int err = readBlock(dBlk))
+        if(!(block = fillCacheWithBlock(dataCache, dBlk, err)))
             return err;
-        memcpy(data, blockCache[BCACHE_SIZE], len);
+        memcpy(data, block, len);
     }
     
     return ERR_NO;
 }
 
-int UFS::readBlock(uint32_t dBlk) {
-    if(!(cacheBlockNo[BCACHE_SIZE] == dBlk)) {
-        if(int err = part.readSectors(dBlk, fsFrag, blockCache[BCACHE_SIZE]))
-            return err;
-        cacheBlockNo[BCACHE_SIZE] = dBlk;
-    }
-    return ERR_NO;
-}
-
 std::vector<direct> UFS::list(uint32_t ino) {
     vector<direct> result;
     icommon inode;
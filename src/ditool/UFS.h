@@ -9,6 +9,9 @@
 #define UFS_hpp
 
 #include <fstream>
+#include <list>
+#include <unordered_map>
+#include <vector>
 #include <stdint.h>
 
 #include "Partition.h"
@@ -16,9 +19,26 @@
 #include "inode.h"
 #include "fsdir.h"
 
-const int BCACHE_SHIFT = 8; // block cache size as power-of-two
-const int BCACHE_SIZE  = 1 << BCACHE_SHIFT;
-const int BCACHE_MASK  = BCACHE_SIZE-1;
+const uint32_t UFS_CACHE_BLOCKS = 1024; // default number of cached indirect blocks
+const uint32_t UFS_DATA_BLOCKS  = 4;    // cached data blocks for partial reads
+const uint32_t UFS_RUN_BLOCKS   = 64;   // contiguous data blocks read at once
+
+// Least recently used file system blocks
+class UFSBlockCache {
+    struct Entry {
+        uint32_t             blkNo;
+        std::vector<uint8_t> data;
+    };
+    std::list<Entry>                                         entries;
+    std::unordered_map<uint32_t, std::list<Entry>::iterator> index;
+    size_t                                                   capacity;
+public:
+    UFSBlockCache(size_t capacity) : capacity(capacity < 1 ? 1 : capacity) {}
+    
+    uint8_t* get(uint32_t blkNo);
+    uint8_t* add(uint32_t blkNo, size_t size);
+    void     drop(uint32_t blkNo);
+};
 
 class UFS {
     const Partition& part;
@@ -26,16 +46,15 @@ class UFS {
     uint32_t         fsBMask;
     uint32_t         fsBSize;
     uint32_t         fsFrag;
-    uint8_t*         blockCache[BCACHE_SIZE+1];
-    uint32_t         cacheBlockNo[BCACHE_SIZE+1];
+    UFSBlockCache    metaCache;
+    UFSBlockCache    dataCache;
     
     int32_t          bmap(const icommon& inode, uint32_t fBlk);
-    int              fillCacheWithBlock(uint32_t blkNo);
-    int              readBlock(uint32_t dBlk);
+    uint8_t*         fillCacheWithBlock(UFSBlockCache& cache, uint32_t blkNo, int& err);
 public:
     ufs_super_block  superBlock;
     
-    UFS(const Partition& part);
+    UFS(const Partition& part, uint32_t cacheBlocks = UFS_CACHE_BLOCKS);
     ~UFS(void);
     
     std::string         mountPoint(void) const;
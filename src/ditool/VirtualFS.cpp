@@ -326,6 +326,46 @@ VirtualFS::VirtualFS(const HostPath& basePath, const VFSPath& basePathAlias)
 VirtualFS::~VirtualFS() {
 }
 
+// Lifetime of cached attributes. Changes made through VirtualFS drop the
+// entries at once, this only bounds how long changes made by other host
+// processes stay unnoticed.
+static const uint64_t ATTR_CACHE_TTL_US  = 1000000;
+static const size_t   ATTR_CACHE_ENTRIES = 4096;
+
+class VFSCacheLock {
+    VirtualFS& fs;
+public:
+    VFSCacheLock(VirtualFS& fs) : fs(fs) {fs.cacheLock();}
+    ~VFSCacheLock()                      {fs.cacheUnlock();}
+};
+
+static uint64_t cache_time_us(void) {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return static_cast<uint64_t>(tv.tv_sec) * 1000000 + tv.tv_usec;
+}
+
+void VirtualFS::invalidate(const VFSPath& absoluteVFSpath) {
+    string key = toHostPath(absoluteVFSpath).string();
+    VFSCacheLock lock(*this);
+    statCache.erase(key);
+    attrsCache.erase(key);
+}
+
+void VirtualFS::cacheAttrs(const string& hostPath, const AttrsEntry& entry) {
+    VFSCacheLock lock(*this);
+    if(attrsCache.size() >= ATTR_CACHE_ENTRIES)
+        attrsCache.clear();
+    attrsCache.erase(hostPath);
+    attrsCache.insert(make_pair(hostPath, entry));
+}
+
+void VirtualFS::invalidateAll(void) {
+    VFSCacheLock lock(*this);
+    statCache.clear();
+    attrsCache.clear();
+}
+
 HostPath VirtualFS::getBasePath() {return basePath;}
 
 VFSPath VirtualFS::getBasePathAlias() {return basePathAlias;}
@@ -435,6 +475,10 @@ void VirtualFS::setFileAttrs(const VFSPath& absoluteVFSpath, const FileAttrs& fs
     HostPath hostPath   = toHostPath(absoluteVFSpath);
 #if HAVE_SYS_XATTR_H
 #if HAVE_LXETXATTR
+    {
+        VFSCacheLock lock(*this);
+        attrsCache.erase(hostPath.string());
+    }
     if(::lsetxattr(hostPath.c_str(), NFSD_ATTRS.c_str(), serialized.c_str(), serialized.length(), 0) != 0)
 #else
     if(::setxattr(hostPath.c_str(), NFSD_ATTRS.c_str(), serialized.c_str(), serialized.length(), 0, XATTR_NOFOLLOW) != 0)
@@ -447,13 +491,29 @@ FileAttrs VirtualFS::getFileAttrs(const VFSPath& absoluteVFSpath) {
     char buffer[128];
     memset(buffer, 0, sizeof(buffer));
     HostPath hostPath = toHostPath(absoluteVFSpath);
+    uint64_t now      = cache_time_us();
+    
+    {
+        VFSCacheLock lock(*this);
+        map<string, AttrsEntry>::iterator it = attrsCache.find(hostPath.string());
+        if(it != attrsCache.end()) {
+            if(now - it->second.time < ATTR_CACHE_TTL_US)
+                return it->second.attrs;
+            attrsCache.erase(it);
+        }
+    }
+    
 #if HAVE_SYS_XATTR_H
 #if HAVE_LXETXATTR
     if(::lgetxattr(hostPath.c_str(), NFSD_ATTRS.c_str(), buffer, sizeof(buffer)) == 0)
 #else
     if(::getxattr(hostPath.c_str(), NFSD_ATTRS.c_str(), buffer, sizeof(buffer), 0, XATTR_NOFOLLOW) > 0)
 #endif
-        return FileAttrs(buffer);
+    {
+        FileAttrs result(buffer);
+        cacheAttrs(hostPath.string(), AttrsEntry(now, result));
+        return result;
+    }
     else
 #endif
     {
@@ -465,7 +525,9 @@ FileAttrs VirtualFS::getFileAttrs(const VFSPath& absoluteVFSpath) {
 #endif
         fstat.st_uid = vfsGetUID(absoluteVFSpath.parent_path(), true);
         fstat.st_gid = vfsGetGID(absoluteVFSpath.parent_path(), true);
-        return FileAttrs(fstat);
+        FileAttrs result(fstat);
+        cacheAttrs(hostPath.string(), AttrsEntry(now, result));
+        return result;
     }
 }
 
@@ -491,6 +553,7 @@ VFSFile::VFSFile(VirtualFS& ft, const VFSPath& path, const std::string& mode)
         ft.vfsChmod(path, fstat.st_mode);
         file = ::fopen(ft.toHostPath(path).c_str(), mode.c_str());
     }
+    if(file) ft.invalidate(path); // the file may have been created
 }
 
 VFSFile::~VFSFile(void) {
@@ -511,6 +574,7 @@ VFSFile::~VFSFile(void) {
         ft.vfsUtimes(path, times);
     }
     if(file) fclose(file);
+    ft.invalidate(path); // size and times may have changed
 }
 
 size_t VFSFile::read(size_t fileOffset, void* dst, size_t count) {
@@ -542,6 +606,7 @@ static int get_error(int result) {
 }
 
 int VirtualFS::vfsChmod(const VFSPath& absoluteVFSpath, mode_t mode) {
+    invalidate(absoluteVFSpath);
 #ifdef _WIN32
     return 0; // not supported
 #else
@@ -580,11 +645,41 @@ DIR* VirtualFS::vfsOpendir(const VFSPath& absoluteVFSpath) {
     return ::opendir(toHostPath(absoluteVFSpath).c_str());
 }
 
+int VirtualFS::vfsReaddir(const VFSPath& absoluteVFSpath, vector<VFSDirEntry>& entries) {
+    DIR* dir = vfsOpendir(absoluteVFSpath);
+    if(!(dir)) return errno;
+    
+    for(struct dirent* fileinfo = readdir(dir); fileinfo; fileinfo = readdir(dir)) {
+        VFSDirEntry entry;
+#if HAVE_STRUCT_DIRENT_D_NAMELEN
+        entry.name = string(fileinfo->d_name, fileinfo->d_namlen);
+#else
+        entry.name = fileinfo->d_name;
+#endif
+        entry.ino  = fileinfo->d_ino;
+        entries.push_back(entry);
+    }
+    closedir(dir);
+    return 0;
+}
+
+int VirtualFS::vfsRead(const VFSPath& absoluteVFSpath, size_t fileOffset, void* dst, size_t& count) {
+    VFSFile file(*this, absoluteVFSpath, "rb");
+    if(!(file.isOpen())) {
+        count = 0;
+        return errno;
+    }
+    count = file.read(fileOffset, dst, count);
+    return 0;
+}
+
 int VirtualFS::vfsRemove(const VFSPath& absoluteVFSpath) {
+    invalidate(absoluteVFSpath);
     return get_error(::remove(toHostPath(absoluteVFSpath).c_str()));
 }
 
 int VirtualFS::vfsRename(const VFSPath& absoluteVFSpathFrom, const VFSPath& absoluteVFSpathTo) {
+    invalidateAll(); // paths below a renamed directory change too
     return get_error(::rename(toHostPath(absoluteVFSpathFrom).c_str(), toHostPath(absoluteVFSpathTo).c_str()));
 }
 
@@ -627,6 +722,8 @@ int VirtualFS::vfsReadlink(const VFSPath& absoluteVFSpath, VFSPath& result) {
 }
 
 int VirtualFS::vfsLink(const VFSPath& absoluteVFSpathFrom, const VFSPath& absoluteVFSpathTo, bool soft) {
+    invalidate(absoluteVFSpathTo);
+    if(!(soft)) invalidate(absoluteVFSpathFrom); // link count
 #ifdef _WIN32
     return EACCES; // not supported
 #else
@@ -640,6 +737,7 @@ int VirtualFS::vfsLink(const VFSPath& absoluteVFSpathFrom, const VFSPath& absolu
 }
 
 int VirtualFS::vfsMkdir(const VFSPath& absoluteVFSpath, mode_t mode) {
+    invalidate(absoluteVFSpath);
 #ifdef _WIN32
     return get_error(::mkdir(toHostPath(absoluteVFSpath).c_str()));
 #else
@@ -648,6 +746,7 @@ int VirtualFS::vfsMkdir(const VFSPath& absoluteVFSpath, mode_t mode) {
 }
 
 int VirtualFS::vfsNftw(const VFSPath& absoluteVFSpath, int (*fn)(const char *, const struct stat *ptr, int flag, struct FTW *), int depth, int flags) {
+    invalidateAll(); // fn may change everything below the path
     return get_error(::nftw(toHostPath(absoluteVFSpath).c_str(), fn, depth, flags));
 }
 
@@ -672,14 +771,36 @@ int VirtualFS::vfsStatvfs(const VFSPath& absoluteVFSpath, struct statvfs& fsstat
 }
 
 int VirtualFS::vfsStat(const VFSPath& absoluteVFSpath, struct stat& fstat) {
+    string   hostPath = toHostPath(absoluteVFSpath).string();
+    uint64_t now      = cache_time_us();
+    
+    {
+        VFSCacheLock lock(*this);
+        map<string, StatEntry>::iterator it = statCache.find(hostPath);
+        if(it != statCache.end() && now - it->second.time < ATTR_CACHE_TTL_US) {
+            fstat = it->second.fstat;
+            return it->second.result;
+        }
+    }
+    
+    StatEntry entry;
+    entry.time = now;
 #ifdef _WIN32
-    return get_error(::stat(toHostPath(absoluteVFSpath).c_str(), &fstat));
+    entry.result = get_error(::stat(hostPath.c_str(), &entry.fstat));
 #else
-    return get_error(::lstat(toHostPath(absoluteVFSpath).c_str(), &fstat));
+    entry.result = get_error(::lstat(hostPath.c_str(), &entry.fstat));
 #endif
+    fstat = entry.fstat;
+    
+    VFSCacheLock lock(*this);
+    if(statCache.size() >= ATTR_CACHE_ENTRIES)
+        statCache.clear();
+    statCache[hostPath] = entry;
+    return entry.result;
 }
 
 int VirtualFS::vfsUtimes(const VFSPath& absoluteVFSpath, const struct timeval times[2]) {
+    invalidate(absoluteVFSpath);
 #ifdef _WIN32
     return 0; // not supported
 #else
@@ -6,6 +6,10 @@
 #include <memory>
 #include <cstring>
 #include <algorithm>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 
 #include <stdio.h>
 #include <unistd.h>
@@ -54,7 +58,13 @@ static void print_help(void) {
     cout << "  -lst <type> List files in disk image of type. type=FILE|DIR|SLINK|HLINK|FIFO|CHAR|BLOCK|SOCK" << endl;
     cout << "  -out <path> Copy files from disk image to <path>." << endl;
     cout << "  -clean      Clean output directory before copying." << endl;
+    cout << "  -update     Copy only files changed since the last copy, remove deleted files." << endl;
     cout << "  -netboot    Prepare files in output directory for netboot." << endl;
+    cout << "  -cache <MB> Size of the file system metadata cache (default 8)." << endl;
+    cout << "  -j <n>      Number of threads writing files (default: number of cores, up to 8)." << endl;
+#if HAVE_LIBZ
+    cout << "  -z <file>   Write a compressed copy of the disk image to <file>." << endl;
+#endif
 }
 
 static bool ignore_name(const char* name) {
@@ -251,7 +261,172 @@ static bool do_print(const char* type, const char* listType, bool& doPrint, bool
     return true;
 }
 
-static void process_inodes_recr(UFS& ufs, map<uint32_t, string>& inode2path, set<string>& skip, uint32_t ino, const string& path, VirtualFS* ft, ostream& os, const char* listType) {
+// Host files are written by a pool of threads while the disk image is
+// read. The UFS reader is not thread safe, so data is read by the thread
+// walking the file system. It also creates the files, later hard links and
+// attributes can rely on them existing. Queued data is limited in size.
+struct CopyJob {
+    VFSPath               path;
+    size_t                size;
+    unique_ptr<uint8_t[]> data;
+    unique_ptr<VFSFile>   file;
+    CopyJob(const string& path, size_t size) : path(path), size(size), data(new uint8_t[size]) {}
+};
+
+class FileWriterPool {
+    static const size_t QUEUE_BYTES = 64 << 20;
+
+    deque<CopyJob*>    jobs;
+    size_t             queued;
+    bool               done;
+    mutex              lock;
+    condition_variable wakeWorker;
+    condition_variable wakeProducer;
+    vector<thread>     workers;
+
+    void work(void) {
+        for(;;) {
+            unique_lock<mutex> guard(lock);
+            wakeWorker.wait(guard, [this] {return done || !jobs.empty();});
+            if(jobs.empty()) return;
+            CopyJob* job = jobs.front();
+            jobs.pop_front();
+            guard.unlock();
+
+            if(job->file->write(0, job->data.get(), job->size) != job->size) {
+                string errmsg("Error while writing '");
+                errmsg += job->path.string();
+                errmsg += "'";
+                perror(errmsg.c_str());
+                exit(1);
+            }
+            size_t size = job->size;
+            delete job;
+
+            guard.lock();
+            queued -= size;
+            wakeProducer.notify_one();
+        }
+    }
+public:
+    FileWriterPool(int count) : queued(0), done(false) {
+        for(int i = 0; i < max(count, 1); i++)
+            workers.push_back(thread(&FileWriterPool::work, this));
+    }
+
+    ~FileWriterPool(void) {
+        finish();
+    }
+
+    void submit(CopyJob* job) {
+        unique_lock<mutex> guard(lock);
+        wakeProducer.wait(guard, [this] {return queued < QUEUE_BYTES;});
+        queued += job->size;
+        jobs.push_back(job);
+        wakeWorker.notify_one();
+    }
+
+    // Wait until all files are written
+    void finish(void) {
+        {
+            lock_guard<mutex> guard(lock);
+            done = true;
+        }
+        wakeWorker.notify_all();
+        for(size_t i = 0; i < workers.size(); i++)
+            workers[i].join();
+        workers.clear();
+    }
+};
+
+// The manifest lists what has been copied to the output directory, one
+// "inode mtime_sec mtime_usec size path" line per entry. With -update only
+// entries that differ from the manifest are copied again and entries that
+// are no longer in the image are removed.
+class Manifest {
+    struct Entry {
+        uint32_t ino;
+        uint32_t mtimeSec;
+        uint32_t mtimeUsec;
+        uint32_t size;
+        Entry(void) : ino(0), mtimeSec(0), mtimeUsec(0), size(0) {}
+        Entry(uint32_t ino, const icommon& inode)
+        : ino(ino)
+        , mtimeSec(fsv(inode.ic_mtime.tv_sec))
+        , mtimeUsec(fsv(inode.ic_mtime.tv_usec))
+        , size(fsv(inode.ic_size)) {}
+        bool operator == (const Entry& e) const {
+            return ino == e.ino && mtimeSec == e.mtimeSec && mtimeUsec == e.mtimeUsec && size == e.size;
+        }
+    };
+    map<string, Entry> previous;
+    map<string, Entry> current;
+    HostPath           path;
+public:
+    Manifest(const HostPath& path, bool update) : path(path) {
+        if(!(update)) return;
+        ifstream in(path.string());
+        for(string line; getline(in, line);) {
+            Entry entry;
+            int   pathPos = 0;
+            if(sscanf(line.c_str(), "%u %u %u %u %n", &entry.ino, &entry.mtimeSec, &entry.mtimeUsec, &entry.size, &pathPos) >= 4 && pathPos)
+                previous[line.substr(pathPos)] = entry;
+        }
+    }
+
+    // Records an entry, returns true if it is unchanged since the last copy
+    bool add(const string& vfsPath, uint32_t ino, const icommon& inode) {
+        Entry entry(ino, inode);
+        current[vfsPath] = entry;
+        map<string, Entry>::const_iterator it = previous.find(vfsPath);
+        return it != previous.end() && it->second == entry;
+    }
+
+    bool known(const string& vfsPath) const {
+        return previous.find(vfsPath) != previous.end();
+    }
+
+    // Removes entries that have been copied before but are gone from the image
+    void removeDeleted(VirtualFS& ft) {
+        for(map<string, Entry>::reverse_iterator it = previous.rbegin(); it != previous.rend(); it++) {
+            if(current.find(it->first) != current.end()) continue;
+            struct stat fstat;
+            if(ft.vfsStat(it->first, fstat) != 0) continue;
+            cout << "Removing '" << it->first << "'" << endl;
+            ft.vfsNftw(it->first, VirtualFS::remove, 64, FTW_DEPTH | FTW_PHYS);
+        }
+    }
+
+    bool save(void) {
+        ofstream out(path.string());
+        for(map<string, Entry>::const_iterator it = current.begin(); it != current.end(); it++)
+            out << it->second.ino << ' ' << it->second.mtimeSec << ' ' << it->second.mtimeUsec << ' ' << it->second.size << ' ' << it->first << '\n';
+        return out.good();
+    }
+};
+
+// Returns true if an existing host file can be kept. Entries that changed
+// since the last copy are removed, directories are always kept.
+static bool update_entry(VirtualFS& ft, Manifest& manifest, const string& dirEntPath, uint32_t ino, const icommon& inode) {
+    bool        known     = manifest.known(dirEntPath);
+    bool        unchanged = manifest.add(dirEntPath, ino, inode);
+    struct stat fstat;
+    if(!(known) || ft.vfsStat(dirEntPath, fstat) != 0)
+        return false;
+    bool isDir = (fsv(inode.ic_mode) & IFMT) == IFDIR;
+    if(S_ISDIR(fstat.st_mode) && isDir)
+        return true;
+    if(unchanged)
+        return true;
+    cout << "Updating '" << dirEntPath << "'" << endl;
+    if(S_ISDIR(fstat.st_mode))
+        ft.vfsNftw(dirEntPath, VirtualFS::remove, 64, FTW_DEPTH | FTW_PHYS);
+    else
+        ft.vfsRemove(dirEntPath);
+    return false;
+}
+
+static void process_inodes_recr(UFS& ufs, map<uint32_t, string>& inode2path, set<string>& skip, uint32_t ino, const string& path, VirtualFS* ft, Manifest* manifest, FileWriterPool* writers, ostream& os, const char* listType) {
     vector<direct> entries = ufs.list(ino);
     for(size_t i = 0; i < entries.size(); i++) {
         direct& dirEnt = entries[i];
@@ -262,9 +437,12 @@ static void process_inodes_recr(UFS& ufs, map<uint32_t, string>& inode2path, set
 
         bool doPrint(true);
         bool forcePrint(false);
+        bool keep(false);
                                 
         if(!(ignore_name(dirEnt.d_name)) || dirEntPath == "/") {
-            if(ft && ft->vfsAccess(dirEntPath, F_OK) == 0) {
+            if(ft && manifest && dirEntPath != "/")
+                keep = update_entry(*ft, *manifest, dirEntPath, fsv(dirEnt.d_inonum), inode);
+            if(ft && !(keep) && ft->vfsAccess(dirEntPath, F_OK) == 0) {
                 struct stat fstat;
                 ft->vfsStat(dirEntPath, fstat);
                 if((fsv(inode.ic_mode) & IFMT) == IFLNK) {
@@ -298,7 +476,7 @@ static void process_inodes_recr(UFS& ufs, map<uint32_t, string>& inode2path, set
             if(inode2path.find(fsv(dirEnt.d_inonum)) != inode2path.end()) {
                 if(do_print("HLINK", listType, doPrint, forcePrint)) os << "[HLINK] " << inode2path[fsv(dirEnt.d_inonum)] << " <- ";
                 forcePrint = true;
-                if(ft) ft->vfsLink(inode2path[fsv(dirEnt.d_inonum)], dirEntPath, false);
+                if(ft && !(keep)) ft->vfsLink(inode2path[fsv(dirEnt.d_inonum)], dirEntPath, false);
             } else
                 inode2path[fsv(dirEnt.d_inonum)] = dirEntPath;
         }
@@ -306,52 +484,47 @@ static void process_inodes_recr(UFS& ufs, map<uint32_t, string>& inode2path, set
         switch(fsv(inode.ic_mode) & IFMT) {
             case IFIFO:       /* named pipe (fifo) */
                 if(do_print("FIFO", listType, doPrint, forcePrint)) os << "[FIFO]  ";
-                if(ft) ft->touch(dirEntPath);
+                if(ft && !(keep)) ft->touch(dirEntPath);
                 break;
             case IFCHR:        /* character special */
                 if(do_print("CHAR", listType, doPrint, forcePrint)) os << "[CHAR]  ";
-                if(ft) ft->touch(dirEntPath);
+                if(ft && !(keep)) ft->touch(dirEntPath);
                 break;
             case IFDIR:       /* directory */
                 if(do_print("DIR", listType, doPrint, forcePrint)) os << "[DIR]   ";
                 if(!(ignore_name(dirEnt.d_name))) {
                     if(doPrint) os << dirEntPath << endl;
                     doPrint = false;
-                    if(ft) ft->vfsMkdir(dirEntPath, DEFAULT_PERM);
-                    process_inodes_recr(ufs, inode2path, skip, fsv(dirEnt.d_inonum), dirEntPath, ft, os, listType);
+                    if(ft && !(keep)) ft->vfsMkdir(dirEntPath, DEFAULT_PERM);
+                    process_inodes_recr(ufs, inode2path, skip, fsv(dirEnt.d_inonum), dirEntPath, ft, manifest, writers, os, listType);
                 }
                 break;
             case IFBLK:       /* block special */
                 if(do_print("BLOCK", listType, doPrint, forcePrint)) os << "[BLOCK] ";
-                if(ft) ft->touch(dirEntPath);
+                if(ft && !(keep)) ft->touch(dirEntPath);
                 break;
             case IFREG:        /* regular */
                 if(do_print("FILE", listType, doPrint, forcePrint)) os << "[FILE]  ";
-                if(ft && ft->vfsAccess(dirEntPath, F_OK) != 0) {
-                    VFSFile file(*ft, dirEntPath, "wb");
-                    if(file.isOpen()) {
-                        size_t size = fsv(inode.ic_size);
-                        unique_ptr<uint8_t[]> buffer(new uint8_t[size]);
-                        ufs.readFile(inode, 0, static_cast<uint32_t>(size), buffer.get());
-                        if(file.write(0, buffer.get(), size) != size) {
-                            string errmsg("Error while writing '");
-                            errmsg += dirEntPath;
-                            errmsg += "'";
-                            perror(errmsg.c_str());
-                            exit(1);
-                        }
+                if(ft && !(keep) && ft->vfsAccess(dirEntPath, F_OK) != 0) {
+                    CopyJob* job = new CopyJob(dirEntPath, fsv(inode.ic_size));
+                    job->file.reset(new VFSFile(*ft, job->path, "wb"));
+                    if(job->file->isOpen()) {
+                        ufs.readFile(inode, 0, static_cast<uint32_t>(job->size), job->data.get());
+                        writers->submit(job);
+                    } else {
+                        delete job;
                     }
                 }
                 break;
             case IFLNK: {       /* symbolic link */
                 string link = ufs.readlink(inode);
                 if(do_print("SLINK", listType, doPrint, forcePrint)) os << "[SLINK] " << link << " <- ";
-                if(ft) ft->vfsLink(link, dirEntPath, true);
+                if(ft && !(keep)) ft->vfsLink(link, dirEntPath, true);
                 break;
             }
             case IFSOCK:        /* socket */
                 if(do_print("SOCK", listType, doPrint, forcePrint)) os << "[SOCK]  ";
-                if(ft) ft->touch(dirEntPath);
+                if(ft && !(keep)) ft->touch(dirEntPath);
                 break;
             default:
                 cout << "WARNING: unknown format (" << (fsv(inode.ic_mode) & IFMT) << ") '" << dirEntPath << "'" << endl;
@@ -365,15 +538,19 @@ static void process_inodes_recr(UFS& ufs, map<uint32_t, string>& inode2path, set
 }
 
 class DiToolFS : public VirtualFS {
+    recursive_mutex mutex;
 public:
     DiToolFS(const HostPath& basePath, const VFSPath& basePathAlias) : VirtualFS(basePath, basePathAlias) {}
     virtual void move  (uint64_t fileHandleFrom, const VFSPath& absoluteVFSpathTo) {}
     virtual void remove(uint64_t fileHandle) {}
+protected:
+    virtual void cacheLock  (void) {mutex.lock();}
+    virtual void cacheUnlock(void) {mutex.unlock();}
 };
 
-static void dump_part(DiskImage& im, int part, const HostPath& outPath, ostream& os, const char* listType) {
+static void dump_part(DiskImage& im, int part, const HostPath& outPath, ostream& os, const char* listType, uint32_t cacheBlocks, int threads, bool update) {
     VirtualFS* ft = NULL;
-    UFS ufs(im.parts[part]);
+    UFS ufs(im.parts[part], cacheBlocks);
 
     if(!(outPath.empty()))
         ft = new DiToolFS(outPath, ufs.mountPoint());
@@ -381,8 +558,20 @@ static void dump_part(DiskImage& im, int part, const HostPath& outPath, ostream&
     map<uint32_t, string> inode2path;
     set<string>           skip;
     if(ft) {
-        cout << "---- copying " << im.path << " partition " << part << " to " << ft->getBasePath() << endl;
-        process_inodes_recr(ufs, inode2path, skip, ROOTINO, "", ft, os, listType);
+        char manifestName[32];
+        snprintf(manifestName, sizeof(manifestName), ".ditool_manifest.%d", part);
+        Manifest manifest(outPath / manifestName, update);
+        cout << "---- " << (update ? "updating " : "copying ") << im.path << " partition " << part << " to " << ft->getBasePath() << endl;
+        {
+            FileWriterPool writers(threads);
+            process_inodes_recr(ufs, inode2path, skip, ROOTINO, "", ft, &manifest, &writers, os, listType);
+        }
+        if(update) {
+            cout << "---- removing deleted files" << endl;
+            manifest.removeDeleted(*ft);
+        }
+        if(!(manifest.save()))
+            cout << "Unable to write manifest " << (outPath / manifestName) << endl;
         cout << "---- setting file attributes for NFSD" << endl;
         set_attrs_inode(ufs, ROOTINO, "", *ft);
         set_attrs_recr(ufs, skip, ROOTINO, "", *ft);
@@ -393,7 +582,7 @@ static void dump_part(DiskImage& im, int part, const HostPath& outPath, ostream&
         verify_attr_recr(ufs, skip, ROOTINO, "", *ft);
         delete ft;
     } else {
-        process_inodes_recr(ufs, inode2path, skip, ROOTINO, "", ft, os, listType);
+        process_inodes_recr(ufs, inode2path, skip, ROOTINO, "", ft, NULL, NULL, os, listType);
     }
 }
 
@@ -452,7 +641,29 @@ extern "C" int main(int argc, const char * argv[]) {
     const char* listType  = get_option(argv, argv + argc, "-lst");
     HostPath    outPath   = to_host_path(get_option(argv, argv + argc, "-out"));
     bool        clean     = has_option(argv, argv + argc, "-clean");
+    bool        update    = has_option(argv, argv + argc, "-update") && !(clean);
     bool        netboot   = has_option(argv, argv + argc, "-netboot");
+    const char* cacheSize = get_option(argv, argv + argc, "-cache");
+    uint32_t    cacheBlocks = cacheSize ? atoi(cacheSize) * 128 : UFS_CACHE_BLOCKS; // 8 KB blocks
+    const char* threadNum = get_option(argv, argv + argc, "-j");
+    int         threads   = threadNum ? atoi(threadNum) : min(max(static_cast<int>(thread::hardware_concurrency()), 1), 8);
+#if HAVE_LIBZ
+    HostPath    zipFile   = to_host_path(get_option(argv, argv + argc, "-z"));
+
+    if (!(imageFile).empty() && !(zipFile.empty())) {
+        FILE* in  = fopen(imageFile.c_str(), "rb");
+        FILE* out = fopen(zipFile.c_str(), "wb");
+        bool  ok  = in && out && ZImage_Compress(in, out, ZIMAGE_CHUNKSIZE);
+        if(in)  fclose(in);
+        if(out) fclose(out);
+        if(!(ok)) {
+            cout << "Can't compress '" << imageFile << "' to '" << zipFile << "'." << endl;
+            return 1;
+        }
+        cout << "Compressed '" << imageFile << "' to '" << zipFile << "'." << endl;
+        return 0;
+    }
+#endif
 
     if (!(imageFile).empty()) {
         DiskImage  im(imageFile.string());
@@ -492,10 +703,10 @@ extern "C" int main(int argc, const char * argv[]) {
             
             int part = partNum ? atoi(partNum) : -1;
             if(part >= 0 && part < static_cast<int>(im.parts.size()) && im.parts[part].isUFS()) {
-                dump_part(im, part, outPath, listFiles ? cout : nullStream, listType);
+                dump_part(im, part, outPath, listFiles ? cout : nullStream, listType, cacheBlocks, threads, update);
             } else {
                 for(int part = 0; part < (int)im.parts.size(); part++)
-                    dump_part(im, part, outPath, listFiles ? cout : nullStream, listType);
+                    dump_part(im, part, outPath, listFiles ? cout : nullStream, listType, cacheBlocks, threads, update);
             }
         }
     } else if(!(netboot)) {
@@ -554,7 +765,10 @@ bool NetbootTaskFile::run(VirtualFS& vfs) {
         ofstream out(vfs.toHostPath(file).string());
         if(!(out)) return false;
         
-        return run(out);
+        bool result = run(out);
+        out.close();
+        vfs.invalidate(file); // written behind the back of the VirtualFS
+        return result;
     } catch(exception& e) {
         cout << e.what() << endl;
         return false;
@@ -14,6 +14,7 @@ const char Dma_fileid[] = "Previous dma.c";
 #include "ioMem.h"
 #include "ioMemTables.h"
 #include "m68000.h"
+#include "NextBus.hpp"
 #include "scsi.h"
 #include "esp.h"
 #include "mo.h"
@@ -92,7 +93,7 @@ uint8_t modma_buf[DMA_BURST_SIZE];
 #define DMA_STAT_MASK   (DMA_ENABLE|DMA_SUPDATE|DMA_COMPLETE|DMA_BUSEXC)
 
 
-static inline uint32_t dma_getlong(uint8_t *buf, uint32_t pos) {
+static inline uint32_t dma_getlong(const uint8_t *buf, uint32_t pos) {
     return (buf[pos] << 24) | (buf[pos+1] << 16) | (buf[pos+2] << 8) | buf[pos+3];
 }
 
@@ -383,7 +384,117 @@ static void dma_interrupt(int channel) {
 
 /* DMA Read and Write Memory Functions */
 
+/* Bulk copies between main memory and device buffers. Each piece that stays
+ * within one memory bank is copied with memcpy if the bank is plain memory,
+ * everything else goes through the bus functions. The next pointer of the
+ * channel is advanced as the data is moved, so it points to the failing
+ * address if a bus error occurs. */
+static void dma_copy_out(int channel, const uint8_t* src, uint32_t size) {
+    uint32_t addr, len;
+    uint8_t* dst;
+    
+    while (size > 0) {
+        addr = dma[channel].next;
+        len = 0x10000 - (addr & 0xffff);
+        if (len > size) {
+            len = size;
+        }
+        if ((dst = phys_host_write(addr, len))) {
+            memcpy(dst, src, len);
+        } else if ((addr|len)&3) {
+            put_byte(addr, *src);
+            len = 1;
+        } else {
+            put_long(addr, dma_getlong(src, 0));
+            len = 4;
+        }
+        dma[channel].next += len;
+        src += len;
+        size -= len;
+    }
+}
+
+static void dma_copy_in(int channel, uint8_t* dst, uint32_t size) {
+    uint32_t addr, len;
+    uint8_t* src;
+    
+    while (size > 0) {
+        addr = dma[channel].next;
+        len = 0x10000 - (addr & 0xffff);
+        if (len > size) {
+            len = size;
+        }
+        if ((src = phys_host_read(addr, len))) {
+            memcpy(dst, src, len);
+        } else if ((addr|len)&3) {
+            *dst = get_byte(addr);
+            len = 1;
+        } else {
+            dma_putlong(get_long(addr), dst, 0);
+            len = 4;
+        }
+        dma[channel].next += len;
+        dst += len;
+        size -= len;
+    }
+}
+
+/* Return the number of bytes a device can move in whole bursts, limited
+ * by the space left in the channel. */
+static uint32_t dma_burst_room(int channel, uint32_t size) {
+    uint32_t room = dma[channel].limit - dma[channel].next;
+    
+    if (size > room) {
+        size = room;
+    }
+    return size - size % DMA_BURST_SIZE;
+}
+
 /* Channel SCSI (shared with floppy drive) */
+/* Copy as many whole bursts as the SCSI or floppy buffer holds and the
+ * channel can take to main memory with one memcpy. Returns false if nothing
+ * has been copied, the data must then be moved burst by burst. */
+static bool dma_esp_write_span(void) {
+    uint8_t* src;
+    int size;
+    
+    if (floppy_select) {
+        size = flp_buffer.size;
+        src = flp_buffer.data + flp_buffer.limit - flp_buffer.size;
+    } else {
+        src = ESP_Send_Span(&size);
+    }
+    if (size <= 0 || (size = dma_burst_room(CHANNEL_SCSI, size)) == 0) {
+        return false;
+    }
+    if ((size / DMA_BURST_SIZE) & 1) {
+        ESP_DMA_set_status(); /* once per burst */
+    }
+    dma_copy_out(CHANNEL_SCSI, src, size);
+    if (floppy_select) {
+        flp_buffer.size -= size;
+    } else {
+        ESP_Send_Consume(size);
+    }
+    return true;
+}
+
+/* Copy as many whole bursts as the floppy buffer has room for from main
+ * memory with one memcpy. Returns false if nothing has been copied. */
+static bool dma_flp_read_span(void) {
+    uint32_t size = dma_burst_room(CHANNEL_SCSI, flp_buffer.limit - flp_buffer.size);
+    
+    if (size == 0) {
+        return false;
+    }
+    if ((size / DMA_BURST_SIZE) & 1) {
+        ESP_DMA_set_status(); /* once per burst */
+    }
+    dma_copy_in(CHANNEL_SCSI, flp_buffer.data + flp_buffer.size, size);
+    flp_buffer.size += size;
+    return true;
+}
+
 void dma_esp_write_memory(void) {
     Log_Printf(LOG_DMA_LEVEL, "[DMA] Channel SCSI: Write to memory at $%08x, %i bytes (ESP counter %i)",
                dma[CHANNEL_SCSI].next,dma[CHANNEL_SCSI].limit-dma[CHANNEL_SCSI].next,esp_counter);
@@ -404,6 +515,10 @@ void dma_esp_write_memory(void) {
         }
 
         while (dma[CHANNEL_SCSI].next<=dma[CHANNEL_SCSI].limit) {
+            /* Copy whole bursts straight from the SCSI buffer to memory */
+            if (espdma_buf_limit==0 && dma_esp_write_span()) {
+                continue;
+            }
             /* Fill DMA channel FIFO (only if limit < FIFO size) */
             if (espdma_buf_limit<DMA_BURST_SIZE) {
                 if (floppy_select) {
@@ -514,6 +629,10 @@ void dma_esp_read_memory(void) {
         }
         
         while (dma[CHANNEL_SCSI].next<dma[CHANNEL_SCSI].limit) {
+            /* Copy whole bursts straight from memory to the floppy buffer */
+            if (espdma_buf_limit==0 && floppy_select && dma_flp_read_span()) {
+                continue;
+            }
             /* Read data from memory to DMA channel FIFO (only if limit < FIFO size) */
             if (espdma_buf_limit<DMA_BURST_SIZE) {
                 while (dma[CHANNEL_SCSI].next<dma[CHANNEL_SCSI].limit && espdma_buf_limit<DMA_BURST_SIZE) {
@@ -569,6 +688,29 @@ void dma_esp_read_memory(void) {
 
 
 /* Channel MO */
+/* Copy whole bursts between the ECC buffer and main memory */
+static bool dma_mo_write_span(void) {
+    uint32_t size = dma_burst_room(CHANNEL_DISK, ecc_buffer[eccout].size);
+    
+    if (size == 0) {
+        return false;
+    }
+    dma_copy_out(CHANNEL_DISK, ecc_buffer[eccout].data+ecc_buffer[eccout].limit-ecc_buffer[eccout].size, size);
+    ecc_buffer[eccout].size -= size;
+    return true;
+}
+
+static bool dma_mo_read_span(void) {
+    uint32_t size = dma_burst_room(CHANNEL_DISK, ecc_buffer[eccin].limit-ecc_buffer[eccin].size);
+    
+    if (size == 0) {
+        return false;
+    }
+    dma_copy_in(CHANNEL_DISK, ecc_buffer[eccin].data+ecc_buffer[eccin].size, size);
+    ecc_buffer[eccin].size += size;
+    return true;
+}
+
 void dma_mo_write_memory(void) {
     Log_Printf(LOG_DMA_LEVEL, "[DMA] Channel MO: Write to memory at $%08x, %i bytes",
                dma[CHANNEL_DISK].next,dma[CHANNEL_DISK].limit-dma[CHANNEL_DISK].next);
@@ -589,6 +731,10 @@ void dma_mo_write_memory(void) {
         }
         
         while (dma[CHANNEL_DISK].next<=dma[CHANNEL_DISK].limit) {
+            /* Copy whole bursts straight from the ECC buffer to memory */
+            if (modma_buf_limit==0 && dma_mo_write_span()) {
+                continue;
+            }
             /* Fill DMA channel FIFO (only if limit < FIFO size) */
             if (modma_buf_limit<DMA_BURST_SIZE) {
                 while (modma_buf_limit<DMA_BURST_SIZE && ecc_buffer[eccout].size>0) {
@@ -646,6 +792,10 @@ void dma_mo_read_memory(void) {
         }
         
         while (dma[CHANNEL_DISK].next<dma[CHANNEL_DISK].limit) {
+            /* Copy whole bursts straight from memory to the ECC buffer */
+            if (modma_buf_limit==0 && dma_mo_read_span()) {
+                continue;
+            }
             /* Read data from memory to DMA channel FIFO (only if limit < FIFO size) */
             if (modma_buf_limit<DMA_BURST_SIZE) {
                 while (dma[CHANNEL_DISK].next<dma[CHANNEL_DISK].limit && modma_buf_limit<DMA_BURST_SIZE) {
@@ -705,10 +855,13 @@ void dma_sndout_read_memory(void) {
         }
         
         TRY(prb) {
-            while (dma[CHANNEL_SOUNDOUT].next<dma[CHANNEL_SOUNDOUT].limit && snd_buffer_len<SND_BUFFER_LIMIT) {
-                snd_buffer[snd_buffer_len] = get_byte(dma[CHANNEL_SOUNDOUT].next);
-                dma[CHANNEL_SOUNDOUT].next++;
-                snd_buffer_len++;
+            if (dma[CHANNEL_SOUNDOUT].next<dma[CHANNEL_SOUNDOUT].limit && snd_buffer_len<SND_BUFFER_LIMIT) {
+                uint32_t size = dma[CHANNEL_SOUNDOUT].limit-dma[CHANNEL_SOUNDOUT].next;
+                if (size > (uint32_t)(SND_BUFFER_LIMIT-snd_buffer_len)) {
+                    size = SND_BUFFER_LIMIT-snd_buffer_len;
+                }
+                dma_copy_in(CHANNEL_SOUNDOUT, snd_buffer+snd_buffer_len, size);
+                snd_buffer_len += size;
             }
         } CATCH(prb) {
             Log_Printf(LOG_WARN, "[DMA] Channel Sound Out: Bus error reading from %08x",dma[CHANNEL_SOUNDOUT].next);
@@ -776,10 +929,13 @@ void dma_printer_read_memory(void) {
         }
         
         TRY(prb) {
-            while (dma[CHANNEL_PRINTER].next<dma[CHANNEL_PRINTER].limit && lp_buffer.size<lp_buffer.limit) {
-                lp_buffer.data[lp_buffer.size]=get_byte(dma[CHANNEL_PRINTER].next);
-                lp_buffer.size++;
-                dma[CHANNEL_PRINTER].next++;
+            if (dma[CHANNEL_PRINTER].next<dma[CHANNEL_PRINTER].limit && lp_buffer.size<lp_buffer.limit) {
+                uint32_t size = dma[CHANNEL_PRINTER].limit-dma[CHANNEL_PRINTER].next;
+                if (size > (uint32_t)(lp_buffer.limit-lp_buffer.size)) {
+                    size = lp_buffer.limit-lp_buffer.size;
+                }
+                dma_copy_in(CHANNEL_PRINTER, lp_buffer.data+lp_buffer.size, size);
+                lp_buffer.size += size;
             }
         } CATCH(prb) {
             Log_Printf(LOG_WARN, "[DMA] Channel Printer: Bus error reading from %08x",dma[CHANNEL_PRINTER].next);
@@ -836,10 +992,13 @@ void dma_enet_write_memory(bool eop) {
     }
     
     TRY(prb) {
-        while (dma[CHANNEL_EN_RX].next<dma[CHANNEL_EN_RX].limit && enet_rx_buffer.size>0) {
-            put_byte(dma[CHANNEL_EN_RX].next, enet_rx_buffer.data[enet_rx_buffer.limit-enet_rx_buffer.size]);
-            enet_rx_buffer.size--;
-            dma[CHANNEL_EN_RX].next++;
+        if (dma[CHANNEL_EN_RX].next<dma[CHANNEL_EN_RX].limit && enet_rx_buffer.size>0) {
+            uint32_t size = dma[CHANNEL_EN_RX].limit-dma[CHANNEL_EN_RX].next;
+            if (size > (uint32_t)enet_rx_buffer.size) {
+                size = enet_rx_buffer.size;
+            }
+            dma_copy_out(CHANNEL_EN_RX, enet_rx_buffer.data+enet_rx_buffer.limit-enet_rx_buffer.size, size);
+            enet_rx_buffer.size -= size;
         }
     } CATCH(prb) {
         Log_Printf(LOG_WARN, "[DMA] Channel Ethernet Receive: Bus error while writing to %08x",dma[CHANNEL_EN_RX].next);
@@ -868,6 +1027,10 @@ void dma_enet_write_memory(bool eop) {
     dma_enet_interrupt(CHANNEL_EN_RX);
 }
 
+bool dma_enet_ready(void) {
+    return (dma[CHANNEL_EN_RX].csr&DMA_ENABLE) && dma[CHANNEL_EN_RX].next<dma[CHANNEL_EN_RX].limit;
+}
+
 bool dma_enet_read_memory(void) {
     if (dma[CHANNEL_EN_TX].csr&DMA_ENABLE) {
         Log_Printf(LOG_DMA_LEVEL, "[DMA] Channel Ethernet Transmit: Read from memory at $%08x, %i bytes",
@@ -878,10 +1041,13 @@ bool dma_enet_read_memory(void) {
         }
         
         TRY(prb) {
-            while (dma[CHANNEL_EN_TX].next<ENADDR(dma[CHANNEL_EN_TX].limit) && enet_tx_buffer.size<enet_tx_buffer.limit) {
-                enet_tx_buffer.data[enet_tx_buffer.size]=get_byte(dma[CHANNEL_EN_TX].next);
-                enet_tx_buffer.size++;
-                dma[CHANNEL_EN_TX].next++;
+            if (dma[CHANNEL_EN_TX].next<ENADDR(dma[CHANNEL_EN_TX].limit) && enet_tx_buffer.size<enet_tx_buffer.limit) {
+                uint32_t size = ENADDR(dma[CHANNEL_EN_TX].limit)-dma[CHANNEL_EN_TX].next;
+                if (size > (uint32_t)(enet_tx_buffer.limit-enet_tx_buffer.size)) {
+                    size = enet_tx_buffer.limit-enet_tx_buffer.size;
+                }
+                dma_copy_in(CHANNEL_EN_TX, enet_tx_buffer.data+enet_tx_buffer.size, size);
+                enet_tx_buffer.size += size;
             }
         } CATCH(prb) {
             Log_Printf(LOG_WARN, "[DMA] Channel Ethernet Transmit: Bus error while writing to %08x",dma[CHANNEL_EN_TX].next);
@@ -902,15 +1068,29 @@ bool dma_enet_read_memory(void) {
 
 /* Memory to Memory */
 
-uint32_t m2m_buffer[DMA_BURST_SIZE];
+/* Each descriptor of the write channel is copied at once, plain memory
+ * with memmove and everything else burst by burst. The channels complete
+ * after the time the transfer takes, 4 cycles per burst. */
+
+uint8_t m2m_buffer[DMA_BURST_SIZE];
 int m2m_buffer_size;
+bool m2m_busy = false; /* Copied, waiting for completion */
+
+static void dma_m2m_burst(void);
+static void dma_m2m_copy(void);
 
 void M2MDMA_IO_Handler(void) {
     CycInt_AcknowledgeInterrupt();
     
+    if (m2m_busy) {
+        m2m_busy = false;
+        if ((dma[CHANNEL_M2R].csr&DMA_ENABLE) && dma[CHANNEL_M2R].next==dma[CHANNEL_M2R].limit) {
+            dma_interrupt(CHANNEL_M2R);
+        }
+        dma_interrupt(CHANNEL_R2M);
+    }
     if (dma[CHANNEL_R2M].csr&DMA_ENABLE) {
-        dma_m2m_write_memory();
-        CycInt_AddRelativeInterruptCycles(4, INTERRUPT_M2M_IO);
+        dma_m2m_copy();
     }
 }
 
@@ -926,48 +1106,103 @@ void dma_m2m(void) {
                    dma[CHANNEL_M2R].limit-dma[CHANNEL_M2R].next,dma[CHANNEL_M2R].next,
                    dma[CHANNEL_R2M].limit-dma[CHANNEL_R2M].next,dma[CHANNEL_R2M].next);
         
+        /* A running transfer continues with the new descriptor when it completes */
+        if (m2m_busy) {
+            return;
+        }
         CycInt_AddRelativeInterruptCycles(4, INTERRUPT_M2M_IO);
     }
 }
 
-void dma_m2m_write_memory(void) {
+/* Copy the current descriptor of the write channel and schedule its
+ * completion. If the read channel ends first, the last burst is written
+ * again until the write channel is full, this is done burst by burst. */
+static void dma_m2m_copy(void) {
+    uint32_t start = dma[CHANNEL_R2M].next;
+    uint32_t size, src, dst;
+    uint8_t *from, *to;
     
-    if (dma[CHANNEL_R2M].next<dma[CHANNEL_R2M].limit) {
-
-        if (dma[CHANNEL_M2R].next<dma[CHANNEL_M2R].limit) {
-            /* (Re)fill the buffer, if there is still data to read */
-            m2m_buffer_size = 0;
-
-            TRY(prb) {
-                while (m2m_buffer_size < DMA_BURST_SIZE) {
-                    m2m_buffer[m2m_buffer_size]=get_byte(dma[CHANNEL_M2R].next);
-                    m2m_buffer_size++;
-                    dma[CHANNEL_M2R].next++;
-                }
-            } CATCH(prb) {
-                Log_Printf(LOG_WARN, "[DMA] Channel M2M: Bus error while reading from %08x",dma[CHANNEL_M2R].next);
-                dma[CHANNEL_M2R].csr &= ~DMA_ENABLE;
-                dma[CHANNEL_M2R].csr |= (DMA_COMPLETE|DMA_BUSEXC);
-            } ENDTRY
-            
-            dma_interrupt(CHANNEL_M2R);
+    if (!(dma[CHANNEL_M2R].csr&DMA_ENABLE) ||
+        dma[CHANNEL_M2R].limit-dma[CHANNEL_M2R].next < dma[CHANNEL_R2M].limit-dma[CHANNEL_R2M].next) {
+        dma_m2m_write_memory();
+        CycInt_AddRelativeInterruptCycles(4, INTERRUPT_M2M_IO);
+        return;
+    }
+    
+    while (dma[CHANNEL_R2M].next<dma[CHANNEL_R2M].limit &&
+           (dma[CHANNEL_R2M].csr&DMA_ENABLE) && (dma[CHANNEL_M2R].csr&DMA_ENABLE)) {
+        src  = dma[CHANNEL_M2R].next;
+        dst  = dma[CHANNEL_R2M].next;
+        size = dma[CHANNEL_R2M].limit-dst;
+        if (size > 0x10000-(src&0xffff)) {
+            size = 0x10000-(src&0xffff);
+        }
+        if (size > 0x10000-(dst&0xffff)) {
+            size = 0x10000-(dst&0xffff);
+        }
+        if ((from = phys_host_read(src, size)) && (to = phys_host_write(dst, size))) {
+            memmove(to, from, size);
+            dma[CHANNEL_M2R].next += size;
+            dma[CHANNEL_R2M].next += size;
         } else {
-            /* Re-use data in buffer */
-            m2m_buffer_size = DMA_BURST_SIZE;
+            dma_m2m_burst();
         }
-        
+    }
+    
+    m2m_busy = true;
+    size = (dma[CHANNEL_R2M].next-start)/DMA_BURST_SIZE;
+    CycInt_AddRelativeInterruptCycles((size>0?size:1)*4, INTERRUPT_M2M_IO);
+}
+
+/* Copy one burst through the channel buffer */
+static void dma_m2m_burst(void) {
+    if (dma[CHANNEL_M2R].next<dma[CHANNEL_M2R].limit) {
+        /* (Re)fill the buffer, if there is still data to read */
+        m2m_buffer_size = 0;
+
         TRY(prb) {
-            /* Write the contents of the buffer to memory */
-            while (m2m_buffer_size > 0) {
-                put_byte(dma[CHANNEL_R2M].next, m2m_buffer[DMA_BURST_SIZE-m2m_buffer_size]);
-                m2m_buffer_size--;
-                dma[CHANNEL_R2M].next++;
+            /* NeXTbus memory is read with one block transfer */
+            if (nextbus_copy_in(dma[CHANNEL_M2R].next, DMA_BURST_SIZE, m2m_buffer)) {
+                m2m_buffer_size = DMA_BURST_SIZE;
+                dma[CHANNEL_M2R].next += DMA_BURST_SIZE;
+            }
+            if (m2m_buffer_size < DMA_BURST_SIZE) {
+                dma_copy_in(CHANNEL_M2R, m2m_buffer, DMA_BURST_SIZE);
+                m2m_buffer_size = DMA_BURST_SIZE;
             }
         } CATCH(prb) {
-            Log_Printf(LOG_WARN, "[DMA] Channel M2M: Bus error while writing to %08x",dma[CHANNEL_R2M].next);
-            dma[CHANNEL_R2M].csr &= ~DMA_ENABLE;
-            dma[CHANNEL_R2M].csr |= (DMA_COMPLETE|DMA_BUSEXC);
+            Log_Printf(LOG_WARN, "[DMA] Channel M2M: Bus error while reading from %08x",dma[CHANNEL_M2R].next);
+            dma[CHANNEL_M2R].csr &= ~DMA_ENABLE;
+            dma[CHANNEL_M2R].csr |= (DMA_COMPLETE|DMA_BUSEXC);
         } ENDTRY
+        
+        dma_interrupt(CHANNEL_M2R);
+    } else {
+        /* Re-use data in buffer */
+        m2m_buffer_size = DMA_BURST_SIZE;
+    }
+    
+    TRY(prb) {
+        /* Write the contents of the buffer to memory */
+        if (m2m_buffer_size == DMA_BURST_SIZE &&
+            nextbus_copy_out(dma[CHANNEL_R2M].next, DMA_BURST_SIZE, m2m_buffer)) {
+            m2m_buffer_size = 0;
+            dma[CHANNEL_R2M].next += DMA_BURST_SIZE;
+        }
+        if (m2m_buffer_size > 0) {
+            dma_copy_out(CHANNEL_R2M, m2m_buffer, DMA_BURST_SIZE);
+            m2m_buffer_size = 0;
+        }
+    } CATCH(prb) {
+        Log_Printf(LOG_WARN, "[DMA] Channel M2M: Bus error while writing to %08x",dma[CHANNEL_R2M].next);
+        dma[CHANNEL_R2M].csr &= ~DMA_ENABLE;
+        dma[CHANNEL_R2M].csr |= (DMA_COMPLETE|DMA_BUSEXC);
+    } ENDTRY
+}
+
+void dma_m2m_write_memory(void) {
+    if (dma[CHANNEL_R2M].next<dma[CHANNEL_R2M].limit) {
+        dma_m2m_burst();
     }
     
     dma_interrupt(CHANNEL_R2M);
@@ -1235,4 +1470,5 @@ void DMA_Reset(void) {
         dma_initialize_buffer(i, 0);
     }
     CycInt_RemovePendingInterrupt(INTERRUPT_M2M_IO);
+    m2m_busy = false;
 }
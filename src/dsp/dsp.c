@@ -21,6 +21,7 @@
 */
 
 #include <ctype.h>
+#include <inttypes.h>
 
 #include "main.h"
 #include "sysdeps.h"
@@ -31,6 +32,8 @@
 #include "m68000.h"
 #include "sysReg.h"
 #include "dma.h"
+#include "host.h"
+#include "coproc.h"
 
 #if ENABLE_DSP_EMU
 #include "debugdsp.h"
@@ -66,6 +69,45 @@ static const char* x_ext_memory_addr_name[] = {
 };
 
 static int32_t save_cycles;
+
+/* The DSP runs in batches of up to DSP_QUANTUM_MAX 68k cycles as long as
+ * the 68k does not talk to it. Host port accesses, DMA and pending DSP
+ * interrupts switch back to running it after every 68k instruction. */
+#define DSP_QUANTUM_MAX  128
+
+int32_t DSP_BatchCycles;
+int32_t DSP_Quantum;
+static bool dsp_host_access;
+
+/* Threaded DSP. The DSP thread owns dsp_core while it runs. The 68k posts
+ * host port writes, TRXL read side effects and IRQB to a single producer,
+ * single consumer queue, which the DSP thread applies between instructions.
+ * The DSP thread publishes the 8 host port bytes after each slice. A 68k
+ * read first waits until all posted operations are applied, so the 68k
+ * always sees the results of its own writes. HREQ and DMA are handled on
+ * the 68k thread from the published bytes. Reset, start and memory changes
+ * stop the thread and restart it afterwards. */
+#define DSP_THREAD_SLICE       64    /* DSP cycles run between queue checks */
+#define DSP_HOST_QUEUE_SIZE    1024  /* power of 2 */
+
+#define MSG_DSP_HOST   0x01
+#define MSG_DSP_KILL   0x02
+
+enum {
+	DSP_OP_WRITE,
+	DSP_OP_READ_TRXL,
+	DSP_OP_IRQB
+};
+
+static COPROC     dsp_coproc;
+static bool       dsp_threaded;
+static uint32_t   dsp_host_queue[DSP_HOST_QUEUE_SIZE];
+static atomic_int dsp_host_posted;     /* written by the 68k */
+static atomic_int dsp_host_done;       /* written by the DSP thread */
+static atomic_int dsp_host_regs[2];    /* ICR CVR ISR IVR, RX0 RXH RXM RXL */
+static uint32_t   dsp_host_applied;    /* DSP thread copy of dsp_host_done */
+static uint32_t   dsp_host_shadow[2];  /* DSP thread copy of dsp_host_regs */
+static int        dsp_hreq_state;      /* HREQ and DMA mode last seen by the 68k */
 #endif
 
 static bool bDspDebugging;
@@ -95,9 +137,9 @@ void DSP_HandleTXD(int set) {
  * Handle HREQ at the host CPU.
  */
 #if ENABLE_DSP_EMU
-static void DSP_HandleHREQ(int set)
+static void dsp_update_hreq(int set, int dma_mode)
 {
-	if (dsp_core.dma_mode) {
+	if (dma_mode) {
 		dsp_hreq_intr = 0;
 		if (set) {
 			dsp_core.dma_request = 1;
@@ -116,6 +158,206 @@ static void DSP_HandleHREQ(int set)
 	}
 	scr_check_dsp_interrupt();
 }
+
+static void DSP_HandleHREQ(int set)
+{
+	/* The threaded DSP leaves this to dsp_thread_update_hreq() */
+	if (!dsp_threaded) {
+		dsp_update_hreq(set, dsp_core.dma_mode);
+	}
+}
+#endif
+
+
+/**
+ * Threaded DSP: host port queue and DSP thread
+ */
+#if ENABLE_DSP_EMU
+static void dsp_thread_update_hreq(void);
+
+/* Called on the 68k thread */
+static void dsp_host_post(int op, int addr, uint8_t value)
+{
+	uint32_t posted = host_atomic_get(&dsp_host_posted);
+	int spins = 0;
+
+	while (posted - (uint32_t)host_atomic_get(&dsp_host_done) >= DSP_HOST_QUEUE_SIZE) {
+		if (++spins > 4096) {
+			host_sleep_us(10);
+		}
+	}
+	dsp_host_queue[posted & (DSP_HOST_QUEUE_SIZE-1)] = (op<<16) | (addr<<8) | value;
+	host_atomic_set(&dsp_host_posted, posted + 1);
+	CoProc_Send(&dsp_coproc, MSG_DSP_HOST, 0);
+}
+
+static bool dsp_host_idle(void)
+{
+	return host_atomic_get(&dsp_host_done) == host_atomic_get(&dsp_host_posted);
+}
+
+/* Called on the 68k thread, waits until all posted operations are applied */
+static void dsp_host_sync(void)
+{
+	int spins = 0;
+
+	while (!dsp_host_idle() && !bQuitProgram) {
+		if (++spins > 4096) {
+			host_sleep_us(10);
+		}
+	}
+}
+
+static uint8_t dsp_host_read(int addr)
+{
+	uint8_t value;
+
+	if (!dsp_threaded) {
+		return dsp_core_read_host(addr);
+	}
+	dsp_host_sync();
+	dsp_thread_update_hreq();
+	value = host_atomic_get(&dsp_host_regs[addr>>2]) >> ((addr&3)*8);
+	if (addr == CPU_HOST_TRXL) {
+		dsp_host_post(DSP_OP_READ_TRXL, addr, 0);
+	}
+	return value;
+}
+
+static void dsp_host_write(int addr, uint8_t value)
+{
+	if (!dsp_threaded) {
+		dsp_core_write_host(addr, value);
+		return;
+	}
+	dsp_host_post(DSP_OP_WRITE, addr, value);
+}
+
+/* Called on the DSP thread */
+static void dsp_thread_publish(void)
+{
+	uint32_t regs;
+	int i;
+
+	/* RX bytes first, so RXDF is never seen before its data */
+	for (i = 1; i >= 0; i--) {
+		regs  = dsp_core.hostport[i*4+0];
+		regs |= dsp_core.hostport[i*4+1] << 8;
+		regs |= dsp_core.hostport[i*4+2] << 16;
+		regs |= (uint32_t)dsp_core.hostport[i*4+3] << 24;
+		if (regs != dsp_host_shadow[i]) {
+			dsp_host_shadow[i] = regs;
+			host_atomic_set(&dsp_host_regs[i], regs);
+		}
+	}
+}
+
+/* Called on the DSP thread, applies all posted operations */
+static void dsp_thread_drain(void)
+{
+	uint32_t posted = host_atomic_get(&dsp_host_posted);
+	uint32_t op;
+
+	if (posted == dsp_host_applied) {
+		return;
+	}
+	while (dsp_host_applied != posted) {
+		op = dsp_host_queue[dsp_host_applied & (DSP_HOST_QUEUE_SIZE-1)];
+		switch (op >> 16) {
+			case DSP_OP_WRITE:
+				dsp_core_write_host((op>>8) & 0xff, op & 0xff);
+				break;
+			case DSP_OP_READ_TRXL:
+				dsp_core_read_host(CPU_HOST_TRXL);
+				break;
+			case DSP_OP_IRQB:
+				dsp_set_interrupt(DSP_INTER_IRQB, 1);
+				break;
+		}
+		dsp_host_applied++;
+	}
+	dsp_thread_publish();
+	host_atomic_set(&dsp_host_done, dsp_host_applied);
+}
+
+static int DSP_Thread(void *data)
+{
+	int msg, cycles;
+
+	for (;;) {
+		msg = CoProc_Receive(&dsp_coproc);
+		dsp_thread_drain();
+		if (msg & MSG_DSP_KILL) {
+			break;
+		}
+
+		/* Sleep until the host port is written while the DSP waits for its bootstrap code
+		 * or spins in an idle loop */
+		if (!dsp_core.running || dsp_core.idle) {
+			cycles = CoProc_Credit(&dsp_coproc);
+			if (dsp_core.running && cycles > 0) {
+				dsp56k_stats_skip(cycles);
+			}
+			CoProc_Discard(&dsp_coproc);
+			CoProc_Idle(&dsp_coproc);
+			continue;
+		}
+
+		if (CoProc_Credit(&dsp_coproc) > 0) {
+			for (cycles = 0; cycles < DSP_THREAD_SLICE && !dsp_core.idle; cycles += dsp_core.instr_cycle) {
+				dsp56k_execute_instruction();
+			}
+			dsp_thread_publish();
+			CoProc_Take(&dsp_coproc, cycles);
+		} else {
+			dsp_stats.waits++;
+			CoProc_Wait(&dsp_coproc, 1);
+		}
+	}
+	return 0;
+}
+
+/* Called on the 68k thread, HREQ follows the published ISR and ICR */
+static void dsp_thread_update_hreq(void)
+{
+	uint32_t regs = host_atomic_get(&dsp_host_regs[0]);
+	int hreq = (regs >> (CPU_HOST_ISR*8 + CPU_HOST_ISR_HREQ)) & 1;
+	int dma_mode = (regs >> (CPU_HOST_ICR*8 + CPU_HOST_ICR_HM0)) & 3;
+
+	if ((hreq | (dma_mode<<1)) != dsp_hreq_state) {
+		dsp_hreq_state = hreq | (dma_mode<<1);
+		dsp_update_hreq(hreq, dma_mode);
+	}
+}
+
+static void dsp_thread_start(void)
+{
+	if (!ConfigureParams.System.bDSPThread || !bDspEmulated || dsp_threaded) {
+		return;
+	}
+	host_atomic_set(&dsp_host_posted, 0);
+	host_atomic_set(&dsp_host_done, 0);
+	dsp_host_applied = 0;
+	dsp_host_shadow[0] = dsp_host_shadow[1] = 0xffffffff;
+	dsp_thread_publish();
+	dsp_hreq_state = ((dsp_core.hostport[CPU_HOST_ISR] >> CPU_HOST_ISR_HREQ) & 1) | (dsp_core.dma_mode<<1);
+
+	dsp_threaded = true;
+	/* Let the DSP lag behind by at most nThreadSkew microseconds */
+	CoProc_Start(&dsp_coproc, DSP_Thread, "[Previous] DSP", NULL,
+	             ConfigureParams.System.nThreadSkew * ConfigureParams.System.nCpuFreq * 2);
+}
+
+/* Returns true if the thread was running */
+static bool dsp_thread_stop(void)
+{
+	if (!dsp_threaded) {
+		return false;
+	}
+	CoProc_Stop(&dsp_coproc, MSG_DSP_KILL);
+	dsp_threaded = false;
+	return true;
+}
 #endif
 
 
@@ -126,7 +368,11 @@ void DSP_SetIRQB(void)
 {
 #if ENABLE_DSP_EMU
 	if (dsp_intr_at_block_end) {
-		dsp_set_interrupt(DSP_INTER_IRQB, 1);
+		if (dsp_threaded) {
+			dsp_host_post(DSP_OP_IRQB, 0, 0);
+		} else {
+			dsp_set_interrupt(DSP_INTER_IRQB, 1);
+		}
 	}
 #endif
 }
@@ -138,6 +384,10 @@ void DSP_SetIRQB(void)
 #if ENABLE_DSP_EMU
 static void DSP_HandleDMA(void)
 {
+	/* The threaded DSP must have seen all previous host port accesses */
+	if (dsp_threaded && !dsp_host_idle()) {
+		return;
+	}
 	if (dsp_core.dma_mode && dsp_core.dma_request && dma_dsp_ready()) {
 		/* Set the counter according to selected DMA mode */
 		if (dsp_core.dma_address_counter==0) {
@@ -151,17 +401,17 @@ static void DSP_HandleDMA(void)
 		
 		/* Read or write via DMA */
 		if (dsp_core.dma_direction==(1<<CPU_HOST_ICR_TREQ)) {
-			dsp_core_write_host(CPU_HOST_TRXL-dsp_core.dma_address_counter, dma_dsp_read_memory());
+			dsp_host_write(CPU_HOST_TRXL-dsp_core.dma_address_counter, dma_dsp_read_memory());
 		} else {
-			dma_dsp_write_memory(dsp_core_read_host(CPU_HOST_TRXL-dsp_core.dma_address_counter));
+			dma_dsp_write_memory(dsp_host_read(CPU_HOST_TRXL-dsp_core.dma_address_counter));
 		}
 		
 		/* Handle unpacked mode on non-Turbo systems */
 		if (dsp_dma_unpacked && dsp_core.dma_address_counter==0 && !ConfigureParams.System.bTurbo) {
 			if (dsp_core.dma_direction==(1<<CPU_HOST_ICR_TREQ)) {
-				dsp_core_write_host(CPU_HOST_TRX0, dma_dsp_read_memory());
+				dsp_host_write(CPU_HOST_TRX0, dma_dsp_read_memory());
 			} else {
-				dma_dsp_write_memory(dsp_core_read_host(CPU_HOST_TRX0));
+				dma_dsp_write_memory(dsp_host_read(CPU_HOST_TRX0));
 			}
 			return;
 		}
@@ -180,6 +430,7 @@ void DSP_Init(void)
 		return;
 	dsp_core_init(DSP_HandleHREQ);
 	dsp56k_init_cpu();
+	CoProc_Init(&dsp_coproc);
 	bDspEnabled = true;
 	save_cycles = 0;
 #endif
@@ -194,6 +445,7 @@ void DSP_UnInit(void)
 #if ENABLE_DSP_EMU
 	if (!bDspEnabled)
 		return;
+	dsp_thread_stop();
 	dsp_core_shutdown();
 	bDspEnabled = false;
 #endif
@@ -215,8 +467,12 @@ void DSP_Reset(void)
 	Statusbar_SetDspLed(false);
 	dsp_txdn_intr = 0;
 
+	dsp_thread_stop();
 	dsp_core_reset();
 	save_cycles = 0;
+	DSP_BatchCycles = 0;
+	DSP_Quantum = 0;
+	dsp_thread_start();
 #endif
 }
 
@@ -227,11 +483,16 @@ void DSP_Reset(void)
 void DSP_EnableMemory(void)
 {
 #if ENABLE_DSP_EMU
+	bool threaded = dsp_thread_stop();
+
 	if (ConfigureParams.System.bDSPMemoryExpansion) {
 		dsp_core_config_ramext(dsp_ram, DSP_RAMSIZE_96kB);
 	} else {
 		dsp_core_config_ramext(dsp_ram, DSP_RAMSIZE_24kB);
 	}
+	if (threaded) {
+		dsp_thread_start();
+	}
 #endif
 }
 
@@ -242,7 +503,24 @@ void DSP_EnableMemory(void)
 void DSP_DisableMemory(void)
 {
 #if ENABLE_DSP_EMU
+	bool threaded = dsp_thread_stop();
+
 	dsp_core_config_ramext(NULL, 0);
+	if (threaded) {
+		dsp_thread_start();
+	}
+#endif
+}
+
+
+/**
+ * Apply changed DSP thread settings without a reset
+ */
+void DSP_SetThreading(void)
+{
+#if ENABLE_DSP_EMU
+	dsp_thread_stop();
+	dsp_thread_start();
 #endif
 }
 
@@ -256,12 +534,19 @@ void DSP_Start(uint8_t mode)
 		return;
 	}
 #if ENABLE_DSP_EMU
+	bool threaded = dsp_thread_stop();
+
 	if (ConfigureParams.System.nDSPType==DSP_TYPE_ACCURATE) {
 		dsp_core_start(mode, 1);
 	} else if (ConfigureParams.System.nDSPType==DSP_TYPE_EMU) {
 		dsp_core_start(mode, 0);
 	}
 	save_cycles = 0;
+	DSP_BatchCycles = 0;
+	DSP_Quantum = 0;
+	if (threaded) {
+		dsp_thread_start();
+	}
 #endif
 }
 
@@ -271,18 +556,102 @@ void DSP_Start(uint8_t mode)
 void DSP_Run(int nHostCycles)
 {
 #if ENABLE_DSP_EMU
-	save_cycles += nHostCycles * 2;
-	
-	while (save_cycles > 0)
-	{
-		dsp56k_execute_instruction();
-		save_cycles -= dsp_core.instr_cycle;
+	if (dsp_threaded) {
+		CoProc_Grant(&dsp_coproc, (nHostCycles + DSP_BatchCycles) * 2);
+		DSP_BatchCycles = 0;
+		dsp_thread_update_hreq();
+	} else {
+		save_cycles += (nHostCycles + DSP_BatchCycles) * 2;
+		DSP_BatchCycles = 0;
+
+		while (save_cycles > 0)
+		{
+			/* Idle loop, the cycles can be skipped in one go */
+			if (dsp_core.idle) {
+				dsp56k_stats_skip(save_cycles);
+				save_cycles = 0;
+				break;
+			}
+			dsp56k_execute_instruction();
+			save_cycles -= dsp_core.instr_cycle;
+		}
 	}
 	
 	DSP_HandleDMA();
+
+	/* Adapt the batch size */
+	if (dsp_host_access || dsp_core.dma_request || dsp_hreq_intr || dsp_txdn_intr) {
+		dsp_host_access = false;
+		DSP_Quantum = 0;
+	} else if (DSP_Quantum < DSP_QUANTUM_MAX) {
+		DSP_Quantum = DSP_Quantum ? DSP_Quantum * 2 : 8;
+	}
 #endif
 }
 
+/**
+ * Copy the running counter totals and the busiest routines. Counters are
+ * written by the DSP thread without locking, a snapshot may be off by a
+ * few counts.
+ */
+bool DSP_Stats(DSP_STATS* stats)
+{
+#if ENABLE_DSP_EMU
+	int i, j;
+	dsp_routine_stats_t r;
+
+	memset(stats, 0, sizeof(*stats));
+	stats->insns       = dsp_stats.insns;
+	stats->cycles      = dsp_stats.cycles;
+	stats->host_stalls = dsp_stats.host_stalls;
+	stats->ssi_stalls  = dsp_stats.ssi_stalls;
+	stats->idle        = dsp_stats.idle;
+	stats->waits       = dsp_stats.waits;
+	stats->stalls      = dsp_coproc.stalls;
+	stats->main_cycles = dsp_stats.main.cycles;
+
+	/* Insert into the sorted list, dropping the least busy */
+	for (i = 0; i < DSP_STATS_ROUTINES; i++) {
+		r = dsp_stats.routine[i];
+		if (r.calls == 0) {
+			continue;
+		}
+		for (j = stats->nroutines; j > 0 && stats->routine[j-1].cycles < r.cycles; j--) {
+			if (j < DSP_STATS_TOP) {
+				stats->routine[j] = stats->routine[j-1];
+			}
+		}
+		if (j < DSP_STATS_TOP) {
+			stats->routine[j].addr   = r.addr;
+			stats->routine[j].calls  = r.calls;
+			stats->routine[j].cycles = r.cycles;
+			if (stats->nroutines < DSP_STATS_TOP) {
+				stats->nroutines++;
+			}
+		}
+	}
+	return true;
+#else
+	memset(stats, 0, sizeof(*stats));
+	return false;
+#endif
+}
+
+/**
+ * Bring the DSP up to date with the 68k before a host port access
+ */
+#if ENABLE_DSP_EMU
+static void DSP_Sync(void)
+{
+	dsp_host_access = true;
+	if (dsp_core.running && DSP_BatchCycles > 0) {
+		DSP_Run(0);
+	} else {
+		DSP_Quantum = 0;
+	}
+}
+#endif
+
 /**
  * Enable/disable DSP debugging mode
  */
@@ -522,6 +891,7 @@ void DSP_Info(FILE *fp, uint32_t dummy)
 #if ENABLE_DSP_EMU
 	int i, j;
 	const char *stackname[] = { "SSH", "SSL" };
+	DSP_STATS stats;
 
 	fputs("\nDSP core information:\n", fp);
 
@@ -556,6 +926,18 @@ void DSP_Info(FILE *fp, uint32_t dummy)
 		fprintf(fp, " %02x", dsp_core.hostport[i]);
 	}
 	fputs("\n", fp);
+
+	DSP_Stats(&stats);
+	fprintf(fp, "\nStatistics:\n");
+	fprintf(fp, "  instructions: %" PRIu64 ", cycles: %" PRIu64 "\n", stats.insns, stats.cycles);
+	fprintf(fp, "  stalls: host %" PRIu64 ", ssi %" PRIu64 ", idle %" PRIu64 " cycles\n",
+	        stats.host_stalls, stats.ssi_stalls, stats.idle);
+	fprintf(fp, "  thread: %" PRIu64 " waits, %" PRIu64 " host stalls\n", stats.waits, stats.stalls);
+	fprintf(fp, "  main: %" PRIu64 " cycles\n", stats.main_cycles);
+	for (i = 0; i < stats.nroutines; i++) {
+		fprintf(fp, "  p:%04hx: %" PRIu64 " cycles, %" PRIu64 " calls\n",
+		        stats.routine[i].addr, stats.routine[i].cycles, stats.routine[i].calls);
+	}
 #endif
 }
 
@@ -750,6 +1132,9 @@ bool DSP_Disasm_SetRegister(const char *arg, uint32_t value)
 	uint32_t *addr, mask, sp_value;
 	int bits;
 
+	/* Leave a possible idle loop */
+	dsp_core.idle = 0;
+
 	/* first check registers needing special handling... */
 	if (arg[0]=='S' || arg[0]=='s') {
 		if (arg[1]=='P' || arg[1]=='p') {
@@ -904,9 +1289,10 @@ void DSP_SsiTransmit_SCK(void)
 
 void DSP_ICR_Read(void) { // 0x02008000
 #if ENABLE_DSP_EMU
-	if (bDspEmulated)
-		IoMem_WriteByte(IoAccessCurrentAddress, dsp_core_read_host(CPU_HOST_ICR));
-	else
+	if (bDspEmulated) {
+		DSP_Sync();
+		IoMem_WriteByte(IoAccessCurrentAddress, dsp_host_read(CPU_HOST_ICR));
+	} else
 #endif
 		IoMem_WriteByte(IoAccessCurrentAddress, 0x7F);
 	Log_Printf(LOG_DSP_REG_LEVEL,"[DSP] ICR read at $%08x val=$%02x PC=$%08x\n", IoAccessCurrentAddress, IoMem_ReadByte(IoAccessCurrentAddress), m68k_getpc());
@@ -914,17 +1300,20 @@ void DSP_ICR_Read(void) { // 0x02008000
 
 void DSP_ICR_Write(void) {
 #if ENABLE_DSP_EMU
-	if (bDspEmulated)
-		dsp_core_write_host(CPU_HOST_ICR, IoMem_ReadByte(IoAccessCurrentAddress));
+	if (bDspEmulated) {
+		DSP_Sync();
+		dsp_host_write(CPU_HOST_ICR, IoMem_ReadByte(IoAccessCurrentAddress));
+	}
 #endif
 	Log_Printf(LOG_DSP_REG_LEVEL,"[DSP] ICR write at $%08x val=$%02x PC=$%08x\n", IoAccessCurrentAddress, IoMem_ReadByte(IoAccessCurrentAddress), m68k_getpc());
 }
 
 void DSP_CVR_Read(void) { // 0x02008001
 #if ENABLE_DSP_EMU
-	if (bDspEmulated)
-		IoMem_WriteByte(IoAccessCurrentAddress, dsp_core_read_host(CPU_HOST_CVR));
-	else
+	if (bDspEmulated) {
+		DSP_Sync();
+		IoMem_WriteByte(IoAccessCurrentAddress, dsp_host_read(CPU_HOST_CVR));
+	} else
 #endif
 		IoMem_WriteByte(IoAccessCurrentAddress, 0xFF);
 	Log_Printf(LOG_DSP_REG_LEVEL,"[DSP] CVR read at $%08x val=$%02x PC=$%08x\n", IoAccessCurrentAddress, IoMem_ReadByte(IoAccessCurrentAddress), m68k_getpc());
@@ -932,17 +1321,20 @@ void DSP_CVR_Read(void) { // 0x02008001
 
 void DSP_CVR_Write(void) {
 #if ENABLE_DSP_EMU
-	if (bDspEmulated)
-		dsp_core_write_host(CPU_HOST_CVR, IoMem_ReadByte(IoAccessCurrentAddress));
+	if (bDspEmulated) {
+		DSP_Sync();
+		dsp_host_write(CPU_HOST_CVR, IoMem_ReadByte(IoAccessCurrentAddress));
+	}
 #endif
 	Log_Printf(LOG_DSP_REG_LEVEL,"[DSP] CVR write at $%08x val=$%02x PC=$%08x\n", IoAccessCurrentAddress, IoMem_ReadByte(IoAccessCurrentAddress), m68k_getpc());
 }
 
 void DSP_ISR_Read(void) { // 0x02008002
 #if ENABLE_DSP_EMU
-	if (bDspEmulated)
-		IoMem_WriteByte(IoAccessCurrentAddress, dsp_core_read_host(CPU_HOST_ISR));
-	else
+	if (bDspEmulated) {
+		DSP_Sync();
+		IoMem_WriteByte(IoAccessCurrentAddress, dsp_host_read(CPU_HOST_ISR));
+	} else
 #endif
 		IoMem_WriteByte(IoAccessCurrentAddress, 0xFF);
 	Log_Printf(LOG_DSP_REG_LEVEL,"[DSP] ISR read at $%08x val=$%02x PC=$%08x\n", IoAccessCurrentAddress, IoMem_ReadByte(IoAccessCurrentAddress), m68k_getpc());
@@ -950,17 +1342,20 @@ void DSP_ISR_Read(void) { // 0x02008002
 
 void DSP_ISR_Write(void) {
 #if ENABLE_DSP_EMU
-	if (bDspEmulated)
-		dsp_core_write_host(CPU_HOST_ISR, IoMem_ReadByte(IoAccessCurrentAddress));
+	if (bDspEmulated) {
+		DSP_Sync();
+		dsp_host_write(CPU_HOST_ISR, IoMem_ReadByte(IoAccessCurrentAddress));
+	}
 #endif
 	Log_Printf(LOG_DSP_REG_LEVEL,"[DSP] ISR write at $%08x val=$%02x PC=$%08x\n", IoAccessCurrentAddress, IoMem_ReadByte(IoAccessCurrentAddress), m68k_getpc());
 }
 
 void DSP_IVR_Read(void) { // 0x02008003
 #if ENABLE_DSP_EMU
-	if (bDspEmulated)
-		IoMem_WriteByte(IoAccessCurrentAddress, dsp_core_read_host(CPU_HOST_IVR));
-	else
+	if (bDspEmulated) {
+		DSP_Sync();
+		IoMem_WriteByte(IoAccessCurrentAddress, dsp_host_read(CPU_HOST_IVR));
+	} else
 #endif
 		IoMem_WriteByte(IoAccessCurrentAddress, 0xFF);
 	Log_Printf(LOG_DSP_REG_LEVEL,"[DSP] IVR read at $%08x val=$%02x PC=$%08x\n", IoAccessCurrentAddress, IoMem_ReadByte(IoAccessCurrentAddress), m68k_getpc());
@@ -968,17 +1363,20 @@ void DSP_IVR_Read(void) { // 0x02008003
 
 void DSP_IVR_Write(void) {
 #if ENABLE_DSP_EMU
-	if (bDspEmulated)
-		dsp_core_write_host(CPU_HOST_IVR, IoMem_ReadByte(IoAccessCurrentAddress));
+	if (bDspEmulated) {
+		DSP_Sync();
+		dsp_host_write(CPU_HOST_IVR, IoMem_ReadByte(IoAccessCurrentAddress));
+	}
 #endif
 	Log_Printf(LOG_DSP_REG_LEVEL,"[DSP] IVR write at $%08x val=$%02x PC=$%08x\n", IoAccessCurrentAddress, IoMem_ReadByte(IoAccessCurrentAddress), m68k_getpc());
 }
 
 void DSP_Data0_Read(void) { // 0x02008004
 #if ENABLE_DSP_EMU
-	if (bDspEmulated)
-		IoMem_WriteByte(IoAccessCurrentAddress, dsp_core_read_host(CPU_HOST_TRX0));
-	else
+	if (bDspEmulated) {
+		DSP_Sync();
+		IoMem_WriteByte(IoAccessCurrentAddress, dsp_host_read(CPU_HOST_TRX0));
+	} else
 #endif
 		IoMem_WriteByte(IoAccessCurrentAddress, 0x00);
 	Log_Printf(LOG_DSP_REG_LEVEL,"[DSP] Data0 read at $%08x val=$%02x PC=$%08x\n", IoAccessCurrentAddress, IoMem_ReadByte(IoAccessCurrentAddress), m68k_getpc());
@@ -986,17 +1384,20 @@ void DSP_Data0_Read(void) { // 0x02008004
 
 void DSP_Data0_Write(void) {
 #if ENABLE_DSP_EMU
-	if (bDspEmulated)
-		dsp_core_write_host(CPU_HOST_TRX0, IoMem_ReadByte(IoAccessCurrentAddress));
+	if (bDspEmulated) {
+		DSP_Sync();
+		dsp_host_write(CPU_HOST_TRX0, IoMem_ReadByte(IoAccessCurrentAddress));
+	}
 #endif
 	Log_Printf(LOG_DSP_REG_LEVEL,"[DSP] Data0 write at $%08x val=$%02x PC=$%08x\n", IoAccessCurrentAddress, IoMem_ReadByte(IoAccessCurrentAddress), m68k_getpc());
 }
 
 void DSP_Data1_Read(void) { // 0x02008005
 #if ENABLE_DSP_EMU
-	if (bDspEmulated)
-		IoMem_WriteByte(IoAccessCurrentAddress, dsp_core_read_host(CPU_HOST_TRXH));
-	else
+	if (bDspEmulated) {
+		DSP_Sync();
+		IoMem_WriteByte(IoAccessCurrentAddress, dsp_host_read(CPU_HOST_TRXH));
+	} else
 #endif
 		IoMem_WriteByte(IoAccessCurrentAddress, 0x00);
 	Log_Printf(LOG_DSP_REG_LEVEL,"[DSP] Data1 read at $%08x val=$%02x PC=$%08x\n", IoAccessCurrentAddress, IoMem_ReadByte(IoAccessCurrentAddress), m68k_getpc());
@@ -1004,17 +1405,20 @@ void DSP_Data1_Read(void) { // 0x02008005
 
 void DSP_Data1_Write(void) {
 #if ENABLE_DSP_EMU
-	if (bDspEmulated)
-		dsp_core_write_host(CPU_HOST_TRXH, IoMem_ReadByte(IoAccessCurrentAddress));
+	if (bDspEmulated) {
+		DSP_Sync();
+		dsp_host_write(CPU_HOST_TRXH, IoMem_ReadByte(IoAccessCurrentAddress));
+	}
 #endif
 	Log_Printf(LOG_DSP_REG_LEVEL,"[DSP] Data1 write at $%08x val=$%02x PC=$%08x\n", IoAccessCurrentAddress, IoMem_ReadByte(IoAccessCurrentAddress), m68k_getpc());
 }
 
 void DSP_Data2_Read(void) { // 0x02008006
 #if ENABLE_DSP_EMU
-	if (bDspEmulated)
-		IoMem_WriteByte(IoAccessCurrentAddress, dsp_core_read_host(CPU_HOST_TRXM));
-	else
+	if (bDspEmulated) {
+		DSP_Sync();
+		IoMem_WriteByte(IoAccessCurrentAddress, dsp_host_read(CPU_HOST_TRXM));
+	} else
 #endif
 		IoMem_WriteByte(IoAccessCurrentAddress, 0x00);
 	Log_Printf(LOG_DSP_REG_LEVEL,"[DSP] Data2 read at $%08x val=$%02x PC=$%08x\n", IoAccessCurrentAddress, IoMem_ReadByte(IoAccessCurrentAddress), m68k_getpc());
@@ -1022,17 +1426,20 @@ void DSP_Data2_Read(void) { // 0x02008006
 
 void DSP_Data2_Write(void) {
 #if ENABLE_DSP_EMU
-	if (bDspEmulated)
-		dsp_core_write_host(CPU_HOST_TRXM, IoMem_ReadByte(IoAccessCurrentAddress));
+	if (bDspEmulated) {
+		DSP_Sync();
+		dsp_host_write(CPU_HOST_TRXM, IoMem_ReadByte(IoAccessCurrentAddress));
+	}
 #endif
 	Log_Printf(LOG_DSP_REG_LEVEL,"[DSP] Data2 write at $%08x val=$%02x PC=$%08x\n", IoAccessCurrentAddress, IoMem_ReadByte(IoAccessCurrentAddress), m68k_getpc());
 }
 
 void DSP_Data3_Read(void) { // 0x02008007
 #if ENABLE_DSP_EMU
-	if (bDspEmulated)
-		IoMem_WriteByte(IoAccessCurrentAddress, dsp_core_read_host(CPU_HOST_TRXL));
-	else
+	if (bDspEmulated) {
+		DSP_Sync();
+		IoMem_WriteByte(IoAccessCurrentAddress, dsp_host_read(CPU_HOST_TRXL));
+	} else
 #endif
 		IoMem_WriteByte(IoAccessCurrentAddress, 0x00);
 	Log_Printf(LOG_DSP_REG_LEVEL,"[DSP] Data3 read at $%08x val=$%02x PC=$%08x\n", IoAccessCurrentAddress, IoMem_ReadByte(IoAccessCurrentAddress), m68k_getpc());
@@ -1040,8 +1447,75 @@ void DSP_Data3_Read(void) { // 0x02008007
 
 void DSP_Data3_Write(void) {
 #if ENABLE_DSP_EMU
-	if (bDspEmulated)
-		dsp_core_write_host(CPU_HOST_TRXL, IoMem_ReadByte(IoAccessCurrentAddress));
+	if (bDspEmulated) {
+		DSP_Sync();
+		dsp_host_write(CPU_HOST_TRXL, IoMem_ReadByte(IoAccessCurrentAddress));
+	}
 #endif
 	Log_Printf(LOG_DSP_REG_LEVEL,"[DSP] Data3 write at $%08x val=$%02x PC=$%08x\n", IoAccessCurrentAddress, IoMem_ReadByte(IoAccessCurrentAddress), m68k_getpc());
 }
+
+/**
+ * Direct access to the host port for polling loops. Registers are accessed
+ * in ascending order, so that word and long accesses behave like a sequence
+ * of byte accesses.
+ */
+static const uint8_t dsp_host_default[8] = { 0x7F, 0xFF, 0xFF, 0xFF, 0x00, 0x00, 0x00, 0x00 };
+
+static uint32_t DSP_Host_Read(uint32_t addr, int size) {
+	uint32_t val = 0;
+	int reg = addr & 7;
+	int end = reg + size;
+
+#if ENABLE_DSP_EMU
+	if (bDspEmulated) {
+		DSP_Sync();
+		for (; reg < end; reg++) {
+			val = (val << 8) | dsp_host_read(reg);
+		}
+		return val;
+	}
+#endif
+	for (; reg < end; reg++) {
+		val = (val << 8) | dsp_host_default[reg];
+	}
+	return val;
+}
+
+static void DSP_Host_Write(uint32_t addr, uint32_t val, int size) {
+#if ENABLE_DSP_EMU
+	int reg = addr & 7;
+	int end = reg + size;
+
+	if (bDspEmulated) {
+		DSP_Sync();
+		for (; reg < end; reg++) {
+			dsp_host_write(reg, val >> ((end - reg - 1) * 8));
+		}
+	}
+#endif
+}
+
+uint32_t DSP_Host_bget(uint32_t addr) {
+	return DSP_Host_Read(addr, SIZE_BYTE);
+}
+
+uint32_t DSP_Host_wget(uint32_t addr) {
+	return DSP_Host_Read(addr, SIZE_WORD);
+}
+
+uint32_t DSP_Host_lget(uint32_t addr) {
+	return DSP_Host_Read(addr, SIZE_LONG);
+}
+
+void DSP_Host_bput(uint32_t addr, uint32_t val) {
+	DSP_Host_Write(addr, val, SIZE_BYTE);
+}
+
+void DSP_Host_wput(uint32_t addr, uint32_t val) {
+	DSP_Host_Write(addr, val, SIZE_WORD);
+}
+
+void DSP_Host_lput(uint32_t addr, uint32_t val) {
+	DSP_Host_Write(addr, val, SIZE_LONG);
+}
@@ -28,6 +28,32 @@
 #endif
 
 extern bool bDspEnabled;
+#if ENABLE_DSP_EMU
+extern int32_t DSP_BatchCycles;
+extern int32_t DSP_Quantum;
+#endif
+
+/* DSP counters, running totals since the last DSP reset */
+#define DSP_STATS_TOP 16
+
+typedef struct {
+	uint16_t addr;          /* subroutine or interrupt vector */
+	uint64_t calls;
+	uint64_t cycles;        /* without stalls */
+} DSP_ROUTINE_STATS;
+
+typedef struct dsp_stats {
+	uint64_t insns;         /* instructions executed */
+	uint64_t cycles;        /* DSP cycles, including stalls */
+	uint64_t host_stalls;   /* cycles spent polling the host port */
+	uint64_t ssi_stalls;    /* cycles spent polling the SSI */
+	uint64_t idle;          /* cycles spent in other idle loops */
+	uint64_t waits;         /* DSP thread ran out of cycles */
+	uint64_t stalls;        /* m68k thread waited for the DSP thread */
+	uint64_t main_cycles;   /* outside of any subroutine */
+	int      nroutines;     /* valid entries in routine[] */
+	DSP_ROUTINE_STATS routine[DSP_STATS_TOP];   /* busiest first */
+} DSP_STATS;
 
 /* Dsp commands */
 extern void DSP_Init(void);
@@ -37,10 +63,13 @@ extern void DSP_Start(uint8_t mode);
 extern void DSP_Run(int nHostCycles);
 extern void DSP_EnableMemory(void);
 extern void DSP_DisableMemory(void);
+extern void DSP_SetThreading(void);
 
 /* Save Dsp state to snapshot */
 extern void DSP_MemorySnapShot_Capture(bool bSave);
 
+extern bool DSP_Stats(DSP_STATS* stats);
+
 /* Dsp Debugger commands */
 extern void DSP_SetDebugging(bool enabled);
 extern uint16_t DSP_GetPC(void);
@@ -91,6 +120,13 @@ extern void DSP_Data2_Write(void);
 extern void DSP_Data3_Read(void);
 extern void DSP_Data3_Write(void);
 
+extern uint32_t DSP_Host_bget(uint32_t addr);
+extern uint32_t DSP_Host_wget(uint32_t addr);
+extern uint32_t DSP_Host_lget(uint32_t addr);
+extern void DSP_Host_bput(uint32_t addr, uint32_t val);
+extern void DSP_Host_wput(uint32_t addr, uint32_t val);
+extern void DSP_Host_lput(uint32_t addr, uint32_t val);
+
 extern void DSP_SetIRQB(void);
 
 /* See statusbar.c */
@@ -627,6 +627,7 @@ void dsp_core_start(uint8_t mode, int bootstrap)
 		dsp_core.pc = 0x0000;
 	}
 	dsp_core.mode_wait = 0;
+	dsp_core.idle = 0;
 
 	/* Start using bootstrap ROM */
 	if (bootstrap) {
@@ -671,6 +672,7 @@ void dsp_core_reset(void)
 	memset(dsp_core.registers, 0, sizeof(dsp_core.registers));
 	dsp_core.dsp_host_rtx = 0;
 	dsp_core.dsp_host_htx = 0;
+	dsp_core.idle = 0;
 
 	dsp_core.bootstrap_pos = 0;
 
@@ -832,6 +834,8 @@ void dsp_core_ssi_Receive_SC0(void)
 {
 	uint32_t value, i, temp=0;
 
+	dsp_core.idle = 0;
+
 	/* Receive data from crossbar to SSI */
 	value = dsp_core.ssi.received_value;
 
@@ -876,6 +880,8 @@ void dsp_core_ssi_Receive_SC0(void)
  */
 void dsp_core_ssi_Receive_SC1(uint32_t value)
 {
+	dsp_core.idle = 0;
+
 	/* SSI runs in network mode ? */
 	if (dsp_core.ssi.crb_mode) {
 		if (value) {
@@ -900,6 +906,8 @@ void dsp_core_ssi_Receive_SC1(uint32_t value)
  */
 void dsp_core_ssi_Receive_SC2(uint32_t value)
 {
+	dsp_core.idle = 0;
+
 	/* SSI runs in network mode ? */
 	if (dsp_core.ssi.crb_mode) {
 		if (value) {
@@ -925,6 +933,8 @@ void dsp_core_ssi_Receive_SCK(void)
 {
 	uint32_t value, i, temp=0;
 
+	dsp_core.idle = 0;
+
 	value = dsp_core.ssi.TX;
 
 	/* Transfer data from SSI to crossbar*/
@@ -1141,6 +1151,8 @@ uint8_t dsp_core_read_host(int addr)
 
 	value = dsp_core.hostport[addr];
 	if (addr == CPU_HOST_TRXL) {
+		dsp_core.idle = 0;
+
 		/* Clear RXDF bit to say that CPU has read */
 		dsp_core.hostport[CPU_HOST_ISR] &= 0xff-(1<<CPU_HOST_ISR_RXDF);
 		dsp_core_dsp2host();
@@ -1153,6 +1165,8 @@ uint8_t dsp_core_read_host(int addr)
 
 void dsp_core_write_host(int addr, uint8_t value)
 {
+	dsp_core.idle = 0;
+
 	switch(addr) {
 		case CPU_HOST_ICR:
 			dsp_core.hostport[CPU_HOST_ICR]=value & 0xfb;
@@ -142,6 +142,11 @@ extern uint32_t DSP_RAMSIZE;
 #define DSP_SSI_SR_TDE		0x6
 #define DSP_SSI_SR_RDF		0x7
 
+/* What an idle loop waits for */
+#define DSP_IDLE_LOOP           0x1
+#define DSP_IDLE_HOST           0x2
+#define DSP_IDLE_SSI            0x3
+
 #define DSP_INTERRUPT_NONE      0x0
 #define DSP_INTERRUPT_DISABLED  0x1
 #define DSP_INTERRUPT_LONG      0x2
@@ -222,6 +227,10 @@ struct dsp_core_s {
 	/* DSP executing instructions ? */
 	int running;
 
+	/* DSP spinning in an idle loop, nothing to do until the host port,
+	 * an interrupt or the SSI changes something. One of DSP_IDLE_* */
+	int idle;
+
 	/* DSP DMA variables */
 	int dma_mode;
 	int dma_direction;
@@ -184,14 +184,48 @@ static char   str_disasm_memory[12][50];
 
 static uint16_t disasm_memory_ptr;		/* Pointer for memory change in disasm mode */
 
+/* Decoded instructions, one entry per P: address */
+/* The entry is only used while the fetched word still matches, so writes to */
+/* P: memory (moves, DMA, bootstrap, X:/Y: aliases of external RAM) need no */
+/* further invalidation */
+typedef struct {
+	uint32_t inst;		/* Instruction word, DSP_DECODE_INVALID if empty */
+	void (*func)(void);	/* Handler with the parallel move type resolved */
+} dsp_decoded_t;
+
+#define DSP_DECODE_INVALID 0xffffffff
+
+static dsp_decoded_t decode_cache[0x10000];
+
+/* Fused REP loops return to DSP_Run after this many DSP cycles */
+#define DSP_REP_BATCH_CYCLES 256
+
+/* State of a fused REP MAC loop, see dsp_pm_8_mac() */
+static int64_t  rep_mac_accu;		/* Accumulator, sign extended from 56 bits */
+static uint32_t rep_mac_accu_reg;	/* 0 for A, 1 for B */
+static uint32_t rep_mac_src1, rep_mac_src2, rep_mac_negate;
+static uint32_t rep_mac_ea1, rep_mac_ea2, rep_mac_dst1, rep_mac_dst2;
+static uint16_t rep_mac_overflow, rep_mac_limited;
+
+/* Always-on statistics, see DSP_Stats() */
+dsp_stats_t dsp_stats;
+
+/* Routine charged for the cycles at each stack level, level 0 is main */
+static dsp_routine_stats_t *stats_level[16];
+
 /**********************************
  *	Functions
  **********************************/
 
 typedef void (*dsp_emul_t)(void);
 
+static void dsp_postexecute_waitstates(void);
+static void dsp_postexecute_agu_pipeline(void);
 static void dsp_postexecute_update_pc(void);
 static void dsp_postexecute_interrupts(void);
+static int dsp_idle_kind(dsp_emul_t func);
+static void dsp_check_idle(int kind);
+static void dsp_stats_update(uint16_t start_pc, uint32_t start_sp, int kind);
 
 static void dsp_setInterruptIPL(uint32_t value);
 
@@ -301,12 +335,17 @@ static int dsp_pm_read_accu24(int numreg, uint32_t *dest);
 static void dsp_pm_0(void);
 static void dsp_pm_1(void);
 static void dsp_pm_2(void);
+static void dsp_pm_2_0(void);
+static void dsp_pm_2_1(void);
 static void dsp_pm_2_2(void);
 static void dsp_pm_3(void);
 static void dsp_pm_4(void);
 static void dsp_pm_4x(void);
 static void dsp_pm_5(void);
 static void dsp_pm_8(void);
+static int dsp_pm_8_mac_init(void);
+static void dsp_pm_8_mac(void);
+static void dsp_pm_8_mac_done(void);
 
 /* 56bits arithmetic */
 static uint16_t dsp_abs56(uint32_t *dest);
@@ -772,8 +811,15 @@ const char *dsp_interrupt_name[32] = {
 
 void dsp56k_init_cpu(void)
 {
+	int i;
+
 	dsp56k_disasm_init();
 	isDsp_in_disasm_mode = false;
+	memset(decode_cache, 0xff, sizeof(decode_cache));
+	memset(&dsp_stats, 0, sizeof(dsp_stats));
+	for (i = 0; i < 16; i++) {
+		stats_level[i] = &dsp_stats.main;
+	}
 #if DSP_COUNT_IPS
 	start_time = SDL_GetTicks();
 	num_inst = 0;
@@ -818,10 +864,88 @@ uint16_t dsp56k_execute_one_disasm_instruction(FILE *out, uint16_t pc)
 	return instruction_length;
 }
 
-void dsp56k_execute_instruction(void)
+/**
+ * Select the handler of an instruction word. Parallel move instructions
+ * are resolved down to the handler of their move type, so the sub-decoding
+ * in dsp_pm_2 and dsp_pm_4 is only done once per P: address.
+ */
+static dsp_emul_t dsp_decode_instruction(uint32_t inst)
 {
 	uint32_t value;
+
+	if (inst < 0x100000) {
+		value = (inst >> 11) & (BITMASK(6) << 3);
+		value += (inst >> 5) & BITMASK(3);
+		return opcodes8h[value];
+	}
+
+	switch ((inst>>20) & BITMASK(4)) {
+		case 2:
+			if ((inst & 0xffff00) == 0x200000)
+				return dsp_pm_2_0;
+			if ((inst & 0xffe000) == 0x204000)
+				return dsp_pm_2_1;
+			if ((inst & 0xfc0000) == 0x200000)
+				return dsp_pm_2_2;
+			return dsp_pm_3;
+		case 4:
+			if ((inst & 0xf40000) == 0x400000)
+				return dsp_pm_4x;
+			return dsp_pm_5;
+		default:
+			return opcodes_parmove[(inst>>20) & BITMASK(4)];
+	}
+}
+
+/**
+ * Run all but the last iteration of a REP loop back to back. REP is not
+ * interruptible and the repeated instruction is fetched only once, so only
+ * the waitstates, the AGU pipeline and LC need updating in between. The
+ * last iteration is left to the caller, which also ends the loop.
+ */
+static void dsp_execute_rep(dsp_emul_t func)
+{
+	uint16_t fetch_access = access_to_ext_memory;
+	uint32_t cycles = 0;
+
+	/* MAC with X:Y: reads into its inputs keeps the accumulator native */
+	if (func == dsp_pm_8 && dsp_pm_8_mac_init()) {
+		func = dsp_pm_8_mac;
+	}
+
+	while (dsp_core.registers[DSP_REG_LC] > 1 && cycles < DSP_REP_BATCH_CYCLES) {
+		access_to_ext_memory = fetch_access;
+		dsp_core.agu_move_indirect_instr = 0;
+		dsp_core.instr_cycle = 2;
+		cur_inst_len = 1;
+
+		func();
+
+		dsp_postexecute_waitstates();
+		dsp_postexecute_agu_pipeline();
+
+		cycles += dsp_core.instr_cycle;
+		--dsp_core.registers[DSP_REG_LC];
+	}
+
+	if (func == dsp_pm_8_mac) {
+		dsp_pm_8_mac_done();
+	}
+
+	/* Prepare the last iteration */
+	access_to_ext_memory = fetch_access;
+	dsp_core.agu_move_indirect_instr = 0;
+	dsp_core.instr_cycle = cycles + 2;
+	cur_inst_len = 1;
+}
+
+void dsp56k_execute_instruction(void)
+{
+	dsp_decoded_t *decoded;
 	uint32_t disasm_return = 0;
+	uint16_t start_pc = dsp_core.pc;
+	uint32_t start_sp = dsp_core.registers[DSP_REG_SP] & BITMASK(4);
+	int idle_kind = 0;
 	disasm_memory_ptr = 0;
 
 	/* Initialise the number of access to the external memory for this instruction */
@@ -864,34 +988,27 @@ void dsp56k_execute_instruction(void)
 		}
 	}
 
-	if (cur_inst < 0x100000) {
-		value = (cur_inst >> 11) & (BITMASK(6) << 3);
-		value += (cur_inst >> 5) & BITMASK(3);
-		opcodes8h[value]();
-	} else {
-		/* Do parallel move read */
-		opcodes_parmove[(cur_inst>>20) & BITMASK(4)]();
+	decoded = &decode_cache[dsp_core.pc];
+	if (decoded->inst != cur_inst) {
+		decoded->inst = cur_inst;
+		decoded->func = dsp_decode_instruction(cur_inst);
 	}
 
-	/* Add the waitstate due to external memory access */
-	/* (2 extra cycles per extra access to the external memory after the first one */
-	if (access_to_ext_memory != 0) {
-		value  = (access_to_ext_memory >> DSP_SPACE_X) & 1;
-		value += (access_to_ext_memory >> DSP_SPACE_Y) & 1;
-		value += (access_to_ext_memory >> DSP_SPACE_P) & 1;
-
-		if (value > 1)
-			dsp_core.instr_cycle += (value - 1) * 2;
+	/* Repeated instruction ? (not while tracing or debugging) */
+	if (dsp_core.loop_rep && dsp_core.pc_on_rep == 0 &&
+	    dsp_core.registers[DSP_REG_LC] > 1 && dsp_core.mode_wait == 0 &&
+	    isDsp_in_disasm_mode == false && !LOG_TRACE_LEVEL(TRACE_DSP_DISASM) &&
+	    !(dsp_core.registers[DSP_REG_SR] & (1<<DSP_SR_T))) {
+		dsp_execute_rep(decoded->func);
 	}
 
-	/* Process the AGU pipeline */
-	dsp_core.agu_pipeline_reg[0] = 0;
+	decoded->func();
 
-	if (dsp_core.agu_pipeline_reg[1] != 0 ) {
-		dsp_core.agu_pipeline_reg[0] = dsp_core.agu_pipeline_reg[1];
-		dsp_core.agu_pipeline_val[0] = dsp_core.agu_pipeline_val[1];
-		dsp_core.agu_pipeline_reg[1] = 0;
-	}
+	/* Add the waitstate due to external memory access */
+	dsp_postexecute_waitstates();
+
+	/* Process the AGU pipeline */
+	dsp_postexecute_agu_pipeline();
 
 	/* Process the PC */
 	dsp_postexecute_update_pc();
@@ -899,6 +1016,15 @@ void dsp56k_execute_instruction(void)
 	/* Process Interrupts */
 	dsp_postexecute_interrupts();
 
+	/* Jump to itself ? */
+	if (dsp_core.pc == start_pc) {
+		idle_kind = dsp_idle_kind(decoded->func);
+		dsp_check_idle(idle_kind);
+	}
+
+	if (!isDsp_in_disasm_mode) {
+		dsp_stats_update(start_pc, start_sp, idle_kind);
+	}
 
 	/* Disasm current instruction ? (trace mode only) */
 	if (LOG_TRACE_LEVEL(TRACE_DSP_DISASM)) {
@@ -941,10 +1067,171 @@ void dsp56k_execute_instruction(void)
 #endif
 }
 
+/**********************************
+ *	Waitstates and AGU pipeline
+**********************************/
+
+static void dsp_postexecute_waitstates(void)
+{
+	uint32_t value;
+
+	/* 2 extra cycles per extra access to the external memory after the first one */
+	if (access_to_ext_memory != 0) {
+		value  = (access_to_ext_memory >> DSP_SPACE_X) & 1;
+		value += (access_to_ext_memory >> DSP_SPACE_Y) & 1;
+		value += (access_to_ext_memory >> DSP_SPACE_P) & 1;
+
+		if (value > 1)
+			dsp_core.instr_cycle += (value - 1) * 2;
+	}
+}
+
+static void dsp_postexecute_agu_pipeline(void)
+{
+	dsp_core.agu_pipeline_reg[0] = 0;
+
+	if (dsp_core.agu_pipeline_reg[1] != 0 ) {
+		dsp_core.agu_pipeline_reg[0] = dsp_core.agu_pipeline_reg[1];
+		dsp_core.agu_pipeline_val[0] = dsp_core.agu_pipeline_val[1];
+		dsp_core.agu_pipeline_reg[1] = 0;
+	}
+}
+
 /**********************************
  *	Update the PC
 **********************************/
 
+/**********************************
+ *	Idle loop detection
+ **********************************/
+
+/* What an instruction that jumps to itself waits for, 0 if it changes
+ * some state and is no idle loop */
+static int dsp_idle_kind(dsp_emul_t func)
+{
+	uint32_t addr;
+
+	if (func == dsp_jmp_imm) {
+		return DSP_IDLE_LOOP;
+	}
+	if (func == dsp_jmp_ea) {
+		/* Absolute address only, register modes update Rn */
+		return ((cur_inst>>8) & BITMASK(6)) == 0x30 ? DSP_IDLE_LOOP : 0;
+	}
+	if (func == dsp_jclr_pp || func == dsp_jset_pp) {
+		/* Reading the receive registers has side effects */
+		addr = (cur_inst>>8) & BITMASK(6);
+		if (addr == DSP_HOST_HRX || addr == DSP_SSI_RX) {
+			return 0;
+		}
+		if (addr >= DSP_HOST_HCR && addr <= DSP_HOST_HTX) {
+			return DSP_IDLE_HOST;
+		}
+		if (addr >= DSP_SSI_CRA && addr <= DSP_SSI_TX) {
+			return DSP_IDLE_SSI;
+		}
+		return DSP_IDLE_LOOP;
+	}
+	return 0;
+}
+
+/* An idle loop can only be left after the host port, an interrupt or the
+ * SSI changed something. Stop stepping until then, see dsp_core.idle. */
+static void dsp_check_idle(int kind)
+{
+	if (kind == 0 || dsp_core.loop_rep || dsp_core.interrupt_state == DSP_INTERRUPT_DISABLED ||
+	    (dsp_core.registers[DSP_REG_SR] & ((1<<DSP_SR_T)|(1<<DSP_SR_LF))) ||
+	    dsp_core.mode_wait > 0 || isDsp_in_disasm_mode) {
+		return;
+	}
+
+	/* Any pending interrupt that could be taken ends the loop */
+	if (dsp_core.interrupt_status & (DSP_INTER_NMI_MASK |
+	    (dsp_core.interrupt_enable & dsp_core.interrupt_mask))) {
+		return;
+	}
+
+	dsp_core.idle = kind;
+}
+
+/**********************************
+ *	Statistics
+ **********************************/
+
+static dsp_routine_stats_t *dsp_stats_routine(uint16_t addr)
+{
+	uint32_t i, n;
+
+	i = ((addr * 40503U) >> 8) & (DSP_STATS_ROUTINES-1);
+	for (n = 0; n < DSP_STATS_ROUTINES; n++) {
+		if (dsp_stats.routine[i].calls == 0) {
+			dsp_stats.routine[i].addr = addr;
+			return &dsp_stats.routine[i];
+		}
+		if (dsp_stats.routine[i].addr == addr) {
+			return &dsp_stats.routine[i];
+		}
+		i = (i+1) & (DSP_STATS_ROUTINES-1);
+	}
+	return &dsp_stats.other;
+}
+
+/* Routines are entered when the stack grows by one level (JSR, long
+ * interrupt) and left when it shrinks back. DO loops push two levels
+ * and stay in the current routine. */
+static void dsp_stats_update(uint16_t start_pc, uint32_t start_sp, int kind)
+{
+	uint32_t sp, i;
+
+	dsp_stats.insns++;
+	dsp_stats.cycles += dsp_core.instr_cycle;
+
+	if (dsp_core.pc == start_pc && kind) {
+		switch (kind) {
+			case DSP_IDLE_HOST:
+				dsp_stats.host_stalls += dsp_core.instr_cycle;
+				break;
+			case DSP_IDLE_SSI:
+				dsp_stats.ssi_stalls += dsp_core.instr_cycle;
+				break;
+			default:
+				dsp_stats.idle += dsp_core.instr_cycle;
+				break;
+		}
+	} else {
+		stats_level[start_sp]->cycles += dsp_core.instr_cycle;
+	}
+
+	sp = dsp_core.registers[DSP_REG_SP] & BITMASK(4);
+	if (sp == ((start_sp+1) & BITMASK(4))) {
+		stats_level[sp] = dsp_stats_routine(dsp_core.pc);
+		stats_level[sp]->calls++;
+	} else if (sp > start_sp) {
+		for (i = start_sp+1; i <= sp; i++) {
+			stats_level[i] = stats_level[start_sp];
+		}
+	}
+}
+
+/**
+ * Account for cycles skipped while the DSP was idle
+ */
+void dsp56k_stats_skip(uint32_t cycles)
+{
+	dsp_stats.cycles += cycles;
+	switch (dsp_core.idle) {
+		case DSP_IDLE_HOST:
+			dsp_stats.host_stalls += cycles;
+			break;
+		case DSP_IDLE_SSI:
+			dsp_stats.ssi_stalls += cycles;
+			break;
+		default:
+			dsp_stats.idle += cycles;
+			break;
+	}
+}
+
 static void dsp_postexecute_update_pc(void)
 {
 	/* When running a REP, PC must stay on the current instruction */
@@ -1004,6 +1291,8 @@ static void dsp_postexecute_update_pc(void)
 /* Set the status of an interrupt */
 void dsp_set_interrupt(uint32_t intr, uint32_t set)
 {
+	dsp_core.idle = 0;
+
 	if (set)
 		dsp_core.interrupt_status |= (1<<intr);
 	else
@@ -3839,7 +4128,6 @@ static void dsp_pm_1(void)
 
 static void dsp_pm_2(void)
 {
-	uint32_t dummy;
 /*
 	0010 0000 0000 0000 nop
 	0010 0000 010m mrrr R update
@@ -3847,15 +4135,12 @@ static void dsp_pm_2(void)
 	001d dddd iiii iiii #xx,D
 */
 	if ((cur_inst & 0xffff00) == 0x200000) {
-		/* Execute parallel instruction */
-		opcodes_alu[cur_inst & BITMASK(8)]();
+		dsp_pm_2_0();
 		return;
 	}
 
 	if ((cur_inst & 0xffe000) == 0x204000) {
-		dsp_calc_ea((cur_inst>>8) & BITMASK(5), &dummy);
-		/* Execute parallel instruction */
-		opcodes_alu[cur_inst & BITMASK(8)]();
+		dsp_pm_2_1();
 		return;
 	}
 
@@ -3867,6 +4152,26 @@ static void dsp_pm_2(void)
 	dsp_pm_3();
 }
 
+static void dsp_pm_2_0(void)
+{
+/*
+	0010 0000 0000 0000 nop
+*/
+	/* Execute parallel instruction */
+	opcodes_alu[cur_inst & BITMASK(8)]();
+}
+
+static void dsp_pm_2_1(void)
+{
+	uint32_t dummy;
+/*
+	0010 0000 010m mrrr R update
+*/
+	dsp_calc_ea((cur_inst>>8) & BITMASK(5), &dummy);
+	/* Execute parallel instruction */
+	opcodes_alu[cur_inst & BITMASK(8)]();
+}
+
 static void dsp_pm_2_2(void)
 {
 /*
@@ -4254,6 +4559,112 @@ static void dsp_pm_8(void)
 	}
 }
 
+/* Multiplier inputs of MPY/MAC, selected by the QQQ bits of the ALU opcode */
+static const uint32_t registers_mpy[8][2] = {
+	{DSP_REG_X0,DSP_REG_X0},
+	{DSP_REG_Y0,DSP_REG_Y0},
+	{DSP_REG_X1,DSP_REG_X0},
+	{DSP_REG_Y1,DSP_REG_Y0},
+	{DSP_REG_X0,DSP_REG_Y1},
+	{DSP_REG_Y0,DSP_REG_X0},
+	{DSP_REG_X1,DSP_REG_Y0},
+	{DSP_REG_Y1,DSP_REG_X1}
+};
+
+/**
+ * Set up a fused REP loop of
+ *	mac (+/-)S1,S2,D	x:ea,D1	y:ea,D2
+ * with D1 in X0/X1 and D2 in Y0/Y1. Returns 0 for all other instructions.
+ * While the loop runs the accumulator is kept in rep_mac_accu and only
+ * written back by dsp_pm_8_mac_done().
+ */
+static int dsp_pm_8_mac_init(void)
+{
+	uint32_t alu = cur_inst & BITMASK(8);
+
+	/* MAC, X: and Y: read into X0/X1 and Y0/Y1 */
+	if ((alu & 0x83) != 0x82 || (cur_inst & ((1<<22)|(1<<15))) != ((1<<22)|(1<<15)) ||
+	    (cur_inst & ((1<<19)|(1<<17))) != 0) {
+		return 0;
+	}
+
+	rep_mac_ea1 = (cur_inst>>8) & BITMASK(5);
+	if ((rep_mac_ea1>>3) == 0) {
+		rep_mac_ea1 |= (1<<5);
+	}
+	rep_mac_ea2 = (cur_inst>>13) & BITMASK(2);
+	rep_mac_ea2 |= (cur_inst>>17) & (BITMASK(2)<<3);
+	if ((rep_mac_ea1 & (1<<2))==0) {
+		rep_mac_ea2 |= 1<<2;
+	}
+	if ((rep_mac_ea2>>3) == 0) {
+		rep_mac_ea2 |= (1<<5);
+	}
+
+	rep_mac_dst1 = DSP_REG_X0 + ((cur_inst>>18) & 1);
+	rep_mac_dst2 = DSP_REG_Y0 + ((cur_inst>>16) & 1);
+
+	rep_mac_src1 = registers_mpy[(alu>>4) & BITMASK(3)][0];
+	rep_mac_src2 = registers_mpy[(alu>>4) & BITMASK(3)][1];
+	rep_mac_negate = (alu>>2) & 1;
+	rep_mac_accu_reg = (alu>>3) & 1;
+
+	rep_mac_accu = ((uint64_t)dsp_core.registers[DSP_REG_A2+rep_mac_accu_reg] << 48) |
+		((uint64_t)dsp_core.registers[DSP_REG_A1+rep_mac_accu_reg] << 24) |
+		dsp_core.registers[DSP_REG_A0+rep_mac_accu_reg];
+	rep_mac_accu = (int64_t)((uint64_t)rep_mac_accu << 8) >> 8;
+
+	rep_mac_overflow = rep_mac_limited = 0;
+	return 1;
+}
+
+static void dsp_pm_8_mac(void)
+{
+	uint32_t x_addr, y_addr, save_reg1, save_reg2;
+	int64_t product, result;
+
+	dsp_calc_ea(rep_mac_ea1, &x_addr);
+	dsp_calc_ea(rep_mac_ea2, &y_addr);
+
+	save_reg1 = read_memory(DSP_SPACE_X, x_addr);
+	save_reg2 = read_memory(DSP_SPACE_Y, y_addr);
+
+	/* 24x24 bits fractional multiply, exact in 48 bits */
+	product = (int64_t)((int32_t)(dsp_core.registers[rep_mac_src1] << 8) >> 8) *
+		((int32_t)(dsp_core.registers[rep_mac_src2] << 8) >> 8) * 2;
+	if (rep_mac_negate) {
+		product = -product;
+	}
+
+	/* 56 bits accumulate, overflow if the sum does not fit */
+	result = rep_mac_accu + product;
+	rep_mac_accu = (int64_t)((uint64_t)result << 8) >> 8;
+	rep_mac_overflow = (rep_mac_accu != result);
+	rep_mac_limited |= rep_mac_overflow;
+
+	dsp_core.registers[rep_mac_dst1] = save_reg1;
+	dsp_core.registers[rep_mac_dst2] = save_reg2;
+}
+
+static void dsp_pm_8_mac_done(void)
+{
+	uint32_t reg0, reg1, reg2;
+
+	reg0 = ((uint64_t)rep_mac_accu >> 48) & BITMASK(8);
+	reg1 = ((uint64_t)rep_mac_accu >> 24) & BITMASK(24);
+	reg2 = (uint64_t)rep_mac_accu & BITMASK(24);
+
+	dsp_core.registers[DSP_REG_A2+rep_mac_accu_reg] = reg0;
+	dsp_core.registers[DSP_REG_A1+rep_mac_accu_reg] = reg1;
+	dsp_core.registers[DSP_REG_A0+rep_mac_accu_reg] = reg2;
+
+	/* Same flags as the last MAC, L is sticky over the whole loop */
+	dsp_ccr_update_e_u_n_z(reg0, reg1, reg2);
+
+	dsp_core.registers[DSP_REG_SR] &= BITMASK(16)-(1<<DSP_SR_V);
+	dsp_core.registers[DSP_REG_SR] |= (rep_mac_overflow<<DSP_SR_V) | (rep_mac_limited<<DSP_SR_L);
+}
+
 /**********************************
  *	56bit arithmetic
  **********************************/
@@ -115,6 +115,30 @@ extern void dsp56k_init_cpu(void);		/* Set dsp_core to use */
 extern void dsp56k_execute_instruction(void);	/* Execute 1 instruction */
 extern uint16_t dsp56k_execute_one_disasm_instruction(FILE *out, uint16_t pc);	/* Execute 1 instruction in disasm mode */
 
+/* Always-on statistics, running totals since the last DSP reset */
+#define DSP_STATS_ROUTINES	256	/* Routine table size, power of two */
+
+typedef struct {
+	uint16_t addr;		/* Subroutine or interrupt vector */
+	uint64_t calls;
+	uint64_t cycles;	/* Without stalls */
+} dsp_routine_stats_t;
+
+typedef struct {
+	uint64_t insns;
+	uint64_t cycles;	/* DSP cycles, including stalls and skipped idle cycles */
+	uint64_t host_stalls;	/* Cycles spent polling the host port */
+	uint64_t ssi_stalls;	/* Cycles spent polling the SSI */
+	uint64_t idle;		/* Cycles spent in other idle loops */
+	uint64_t waits;		/* DSP thread ran out of cycles */
+	dsp_routine_stats_t main;	/* Outside of any subroutine */
+	dsp_routine_stats_t other;	/* Routines not fitting in the table */
+	dsp_routine_stats_t routine[DSP_STATS_ROUTINES];
+} dsp_stats_t;
+
+extern dsp_stats_t dsp_stats;
+extern void dsp56k_stats_skip(uint32_t cycles);
+
 /* Interrupt relative functions */
 void dsp_set_interrupt(uint32_t intr, uint32_t set);
 void dsp_set_interrupt_mask(uint32_t intr, uint32_t set);
@@ -11,7 +11,7 @@ const char Enet_pcap_fileid[] = "Previous enet_pcap.c";
 #include "m68000.h"
 #include "ethernet.h"
 #include "enet_pcap.h"
-#include "queue.h"
+#include "pktring.h"
 #include "host.h"
 
 #if HAVE_PCAP
@@ -29,46 +29,80 @@ const char Enet_pcap_fileid[] = "Previous enet_pcap.c";
 /* PCAP prototypes */
 pcap_t *pcap_handle;
 
-/* queue prototypes */
-queueADT pcapq;
+/* Frames from the capture device to the guest */
+static PKTRING *pcap_ring;
 
 int pcap_started;
 static mutex_t *pcap_mutex = NULL;
 thread_t *pcap_tick_func_handle;
 
+#define PCAP_TICK_US    1230
+#define PCAP_IDLE_US    10000
+#define PCAP_BUFFER     (2*1024*1024)   /* Kernel capture buffer */
+
+static void pcap_handler_func(unsigned char *user, const struct pcap_pkthdr *h, const unsigned char *data)
+{
+    int len = h->caplen;
+    
+    if (len == 0) {
+        return;
+    }
+    if (len > 1516)
+        len = 1516;
+    
+    PktRing_Put(pcap_ring, data, len);
+    Log_Printf(LOG_EN_PCAP_LEVEL, "[PCAP] Output packet with %i bytes to queue",len);
+}
+
 //This function is to be periodically called
 //to keep the internal packet state flowing.
+//It moves all packets that have arrived to the ring. Packets stay
+//in the capture buffer while the ring is full. A batch never exceeds
+//the free slots, so no packet taken from the capture buffer is dropped.
 static void pcap_tick(void)
 {
-    struct pcap_pkthdr h;
-    const unsigned char *data;
+    int free, n;
     
-    if (pcap_started) {
+    while (pcap_started && (free = PktRing_Free(pcap_ring)) > 0) {
         host_mutex_lock(pcap_mutex);
-        data = pcap_next(pcap_handle,&h);
+        n = pcap_dispatch(pcap_handle, free, pcap_handler_func, NULL);
         host_mutex_unlock(pcap_mutex);
 
-        if (data && h.caplen > 0) {
-            if (h.caplen > 1516)
-                h.caplen = 1516;
-            
-            struct queuepacket *p;
-            p=(struct queuepacket *)malloc(sizeof(struct queuepacket));
-            host_mutex_lock(pcap_mutex);
-            p->len=h.caplen;
-            memcpy(p->data,data,h.caplen);
-            QueueEnter(pcapq,p);
-            host_mutex_unlock(pcap_mutex);
-            Log_Printf(LOG_EN_PCAP_LEVEL, "[PCAP] Output packet with %i bytes to queue",h.caplen);
+        if (n < free) {
+            break; // capture buffer is empty or an error occurred
         }
     }
 }
 
+//Wait until packets arrive, if the platform can select() on the capture
+//device, else for PCAP_TICK_US.
+static void pcap_wait(void)
+{
+#ifndef _WIN32
+    int fd = pcap_get_selectable_fd(pcap_handle);
+    if (fd >= 0) {
+        fd_set rfds;
+        struct timeval tv;
+        FD_ZERO(&rfds);
+        FD_SET(fd, &rfds);
+        tv.tv_sec  = 0;
+        tv.tv_usec = PCAP_IDLE_US; // check pcap_started now and then
+        select(fd + 1, &rfds, NULL, NULL, &tv);
+        return;
+    }
+#endif
+    host_sleep_us(PCAP_TICK_US);
+}
+
 static int tick_func(void *arg)
 {
     while(pcap_started)
     {
-        host_sleep_us(1230);
+        if (PktRing_Free(pcap_ring) > 0) {
+            pcap_wait();
+        } else {
+            host_sleep_us(PCAP_TICK_US); // wait for the guest
+        }
         pcap_tick();
     }
     return 0;
@@ -77,17 +111,13 @@ static int tick_func(void *arg)
 
 void enet_pcap_queue_poll(void)
 {
-    if (pcap_started) {
-        host_mutex_lock(pcap_mutex);
-        if (QueuePeek(pcapq)>0)
-        {
-            struct queuepacket *qp;
-            qp=QueueDelete(pcapq);
-            Log_Printf(LOG_EN_PCAP_LEVEL, "[PCAP] Getting packet from queue");
-            enet_receive(qp->data,qp->len);
-            free(qp);
-        }
-        host_mutex_unlock(pcap_mutex);
+    uint8_t *pkt;
+    int len;
+    
+    if (pcap_started && (pkt = PktRing_Peek(pcap_ring, &len))) {
+        Log_Printf(LOG_EN_PCAP_LEVEL, "[PCAP] Getting packet from queue");
+        enet_receive(pkt,len);
+        PktRing_Release(pcap_ring);
     }
 }
 
@@ -106,9 +136,9 @@ void enet_pcap_stop(void) {
     if (pcap_started) {
         Log_Printf(LOG_WARN, "Stopping PCAP");
         pcap_started=0;
-        QueueDestroy(pcapq);
-        host_mutex_destroy(pcap_mutex);
         host_thread_wait(pcap_tick_func_handle);
+        host_mutex_destroy(pcap_mutex);
+        PktRing_Destroy(pcap_ring);
         pcap_close(pcap_handle);
     }
 }
@@ -135,14 +165,34 @@ void enet_pcap_start(uint8_t *mac) {
         }
         Log_Printf(LOG_WARN, "Device: %s", dev);
         
-        pcap_handle = pcap_open_live(dev, 1518, 1, 1, errbuf);
+        /* Options must be set before the device is activated. On Linux
+         * this gives a memory mapped TPACKET_V3 ring, elsewhere a BPF
+         * buffer of the requested size. */
+        pcap_handle = pcap_create(dev, errbuf);
         
         if (pcap_handle == NULL) {
             Log_Printf(LOG_WARN, "[PCAP] Error: Couldn't open device %s: %s", dev, errbuf);
             return;
         }
         
-        pcap_set_immediate_mode(pcap_handle, 1);
+        pcap_set_snaplen(pcap_handle, 1518);
+        pcap_set_promisc(pcap_handle, 1);
+        pcap_set_timeout(pcap_handle, 1);
+        pcap_set_buffer_size(pcap_handle, PCAP_BUFFER);
+        if (pcap_set_immediate_mode(pcap_handle, 1) != 0) {
+            Log_Printf(LOG_WARN, "[PCAP] Warning: Couldn't set immediate mode.");
+        }
+        
+        if (pcap_activate(pcap_handle) < 0) {
+            Log_Printf(LOG_WARN, "[PCAP] Error: Couldn't activate device %s: %s", dev, pcap_geterr(pcap_handle));
+            pcap_close(pcap_handle);
+            return;
+        }
+        
+        /* Do not capture our own packets where the platform allows it */
+        if (pcap_setdirection(pcap_handle, PCAP_D_IN) != 0) {
+            Log_Printf(LOG_DEBUG, "[PCAP] Capture direction not supported: %s", pcap_geterr(pcap_handle));
+        }
         
         if (pcap_getnonblock(pcap_handle, errbuf) == 0) {
             Log_Printf(LOG_WARN, "[PCAP] Setting interface to non-blocking mode.");
@@ -156,20 +206,30 @@ void enet_pcap_start(uint8_t *mac) {
         }
         
 #if 1 // TODO: Check if we need to take care of RXMODE_ADDR_SIZE and RX_PROMISCUOUS/RX_ANY
+        /* The filter runs in the kernel, other traffic on the host LAN
+         * never reaches the emulator. Frames sent by the guest itself are
+         * dropped where the capture direction could not be set. */
         snprintf(filter_exp, sizeof(filter_exp),
-                 "(((ether dst ff:ff:ff:ff:ff:ff) or (ether dst %02x:%02x:%02x:%02x:%02x:%02x) or (ether[0] & 0x01 = 0x01)))",
+                 "((ether dst %02x:%02x:%02x:%02x:%02x:%02x) or (ether[0] & 0x01 = 0x01)) and not (ether src %02x:%02x:%02x:%02x:%02x:%02x)",
+                 mac[0], mac[1], mac[2], mac[3], mac[4], mac[5],
                  mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
 
-        if (pcap_compile(pcap_handle, &fp, filter_exp, 0, net) == -1) {
+        if (pcap_compile(pcap_handle, &fp, filter_exp, 1, net) == -1) {
             Log_Printf(LOG_WARN, "[PCAP] Warning: Couldn't parse filter %s: %s", filter_exp, pcap_geterr(pcap_handle));
         } else {
             if (pcap_setfilter(pcap_handle, &fp) == -1) {
                 Log_Printf(LOG_WARN, "[PCAP] Warning: Couldn't install filter %s: %s", filter_exp, pcap_geterr(pcap_handle));
             }
+            pcap_freecode(&fp);
         }
 #endif
+        pcap_ring = PktRing_Create();
+        if (!pcap_ring) {
+            Log_Printf(LOG_WARN, "[PCAP] Error: Cannot allocate packet buffers");
+            pcap_close(pcap_handle);
+            return;
+        }
         pcap_started=1;
-        pcapq = QueueCreate();
         pcap_mutex=host_mutex_create();
         pcap_tick_func_handle=host_thread_create(tick_func,"PCAPTickThread", (void *)NULL);
     }
@@ -11,13 +11,15 @@ const char Enet_slirp_fileid[] = "Previous enet_slirp.c";
 #include "m68000.h"
 #include "ethernet.h"
 #include "enet_slirp.h"
-#include "queue.h"
+#include "pktring.h"
 #include "host.h"
 #include "libslirp.h"
 #include "nfs/nfsd.h"
 
 #ifndef _WIN32
 #include <arpa/inet.h>
+#include <fcntl.h>
+#include <unistd.h>
 #else
 #undef TCHAR
 #include <winsock2.h>
@@ -29,8 +31,15 @@ int inet_aton(const char *cp, struct in_addr *addr);
 /****************/
 /* -- SLIRP -- */
 
-/* queue prototypes */
-queueADT slirpq;
+/* Frames from SLiRP to the guest. The producer side is serialized by
+ * slirp_mutex, because SLiRP only outputs while it is called with the
+ * mutex held. */
+static PKTRING *slirp_ring;
+
+/* Packets since start, for the metrics endpoint */
+static uint64_t slirp_packets_in;   /* from the guest */
+static uint64_t slirp_packets_out;  /* to the guest */
+static uint64_t slirp_drops;
 
 int slirp_inited;
 int slirp_started;
@@ -46,21 +55,82 @@ int slirp_can_output(void)
 
 //This is a callback function for SLiRP that sends a packet
 //to the calling library.  In this case I stuff
-//it in q queue
+//it in the ring
 void slirp_output (const unsigned char *pkt, int pkt_len)
 {
-    struct queuepacket *p;
-    p=(struct queuepacket *)malloc(sizeof(struct queuepacket));
-    host_mutex_lock(slirp_mutex);
-    p->len=pkt_len;
-    memcpy(p->data,pkt,pkt_len);
-    QueueEnter(slirpq,p);
-    host_mutex_unlock(slirp_mutex);
+    if (!PktRing_Put(slirp_ring, pkt, pkt_len)) {
+        slirp_drops++;
+        Log_Printf(LOG_WARN, "[SLIRP] Dropping packet with %i bytes (%u dropped)",
+                   pkt_len, PktRing_Dropped(slirp_ring));
+        return;
+    }
+    slirp_packets_out++;
     Log_Printf(LOG_EN_SLIRP_LEVEL, "[SLIRP] Output packet with %i bytes to queue",pkt_len);
 }
 
+#ifndef _WIN32
+#define SLIRP_IDLE_US   100000
+#else
+#define SLIRP_IDLE_US   10000
+#endif
+#define SLIRP_FULL_US   1000
+#define SLIRP_RIP_SEC   30
+
+#ifndef _WIN32
+//The tick thread also waits on this pipe, so that it wakes up as
+//soon as the guest sends a packet or SLiRP is stopped.
+static int slirp_wakeup[2] = { -1, -1 };
+
+static void slirp_wakeup_open(void)
+{
+    if (pipe(slirp_wakeup) < 0) {
+        slirp_wakeup[0] = slirp_wakeup[1] = -1;
+        return;
+    }
+    fcntl(slirp_wakeup[0], F_SETFL, O_NONBLOCK);
+    fcntl(slirp_wakeup[1], F_SETFL, O_NONBLOCK);
+}
+
+static void slirp_wakeup_close(void)
+{
+    if (slirp_wakeup[0] >= 0) {
+        close(slirp_wakeup[0]);
+        close(slirp_wakeup[1]);
+        slirp_wakeup[0] = slirp_wakeup[1] = -1;
+    }
+}
+
+static void slirp_wakeup_signal(void)
+{
+    char c = 0;
+    
+    if (slirp_wakeup[1] >= 0 && write(slirp_wakeup[1], &c, 1) < 0) {
+        // the pipe is full, a wakeup is already pending
+    }
+}
+
+static void slirp_wakeup_drain(void)
+{
+    char buf[64];
+    
+    while (read(slirp_wakeup[0], buf, sizeof(buf)) > 0) {}
+}
+#else
+//Windows can only select on sockets, the tick thread wakes up every
+//SLIRP_IDLE_US to pick up the effects of new guest packets.
+static void slirp_wakeup_open(void) {}
+static void slirp_wakeup_close(void) {}
+static void slirp_wakeup_signal(void) {}
+#endif
+
+/* Free slots needed before the sockets are polled, one poll can output
+ * several packets */
+#define SLIRP_RING_RESERVE  64
+
 //This function is to be periodically called
 //to keep the internal packet state flowing.
+//It waits until a socket is ready, the guest has sent a packet or
+//the next SLiRP timer is due, but not longer than SLIRP_IDLE_US.
 static void slirp_tick(void)
 {
     int ret2,nfds;
@@ -71,23 +141,48 @@ static void slirp_tick(void)
     
     if (slirp_started)
     {
+        // let the sockets fill up while the guest does not pick up packets
+        if (PktRing_Free(slirp_ring) < SLIRP_RING_RESERVE) {
+            host_sleep_us(SLIRP_FULL_US);
+            return;
+        }
         FD_ZERO(&rfds);
         FD_ZERO(&wfds);
         FD_ZERO(&xfds);
         host_mutex_lock(slirp_mutex);
         timeout=slirp_select_fill(&nfds,&rfds,&wfds,&xfds); //this can crash
         host_mutex_unlock(slirp_mutex);
+#ifndef _WIN32
+        if (slirp_wakeup[0] >= 0) {
+            FD_SET(slirp_wakeup[0], &rfds);
+            if (slirp_wakeup[0] > nfds)
+                nfds = slirp_wakeup[0];
+        }
+#endif
         
-        if(timeout<0)
-            timeout=500;
+        if(timeout<0 || timeout>SLIRP_IDLE_US)
+            timeout=SLIRP_IDLE_US;
         tv.tv_sec=0;
         tv.tv_usec = timeout;    //basilisk default 10000
         
-        ret2 = select(nfds + 1, &rfds, &wfds, &xfds, &tv);
+        if (nfds < 0) {
+            // nothing to select, just wait for the timers
+            host_sleep_us(timeout);
+            ret2 = 0;
+        } else {
+            ret2 = select(nfds + 1, &rfds, &wfds, &xfds, &tv);
+        }
+#ifndef _WIN32
+        if (ret2 > 0 && slirp_wakeup[0] >= 0 && FD_ISSET(slirp_wakeup[0], &rfds)) {
+            slirp_wakeup_drain();
+        }
+#endif
         if(ret2>=0){
+            uint64_t start = host_prof_now();
             host_mutex_lock(slirp_mutex);
             slirp_select_poll(&rfds, &wfds, &xfds);
             host_mutex_unlock(slirp_mutex);
+            host_prof_end(HOST_PROF_NET, start);
         }
     }
 }
@@ -106,9 +201,6 @@ static void slirp_rip_tick(void)
 }
 
 
-#define SLIRP_TICK_US   1230
-#define SLIRP_RIP_SEC   30
-
 static int tick_func(void *arg)
 {
     uint32_t time = host_get_save_time();
@@ -117,8 +209,8 @@ static int tick_func(void *arg)
 
     while(slirp_started)
     {
-        host_sleep_us(SLIRP_TICK_US);
         slirp_tick();
+        nfsd_tick(); // write out data gathered by the NFS server
         
         // for routing information protocol
         last_time = time;
@@ -139,16 +231,26 @@ static int tick_func(void *arg)
 
 void enet_slirp_queue_poll(void)
 {
-    host_mutex_lock(slirp_mutex);
-    if (QueuePeek(slirpq)>0)
+    uint8_t *pkt;
+    int len;
+    
+    if (slirp_started && (pkt = PktRing_Peek(slirp_ring, &len)))
     {
-        struct queuepacket *qp;
-        qp=QueueDelete(slirpq);
         Log_Printf(LOG_EN_SLIRP_LEVEL, "[SLIRP] Getting packet from queue");
-        enet_receive(qp->data,qp->len);
-        free(qp);
+        enet_receive(pkt,len);
+        PktRing_Release(slirp_ring);
     }
-    host_mutex_unlock(slirp_mutex);
+}
+
+uint8_t *enet_slirp_input_buffer(int *size) {
+    uint8_t *buf = NULL;
+    
+    if (slirp_started) {
+        host_mutex_lock(slirp_mutex);
+        buf = slirp_input_buffer(size);
+        host_mutex_unlock(slirp_mutex);
+    }
+    return buf;
 }
 
 void enet_slirp_input(uint8_t *pkt, int pkt_len) {
@@ -157,16 +259,27 @@ void enet_slirp_input(uint8_t *pkt, int pkt_len) {
         host_mutex_lock(slirp_mutex);
         slirp_input(pkt,pkt_len);
         host_mutex_unlock(slirp_mutex);
+        slirp_packets_in++;
+        slirp_wakeup_signal();
     }
 }
 
+// Counters are read without locking, a snapshot may be off by a few packets
+void enet_slirp_stats(uint64_t *in, uint64_t *out, uint64_t *drops) {
+    *in    = slirp_packets_in;
+    *out   = slirp_packets_out;
+    *drops = slirp_drops;
+}
+
 void enet_slirp_stop(void) {
     if (slirp_started) {
         Log_Printf(LOG_WARN, "Stopping SLIRP");
         slirp_started=0;
-        QueueDestroy(slirpq);
-        host_mutex_destroy(slirp_mutex);
+        slirp_wakeup_signal();
         host_thread_wait(tick_func_handle);
+        slirp_wakeup_close();
+        host_mutex_destroy(slirp_mutex);
+        PktRing_Destroy(slirp_ring);
     }
 }
 
@@ -187,8 +300,16 @@ void enet_slirp_start(uint8_t *mac) {
         Log_Printf(LOG_WARN, "Starting SLIRP (%02x:%02x:%02x:%02x:%02x:%02x)",
                    mac[0],mac[1],mac[2],mac[3],mac[4],mac[5]);
         memcpy(client_ethaddr, mac, 6);
+        slirp_ring = PktRing_Create();
+        if (!slirp_ring) {
+            Log_Printf(LOG_WARN, "[SLIRP] Error: Cannot allocate packet buffers");
+            return;
+        }
+        /* Applies to new connections */
+        slirp_tcp_config(ConfigureParams.Ethernet.nSlirpBufferSize*1024,
+                         ConfigureParams.Ethernet.bSlirpNoDelay);
+        slirp_wakeup_open();
         slirp_started=1;
-        slirpq = QueueCreate();
         slirp_mutex=host_mutex_create();
         tick_func_handle=host_thread_create(tick_func,"SLiRPTickThread", (void *)NULL);
     }
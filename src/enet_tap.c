@@ -0,0 +1,161 @@
+/*
+  Previous - enet_tap.c
+
+  This file is distributed under the GNU General Public License, version 2
+  or at your option any later version. Read the file gpl.txt for details.
+
+  Send and receive Ethernet packets using a TAP device of the host. The
+  device has to be created and bridged by the user, for example with
+  "ip tuntap add dev tap0 mode tap user <name>". No super user privileges
+  are needed at run time and frames bypass the SLiRP TCP/IP stack.
+*/
+const char Enet_tap_fileid[] = "Previous enet_tap.c";
+
+#include "m68000.h"
+#include "ethernet.h"
+#include "enet_tap.h"
+#include "pktring.h"
+#include "host.h"
+
+#if HAVE_LINUX_IF_TUN_H
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/ioctl.h>
+#include <sys/select.h>
+#include <net/if.h>
+#include <linux/if_tun.h>
+
+#define LOG_EN_TAP_LEVEL LOG_DEBUG
+
+/***************/
+/* --- TAP --- */
+
+/* Frames from the TAP device to the guest */
+static PKTRING *tap_ring;
+
+static int tap_fd = -1;
+static int tap_started;
+static thread_t *tap_tick_func_handle;
+
+#define TAP_TICK_US     1230
+#define TAP_IDLE_US     10000
+
+//Move all frames that have arrived to the ring. Frames stay in the
+//device queue while the ring is full. Each read returns one frame.
+static void tap_tick(void)
+{
+    uint8_t buf[PKTRING_MTU];
+    ssize_t len;
+    
+    while (tap_started && PktRing_Free(tap_ring) > 0) {
+        len = read(tap_fd, buf, sizeof(buf));
+        if (len <= 0) {
+            if (len < 0 && errno != EAGAIN && errno != EINTR) {
+                Log_Printf(LOG_WARN, "[TAP] Error: Couldn't receive packet: %s", strerror(errno));
+            }
+            break;
+        }
+        PktRing_Put(tap_ring, buf, (int)len);
+        Log_Printf(LOG_EN_TAP_LEVEL, "[TAP] Output packet with %i bytes to queue", (int)len);
+    }
+}
+
+//Block until frames arrive, return now and then to check tap_started.
+static void tap_wait(void)
+{
+    fd_set rfds;
+    struct timeval tv;
+    
+    FD_ZERO(&rfds);
+    FD_SET(tap_fd, &rfds);
+    tv.tv_sec  = 0;
+    tv.tv_usec = TAP_IDLE_US;
+    select(tap_fd + 1, &rfds, NULL, NULL, &tv);
+}
+
+static int tick_func(void *arg)
+{
+    while (tap_started)
+    {
+        if (PktRing_Free(tap_ring) > 0) {
+            tap_wait();
+        } else {
+            host_sleep_us(TAP_TICK_US); // wait for the guest
+        }
+        tap_tick();
+    }
+    return 0;
+}
+
+
+void enet_tap_queue_poll(void)
+{
+    uint8_t *pkt;
+    int len;
+    
+    if (tap_started && (pkt = PktRing_Peek(tap_ring, &len))) {
+        Log_Printf(LOG_EN_TAP_LEVEL, "[TAP] Getting packet from queue");
+        enet_receive(pkt, len);
+        PktRing_Release(tap_ring);
+    }
+}
+
+void enet_tap_input(uint8_t *pkt, int pkt_len) {
+    if (tap_started) {
+        Log_Printf(LOG_EN_TAP_LEVEL, "[TAP] Input packet with %i bytes", pkt_len);
+        if (write(tap_fd, pkt, pkt_len) != pkt_len) {
+            Log_Printf(LOG_WARN, "[TAP] Error: Couldn't transmit packet!");
+        }
+    }
+}
+
+void enet_tap_stop(void) {
+    if (tap_started) {
+        Log_Printf(LOG_WARN, "Stopping TAP");
+        tap_started=0;
+        host_thread_wait(tap_tick_func_handle);
+        PktRing_Destroy(tap_ring);
+        close(tap_fd);
+        tap_fd = -1;
+    }
+}
+
+void enet_tap_start(uint8_t *mac) {
+    struct ifreq ifr;
+
+    if (!tap_started) {
+        Log_Printf(LOG_WARN, "Starting TAP (%02x:%02x:%02x:%02x:%02x:%02x)",
+                   mac[0],mac[1],mac[2],mac[3],mac[4],mac[5]);
+        
+        tap_fd = open("/dev/net/tun", O_RDWR | O_NONBLOCK);
+        if (tap_fd < 0) {
+            Log_Printf(LOG_WARN, "[TAP] Error: Couldn't open /dev/net/tun: %s", strerror(errno));
+            return;
+        }
+        
+        memset(&ifr, 0, sizeof(ifr));
+        ifr.ifr_flags = IFF_TAP | IFF_NO_PI;
+        snprintf(ifr.ifr_name, IFNAMSIZ, "%.*s", IFNAMSIZ - 1, ConfigureParams.Ethernet.szTapInterface);
+        
+        if (ioctl(tap_fd, TUNSETIFF, &ifr) < 0) {
+            Log_Printf(LOG_WARN, "[TAP] Error: Couldn't attach to device %s: %s",
+                       ConfigureParams.Ethernet.szTapInterface, strerror(errno));
+            close(tap_fd);
+            tap_fd = -1;
+            return;
+        }
+        Log_Printf(LOG_WARN, "Device: %s", ifr.ifr_name);
+        
+        tap_ring = PktRing_Create();
+        if (!tap_ring) {
+            Log_Printf(LOG_WARN, "[TAP] Error: Cannot allocate packet buffers");
+            close(tap_fd);
+            tap_fd = -1;
+            return;
+        }
+        tap_started=1;
+        tap_tick_func_handle=host_thread_create(tick_func,"TAPTickThread", (void *)NULL);
+    }
+}
+#endif
@@ -389,6 +389,25 @@ static void esp_dma_write_memory(void) { /* from device to memory */
 bool ESP_Send_Ready(void) {
     return (esp_counter > 0 && SCSIbus.phase == PHASE_DI) || fifoflags > 0;
 }
+/* Burst transfers: return up to esp_counter bytes of device data that
+ * can be copied in one go, 0 bytes if the FIFO holds data */
+uint8_t* ESP_Send_Span(int* size) {
+    uint8_t* data;
+    
+    if (fifoflags > 0 || esp_counter <= 0 || SCSIbus.phase != PHASE_DI) {
+        *size = 0;
+        return NULL;
+    }
+    data = SCSIdisk_Send_Span(size);
+    if (*size > esp_counter) {
+        *size = esp_counter;
+    }
+    return data;
+}
+void ESP_Send_Consume(int size) {
+    esp_counter -= size;
+    SCSIdisk_Send_Consume(size);
+}
 uint8_t ESP_Send_Data(void) {
     if (fifoflags > 0) {
         return esp_fifo_read();
@@ -788,6 +807,9 @@ void esp_select(bool atn) {
         esp_command_clear();
         esp_state = DISCONNECTED;
         int seltout = (selecttimeout * 8192 * clockconv) / ESP_CLOCK_FREQ; /* timeout in microseconds */
+        if (ConfigureParams.Boot.bFastBoot && seltout > ESP_DELAY) {
+            seltout = ESP_DELAY; /* nobody is going to answer later */
+        }
         Log_Printf(LOG_ESPCMD_LEVEL, "[ESP] Select: Target %i, timeout after %i microseconds",target,seltout);
         CycInt_AddRelativeInterruptUs(seltout, 0, INTERRUPT_ESP);
         return;
@@ -888,6 +910,9 @@ void ESP_IO_Handler(void) {
         case ESP_IO_STATE_TRANSFERING:
             switch (SCSIbus.phase) {
                 case PHASE_DI:
+                    if (SCSIdisk_Busy()) { /* Wait for the disk image */
+                        break;
+                    }
                     esp_dma_write_memory();
                     if (esp_transfer_done(true)) {
                         esp_io_state=ESP_IO_STATE_FLUSHING;
@@ -9,6 +9,7 @@
 */
 const char Ethernet_fileid[] = "Previous ethernet.c";
 
+#include "main.h"
 #include "ioMem.h"
 #include "ioMemTables.h"
 #include "m68000.h"
@@ -19,14 +20,17 @@ const char Ethernet_fileid[] = "Previous ethernet.c";
 #include "ethernet.h"
 #include "enet_slirp.h"
 #include "enet_pcap.h"
+#include "enet_tap.h"
 #include "cycInt.h"
 #include "statusbar.h"
+#include "host.h"
+#include "replay.h"
 
 #define LOG_EN_LEVEL        LOG_DEBUG
 #define LOG_EN_REG_LEVEL    LOG_DEBUG
 
 
-EthernetBuffer enet_tx_buffer;
+EthernetTxBuffer enet_tx_buffer;
 EthernetBuffer enet_rx_buffer;
 
 struct {
@@ -91,10 +95,21 @@ bool new_enet_buserror(void);
 
 void (*enet_output)(void);
 void (*enet_input)(uint8_t *pkt, int len);
+uint8_t *(*enet_input_buffer)(int *size);
 void (*enet_start)(uint8_t *mac);
 void (*enet_stop)(void);
 
+/* Set while a paravirtual network board owns the backend */
+static void (*enet_redirect)(uint8_t *pkt, int len);
+static uint8_t enet_redirect_mac[6];
+
+/* Packet printer and analyzer, enable for debugging */
+#define LOG_EN_DATA    0
+#define LOG_EN_ANALYZE 0
+#define LOG_EN_FILE    ""
+
 void print_packet(uint8_t *pkt, int len, int out);
+static void enet_capture(uint8_t *pkt, int len, int out);
 
 
 /* Interrupt functions */
@@ -311,6 +326,7 @@ void EN_CounterHi_Read(void) { // 0x0200600f
 /* Ethernet periodic check */
 #define ENET_IO_DELAY   500     /* use 500 for NeXT hardware test, 20 for status test */
 #define ENET_IO_SHORT   40      /* use 40 for 68030 hardware test */
+#define ENET_IO_FAST    2       /* unlimited speed, while packets are moving */
 
 /* Ethernet states */
 enum {
@@ -321,6 +337,21 @@ enum {
 static bool tx_done;
 static bool rx_chain;
 static int old_size;
+
+/* Packets that arrive back to back are received in the same handler call,
+ * as long as the receive DMA channel has buffers for them. The guest then
+ * handles their interrupts at once. */
+#define ENET_RX_BURST       4
+#define ENET_RX_BURST_FAST  32  /* unlimited speed */
+
+static bool rx_delivered; /* A packet has been received in this call */
+static bool tx_delivered; /* A packet has been sent in this call */
+
+static bool enet_rx_continue(int *count) {
+    int burst = ConfigureParams.Ethernet.bUnlimitedSpeed ? ENET_RX_BURST_FAST : ENET_RX_BURST;
+    return receiver_state==RECV_STATE_WAITING && rx_delivered &&
+           ++*count < burst && dma_enet_ready();
+}
 static int en_state;
 
 #define EN_DISCONNECTED    0
@@ -414,9 +445,26 @@ static bool enet_packet_for_me(uint8_t *packet) {
     }
 }
 
+static bool enet_recording = false;
+
 void enet_receive(uint8_t *pkt, int len) {
+    if (enet_recording) {
+        Replay_Data(REPLAY_NET, pkt, len, len);
+    }
+    if (enet_redirect) {
+        if (LOG_TRACE_LEVEL(TRACE_ENET_PACKETS)) {
+            enet_capture(pkt, len, 0);
+        }
+        enet_redirect(pkt, len);
+        return;
+    }
     if (enet_packet_for_me(pkt)) {
+#if LOG_EN_DATA
         print_packet(pkt, len, 0);
+#endif
+        if (LOG_TRACE_LEVEL(TRACE_ENET_PACKETS)) {
+            enet_capture(pkt, len, 0);
+        }
         memcpy(enet_rx_buffer.data,pkt,len);
         len += 4; /* Checksum */
         if (len < ENET_FRAMESIZE_MIN) { /* Hack for short packets from SLIRP */
@@ -430,25 +478,67 @@ void enet_receive(uint8_t *pkt, int len) {
     }
 }
 
+/* Fetch packets from the backend, or from the log of a replay */
+static void enet_output_poll(void) {
+    static uint8_t pkt[EN_BUF_MAX];
+    int len;
+    
+    if (nReplayMode == REPLAY_PLAY) {
+        len = Replay_Data(REPLAY_NET, pkt, 0, sizeof(pkt));
+        if (len >= 0) {
+            enet_receive(pkt, len);
+        }
+        return;
+    }
+    enet_recording = (nReplayMode == REPLAY_RECORD);
+    enet_output();
+    enet_recording = false;
+}
+
 static void enet_send(uint8_t *pkt, int len) {
+#if LOG_EN_DATA
     print_packet(pkt, len, 1);
+#endif
+    if (LOG_TRACE_LEVEL(TRACE_ENET_PACKETS)) {
+        enet_capture(pkt, len, 1);
+    }
     if (en_state == EN_LOOPBACK) {
         /* Loop back */
         Log_Printf(LOG_WARN, "[EN] Loopback packet.");
         enet_receive(pkt, len);
     } else {
-        /* Send to real world network */
-        enet_input(pkt, len);
         /* Simultaneously receive packet on thin ethernet */
         if (en_state == EN_THINWIRE) {
             enet_receive(pkt, len);
         }
+        /* Send to real world network, this may consume the buffer */
+        enet_input(pkt, len);
+    }
+}
+
+/* Set up the transmit buffer for a new packet */
+static void enet_tx_prepare(void) {
+    uint8_t *buf = NULL;
+    int size = 0;
+    
+    if (enet_input_buffer && (en_state == EN_THINWIRE || en_state == EN_TWISTEDPAIR)) {
+        buf = enet_input_buffer(&size);
+    }
+    if (buf && size >= ENET_FRAMESIZE_MAX) {
+        enet_tx_buffer.data = buf;
+        enet_tx_buffer.limit = size;
+    } else {
+        enet_tx_buffer.data = enet_tx_buffer.base;
+        enet_tx_buffer.limit = EN_BUF_MAX;
     }
 }
 
 
 /* Fujitsu ethernet controller */
 static int enet_state(void) {
+    if (enet_redirect) {
+        return EN_DISCONNECTED;
+    }
     if (ConfigureParams.System.nMachineType == NEXT_CUBE030) {
         if (enet.tx_mode&TXMODE_DIS_LOOP) {
             if (ConfigureParams.Ethernet.bEthernetConnected) {
@@ -478,12 +568,17 @@ static int enet_state(void) {
 }
 
 static void enet_io(void) {
+    int count = 0;
     
     en_state = enet_state();
     
-    /* Receive packet */
-    switch (receiver_state) {
+    /* Receive packets */
+    do switch (receiver_state) {
         case RECV_STATE_WAITING:
+            if (enet_rx_buffer.size==0 && (en_state == EN_THINWIRE || en_state == EN_TWISTEDPAIR)) {
+                /* Receive from real world network */
+                enet_output_poll();
+            }
             if (enet_rx_buffer.size>0) {
                 Statusbar_BlinkLed(DEVICE_LED_ENET);
                 Log_Printf(LOG_EN_LEVEL, "[EN] Receiving packet from %02X:%02X:%02X:%02X:%02X:%02X",
@@ -498,10 +593,6 @@ static void enet_io(void) {
                     break; /* Keep on waiting for a good packet */
                 } else /* Fall through to receiving state */
                     receiver_state = RECV_STATE_RECEIVING;
-            } else if (en_state == EN_THINWIRE || en_state == EN_TWISTEDPAIR) {
-                /* Receive from real world network */
-                enet_output();
-                break;
             } else
                 break;
         case RECV_STATE_RECEIVING:
@@ -530,13 +621,14 @@ static void enet_io(void) {
                     }
                     enet.tx_status &= ~TXSTAT_NET_BUSY;
                     receiver_state = RECV_STATE_WAITING;
+                    rx_delivered = true;
                 }
             }
             break;
             
         default:
             break;
-    }
+    } while (enet_rx_continue(&count));
     
     /* Send packet */
     if (enet.tx_status&TXSTAT_READY) {
@@ -544,6 +636,9 @@ static void enet_io(void) {
             /* Wait until network is free */
             Log_Printf(LOG_EN_LEVEL, "[EN] Network is busy. Transmission delayed.");
         } else {
+            if (enet_tx_buffer.size==0) {
+                enet_tx_prepare();
+            }
             old_size = enet_tx_buffer.size;
             tx_done=dma_enet_read_memory();
             if (enet_tx_buffer.size>0) {
@@ -572,6 +667,7 @@ static void enet_io(void) {
                            enet_tx_buffer.data[3], enet_tx_buffer.data[4], enet_tx_buffer.data[5]);
                 enet_send(enet_tx_buffer.data, enet_tx_buffer.size);
                 enet_tx_buffer.size=0;
+                tx_delivered = true;
             }
         }
     }
@@ -643,12 +739,17 @@ static int new_enet_state(void) {
 }
 
 static void new_enet_io(void) {
+    int count = 0;
     
     en_state = new_enet_state();
     
-    /* Receive packet */
-    switch (receiver_state) {
+    /* Receive packets */
+    do switch (receiver_state) {
         case RECV_STATE_WAITING:
+            if (enet_rx_buffer.size==0 && (en_state == EN_THINWIRE || en_state == EN_TWISTEDPAIR)) {
+                /* Receive from real world network */
+                enet_output_poll();
+            }
             if (enet_rx_buffer.size>0) {
                 Statusbar_BlinkLed(DEVICE_LED_ENET);
                 Log_Printf(LOG_EN_LEVEL, "[EN] Receiving packet from %02X:%02X:%02X:%02X:%02X:%02X",
@@ -662,10 +763,6 @@ static void new_enet_io(void) {
                     break; /* Keep on waiting for a good packet */
                 } else /* Fall through to receiving state */
                     receiver_state = RECV_STATE_RECEIVING;
-            } else if (en_state == EN_THINWIRE || en_state == EN_TWISTEDPAIR) {
-                /* Receive from real world network */
-                enet_output();
-                break;
             } else
                 break;
         case RECV_STATE_RECEIVING:
@@ -692,13 +789,14 @@ static void new_enet_io(void) {
                     }
                     enet.tx_status &= ~TXSTAT_NET_BUSY;
                     receiver_state = RECV_STATE_WAITING;
+                    rx_delivered = true;
                 }
             }
             break;
             
         default:
             break;
-    }
+    } while (enet_rx_continue(&count));
     
     /* Send packet */
     if (enet.tx_mode&TXMODE_ENABLE) {
@@ -706,6 +804,9 @@ static void new_enet_io(void) {
             /* Wait until network is free */
             Log_Printf(LOG_EN_LEVEL, "[EN] Network is busy. Transmission delayed.");
         } else {
+            if (enet_tx_buffer.size==0) {
+                enet_tx_prepare();
+            }
             dma_enet_read_memory();
             if (enet_tx_buffer.size>0) {
                 if (en_state == EN_DISCONNECTED) {
@@ -717,6 +818,7 @@ static void new_enet_io(void) {
                                enet_tx_buffer.data[0], enet_tx_buffer.data[1], enet_tx_buffer.data[2],
                                enet_tx_buffer.data[3], enet_tx_buffer.data[4], enet_tx_buffer.data[5]);
                     enet_send(enet_tx_buffer.data, enet_tx_buffer.size);
+                    tx_delivered = true;
                 }
                 enet_tx_buffer.size=0;
                 enet_tx_interrupt(TXSTAT_READY);
@@ -731,19 +833,31 @@ void ENET_IO_Handler(void) {
     if (enet.reset&EN_RESET) {
         Log_Printf(LOG_WARN, "Stopping Ethernet Transmitter/Receiver");
         /* Stop SLIRP/PCAP */
-        if (ConfigureParams.Ethernet.bEthernetConnected) {
+        if (ConfigureParams.Ethernet.bEthernetConnected && !enet_redirect) {
             enet_stop();
         }
         return;
     }
     
+    rx_delivered = false;
+    tx_delivered = false;
     if (ConfigureParams.System.bTurbo) {
         new_enet_io();
     } else {
         enet_io();
     }
     
-    CycInt_AddRelativeInterruptUs(receiver_state==RECV_STATE_WAITING?ENET_IO_DELAY:ENET_IO_SHORT, 0, INTERRUPT_ENET_IO);
+    /* Come back soon if more packets may be waiting */
+    if (ConfigureParams.Ethernet.bUnlimitedSpeed) {
+        /* Move packets as fast as the guest supplies and takes them */
+        if (receiver_state==RECV_STATE_WAITING && !rx_delivered && !tx_delivered && enet_tx_buffer.size==0) {
+            CycInt_AddRelativeInterruptUs(ENET_IO_SHORT, 0, INTERRUPT_ENET_IO);
+        } else {
+            CycInt_AddRelativeInterruptUs(ENET_IO_FAST, 0, INTERRUPT_ENET_IO);
+        }
+    } else {
+        CycInt_AddRelativeInterruptUs((receiver_state==RECV_STATE_WAITING && !rx_delivered)?ENET_IO_DELAY:ENET_IO_SHORT, 0, INTERRUPT_ENET_IO);
+    }
 }
 
 void enet_reset(void) {
@@ -751,7 +865,7 @@ void enet_reset(void) {
         enet.tx_status=ConfigureParams.System.bTurbo?0:TXSTAT_READY;
     } else {
         /* Start SLIRP/PCAP */
-        if (ConfigureParams.Ethernet.bEthernetConnected) {
+        if (ConfigureParams.Ethernet.bEthernetConnected && !enet_redirect) {
             enet_start(enet.mac_addr);
         }
         if (!CycInt_InterruptActive(INTERRUPT_ENET_IO)) {
@@ -768,6 +882,7 @@ void Ethernet_Reset(bool hard) {
         enet.reset=EN_RESET;
         enet_rx_buffer.size=enet_tx_buffer.size=0;
         enet_rx_buffer.limit=enet_tx_buffer.limit=EN_BUF_MAX;
+        enet_tx_buffer.data=enet_tx_buffer.base;
         enet.tx_status=ConfigureParams.System.bTurbo?0:TXSTAT_READY;
         CycInt_RemovePendingInterrupt(INTERRUPT_ENET_IO);
     }
@@ -780,27 +895,183 @@ void Ethernet_Reset(bool hard) {
     if (ConfigureParams.Ethernet.nHostInterface == ENET_PCAP) {
         enet_output = enet_pcap_queue_poll;
         enet_input  = enet_pcap_input;
+        enet_input_buffer = NULL;
         enet_start  = enet_pcap_start;
         enet_stop   = enet_pcap_stop;
     } else
+#endif
+#if HAVE_LINUX_IF_TUN_H
+    if (ConfigureParams.Ethernet.nHostInterface == ENET_TAP) {
+        enet_output = enet_tap_queue_poll;
+        enet_input  = enet_tap_input;
+        enet_input_buffer = NULL;
+        enet_start  = enet_tap_start;
+        enet_stop   = enet_tap_stop;
+    } else
 #endif
     {
         enet_output = enet_slirp_queue_poll;
         enet_input  = enet_slirp_input;
+        enet_input_buffer = enet_slirp_input_buffer;
         enet_start  = enet_slirp_start;
         enet_stop   = enet_slirp_stop;
     }
     init_done = 1;
     
     enet_reset();
+    
+    if (enet_redirect && ConfigureParams.Ethernet.bEthernetConnected) {
+        enet_start(enet_redirect_mac);
+    }
+}
+
+/* Paravirtual network boards bypass the ethernet controller. While a
+ * receive function is set, it gets all packets from the backend and the
+ * controller is disconnected. */
+void Ethernet_Redirect(void (*receive)(uint8_t *pkt, int len), const uint8_t *mac) {
+    if (ConfigureParams.Ethernet.bEthernetConnected && (enet_redirect || !(enet.reset&EN_RESET))) {
+        enet_stop();
+    }
+    enet_redirect = receive;
+    if (receive) {
+        memcpy(enet_redirect_mac, mac, 6);
+    }
+    if (ConfigureParams.Ethernet.bEthernetConnected) {
+        if (receive) {
+            enet_start(enet_redirect_mac);
+        } else if (!(enet.reset&EN_RESET)) {
+            enet_start(enet.mac_addr);
+        }
+    }
 }
 
+/* Send a packet from a paravirtual network board */
+void Ethernet_Send(uint8_t *pkt, int len) {
+    if (LOG_TRACE_LEVEL(TRACE_ENET_PACKETS)) {
+        enet_capture(pkt, len, 1);
+    }
+    if (enet_redirect && ConfigureParams.Ethernet.bEthernetConnected) {
+        enet_input(pkt, len);
+    }
+}
 
-/* Packet printer and analyzer */
+/* Fetch one packet from the backend for a paravirtual network board */
+void Ethernet_Poll(void) {
+    if (enet_redirect && ConfigureParams.Ethernet.bEthernetConnected) {
+        enet_output_poll();
+    }
+}
 
-#define LOG_EN_DATA    0
-#define LOG_EN_ANALYZE 0
-#define LOG_EN_FILE    ""
+
+/* Packet capture
+ *
+ * With the enet_packets trace enabled, the last frames sent and received
+ * by the guest are kept in memory. The debugger command enetdump writes
+ * them to a pcapng file. Without the trace the cost is a single test of
+ * the trace flags per packet. */
+
+#define ENET_CAPTURE_SLOTS  256
+#define ENET_CAPTURE_SNAP   ENET_FRAMESIZE_MAX
+
+typedef struct {
+    uint64_t time;
+    int      len;
+    int      out;
+    uint8_t  data[ENET_CAPTURE_SNAP];
+} ENET_CAPTURE;
+
+static ENET_CAPTURE *enet_capture_ring;
+static uint32_t enet_capture_count;
+
+static void enet_capture(uint8_t *pkt, int len, int out) {
+    ENET_CAPTURE *slot;
+    
+    if (!enet_capture_ring) {
+        enet_capture_ring = malloc(ENET_CAPTURE_SLOTS * sizeof(ENET_CAPTURE));
+        if (!enet_capture_ring) {
+            return;
+        }
+    }
+    slot = &enet_capture_ring[enet_capture_count++ % ENET_CAPTURE_SLOTS];
+    slot->time = host_time_us();
+    slot->len  = len;
+    slot->out  = out;
+    memcpy(slot->data, pkt, len < ENET_CAPTURE_SNAP ? len : ENET_CAPTURE_SNAP);
+}
+
+static void pcapng_put32(FILE *f, uint32_t v) {
+    fwrite(&v, sizeof(v), 1, f);
+}
+
+static void pcapng_put16(FILE *f, uint16_t v) {
+    fwrite(&v, sizeof(v), 1, f);
+}
+
+/**
+ * Write the captured frames to a pcapng file in host byte order.
+ * Returns the number of frames written or -1 on error.
+ */
+int Ethernet_CaptureDump(const char *filename) {
+    static const uint8_t pad[4] = { 0, 0, 0, 0 };
+    uint32_t i, first, caplen, padded;
+    ENET_CAPTURE *slot;
+    FILE *f;
+    
+    f = fopen(filename, "wb");
+    if (!f) {
+        return -1;
+    }
+    
+    /* Section header block */
+    pcapng_put32(f, 0x0A0D0D0A);
+    pcapng_put32(f, 28);
+    pcapng_put32(f, 0x1A2B3C4D);
+    pcapng_put16(f, 1);
+    pcapng_put16(f, 0);
+    pcapng_put32(f, 0xFFFFFFFF); /* Section length unknown */
+    pcapng_put32(f, 0xFFFFFFFF);
+    pcapng_put32(f, 28);
+    
+    /* Interface description block: Ethernet, microsecond time stamps */
+    pcapng_put32(f, 0x00000001);
+    pcapng_put32(f, 20);
+    pcapng_put16(f, 1);
+    pcapng_put16(f, 0);
+    pcapng_put32(f, ENET_CAPTURE_SNAP);
+    pcapng_put32(f, 20);
+    
+    first = enet_capture_count > ENET_CAPTURE_SLOTS ? enet_capture_count - ENET_CAPTURE_SLOTS : 0;
+    
+    for (i = first; i < enet_capture_count && enet_capture_ring; i++) {
+        slot   = &enet_capture_ring[i % ENET_CAPTURE_SLOTS];
+        caplen = slot->len < ENET_CAPTURE_SNAP ? slot->len : ENET_CAPTURE_SNAP;
+        padded = (caplen + 3) & ~3;
+        
+        /* Enhanced packet block with direction option */
+        pcapng_put32(f, 0x00000006);
+        pcapng_put32(f, 28 + padded + 12 + 4);
+        pcapng_put32(f, 0);
+        pcapng_put32(f, (uint32_t)(slot->time >> 32));
+        pcapng_put32(f, (uint32_t)slot->time);
+        pcapng_put32(f, caplen);
+        pcapng_put32(f, slot->len);
+        fwrite(slot->data, 1, caplen, f);
+        fwrite(pad, 1, padded - caplen, f);
+        pcapng_put16(f, 2); /* epb_flags */
+        pcapng_put16(f, 4);
+        pcapng_put32(f, slot->out ? 2 : 1);
+        pcapng_put32(f, 0); /* opt_endofopt */
+        pcapng_put32(f, 28 + padded + 12 + 4);
+    }
+    
+    if (fclose(f) != 0) {
+        return -1;
+    }
+    return enet_capture_count - first;
+}
+
+
+/* Packet printer and analyzer */
 
 void print_packet(uint8_t *buf, int size, int out) {
 #if LOG_EN_DATA
@@ -27,10 +27,16 @@ const char File_fileid[] = "Hatari file.c";
 #include "file.h"
 #include "str.h"
 #include "zip.h"
+#if HAVE_LIBZ
+#include "zimage.h"
+#endif
 
 #ifdef HAVE_FLOCK
 # include <sys/file.h>
 #endif
+#if HAVE_SYS_MMAN_H
+# include <sys/mman.h>
+#endif
 #if defined(__APPLE__)
 #include <sys/disk.h>
 #endif
@@ -377,6 +383,15 @@ off_t File_Length(const char *pszFileName)
 	hDiskFile = fopen(pszFileName, "rb");
 	if (hDiskFile!=NULL)
 	{
+#if HAVE_LIBZ
+		/* compressed disk images report their uncompressed size */
+		uint64_t zsize = ZImage_Length(hDiskFile);
+		if (zsize)
+		{
+			fclose(hDiskFile);
+			return zsize;
+		}
+#endif
 #if defined(__APPLE__)
 		/* special handling for character/block devices on macOS, where the
 		   seeking method doesn't determine the size */
@@ -716,6 +731,35 @@ FILE *File_Open(const char *path, const char *mode)
 }
 
 
+/*-----------------------------------------------------------------------*/
+/**
+ * Compressed disk images. File_Read decompresses the data of files that
+ * have been opened with File_OpenCompressed, File_Write fails on them.
+ */
+#if HAVE_LIBZ
+#define FILE_MAX_ZIMAGES 16
+
+typedef struct {
+	FILE   *fp;
+	ZIMAGE *zi;
+} FILE_ZIMAGE;
+
+static FILE_ZIMAGE file_zimages[FILE_MAX_ZIMAGES];
+
+static FILE_ZIMAGE *File_FindCompressed(FILE *fp)
+{
+	int i;
+
+	for (i = 0; i < FILE_MAX_ZIMAGES; i++)
+	{
+		if (file_zimages[i].fp == fp)
+			return &file_zimages[i];
+	}
+	return NULL;
+}
+#endif
+
+
 /*-----------------------------------------------------------------------*/
 /**
  * Close given FILE pointer and return the closed pointer
@@ -725,12 +769,153 @@ FILE *File_Close(FILE *fp)
 {
 	if (fp && fp != stdin && fp != stdout && fp != stderr)
 	{
+		File_Unmap(fp);
+#if HAVE_LIBZ
+		FILE_ZIMAGE *z = File_FindCompressed(fp);
+		if (z)
+		{
+			z->zi = ZImage_Close(z->zi);
+			z->fp = NULL;
+		}
+#endif
 		fclose(fp);
 	}
 	return NULL;
 }
 
 
+/*-----------------------------------------------------------------------*/
+/**
+ * Memory mapped files. File_Read and File_Write copy from and to the
+ * mapping of a file that has been mapped with File_Map.
+ */
+#define FILE_MAX_MAPS 16
+
+typedef struct {
+	FILE    *fp;
+	uint8_t *base;
+	uint64_t size;
+	bool     writable;
+} FILE_MAP;
+
+#if HAVE_SYS_MMAN_H
+static FILE_MAP file_maps[FILE_MAX_MAPS];
+
+static FILE_MAP *File_FindMap(FILE *fp)
+{
+	int i;
+
+	for (i = 0; i < FILE_MAX_MAPS; i++)
+	{
+		if (file_maps[i].fp == fp)
+			return &file_maps[i];
+	}
+	return NULL;
+}
+#else
+static FILE_MAP *File_FindMap(FILE *fp)
+{
+	return NULL;
+}
+#endif
+
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Map a file opened with File_Open into memory. Shared read-only mappings
+ * of the same file share the host page cache. Returns false if the file
+ * can not be mapped, it is then accessed through fp as before.
+ */
+bool File_Map(FILE *fp, bool writable)
+{
+#if HAVE_SYS_MMAN_H
+	FILE_MAP *map;
+	struct stat st;
+	void *base;
+
+	if (!fp || File_FindMap(fp) || !(map = File_FindMap(NULL)))
+		return false;
+	if (fstat(fileno(fp), &st) || !S_ISREG(st.st_mode) || st.st_size == 0)
+		return false;
+
+	fflush(fp);
+	base = mmap(NULL, st.st_size, writable ? PROT_READ|PROT_WRITE : PROT_READ,
+	            MAP_SHARED, fileno(fp), 0);
+	if (base == MAP_FAILED)
+	{
+		fprintf(stderr, "File mapping failed:\n  %s\n", strerror(errno));
+		return false;
+	}
+	map->fp = fp;
+	map->base = base;
+	map->size = st.st_size;
+	map->writable = writable;
+	return true;
+#else
+	return false;
+#endif
+}
+
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Write changes to a mapped file back to disk.
+ */
+void File_Sync(FILE *fp)
+{
+#if HAVE_SYS_MMAN_H
+	FILE_MAP *map = fp ? File_FindMap(fp) : NULL;
+
+	if (map)
+		msync(map->base, map->size, MS_SYNC);
+#endif
+}
+
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Write back and remove the mapping of a file. Called by File_Close.
+ */
+void File_Unmap(FILE *fp)
+{
+#if HAVE_SYS_MMAN_H
+	FILE_MAP *map = fp ? File_FindMap(fp) : NULL;
+
+	if (map)
+	{
+		msync(map->base, map->size, MS_SYNC);
+		munmap(map->base, map->size);
+		map->fp = NULL;
+	}
+#endif
+}
+
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Check if a file opened with File_Open is a compressed disk image and
+ * set up decompression if it is. Returns true for compressed images,
+ * they must be treated as read-only by the caller.
+ */
+bool File_OpenCompressed(FILE *fp)
+{
+#if HAVE_LIBZ
+	FILE_ZIMAGE *z;
+	ZIMAGE *zi;
+
+	if (!fp || File_FindCompressed(fp) || !(z = File_FindCompressed(NULL)))
+		return false;
+	if (!(zi = ZImage_Open(fp)))
+		return false;
+	z->fp = fp;
+	z->zi = zi;
+	return true;
+#else
+	return false;
+#endif
+}
+
+
 /*-----------------------------------------------------------------------*/
 /**
  * Internal lock function for File_Lock() / File_UnLock().
@@ -781,16 +966,85 @@ void File_UnLock(FILE *fp)
 }
 
 
+#if HAVE_PREAD
+/*-----------------------------------------------------------------------*/
+/**
+ * Positioned read and write on the file descriptor. Disk images are only
+ * accessed at explicit offsets, so the stdio buffer would be discarded by
+ * the seek before each access and only adds a copy. Short transfers are
+ * continued. Return false on error or end of file.
+ */
+static bool File_PRead(int fd, uint8_t *data, uint32_t size, uint64_t offset)
+{
+	ssize_t n;
+
+	while (size)
+	{
+		n = pread(fd, data, size, offset);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			return false;
+		data += n;
+		size -= n;
+		offset += n;
+	}
+	return true;
+}
+
+static bool File_PWrite(int fd, const uint8_t *data, uint32_t size, uint64_t offset)
+{
+	ssize_t n;
+
+	while (size)
+	{
+		n = pwrite(fd, data, size, offset);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			return false;
+		data += n;
+		size -= n;
+		offset += n;
+	}
+	return true;
+}
+#endif
+
+
 /*-----------------------------------------------------------------------*/
 /**
  * Read data from given FILE pointer to buffer and return status
  */
 bool File_Read(uint8_t *data, uint32_t size, uint64_t offset, FILE *fp)
 {
+	FILE_MAP *map;
+
 	if (!fp || !data)
 	{
 		return false;
 	}
+#if HAVE_LIBZ
+	FILE_ZIMAGE *z = File_FindCompressed(fp);
+	if (z)
+	{
+		return ZImage_Read(z->zi, data, size, offset);
+	}
+#endif
+	map = File_FindMap(fp);
+	if (map && offset + size <= map->size)
+	{
+		memcpy(data, map->base + offset, size);
+		return true;
+	}
+#if HAVE_PREAD
+	if (!File_PRead(fileno(fp), data, size, offset))
+	{
+		fprintf(stderr, "Error occured while reading file.\n");
+		return false;
+	}
+	return true;
+#else
 	if (fseek(fp, offset, SEEK_SET))
 	{
 		fprintf(stderr, "File seek failed:\n  %s\n", strerror(errno));
@@ -802,6 +1056,7 @@ bool File_Read(uint8_t *data, uint32_t size, uint64_t offset, FILE *fp)
 		return false;
 	}
 	return true;
+#endif
 }
 
 
@@ -811,10 +1066,35 @@ bool File_Read(uint8_t *data, uint32_t size, uint64_t offset, FILE *fp)
  */
 bool File_Write(uint8_t *data, uint32_t size, uint64_t offset, FILE *fp)
 {
+	FILE_MAP *map;
+
 	if (!fp || !data)
 	{
 		return false;
 	}
+#if HAVE_LIBZ
+	if (File_FindCompressed(fp))
+	{
+		fprintf(stderr, "Cannot write to compressed disk image.\n");
+		return false;
+	}
+#endif
+	map = File_FindMap(fp);
+	if (map && map->writable && offset + size <= map->size)
+	{
+		memcpy(map->base + offset, data, size);
+		return true;
+	}
+#if HAVE_PREAD
+	/* Nothing must wait in the stdio buffer of the stream */
+	fflush(fp);
+	if (!File_PWrite(fileno(fp), data, size, offset))
+	{
+		fprintf(stderr, "Error occured while writing file.\n");
+		return false;
+	}
+	return true;
+#else
 	if (fseek(fp, offset, SEEK_SET))
 	{
 		fprintf(stderr, "File seek failed:\n  %s\n", strerror(errno));
@@ -826,6 +1106,7 @@ bool File_Write(uint8_t *data, uint32_t size, uint64_t offset, FILE *fp)
 		return false;
 	}
 	return true;
+#endif
 }
 
 
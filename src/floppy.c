@@ -17,6 +17,7 @@ const char Floppy_fileid[] = "Previous floppy.c";
 #include "floppy.h"
 #include "cycInt.h"
 #include "file.h"
+#include "diskcache.h"
 #include "statusbar.h"
 
 #define LOG_FLP_REG_LEVEL   LOG_DEBUG
@@ -416,8 +417,12 @@ static void floppy_seek_track(uint8_t c, int drive) {
 
 /* Timings */
 #define FLP_SEEK_TIME 200000 /* 200 ms */
+#define FLP_INSTANT_TIME 100 /* sector time for instant I/O */
 
 static int get_sector_time(int drive) {
+    if (ConfigureParams.System.nIOTiming == IO_TIMING_INSTANT) {
+        return FLP_INSTANT_TIME;
+    }
     switch (flpdrv[drive].floppysize) {
         case SIZE_720K: return 22000;
         case SIZE_1440K: return 11000;
@@ -427,6 +432,9 @@ static int get_sector_time(int drive) {
 }
 
 static int get_seek_time(int drive) {
+    if (ConfigureParams.System.nIOTiming == IO_TIMING_INSTANT) {
+        return 0;
+    }
     if (flpdrv[drive].seekoffset > NUM_CYLINDERS) {
         return FLP_SEEK_TIME;
     }
@@ -1032,7 +1040,7 @@ static void floppy_read_sector(void) {
         Log_Printf(LOG_FLP_CMD_LEVEL, "[Floppy] Read sector at offset %i",logical_sec);
 
         flp_buffer.size = flp_buffer.limit = sec_size;
-        File_Read(flp_buffer.data, flp_buffer.size, logical_sec*sec_size, flpdrv[drive].dsk);
+        DiskCache_Read(DISKCACHE_FLOPPY(drive), flp_buffer.data, flp_buffer.size, logical_sec*sec_size, flpdrv[drive].dsk);
         flpdrv[drive].sector++;
         flp_sector_counter--;
     }
@@ -1060,7 +1068,7 @@ static void floppy_write_sector(void) {
     } else {
         Log_Printf(LOG_FLP_CMD_LEVEL, "[Floppy] Write sector at offset %i",logical_sec);
         
-        File_Write(flp_buffer.data, flp_buffer.size, logical_sec*sec_size, flpdrv[drive].dsk);
+        DiskCache_Write(DISKCACHE_FLOPPY(drive), flp_buffer.data, flp_buffer.size, logical_sec*sec_size, flpdrv[drive].dsk);
         flp_buffer.size = 0;
         flp_buffer.limit = sec_size;
         flpdrv[drive].sector++;
@@ -1102,7 +1110,7 @@ static void floppy_format_sector(void) {
         send_rw_status(drive);
     } else {
         Log_Printf(LOG_FLP_CMD_LEVEL, "[Floppy] Format sector at offset %i",logical_sec);
-        File_Write(flp_buffer.data, flp_buffer.size, logical_sec*sec_size, flpdrv[drive].dsk);
+        DiskCache_Write(DISKCACHE_FLOPPY(drive), flp_buffer.data, flp_buffer.size, logical_sec*sec_size, flpdrv[drive].dsk);
         flp_buffer.size = 0;
         flp_buffer.limit = 4;
         flpdrv[drive].sector++;
@@ -1117,49 +1125,55 @@ static void floppy_format_sector(void) {
 
 void FLP_IO_Handler(void) {
     uint32_t old_size;
+    /* With instant timing all sectors the DMA can take move in one go */
+    bool burst = ConfigureParams.System.nIOTiming == IO_TIMING_INSTANT;
     
     CycInt_AcknowledgeInterrupt();
     
     switch (flp_io_state) {
         case FLP_STATE_WRITE:
-            if (flp_buffer.size==flp_buffer.limit) {
-                floppy_write_sector();
-                if (flp_sector_counter==0) { /* done */
-                    floppy_interrupt();
-                    flp_io_state = FLP_STATE_DONE;
-                    return;
-                }
-            } else if (flp_buffer.size<flp_buffer.limit) { /* loop in filling mode */
-                old_size = flp_buffer.size;
-                dma_esp_read_memory();
-                if (flp_buffer.size==old_size) {
-                    floppy_rw_nodata();
-                    floppy_interrupt();
-                    flp_io_state = FLP_STATE_DONE;
-                    return;
+            do {
+                if (flp_buffer.size==flp_buffer.limit) {
+                    floppy_write_sector();
+                    if (flp_sector_counter==0) { /* done */
+                        floppy_interrupt();
+                        flp_io_state = FLP_STATE_DONE;
+                        return;
+                    }
+                } else if (flp_buffer.size<flp_buffer.limit) { /* loop in filling mode */
+                    old_size = flp_buffer.size;
+                    dma_esp_read_memory();
+                    if (flp_buffer.size==old_size) {
+                        floppy_rw_nodata();
+                        floppy_interrupt();
+                        flp_io_state = FLP_STATE_DONE;
+                        return;
+                    }
                 }
-            }
+            } while (burst && (flp_buffer.size==0 || flp_buffer.size==flp_buffer.limit));
             break;
             
         case FLP_STATE_READ:
-            if (flp_buffer.size==0 && flp_sector_counter>0) {
-                floppy_read_sector();
-            }
-            if (flp_buffer.size>0) { /* loop in draining mode */
-                old_size = flp_buffer.size;
-                dma_esp_write_memory();
-                if (flp_buffer.size==old_size) {
-                    floppy_rw_nodata();
+            do {
+                if (flp_buffer.size==0 && flp_sector_counter>0) {
+                    floppy_read_sector();
+                }
+                if (flp_buffer.size>0) { /* loop in draining mode */
+                    old_size = flp_buffer.size;
+                    dma_esp_write_memory();
+                    if (flp_buffer.size==old_size) {
+                        floppy_rw_nodata();
+                        floppy_interrupt();
+                        flp_io_state = FLP_STATE_DONE;
+                        return;
+                    }
+                }
+                if (flp_buffer.size==0 && flp_sector_counter==0) { /* done */
                     floppy_interrupt();
                     flp_io_state = FLP_STATE_DONE;
                     return;
                 }
-            }
-            if (flp_buffer.size==0 && flp_sector_counter==0) { /* done */
-                floppy_interrupt();
-                flp_io_state = FLP_STATE_DONE;
-                return;
-            }
+            } while (burst && flp_buffer.size==0 && flp_io_state==FLP_STATE_READ);
             break;
             
         case FLP_STATE_FORMAT:
@@ -1267,6 +1281,11 @@ int Floppy_Insert(int drive) {
         Statusbar_AddMessage("Cannot insert floppy disk", 0);
         return 1;
     }
+    if (File_OpenCompressed(flpdrv[drive].dsk)) {
+        flpdrv[drive].protected = true;
+    } else if (ConfigureParams.System.bMapDiskImages) {
+        File_Map(flpdrv[drive].dsk, !flpdrv[drive].protected);
+    }
     
     flpdrv[drive].inserted = true;
     flpdrv[drive].spinning = false;
@@ -1286,6 +1305,7 @@ void Floppy_Eject(int drive) {
     
     Log_Printf(LOG_WARN, "Floppy disk %i: Eject",drive);
     
+    DiskCache_Drop(DISKCACHE_FLOPPY(drive));
     flpdrv[drive].dsk = File_Close(flpdrv[drive].dsk);
     flpdrv[drive].floppysize = 0;
     flpdrv[drive].blocksize = 0;
@@ -4,7 +4,8 @@
   This file is distributed under the GNU General Public License, version 2
   or at your option any later version. Read the file gpl.txt for details.
 
-  Grab video or sound output and save it to a PNG or AIFF file.
+  Grab video or sound output and save it to a PNG or AIFF file. Video can
+  also be recorded by piping frames to an external encoder.
 */
 const char Grab_fileid[] = "Previous grab.c";
 
@@ -19,9 +20,11 @@ const char Grab_fileid[] = "Previous grab.c";
 #include "host.h"
 #include "grab.h"
 
+#include <SDL.h>
+#if !defined(WIN32)
+#include <signal.h>
+#endif
 
-#if HAVE_LIBPNG
-#include <png.h>
 
 #define NEXT_SCREEN_HEIGHT 832
 #define NEXT_SCREEN_WIDTH  1120
@@ -33,9 +36,9 @@ const char Grab_fileid[] = "Previous grab.c";
 #endif
 
 /**
- * Convert framebuffer data to RGBA and fill buffer.
+ * Convert framebuffer data to RGBA and fill buffer (1120x832 pixels).
  */
-static bool Grab_FillBuffer(uint8_t* buf) {
+bool Grab_GetFrame(uint8_t* buf) {
 	uint8_t* fb;
 	int i, j;
 	
@@ -83,85 +86,98 @@ static bool Grab_FillBuffer(uint8_t* buf) {
 	return false;
 }
 
+
+#if HAVE_LIBZ
+#include "imgout.h"
+
 /**
- * Create PNG file.
+ * Create PNG file from RGBA data in buf.
  */
-static bool Grab_MakePNG(FILE* fp) {
-	png_structp png_ptr  = NULL;
-	png_infop   info_ptr = NULL;
-	png_text    pngtext;
-	
-	char        key[]    = "Title";
-	char        text[]   = "Previous Screen Grab";
+static bool Grab_MakePNG(FILE* fp, uint8_t* buf) {
+	IMGOUT_PNG* png;
+	int y;
 
-	int         y        = 0;
-	bool        result   = false;
-	
-	off_t       start    = 0;
-	uint8_t*    src_ptr  = NULL;
-	uint8_t*    buf      = malloc(NEXT_SCREEN_WIDTH*NEXT_SCREEN_HEIGHT*4);
-	
-	if (buf) {
-		if (Grab_FillBuffer(buf)) {
-			/* Create and initialize the png_struct with error handler functions. */
-			png_ptr = png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
-			if (png_ptr) {
-				/* Allocate/initialize the image information data. */
-				info_ptr = png_create_info_struct(png_ptr);
-				if (info_ptr) {
-					/* libpng ugliness: Set error handling when not supplying own
-					 * error handling functions in the png_create_write_struct() call.
-					 */
-					if (!setjmp(png_jmpbuf(png_ptr))) {
-						/* store current pos in fp (could be != 0 for avi recording) */
-						start = ftello(fp);
-						
-						/* initialize the png structure */
-						png_init_io(png_ptr, fp);
-						
-						/* image data properties */
-						png_set_IHDR(png_ptr, info_ptr, NEXT_SCREEN_WIDTH, NEXT_SCREEN_HEIGHT, 8, PNG_COLOR_TYPE_RGB_ALPHA,
-									 PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_DEFAULT,
-									 PNG_FILTER_TYPE_DEFAULT);
-						
-						/* image info */
-						pngtext.key = key;
-						pngtext.text = text;
-						pngtext.compression = PNG_TEXT_COMPRESSION_NONE;
-#ifdef PNG_iTXt_SUPPORTED
-						pngtext.lang = NULL;
-#endif
-						png_set_text(png_ptr, info_ptr, &pngtext, 1);
-						
-						/* write the file header information */
-						png_write_info(png_ptr, info_ptr);
-						
-						for (y = 0; y < NEXT_SCREEN_HEIGHT; y++)
-						{		
-							src_ptr = buf + y * NEXT_SCREEN_WIDTH * 4;
-							
-							png_write_row(png_ptr, src_ptr);
-						}
-						
-						/* write the additional chunks to the PNG file */
-						png_write_end(png_ptr, info_ptr);
-						
-						result = true;
-					}
-				}
-				/* handles info_ptr being NULL */
-				png_destroy_write_struct(&png_ptr, &info_ptr);
-			}
+	png = ImgOut_PngBegin(fp, NEXT_SCREEN_WIDTH, NEXT_SCREEN_HEIGHT, 8, IMGOUT_RGBA, 0,
+	                      "Previous Screen Grab");
+	if (!png) {
+		return false;
+	}
+	for (y = 0; y < NEXT_SCREEN_HEIGHT; y++) {
+		ImgOut_PngRow(png, buf + y * NEXT_SCREEN_WIDTH * 4);
+	}
+	return ImgOut_PngEnd(png, false);
+}
+
+/*
+ Screenshots are encoded by a worker thread. Grab_Screen converts VRAM into
+ one of a few pooled buffers and opens the file, so the emulator only waits
+ for that. When all buffers are in use, the PNG is encoded synchronously.
+ */
+#define GRAB_PNG_BUFFERS 4
+
+typedef struct {
+	uint8_t* buf;
+	FILE*    fp;
+	volatile bool busy;  /* Owned by the worker until encoded */
+} GRAB_PNG;
+
+static GRAB_PNG      GrabPng[GRAB_PNG_BUFFERS];
+static int           nGrabPngHead;           /* Next buffer to fill */
+static int           nGrabPngTail;           /* Next buffer to encode, used by worker only */
+static lock_t        GrabPngLock;            /* Serializes callers of Grab_Screen */
+static thread_t*     GrabPngThread;
+static SDL_sem*      GrabPngWake;
+static volatile bool bGrabPngQuit;
+
+/**
+ * Encode and close one screenshot.
+ */
+static void Grab_WritePNG(GRAB_PNG* png) {
+	if (!Grab_MakePNG(png->fp, png->buf)) {
+		Log_Printf(LOG_WARN, "[Grab] Error: Could not create PNG file");
+	}
+	png->fp = File_Close(png->fp);
+}
+
+/**
+ * Worker thread, encodes buffers in the order they were filled. Returns once
+ * all of them are written after Grab_StopPNG.
+ */
+static int Grab_PNGThread(void* unused) {
+	GRAB_PNG* png;
+
+	for (;;) {
+		SDL_SemWait(GrabPngWake);
+		png = &GrabPng[nGrabPngTail];
+		if (png->busy) {
+			Grab_WritePNG(png);
+			nGrabPngTail = (nGrabPngTail + 1) % GRAB_PNG_BUFFERS;
+			png->busy = false;
+		} else if (bGrabPngQuit) {
+			break;
 		}
-		free(buf);
-	}	
-	return result;
+	}
+	return 0;
+}
+
+/**
+ * Wait for pending screenshots and stop the worker thread.
+ */
+static void Grab_StopPNG(void) {
+	if (GrabPngThread) {
+		bGrabPngQuit = true;
+		SDL_SemPost(GrabPngWake);
+		host_thread_wait(GrabPngThread);
+		GrabPngThread = NULL;
+	}
 }
 
 /**
  * Open file and save PNG data to it.
  */
 static void Grab_SaveFile(char* szPathName) {
+	GRAB_PNG* png;
+	GRAB_PNG  tmp;
 	FILE *fp = NULL;
 
 	fp = File_Open(szPathName, "wb");
@@ -169,14 +185,44 @@ static void Grab_SaveFile(char* szPathName) {
 		Log_Printf(LOG_WARN, "[Grab] Error: Could not open file %s", szPathName);
 		return;
 	}
-	
-	if (Grab_MakePNG(fp)) {
+
+	if (!GrabPngThread) {
+		if (!GrabPngWake) {
+			GrabPngWake = SDL_CreateSemaphore(0);
+		}
+		bGrabPngQuit  = false;
+		GrabPngThread = host_thread_create(Grab_PNGThread, "[Previous] Screen grab", NULL);
+	}
+
+	png = &GrabPng[nGrabPngHead];
+	if (!png->buf) {
+		png->buf = malloc(NEXT_SCREEN_WIDTH*NEXT_SCREEN_HEIGHT*4);
+	}
+	if (png->busy || !png->buf || !GrabPngThread) {
+		/* No buffer or no worker available, do it here */
+		tmp.buf = malloc(NEXT_SCREEN_WIDTH*NEXT_SCREEN_HEIGHT*4);
+		tmp.fp  = fp;
+		if (tmp.buf && Grab_GetFrame(tmp.buf)) {
+			Grab_WritePNG(&tmp);
+			Statusbar_AddMessage("Saving screen to file", 0);
+		} else {
+			Log_Printf(LOG_WARN, "[Grab] Error: Could not create PNG file");
+			File_Close(fp);
+		}
+		free(tmp.buf);
+		return;
+	}
+
+	if (Grab_GetFrame(png->buf)) {
+		png->fp   = fp;
+		png->busy = true;
+		nGrabPngHead = (nGrabPngHead + 1) % GRAB_PNG_BUFFERS;
+		SDL_SemPost(GrabPngWake);
 		Statusbar_AddMessage("Saving screen to file", 0);
 	} else {
 		Log_Printf(LOG_WARN, "[Grab] Error: Could not create PNG file");
+		File_Close(fp);
 	}
-	
-	File_Close(fp);
 }
 
 /**
@@ -187,6 +233,7 @@ void Grab_Screen(void) {
 	char szFileName[32];
 	char *szPathName = NULL;
 	
+	host_lock(&GrabPngLock);
 	if (File_DirExists(ConfigureParams.Printer.szPrintToFileName)) {
 		for (i = 0; i < 1000; i++) {
 			snprintf(szFileName, sizeof(szFileName), "next_screen_%03d", i);
@@ -204,15 +251,203 @@ void Grab_Screen(void) {
 			Log_Printf(LOG_WARN, "[Grab] Error: Maximum screen grab count exceeded (%d)", i);
 		}
 	}
+	host_unlock(&GrabPngLock);
 	if (szPathName) {
 		free(szPathName);
 	}
 }
-#else // !HAVE_LIBPNG
+#else // !HAVE_LIBZ
 void Grab_Screen(void) {
-	Log_Printf(LOG_WARN, "[Grab] Screen grab not supported (libpng missing)");
+	Log_Printf(LOG_WARN, "[Grab] Screen grab not supported (zlib missing)");
+}
+
+static void Grab_StopPNG(void) {}
+#endif // HAVE_LIBZ
+
+
+/*
+ Video output
+
+ Each VBL the emulator thread counts a frame and wakes the recorder thread,
+ which converts VRAM to RGBA and writes it to the standard input of the
+ command in Screen.szRecordCommand ("%s" is replaced by the file name). The
+ recorder reads VRAM while the guest runs, so frames may tear. Frames that
+ arrive while the recorder is busy are not converted, the last frame is
+ written again instead to keep the video in sync. The emulator thread never
+ waits for the recorder.
+
+ Frames are 1120x832 RGBA at 68 Hz, for example:
+ ffmpeg -f rawvideo -pix_fmt rgba -s 1120x832 -r 68 -i - -pix_fmt yuv420p %s
+ Hardware encoders are selected with the -c:v option of the command.
+ */
+
+#if defined(WIN32)
+#define popen  _popen
+#define pclose _pclose
+#define POPEN_MODE "wb"
+#else
+#define POPEN_MODE "w"
+#endif
+
+/**
+ * Build an encoder command line, "%s" is replaced by the quoted file name.
+ */
+static char* Grab_MakeCommand(const char* cmd, const char* szPathName) {
+	char* szCommand = malloc(strlen(cmd) + strlen(szPathName) + 3);
+	const char* arg;
+
+	if (szCommand) {
+		arg = strstr(cmd, "%s");
+		if (arg) {
+			sprintf(szCommand, "%.*s\"%s\"%s", (int)(arg - cmd), cmd, szPathName, arg + 2);
+		} else {
+			strcpy(szCommand, cmd);
+		}
+	}
+	return szCommand;
+}
+
+/**
+ * Start an encoder that reads from its standard input.
+ */
+static FILE* Grab_OpenPipe(const char* szCommand) {
+#if !defined(WIN32)
+	/* Let fwrite fail instead of terminating if the encoder exits */
+	signal(SIGPIPE, SIG_IGN);
+#endif
+	return popen(szCommand, POPEN_MODE);
+}
+
+static thread_t*     GrabVideoThread;
+static SDL_sem*      GrabVideoWake;
+static SDL_atomic_t  nVideoFramesPending;  /* Frames counted since the recorder last woke up */
+static FILE*         VideoPipe;            /* Standard input of the encoder */
+static int           nVideoFramesDropped;  /* Frames replaced by a copy of the previous one */
+static volatile bool bRecordingVideo = false;
+
+/**
+ * Recorder thread.
+ */
+static int Grab_VideoThread(void* unused) {
+	uint8_t* buf = malloc(NEXT_SCREEN_WIDTH*NEXT_SCREEN_HEIGHT*4);
+	int n;
+
+	if (!buf) {
+		Log_Printf(LOG_WARN, "[Grab] Error: Cannot allocate video buffer");
+		return 0;
+	}
+	while (bRecordingVideo) {
+		SDL_SemWait(GrabVideoWake);
+		n = SDL_AtomicSet(&nVideoFramesPending, 0);
+		if (n <= 0) {
+			continue;
+		}
+		if (!Grab_GetFrame(buf)) {
+			memset(buf, 0, NEXT_SCREEN_WIDTH*NEXT_SCREEN_HEIGHT*4);
+		}
+		nVideoFramesDropped += n - 1;
+		while (n--) {
+			if (fwrite(buf, NEXT_SCREEN_WIDTH*NEXT_SCREEN_HEIGHT*4, 1, VideoPipe) != 1) {
+				Log_Printf(LOG_WARN, "[Grab] Error: Video encoder stopped accepting frames");
+				bRecordingVideo = false;
+				break;
+			}
+		}
+	}
+	free(buf);
+	return 0;
+}
+
+/**
+ * Stop the recorder thread and close the encoder.
+ */
+static void Grab_CloseVideo(void) {
+	if (GrabVideoThread) {
+		bRecordingVideo = false;
+		SDL_SemPost(GrabVideoWake);
+		host_thread_wait(GrabVideoThread);
+		GrabVideoThread = NULL;
+
+		pclose(VideoPipe);
+		VideoPipe = NULL;
+
+		Log_Printf(LOG_WARN, "[Grab] Stopping video record (%d frames dropped)", nVideoFramesDropped);
+		Statusbar_AddMessage("Stop saving video to file", 0);
+	}
+}
+
+/**
+ * Start the encoder and the recorder thread.
+ */
+static void Grab_OpenVideo(void) {
+	int i;
+	char szFileName[32];
+	char *szPathName = NULL;
+	char *szCommand  = NULL;
+	const char* cmd  = ConfigureParams.Screen.szRecordCommand;
+
+	if (!File_DirExists(ConfigureParams.Printer.szPrintToFileName)) {
+		return;
+	}
+
+	/* Build file name */
+	for (i = 0; i < 1000; i++) {
+		snprintf(szFileName, sizeof(szFileName), "next_video_%03d", i);
+		szPathName = File_MakePath(ConfigureParams.Printer.szPrintToFileName, szFileName, ".mp4");
+
+		if (File_Exists(szPathName)) {
+			free(szPathName);
+			szPathName = NULL;
+			continue;
+		}
+		break;
+	}
+	if (!szPathName) {
+		Log_Printf(LOG_WARN, "[Grab] Error: Maximum video grab count exceeded (%d)", i);
+		return;
+	}
+
+	szCommand = Grab_MakeCommand(cmd, szPathName);
+	if (szCommand) {
+		VideoPipe = Grab_OpenPipe(szCommand);
+		if (VideoPipe) {
+			nVideoFramesDropped = 0;
+			SDL_AtomicSet(&nVideoFramesPending, 0);
+			/* Kept for good, the emulator thread may still post to it */
+			if (!GrabVideoWake) {
+				GrabVideoWake = SDL_CreateSemaphore(0);
+			}
+			bRecordingVideo = true;
+			GrabVideoThread = host_thread_create(Grab_VideoThread, "[Previous] Video recorder", NULL);
+			Log_Printf(LOG_WARN, "[Grab] Starting video record: %s", szCommand);
+			Statusbar_AddMessage("Start saving video to file", 0);
+		} else {
+			Log_Printf(LOG_WARN, "[Grab] Failed to start video encoder: %s", szCommand);
+		}
+		free(szCommand);
+	}
+	free(szPathName);
+}
+
+/**
+ * Count a video frame, called every VBL.
+ */
+void Grab_VideoFrame(void) {
+	if (bRecordingVideo && SDL_AtomicAdd(&nVideoFramesPending, 1) == 0) {
+		SDL_SemPost(GrabVideoWake);
+	}
+}
+
+/**
+ * Start/Stop recording video. Does nothing without an encoder command.
+ */
+void Grab_VideoToggle(void) {
+	if (GrabVideoThread) {
+		Grab_CloseVideo();
+	} else if (ConfigureParams.Screen.szRecordCommand[0]) {
+		Grab_OpenVideo();
+	}
 }
-#endif // HAVE_LIBPNG
 
 
 /*
@@ -245,12 +480,28 @@ void Grab_Screen(void) {
  16 - end Data (Samples)
  */
 
-static lock_t GrabSoundLock;               /* Protect AIFF file and variables */
+static lock_t GrabSoundLock;               /* Protect the recording state */
 
 static FILE*  AiffFileHndl;                /* Pointer to our AIFF file */
+static FILE*  SoundPipe;                   /* Standard input of the encoder */
 static int    nAiffOutputBytes;            /* Number of sample bytes saved */
 volatile bool bRecordingAiff = false;      /* Is an AIFF file open and recording? */
 
+/* Samples are passed to the writer thread through a ring buffer, so the
+ * emulator thread never waits for the file system. It is written in large
+ * batches, samples that do not fit are dropped. */
+#define GRAB_SOUND_BUFFER  (1<<18)         /* 1.5 seconds */
+#define GRAB_SOUND_MASK    (GRAB_SOUND_BUFFER-1)
+#define GRAB_SOUND_BATCH   (1<<15)         /* Wake the writer after this many bytes */
+
+static uint8_t       SoundBuffer[GRAB_SOUND_BUFFER];
+static SDL_atomic_t  nSoundBufferWr;       /* Bytes written, owned by the emulator thread */
+static SDL_atomic_t  nSoundBufferRd;       /* Bytes read, owned by the writer thread */
+static int           nSoundBytesDropped;
+static thread_t*     GrabSoundThread;
+static SDL_sem*      GrabSoundWake;
+static volatile bool bSoundWriterRunning = false;
+
 static uint8_t AiffHeader[54] =
 {
 	/* Format chunk */
@@ -274,6 +525,51 @@ static uint8_t AiffHeader[54] =
 };
 
 
+/**
+ * Write all buffered samples to the file or encoder. Returns false on error.
+ */
+static bool Grab_WriteSoundBuffer(void) {
+	FILE*    out = SoundPipe ? SoundPipe : AiffFileHndl;
+	uint32_t rd  = SDL_AtomicGet(&nSoundBufferRd);
+	uint32_t wr  = SDL_AtomicGet(&nSoundBufferWr);
+	uint32_t len;
+
+	while (rd != wr) {
+		/* At most up to the end of the buffer */
+		len = wr - rd;
+		if (len > GRAB_SOUND_BUFFER - (rd & GRAB_SOUND_MASK)) {
+			len = GRAB_SOUND_BUFFER - (rd & GRAB_SOUND_MASK);
+		}
+		if (fwrite(SoundBuffer + (rd & GRAB_SOUND_MASK), len, 1, out) != 1) {
+			return false;
+		}
+		nAiffOutputBytes += len;
+		rd += len;
+		SDL_AtomicSet(&nSoundBufferRd, rd);
+	}
+	return true;
+}
+
+/**
+ * Writer thread.
+ */
+static int Grab_SoundThread(void* unused) {
+	bool ok = true;
+
+	while (bSoundWriterRunning) {
+		SDL_SemWaitTimeout(GrabSoundWake, 100);
+		if (ok && !Grab_WriteSoundBuffer()) {
+			perror("[Grab] Grab_SoundThread:");
+			ok = false;
+		}
+	}
+	/* Recording has stopped, nothing is added anymore */
+	if (ok && !Grab_WriteSoundBuffer()) {
+		perror("[Grab] Grab_SoundThread:");
+	}
+	return 0;
+}
+
 /**
  * Write sizes to AIFF header, then close the AIFF file.
  */
@@ -283,14 +579,28 @@ static void Grab_CloseSoundFile(void)
 	uint32_t nAiffDataBytes;
 	uint32_t nAiffSamples;
 	
-	if (bRecordingAiff)
-	{
-		bRecordingAiff = false;
-		
+	host_lock(&GrabSoundLock);
+	if (!bRecordingAiff) {
+		host_unlock(&GrabSoundLock);
+		return;
+	}
+	bRecordingAiff = false;
+	host_unlock(&GrabSoundLock);
+	
+	/* Let the writer thread save what is left */
+	bSoundWriterRunning = false;
+	SDL_SemPost(GrabSoundWake);
+	host_thread_wait(GrabSoundThread);
+	GrabSoundThread = NULL;
+	
+	if (SoundPipe) {
+		pclose(SoundPipe);
+		SoundPipe = NULL;
+	} else {
 		/* Update headers with sizes */
 		nAiffFileBytes = 46+nAiffOutputBytes; /* length of headers minus 8 bytes plus length of data */
 		nAiffDataBytes = 8+nAiffOutputBytes;  /* length of data plus 8 bytes */
-		nAiffSamples   = nAiffOutputBytes/2;  /* length of data divided by bytes per sample */
+		nAiffSamples   = nAiffOutputBytes/4;  /* length of data divided by bytes per frame */
 		
 		/* Patch length of file in header structure */
 		AiffHeader[4] = (uint8_t)((nAiffFileBytes >> 24) & 0xff);
@@ -303,7 +613,7 @@ static void Grab_CloseSoundFile(void)
 		AiffHeader[23] = (uint8_t)((nAiffSamples >> 16) & 0xff);
 		AiffHeader[24] = (uint8_t)((nAiffSamples >>  8) & 0xff);
 		AiffHeader[25] = (uint8_t)((nAiffSamples >>  0) & 0xff);
-
+		
 		/* Patch length of data in header structure */
 		AiffHeader[42] = (uint8_t)((nAiffDataBytes >> 24) & 0xff);
 		AiffHeader[43] = (uint8_t)((nAiffDataBytes >> 16) & 0xff);
@@ -318,21 +628,45 @@ static void Grab_CloseSoundFile(void)
 		
 		/* Close file */
 		AiffFileHndl = File_Close(AiffFileHndl);
-		
-		/* And inform user */
-		Log_Printf(LOG_WARN, "[Grab] Stopping sound record");
-		Statusbar_AddMessage("Stop saving sound to file", 0);
 	}
+	
+	/* And inform user */
+	Log_Printf(LOG_WARN, "[Grab] Stopping sound record (%d bytes dropped)", nSoundBytesDropped);
+	Statusbar_AddMessage("Stop saving sound to file", 0);
 }
 
 /**
- * Open AIFF output file and write header.
+ * Return the extension an encoder command appends to the file name, for
+ * example ".flac" for "-o %s.flac".
+ */
+static void Grab_CommandExtension(const char* cmd, char* ext, size_t size) {
+	const char* arg = strstr(cmd, "%s");
+	size_t len = 0;
+
+	if (arg && arg[2] == '.') {
+		arg += 2;
+		while (arg[len] && arg[len] != ' ' && arg[len] != '"' && arg[len] != '\'' && len < size - 1) {
+			len++;
+		}
+		memcpy(ext, arg, len);
+	}
+	ext[len] = '\0';
+}
+
+/**
+ * Open AIFF output file and write header or start the encoder in
+ * Sound.szRecordCommand ("%s" is replaced by the file name without
+ * extension). The encoder reads raw 16-bit big endian stereo samples
+ * at 44.1 kHz.
  */
 static void Grab_OpenSoundFile(void)
 {
 	int i;
 	char szFileName[32];
+	char szExt[16];
 	char *szPathName = NULL;
+	char *szCommand  = NULL;
+	const char* cmd  = ConfigureParams.Sound.szRecordCommand;
 	
 	if (bRecordingAiff) {
 		Grab_CloseSoundFile();
@@ -343,11 +677,18 @@ static void Grab_OpenSoundFile(void)
 	if (File_DirExists(ConfigureParams.Printer.szPrintToFileName)) {
 		
 		/* Build file name */
+		if (cmd[0]) {
+			Grab_CommandExtension(cmd, szExt, sizeof(szExt));
+		} else {
+			strcpy(szExt, ".aiff");
+		}
 		for (i = 0; i < 1000; i++) {
 			snprintf(szFileName, sizeof(szFileName), "next_sound_%03d", i);
-			szPathName = File_MakePath(ConfigureParams.Printer.szPrintToFileName, szFileName, ".aiff");
+			szPathName = File_MakePath(ConfigureParams.Printer.szPrintToFileName, szFileName, szExt);
 			
 			if (File_Exists(szPathName)) {
+				free(szPathName);
+				szPathName = NULL;
 				continue;
 			}
 			break;
@@ -358,50 +699,94 @@ static void Grab_OpenSoundFile(void)
 			goto done;
 		}
 		
-		/* Create our file */
-		AiffFileHndl = File_Open(szPathName, "wb");
-		if (!AiffFileHndl)
-		{
-			Log_Printf(LOG_WARN, "[Grab] Failed to create sound file %s: ", szPathName);
-			goto done;
+		if (cmd[0]) {
+			/* Start the encoder, it appends the extension itself */
+			free(szPathName);
+			szPathName = File_MakePath(ConfigureParams.Printer.szPrintToFileName, szFileName, NULL);
+			if (!szPathName) {
+				goto done;
+			}
+			szCommand = Grab_MakeCommand(cmd, szPathName);
+			if (!szCommand) {
+				goto done;
+			}
+			SoundPipe = Grab_OpenPipe(szCommand);
+			if (!SoundPipe) {
+				Log_Printf(LOG_WARN, "[Grab] Failed to start sound encoder: %s", szCommand);
+				goto done;
+			}
+		} else {
+			/* Create our file */
+			AiffFileHndl = File_Open(szPathName, "wb");
+			if (!AiffFileHndl)
+			{
+				Log_Printf(LOG_WARN, "[Grab] Failed to create sound file %s: ", szPathName);
+				goto done;
+			}
+			
+			/* Write header to file */
+			if (!File_Write(AiffHeader, sizeof(AiffHeader), 0, AiffFileHndl))
+			{
+				perror("[Grab] Grab_OpenSoundFile:");
+				AiffFileHndl = File_Close(AiffFileHndl);
+				goto done;
+			}
 		}
 		
-		/* Write header to file */
-		if (File_Write(AiffHeader, sizeof(AiffHeader), 0, AiffFileHndl))
-		{
-			bRecordingAiff = true;
-			Log_Printf(LOG_WARN, "[Grab] Starting sound record");
-			Statusbar_AddMessage("Start saving sound to file", 0);
-		}
-		else
-		{
-			perror("[Grab] Grab_OpenSoundFile:");
+		/* Start the writer thread */
+		nSoundBytesDropped = 0;
+		SDL_AtomicSet(&nSoundBufferWr, 0);
+		SDL_AtomicSet(&nSoundBufferRd, 0);
+		/* Kept for good, the emulator thread may still post to it */
+		if (!GrabSoundWake) {
+			GrabSoundWake = SDL_CreateSemaphore(0);
 		}
+		bSoundWriterRunning = true;
+		GrabSoundThread = host_thread_create(Grab_SoundThread, "[Previous] Sound recorder", NULL);
+		
+		host_lock(&GrabSoundLock);
+		bRecordingAiff = true;
+		host_unlock(&GrabSoundLock);
+		
+		Log_Printf(LOG_WARN, "[Grab] Starting sound record");
+		Statusbar_AddMessage("Start saving sound to file", 0);
 		
 	done:
-		if (szPathName) {
-			free(szPathName);
-		}
+		free(szCommand);
+		free(szPathName);
 	}
 }
 
 /**
- * Update AIFF file with current samples.
+ * Queue samples for the writer thread.
  */
 void Grab_Sound(uint8_t* samples, int len)
 {
+	uint32_t wr, rd, space, n;
+	
 	host_lock(&GrabSoundLock);
 	if (bRecordingAiff)
 	{
-		/* Append samples to our AIFF file */
-		if (fwrite(samples, len, 1, AiffFileHndl) != 1)
-		{
-			perror("[Grab] Grab_Sound:");
-			Grab_CloseSoundFile();
+		wr   = SDL_AtomicGet(&nSoundBufferWr);
+		rd   = SDL_AtomicGet(&nSoundBufferRd);
+		space = GRAB_SOUND_BUFFER - (wr - rd);
+		if ((uint32_t)len > space) {
+			/* Keep whole frames */
+			nSoundBytesDropped += len - (space & ~3);
+			len = space & ~3;
+		}
+		n = GRAB_SOUND_BUFFER - (wr & GRAB_SOUND_MASK);
+		if (n > (uint32_t)len) {
+			n = len;
+		}
+		memcpy(SoundBuffer + (wr & GRAB_SOUND_MASK), samples, n);
+		memcpy(SoundBuffer, samples + n, len - n);
+		SDL_AtomicSet(&nSoundBufferWr, wr + len);
+		
+		/* Wake the writer when a batch is complete */
+		if ((wr - rd) < GRAB_SOUND_BATCH && (wr + len - rd) >= GRAB_SOUND_BATCH) {
+			SDL_SemPost(GrabSoundWake);
 		}
-
-		/* Add samples to AIFF file length counter */
-		nAiffOutputBytes += len;
 	}
 	host_unlock(&GrabSoundLock);
 }
@@ -410,20 +795,18 @@ void Grab_Sound(uint8_t* samples, int len)
  * Start/Stop recording sound.
  */
 void Grab_SoundToggle(void) {
-	host_lock(&GrabSoundLock);
 	if (bRecordingAiff) {
 		Grab_CloseSoundFile();
 	} else {
 		Grab_OpenSoundFile();
 	}
-	host_unlock(&GrabSoundLock);
 }
 
 /**
  * Stop any recording activities.
  */
 void Grab_Stop(void) {
-	host_lock(&GrabSoundLock);
 	Grab_CloseSoundFile();
-	host_unlock(&GrabSoundLock);
+	Grab_CloseVideo();
+	Grab_StopPNG();
 }
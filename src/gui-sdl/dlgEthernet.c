@@ -16,6 +16,7 @@ const char DlgEthernet_fileid[] = "Previous dlgEthernet.c";
 Uint8 mac_addr[6];
 char mac_addr_string[20] = "00:00:0f:00:00:00";
 char nfs_root_string[64] = "";
+char enet_speed_string[16] = "";
 
 #if HAVE_PCAP
 #define DLGENET_ENABLE      4
@@ -33,6 +34,8 @@ char nfs_root_string[64] = "";
 
 #define DLGENET_EXIT        21
 
+#define DLGENET_SPEED       25
+
 #define PCAP_INTERFACE_LEN  19
 
 char pcap_interface[PCAP_INTERFACE_LEN] = "PCAP";
@@ -41,7 +44,7 @@ char pcap_interface[PCAP_INTERFACE_LEN] = "PCAP";
 /* The Ethernet options dialog: */
 static SGOBJ enetdlg[] =
 {
-	{ SGBOX, 0, 0, 0,0, 51,29, NULL },
+	{ SGBOX, 0, 0, 0,0, 51,33, NULL },
 	{ SGTEXT, 0, 0, 18,1, 15,1, "Network options" },
 	
 	{ SGBOX, 0, 0, 1,3, 24,9, NULL },
@@ -66,9 +69,14 @@ static SGOBJ enetdlg[] =
 	{ SGBUTTON, 0, 0, 37,18, 10,1, "Browse" },
 	{ SGTEXT, 0, 0, 3,20, 44,1, nfs_root_string },
 
-	{ SGTEXT, 0, 0, 4,23, 22,1, "Note: PCAP requires super user privileges." },
+	{ SGTEXT, 0, 0, 4,27, 22,1, "Note: PCAP requires super user privileges." },
+	
+	{ SGBUTTON, SG_DEFAULT, 0, 15,30, 21,1, "Back to main menu" },
 	
-	{ SGBUTTON, SG_DEFAULT, 0, 15,26, 21,1, "Back to main menu" },
+	{ SGBOX, 0, 0, 1,22, 49,3, NULL },
+	{ SGTEXT, 0, 0, 3,23, 15,1, "Transfer speed:" },
+	{ SGTEXT, 0, 0, 19,23, 15,1, enet_speed_string },
+	{ SGBUTTON, 0, 0, 37,23, 10,1, "Select" },
 	{ SGSTOP, 0, 0, 0,0, 0,0, NULL }
 };
 #else // !HAVE_PCAP
@@ -80,11 +88,12 @@ static SGOBJ enetdlg[] =
 #define DLGENET_NFSBROWSE   13
 #define DLGENET_NFSROOT     14
 #define DLGENET_EXIT        15
+#define DLGENET_SPEED       19
 
 /* The Ethernet options dialog: */
 static SGOBJ enetdlg[] =
 {
-	{ SGBOX, 0, 0, 0,0, 53,23, NULL },
+	{ SGBOX, 0, 0, 0,0, 53,27, NULL },
 	{ SGTEXT, 0, 0, 19,1, 16,1, "Network options" },
 	
 	{ SGBOX, 0, 0, 1,3, 25,9, NULL },
@@ -103,7 +112,12 @@ static SGOBJ enetdlg[] =
 	{ SGBUTTON, 0, 0, 40,14, 10,1, "Browse" },
 	{ SGTEXT, 0, 0, 3,16, 47,1, nfs_root_string },
 	
-	{ SGBUTTON, SG_DEFAULT, 0, 16,20, 21,1, "Back to main menu" },
+	{ SGBUTTON, SG_DEFAULT, 0, 16,24, 21,1, "Back to main menu" },
+	
+	{ SGBOX, 0, 0, 1,19, 51,3, NULL },
+	{ SGTEXT, 0, 0, 3,20, 15,1, "Transfer speed:" },
+	{ SGTEXT, 0, 0, 19,20, 15,1, enet_speed_string },
+	{ SGBUTTON, 0, 0, 40,20, 10,1, "Select" },
 	{ SGSTOP, 0, 0, 0,0, 0,0, NULL }
 };
 #endif
@@ -142,7 +156,10 @@ void DlgEthernet_Main(void)
 		enetdlg[DLGENET_PCAP].state |= SG_SELECTED;
 		snprintf(pcap_interface, PCAP_INTERFACE_LEN, "PCAP: %.12s", ConfigureParams.Ethernet.szInterfaceName);
 	} else {
-		enetdlg[DLGENET_SLIRP].state |= SG_SELECTED;
+		/* A TAP device can only be selected in the configuration file */
+		if (ConfigureParams.Ethernet.nHostInterface == ENET_SLIRP) {
+			enetdlg[DLGENET_SLIRP].state |= SG_SELECTED;
+		}
 		snprintf(pcap_interface, sizeof(pcap_interface), "PCAP");
 	}
 #endif
@@ -162,6 +179,8 @@ void DlgEthernet_Main(void)
 		
 		snprintf(mac_addr_string, sizeof(mac_addr_string), "%02x:%02x:%02x:%02x:%02x:%02x",
 		         mac_addr[0],mac_addr[1],mac_addr[2],mac_addr[3],mac_addr[4],mac_addr[5]);
+		snprintf(enet_speed_string, sizeof(enet_speed_string), "%s",
+		         ConfigureParams.Ethernet.bUnlimitedSpeed ? "Unlimited" : "10 Mbit/s");
 
 		but = SDLGui_DoDialog(enetdlg);
 		
@@ -201,6 +220,9 @@ void DlgEthernet_Main(void)
 			case DLGENET_MAC:
 				DlgEthernetAdvanced_ConfigureMAC(mac_addr);
 				break;
+			case DLGENET_SPEED:
+				DlgEthernetAdvanced_ConfigureSpeed();
+				break;
 			case DLGENET_NFSBROWSE:
 				SDLGui_DirConfSelect(nfs_root_string,
 				                     ConfigureParams.Ethernet.szNFSroot,
@@ -222,7 +244,7 @@ void DlgEthernet_Main(void)
 #if HAVE_PCAP
 	if (enetdlg[DLGENET_PCAP].state & SG_SELECTED) {
 		ConfigureParams.Ethernet.nHostInterface = ENET_PCAP;
-	} else {
+	} else if (enetdlg[DLGENET_SLIRP].state & SG_SELECTED) {
 		ConfigureParams.Ethernet.nHostInterface = ENET_SLIRP;
 	}
 #endif
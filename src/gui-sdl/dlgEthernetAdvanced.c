@@ -220,3 +220,53 @@ void DlgEthernetAdvanced_ConfigureMAC(Uint8 *mac)
 		ConfigureParams.Rom.bUseCustomMac = false;
 	}
 }
+
+
+#define DLGENETSPEED_NORMAL 2
+#define DLGENETSPEED_FAST   3
+#define DLGENETSPEED_OK     5
+
+/* The Ethernet speed options dialog: */
+static SGOBJ enetspeeddlg[] =
+{
+	{ SGBOX, 0, 0, 0,0, 46,11, NULL },
+	{ SGTEXT, 0, 0, 2,1, 30,1, "Select Ethernet transfer speed:" },
+	
+	{ SGRADIOBUT, 0, 0, 4,3, 25,1, "Like 10 Mbit/s hardware" },
+	{ SGRADIOBUT, 0, 0, 4,5, 11,1, "Unlimited" },
+	{ SGTEXT, 0, 0, 6,6, 38,1, "(may break guest timing diagnostics)" },
+	
+	{ SGBUTTON, SG_DEFAULT, 0, 17,9, 10,1, "OK" },
+	
+	{ SGSTOP, 0, 0, 0,0, 0,0, NULL }
+};
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Show and process the Ethernet speed options dialog.
+ */
+void DlgEthernetAdvanced_ConfigureSpeed(void)
+{
+	int but;
+	
+	SDLGui_CenterDlg(enetspeeddlg);
+	
+	enetspeeddlg[DLGENETSPEED_NORMAL].state &= ~SG_SELECTED;
+	enetspeeddlg[DLGENETSPEED_FAST].state &= ~SG_SELECTED;
+	
+	if (ConfigureParams.Ethernet.bUnlimitedSpeed) {
+		enetspeeddlg[DLGENETSPEED_FAST].state |= SG_SELECTED;
+	} else {
+		enetspeeddlg[DLGENETSPEED_NORMAL].state |= SG_SELECTED;
+	}
+	
+	do
+	{
+		but = SDLGui_DoDialog(enetspeeddlg);
+	}
+	while (but != DLGENETSPEED_OK && but != SDLGUI_QUIT &&
+		   but != SDLGUI_ERROR && !bQuitProgram);
+	
+	/* Read values from dialog */
+	ConfigureParams.Ethernet.bUnlimitedSpeed = enetspeeddlg[DLGENETSPEED_FAST].state & SG_SELECTED;
+}
@@ -17,6 +17,7 @@ const char DlgFileSelect_fileid[] = "Hatari dlgFileSelect.c";
 #endif
 
 #include "main.h"
+#include "host.h"
 #include "scandir.h"
 #include "sdlgui.h"
 #include "file.h"
@@ -134,7 +135,7 @@ static int mouseClicked = 0;			/* used to know if mouse if down for the first ti
 static int mouseIsOut = 0;			/* used to keep info that mouse if above or under the scrollbar when mousebutton is down */
 static float scrollbar_Ypos = 0.0;		/* scrollbar height */
 
-static char *dirpath;				/* for get_dtype() */
+static int dirs;				/* How many of them are directories? They are listed first */
 #if !defined(HAVE_DIRENT_D_TYPE) && !defined(DT_UNKNOWN)
 enum {
 	DT_UNKNOWN,
@@ -144,6 +145,42 @@ enum {
 };
 #endif
 
+/* Directories are read by a background thread, so that the dialog stays
+ * responsive on huge or slow directories.  Complete listings are cached
+ * together with the entry types, keyed by path and directory mtime, so
+ * that returning to a directory needs neither readdir() nor stat().
+ */
+#define DIRCACHE_SIZE     8
+#define DIRSCAN_BATCH_US  100000	/* Min. time between partial results */
+
+typedef struct {
+	char *name;
+	bool isdir;
+} dirinfo_t;
+
+typedef struct {
+	char *path;
+	time_t mtime;
+	dirinfo_t *list;
+	int count;
+	int size;
+	unsigned int stamp;			/* For LRU replacement in cache */
+} dirlist_t;
+
+static dirlist_t dircache[DIRCACHE_SIZE];
+static unsigned int dircache_stamp;
+
+static struct {
+	thread_t *thread;
+	lock_t lock;				/* Protects the fields below */
+	dirlist_t dir;				/* Entries read so far */
+	bool done;
+	bool failed;
+	bool abort;
+	bool notified;				/* Wake-up event is pending */
+} dirscan;
+static Uint32 dirscan_event;			/* SDL event type for scanner wake-ups */
+
 /* Convert file position (in file list) to scrollbar y position */
 static void DlgFileSelect_Convert_ypos_to_scrollbar_Ypos(void);
 
@@ -170,7 +207,6 @@ static int DlgFileSelect_RefreshEntries(struct dirent **files, char *path, bool
 	{
 		if (i+ypos < entries)
 		{
-			struct stat filestat;
 			/* Prepare entries: */
 			strcpy(tempstr, "  ");
 			strcat(tempstr, files[i+ypos]->d_name);
@@ -186,7 +222,7 @@ static int DlgFileSelect_RefreshEntries(struct dirent **files, char *path, bool
 			}
 			else
 			{
-				if( stat(tempstr, &filestat)==0 && S_ISDIR(filestat.st_mode) )
+				if (i+ypos < dirs)
 					dlgfilenames[i][0] = SGFOLDER;    /* Mark folders */
 				if (ZIP_FileNameIsZIP(tempstr) && browsingzip == false)
 					dlgfilenames[i][0] = SGFOLDER;    /* Mark .ZIP archives as folders */
@@ -387,6 +423,8 @@ static bool acceptEvents(SDL_EventType evtype)
 {
 	if (evtype == SDL_MOUSEWHEEL || evtype == SDL_KEYDOWN)
 		return true;
+	if (dirscan_event && evtype == dirscan_event)
+		return true;
 	return false;
 }
 
@@ -494,51 +532,319 @@ static int strcat_maxlen(char *dst, int maxlen, const char *src, const char *add
  * Get given file's type, directory or a file.
  * (if name itself is symlink, stat() checks file it points to)
  */
-static int get_dtype(const char *name)
+static int get_dtype(const char *dirname, const char *name)
 {
 	struct stat buf;
 	char path[FILENAME_MAX];
 
-	snprintf(path, sizeof(path), "%s%c%s", dirpath, PATHSEP, name);
+	snprintf(path, sizeof(path), "%s%c%s", dirname, PATHSEP, name);
 	if (stat(path, &buf) == 0 && S_ISDIR(buf.st_mode))
 		return DT_DIR;
 	else
 		return DT_REG;
 }
 
+/*-----------------------------------------------------------------------*/
+/**
+ * Free a directory listing.
+ */
+static void dirlist_free(dirlist_t *dir)
+{
+	int i;
+
+	for (i = 0; i < dir->count; i++)
+		free(dir->list[i].name);
+	free(dir->list);
+	free(dir->path);
+	memset(dir, 0, sizeof(*dir));
+}
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Append an entry to a directory listing. Returns false if out of memory.
+ */
+static bool dirlist_add(dirlist_t *dir, const char *name, bool isdir)
+{
+	if (dir->count == dir->size)
+	{
+		int size = dir->size ? 2 * dir->size : 64;
+		dirinfo_t *list = realloc(dir->list, size * sizeof(*list));
+		if (!list)
+			return false;
+		dir->list = list;
+		dir->size = size;
+	}
+	dir->list[dir->count].name = strdup(name);
+	if (!dir->list[dir->count].name)
+		return false;
+	dir->list[dir->count].isdir = isdir;
+	dir->count++;
+	return true;
+}
+
 /*-----------------------------------------------------------------------*/
 /**
  * Case insensitive sorting for directory entry names, so
  * that directory entries are listed first.
  */
-static int filesort(const struct dirent **d1, const struct dirent **d2)
+static int dirinfo_sort(const void *p1, const void *p2)
 {
-	const char *name1 = (*d1)->d_name;
-	const char *name2 = (*d2)->d_name;
-#ifndef HAVE_DIRENT_D_TYPE
-	int type1 = DT_UNKNOWN;
-	int type2 = DT_UNKNOWN;
-#else
-	int type1 = (*d1)->d_type;
-	int type2 = (*d2)->d_type;
+	const dirinfo_t *d1 = p1;
+	const dirinfo_t *d2 = p2;
+
+	if (d1->isdir != d2->isdir)
+		return d1->isdir ? -1 : 1;
+	return strcasecmp(d1->name, d2->name);
+}
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Build the dialog's file list from a (possibly incomplete) directory
+ * listing. Sets entries and dirs accordingly.
+ */
+static struct dirent **DlgFileSelect_ListFromDir(dirlist_t *dir, bool showhidden)
+{
+	struct dirent **files;
+	int i;
+
+	entries = dirs = 0;
+
+	qsort(dir->list, dir->count, sizeof(dir->list[0]), dirinfo_sort);
+
+	files = malloc((dir->count + 1) * sizeof(*files));
+	if (!files)
+		return NULL;
+
+	for (i = 0; i < dir->count; i++)
+	{
+		/* Does file name start with a dot? -> hidden file! */
+		if (!showhidden && dir->list[i].name[0] == '.')
+			continue;
+		files[entries] = malloc(sizeof(struct dirent));
+		if (!files[entries])
+			break;
+		Str_Copy(files[entries]->d_name, dir->list[i].name, sizeof(files[entries]->d_name));
+		if (dir->list[i].isdir)
+			dirs++;
+		entries++;
+	}
+	return files;
+}
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Look up a directory listing in the cache. The listing is only valid
+ * as long as the directory has not been modified since it was read.
+ */
+static dirlist_t *DlgFileSelect_CacheLookup(const char *path, time_t mtime)
+{
+	int i;
+
+	for (i = 0; i < DIRCACHE_SIZE; i++)
+	{
+		if (dircache[i].path && dircache[i].mtime == mtime &&
+		    strcmp(dircache[i].path, path) == 0)
+		{
+			dircache[i].stamp = ++dircache_stamp;
+			return &dircache[i];
+		}
+	}
+	return NULL;
+}
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Move a complete directory listing into the cache, replacing an older
+ * listing of the same directory or else the least recently used one.
+ */
+static void DlgFileSelect_CacheInsert(dirlist_t *dir)
+{
+	dirlist_t *victim = NULL;
+	int i;
+
+	for (i = 0; i < DIRCACHE_SIZE && !victim; i++)
+	{
+		if (dircache[i].path && strcmp(dircache[i].path, dir->path) == 0)
+			victim = &dircache[i];
+	}
+	if (!victim)
+	{
+		/* Empty slots have stamp 0 */
+		victim = &dircache[0];
+		for (i = 1; i < DIRCACHE_SIZE; i++)
+		{
+			if (dircache[i].stamp < victim->stamp)
+				victim = &dircache[i];
+		}
+	}
+
+	dirlist_free(victim);
+	*victim = *dir;
+	victim->stamp = ++dircache_stamp;
+	memset(dir, 0, sizeof(*dir));
+}
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Wake up the dialog loop, unless a wake-up is already pending.
+ */
+static void DlgFileSelect_ScanNotify(void)
+{
+	SDL_Event event;
+	bool pending;
+
+	host_lock(&dirscan.lock);
+	pending = dirscan.notified;
+	dirscan.notified = true;
+	host_unlock(&dirscan.lock);
+
+	if (!pending && dirscan_event)
+	{
+		SDL_zero(event);
+		event.type = dirscan_event;
+		SDL_PushEvent(&event);
+	}
+}
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Directory scanner thread. Reads the entries and their types, and
+ * passes them to the dialog in batches.
+ */
+static int DlgFileSelect_ScanThread(void *unused)
+{
+	DIR *dd;
+	struct dirent *d;
+	uint64_t last = host_time_us();
+	bool stop = false;
+
+	dd = opendir(dirscan.dir.path);
+	if (!dd)
+	{
+		host_lock(&dirscan.lock);
+		dirscan.failed = dirscan.done = true;
+		host_unlock(&dirscan.lock);
+		DlgFileSelect_ScanNotify();
+		return 1;
+	}
+
+	while (!stop && (d = readdir(dd)) != NULL)
+	{
+		int type = DT_UNKNOWN;
+#if defined(HAVE_DIRENT_D_TYPE) || defined(_DIRENT_HAVE_D_TYPE)
+		type = d->d_type;
 #endif
+		/* OS / file system that doesn't support d_type field, or symlink */
+		if (type == DT_UNKNOWN || type == DT_LNK)
+			type = get_dtype(dirscan.dir.path, d->d_name);
+
+		host_lock(&dirscan.lock);
+		stop = dirscan.abort;
+		if (!stop && !dirlist_add(&dirscan.dir, d->d_name, type == DT_DIR))
+			dirscan.failed = stop = true;
+		host_unlock(&dirscan.lock);
+
+		if (host_time_us() - last >= DIRSCAN_BATCH_US)
+		{
+			last = host_time_us();
+			DlgFileSelect_ScanNotify();
+		}
+	}
+	closedir(dd);
+
+	host_lock(&dirscan.lock);
+	dirscan.done = true;
+	host_unlock(&dirscan.lock);
+	DlgFileSelect_ScanNotify();
+	return 0;
+}
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Abort a running directory scan and drop its results.
+ */
+static void DlgFileSelect_ScanStop(void)
+{
+	if (dirscan.thread)
+	{
+		host_lock(&dirscan.lock);
+		dirscan.abort = true;
+		host_unlock(&dirscan.lock);
+		host_thread_wait(dirscan.thread);
+		dirscan.thread = NULL;
+	}
+	if (dirscan_event)
+		SDL_FlushEvent(dirscan_event);
+	dirlist_free(&dirscan.dir);
+}
 
-	/* OS / file system that doesn't support d_type field, or symlink */
-	if (type1 == DT_UNKNOWN || type1 == DT_LNK)
-		type1 = get_dtype(name1);
-	if (type2 == DT_UNKNOWN || type2 == DT_LNK)
-		type2 = get_dtype(name2);
+/*-----------------------------------------------------------------------*/
+/**
+ * Start reading given directory in the background. Falls back to
+ * reading it right away if no thread can be created.
+ */
+static bool DlgFileSelect_ScanStart(const char *path, time_t mtime)
+{
+	DlgFileSelect_ScanStop();
 
-	if (type1 == DT_DIR)
+	if (!dirscan_event)
 	{
-		if (type2 != DT_DIR)
-			return -1;
-	} else if (type2 == DT_DIR)
+		dirscan_event = SDL_RegisterEvents(1);
+		if (dirscan_event == (Uint32)-1)
+			dirscan_event = 0;
+	}
+
+	dirscan.dir.path = strdup(path);
+	if (!dirscan.dir.path)
+		return false;
+	dirscan.dir.mtime = mtime;
+	dirscan.done = dirscan.failed = false;
+	dirscan.abort = dirscan.notified = false;
+
+	if (dirscan_event)
+		dirscan.thread = host_thread_create(DlgFileSelect_ScanThread, "[Previous] Dir scan", NULL);
+	if (!dirscan.thread)
+		DlgFileSelect_ScanThread(NULL);
+	return true;
+}
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Replace the dialog's file list with what the scanner has found so far.
+ * Returns 1 when the scan is complete, 0 while it is still running and
+ * -1 if the directory could not be read.
+ */
+static int DlgFileSelect_ScanUpdate(struct dirent ***pfiles, bool showhidden)
+{
+	bool done, failed;
+
+	if (!dirscan.dir.path)
+		return 1;               /* stale wake-up */
+
+	*pfiles = files_free(*pfiles);
+
+	host_lock(&dirscan.lock);
+	dirscan.notified = false;
+	*pfiles = DlgFileSelect_ListFromDir(&dirscan.dir, showhidden);
+	done = dirscan.done;
+	failed = dirscan.failed;
+	host_unlock(&dirscan.lock);
+
+	if (!done)
+		return 0;
+
+	if (dirscan.thread)
 	{
-		if (type1 != DT_DIR)
-			return 1;
+		host_thread_wait(dirscan.thread);
+		dirscan.thread = NULL;
 	}
-	return strcasecmp(name1, name2);
+	if (failed)
+	{
+		dirlist_free(&dirscan.dir);
+		return -1;
+	}
+	DlgFileSelect_CacheInsert(&dirscan.dir);
+	return 1;
 }
 
 /*-----------------------------------------------------------------------*/
@@ -669,6 +975,7 @@ char* SDLGui_FileSelect(const char *title, const char *path_and_name, char **zip
 	char *zipfilename;                  /* Filename in zip file */
 	char *zipdir;
 	bool browsingzip = false;           /* Are we browsing an archive? */
+	bool showhidden;                    /* Are hidden files listed? */
 	zip_dir *zipfiles = NULL;
 	SDL_Event sdlEvent;
 	int yScrollbar_size;                /* Size of the vertical scrollbar */
@@ -689,7 +996,7 @@ char* SDLGui_FileSelect(const char *title, const char *path_and_name, char **zip
 	}
 
 	refreshentries = true;
-	entries = 0;
+	entries = dirs = 0;
 
 	/* Allocate memory for the file and path name strings: */
 	pStringMem = malloc(4 * FILENAME_MAX);
@@ -765,6 +1072,8 @@ char* SDLGui_FileSelect(const char *title, const char *path_and_name, char **zip
 	retbut = SDLGUI_NOTFOUND;
 	do
 	{
+		showhidden = fsdlg[SGFSDLG_SHOWHIDDEN].state & SG_SELECTED;
+
 		if (reloaddir)
 		{
 			files = files_free(files);
@@ -772,6 +1081,7 @@ char* SDLGui_FileSelect(const char *title, const char *path_and_name, char **zip
 			if (browsingzip)
 			{
 				files = ZIP_GetFilesDir(zipfiles, zipdir, &entries);
+				dirs = 0;
 				if(!files)
 				{
 					Log_Printf(LOG_WARN, "SDLGui_FileSelect: ZIP_GetFilesDir() error!\n");
@@ -780,14 +1090,28 @@ char* SDLGui_FileSelect(const char *title, const char *path_and_name, char **zip
 			}
 			else
 			{
-				/* for get_dtype() */
-				dirpath = path;
-				/* Load directory entries: */
-				entries = scandir(path, &files, NULL, filesort);
+				struct stat dirstat;
+				dirlist_t *cached;
+
+				/* Load directory entries, from cache if unchanged: */
+				if (stat(path, &dirstat) != 0)
+				{
+					entries = -1;
+				}
+				else if ((cached = DlgFileSelect_CacheLookup(path, dirstat.st_mtime)) != NULL)
+				{
+					DlgFileSelect_ScanStop();
+					files = DlgFileSelect_ListFromDir(cached, showhidden);
+				}
+				else if (!DlgFileSelect_ScanStart(path, dirstat.st_mtime) ||
+				         DlgFileSelect_ScanUpdate(&files, showhidden) < 0)
+				{
+					entries = -1;
+				}
 			}
 
 			/* Remove hidden files from the list if necessary: */
-			if (!(fsdlg[SGFSDLG_SHOWHIDDEN].state & SG_SELECTED))
+			if (browsingzip && !showhidden)
 			{
 				DlgFileSelect_RemoveHiddenFiles(files);
 			}
@@ -1057,7 +1381,17 @@ char* SDLGui_FileSelect(const char *title, const char *path_and_name, char **zip
 				scrollbar_Ypos = 0.0;
 				break;
 			case SDLGUI_UNKNOWNEVENT:
-				DlgFileSelect_HandleSdlEvents(&sdlEvent);
+				if (dirscan_event && sdlEvent.type == dirscan_event)
+				{
+					/* More directory entries have been read */
+					if (!browsingzip && DlgFileSelect_ScanUpdate(&files, showhidden) < 0)
+						Log_Printf(LOG_WARN, "SDLGui_FileSelect: Reading directory failed.\n");
+					refreshentries = true;
+				}
+				else
+				{
+					DlgFileSelect_HandleSdlEvents(&sdlEvent);
+				}
 				break;
 #if WIN32
 			case SGFSDLG_DRIVE_LESS:
@@ -1103,6 +1437,7 @@ char* SDLGui_FileSelect(const char *title, const char *path_and_name, char **zip
 
 clean_exit:
 	Main_ShowCursor(bOldMouseVisibility);
+	DlgFileSelect_ScanStop();
 
 	if (browsingzip && zipfiles != NULL)
 	{
@@ -12,6 +12,9 @@ const char DlgMemory_fileid[] = "Previous dlgMemory.c";
 #include "file.h"
 #include "screen.h"
 
+/* Memory snapshots are inherited from Hatari and not implemented. Most
+ * device state (ESP, MO, SCC, DMA, NeXTdimension, ...) lives in static
+ * variables and host file handles that have no capture functions yet. */
 #define GUI_SAVE_MEMORY 0
 
 #define DLGMEM_8MB      4
@@ -333,6 +333,5 @@ void Dialog_SystemDlg(void)
   
 	/* Obsolete */
 	ConfigureParams.System.bCompatibleCpu = 1;
-	ConfigureParams.System.bCompatibleFPU = 1;
 	ConfigureParams.System.bMMU = 1;
 }
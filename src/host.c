@@ -28,8 +28,10 @@ const char Host_fileid[] = "Previous host.c";
 #include "cycInt.h"
 #include "main.h"
 #include "log.h"
+#include "replay.h"
 #include "memory.h"
 #include "newcpu.h"
+#include "m68000.h"
 
 
 #define NUM_BLANKS 3
@@ -54,6 +56,9 @@ static uint64_t     hardClockActual;
 static time_t       unixTimeStart;
 static lock_t       timeLock;
 static uint64_t     saveTime;
+static int          paceScale;      // pacing target in percent of real time
+static uint64_t     paceRealStart;  // real time when paceScale was set
+static uint64_t     paceStart;      // pacing time at that moment
 
 
 static inline uint64_t real_time(void) {
@@ -142,7 +147,7 @@ void host_reset(void) {
     perfCounterStart  = SDL_GetPerformanceCounter();
     pauseTimeStamp    = perfCounterStart;
     perfFrequency     = SDL_GetPerformanceFrequency();
-    unixTimeStart     = time(NULL);
+    unixTimeStart     = Replay_UnixTime(time(NULL));
     cycleCounterStart = 0;
     currentIsRealtime = false;
     hardClockExpected = 0;
@@ -150,6 +155,9 @@ void host_reset(void) {
     enableRealtime    = ConfigureParams.System.bRealtime;
     osDarkmatter      = false;
     saveTime          = 0;
+    paceScale         = 100;
+    paceRealStart     = 0;
+    paceStart         = 0;
     
     for(int i = NUM_BLANKS; --i >= 0;) {
         host_reset_blank_counter(i);
@@ -165,6 +173,23 @@ void host_reset(void) {
     host_check_unix_time();
 }
 
+// Apply a changed CPU frequency or realtime flag without a reset
+void host_set_speed(void) {
+    host_lock(&timeLock);
+    
+    if(!currentIsRealtime) {
+        // keep hostTime continuous across the change of the divisor
+        int64_t hostTime  = (nCyclesMainCounter - cycleCounterStart) / cycleDivisor;
+        cycleCounterStart = nCyclesMainCounter - hostTime * ConfigureParams.System.nCpuFreq;
+    }
+    cycleDivisor   = ConfigureParams.System.nCpuFreq;
+    enableRealtime = ConfigureParams.System.bRealtime;
+    
+    host_unlock(&timeLock);
+    
+    host_report_limits();
+}
+
 static char DARKMATTER[] = "darkmatter";
 
 void host_blank_count(int src, bool state) {
@@ -282,6 +307,60 @@ int64_t host_real_time_offset(void) {
     return (int64_t)vt-rt;
 }
 
+static inline uint64_t pace_time(uint64_t realTime) {
+    return paceStart + (realTime - paceRealStart) * paceScale / 100;
+}
+
+// Return how many microseconds hostTime is ahead of the pacing target,
+// which is real time scaled by the speed governor
+int64_t host_pace_offset(void) {
+    uint64_t rt, vt;
+    host_time(&rt, &vt);
+    return (int64_t)vt - pace_time(rt);
+}
+
+#define GOVERNOR_STEP    25         // percent of real time added per call
+#define GOVERNOR_BACKOFF 90         // percent of the target that must be reached
+#define GOVERNOR_MAX_LAG 100000LL   // us behind the target before it is dropped
+
+// Speed governor for cycle time. Called periodically with the speed the
+// emulation has reached since the last call, relative to real time. While
+// the host keeps up the pacing target is raised step by step up to
+// nMaxSpeed, so spare host capacity is used. If other load takes the host
+// away, the target falls back to what has been reached and the lag is
+// dropped instead of being caught up later.
+void host_governor(double speed) {
+    int      scale = paceScale;
+    uint64_t rt, vt;
+    
+    host_time(&rt, &vt);
+    
+    if(ConfigureParams.System.nMaxSpeed <= 100 || ConfigureParams.System.bRealtime ||
+       ConfigureParams.System.bFastForward || ConfigureParams.System.bAudioSync) {
+        scale = 100;
+    } else {
+        if(speed * 100 < paceScale * GOVERNOR_BACKOFF / 100) {
+            scale = (int)(speed * 100);
+        } else {
+            scale += GOVERNOR_STEP;
+        }
+        if(scale > ConfigureParams.System.nMaxSpeed) scale = ConfigureParams.System.nMaxSpeed;
+        if(scale < 100)                              scale = 100;
+        
+        if((int64_t)vt - (int64_t)pace_time(rt) < -GOVERNOR_MAX_LAG) {
+            paceStart     = vt;
+            paceRealStart = rt;
+        }
+    }
+    
+    if(scale != paceScale) {
+        paceStart     = pace_time(rt);
+        paceRealStart = rt;
+        paceScale     = scale;
+        Log_Printf(LOG_DEBUG, "[Hosttime] Speed governor target: %d%%", scale);
+    }
+}
+
 void host_pause_time(bool pausing) {
     if(pausing) {
         pauseTimeStamp = SDL_GetPerformanceCounter();
@@ -375,7 +454,51 @@ int host_num_cpus(void) {
     return SDL_GetCPUCount();
 }
 
+uint64_t host_prof_ticks[HOST_PROF_NUM];
+
+static const char* PROF_NAMES[HOST_PROF_NUM] = {
+    "mmu","io","dma","snd","event","dsp","idle","net","i860","blit"
+};
+
+typedef struct {
+    uint64_t now;
+    uint64_t ticks[HOST_PROF_NUM];
+} host_prof_t;
+
+/* Share of host time per subsystem in percent since the last call with the
+ * same snapshot. Returns the share of the 68k thread left for the CPU core. */
+static int host_prof_shares(host_prof_t* last, int* share) {
+    uint64_t now     = host_prof_now();
+    uint64_t elapsed = now - last->now;
+    int      cpu     = 100;
+
+    for(int i = 0; i < HOST_PROF_NUM; i++) {
+        uint64_t ticks = host_prof_ticks[i];
+        share[i] = elapsed ? (int)((ticks - last->ticks[i]) * 100 / elapsed) : 0;
+        last->ticks[i] = ticks;
+        if(i < HOST_PROF_CPU_NUM) cpu -= share[i];
+    }
+    last->now = now;
+    return cpu < 0 ? 0 : cpu;
+}
+
+/* Busiest subsystem besides the CPU core and idle time, for the statusbar */
+const char* host_prof_busiest(int* percent) {
+    static host_prof_t last;
+    int share[HOST_PROF_NUM];
+    int busiest = HOST_PROF_MMU;
+
+    host_prof_shares(&last, share);
+    for(int i = 0; i < HOST_PROF_NUM; i++) {
+        if(i != HOST_PROF_IDLE && share[i] > share[busiest]) busiest = i;
+    }
+    *percent = share[busiest];
+    return PROF_NAMES[busiest];
+}
+
 static uint64_t lastVT;
+static int64_t  lastCycles;
+static uint64_t lastKernelIdle;
 static char report[512];
 
 const char* host_report(uint64_t realTime, uint64_t hostTime) {
@@ -394,6 +517,21 @@ const char* host_report(uint64_t realTime, uint64_t hostTime) {
         r += sprintf(r, " %s:%.1fHz", BLANKS[i], (double)nBlank/dVT);
     }
     
+    static host_prof_t last;
+    int share[HOST_PROF_NUM];
+    r += sprintf(r, " host:{cpu=%d%%", host_prof_shares(&last, share));
+    for(int i = 0; i < HOST_PROF_NUM; i++) {
+        r += sprintf(r, " %s=%d%%", PROF_NAMES[i], share[i]);
+    }
+    r += sprintf(r, "}");
+
+    if(ConfigureParams.System.bKernelIdle) {
+        int64_t cycles = nCyclesMainCounter - lastCycles;
+        r += sprintf(r, " kernelIdle:%.1f%%", cycles > 0 ? (nKernelIdleCycles - lastKernelIdle) * 100.0 / cycles : 0.0);
+    }
+    lastCycles     = nCyclesMainCounter;
+    lastKernelIdle = nKernelIdleCycles;
+
     lastVT = hostTime;
 
     return report;
@@ -0,0 +1,530 @@
+/*
+  Previous - imgout.c
+
+  This file is distributed under the GNU General Public License, version 2
+  or at your option any later version. Read the file gpl.txt for details.
+
+  Compressed image output shared by screenshots and printed pages.
+
+  A zlib stream is cut into chunks of IMGOUT_CHUNK bytes that are deflated
+  by a few worker threads at the same time, the way pigz does it. Each
+  chunk is primed with the last 32 kB of the input before it, so matches
+  across chunk borders are still found and the ratio stays close to that
+  of a single stream. Chunks end on a byte boundary with a sync flush, the
+  last one with a final block. The outputs are written in order by the
+  thread that feeds the stream and the checksums are combined, so the
+  result is one ordinary zlib stream.
+
+  The PNG writer filters rows on the calling thread and puts the stream
+  into IDAT chunks. Compression level and row filter are taken from the
+  printer settings.
+*/
+const char ImgOut_fileid[] = "Previous imgout.c";
+
+#include "main.h"
+#include "configuration.h"
+#include "host.h"
+#include "imgout.h"
+
+#if HAVE_LIBZ
+#include <zlib.h>
+
+#define IMGOUT_CHUNK    (128*1024)  /* input per job */
+#define IMGOUT_DICT     32768       /* deflate window */
+#define IMGOUT_THREADS  8
+#define IMGOUT_SLOTS    (2*IMGOUT_THREADS)
+#define IMGOUT_IDAT     65536       /* PNG output per IDAT chunk */
+
+/* Enough for the worst case of deflate plus the sync flush marker */
+#define IMGOUT_BOUND(n) ((n) + ((n)>>12) + ((n)>>14) + ((n)>>25) + 13 + 16)
+
+typedef struct {
+	uint8_t* in;        /* IMGOUT_DICT bytes of dictionary, then the input */
+	uint32_t dict;      /* dictionary bytes before the input */
+	uint32_t len;       /* input bytes */
+	uint8_t* out;
+	uint32_t outlen;
+	uLong    adler;
+	bool     last;
+	SDL_sem* done;
+} IMGOUT_JOB;
+
+struct IMGOUT_Z {
+	imgout_write_t write;
+	void*      arg;
+	int        level;
+	IMGOUT_JOB job[IMGOUT_SLOTS];
+	int        nslots;
+	int        head;        /* slot being filled */
+	int        tail;        /* oldest slot not yet written */
+	int        pending;     /* dispatched slots not yet written */
+	uLong      adler;
+	uint32_t   length;      /* compressed bytes written */
+	thread_t*  thread[IMGOUT_THREADS];
+	int        nthreads;
+	SDL_sem*   jobs;
+	atomic_int next;        /* next job taken by a worker */
+	volatile bool quit;
+};
+
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Deflate one chunk as a raw deflate stream that ends on a byte boundary.
+ */
+static void imgout_deflate(IMGOUT_Z* z, IMGOUT_JOB* job) {
+	z_stream s;
+
+	memset(&s, 0, sizeof(s));
+	deflateInit2(&s, z->level, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY);
+	if (job->dict) {
+		deflateSetDictionary(&s, job->in + IMGOUT_DICT - job->dict, job->dict);
+	}
+	s.next_in   = job->in + IMGOUT_DICT;
+	s.avail_in  = job->len;
+	s.next_out  = job->out;
+	s.avail_out = IMGOUT_BOUND(IMGOUT_CHUNK);
+	deflate(&s, job->last ? Z_FINISH : Z_SYNC_FLUSH);
+	job->outlen = IMGOUT_BOUND(IMGOUT_CHUNK) - s.avail_out;
+	deflateEnd(&s);
+
+	job->adler = adler32(adler32(0, NULL, 0), job->in + IMGOUT_DICT, job->len);
+}
+
+static int imgout_worker(void* arg) {
+	IMGOUT_Z* z = (IMGOUT_Z*)arg;
+	IMGOUT_JOB* job;
+
+	for (;;) {
+		SDL_SemWait(z->jobs);
+		if (z->quit) {
+			break;
+		}
+		job = &z->job[host_atomic_add(&z->next, 1) % z->nslots];
+		imgout_deflate(z, job);
+		SDL_SemPost(job->done);
+	}
+	return 0;
+}
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Wait for the oldest dispatched chunk and write its output.
+ */
+static void imgout_retire(IMGOUT_Z* z) {
+	IMGOUT_JOB* job = &z->job[z->tail];
+
+	if (z->nthreads) {
+		SDL_SemWait(job->done);
+	}
+	z->write(job->out, job->outlen, z->arg);
+	z->length += job->outlen;
+	z->adler   = adler32_combine(z->adler, job->adler, job->len);
+	z->tail    = (z->tail + 1) % z->nslots;
+	z->pending--;
+}
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Hand the chunk being filled to the workers and start the next one with
+ * the end of its input as dictionary.
+ */
+static void imgout_dispatch(IMGOUT_Z* z, bool last) {
+	IMGOUT_JOB* prev = &z->job[z->head];
+	IMGOUT_JOB* job;
+	uint32_t dict;
+
+	prev->last = last;
+	z->pending++;
+	if (z->nthreads) {
+		SDL_SemPost(z->jobs);
+	} else {
+		imgout_deflate(z, prev);
+	}
+	if (last) {
+		return;
+	}
+
+	z->head = (z->head + 1) % z->nslots;
+	if (z->pending == z->nslots) {
+		imgout_retire(z);
+	}
+	job  = &z->job[z->head];
+	dict = prev->dict + prev->len;
+	if (dict > IMGOUT_DICT) {
+		dict = IMGOUT_DICT;
+	}
+	memmove(job->in + IMGOUT_DICT - dict, prev->in + IMGOUT_DICT + prev->len - dict, dict);
+	job->dict = dict;
+	job->len  = 0;
+}
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Start a zlib stream. Compressed data is passed to write in order, always
+ * from the calling thread. Returns NULL if out of memory.
+ */
+IMGOUT_Z* ImgOut_ZBegin(imgout_write_t write, void* arg) {
+	IMGOUT_Z* z = calloc(1, sizeof(IMGOUT_Z));
+	uint8_t header[2];
+	int i, flevel;
+
+	if (!z) {
+		return NULL;
+	}
+	z->write = write;
+	z->arg   = arg;
+	z->level = ConfigureParams.Printer.nCompression;
+	z->adler = adler32(0, NULL, 0);
+
+	z->nthreads = host_num_cpus();
+	if (z->nthreads > IMGOUT_THREADS) {
+		z->nthreads = IMGOUT_THREADS;
+	}
+	if (z->nthreads < 2) {
+		z->nthreads = 0;
+	}
+	z->nslots = z->nthreads ? 2 * z->nthreads : 1;
+
+	for (i = 0; i < z->nslots; i++) {
+		z->job[i].in  = malloc(IMGOUT_DICT + IMGOUT_CHUNK);
+		z->job[i].out = malloc(IMGOUT_BOUND(IMGOUT_CHUNK));
+		if (!z->job[i].in || !z->job[i].out) {
+			z->nslots = i + 1;
+			z->nthreads = 0;
+			ImgOut_ZEnd(z);
+			return NULL;
+		}
+		if (z->nthreads) {
+			z->job[i].done = SDL_CreateSemaphore(0);
+		}
+	}
+	if (z->nthreads) {
+		z->jobs = SDL_CreateSemaphore(0);
+		for (i = 0; i < z->nthreads; i++) {
+			z->thread[i] = host_thread_create(imgout_worker, "[Previous] Deflate", z);
+		}
+	}
+
+	/* zlib header, 32 kB window */
+	flevel = z->level < 2 ? 0 : z->level < 6 ? 1 : z->level == 6 ? 2 : 3;
+	header[0] = 0x78;
+	header[1] = flevel << 6;
+	header[1] += 31 - ((header[0] << 8) | header[1]) % 31;
+	z->write(header, sizeof(header), z->arg);
+	z->length = sizeof(header);
+	return z;
+}
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Add data to a zlib stream.
+ */
+void ImgOut_ZWrite(IMGOUT_Z* z, const uint8_t* data, uint32_t len) {
+	IMGOUT_JOB* job;
+	uint32_t n;
+
+	while (len) {
+		job = &z->job[z->head];
+		if (job->len == IMGOUT_CHUNK) {
+			imgout_dispatch(z, false);
+			continue;
+		}
+		n = IMGOUT_CHUNK - job->len;
+		if (n > len) {
+			n = len;
+		}
+		memcpy(job->in + IMGOUT_DICT + job->len, data, n);
+		job->len += n;
+		data     += n;
+		len      -= n;
+	}
+}
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Finish a zlib stream and free it. Returns the total compressed length.
+ */
+uint32_t ImgOut_ZEnd(IMGOUT_Z* z) {
+	uint8_t trailer[4];
+	uint32_t length;
+	int i;
+
+	if (z->length) {
+		imgout_dispatch(z, true);
+		while (z->pending) {
+			imgout_retire(z);
+		}
+		trailer[0] = z->adler >> 24;
+		trailer[1] = z->adler >> 16;
+		trailer[2] = z->adler >> 8;
+		trailer[3] = z->adler;
+		z->write(trailer, sizeof(trailer), z->arg);
+		z->length += sizeof(trailer);
+	}
+
+	if (z->nthreads) {
+		z->quit = true;
+		for (i = 0; i < z->nthreads; i++) {
+			SDL_SemPost(z->jobs);
+		}
+		for (i = 0; i < z->nthreads; i++) {
+			host_thread_wait(z->thread[i]);
+		}
+		SDL_DestroySemaphore(z->jobs);
+	}
+	for (i = 0; i < z->nslots; i++) {
+		if (z->job[i].done) {
+			SDL_DestroySemaphore(z->job[i].done);
+		}
+		free(z->job[i].in);
+		free(z->job[i].out);
+	}
+	length = z->length;
+	free(z);
+	return length;
+}
+
+
+/* ------------------------------------------------------------------------
+ * PNG
+ */
+
+struct IMGOUT_PNG {
+	FILE*     fp;
+	long      start;        /* file offset of the signature */
+	int       width;
+	int       height;
+	int       rows;
+	int       depth;
+	int       color;
+	int       rowbytes;
+	int       bpp;          /* filter distance in bytes */
+	int       filter;
+	uint8_t*  prev;         /* previous row, unfiltered */
+	uint8_t*  line[2];      /* filter type and filtered row */
+	IMGOUT_Z* z;
+	uint8_t   idat[IMGOUT_IDAT];
+	uint32_t  idatlen;
+};
+
+static void imgout_put32(uint8_t* p, uint32_t v) {
+	p[0] = v>>24; p[1] = v>>16; p[2] = v>>8; p[3] = v;
+}
+
+static void imgout_png_chunk(FILE* fp, const char* type, const uint8_t* data, uint32_t len) {
+	uint8_t buf[8];
+	uint32_t crc = crc32(0, (const Bytef*)type, 4);
+
+	if (len) {
+		crc = crc32(crc, data, len);    /* with no data crc32 returns its initial value */
+	}
+	imgout_put32(buf, len);
+	memcpy(buf+4, type, 4);
+	fwrite(buf, 1, 8, fp);
+	fwrite(data, 1, len, fp);
+	imgout_put32(buf, crc);
+	fwrite(buf, 1, 4, fp);
+}
+
+static void imgout_png_ihdr(IMGOUT_PNG* png, uint8_t* ihdr, int height) {
+	imgout_put32(ihdr, png->width);
+	imgout_put32(ihdr+4, height);
+	ihdr[8]  = png->depth;
+	ihdr[9]  = png->color;
+	ihdr[10] = 0;   /* deflate */
+	ihdr[11] = 0;   /* adaptive filtering */
+	ihdr[12] = 0;   /* no interlace */
+}
+
+static void imgout_png_flush(IMGOUT_PNG* png) {
+	if (png->idatlen) {
+		imgout_png_chunk(png->fp, "IDAT", png->idat, png->idatlen);
+		png->idatlen = 0;
+	}
+}
+
+static void imgout_png_write(const uint8_t* data, uint32_t len, void* arg) {
+	IMGOUT_PNG* png = (IMGOUT_PNG*)arg;
+	uint32_t n;
+
+	while (len) {
+		n = IMGOUT_IDAT - png->idatlen;
+		if (n > len) {
+			n = len;
+		}
+		memcpy(png->idat + png->idatlen, data, n);
+		png->idatlen += n;
+		data += n;
+		len  -= n;
+		if (png->idatlen == IMGOUT_IDAT) {
+			imgout_png_flush(png);
+		}
+	}
+}
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Start a PNG file at the current position of fp. Returns NULL if out of
+ * memory.
+ */
+IMGOUT_PNG* ImgOut_PngBegin(FILE* fp, int width, int height, int depth, int color,
+                            int dpi, const char* title) {
+	IMGOUT_PNG* png = calloc(1, sizeof(IMGOUT_PNG));
+	uint8_t ihdr[13];
+	uint8_t phys[9];
+	uint32_t ppm;
+	int channels = color == IMGOUT_RGBA ? 4 : color == IMGOUT_RGB ? 3 : 1;
+
+	if (!png) {
+		return NULL;
+	}
+	png->fp       = fp;
+	png->start    = ftell(fp);
+	png->width    = width;
+	png->height   = height;
+	png->depth    = depth;
+	png->color    = color;
+	png->rowbytes = (width * channels * depth + 7) / 8;
+	png->bpp      = (channels * depth + 7) / 8;
+	png->filter   = ConfigureParams.Printer.nPngFilter;
+	png->prev     = calloc(1, png->rowbytes);
+	png->line[0]  = malloc(1 + png->rowbytes);
+	png->line[1]  = malloc(1 + png->rowbytes);
+	if (png->prev && png->line[0] && png->line[1]) {
+		png->z = ImgOut_ZBegin(imgout_png_write, png);
+	}
+	if (!png->z) {
+		ImgOut_PngEnd(png, true);
+		return NULL;
+	}
+
+	/* The zlib header is buffered until the first IDAT chunk */
+	fwrite("\x89PNG\r\n\x1a\n", 1, 8, fp);
+	imgout_png_ihdr(png, ihdr, height);
+	imgout_png_chunk(fp, "IHDR", ihdr, sizeof(ihdr));
+	if (dpi > 0) {
+		ppm = (uint32_t)(dpi / 0.0254 + 0.5);
+		imgout_put32(phys, ppm);
+		imgout_put32(phys+4, ppm);
+		phys[8] = 1;    /* meter */
+		imgout_png_chunk(fp, "pHYs", phys, sizeof(phys));
+	}
+	if (title) {
+		uint8_t text[80];
+		int len = snprintf((char*)text, sizeof(text), "Title%c%s", 0, title);
+		if (len > (int)sizeof(text) - 1) {
+			len = sizeof(text) - 1;
+		}
+		imgout_png_chunk(fp, "tEXt", text, len);
+	}
+	return png;
+}
+
+static inline int imgout_paeth(int a, int b, int c) {
+	int p  = a + b - c;
+	int pa = abs(p - a);
+	int pb = abs(p - b);
+	int pc = abs(p - c);
+
+	if (pa <= pb && pa <= pc) return a;
+	if (pb <= pc) return b;
+	return c;
+}
+
+/* Apply one filter type, returns the sum of the filtered bytes as signed values */
+static uint32_t imgout_filter(IMGOUT_PNG* png, uint8_t* out, const uint8_t* row, int type) {
+	const uint8_t* up = png->prev;
+	uint32_t sum = 0;
+	int i, a, c;
+
+	out[0] = type;
+	out++;
+	for (i = 0; i < png->rowbytes; i++) {
+		a = i >= png->bpp ? row[i - png->bpp] : 0;
+		c = i >= png->bpp ? up[i - png->bpp]  : 0;
+		switch (type) {
+			case 0: out[i] = row[i]; break;
+			case 1: out[i] = row[i] - a; break;
+			case 2: out[i] = row[i] - up[i]; break;
+			case 3: out[i] = row[i] - ((a + up[i]) >> 1); break;
+			case 4: out[i] = row[i] - imgout_paeth(a, up[i], c); break;
+		}
+		sum += abs((int8_t)out[i]);
+	}
+	return sum;
+}
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Add one row of pixels in PNG byte order.
+ */
+void ImgOut_PngRow(IMGOUT_PNG* png, const uint8_t* row) {
+	uint32_t sum, best;
+	uint8_t* tmp;
+	int type;
+
+	switch (png->filter) {
+		case IMG_FILTER_NONE:
+			imgout_filter(png, png->line[0], row, 0);
+			break;
+		case IMG_FILTER_UP:
+			imgout_filter(png, png->line[0], row, 2);
+			break;
+		default:
+			/* Keep the filter with the smallest sum of absolute differences */
+			best = imgout_filter(png, png->line[0], row, 0);
+			for (type = 1; type <= 4 && best; type++) {
+				sum = imgout_filter(png, png->line[1], row, type);
+				if (sum < best) {
+					best = sum;
+					tmp = png->line[0];
+					png->line[0] = png->line[1];
+					png->line[1] = tmp;
+				}
+			}
+			break;
+	}
+	ImgOut_ZWrite(png->z, png->line[0], 1 + png->rowbytes);
+	memcpy(png->prev, row, png->rowbytes);
+	png->rows++;
+}
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Finish a PNG file and free the writer. The file is not closed. With abort
+ * the file is left incomplete. Returns false on write errors.
+ */
+bool ImgOut_PngEnd(IMGOUT_PNG* png, bool abort) {
+	uint8_t ihdr[4+13];
+	uint8_t crc[4];
+	long end;
+	bool result = !abort;
+
+	if (png->z) {
+		ImgOut_ZEnd(png->z);
+		if (!abort) {
+			imgout_png_flush(png);
+			imgout_png_chunk(png->fp, "IEND", NULL, 0);
+			if (png->height == 0) {
+				/* Patch the height and checksum of the header */
+				memcpy(ihdr, "IHDR", 4);
+				imgout_png_ihdr(png, ihdr+4, png->rows);
+				imgout_put32(crc, crc32(0, ihdr, sizeof(ihdr)));
+				end = ftell(png->fp);
+				fseek(png->fp, png->start + 12, SEEK_SET);
+				fwrite(ihdr, 1, sizeof(ihdr), png->fp);
+				fwrite(crc, 1, sizeof(crc), png->fp);
+				fseek(png->fp, end, SEEK_SET);
+			}
+			result = !ferror(png->fp);
+		}
+	}
+	free(png->prev);
+	free(png->line[0]);
+	free(png->line[1]);
+	free(png);
+	return result;
+}
+
+#endif /* HAVE_LIBZ */
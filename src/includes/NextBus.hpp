@@ -34,6 +34,12 @@ extern void nextbus_board_lput(uaecptr addr, uae_u32 val);
 extern void nextbus_board_wput(uaecptr addr, uae_u32 val);
 extern void nextbus_board_bput(uaecptr addr, uae_u32 val);
 
+extern bool nextbus_copy_in(uaecptr addr, uae_u32 len, uae_u8* buf);
+extern bool nextbus_copy_out(uaecptr addr, uae_u32 len, const uae_u8* buf);
+
+extern bool nextbus_master_read(uaecptr addr, uae_u8* buf, uae_u32 len);
+extern bool nextbus_master_write(uaecptr addr, const uae_u8* buf, uae_u32 len);
+
 extern void NextBus_Reset(void);
 extern void NextBus_Pause(bool pause);
 
@@ -68,6 +74,12 @@ public:
     virtual void   board_wput(uint32_t addr, uint16_t val);
     virtual void   board_bput(uint32_t addr, uint8_t val);
     
+    /* Block transfers, the default moves one byte at a time */
+    virtual void   slot_copy_in(uint32_t addr, uint32_t len, uint8_t* buf);
+    virtual void   slot_copy_out(uint32_t addr, uint32_t len, const uint8_t* buf);
+    virtual void   board_copy_in(uint32_t addr, uint32_t len, uint8_t* buf);
+    virtual void   board_copy_out(uint32_t addr, uint32_t len, const uint8_t* buf);
+    
     virtual void   reset(void);
     virtual void   pause(bool pause);
 };
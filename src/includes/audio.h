@@ -14,13 +14,13 @@ extern void Audio_Output_UnInit(void);
 extern void Audio_Output_Queue_Put(uint8_t* data, int len);
 extern void Audio_Output_Queue_Clear(void);
 extern int  Audio_Output_Queue_Size(void);
+extern bool Audio_Output_Clock_Offset(int64_t* offset);
 
 extern void Audio_Input_Enable(bool bEnable);
 extern void Audio_Input_Init(void);
 extern void Audio_Input_UnInit(void);
-extern int  Audio_Input_Buffer_Get(int16_t* sample);
+extern int  Audio_Input_Buffer_Get(int16_t* samples, int count);
+extern void Audio_Input_Buffer_Advance(int count);
 extern int  Audio_Input_Buffer_Size(void);
-extern void Audio_Input_Lock(void);
-extern void Audio_Input_Unlock(void);
 
 #endif /* PREV_AUDIO_H */
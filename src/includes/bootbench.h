@@ -0,0 +1,18 @@
+/*
+  Previous - bootbench.h
+
+  This file is distributed under the GNU General Public License, version 2
+  or at your option any later version. Read the file gpl.txt for details.
+*/
+
+#ifndef PREV_BOOTBENCH_H
+#define PREV_BOOTBENCH_H
+
+extern bool Bootbench_Load(const char *path);
+extern void Bootbench_Poll(void);
+extern void Bootbench_StartupStep(const char *name);
+extern int  Bootbench_ExitCode(void);
+
+extern bool bBootbench;
+
+#endif /* PREV_BOOTBENCH_H */
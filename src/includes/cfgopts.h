@@ -27,7 +27,15 @@ struct Config_Tag
   void       *buf;                 /* Storage location     */
 };
 
+struct Config_Section
+{
+  const char *header;              /* INI header, i.e. "[TEST]" */
+  const struct Config_Tag *configs;
+};
+
 int input_config(const char *, const struct Config_Tag *, const char *);
+int input_config_sections(const char *, const struct Config_Section *);
+int set_config_option(const struct Config_Tag *, const char *, const char *);
 int update_config(const char *, const struct Config_Tag *, const char *);
 
 #endif
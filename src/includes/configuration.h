@@ -35,6 +35,9 @@ typedef struct
   int nAlertDlgLogLevel;
   bool bConfirmQuit;
   bool bConsoleWindow;
+  bool bMetricsServer;            /* TRUE to serve counters in the Prometheus format */
+  int nMetricsPort;
+  bool bMetricsLocalOnly;         /* TRUE to accept connections from this host only */
 } CNF_LOG;
 
 
@@ -68,6 +71,7 @@ typedef struct
 {
   bool bEnableMicrophone;
   bool bEnableSound;
+  char szRecordCommand[FILENAME_MAX]; /* Audio encoder reading raw 16-bit stereo, empty to record AIFF */
 } CNF_SOUND;
 
 /* Dialog Keyboard */
@@ -142,6 +146,8 @@ typedef struct
 {
   int nMemoryBankSize[4];
   MEMORY_SPEED nMemorySpeed;
+  bool bMergeablePages;
+  bool bHugePages;
 } CNF_MEMORY;
 
 
@@ -167,6 +173,7 @@ typedef struct
   bool bLoopPot;
   bool bVerbose;
   bool bVisible;
+  bool bFastBoot;                 /* TRUE to patch out long ROM delays */
 } CNF_BOOT;
 
 
@@ -182,6 +189,7 @@ typedef enum {
 
 typedef struct {
   char szImageName[FILENAME_MAX];
+  char szOverlayName[FILENAME_MAX]; /* Overlay used with WRITEPROT_ON, temporary if empty */
   SCSI_DEVTYPE nDeviceType;
   bool bDiskInserted;
   bool bWriteProtected;
@@ -211,6 +219,7 @@ typedef struct {
 
 typedef struct {
   MODISK drive[MO_MAX_DRIVES];
+  bool bTrustImage;     /* Skip ECC correction of sectors from the images */
 } CNF_MO;
 
 
@@ -232,7 +241,8 @@ typedef struct {
 typedef enum
 {
   ENET_SLIRP,
-  ENET_PCAP
+  ENET_PCAP,
+  ENET_TAP
 } ENET_INTERFACE;
 
 typedef struct {
@@ -240,8 +250,12 @@ typedef struct {
   bool bTwistedPair;
   ENET_INTERFACE nHostInterface;
   char szInterfaceName[FILENAME_MAX];
+  char szTapInterface[FILENAME_MAX];
   char szNFSroot[FILENAME_MAX];
   bool bNetworkTime;
+  int nSlirpBufferSize;     /* KB per TCP socket buffer */
+  bool bSlirpNoDelay;       /* Set TCP_NODELAY on host sockets */
+  bool bUnlimitedSpeed;     /* Do not pace transfers like 10 Mbit/s hardware */
 } CNF_ENET;
 
 typedef enum
@@ -259,6 +273,15 @@ typedef struct
   bool bFullScreen;
   bool bShowStatusbar;
   bool bShowDriveLed;
+  int nFrameSkips;                /* Screen updates to skip in fast forward mode */
+  int nFrameRateCap;              /* Highest repaint rate in Hz, 0 for display refresh rate */
+  int nPrescale;                  /* Integer factor the frame is expanded by before the renderer scales it */
+  bool bNDInMainWindow;           /* TRUE to show dual monitor NeXTdimension screens in the main window */
+  char szRecordCommand[FILENAME_MAX]; /* Video encoder reading raw RGBA frames, empty to record sound only */
+  bool bHeadless;                 /* TRUE to run without window, renderer and audio */
+  bool bRfbServer;                /* TRUE to serve the screen to VNC clients */
+  int nRfbPort;
+  bool bRfbLocalOnly;             /* TRUE to accept connections from this host only */
 } CNF_SCREEN;
 
 
@@ -271,13 +294,47 @@ typedef enum
   PAPER_LEGAL
 } PAPER_SIZE;
 
+typedef enum
+{
+  PRINT_PNG,
+  PRINT_PDF
+} PRINT_FORMAT;
+
+typedef enum
+{
+  IMG_FILTER_NONE,
+  IMG_FILTER_UP,
+  IMG_FILTER_ADAPTIVE
+} IMG_FILTER;
+
 typedef struct
 {
   bool bPrinterConnected;
   PAPER_SIZE nPaperSize;
   char szPrintToFileName[FILENAME_MAX];
+  PRINT_FORMAT nOutputFormat;     /* One PNG or PDF file per page */
+  int nCompression;               /* zlib level 0-9 for all image output */
+  IMG_FILTER nPngFilter;          /* PNG row filter */
 } CNF_PRINTER;
 
+
+/* Serial port configuration */
+typedef enum
+{
+  SERIAL_NONE,
+  SERIAL_PTY,
+  SERIAL_TCP
+} SERIAL_HOST;
+
+typedef struct
+{
+  SERIAL_HOST nHost;
+  int  nChannel;                  /* SCC channel, 0 = A, 1 = B */
+  int  nTcpPort;                  /* Loopback port for SERIAL_TCP */
+  char szPtyLink[FILENAME_MAX];   /* Symbolic link to the PTY, none if empty */
+  bool bHighSpeed;                /* Receive without pacing at the baud rate */
+} CNF_SERIAL;
+
 /* Dialog System */
 typedef enum
 {
@@ -313,6 +370,12 @@ typedef enum
   DSP_TYPE_EMU
 } DSPTYPE;
 
+typedef enum
+{
+  IO_TIMING_ACCURATE,
+  IO_TIMING_INSTANT
+} IOTIMING;
+
 typedef enum
 {
   FPU_NONE = 0,
@@ -332,12 +395,25 @@ typedef struct
   int nCpuLevel;
   int nCpuFreq;
   bool bCompatibleCpu;            /* Prefetch mode */
+  bool bBlockCache;               /* TRUE if opcodes are dispatched from the block cache */
+  bool bHostTLB;                  /* TRUE if MMU data accesses use the host TLB */
+  bool bFastLoops;                /* TRUE if copy and fill loops run on host memory */
+  bool bCpuCaches;                /* TRUE if CINV/CPUSH maintain the 68040 cache lines */
+  bool bKernelIdle;               /* TRUE to skip emulated time while the kernel runs its idle thread */
   MACHINETYPE nMachineType;
   bool bRealtime;                 /* TRUE if realtime sources shoud be used */
+  bool bFastForward;              /* TRUE to run unthrottled on cycle time only */
+  bool bAudioSync;                /* TRUE to pace cycle time by the audio output device */
+  int nMaxSpeed;                  /* Max pacing target of the speed governor in percent of real time, 100 to disable */
+  int nThreadSkew;                /* Max time in us a co-processor thread may lag behind */
+  IOTIMING nIOTiming;             /* Seek and rotational delays of disk drives */
+  bool bMapDiskImages;            /* TRUE to access disk images through memory mappings */
+  int nDiskCacheSize;             /* Size of the host side disk block cache in MB, 0 to disable */
   DSPTYPE nDSPType;               /* how to "emulate" DSP */
   bool bDSPMemoryExpansion;
+  bool bDSPThread;                /* TRUE to run the DSP on its own host thread */
   FPUTYPE n_FPUType;
-  bool bCompatibleFPU;            /* More compatible FPU */
+  bool bCompatibleFPU;            /* Softfloat FPU, host FPU if FALSE */
   bool bMMU;                      /* TRUE if MMU is enabled */
 } CNF_SYSTEM;
 
@@ -352,11 +428,27 @@ typedef struct
 
 typedef struct {
   bool bI860Thread;
+  bool bI860CompatibleFPU;        /* Softfloat i860 FPU, host FPU if FALSE */
   bool bMainDisplay;
   int nMainDisplay;
+  char szStatsFileName[FILENAME_MAX];  /* CSV file for i860 counters, none if empty */
   NDBOARD board[ND_MAX_BOARDS];
 } CNF_ND;
 
+/* Paravirtual NeXTbus disk configuration */
+typedef struct {
+  bool bEnabled;
+  int  nSlot;                     /* NeXTbus slot, 2, 4 or 6 */
+  bool bWriteProtected;
+  char szImageName[FILENAME_MAX];
+} CNF_NBDISK;
+
+/* Paravirtual NeXTbus network configuration, uses the Ethernet backend */
+typedef struct {
+  bool bEnabled;
+  int  nSlot;                     /* NeXTbus slot, 2, 4 or 6 */
+} CNF_NBNET;
+
 /* State of system is stored in this structure */
 /* On reset, variables are copied into system globals and used. */
 typedef struct
@@ -378,8 +470,11 @@ typedef struct
   CNF_ENET      Ethernet;
   CNF_ROM       Rom;
   CNF_PRINTER   Printer;
+  CNF_SERIAL    Serial;
   CNF_SYSTEM    System;
   CNF_ND        Dimension;
+  CNF_NBDISK    NBDisk;
+  CNF_NBNET     NBNet;
 } CNF_PARAMS;
 
 
@@ -395,6 +490,7 @@ extern void Configuration_CheckDimensionSettings(void);
 extern void Configuration_CheckEthernetSettings(void);
 extern void Configuration_CheckPeripheralSettings(void);
 extern void Configuration_Load(const char *psFileName);
+extern bool Configuration_SetOption(const char *option);
 extern void Configuration_Save(void);
 extern void Configuration_MemorySnapShot_Capture(bool bSave);
 
@@ -0,0 +1,46 @@
+/*
+  Previous - coproc.h
+
+  This file is distributed under the GNU General Public License, version 2
+  or at your option any later version. Read the file gpl.txt for details.
+*/
+
+#ifndef PREV_COPROC_H
+#define PREV_COPROC_H
+
+#include "host.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+	thread_t*  thread;
+	atomic_int port;      /* pending message bits */
+	atomic_int credit;    /* cycles granted by the m68k, not yet run */
+	atomic_int idle;      /* co-processor thread is waiting for work */
+	atomic_int stalled;   /* m68k thread is waiting for the co-processor */
+	SDL_sem*   wake;
+	SDL_sem*   drained;
+	int        maxSkew;   /* credit at which the m68k thread waits */
+	int        spin;      /* polls before CoProc_Wait parks the thread */
+	uint64_t   stalls;    /* times the m68k thread had to wait */
+} COPROC;
+
+extern void CoProc_Init(COPROC* cp);
+extern void CoProc_Start(COPROC* cp, thread_func_t func, const char* name, void* data, int maxSkew);
+extern void CoProc_Stop(COPROC* cp, int killMsg);
+extern void CoProc_Send(COPROC* cp, int set, int clear);
+extern int  CoProc_Receive(COPROC* cp);
+extern void CoProc_Grant(COPROC* cp, int cycles);
+extern int  CoProc_Credit(COPROC* cp);
+extern void CoProc_Take(COPROC* cp, int cycles);
+extern void CoProc_Discard(COPROC* cp);
+extern void CoProc_Wait(COPROC* cp, uint32_t ms);
+extern void CoProc_Idle(COPROC* cp);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PREV_COPROC_H */
@@ -36,6 +36,10 @@ typedef enum
   INTERRUPT_EVENT_LOOP,
   INTERRUPT_ND_VBL,
   INTERRUPT_ND_VIDEO_VBL,
+  INTERRUPT_PROFILE,
+  INTERRUPT_NBDISK_IO,
+  INTERRUPT_NBNET_IO,
+  INTERRUPT_SCC_RX,
   MAX_INTERRUPTS
 } interrupt_id;
 
@@ -51,26 +55,28 @@ enum {
 typedef struct
 {
     int     type;   /* Type of time (CPU Cycles, microseconds) or NONE for inactive */
-    int64_t time;   /* number of CPU cycles to go until interupt or absolute microsecond timeout until interrupt */
+    int64_t time;   /* absolute CPU cycle count or microsecond timeout of the interrupt (cycles to go in PendingInterrupt) */
     void (*pFunction)(void);
 } INTERRUPTHANDLER;
 
 extern INTERRUPTHANDLER PendingInterrupt;
 
 extern int64_t nCyclesMainCounter;
-extern int64_t nCyclesOver;
 
 extern int usCheckCycles;
 
 extern void CycInt_Reset(void);
 extern void CycInt_MemorySnapShot_Capture(bool bSave);
 extern void CycInt_AcknowledgeInterrupt(void);
+extern int  CycInt_ActiveSubsystem(void);
+extern uint64_t CycInt_HandlerCount(interrupt_id Handler, const char** name);
 extern void CycInt_AddRelativeInterruptCycles(int64_t CycleTime, interrupt_id Handler);
 extern void CycInt_AddRelativeInterruptUs(int64_t us, int64_t usreal, interrupt_id Handler);
 extern void CycInt_AddRelativeInterruptUsCycles(int64_t us, int64_t usreal, interrupt_id Handler);
 extern void CycInt_RemovePendingInterrupt(interrupt_id Handler);
 extern bool CycInt_InterruptActive(interrupt_id Handler);
 extern bool CycInt_SetNewInterruptUs(void);
+extern int  CycInt_Idle(int cycles);
 
 #ifdef __cplusplus
 }
@@ -23,6 +23,7 @@ extern bool DlgEthernetAdvanced_ConfigurePCAP(void);
 extern void DlgEthernetAdvanced_ConfigureMAC(uint8_t *mac);
 extern bool DlgEthernetAdvanced_GetRomMAC(uint8_t *mac);
 extern void DlgEthernetAdvanced_GetMAC(uint8_t *mac);
+extern void DlgEthernetAdvanced_ConfigureSpeed(void);
 extern void DlgSound_Main(void);
 extern void DlgPrinter_Main(void);
 extern void Dialog_KeyboardDlg(void);
@@ -0,0 +1,37 @@
+/*
+  Previous - diskcache.h
+
+  This file is distributed under the GNU General Public License, version 2
+  or at your option any later version. Read the file gpl.txt for details.
+*/
+
+#ifndef PREV_DISKCACHE_H
+#define PREV_DISKCACHE_H
+
+#include "configuration.h"
+
+/* Devices that use the cache */
+#define DISKCACHE_SCSI(n)   (n)
+#define DISKCACHE_MO(n)     (ESP_MAX_DEVS + (n))
+#define DISKCACHE_FLOPPY(n) (ESP_MAX_DEVS + MO_MAX_DRIVES + (n))
+#define DISKCACHE_DEVS      (ESP_MAX_DEVS + MO_MAX_DRIVES + FLP_MAX_DRIVES)
+
+typedef struct {
+	uint64_t hits;      /* Blocks found in the cache */
+	uint64_t misses;    /* Blocks read from the image */
+	uint64_t evictions; /* Blocks of this device dropped to make room */
+	uint64_t reads;     /* Read requests since start, with or without the cache */
+	uint64_t writes;    /* Write requests */
+	uint64_t bytes_read;
+	uint64_t bytes_written;
+} DISKCACHE_STATS;
+
+extern void DiskCache_Reset(void);
+extern void DiskCache_Drop(int dev);
+extern bool DiskCache_Read(int dev, uint8_t *data, uint32_t size, uint64_t offset, FILE *fp);
+extern bool DiskCache_Write(int dev, uint8_t *data, uint32_t size, uint64_t offset, FILE *fp);
+extern void DiskCache_Stats(int dev, DISKCACHE_STATS *stats);
+extern const char *DiskCache_Name(int dev);
+extern const char *DiskCache_Report(uint64_t realTime, uint64_t hostTime);
+
+#endif /* PREV_DISKCACHE_H */
@@ -52,6 +52,7 @@ extern void dma_mo_read_memory(void);
 
 extern void dma_enet_write_memory(bool eop);
 extern bool dma_enet_read_memory(void);
+extern bool dma_enet_ready(void);
 
 extern void dma_dsp_write_memory(uint8_t val);
 extern uint8_t dma_dsp_read_memory(void);
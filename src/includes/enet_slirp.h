@@ -10,7 +10,14 @@
 
 extern void enet_slirp_queue_poll(void);
 extern void enet_slirp_input(uint8_t *pkt, int pkt_len);
+extern uint8_t *enet_slirp_input_buffer(int *size);
 extern void enet_slirp_stop(void);
 extern void enet_slirp_start(uint8_t *mac);
+extern void enet_slirp_stats(uint64_t *in, uint64_t *out, uint64_t *drops);
+
+/* Statistics of the NFS server in slirp/nfs/nfsd.cpp */
+extern void nfsd_print_stats(FILE *f);
+extern const char *nfsd_report(uint64_t realTime, uint64_t hostTime);
+extern void nfsd_stats(uint64_t *calls, uint64_t *timeUs);
 
 #endif /* PREV_ENET_SLIRP_H */
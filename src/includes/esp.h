@@ -93,6 +93,8 @@ extern void ESP_IO_Handler(void);
 
 extern bool ESP_Send_Ready(void);
 extern uint8_t ESP_Send_Data(void);
+extern uint8_t* ESP_Send_Span(int* size);
+extern void ESP_Send_Consume(int size);
 extern bool ESP_Receive_Ready(void);
 extern void ESP_Receive_Data(uint8_t val);
 
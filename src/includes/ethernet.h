@@ -46,12 +46,27 @@ typedef struct {
     int limit;
 } EthernetBuffer;
 
-extern EthernetBuffer enet_tx_buffer;
+/* The transmit buffer can be lent by the network backend, so that packets
+ * from the guest are read into their final place */
+typedef struct {
+    uint8_t *data;
+    int size;
+    int limit;
+    uint8_t base[EN_BUF_MAX];
+} EthernetTxBuffer;
+
+extern EthernetTxBuffer enet_tx_buffer;
 extern EthernetBuffer enet_rx_buffer;
 
 extern void ENET_IO_Handler(void);
 extern void Ethernet_Reset(bool hard);
 extern void enet_receive(uint8_t *pkt, int len);
+extern int Ethernet_CaptureDump(const char *filename);
+
+/* Paravirtual network boards */
+extern void Ethernet_Redirect(void (*receive)(uint8_t *pkt, int len), const uint8_t *mac);
+extern void Ethernet_Send(uint8_t *pkt, int len);
+extern void Ethernet_Poll(void);
 
 /* Turbo ethernet controller */
 extern void EN_Control_Read(void);
@@ -44,6 +44,10 @@ extern int File_MakePathBuf(char *buf, size_t buflen, const char *pDir,
 extern void File_ShrinkName(char *pDestFileName, const char *pSrcFileName, int maxlen);
 extern FILE *File_Open(const char *path, const char *mode);
 extern FILE *File_Close(FILE *fp);
+extern bool File_Map(FILE *fp, bool writable);
+extern void File_Sync(FILE *fp);
+extern void File_Unmap(FILE *fp);
+extern bool File_OpenCompressed(FILE *fp);
 extern bool File_Read(uint8_t *data, uint32_t size, uint64_t offset, FILE *fp);
 extern bool File_Write(uint8_t *data, uint32_t size, uint64_t offset, FILE *fp);
 extern bool File_Lock(FILE *fp);
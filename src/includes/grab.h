@@ -8,11 +8,15 @@
 #ifndef PREV_GRAB_H
 #define PREV_GRAB_H
 
+extern bool Grab_GetFrame(uint8_t* buf);
 extern void Grab_Screen(void);
 
 extern void Grab_Sound(uint8_t* samples, int len);
 extern void Grab_SoundToggle(void);
 
+extern void Grab_VideoFrame(void);
+extern void Grab_VideoToggle(void);
+
 extern void Grab_Stop(void);
 
 extern volatile bool bRecordingAiff;
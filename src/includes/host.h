@@ -41,6 +41,7 @@ typedef SDL_ThreadFunction thread_func_t;
 typedef SDL_mutex          mutex_t;
 
 extern void        host_reset(void);
+extern void        host_set_speed(void);
 extern void        host_blank_count(int src, bool state);
 extern int         host_reset_blank_counter(int src);
 extern uint64_t    host_time_us(void);
@@ -57,9 +58,43 @@ extern void        host_sleep_us(uint64_t us);
 extern int         host_num_cpus(void);
 extern void        host_hardclock(int expected, int actual);
 extern int64_t     host_real_time_offset(void);
+extern int64_t     host_pace_offset(void);
+extern void        host_governor(double speed);
 extern void        host_pause_time(bool pausing);
 extern const char* host_report(uint64_t realTime, uint64_t hostTime);
 
+/* Host time accounting per subsystem */
+enum {
+    HOST_PROF_MMU,      /* 68k MMU table walks */
+    HOST_PROF_IO,       /* IO register handlers */
+    HOST_PROF_DMA,      /* DMA and device event handlers */
+    HOST_PROF_SND,      /* sound event handlers */
+    HOST_PROF_EVENT,    /* other events: video, timers, host events */
+    HOST_PROF_DSP,      /* DSP_Run */
+    HOST_PROF_IDLE,     /* host sleeps while the 68k is idle */
+    HOST_PROF_NET,      /* slirp thread */
+    HOST_PROF_I860,     /* NeXTdimension threads */
+    HOST_PROF_BLIT,     /* screen blits */
+    HOST_PROF_NUM,
+    HOST_PROF_CPU_NUM = HOST_PROF_NET /* the ones above run on the 68k thread */
+};
+
+extern uint64_t    host_prof_ticks[HOST_PROF_NUM];
+
+static inline uint64_t host_prof_now(void) {
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    return __builtin_ia32_rdtsc();
+#else
+    return SDL_GetPerformanceCounter();
+#endif
+}
+
+static inline void host_prof_end(int subsystem, uint64_t start) {
+    host_prof_ticks[subsystem] += host_prof_now() - start;
+}
+
+extern const char* host_prof_busiest(int* percent);
+
 extern void        host_lock(lock_t* lock);
 extern void        host_unlock(lock_t* lock);
 extern int         host_trylock(lock_t* lock);
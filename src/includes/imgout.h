@@ -0,0 +1,38 @@
+/*
+  Previous - imgout.h
+
+  This file is distributed under the GNU General Public License, version 2
+  or at your option any later version. Read the file gpl.txt for details.
+*/
+
+#ifndef PREV_IMGOUT_H
+#define PREV_IMGOUT_H
+
+#if HAVE_LIBZ
+
+#include <stdio.h>
+
+/* PNG color types */
+#define IMGOUT_GRAY 0
+#define IMGOUT_RGB  2
+#define IMGOUT_RGBA 6
+
+typedef void (*imgout_write_t)(const uint8_t* data, uint32_t len, void* arg);
+
+typedef struct IMGOUT_Z   IMGOUT_Z;
+typedef struct IMGOUT_PNG IMGOUT_PNG;
+
+/* zlib stream, compressed in parallel and passed to write in order */
+extern IMGOUT_Z*   ImgOut_ZBegin(imgout_write_t write, void* arg);
+extern void        ImgOut_ZWrite(IMGOUT_Z* z, const uint8_t* data, uint32_t len);
+extern uint32_t    ImgOut_ZEnd(IMGOUT_Z* z);
+
+/* PNG file, height 0 is patched with the number of rows at the end */
+extern IMGOUT_PNG* ImgOut_PngBegin(FILE* fp, int width, int height, int depth, int color,
+                                   int dpi, const char* title);
+extern void        ImgOut_PngRow(IMGOUT_PNG* png, const uint8_t* row);
+extern bool        ImgOut_PngEnd(IMGOUT_PNG* png, bool abort);
+
+#endif /* HAVE_LIBZ */
+
+#endif /* PREV_IMGOUT_H */
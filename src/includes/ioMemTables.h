@@ -18,7 +18,23 @@ typedef struct
 	void (*WriteFunc)(void);  /* Write function */
 } INTERCEPT_ACCESS_FUNC;
 
+/* Direct handlers for frequently accessed registers, NULL uses the tables above */
+typedef struct
+{
+	const uint32_t Address;   /* Hardware address */
+	const uint32_t Mask;      /* Mask */
+	const int SpanInBytes;    /* Size of the register block */
+	uint32_t (*ReadByte)(uint32_t addr);
+	uint32_t (*ReadWord)(uint32_t addr);
+	uint32_t (*ReadLong)(uint32_t addr);
+	void (*WriteByte)(uint32_t addr, uint32_t val);
+	void (*WriteWord)(uint32_t addr, uint32_t val);
+	void (*WriteLong)(uint32_t addr, uint32_t val);
+} INTERCEPT_FAST_FUNC;
+
 extern const INTERCEPT_ACCESS_FUNC IoMemTable_NEXT[];
 extern const INTERCEPT_ACCESS_FUNC IoMemTable_Turbo[];
+extern const INTERCEPT_FAST_FUNC IoMemFastTable_NEXT[];
+extern const INTERCEPT_FAST_FUNC IoMemFastTable_Turbo[];
 
 #endif
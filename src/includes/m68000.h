@@ -84,27 +84,32 @@ static inline void M68000_SetSR(uint16_t v)
  * Add CPU cycles.
  */
 static inline void M68000_AddCycles(int cycles) {
-	nCyclesOver += cycles;
-	
 	if (PendingInterrupt.type == CYC_INT_CPU) {
 		PendingInterrupt.time -= cycles;
 	}
 	if (usCheckCycles < 0) {
-		if(!(CycInt_SetNewInterruptUs())) {
-			usCheckCycles = 100 * ConfigureParams.System.nCpuFreq;
-		}
+		CycInt_SetNewInterruptUs();
 	} else {
 		usCheckCycles -= cycles;
 	}
 	nCyclesMainCounter += cycles;
 }
 
+/* Code range of the guest kernel's idle thread, empty if unknown */
+extern uint32_t nKernelIdleStart, nKernelIdleSize;
+extern uint64_t nKernelIdleCycles;
+
+static inline bool M68000_InKernelIdle(uint32_t pc) {
+	return pc - nKernelIdleStart < nKernelIdleSize;
+}
+
 extern void M68000_Init(void);
 extern void M68000_Reset(void);
 extern void M68000_Stop(void);
 extern void M68000_Start(void);
 extern void M68000_CheckInterrupt(void);
 extern void M68000_CheckCpuSettings(void);
+extern int  M68000_KernelIdle(int cycles);
 extern void M68000_BusError (uint32_t addr, int ReadWrite, int Size, int AccessType, uae_u32 val);
 
 extern uint32_t M68000_ReadLong(uint32_t addr);
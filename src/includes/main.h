@@ -88,6 +88,7 @@ extern void Main_CheckStatusbarUpdate(void);
 extern void Main_SetTitle(const char *title);
 extern void Main_SpeedReset(void);
 extern const char* Main_SpeedMsg(void);
+extern double Main_SpeedFactor(void);
 
 #ifdef __cplusplus
 }
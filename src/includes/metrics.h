@@ -0,0 +1,15 @@
+/*
+  Previous - metrics.h
+
+  This file is distributed under the GNU General Public License, version 2
+  or at your option any later version. Read the file gpl.txt for details.
+*/
+
+#ifndef PREV_METRICS_H
+#define PREV_METRICS_H
+
+extern void Metrics_Init(void);
+extern void Metrics_UnInit(void);
+extern void Metrics_Update(void);
+
+#endif /* PREV_METRICS_H */
@@ -0,0 +1,91 @@
+/*
+  Previous - nbdisk.hpp
+
+  This file is distributed under the GNU General Public License, version 2
+  or at your option any later version. Read the file gpl.txt for details.
+*/
+
+#pragma once
+
+#ifndef PREV_NBDISK_HPP
+#define PREV_NBDISK_HPP
+
+#define NBDISK_NBIC_ID      0xC0000B01
+
+#define LOG_NBDISK_LEVEL    LOG_NONE
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+extern void NBDisk_IO_Handler(void);
+
+#ifdef __cplusplus
+}
+
+#include "NextBus.hpp"
+#include "nd_nbic.hpp"
+#include "host.h"
+
+#define NBDISK_RING_MAX     256
+
+typedef struct {
+    uint32_t desc;      /* guest address of the descriptor */
+    uint16_t op;
+    uint16_t status;
+    uint32_t block;
+    uint32_t count;
+    uint32_t buffer;
+    uint8_t* data;      /* host side copy of the transfer */
+} NBDISK_REQ;
+
+class NextBusDisk : public NextBusBoard {
+    FILE*       dsk;
+    bool        readonly;
+    uint32_t    blocks;
+
+    uint32_t    ring_base;
+    uint32_t    ring_size;
+    uint32_t    control;
+    uint32_t    status;
+
+    /* Free running ring indices. The m68k thread submits requests to the
+     * worker, the worker marks them done in order and the m68k thread
+     * completes them to the guest. They are never rewound while the worker
+     * runs, the guest sees them relative to base. */
+    atomic_int  submitted;
+    atomic_int  done;
+    uint32_t    completed;
+    uint32_t    base;
+    atomic_int  quit;
+
+    NBDISK_REQ  req[NBDISK_RING_MAX];
+    thread_t*   thread;
+    SDL_sem*    wake;
+
+    static int  worker(void* data);
+    void        process(NBDISK_REQ* r);
+    void        submit(uint32_t producer);
+    void        drain(void);
+public:
+    NBIC        nbic;
+
+    NextBusDisk(int slot, const char* image, bool writeprotected);
+    virtual ~NextBusDisk();
+
+    bool        valid(void) { return dsk != NULL; }
+    bool        complete(void);
+
+    virtual uint32_t slot_lget(uint32_t addr);
+    virtual uint16_t slot_wget(uint32_t addr);
+    virtual uint8_t  slot_bget(uint32_t addr);
+    virtual void     slot_lput(uint32_t addr, uint32_t val);
+    virtual void     slot_wput(uint32_t addr, uint16_t val);
+    virtual void     slot_bput(uint32_t addr, uint8_t val);
+
+    virtual void     reset(void);
+};
+
+#endif /* __cplusplus */
+
+#endif /* PREV_NBDISK_HPP */
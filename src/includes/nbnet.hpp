@@ -0,0 +1,73 @@
+/*
+  Previous - nbnet.hpp
+
+  This file is distributed under the GNU General Public License, version 2
+  or at your option any later version. Read the file gpl.txt for details.
+*/
+
+#pragma once
+
+#ifndef PREV_NBNET_HPP
+#define PREV_NBNET_HPP
+
+#define NBNET_NBIC_ID       0xC0000B02
+
+#define LOG_NBNET_LEVEL     LOG_NONE
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+extern void NBNet_IO_Handler(void);
+
+#ifdef __cplusplus
+}
+
+#include "NextBus.hpp"
+#include "nd_nbic.hpp"
+
+class NextBusNet : public NextBusBoard {
+    uint8_t     mac[6];
+
+    uint32_t    rx_base;
+    uint32_t    rx_size;
+    uint32_t    tx_base;
+    uint32_t    tx_size;
+    uint32_t    control;
+    uint32_t    status;
+    uint32_t    delay;
+    uint32_t    drops;
+
+    /* Free running ring indices, producers are written by the driver */
+    uint32_t    rx_prod;
+    uint32_t    rx_done;
+    uint32_t    tx_prod;
+    uint32_t    tx_done;
+
+    int         received;
+
+    static void receive(uint8_t* pkt, int len);
+    bool        accept(const uint8_t* pkt);
+    void        transmit(void);
+    void        set_enable(bool enable);
+public:
+    NBIC        nbic;
+
+    NextBusNet(int slot);
+    virtual ~NextBusNet();
+
+    void        poll(void);
+
+    virtual uint32_t slot_lget(uint32_t addr);
+    virtual uint16_t slot_wget(uint32_t addr);
+    virtual uint8_t  slot_bget(uint32_t addr);
+    virtual void     slot_lput(uint32_t addr, uint32_t val);
+    virtual void     slot_wput(uint32_t addr, uint16_t val);
+    virtual void     slot_bput(uint32_t addr, uint8_t val);
+
+    virtual void     reset(void);
+};
+
+#endif /* __cplusplus */
+
+#endif /* PREV_NBNET_HPP */
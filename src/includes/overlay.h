@@ -0,0 +1,21 @@
+/*
+  Previous - overlay.h
+
+  This file is distributed under the GNU General Public License, version 2
+  or at your option any later version. Read the file gpl.txt for details.
+*/
+
+#ifndef PREV_OVERLAY_H
+#define PREV_OVERLAY_H
+
+typedef struct OVERLAY OVERLAY;
+
+extern OVERLAY *Overlay_Open(const char *path, uint32_t blocksize, uint32_t blocks);
+extern OVERLAY *Overlay_Close(OVERLAY *ov);
+extern bool Overlay_Read(OVERLAY *ov, uint32_t block, uint8_t *data);
+extern bool Overlay_Write(OVERLAY *ov, uint32_t block, uint8_t *data);
+extern bool Overlay_Commit(OVERLAY *ov, FILE *base);
+extern void Overlay_Discard(OVERLAY *ov);
+extern uint32_t Overlay_Count(OVERLAY *ov);
+
+#endif /* PREV_OVERLAY_H */
@@ -0,0 +1,24 @@
+/*
+  Previous - pktring.h
+
+  This file is distributed under the GNU General Public License, version 2
+  or at your option any later version. Read the file gpl.txt for details.
+*/
+
+#ifndef PREV_PKTRING_H
+#define PREV_PKTRING_H
+
+#define PKTRING_SLOTS   256     /* Must be a power of 2 */
+#define PKTRING_MTU     1536    /* Largest frame without CRC, rounded up */
+
+typedef struct PKTRING PKTRING;
+
+extern PKTRING *PktRing_Create(void);
+extern void PktRing_Destroy(PKTRING *ring);
+extern bool PktRing_Put(PKTRING *ring, const uint8_t *pkt, int len);
+extern uint8_t *PktRing_Peek(PKTRING *ring, int *len);
+extern void PktRing_Release(PKTRING *ring);
+extern int PktRing_Free(PKTRING *ring);
+extern uint32_t PktRing_Dropped(PKTRING *ring);
+
+#endif /* PREV_PKTRING_H */
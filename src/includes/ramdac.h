@@ -18,8 +18,17 @@ typedef struct {
     uint8_t  ccr[0xC];
     uint8_t  reg[0x30];
     uint8_t  ram[0x630];
+    /* Colour map entries 0-255 per channel (R, G, B) as applied to true
+     * colour pixels. Stored XOR the index so that a cleared struct is a
+     * linear ramp. lut_nonlinear counts entries off the ramp, lut_gen
+     * changes with every write that alters the table. */
+    uint8_t  lut[3][0x100];
+    int      lut_nonlinear;
+    volatile int lut_gen;
 } bt463;
 
+#define BT463_LUT(ramdac, c, v) ((ramdac)->lut[c][v] ^ (v))
+
 #ifdef __cplusplus
 extern "C" {
 #endif /* __cplusplus */
@@ -27,6 +36,7 @@ extern "C" {
 extern uint32_t bt463_bget(bt463* ramdac, uint32_t addr);
 extern void     bt463_bput(bt463* ramdac, uint32_t addr, uint32_t b);
 
+extern const bt463* RAMDAC_Get(void);
 extern void RAMDAC_Read(void);
 extern void RAMDAC_Write(void);
 
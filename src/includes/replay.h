@@ -0,0 +1,40 @@
+/*
+  Previous - replay.h
+
+  This file is distributed under the GNU General Public License, version 2
+  or at your option any later version. Read the file gpl.txt for details.
+*/
+
+#ifndef PREV_REPLAY_H
+#define PREV_REPLAY_H
+
+#include <time.h>
+
+enum {
+	REPLAY_OFF,
+	REPLAY_RECORD,
+	REPLAY_PLAY
+};
+
+/* Record types */
+enum {
+	REPLAY_KEY_DOWN = 1,
+	REPLAY_KEY_UP,
+	REPLAY_MOUSE_MOVE,
+	REPLAY_MOUSE_DOWN,
+	REPLAY_MOUSE_UP,
+	REPLAY_NET,
+	REPLAY_SNDIN,
+	REPLAY_RESET
+};
+
+extern int nReplayMode;
+
+extern bool   Replay_Init(const char* path, bool record);
+extern void   Replay_UnInit(void);
+extern bool   Replay_Input(int type, int a, int b, int c);
+extern void   Replay_Poll(void);
+extern int    Replay_Data(int type, void* data, int len, int size);
+extern time_t Replay_UnixTime(time_t now);
+
+#endif /* PREV_REPLAY_H */
@@ -0,0 +1,15 @@
+/*
+  Previous - rfb.h
+
+  This file is distributed under the GNU General Public License, version 2
+  or at your option any later version. Read the file gpl.txt for details.
+*/
+
+#ifndef PREV_RFB_H
+#define PREV_RFB_H
+
+extern void Rfb_Init(void);
+extern void Rfb_UnInit(void);
+extern void Rfb_Poll(void);
+
+#endif /* PREV_RFB_H */
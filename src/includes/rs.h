@@ -16,6 +16,7 @@ extern "C" {
 
 extern void rs_encode(uint8_t *sector);
 extern int  rs_decode(uint8_t *sector);
+extern void rs_strip(uint8_t *sector);
 
 #ifdef __cplusplus
 }
@@ -22,5 +22,6 @@ extern void SCC_Clock_Write(void);
 extern void SCC_Reset(void);
 
 extern void SCC_IO_Handler(void);
+extern void SCC_RX_Handler(void);
 
 #endif /* PREV_SCC_H */
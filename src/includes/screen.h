@@ -13,6 +13,7 @@ extern "C" {
 #endif /* __cplusplus */
 
 #include <SDL.h>
+#include "ramdac.h"
 
 extern volatile bool bGrabMouse;
 extern volatile bool bInFullScreen;
@@ -27,11 +28,14 @@ extern void Screen_ReturnFromFullScreen(void);
 extern void Screen_ShowMainWindow(void);
 extern void Screen_SizeChanged(void);
 extern void Screen_ModeChanged(void);
+extern bool Screen_NDInMainWindow(void);
 extern void Screen_StatusbarChanged(void);
 extern void Screen_UpdateRects(SDL_Surface *screen, int numrects, SDL_Rect *rects);
 extern void Screen_UpdateRect(SDL_Surface *screen, int32_t x, int32_t y, int32_t w, int32_t h);
-extern void Screen_BlitDimension(uint32_t* vram, SDL_Texture* tex);
+extern bool Screen_BlitDimension(uint32_t* vram, uint8_t* dirty, bool full, SDL_Texture* tex, const bt463* ramdac, int* lut_gen);
 extern void Screen_Blank(SDL_Texture* tex);
+extern uint64_t Screen_FrameWait(uint64_t* lastFrame);
+extern uint64_t Screen_FrameCount(void);
 extern void Screen_Repaint(void);
 
 #ifdef __cplusplus
@@ -44,12 +44,19 @@ typedef struct {
 extern SCSIBuffer scsi_buffer;
 
 extern void SCSI_Reset(void);
+extern void SCSI_Exit(void);
 extern void SCSI_Insert(uint8_t target);
 extern void SCSI_Eject(uint8_t target);
+extern bool SCSI_OverlayCommit(uint8_t target);
+extern bool SCSI_OverlayDiscard(uint8_t target);
+extern int  SCSI_OverlayCount(uint8_t target);
 
 extern uint8_t SCSIdisk_Send_Status(void);
 extern uint8_t SCSIdisk_Send_Message(void);
+extern bool SCSIdisk_Busy(void);
 extern uint8_t SCSIdisk_Send_Data(void);
+extern uint8_t* SCSIdisk_Send_Span(int* size);
+extern void SCSIdisk_Send_Consume(int size);
 extern void SCSIdisk_Receive_Data(uint8_t val);
 extern bool SCSIdisk_Select(uint8_t target);
 extern void SCSIdisk_Receive_Command(uint8_t *commandbuf, uint8_t identify);
@@ -0,0 +1,18 @@
+/*
+  Previous - serial.h
+
+  This file is distributed under the GNU General Public License, version 2
+  or at your option any later version. Read the file gpl.txt for details.
+*/
+
+#ifndef PREV_SERIAL_H
+#define PREV_SERIAL_H
+
+extern void Serial_Reset(void);
+extern void Serial_Stop(void);
+extern bool Serial_Active(int channel);
+extern int  Serial_Read(uint8_t *buf, int len);
+extern int  Serial_Write(const uint8_t *buf, int len);
+extern int  Serial_WriteFree(void);
+
+#endif /* PREV_SERIAL_H */
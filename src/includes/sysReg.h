@@ -67,7 +67,7 @@ extern "C" {
 #define RELEASE_INT     0
 
 extern void set_interrupt(uint32_t intr, uint8_t state);
-extern void scr_check_dsp_interrupt(void);
+extern void (*scr_check_dsp_interrupt)(void);
 
 extern uint32_t scrIntStat;
 extern uint32_t scrIntMask;
@@ -93,20 +93,32 @@ static inline int intlev(void) {
 extern void SCR_Reset(void);
 
 extern void SCR1_Read(void);
+extern uint32_t SCR1_lget(uint32_t addr);
 
 extern void SCR2_Read0(void);
 extern void SCR2_Write0(void);
 extern void SCR2_Read1(void);
 extern void SCR2_Write1(void);
+extern void SCR2_Write1Turbo(void);
 extern void SCR2_Read2(void);
 extern void SCR2_Write2(void);
 extern void SCR2_Read3(void);
 extern void SCR2_Write3(void);
+extern void SCR2_Write3Turbo(void);
+extern uint32_t SCR2_bget(uint32_t addr);
+extern uint32_t SCR2_lget(uint32_t addr);
 
 extern void IntRegStatRead(void);
 extern void IntRegStatWrite(void);
 extern void IntRegMaskRead(void);
 extern void IntRegMaskWrite(void);
+extern uint32_t IntRegStat_lget(uint32_t addr);
+extern uint32_t IntRegMask_lget(uint32_t addr);
+extern void IntRegMask_lput(uint32_t addr, uint32_t val);
+extern void IntRegMaskReadTurbo(void);
+extern void IntRegMaskWriteTurbo(void);
+extern uint32_t IntRegMaskTurbo_lget(uint32_t addr);
+extern void IntRegMaskTurbo_lput(uint32_t addr, uint32_t val);
 
 extern void Hardclock_InterruptHandler(void);
 extern void HardclockRead0(void);
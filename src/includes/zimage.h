@@ -0,0 +1,34 @@
+/*
+  Previous - zimage.h
+
+  This file is distributed under the GNU General Public License, version 2
+  or at your option any later version. Read the file gpl.txt for details.
+*/
+
+#ifndef PREV_ZIMAGE_H
+#define PREV_ZIMAGE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define ZIMAGE_CHUNKSIZE    (64*1024)
+
+typedef struct ZIMAGE ZIMAGE;
+
+extern uint64_t ZImage_Length(FILE *fp);
+extern ZIMAGE *ZImage_Open(FILE *fp);
+extern ZIMAGE *ZImage_Close(ZIMAGE *zi);
+extern bool ZImage_Read(ZIMAGE *zi, uint8_t *data, uint32_t size, uint64_t offset);
+extern uint64_t ZImage_Size(ZIMAGE *zi);
+extern bool ZImage_Compress(FILE *in, FILE *out, uint32_t chunksize);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PREV_ZIMAGE_H */
@@ -14,15 +14,39 @@ const char IoMem_fileid[] = "Previous ioMem.c";
 #include "ioMemTables.h"
 #include "m68000.h"
 #include "sysdeps.h"
+#include "mo.h"
+#include "printer.h"
 
 #define IO_MASK 0x0001FFFF
 #define IO_SIZE 0x00020000
 
-static void (*pInterceptReadTable[IO_SIZE])(void);   /* Table with read access handlers */
-static void (*pInterceptWriteTable[IO_SIZE])(void);  /* Table with write access handlers */
+/* Everything needed to handle an access is kept together in one entry */
+typedef struct
+{
+	void (*ReadFunc)(void);    /* Read access handler */
+	void (*WriteFunc)(void);   /* Write access handler */
+	uint32_t Mask;             /* Mask for deleting don't-care bits from the address */
+	uint8_t Size;              /* Span of the register in bytes */
+	uint8_t Fast;              /* Index+1 into the fast handler table, 0 if none */
+} IOMEM_ENTRY;
+
+static IOMEM_ENTRY IoMemTable[IO_SIZE];
+static const INTERCEPT_ACCESS_FUNC *pInterceptAccessFuncs;
+static const INTERCEPT_FAST_FUNC *pFastAccessFuncs;
+
+/* Devices that are only reset when the guest first accesses their registers */
+typedef struct
+{
+	uint32_t Start, End;       /* IO range decoded by the device */
+	void (*Reset)(void);       /* Reset function of the device */
+	bool Pending;              /* Access stubs installed, reset not done yet */
+} IOMEM_LAZY;
 
-static uint32_t nAccessSize[IO_SIZE];
-static uint32_t nAccessMask[IO_SIZE];
+static IOMEM_LAZY IoMemLazy[] =
+{
+	{ 0x0f000, 0x0ffff, Printer_Reset, false },
+	{ 0x12000, 0x13fff, MO_Reset, false }
+};
 
 uint32_t IoAccessSize;                               /* Set to 1, 2 or 4 according to byte, word or long word access */
 uint32_t IoAccessMask;                               /* Mask for deleting don't-care bits from the address */
@@ -37,8 +61,8 @@ static int nBusErrorAccesses;                        /* Needed to count bus erro
  */
 void IoMem_Intercept ( uint32_t addr , void (*read_f)(void) , void (*write_f)(void) )
 {
-	pInterceptReadTable[addr] = read_f;
-	pInterceptWriteTable[addr] = write_f;
+	IoMemTable[addr].ReadFunc = read_f;
+	IoMemTable[addr].WriteFunc = write_f;
 }
 
 
@@ -57,34 +81,36 @@ static void IoMem_SetBusErrorRegion(uint32_t startaddr, uint32_t endaddr)
 		else
 			IoMem_Intercept ( a , IoMem_BusErrorEvenReadAccess , IoMem_BusErrorEvenWriteAccess );
 
-		nAccessSize[a] = 1;
-		nAccessMask[a] = IO_MASK;
+		IoMemTable[a].Size = 1;
+		IoMemTable[a].Mask = IO_MASK;
+		IoMemTable[a].Fast = 0;
 	}
 }
 
 
 /*-----------------------------------------------------------------------*/
 /**
- * Create 'intercept' tables for hardware address access. Each 'intercept
+ * Return the direct access handlers for 'addr' or NULL if there are none.
  */
-void IoMem_Init(void)
+static inline const INTERCEPT_FAST_FUNC *IoMem_FastHandler(uaecptr addr)
+{
+	uint8_t index = IoMemTable[addr & IO_MASK].Fast;
+
+	return index ? &pFastAccessFuncs[index - 1] : NULL;
+}
+
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Set the handlers of the registers in a region from the intercept tables.
+ */
+static void IoMem_SetHandlers(uint32_t startaddr, uint32_t endaddr)
 {
 	uint32_t addr;
 	uint32_t base;
 	int i;
-	const INTERCEPT_ACCESS_FUNC *pInterceptAccessFuncs = NULL;
-
-	/* Set default IO access handler (-> bus error) */
-	IoMem_SetBusErrorRegion(0, IO_SIZE - 1);
-
-	if (ConfigureParams.System.bTurbo) {
-		pInterceptAccessFuncs = IoMemTable_Turbo;
-	} else {
-		pInterceptAccessFuncs = IoMemTable_NEXT;
-	}
 
-	/* Now set the correct handlers */
-	for (addr = 0; addr < IO_SIZE; addr++)
+	for (addr = startaddr; addr <= endaddr; addr++)
 	{
 		/* Does this hardware location/span appear in our list of possible intercepted functions? */
 		for (i = 0; pInterceptAccessFuncs[i].Address != 0; i++)
@@ -94,21 +120,142 @@ void IoMem_Init(void)
 			if ((pInterceptAccessFuncs[i].Address & IO_MASK) == base)
 			{
 				/* Security checks... */
-				if (pInterceptReadTable[addr] != IoMem_BusErrorEvenReadAccess && pInterceptReadTable[addr] != IoMem_BusErrorOddReadAccess)
+				if (IoMemTable[addr].ReadFunc != IoMem_BusErrorEvenReadAccess && IoMemTable[addr].ReadFunc != IoMem_BusErrorOddReadAccess)
 					Log_Printf(LOG_WARN, "IoMem_Init: Warning: $%x (R) already defined\n", addr);
-				if (pInterceptWriteTable[addr] != IoMem_BusErrorEvenWriteAccess && pInterceptWriteTable[addr] != IoMem_BusErrorOddWriteAccess)
+				if (IoMemTable[addr].WriteFunc != IoMem_BusErrorEvenWriteAccess && IoMemTable[addr].WriteFunc != IoMem_BusErrorOddWriteAccess)
 					Log_Printf(LOG_WARN, "IoMem_Init: Warning: $%x (W) already defined\n", addr);
 
 				/* This location needs to be intercepted, so add entry to list */
 				IoMem_Intercept ( addr , pInterceptAccessFuncs[i].ReadFunc , pInterceptAccessFuncs[i].WriteFunc );
-				nAccessSize[addr] = pInterceptAccessFuncs[i].SpanInBytes;
-				nAccessMask[addr] = pInterceptAccessFuncs[i].Mask;
+				IoMemTable[addr].Size = pInterceptAccessFuncs[i].SpanInBytes;
+				IoMemTable[addr].Mask = pInterceptAccessFuncs[i].Mask;
+			}
+		}
+	}
+
+	/* Registers that bypass the intercept handlers */
+	for (addr = startaddr; addr <= endaddr; addr++)
+	{
+		for (i = 0; pFastAccessFuncs[i].Address != 0; i++)
+		{
+			base = addr & pFastAccessFuncs[i].Mask & ~(pFastAccessFuncs[i].SpanInBytes - 1);
+			if ((pFastAccessFuncs[i].Address & IO_MASK) == base)
+			{
+				IoMemTable[addr].Fast = i + 1;
 			}
 		}
 	}
 }
 
 
+/*-----------------------------------------------------------------------*/
+/**
+ * Reset the device at 'addr' if that is still pending and put back its
+ * register handlers.
+ */
+static void IoMem_LazyInit(uint32_t addr)
+{
+	IOMEM_LAZY *dev;
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(IoMemLazy); i++)
+	{
+		dev = &IoMemLazy[i];
+		if (dev->Pending && addr >= dev->Start && addr <= dev->End)
+		{
+			dev->Pending = false;
+			IoMem_SetBusErrorRegion(dev->Start, dev->End);
+			IoMem_SetHandlers(dev->Start, dev->End);
+			dev->Reset();
+			return;
+		}
+	}
+}
+
+static void IoMem_LazyReadAccess(void)
+{
+	IoMem_LazyInit(IoAccessCurrentAddress & IO_MASK);
+	IoMemTable[IoAccessCurrentAddress & IO_MASK].ReadFunc();
+}
+
+static void IoMem_LazyWriteAccess(void)
+{
+	IoMem_LazyInit(IoAccessCurrentAddress & IO_MASK);
+	IoMemTable[IoAccessCurrentAddress & IO_MASK].WriteFunc();
+}
+
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Point the registers of the lazily reset devices to the access stubs.
+ * A device without registers in this machine is reset normally.
+ */
+static void IoMem_LazySetup(void)
+{
+	IOMEM_LAZY *dev;
+	uint32_t addr;
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(IoMemLazy); i++)
+	{
+		dev = &IoMemLazy[i];
+		dev->Pending = false;
+		for (addr = dev->Start; addr <= dev->End; addr++)
+		{
+			if (IoMemTable[addr].ReadFunc == IoMem_BusErrorEvenReadAccess ||
+			    IoMemTable[addr].ReadFunc == IoMem_BusErrorOddReadAccess)
+				continue;
+
+			IoMem_Intercept ( addr , IoMem_LazyReadAccess , IoMem_LazyWriteAccess );
+			IoMemTable[addr].Fast = 0;
+			dev->Pending = true;
+		}
+	}
+}
+
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Reset the lazily reset devices that are in use. The others are reset
+ * when the guest first accesses them.
+ */
+void IoMem_LazyReset(void)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(IoMemLazy); i++)
+	{
+		if (!IoMemLazy[i].Pending)
+			IoMemLazy[i].Reset();
+	}
+}
+
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Create 'intercept' tables for hardware address access. Each 'intercept
+ */
+void IoMem_Init(void)
+{
+	/* Set default IO access handler (-> bus error) */
+	IoMem_SetBusErrorRegion(0, IO_SIZE - 1);
+
+	if (ConfigureParams.System.bTurbo) {
+		pInterceptAccessFuncs = IoMemTable_Turbo;
+		pFastAccessFuncs = IoMemFastTable_Turbo;
+	} else {
+		pInterceptAccessFuncs = IoMemTable_NEXT;
+		pFastAccessFuncs = IoMemFastTable_NEXT;
+	}
+
+	/* Now set the correct handlers */
+	IoMem_SetHandlers(0, IO_SIZE - 1);
+
+	/* Defer device resets until first access */
+	IoMem_LazySetup();
+}
+
+
 /**
  * Uninitialize the IoMem code (currently unused).
  */
@@ -143,16 +290,22 @@ uint8_t IoMem_ReadBytePort(void)
  */
 uae_u32 IoMem_bget(uaecptr addr)
 {
+	const INTERCEPT_FAST_FUNC *fast = IoMem_FastHandler(addr);
 	uint8_t val;
 
-	IoAccessMask = nAccessMask[addr & IO_MASK];
-	IoAccessSize = nAccessSize[addr & IO_MASK];
+	if (fast && fast->ReadByte)
+	{
+		return fast->ReadByte(addr);
+	}
+
+	IoAccessMask = IoMemTable[addr & IO_MASK].Mask;
+	IoAccessSize = IoMemTable[addr & IO_MASK].Size;
 	IoAccessCurrentAddress = addr;  /* Store access location */
 	IoAccessBaseAddress = addr & ~(IoAccessSize - 1);
 
 	nBusErrorAccesses = 0;
 
-	pInterceptReadTable[IoAccessCurrentAddress & IO_MASK]();   /* Call handler */
+	IoMemTable[IoAccessCurrentAddress & IO_MASK].ReadFunc();   /* Call handler */
 
 	/* Check if we read from a bus-error region */
 	if (nBusErrorAccesses == SIZE_BYTE)
@@ -163,8 +316,6 @@ uae_u32 IoMem_bget(uaecptr addr)
 
 	val = IoMem_ReadByte(addr);
 
-	LOG_TRACE(TRACE_IOMEM_RD, "IO read.b $%08x = $%02x\n", addr, val);
-
 	return val;
 }
 
@@ -175,6 +326,7 @@ uae_u32 IoMem_bget(uaecptr addr)
  */
 uae_u32 IoMem_wget(uaecptr addr)
 {
+	const INTERCEPT_FAST_FUNC *fast;
 	uint16_t val;
 
 	if (addr & (SIZE_WORD - 1))
@@ -183,15 +335,21 @@ uae_u32 IoMem_wget(uaecptr addr)
 		return 0;
 	}
 
-	IoAccessMask = nAccessMask[addr & IO_MASK];
-	IoAccessSize = nAccessSize[addr & IO_MASK];
+	fast = IoMem_FastHandler(addr);
+	if (fast && fast->ReadWord)
+	{
+		return fast->ReadWord(addr);
+	}
+
+	IoAccessMask = IoMemTable[addr & IO_MASK].Mask;
+	IoAccessSize = IoMemTable[addr & IO_MASK].Size;
 	IoAccessCurrentAddress = addr;  /* Store access location */
 	IoAccessBaseAddress = addr & ~(IoAccessSize - 1);
 
 	nBusErrorAccesses = 0;
 
 	do {
-		pInterceptReadTable[IoAccessCurrentAddress & IO_MASK]();   /* Call handler */
+		IoMemTable[IoAccessCurrentAddress & IO_MASK].ReadFunc();   /* Call handler */
 		IoAccessCurrentAddress += IoAccessSize;
 	} while (IoAccessCurrentAddress < IoAccessBaseAddress + SIZE_WORD);
 
@@ -204,8 +362,6 @@ uae_u32 IoMem_wget(uaecptr addr)
 
 	val = IoMem_ReadWord(addr);
 
-	LOG_TRACE(TRACE_IOMEM_RD, "IO read.w $%08x = $%04x\n", addr, val);
-
 	return val;
 }
 
@@ -216,6 +372,7 @@ uae_u32 IoMem_wget(uaecptr addr)
  */
 uae_u32 IoMem_lget(uaecptr addr)
 {
+	const INTERCEPT_FAST_FUNC *fast;
 	uint32_t val;
 
 	if (addr & (SIZE_LONG - 1))
@@ -224,15 +381,21 @@ uae_u32 IoMem_lget(uaecptr addr)
 		return 0;
 	}
 
-	IoAccessMask = nAccessMask[addr & IO_MASK];
-	IoAccessSize = nAccessSize[addr & IO_MASK];
+	fast = IoMem_FastHandler(addr);
+	if (fast && fast->ReadLong)
+	{
+		return fast->ReadLong(addr);
+	}
+
+	IoAccessMask = IoMemTable[addr & IO_MASK].Mask;
+	IoAccessSize = IoMemTable[addr & IO_MASK].Size;
 	IoAccessCurrentAddress = addr;  /* Store access location */
 	IoAccessBaseAddress = addr & ~(IoAccessSize - 1);
 
 	nBusErrorAccesses = 0;
 
 	do {
-		pInterceptReadTable[IoAccessCurrentAddress & IO_MASK]();   /* Call handler */
+		IoMemTable[IoAccessCurrentAddress & IO_MASK].ReadFunc();   /* Call handler */
 		IoAccessCurrentAddress += IoAccessSize;
 	} while (IoAccessCurrentAddress < IoAccessBaseAddress + SIZE_LONG);
 
@@ -245,8 +408,6 @@ uae_u32 IoMem_lget(uaecptr addr)
 
 	val = IoMem_ReadLong(addr);
 
-	LOG_TRACE(TRACE_IOMEM_RD, "IO read.l $%08x = $%08x\n", addr, val);
-
 	return val;
 }
 
@@ -257,10 +418,16 @@ uae_u32 IoMem_lget(uaecptr addr)
  */
 void IoMem_bput(uaecptr addr, uae_u32 val)
 {
-	LOG_TRACE(TRACE_IOMEM_WR, "IO write.b $%08x = $%02x\n", addr, val&0xff);
+	const INTERCEPT_FAST_FUNC *fast = IoMem_FastHandler(addr);
 
-	IoAccessMask = nAccessMask[addr & IO_MASK];
-	IoAccessSize = nAccessSize[addr & IO_MASK];
+	if (fast && fast->WriteByte)
+	{
+		fast->WriteByte(addr, val & 0xff);
+		return;
+	}
+
+	IoAccessMask = IoMemTable[addr & IO_MASK].Mask;
+	IoAccessSize = IoMemTable[addr & IO_MASK].Size;
 	IoAccessCurrentAddress = addr;  /* Store access location */
 	IoAccessBaseAddress = addr & ~(IoAccessSize - 1);
 
@@ -278,7 +445,7 @@ void IoMem_bput(uaecptr addr, uae_u32 val)
 	}
 
 	do {
-		pInterceptWriteTable[IoAccessCurrentAddress & IO_MASK]();   /* Call handler */
+		IoMemTable[IoAccessCurrentAddress & IO_MASK].WriteFunc();   /* Call handler */
 		IoAccessCurrentAddress += IoAccessSize;
 	} while (IoAccessCurrentAddress < IoAccessBaseAddress + SIZE_BYTE);
 
@@ -296,7 +463,7 @@ void IoMem_bput(uaecptr addr, uae_u32 val)
  */
 void IoMem_wput(uaecptr addr, uae_u32 val)
 {
-	LOG_TRACE(TRACE_IOMEM_WR, "IO write.w $%08x = $%04x\n", addr, val&0xffff);
+	const INTERCEPT_FAST_FUNC *fast;
 
 	if (addr & (SIZE_WORD - 1))
 	{
@@ -304,8 +471,15 @@ void IoMem_wput(uaecptr addr, uae_u32 val)
 		return;
 	}
 
-	IoAccessMask = nAccessMask[addr & IO_MASK];
-	IoAccessSize = nAccessSize[addr & IO_MASK];
+	fast = IoMem_FastHandler(addr);
+	if (fast && fast->WriteWord)
+	{
+		fast->WriteWord(addr, val & 0xffff);
+		return;
+	}
+
+	IoAccessMask = IoMemTable[addr & IO_MASK].Mask;
+	IoAccessSize = IoMemTable[addr & IO_MASK].Size;
 	IoAccessCurrentAddress = addr;  /* Store access location */
 	IoAccessBaseAddress = addr & ~(IoAccessSize - 1);
 
@@ -320,7 +494,7 @@ void IoMem_wput(uaecptr addr, uae_u32 val)
 	}
 
 	do {
-		pInterceptWriteTable[IoAccessCurrentAddress & IO_MASK]();   /* Call handler */
+		IoMemTable[IoAccessCurrentAddress & IO_MASK].WriteFunc();   /* Call handler */
 		IoAccessCurrentAddress += IoAccessSize;
 	} while (IoAccessCurrentAddress < IoAccessBaseAddress + SIZE_WORD);
 
@@ -338,7 +512,7 @@ void IoMem_wput(uaecptr addr, uae_u32 val)
  */
 void IoMem_lput(uaecptr addr, uae_u32 val)
 {
-	LOG_TRACE(TRACE_IOMEM_WR, "IO write.l $%08x = $%08x\n", addr, val);
+	const INTERCEPT_FAST_FUNC *fast;
 
 	if (addr & (SIZE_LONG - 1))
 	{
@@ -346,8 +520,15 @@ void IoMem_lput(uaecptr addr, uae_u32 val)
 		return;
 	}
 
-	IoAccessMask = nAccessMask[addr & IO_MASK];
-	IoAccessSize = nAccessSize[addr & IO_MASK];
+	fast = IoMem_FastHandler(addr);
+	if (fast && fast->WriteLong)
+	{
+		fast->WriteLong(addr, val);
+		return;
+	}
+
+	IoAccessMask = IoMemTable[addr & IO_MASK].Mask;
+	IoAccessSize = IoMemTable[addr & IO_MASK].Size;
 	IoAccessCurrentAddress = addr;  /* Store access location */
 	IoAccessBaseAddress = addr & ~(IoAccessSize - 1);
 
@@ -356,7 +537,7 @@ void IoMem_lput(uaecptr addr, uae_u32 val)
 	IoMem_WriteLong(IoAccessBaseAddress, val);
 
 	do {
-		pInterceptWriteTable[IoAccessCurrentAddress & IO_MASK]();   /* Call handler */
+		IoMemTable[IoAccessCurrentAddress & IO_MASK].WriteFunc();   /* Call handler */
 		IoAccessCurrentAddress += IoAccessSize;
 	} while (IoAccessCurrentAddress < IoAccessBaseAddress + SIZE_LONG);
 
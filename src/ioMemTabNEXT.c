@@ -314,3 +314,27 @@ const INTERCEPT_ACCESS_FUNC IoMemTable_NEXT[] =
 
 	{ 0, 0, NULL, NULL }
 };
+
+
+/*-----------------------------------------------------------------------*/
+/*
+ List of registers that are polled by the kernel and can be accessed directly.
+ */
+const INTERCEPT_FAST_FUNC IoMemFastTable_NEXT[] =
+{
+	/* Interrupt Status and Mask Registers */
+	{ 0x02007000, 0x0001f803, SIZE_LONG, NULL, NULL, IntRegStat_lget, NULL, NULL, NULL },
+	{ 0x02007800, 0x0001f803, SIZE_LONG, NULL, NULL, IntRegMask_lget, NULL, NULL, IntRegMask_lput },
+	
+	/* DSP (Motorola XSP56001) */
+	{ 0x02008000, 0x0001e007, 8, DSP_Host_bget, DSP_Host_wget, DSP_Host_lget, DSP_Host_bput, DSP_Host_wput, DSP_Host_lput },
+	
+	/* System Control Register 1 */
+	{ 0x0200c000, 0x0001f803, SIZE_LONG, NULL, NULL, SCR1_lget, NULL, NULL, NULL },
+	{ 0x0200c800, 0x0001f803, SIZE_LONG, NULL, NULL, SCR1_lget, NULL, NULL, NULL },
+	
+	/* System Control Register 2 */
+	{ 0x0200d000, 0x0001f003, SIZE_LONG, SCR2_bget, NULL, SCR2_lget, NULL, NULL, NULL },
+	
+	{ 0, 0, 0, NULL, NULL, NULL, NULL, NULL, NULL }
+};
@@ -126,7 +126,7 @@ const INTERCEPT_ACCESS_FUNC IoMemTable_Turbo[] =
 	
 	/* Interrupt Status and Mask Registers */
 	{ 0x02007000, 0x0001f803, SIZE_LONG, IntRegStatRead, IntRegStatWrite },
-	{ 0x02007800, 0x0001f803, SIZE_LONG, IntRegMaskRead, IntRegMaskWrite },
+	{ 0x02007800, 0x0001f803, SIZE_LONG, IntRegMaskReadTurbo, IntRegMaskWriteTurbo },
 	
 	/* DSP (Motorola XSP56001) */
 	{ 0x02008000, 0x0001e007, SIZE_BYTE, DSP_ICR_Read, DSP_ICR_Write },
@@ -144,9 +144,9 @@ const INTERCEPT_ACCESS_FUNC IoMemTable_Turbo[] =
 
 	/* System Control Register 2 */
 	{ 0x0200d000, 0x0001f003, SIZE_BYTE, SCR2_Read0, SCR2_Write0 },
-	{ 0x0200d001, 0x0001f003, SIZE_BYTE, SCR2_Read1, SCR2_Write1 },
+	{ 0x0200d001, 0x0001f003, SIZE_BYTE, SCR2_Read1, SCR2_Write1Turbo },
 	{ 0x0200d002, 0x0001f003, SIZE_BYTE, SCR2_Read2, SCR2_Write2 },
-	{ 0x0200d003, 0x0001f003, SIZE_BYTE, SCR2_Read3, SCR2_Write3 },
+	{ 0x0200d003, 0x0001f003, SIZE_BYTE, SCR2_Read3, SCR2_Write3Turbo },
 
 	/* Monitor/Soundbox (Keyboard, Mouse, Sound) */
 	{ 0x0200e000, 0x0001f00f, SIZE_BYTE, KMS_Stat_Snd_Read, KMS_Ctrl_Snd_Write },
@@ -235,3 +235,27 @@ const INTERCEPT_ACCESS_FUNC IoMemTable_Turbo[] =
 	
 	{ 0, 0, NULL, NULL }
 };
+
+
+/*-----------------------------------------------------------------------*/
+/*
+ List of registers that are polled by the kernel and can be accessed directly.
+ */
+const INTERCEPT_FAST_FUNC IoMemFastTable_Turbo[] =
+{
+	/* Interrupt Status and Mask Registers */
+	{ 0x02007000, 0x0001f803, SIZE_LONG, NULL, NULL, IntRegStat_lget, NULL, NULL, NULL },
+	{ 0x02007800, 0x0001f803, SIZE_LONG, NULL, NULL, IntRegMaskTurbo_lget, NULL, NULL, IntRegMaskTurbo_lput },
+	
+	/* DSP (Motorola XSP56001) */
+	{ 0x02008000, 0x0001e007, 8, DSP_Host_bget, DSP_Host_wget, DSP_Host_lget, DSP_Host_bput, DSP_Host_wput, DSP_Host_lput },
+	
+	/* System Control Register 1 */
+	{ 0x0200c000, 0x0001f803, SIZE_LONG, NULL, NULL, SCR1_lget, NULL, NULL, NULL },
+	{ 0x0200c800, 0x0001f803, SIZE_LONG, NULL, NULL, SCR1_lget, NULL, NULL, NULL },
+	
+	/* System Control Register 2 */
+	{ 0x0200d000, 0x0001f003, SIZE_LONG, SCR2_bget, NULL, SCR2_lget, NULL, NULL, NULL },
+	
+	{ 0, 0, 0, NULL, NULL, NULL, NULL, NULL, NULL }
+};
@@ -18,6 +18,7 @@ const char Keymap_fileid[] = "Previous keymap.c";
 #include "log.h"
 #include "kms.h"
 #include "adb.h"
+#include "replay.h"
 
 #define  LOG_KEYMAP_LEVEL   LOG_DEBUG
 
@@ -415,6 +416,9 @@ void Keymap_KeyDown(const SDL_Keysym *sdlkey)
 {
 	uint8_t next_mod, next_key;
 
+	if (!Replay_Input(REPLAY_KEY_DOWN, sdlkey->sym, sdlkey->scancode, sdlkey->mod)) {
+		return;
+	}
 	if (ConfigureParams.System.bADB && ConfigureParams.System.bTurbo) {
 		ADB_KeyDown(sdlkey);
 		return;
@@ -441,6 +445,9 @@ void Keymap_KeyUp(const SDL_Keysym *sdlkey)
 {
 	uint8_t next_mod, next_key;
 
+	if (!Replay_Input(REPLAY_KEY_UP, sdlkey->sym, sdlkey->scancode, sdlkey->mod)) {
+		return;
+	}
 	if (ConfigureParams.System.bADB && ConfigureParams.System.bTurbo) {
 		ADB_KeyUp(sdlkey);
 		return;
@@ -468,6 +475,9 @@ void Keymap_MouseMove(int dx, int dy)
 	bool left = false;
 	bool up   = false;
 
+	if (!Replay_Input(REPLAY_MOUSE_MOVE, dx, dy, 0)) {
+		return;
+	}
 	if (ConfigureParams.System.bADB && ConfigureParams.System.bTurbo) {
 		ADB_MouseMove(dx, dy);
 		return;
@@ -490,6 +500,9 @@ void Keymap_MouseMove(int dx, int dy)
  */
 void Keymap_MouseDown(bool left)
 {
+	if (!Replay_Input(REPLAY_MOUSE_DOWN, left, 0, 0)) {
+		return;
+	}
 	if (ConfigureParams.System.bADB && ConfigureParams.System.bTurbo) {
 		ADB_MouseButton(left,true);
 		return;
@@ -504,6 +517,9 @@ void Keymap_MouseDown(bool left)
  */
 void Keymap_MouseUp(bool left)
 {
+	if (!Replay_Input(REPLAY_MOUSE_UP, left, 0, 0)) {
+		return;
+	}
 	if (ConfigureParams.System.bADB && ConfigureParams.System.bTurbo) {
 		ADB_MouseButton(left,false);
 		return;
@@ -44,6 +44,16 @@ struct {
     uint32_t km_mask;
 } kms;
 
+/* Keyboard and mouse data that arrives while the previous data has not
+ * been read by the guest waits here instead of overrunning the register. */
+#define KM_QUEUE_SIZE 64
+
+static struct {
+    uint32_t data[KM_QUEUE_SIZE];
+    int      head;
+    int      count;
+} km_queue;
+
 
 /* KMS control and status register (0x0200E000) 
  *
@@ -215,15 +225,31 @@ static void kms_km_receive(uint32_t data) {
     }
     
     /* Normal keyboard or mouse data */
-    kms.kmdata = data;
-    
     if (kms.status.km&KM_RECEIVED) {
+        if (km_queue.count < KM_QUEUE_SIZE) {
+            km_queue.data[(km_queue.head+km_queue.count)%KM_QUEUE_SIZE] = data;
+            km_queue.count++;
+            return;
+        }
         kms.status.km |= KM_OVERRUN;
     }
+    kms.kmdata = data;
     kms.status.km |= (KM_RECEIVED|KM_INT);
     set_interrupt(INT_KEYMOUSE, SET_INT);
 }
 
+/* Deliver queued data after the guest has read the data register */
+static void kms_km_receive_next(void) {
+    uint32_t data;
+    
+    if (km_queue.count) {
+        data = km_queue.data[km_queue.head];
+        km_queue.head = (km_queue.head+1)%KM_QUEUE_SIZE;
+        km_queue.count--;
+        kms_km_receive(data);
+    }
+}
+
 static bool kms_codec_dma_blockend;
 
 static void kms_codec_receive(uint32_t data) {
@@ -334,9 +360,15 @@ static void km_internal_poll(uint8_t addr) {
     Log_Printf(LOG_KMS_LEVEL, "[KMS] Device %i disabled (mask: %08X)",device,kms.km_mask);
 }
 
+static uint16_t kms_mouse_data(void);
+
 static void km_user_poll(uint8_t addr) {
     uint32_t data = 0;
     
+    /* Report motion accumulated since the last poll */
+    if (addr&KM_MOUSE) {
+        kms.km_data[addr&KM_ADDR_MASK] = kms_mouse_data();
+    }
     data = kms.km_data[addr&KM_ADDR_MASK];
     
     addr &= ~KM_ADDR_MASK;
@@ -381,15 +413,12 @@ static void km_version(uint8_t addr) {
 }
 
 
-/* Mouse states */
-bool m_button_right = false;
-bool m_button_left  = false;
-bool m_move_left    = false;
-bool m_move_up      = false;
-int  m_move_x       = 0;
-int  m_move_y       = 0;
-int  m_move_dx      = 0;
-int  m_move_dy      = 0;
+/* Mouse states, motion is accumulated until it is reported (right, down) */
+static bool m_button_right = false;
+static bool m_button_left  = false;
+static bool m_moving       = false;
+static int  m_move_x       = 0;
+static int  m_move_y       = 0;
 
 void kms_keydown(uint8_t modkeys, uint8_t keycode) {
     uint8_t  addr = kms.km_addr|KM_MASTER;
@@ -441,20 +470,28 @@ void kms_mouse_button(bool left, bool down) {
     km_internal_poll(addr);
 }
 
-static void kms_mouse_move_step(void) {
-    uint8_t  addr = kms.km_addr|KM_MOUSE;
-    uint16_t data = 0;
+/* A report moves by a part of the accumulated motion, at most 63 units */
+#define MOUSE_STEP_DIV  8
+#define MOUSE_STEP_MAX  32
 
-    int x = m_move_x > m_move_dx ? m_move_dx : m_move_x;
-    int y = m_move_y > m_move_dy ? m_move_dy : m_move_y;
+static int kms_mouse_step(int* move) {
+    int d = abs(*move) / MOUSE_STEP_DIV;
+    
+    if (d < 1) d = 1;
+    if (d > MOUSE_STEP_MAX) d = MOUSE_STEP_MAX;
+    if (d > abs(*move)) d = abs(*move);
+    if (*move < 0) d = -d;
+    
+    *move -= d;
+    return d;
+}
 
-    m_move_x -= x;
-    m_move_y -= y;
+static uint16_t kms_mouse_data(void) {
+    uint16_t data = 0;
     
-    if (!m_move_left && x>0)  /* right */
-        x=(0x40-x)|0x40;
-    if (!m_move_up && y>0)    /* down */
-        y=(0x40-y)|0x40;
+    /* Left and up are positive, 7 bit two's complement */
+    int x = -kms_mouse_step(&m_move_x) & 0x7F;
+    int y = -kms_mouse_step(&m_move_y) & 0x7F;
     
     data |= (x<<1)&MOUSE_X;
     data |= (y<<9)&MOUSE_Y;
@@ -462,8 +499,14 @@ static void kms_mouse_move_step(void) {
     data |= m_button_left?0:MOUSE_LEFT_UP;
     data |= m_button_right?0:MOUSE_RIGHT_UP;
     
-    kms.km_data[addr&KM_ADDR_MASK] = data;
+    return data;
+}
 
+static void kms_mouse_move_step(void) {
+    uint8_t addr = kms.km_addr|KM_MOUSE;
+    
+    kms.km_data[addr&KM_ADDR_MASK] = kms_mouse_data();
+    
     km_internal_poll(addr);
 }
 
@@ -473,33 +516,27 @@ static void kms_mouse_move_step(void) {
 void kms_mouse_move(int x, bool left, int y, bool up) {
     if (x<0 || y<0) abort();
     
-    m_move_left = left;
-    m_move_up   = up;
-#if 0
-    int xsteps = x / 8; if(xsteps == 0) xsteps = 1;
-    int ysteps = y / 8; if(ysteps == 0) ysteps = 1;
-    
-    m_move_x  = x;
-    m_move_dx = x / xsteps;
-    
-    m_move_y  = y;
-    m_move_dy = y / ysteps;
-#else
-    m_move_x = x;
-    m_move_y = y;
+    m_move_x += left ? -x : x;
+    m_move_y += up   ? -y : y;
     
-    m_move_dx = 1;
-    m_move_dy = 1;
-#endif
-    CycInt_AddRelativeInterruptCycles(10, INTERRUPT_MOUSE);
+    /* Host events only add to the motion, the handler reports it */
+    if (!m_moving) {
+        m_moving = true;
+        CycInt_AddRelativeInterruptCycles(10, INTERRUPT_MOUSE);
+    }
 }
 
 void Mouse_Handler(void) {
     CycInt_AcknowledgeInterrupt();
     
-    if (m_move_x > 0 || m_move_y > 0) {
-        kms_mouse_move_step();
+    if (m_move_x || m_move_y) {
+        /* Coalesce while the guest has not read the last event */
+        if (!(kms.status.km&KM_RECEIVED)) {
+            kms_mouse_move_step();
+        }
         CycInt_AddRelativeInterruptUs((1000*1000)/MOUSE_STEP_FREQ, 0, INTERRUPT_MOUSE);
+    } else {
+        m_moving = false;
     }
 }
 
@@ -508,6 +545,8 @@ static void km_reset(void) {
     
     m_move_x = 0;
     m_move_y = 0;
+    km_queue.head  = 0;
+    km_queue.count = 0;
     
     kms.km_addr = 0;
     kms.km_mask = 0;
@@ -694,6 +733,7 @@ void KMS_Ctrl_KM_Write(void) {
     if (val&KM_OVERRUN) {
         kms.status.km &= ~(KM_RECEIVED|KM_OVERRUN|KM_INT);
         set_interrupt(INT_KEYMOUSE, RELEASE_INT);
+        kms_km_receive_next();
     }
     if (val&NMI_RECEIVED) {
         kms.status.km &= ~NMI_RECEIVED;
@@ -752,6 +792,7 @@ void KMS_KM_Data_Read(void) { // 0x0200e008
 
     kms.status.km &= ~(KM_RECEIVED|KM_INT);
     set_interrupt(INT_KEYMOUSE, RELEASE_INT);
+    kms_km_receive_next();
 }
 
 /* Reset */
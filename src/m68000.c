@@ -12,6 +12,14 @@ const char M68000_fileid[] = "Previous m68000.c";
 #include "m68000.h"
 #include "cpummu.h"
 #include "cpummu030.h"
+#include "blockcache.h"
+#include "hosttlb.h"
+#include "symbols.h"
+#include "log.h"
+
+uint32_t nKernelIdleStart;
+uint32_t nKernelIdleSize;
+uint64_t nKernelIdleCycles;
 
 
 /**
@@ -64,6 +72,34 @@ void M68000_CheckInterrupt(void)
 }
 
 
+/*-----------------------------------------------------------------------*/
+/**
+ * Look up the code of the kernel's idle thread in the kernel symbols
+ * when idle skipping is enabled. NeXTSTEP's Mach kernel names it after
+ * its continuation or the thread function.
+ */
+static void M68000_FindKernelIdle(void)
+{
+	static const char *names[] = { "_idle_thread_continue", "_idle_thread" };
+	uint32_t start, end;
+	int i;
+
+	nKernelIdleStart = nKernelIdleSize = 0;
+	if (!ConfigureParams.System.bKernelIdle)
+		return;
+
+	for (i = 0; i < ARRAY_SIZE(names); i++) {
+		if (Symbols_GetCpuFunctionRange(names[i], &start, &end)) {
+			nKernelIdleStart = start;
+			nKernelIdleSize  = end - start;
+			Log_Printf(LOG_WARN, "[CPU] Kernel idle thread at $%08x-$%08x (%s)", start, end, names[i]);
+			return;
+		}
+	}
+	Log_Printf(LOG_WARN, "[CPU] Kernel idle thread not found, no symbols on the boot disk");
+}
+
+
 /*-----------------------------------------------------------------------*/
 /**
  * Check whether CPU settings have been changed.
@@ -119,6 +155,12 @@ void M68000_CheckCpuSettings(void)
 			break;
 		default: fprintf (stderr, "M68000_CheckCpuSettings(): Error, fpu_model unknown\n");
 	}
+	
+	/* Softfloat FPU or faster, less exact host FPU */
+	changed_prefs.fpu_mode = ConfigureParams.System.bCompatibleFPU ? 1 : 0;
+
+	/* Skip the 68040 cache line walks of CINV and CPUSH if not wanted */
+	changed_prefs.cpu_no_caches = !ConfigureParams.System.bCpuCaches;
 
 	/* Hard coded for Previous */
 	changed_prefs.cpu_compatible = false;
@@ -127,11 +169,35 @@ void M68000_CheckCpuSettings(void)
 	changed_prefs.mmu_ec = false;
 	changed_prefs.int_no_unimplemented = true;
 	changed_prefs.fpu_no_unimplemented = true;
+	changed_prefs.fpu_strict = true;
 	changed_prefs.address_space_24 = false;
 	changed_prefs.cpu_data_cache = false;
 	changed_prefs.cachesize = 0;
 
 	check_prefs_changed_cpu();
+
+	/* Only used by the non-prefetch 68030 and 68040 loops */
+	blockcache_enable(ConfigureParams.System.bBlockCache);
+	hosttlb_enable(ConfigureParams.System.bHostTLB);
+	blockcache_enable_loops(ConfigureParams.System.bFastLoops);
+
+	M68000_FindKernelIdle();
+}
+
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Skip cycles while the kernel idles. Called after an instruction in the
+ * idle thread was executed with all interrupts enabled. The thread only
+ * finds work after an interrupt, so nothing is lost by advancing to the
+ * next event. Return the number of cycles to account for the instruction.
+ */
+int M68000_KernelIdle(int cycles)
+{
+	int skip = CycInt_Idle(cycles);
+
+	nKernelIdleCycles += skip - cycles;
+	return skip;
 }
 
 
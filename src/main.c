@@ -17,12 +17,15 @@ const char Main_fileid[] = "Previous main.c";
 #include "main.h"
 #include "configuration.h"
 #include "dialog.h"
+#include "diskcache.h"
+#include "enet_slirp.h"
 #include "ioMem.h"
 #include "keymap.h"
 #include "log.h"
 #include "m68000.h"
 #include "paths.h"
 #include "reset.h"
+#include "scsi.h"
 #include "screen.h"
 #include "sdlgui.h"
 #include "shortcut.h"
@@ -36,6 +39,10 @@ const char Main_fileid[] = "Previous main.c";
 #include "dsp.h"
 #include "host.h"
 #include "grab.h"
+#include "rfb.h"
+#include "metrics.h"
+#include "bootbench.h"
+#include "replay.h"
 #include "dimension.hpp"
 
 #include "hatari-glue.h"
@@ -49,6 +56,7 @@ volatile bool bQuitProgram = false;            /* Flag to quit program cleanly *
 volatile bool bEmulationActive = false;        /* Do not run emulation during initialization */
 static bool   bAccurateDelays;                 /* Host system has an accurate SDL_Delay()? */
 static bool   bIgnoreNextMouseMotion = false;  /* Next mouse motion will be ignored (needed after SDL_WarpMouse) */
+static volatile sig_atomic_t bGrabRequest = 0;  /* Screen grab requested by signal */
 
 #ifndef ENABLE_RENDERING_THREAD
 static SDL_Thread* nextThread;
@@ -87,6 +95,11 @@ void Main_SpeedReset(void) {
 	Log_Printf(LOG_WARN, "Realtime mode %s.\n", ConfigureParams.System.bRealtime ? "enabled" : "disabled");
 }
 
+/* Emulated time per real time over the last statusbar interval */
+double Main_SpeedFactor(void) {
+	return speedFactor;
+}
+
 const char* Main_SpeedMsg(void) {
 	speedMsg[0] = 0;
 	if(speedFactor > 0) {
@@ -106,6 +119,8 @@ const char* Main_SpeedMsg(void) {
 static const report_t reports[] = {
 	{"ND",    nd_reports},
 	{"Host",  host_report},
+	{"Disk",  DiskCache_Report},
+	{"NFS",   nfsd_report},
 };
 #endif
 
@@ -181,6 +196,11 @@ bool Main_UnPauseEmulation(void) {
  * reset or quit.
  */
 static void Main_HaltDialog(void) {
+	if (ConfigureParams.Screen.bHeadless) {
+		Log_Printf(LOG_WARN, "Fatal error: CPU halted! Quitting.");
+		Main_RequestQuit(false);
+		return;
+	}
 	Main_PauseEmulation(true);
 	Log_Printf(LOG_WARN, "Fatal error: CPU halted!");
 	if (!DlgAlert_Query("Fatal error: CPU halted!\n\nPress OK to restart CPU or cancel to quit.")) {
@@ -251,6 +271,9 @@ static void Main_CheckForAccurateDelays(void) {
  * that is generated by SDL_WarpMouse().
  */
 void Main_WarpMouse(int x, int y) {
+	if (!sdlWindow) {
+		return;
+	}
 	SDL_WarpMouseInWindow(sdlWindow, x, y); /* Set mouse pointer to new position */
 	bIgnoreNextMouseMotion = true;          /* Ignore mouse motion event from SDL_WarpMouse */
 }
@@ -263,6 +286,9 @@ void Main_WarpMouse(int x, int y) {
 bool Main_ShowCursor(bool show) {
 	bool bOldVisibility;
 
+	if (!sdlWindow) {
+		return false;
+	}
 	bOldVisibility = SDL_ShowCursor(SDL_QUERY) == SDL_ENABLE;
 	if (bOldVisibility != show) {
 		if (show) {
@@ -280,6 +306,9 @@ bool Main_ShowCursor(bool show) {
  * Set mouse grab.
  */
 void Main_SetMouseGrab(bool grab) {
+	if (!sdlWindow) {
+		return;
+	}
 	/* If emulation is active, set the mouse cursor mode now: */
 	if (grab) {
 		if (bEmulationActive) {
@@ -299,21 +328,22 @@ void Main_SetMouseGrab(bool grab) {
 #ifndef ENABLE_RENDERING_THREAD
 /* ----------------------------------------------------------------------- */
 /**
- * Save an event and make it available to the emulator thread.
+ * Single producer, single consumer ring buffer that passes input events
+ * from the main thread to the emulator thread without locking. Each index
+ * is only written by one side.
  **/
-#define MAX_EVENTS  16
+#define MAX_EVENTS  64              /* must be a power of two */
 static SDL_Event    mainEvent[MAX_EVENTS];
-static SDL_SpinLock mainEventLock;
-static int          mainEventWrite;
-static int          mainEventRead;
-static int          mainEventNext;
+static SDL_atomic_t mainEventWrite; /* written by main thread */
+static SDL_atomic_t mainEventRead;  /* written by emulator thread */
 
 /* ----------------------------------------------------------------------- */
 /**
  * Initialize event queue.
  **/
 static void Main_InitEvents(void) {
-	mainEventRead = mainEventWrite = 0;
+	SDL_AtomicSet(&mainEventRead, 0);
+	SDL_AtomicSet(&mainEventWrite, 0);
 }
 
 /* ----------------------------------------------------------------------- */
@@ -321,21 +351,20 @@ static void Main_InitEvents(void) {
  * Save an event. Called from main loop.
  **/
 static void Main_PutEvent(SDL_Event* event) {
+	int write, next;
+
 	if (!bEmulationActive)
 		return;
 
-	SDL_AtomicLock(&mainEventLock);
-	mainEventNext = mainEventWrite + 1;
-	if (mainEventNext >= MAX_EVENTS) {
-		mainEventNext = 0;
-	}
-	if (mainEventNext == mainEventRead) {
+	write = SDL_AtomicGet(&mainEventWrite);
+	next  = (write + 1) & (MAX_EVENTS - 1);
+	if (next == SDL_AtomicGet(&mainEventRead)) {
 		Log_Printf(LOG_WARN, "Events queue overflow!");
-	} else {
-		mainEvent[mainEventWrite] = *event;
-		mainEventWrite = mainEventNext;
+		return;
 	}
-	SDL_AtomicUnlock(&mainEventLock);
+	mainEvent[write] = *event;
+	/* Publish the event only after it has been stored */
+	SDL_AtomicSet(&mainEventWrite, next);
 }
 
 /* ----------------------------------------------------------------------- */
@@ -343,21 +372,16 @@ static void Main_PutEvent(SDL_Event* event) {
  * Get saved event. Called from emulator thread.
  **/
 static bool Main_GetEvent(SDL_Event* event) {
-	bool valid = false;
+	int read = SDL_AtomicGet(&mainEventRead);
 
-	SDL_AtomicLock(&mainEventLock);
-	if (mainEventWrite != mainEventRead) {
-		mainEventNext = mainEventRead + 1;
-		if (mainEventNext >= MAX_EVENTS) {
-			mainEventNext = 0;
-		}
-		*event = mainEvent[mainEventRead];
-		valid = true;
-		mainEventRead = mainEventNext;
+	if (read == SDL_AtomicGet(&mainEventWrite)) {
+		return false;
 	}
-	SDL_AtomicUnlock(&mainEventLock);
+	*event = mainEvent[read];
+	/* Release the slot only after the event has been copied */
+	SDL_AtomicSet(&mainEventRead, (read + 1) & (MAX_EVENTS - 1));
 
-	return valid;
+	return true;
 }
 #endif // !ENABLE_RENDERING_THREAD
 
@@ -489,6 +513,26 @@ void Main_ResetKeys(void) {
 	SDL_PushEvent(&event);
 }
 
+/* ----------------------------------------------------------------------- */
+/**
+ * Return how many microseconds the emulation is ahead of its pacing clock.
+ * This is real time scaled by the speed governor, or the audio output device while it plays samples and
+ * audio sync is enabled. The difference between both clocks is kept when
+ * switching back to real time, so the emulation does not have to catch up.
+ */
+static int64_t Main_PacingOffset(void) {
+	static int64_t audioDrift = 0;
+	int64_t offset = host_pace_offset();
+	int64_t audioOffset;
+
+	if (ConfigureParams.System.bAudioSync && !ConfigureParams.System.bRealtime &&
+	    Audio_Output_Clock_Offset(&audioOffset)) {
+		audioDrift = offset - audioOffset;
+		return audioOffset;
+	}
+	return offset - audioDrift;
+}
+
 /* ----------------------------------------------------------------------- */
 /**
  * Emulator message handler. Called from emulator.
@@ -523,15 +567,34 @@ void Main_EventHandlerInterrupt(void) {
 		fprintf(stderr, "\n");
 		fflush(stderr);
 #endif
+		nd_stats_dump(vt);
 		Main_Speed(rt, vt);
+		host_governor(speedFactor);
+		Metrics_Update();
 		Statusbar_UpdateInfo();
 		statusBarUpdate = 0;
 	}
 
+	if (bGrabRequest) {
+		bGrabRequest = 0;
+		Grab_Screen();
+	}
+
+	if (bBootbench) {
+		Bootbench_Poll();
+	}
+
+	if (nReplayMode == REPLAY_PLAY) {
+		Replay_Poll();
+	}
+
+	Rfb_Poll();
+
 #ifdef ENABLE_RENDERING_THREAD
 	Main_EventHandler();
 #else
-	if (Main_GetEvent(&event)) {
+	/* Handle all events that arrived since the last call */
+	while (Main_GetEvent(&event)) {
 		switch (event.type) {
 			case SDL_MOUSEMOTION:
 				Keymap_MouseMove(event.motion.xrel, event.motion.yrel);
@@ -556,9 +619,11 @@ void Main_EventHandlerInterrupt(void) {
 		}
 	}
 
-	time_offset = host_real_time_offset();
-	if (time_offset > 0) {
-		host_sleep_us(time_offset);
+	if (!ConfigureParams.System.bFastForward) {
+		time_offset = Main_PacingOffset();
+		if (time_offset > 0) {
+			host_sleep_us(time_offset);
+		}
 	}
 #endif // !ENABLE_RENDERING_THREAD
 
@@ -603,7 +668,9 @@ void Main_EventHandler(void) {
 
 #ifdef ENABLE_RENDERING_THREAD
 		if (bEmulationActive) {
-			int64_t time_offset = host_real_time_offset() / 1000;
+			int64_t time_offset = 0;
+			if (!ConfigureParams.System.bFastForward)
+				time_offset = Main_PacingOffset() / 1000;
 			if (time_offset > 10)
 				events = SDL_WaitEventTimeout(&event, (int)time_offset);
 			else
@@ -807,6 +874,8 @@ void Main_CheckStatusbarUpdate(void) {
  * Set Previous window title. Use NULL for default
  */
 void Main_SetTitle(const char *title) {
+	if (!sdlWindow)
+		return;
 	if (title)
 		SDL_SetWindowTitle(sdlWindow, title);
 	else
@@ -820,6 +889,10 @@ void Main_SetTitle(const char *title) {
  * @return true if configuration is ready, false if we need to quit
  */
 static bool Main_StartMenu(void) {
+	/* Nobody to talk to, missing files make the reset fail instead */
+	if (ConfigureParams.Screen.bHeadless) {
+		return true;
+	}
 	if (!File_Exists(sConfigFileName) || ConfigureParams.ConfigDialog.bShowConfigDialogAtStartup) {
 		Dialog_DoProperty();
 	}
@@ -844,28 +917,40 @@ static bool Main_Init(void) {
 	Log_Printf(LOG_INFO, PROG_NAME ", compiled on:  " __DATE__ ", " __TIME__ "\n");
 
 	/* Init SDL's video and timer subsystems. Note: Audio subsystem
-	   will be initialized later (failure not fatal). */
-	if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_TIMER) < 0)
+	   will be initialized later (failure not fatal). Headless mode
+	   only needs timers and the event queue. */
+	if (SDL_Init(ConfigureParams.Screen.bHeadless ? (SDL_INIT_TIMER | SDL_INIT_EVENTS) : (SDL_INIT_VIDEO | SDL_INIT_TIMER)) < 0)
 	{
 		fprintf(stderr, "Could not initialize the SDL library:\n %s\n", SDL_GetError() );
 		exit(-1);
 	}
+	Bootbench_StartupStep("SDL");
 	SDLGui_Init();
 	Screen_Init();
 	Keymap_Init();
+	Rfb_Init();
+	Metrics_Init();
 	Main_SetTitle(NULL);
+	Bootbench_StartupStep("screen");
 
 	/* Init emulation */
 	M68000_Init();
+	Bootbench_StartupStep("CPU");
 	DSP_Init();
 	IoMem_Init();
 	/* Done as last, needs CPU & DSP running... */
 	DebugUI_Init();
+	Bootbench_StartupStep("devices");
 
 	/* Call menu at startup */
 	if (Main_StartMenu()) {
+		bool ok;
+
+		Bootbench_StartupStep("menu");
 		/* Reset emulated machine */
-		return !Reset_Cold();
+		ok = !Reset_Cold();
+		Bootbench_StartupStep("reset");
+		return ok;
 	}
 	return false;
 }
@@ -883,8 +968,12 @@ static void Main_UnInit(void) {
 	SDL_WaitThread(nextThread, &d);
 	SDL_DestroySemaphore(pauseFlag);
 #endif
+	SCSI_Exit();
 	IoMem_UnInit();
 	SDLGui_UnInit();
+	Rfb_UnInit();
+	Replay_UnInit();
+	Metrics_UnInit();
 	Screen_UnInit();
 	Exit680x0();
 
@@ -948,6 +1037,16 @@ static void Main_StatusbarSetup(void) {
 	Statusbar_UpdateInfo();
 }
 
+#ifndef _WIN32
+/*-----------------------------------------------------------------------*/
+/**
+ * Request a screen grab, useful in headless mode (kill -USR1 <pid>)
+ */
+static void Main_GrabSignal(int sig) {
+	bGrabRequest = 1;
+}
+#endif
+
 /*-----------------------------------------------------------------------*/
 /**
  * Set signal handlers to catch signals
@@ -955,6 +1054,7 @@ static void Main_StatusbarSetup(void) {
 static void Main_SetSignalHandlers(void) {
 #ifndef _WIN32
 	signal(SIGPIPE, SIG_IGN);
+	signal(SIGUSR1, Main_GrabSignal);
 #endif
 	signal(SIGFPE, SIG_IGN);
 }
@@ -965,9 +1065,18 @@ static void Main_SetSignalHandlers(void) {
  * Main
  * 
  * Note: 'argv' cannot be declared const, MinGW would then fail to link.
+ *
+ * One process emulates one machine. The CPU core (regs, cpufunctbl), the
+ * memory banks, the CycInt scheduler and all devices keep their state in
+ * globals, so several machines are run as several processes. The tables
+ * that are the same for all of them are built at compile or load time
+ * and the ROM is patched per machine, so there is little to share.
  */
 int main(int argc, char *argv[])
 {
+	const char *bootbench = NULL;
+	int i;
+
 	/* Generate random seed */
 	srand(time(NULL));
 
@@ -983,9 +1092,35 @@ int main(int argc, char *argv[])
 	/* Now load the values from the configuration file */
 	Main_LoadInitialConfig();
 
+	/* Command line options override the configuration file */
+	for (i = 1; i < argc; i++) {
+		if (i + 1 < argc && !strcmp(argv[i], "--set")) {
+			if (!Configuration_SetOption(argv[++i])) {
+				fprintf(stderr, "Invalid option: %s\n", argv[i]);
+				return 1;
+			}
+		} else if (i + 1 < argc && !strcmp(argv[i], "--bootbench")) {
+			bootbench = argv[++i];
+		} else if (i + 1 < argc && (!strcmp(argv[i], "--record") || !strcmp(argv[i], "--replay"))) {
+			if (!Replay_Init(argv[i + 1], !strcmp(argv[i], "--record"))) {
+				return 1;
+			}
+			i++;
+		} else {
+			fprintf(stderr, "Usage: %s [--set <Section>.<key>=<value>]... [--bootbench <script>]"
+			        " [--record <log> | --replay <log>]\n", argv[0]);
+			return 1;
+		}
+	}
+
 	/* monitor type option might require "reset" -> true */
 	Configuration_Apply(true);
 
+	/* Boot benchmark script */
+	if (bootbench && !Bootbench_Load(bootbench)) {
+		return 1;
+	}
+
 #ifdef WIN32
 	Win_OpenCon();
 #endif
@@ -1020,5 +1155,5 @@ int main(int argc, char *argv[])
 	/* Un-init emulation system */
 	Main_UnInit();
 
-	return 0;
+	return Bootbench_ExitCode();
 }
@@ -0,0 +1,372 @@
+/*
+  Previous - metrics.c
+
+  This file is distributed under the GNU General Public License, version 2
+  or at your option any later version. Read the file gpl.txt for details.
+
+  Built-in HTTP endpoint that serves counters of the emulation in the
+  Prometheus text format on /metrics. The counters are running totals
+  that the subsystems update without locking. They are collected on the
+  emulator thread once per statusbar interval, so boards that come and go
+  with a reset are never touched from another thread, and the text is
+  handed to the server thread under a lock. The server thread answers one
+  request at a time.
+
+  There is no authentication. By default the server only listens on the
+  loopback interface.
+*/
+const char Metrics_fileid[] = "Previous metrics.c";
+
+#include "main.h"
+#include "configuration.h"
+#include "log.h"
+#include "host.h"
+#include "cycInt.h"
+#include "diskcache.h"
+#include "enet_slirp.h"
+#include "screen.h"
+#include "dimension.hpp"
+#include "dsp.h"
+#include "metrics.h"
+
+#if !defined(_WIN32)
+#include <stdarg.h>
+#include <inttypes.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+#define METRICS_SIZE    16384
+#define METRICS_IDLE_US 100000
+#define METRICS_RECV_US 1000000 /* Time a client has to send its request */
+
+static char        metrics_text[METRICS_SIZE];  /* Published by the emulator thread */
+static int         metrics_len;
+static lock_t      metrics_lock;
+static int         metrics_listen_fd = -1;
+static thread_t*   metrics_thread;
+static atomic_int  metrics_running;
+
+
+/* ------------------------------------------------------------------------
+ * Collection, runs on the emulator thread
+ */
+
+typedef struct {
+	char* p;
+	char* end;
+} METRICS_BUF;
+
+static void metrics_printf(METRICS_BUF* b, const char* fmt, ...) {
+	va_list ap;
+	int n;
+
+	va_start(ap, fmt);
+	n = vsnprintf(b->p, b->end - b->p, fmt, ap);
+	va_end(ap);
+	if (n > 0) {
+		b->p += (n < b->end - b->p) ? n : b->end - b->p - 1;
+	}
+}
+
+static void metrics_head(METRICS_BUF* b, const char* name, const char* type, const char* help) {
+	metrics_printf(b, "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+}
+
+static void metrics_cpu(METRICS_BUF* b) {
+	DSP_STATS dsp;
+	ND_STATS  nd;
+	int i;
+
+	metrics_head(b, "previous_speed_ratio", "gauge", "Emulated time per real time.");
+	metrics_printf(b, "previous_speed_ratio %.3f\n", Main_SpeedFactor());
+
+	metrics_head(b, "previous_m68k_cycles_total", "counter", "Emulated 68k cycles since reset.");
+	metrics_printf(b, "previous_m68k_cycles_total %" PRId64 "\n", nCyclesMainCounter);
+
+	metrics_head(b, "previous_m68k_clock_mhz", "gauge", "Emulated 68k clock.");
+	metrics_printf(b, "previous_m68k_clock_mhz %d\n", ConfigureParams.System.nCpuFreq);
+
+	if (DSP_Stats(&dsp)) {
+		metrics_head(b, "previous_dsp_instructions_total", "counter", "Instructions executed by the DSP.");
+		metrics_printf(b, "previous_dsp_instructions_total %" PRIu64 "\n", dsp.insns);
+		metrics_head(b, "previous_dsp_cycles_total", "counter", "DSP cycles, including stalls.");
+		metrics_printf(b, "previous_dsp_cycles_total %" PRIu64 "\n", dsp.cycles);
+	}
+
+	metrics_head(b, "previous_i860_instructions_total", "counter", "Instructions executed by the NeXTdimension i860.");
+	for (i = 0; i < ND_MAX_BOARDS; i++) {
+		if (nd_stats(ND_SLOT(i), &nd)) {
+			metrics_printf(b, "previous_i860_instructions_total{slot=\"%d\"} %" PRIu64 "\n", ND_SLOT(i), nd.insns);
+		}
+	}
+}
+
+static void metrics_events(METRICS_BUF* b) {
+	const char* name;
+	uint64_t n;
+	int i;
+
+	metrics_head(b, "previous_events_total", "counter", "Calls of scheduler event handlers.");
+	for (i = INTERRUPT_NULL + 1; i < MAX_INTERRUPTS; i++) {
+		n = CycInt_HandlerCount(i, &name);
+		if (n) {
+			metrics_printf(b, "previous_events_total{handler=\"%s\"} %" PRIu64 "\n", name, n);
+		}
+	}
+}
+
+static void metrics_disks(METRICS_BUF* b) {
+	DISKCACHE_STATS s[DISKCACHE_DEVS];
+	int dev;
+
+	for (dev = 0; dev < DISKCACHE_DEVS; dev++) {
+		DiskCache_Stats(dev, &s[dev]);
+	}
+	metrics_head(b, "previous_disk_reads_total", "counter", "Read requests to disk images.");
+	for (dev = 0; dev < DISKCACHE_DEVS; dev++) {
+		if (s[dev].reads + s[dev].writes) {
+			metrics_printf(b, "previous_disk_reads_total{dev=\"%s\"} %" PRIu64 "\n", DiskCache_Name(dev), s[dev].reads);
+		}
+	}
+	metrics_head(b, "previous_disk_writes_total", "counter", "Write requests to disk images.");
+	for (dev = 0; dev < DISKCACHE_DEVS; dev++) {
+		if (s[dev].reads + s[dev].writes) {
+			metrics_printf(b, "previous_disk_writes_total{dev=\"%s\"} %" PRIu64 "\n", DiskCache_Name(dev), s[dev].writes);
+		}
+	}
+	metrics_head(b, "previous_disk_read_bytes_total", "counter", "Bytes read from disk images.");
+	for (dev = 0; dev < DISKCACHE_DEVS; dev++) {
+		if (s[dev].reads + s[dev].writes) {
+			metrics_printf(b, "previous_disk_read_bytes_total{dev=\"%s\"} %" PRIu64 "\n", DiskCache_Name(dev), s[dev].bytes_read);
+		}
+	}
+	metrics_head(b, "previous_disk_written_bytes_total", "counter", "Bytes written to disk images.");
+	for (dev = 0; dev < DISKCACHE_DEVS; dev++) {
+		if (s[dev].reads + s[dev].writes) {
+			metrics_printf(b, "previous_disk_written_bytes_total{dev=\"%s\"} %" PRIu64 "\n", DiskCache_Name(dev), s[dev].bytes_written);
+		}
+	}
+	metrics_head(b, "previous_disk_cache_hits_total", "counter", "Blocks found in the host disk cache.");
+	for (dev = 0; dev < DISKCACHE_DEVS; dev++) {
+		if (s[dev].reads + s[dev].writes) {
+			metrics_printf(b, "previous_disk_cache_hits_total{dev=\"%s\"} %" PRIu64 "\n", DiskCache_Name(dev), s[dev].hits);
+		}
+	}
+}
+
+static void metrics_network(METRICS_BUF* b) {
+	uint64_t in, out, drops, calls, timeUs;
+
+	enet_slirp_stats(&in, &out, &drops);
+	metrics_head(b, "previous_net_packets_total", "counter", "Packets through the SLiRP network.");
+	metrics_printf(b, "previous_net_packets_total{dir=\"tx\"} %" PRIu64 "\n", in);
+	metrics_printf(b, "previous_net_packets_total{dir=\"rx\"} %" PRIu64 "\n", out);
+	metrics_head(b, "previous_net_dropped_packets_total", "counter", "Packets to the guest dropped because the queue was full.");
+	metrics_printf(b, "previous_net_dropped_packets_total %" PRIu64 "\n", drops);
+
+	nfsd_stats(&calls, &timeUs);
+	metrics_head(b, "previous_nfs_call_seconds", "summary", "Latency of NFS server calls.");
+	metrics_printf(b, "previous_nfs_call_seconds_count %" PRIu64 "\n", calls);
+	metrics_printf(b, "previous_nfs_call_seconds_sum %.6f\n", timeUs / 1000000.0);
+}
+
+static void metrics_screen(METRICS_BUF* b) {
+	metrics_head(b, "previous_screen_frames_total", "counter", "Frames presented in the main window.");
+	metrics_printf(b, "previous_screen_frames_total %" PRIu64 "\n", Screen_FrameCount());
+}
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Collect the counters for the next request. Called from the emulator
+ * thread once per statusbar interval.
+ */
+void Metrics_Update(void) {
+	static char text[METRICS_SIZE];
+	METRICS_BUF b;
+
+	if (!host_atomic_get(&metrics_running)) {
+		return;
+	}
+	b.p   = text;
+	b.end = text + sizeof(text);
+	text[0] = '\0';
+
+	metrics_cpu(&b);
+	metrics_events(&b);
+	metrics_disks(&b);
+	metrics_network(&b);
+	metrics_screen(&b);
+
+	host_lock(&metrics_lock);
+	metrics_len = (int)(b.p - text);
+	memcpy(metrics_text, text, metrics_len);
+	host_unlock(&metrics_lock);
+}
+
+
+/* ------------------------------------------------------------------------
+ * Server
+ */
+
+static bool metrics_send(int fd, const char* buf, size_t len) {
+	ssize_t n;
+
+	while (len > 0) {
+		n = send(fd, buf, len, MSG_NOSIGNAL);
+		if (n <= 0) {
+			if (n < 0 && errno == EINTR) {
+				continue;
+			}
+			return false;
+		}
+		buf += n;
+		len -= n;
+	}
+	return true;
+}
+
+/* Read until the end of the request header, gives up after METRICS_RECV_US */
+static bool metrics_recv(int fd, char* buf, size_t size) {
+	fd_set rfds;
+	struct timeval tv;
+	size_t len = 0;
+	ssize_t n;
+
+	while (len < size - 1) {
+		FD_ZERO(&rfds);
+		FD_SET(fd, &rfds);
+		tv.tv_sec  = 0;
+		tv.tv_usec = METRICS_RECV_US;
+		if (select(fd + 1, &rfds, NULL, NULL, &tv) <= 0) {
+			return false;
+		}
+		n = recv(fd, buf + len, size - 1 - len, 0);
+		if (n <= 0) {
+			if (n < 0 && errno == EINTR) {
+				continue;
+			}
+			return false;
+		}
+		len += n;
+		buf[len] = '\0';
+		if (strstr(buf, "\r\n\r\n") || strstr(buf, "\n\n")) {
+			return true;
+		}
+	}
+	return true;
+}
+
+static void metrics_request(int fd) {
+	static char body[METRICS_SIZE];
+	char req[1024];
+	char head[256];
+	int len;
+
+	if (!metrics_recv(fd, req, sizeof(req))) {
+		return;
+	}
+	if (strncmp(req, "GET /metrics ", 13) && strncmp(req, "GET / ", 6)) {
+		snprintf(head, sizeof(head), "HTTP/1.0 404 Not Found\r\nContent-Length: 0\r\nConnection: close\r\n\r\n");
+		metrics_send(fd, head, strlen(head));
+		return;
+	}
+
+	host_lock(&metrics_lock);
+	len = metrics_len;
+	memcpy(body, metrics_text, len);
+	host_unlock(&metrics_lock);
+
+	snprintf(head, sizeof(head), "HTTP/1.0 200 OK\r\n"
+	         "Content-Type: text/plain; version=0.0.4; charset=utf-8\r\n"
+	         "Content-Length: %d\r\nConnection: close\r\n\r\n", len);
+	if (metrics_send(fd, head, strlen(head))) {
+		metrics_send(fd, body, len);
+	}
+}
+
+static int metrics_server_thread(void* arg) {
+	fd_set rfds;
+	struct timeval tv;
+	int fd;
+
+	while (host_atomic_get(&metrics_running)) {
+		FD_ZERO(&rfds);
+		FD_SET(metrics_listen_fd, &rfds);
+		tv.tv_sec  = 0;
+		tv.tv_usec = METRICS_IDLE_US;
+		if (select(metrics_listen_fd + 1, &rfds, NULL, NULL, &tv) > 0) {
+			fd = accept(metrics_listen_fd, NULL, NULL);
+			if (fd >= 0) {
+				metrics_request(fd);
+				close(fd);
+			}
+		}
+	}
+	return 0;
+}
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Start the server if it is enabled.
+ */
+void Metrics_Init(void) {
+	struct sockaddr_in addr;
+	int on = 1;
+
+	if (!ConfigureParams.Log.bMetricsServer || host_atomic_get(&metrics_running)) {
+		return;
+	}
+	metrics_listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+	if (metrics_listen_fd < 0) {
+		Log_Printf(LOG_WARN, "[Metrics] Error: Couldn't create socket: %s", strerror(errno));
+		return;
+	}
+	setsockopt(metrics_listen_fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family      = AF_INET;
+	addr.sin_addr.s_addr = htonl(ConfigureParams.Log.bMetricsLocalOnly ? INADDR_LOOPBACK : INADDR_ANY);
+	addr.sin_port        = htons(ConfigureParams.Log.nMetricsPort);
+
+	if (bind(metrics_listen_fd, (struct sockaddr*)&addr, sizeof(addr)) < 0 || listen(metrics_listen_fd, 4) < 0) {
+		Log_Printf(LOG_WARN, "[Metrics] Error: Couldn't listen on port %d: %s",
+		           ConfigureParams.Log.nMetricsPort, strerror(errno));
+		close(metrics_listen_fd);
+		metrics_listen_fd = -1;
+		return;
+	}
+	Log_Printf(LOG_WARN, "[Metrics] Server listening on port %d", ConfigureParams.Log.nMetricsPort);
+
+	metrics_len = 0;
+	host_atomic_set(&metrics_running, 1);
+	metrics_thread = host_thread_create(metrics_server_thread, "MetricsThread", NULL);
+}
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Stop the server.
+ */
+void Metrics_UnInit(void) {
+	if (!host_atomic_get(&metrics_running)) {
+		return;
+	}
+	host_atomic_set(&metrics_running, 0);
+	host_thread_wait(metrics_thread);
+	close(metrics_listen_fd);
+	metrics_listen_fd = -1;
+}
+
+#else /* !_WIN32 */
+
+void Metrics_Init(void) {
+	if (ConfigureParams.Log.bMetricsServer) {
+		Log_Printf(LOG_WARN, "[Metrics] Server is not supported on this platform");
+	}
+}
+void Metrics_UnInit(void) {}
+void Metrics_Update(void) {}
+
+#endif /* !_WIN32 */
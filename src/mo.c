@@ -22,6 +22,7 @@ const char Mo_fileid[] = "Previous mo.c";
 #include "dma.h"
 #include "floppy.h"
 #include "file.h"
+#include "diskcache.h"
 #include "rs.h"
 #include "statusbar.h"
 
@@ -164,6 +165,21 @@ static int dnum;
 #define MO_SECTORSIZE_DISK  1296 /* size of encoded sector, like stored on disk */
 #define MO_SECTORSIZE_DATA  1024 /* size of decoded sector, like handled by software */
 
+/* Track buffer for sequential reads */
+#define MO_TRACK_NONE       0xFFFFFFFF
+#define MO_TRACKSIZE_DISK   (MO_SEC_PER_TRACK*MO_SECTORSIZE_DISK)
+
+static struct {
+    uint8_t  data[MO_TRACKSIZE_DISK];
+    uint32_t first; /* first sector in the buffer, MO_TRACK_NONE if empty */
+    uint32_t next;  /* sector following the last one read */
+} mo_track[MO_MAX_DRIVES];
+
+static void mo_track_drop(int drive) {
+    mo_track[drive].first = MO_TRACK_NONE;
+    mo_track[drive].next  = MO_TRACK_NONE;
+}
+
 
 static uint32_t get_logical_sector(uint32_t sector_id) {
     int32_t tracknum = (sector_id&0xFFFF00)>>8;
@@ -186,6 +202,17 @@ static uint32_t get_logical_sector(uint32_t sector_id) {
 #define SECTOR_IO_DELAY 1250
 #define CMD_DELAY       40
 
+/* Instant I/O timing: spin fast and seek without delay */
+#define SECTOR_IO_DELAY_INSTANT 250
+#define SPINUP_DELAY            500000
+
+static int mo_sector_delay(void) {
+    if (ConfigureParams.System.nIOTiming == IO_TIMING_INSTANT) {
+        return SECTOR_IO_DELAY_INSTANT;
+    }
+    return SECTOR_IO_DELAY;
+}
+
 
 /* Functions */
 static void mo_start(void);
@@ -776,7 +803,7 @@ void osp_formatter_cmd2(void) {
  *
  */
 
-#define ECC_DELAY SECTOR_IO_DELAY/5 /* must be a fraction of sector delay */
+#define ECC_DELAY (mo_sector_delay()/5) /* must be a fraction of sector delay */
 
 bool ecc_repeat=false; /* This is for ECC blocks */
 
@@ -808,7 +835,14 @@ void ecc_decode(void) {
         Log_Printf(LOG_MO_ECC_LEVEL, "[OSP] ECC decoding buffer.");
         ecc_buffer[eccin].limit=ecc_buffer[eccin].size=MO_SECTORSIZE_DATA;
         
-        int num_errors = rs_decode(ecc_buffer[eccin].data);
+        int num_errors = 0;
+        
+        /* Images written by the emulator never have errors */
+        if (ConfigureParams.MO.bTrustImage) {
+            rs_strip(ecc_buffer[eccin].data);
+        } else {
+            num_errors = rs_decode(ecc_buffer[eccin].data);
+        }
         
         if (num_errors<0) {
             Log_Printf(LOG_WARN, "[OSP] ECC: Sector has uncorrectable errors!");
@@ -1004,13 +1038,37 @@ void ECC_IO_Handler(void) {
 
 /* I/O functions */
 
+/* Read a sector from the image. If more sectors follow, either in the same
+ * command or because the last read was the preceding sector, the whole track
+ * is read at once and the following sectors are taken from the buffer. */
+static void mo_read_disk(uint32_t sector_num, uint8_t* buf) {
+    uint32_t first = sector_num - sector_num%MO_SEC_PER_TRACK;
+    
+    if (mo_track[dnum].first != first) {
+        mo_track[dnum].first = MO_TRACK_NONE;
+        if (osp.sector_count>1 || sector_num==mo_track[dnum].next) {
+            if (DiskCache_Read(DISKCACHE_MO(dnum), mo_track[dnum].data, MO_TRACKSIZE_DISK, first*MO_SECTORSIZE_DISK, mo[dnum].dsk)) {
+                Log_Printf(LOG_MO_IO_LEVEL, "MO disk %i: Read track at offset %i", dnum, first);
+                mo_track[dnum].first = first;
+            }
+        }
+    }
+    if (mo_track[dnum].first == first) {
+        memcpy(buf, mo_track[dnum].data + (sector_num-first)*MO_SECTORSIZE_DISK, MO_SECTORSIZE_DISK);
+    } else {
+        /* Random access or partial track at the end of the image */
+        DiskCache_Read(DISKCACHE_MO(dnum), buf, MO_SECTORSIZE_DISK, sector_num*MO_SECTORSIZE_DISK, mo[dnum].dsk);
+    }
+    mo_track[dnum].next = sector_num+1;
+}
+
 void mo_read_sector(uint32_t sector_id) {
     uint32_t sector_num = get_logical_sector(sector_id);
     
     Log_Printf(LOG_MO_IO_LEVEL, "MO disk %i: Read sector at offset %i (%i sectors remaining)",
                dnum, sector_num, osp.sector_count-1);
     
-    File_Read(ecc_buffer[eccin].data, MO_SECTORSIZE_DISK, sector_num*MO_SECTORSIZE_DISK, mo[dnum].dsk);
+    mo_read_disk(sector_num, ecc_buffer[eccin].data);
     
     ecc_buffer[eccin].limit = ecc_buffer[eccin].size = MO_SECTORSIZE_DISK;
 }
@@ -1022,7 +1080,8 @@ void mo_write_sector(uint32_t sector_id) {
                dnum, sector_num, osp.sector_count-1);
     
     if (ecc_buffer[eccout].limit==MO_SECTORSIZE_DISK) {
-        File_Write(ecc_buffer[eccout].data, MO_SECTORSIZE_DISK, sector_num*MO_SECTORSIZE_DISK, mo[dnum].dsk);
+        mo_track_drop(dnum);
+        DiskCache_Write(DISKCACHE_MO(dnum), ecc_buffer[eccout].data, MO_SECTORSIZE_DISK, sector_num*MO_SECTORSIZE_DISK, mo[dnum].dsk);
 
         ecc_buffer[eccout].size = 0;
         ecc_buffer[eccout].limit = MO_SECTORSIZE_DATA;
@@ -1042,7 +1101,8 @@ void mo_erase_sector(uint32_t sector_id) {
     uint8_t erase_buf[MO_SECTORSIZE_DISK];
     memset(erase_buf, 0xFF, MO_SECTORSIZE_DISK);
     
-    File_Write(erase_buf, MO_SECTORSIZE_DISK, sector_num*MO_SECTORSIZE_DISK, mo[dnum].dsk);
+    mo_track_drop(dnum);
+    DiskCache_Write(DISKCACHE_MO(dnum), erase_buf, MO_SECTORSIZE_DISK, sector_num*MO_SECTORSIZE_DISK, mo[dnum].dsk);
 }
 
 void mo_verify_sector(uint32_t sector_id) {
@@ -1051,7 +1111,7 @@ void mo_verify_sector(uint32_t sector_id) {
     Log_Printf(LOG_MO_IO_LEVEL, "MO disk %i: Verify sector at offset %i (%i sectors remaining)",
                dnum, sector_num, osp.sector_count-1);
     
-    File_Read(ecc_buffer[eccin].data, MO_SECTORSIZE_DISK, sector_num*MO_SECTORSIZE_DISK, mo[dnum].dsk);
+    mo_read_disk(sector_num, ecc_buffer[eccin].data);
     
     ecc_buffer[eccin].limit = ecc_buffer[eccin].size = MO_SECTORSIZE_DISK;
 }
@@ -1320,6 +1380,9 @@ void mo_seek(uint16_t command) {
     }
     seek_time+=5000;
 
+    if (ConfigureParams.System.nIOTiming == IO_TIMING_INSTANT) {
+        seek_time=CMD_DELAY;
+    }
     mo_set_signals_delayed(true, false, seek_time);
 #else
     mo_set_signals_delayed(true, false, CMD_DELAY);
@@ -1483,7 +1546,9 @@ void mo_eject_disk(int drive) {
 
     Log_Printf(LOG_WARN, "MO disk %i: Eject",drive);
     
-    mo[drive].dsk=File_Close(mo[drive].dsk);;
+    DiskCache_Drop(DISKCACHE_MO(drive));
+    mo_track_drop(drive);
+    mo[drive].dsk=File_Close(mo[drive].dsk);
     mo[drive].inserted=false;
     mo[drive].spinning=false;
     mo[drive].spiraling=false;
@@ -1495,6 +1560,8 @@ void mo_eject_disk(int drive) {
 void mo_insert_disk(int drive) {
     Log_Printf(LOG_WARN, "MO disk %i: Insert %s",drive,ConfigureParams.MO.drive[drive].szImageName);
     
+    mo_track_drop(drive);
+    
     if (!ConfigureParams.MO.drive[drive].bWriteProtected) {
         mo[drive].dsk = File_Open(ConfigureParams.MO.drive[drive].szImageName, "rb+");
         mo[drive].protected=false;
@@ -1512,6 +1579,12 @@ void mo_insert_disk(int drive) {
         }
     }
     
+    if (File_OpenCompressed(mo[drive].dsk)) {
+        mo[drive].protected=true;
+    } else if (ConfigureParams.System.bMapDiskImages) {
+        File_Map(mo[drive].dsk, !mo[drive].protected);
+    }
+    
     Statusbar_AddMessage("Inserting magneto-optical disk", 0);
     mo[drive].dstat|=DS_INSERT;
     mo[drive].inserted=true;
@@ -1525,7 +1598,7 @@ void mo_start_spiraling(void) {
         return;
     }
     if (!mo[0].spiraling && !mo[1].spiraling) { /* periodic disk operation already active? */
-        CycInt_AddRelativeInterruptUsCycles(SECTOR_IO_DELAY, 400, INTERRUPT_MO_IO);
+        CycInt_AddRelativeInterruptUsCycles(mo_sector_delay(), 400, INTERRUPT_MO_IO);
     }
     mo[dnum].spiraling=true;
 
@@ -1560,7 +1633,7 @@ void mo_spiraling_operation(void) {
             mo[i].sec_offset%=MO_SEC_PER_TRACK;
         }
     }
-    CycInt_AddRelativeInterruptUsCycles(SECTOR_IO_DELAY, 400, INTERRUPT_MO_IO);
+    CycInt_AddRelativeInterruptUsCycles(mo_sector_delay(), 400, INTERRUPT_MO_IO);
 }
 
 void mo_self_diagnostic(void) {
@@ -1601,7 +1674,11 @@ void mo_start(void) {
         Log_Printf(LOG_WARN,"[MO] Starting drive %i", dnum);
         mo[dnum].enabled=true;
         mo[dnum].dstat=DS_RESET;
-        mo_set_signals_delayed(true, false, 500000);
+        if (ConfigureParams.System.nIOTiming == IO_TIMING_INSTANT) {
+            mo_set_signals_delayed(true, false, CMD_DELAY);
+        } else {
+            mo_set_signals_delayed(true, false, SPINUP_DELAY);
+        }
     }
 }
 
@@ -1679,6 +1756,7 @@ void MO_Reset(void) {
     
     for (dnum=0; dnum<MO_MAX_DRIVES; dnum++) {
         mo[dnum].dsk=File_Close(mo[dnum].dsk);
+        mo_track_drop(dnum);
         mo[dnum].connected=false;
         mo[dnum].inserted=false;
         mo_stop();
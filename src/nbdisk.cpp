@@ -0,0 +1,436 @@
+/*
+  Previous - nbdisk.cpp
+
+  This file is distributed under the GNU General Public License, version 2
+  or at your option any later version. Read the file gpl.txt for details.
+
+  Paravirtual disk board for the NeXTbus. It does not exist as real
+  hardware and needs its own driver in the guest. Instead of emulating
+  SCSI phases and FIFOs the driver places requests in a descriptor ring
+  in main memory and rings a doorbell. A host thread reads and writes the
+  disk image, data is moved between main memory and the host buffers on
+  the m68k thread, so the block cache and the MMU see all writes.
+
+  Registers in slot space (long access only):
+    0x00  ID          'NBDK' (read only)
+    0x04  VERSION     1 (read only)
+    0x08  BLOCKSIZE   512 (read only)
+    0x0C  BLOCKS      capacity in blocks (read only)
+    0x10  RINGBASE    physical address of the descriptor ring
+    0x14  RINGSIZE    number of descriptors, a power of two up to 256
+    0x18  CONTROL     bit 0: ring enable, bit 1: completion interrupt enable
+    0x1C  STATUS      bit 0: read only image, bit 1: ring error (write 1 to clear)
+    0x20  DOORBELL    write the producer index
+    0x24  COMPLETED   consumer index (read only)
+    0x28  INTACK      any write clears the completion interrupt
+    0x2C  MAXBLOCKS   largest transfer per descriptor (read only)
+
+  The producer and consumer indices are free running 32-bit counters, the
+  descriptor for index i is at RINGBASE + (i % RINGSIZE) * 16. Clearing the
+  ring enable bit waits for outstanding requests and restarts both indices
+  at 0.
+  The NBIC registers at the top of slot space provide the board ID and
+  the interrupt mask as on other NeXTbus boards.
+
+  Descriptor layout, big endian, 16 bytes:
+    0x00  16-bit operation: 1 read, 2 write, 3 flush
+    0x02  16-bit status: set to 0 by the driver, written by the board
+          1 done, 2 I/O error, 3 invalid request, 4 read only image
+    0x04  first block
+    0x08  number of blocks
+    0x0C  physical address of the buffer, contiguous main memory
+*/
+
+#include "main.h"
+#include "configuration.h"
+#include "m68000.h"
+#include "cycInt.h"
+#include "file.h"
+#include "log.h"
+#include "nbdisk.hpp"
+
+#define NBDISK_MAGIC        0x4E42444B /* 'NBDK' */
+#define NBDISK_VERSION      1
+#define NBDISK_BLOCKSIZE    512
+#define NBDISK_MAXBLOCKS    2048
+#define NBDISK_DESC_SIZE    16
+#define NBDISK_POLL_US      20
+
+/* Registers */
+#define NBDISK_ID           0x00
+#define NBDISK_VER          0x04
+#define NBDISK_BSIZE        0x08
+#define NBDISK_BLOCKS       0x0C
+#define NBDISK_RINGBASE     0x10
+#define NBDISK_RINGSIZE     0x14
+#define NBDISK_CONTROL      0x18
+#define NBDISK_STATUS       0x1C
+#define NBDISK_DOORBELL     0x20
+#define NBDISK_COMPLETED    0x24
+#define NBDISK_INTACK       0x28
+#define NBDISK_MAXXFER      0x2C
+
+#define NBDISK_NBIC_SPACE   0x00FFFFE8
+
+/* Control and status bits */
+#define CTRL_ENABLE         0x01
+#define CTRL_INTR           0x02
+#define STAT_READONLY       0x01
+#define STAT_RINGERR        0x02
+
+/* Operations and request status */
+#define OP_READ             1
+#define OP_WRITE            2
+#define OP_FLUSH            3
+
+#define ST_PENDING          0
+#define ST_DONE             1
+#define ST_IOERR            2
+#define ST_INVALID          3
+#define ST_RDONLY           4
+
+
+static inline uint32_t nbdisk_get32(const uint8_t* p) {
+    return ((uint32_t)p[0]<<24) | ((uint32_t)p[1]<<16) | ((uint32_t)p[2]<<8) | p[3];
+}
+
+
+NextBusDisk::NextBusDisk(int slot, const char* image, bool writeprotected) :
+    NextBusBoard(slot),
+    dsk(NULL),
+    readonly(writeprotected),
+    blocks(0),
+    ring_base(0),
+    ring_size(0),
+    control(0),
+    status(0),
+    completed(0),
+    base(0),
+    thread(NULL),
+    wake(NULL),
+    nbic(slot, NBDISK_NBIC_ID)
+{
+    off_t size = File_Length(image);
+
+    memset(req, 0, sizeof(req));
+    host_atomic_set(&submitted, 0);
+    host_atomic_set(&done, 0);
+    host_atomic_set(&quit, 0);
+
+    if (!File_Exists(image) || size <= 0) {
+        Log_Printf(LOG_WARN, "[NBDisk] Slot %i: Cannot open disk image %s", slot, image);
+        return;
+    }
+    if (!readonly) {
+        dsk = File_Open(image, "rb+");
+    }
+    if (!dsk) {
+        dsk = File_Open(image, "rb");
+        readonly = true;
+    }
+    if (!dsk) {
+        Log_Printf(LOG_WARN, "[NBDisk] Slot %i: Cannot open disk image %s", slot, image);
+        return;
+    }
+    if (ConfigureParams.System.bMapDiskImages) {
+        File_Map(dsk, !readonly);
+    }
+    size /= NBDISK_BLOCKSIZE;
+    blocks = size > 0xFFFFFFFF ? 0xFFFFFFFF : (uint32_t)size;
+
+    Log_Printf(LOG_WARN, "[NBDisk] Slot %i: %s, %u blocks%s", slot, image, blocks, readonly ? ", read only" : "");
+
+    wake   = SDL_CreateSemaphore(0);
+    thread = host_thread_create(worker, "[Previous] NeXTbus disk", this);
+}
+
+NextBusDisk::~NextBusDisk() {
+    if (thread) {
+        host_atomic_set(&quit, 1);
+        SDL_SemPost(wake);
+        host_thread_wait(thread);
+    }
+    if (wake) {
+        SDL_DestroySemaphore(wake);
+    }
+    for (int i = 0; i < NBDISK_RING_MAX; i++) {
+        free(req[i].data);
+    }
+    File_Close(dsk);
+}
+
+
+/* Host thread, serves requests in the order they were submitted */
+int NextBusDisk::worker(void* data) {
+    NextBusDisk* disk = (NextBusDisk*)data;
+    uint32_t     next;
+
+    while (!host_atomic_get(&disk->quit)) {
+        SDL_SemWait(disk->wake);
+
+        while ((next = host_atomic_get(&disk->done)) != (uint32_t)host_atomic_get(&disk->submitted)) {
+            disk->process(&disk->req[next % NBDISK_RING_MAX]);
+            host_atomic_set(&disk->done, next + 1);
+        }
+    }
+    return 0;
+}
+
+void NextBusDisk::process(NBDISK_REQ* r) {
+    uint64_t offset = (uint64_t)r->block * NBDISK_BLOCKSIZE;
+    uint32_t size   = r->count * NBDISK_BLOCKSIZE;
+
+    if (r->status != ST_PENDING) {
+        return;
+    }
+    switch (r->op) {
+        case OP_READ:
+            r->status = File_Read(r->data, size, offset, dsk) ? ST_DONE : ST_IOERR;
+            break;
+        case OP_WRITE:
+            r->status = File_Write(r->data, size, offset, dsk) ? ST_DONE : ST_IOERR;
+            break;
+        case OP_FLUSH:
+            fflush(dsk);
+            File_Sync(dsk);
+            r->status = ST_DONE;
+            break;
+        default:
+            r->status = ST_INVALID;
+            break;
+    }
+}
+
+
+/* Fetch new descriptors and pass them to the worker. Called on the m68k
+ * thread when the doorbell is written. */
+void NextBusDisk::submit(uint32_t producer) {
+    uint32_t    next = host_atomic_get(&submitted);
+    uint8_t     desc[NBDISK_DESC_SIZE];
+    NBDISK_REQ* r;
+
+    if (!(control & CTRL_ENABLE) || !thread) {
+        return;
+    }
+    producer += base;
+    while (next != producer && next - completed < ring_size) {
+        r = &req[next % NBDISK_RING_MAX];
+        r->desc = ring_base + ((next - base) % ring_size) * NBDISK_DESC_SIZE;
+
+        if (!nextbus_master_read(r->desc, desc, NBDISK_DESC_SIZE)) {
+            Log_Printf(LOG_WARN, "[NBDisk] Slot %i: Descriptor at %08X not in memory", slot, r->desc);
+            status |= STAT_RINGERR;
+            break;
+        }
+        r->op     = (desc[0]<<8) | desc[1];
+        r->status = ST_PENDING;
+        r->block  = nbdisk_get32(desc+4);
+        r->count  = nbdisk_get32(desc+8);
+        r->buffer = nbdisk_get32(desc+12);
+
+        Log_Printf(LOG_NBDISK_LEVEL, "[NBDisk] Slot %i: Request %u op %i block %u count %u buffer %08X",
+                   slot, next - base, r->op, r->block, r->count, r->buffer);
+
+        if (r->op == OP_READ || r->op == OP_WRITE) {
+            if (r->count == 0 || r->count > NBDISK_MAXBLOCKS ||
+                r->block >= blocks || r->count > blocks - r->block) {
+                r->status = ST_INVALID;
+            } else if (r->op == OP_WRITE && readonly) {
+                r->status = ST_RDONLY;
+            } else {
+                if (!r->data) {
+                    r->data = (uint8_t*)malloc(NBDISK_MAXBLOCKS * NBDISK_BLOCKSIZE);
+                }
+                if (r->op == OP_WRITE &&
+                    !nextbus_master_read(r->buffer, r->data, r->count * NBDISK_BLOCKSIZE)) {
+                    r->status = ST_INVALID;
+                }
+            }
+        }
+        host_atomic_set(&submitted, ++next);
+    }
+    SDL_SemPost(wake);
+
+    if (!CycInt_InterruptActive(INTERRUPT_NBDISK_IO)) {
+        CycInt_AddRelativeInterruptUs(NBDISK_POLL_US, 0, INTERRUPT_NBDISK_IO);
+    }
+}
+
+/* Report finished requests to the guest. Returns true if requests are
+ * still outstanding. */
+bool NextBusDisk::complete(void) {
+    uint32_t    last = host_atomic_get(&done);
+    uint8_t     st[2];
+    NBDISK_REQ* r;
+
+    if (completed == last) {
+        return completed != (uint32_t)host_atomic_get(&submitted);
+    }
+    while (completed != last) {
+        r = &req[completed % NBDISK_RING_MAX];
+        if (r->op == OP_READ && r->status == ST_DONE &&
+            !nextbus_master_write(r->buffer, r->data, r->count * NBDISK_BLOCKSIZE)) {
+            r->status = ST_INVALID;
+        }
+        st[0] = r->status >> 8;
+        st[1] = r->status;
+        nextbus_master_write(r->desc + 2, st, 2);
+        completed++;
+    }
+    if (control & CTRL_INTR) {
+        nbic.set_intstatus(true);
+    }
+    return completed != (uint32_t)host_atomic_get(&submitted);
+}
+
+/* Wait for the worker to finish all submitted requests */
+void NextBusDisk::drain(void) {
+    while (host_atomic_get(&done) != host_atomic_get(&submitted)) {
+        host_sleep_ms(1);
+    }
+}
+
+
+/* Register access */
+
+uint32_t NextBusDisk::slot_lget(uint32_t addr) {
+    uint32_t val;
+
+    if ((addr & 0x00FFFFFF) >= NBDISK_NBIC_SPACE) {
+        return nbic.lget(addr);
+    }
+    switch (addr & 0x00FFFFFF) {
+        case NBDISK_ID:        val = NBDISK_MAGIC; break;
+        case NBDISK_VER:       val = NBDISK_VERSION; break;
+        case NBDISK_BSIZE:     val = NBDISK_BLOCKSIZE; break;
+        case NBDISK_BLOCKS:    val = blocks; break;
+        case NBDISK_RINGBASE:  val = ring_base; break;
+        case NBDISK_RINGSIZE:  val = ring_size; break;
+        case NBDISK_CONTROL:   val = control; break;
+        case NBDISK_STATUS:    val = status | (readonly ? STAT_READONLY : 0); break;
+        case NBDISK_DOORBELL:  val = host_atomic_get(&submitted) - base; break;
+        case NBDISK_COMPLETED: val = completed - base; break;
+        case NBDISK_MAXXFER:   val = NBDISK_MAXBLOCKS; break;
+        default:
+            return NextBusBoard::slot_lget(addr);
+    }
+    Log_Printf(LOG_NBDISK_LEVEL, "[NBDisk] Slot %i: Register read at %08X, val %08X", slot, addr, val);
+    return val;
+}
+
+uint16_t NextBusDisk::slot_wget(uint32_t addr) {
+    if ((addr & 0x00FFFFFF) >= NBDISK_NBIC_SPACE) {
+        return nbic.wget(addr);
+    }
+    return NextBusBoard::slot_wget(addr);
+}
+
+uint8_t NextBusDisk::slot_bget(uint32_t addr) {
+    if ((addr & 0x00FFFFFF) >= NBDISK_NBIC_SPACE) {
+        return nbic.bget(addr);
+    }
+    return NextBusBoard::slot_bget(addr);
+}
+
+void NextBusDisk::slot_lput(uint32_t addr, uint32_t val) {
+    if ((addr & 0x00FFFFFF) >= NBDISK_NBIC_SPACE) {
+        nbic.lput(addr, val);
+        nd_nbic_interrupt();
+        return;
+    }
+    Log_Printf(LOG_NBDISK_LEVEL, "[NBDisk] Slot %i: Register write at %08X, val %08X", slot, addr, val);
+
+    switch (addr & 0x00FFFFFF) {
+        case NBDISK_RINGBASE:
+            ring_base = val;
+            break;
+        case NBDISK_RINGSIZE:
+            if (val == 0 || val > NBDISK_RING_MAX || (val & (val - 1))) {
+                status |= STAT_RINGERR;
+            } else {
+                ring_size = val;
+            }
+            break;
+        case NBDISK_CONTROL:
+            if ((control & CTRL_ENABLE) && !(val & CTRL_ENABLE)) {
+                drain();
+                complete();
+                base = completed;
+            }
+            if ((val & CTRL_ENABLE) && !ring_size) {
+                status |= STAT_RINGERR;
+                val &= ~CTRL_ENABLE;
+            }
+            control = val & (CTRL_ENABLE | CTRL_INTR);
+            break;
+        case NBDISK_STATUS:
+            status &= ~(val & STAT_RINGERR);
+            break;
+        case NBDISK_DOORBELL:
+            submit(val);
+            break;
+        case NBDISK_INTACK:
+            nbic.set_intstatus(false);
+            nd_nbic_interrupt();
+            break;
+        case NBDISK_ID:
+        case NBDISK_VER:
+        case NBDISK_BSIZE:
+        case NBDISK_BLOCKS:
+        case NBDISK_COMPLETED:
+        case NBDISK_MAXXFER:
+            break;
+        default:
+            NextBusBoard::slot_lput(addr, val);
+            break;
+    }
+}
+
+void NextBusDisk::slot_wput(uint32_t addr, uint16_t val) {
+    if ((addr & 0x00FFFFFF) >= NBDISK_NBIC_SPACE) {
+        nbic.wput(addr, val);
+        nd_nbic_interrupt();
+        return;
+    }
+    NextBusBoard::slot_wput(addr, val);
+}
+
+void NextBusDisk::slot_bput(uint32_t addr, uint8_t val) {
+    if ((addr & 0x00FFFFFF) >= NBDISK_NBIC_SPACE) {
+        nbic.bput(addr, val);
+        nd_nbic_interrupt();
+        return;
+    }
+    NextBusBoard::slot_bput(addr, val);
+}
+
+void NextBusDisk::reset(void) {
+    drain();
+    completed = host_atomic_get(&done);
+    base      = completed;
+    ring_base = 0;
+    ring_size = 0;
+    control   = 0;
+    status    = 0;
+    nbic.init();
+}
+
+
+/* Poll for finished requests, runs on the m68k thread while requests
+ * are outstanding */
+extern "C" void NBDisk_IO_Handler(void) {
+    bool busy = false;
+
+    CycInt_AcknowledgeInterrupt();
+
+    FOR_EACH_SLOT(slot) {
+        if (NextBusDisk* disk = dynamic_cast<NextBusDisk*>(nextbus[slot])) {
+            busy |= disk->complete();
+        }
+    }
+    nd_nbic_interrupt();
+
+    if (busy) {
+        CycInt_AddRelativeInterruptUs(NBDISK_POLL_US, 0, INTERRUPT_NBDISK_IO);
+    }
+}
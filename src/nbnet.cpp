@@ -0,0 +1,454 @@
+/*
+  Previous - nbnet.cpp
+
+  This file is distributed under the GNU General Public License, version 2
+  or at your option any later version. Read the file gpl.txt for details.
+
+  Paravirtual network board for the NeXTbus. Like the paravirtual disk it
+  has no real hardware counterpart and needs its own driver in the guest.
+  Frames are exchanged through a receive and a transmit descriptor ring in
+  main memory. While the board is enabled it owns the SLIRP, PCAP or TAP
+  backend and the on-board ethernet controller is disconnected.
+
+  Both rings are served by a poll on the m68k thread. Every poll sends all
+  queued frames, fills as many receive buffers as the backend has frames
+  for and raises at most one interrupt. The poll interval thus limits the
+  interrupt rate and sets the batch size.
+
+  Registers in slot space (long access only):
+    0x00  ID          'NBNT' (read only)
+    0x04  VERSION     1 (read only)
+    0x08  MAC0        bytes 0-3 of the station address
+    0x0C  MAC1        bytes 4-5 of the station address in bits 31-16
+    0x10  RXBASE      physical address of the receive ring
+    0x14  RXSIZE      number of receive descriptors, a power of two up to 256
+    0x18  TXBASE      physical address of the transmit ring
+    0x1C  TXSIZE      number of transmit descriptors, a power of two up to 256
+    0x20  CONTROL     bit 0: enable, bit 1: receive interrupt enable,
+                      bit 2: transmit interrupt enable, bit 3: promiscuous
+    0x24  STATUS      bit 0: link (read only), bit 1: frames received,
+                      bit 2: frames sent, bit 3: ring error (write 1 to clear)
+    0x28  RXPROD      receive producer index, buffers handed to the board
+    0x2C  RXDONE      receive consumer index (read only)
+    0x30  TXPROD      transmit producer index, frames handed to the board
+    0x34  TXDONE      transmit consumer index (read only)
+    0x38  INTDELAY    poll interval in microseconds, 10 to 10000
+    0x3C  RXDROPS     frames dropped for lack of buffer space (read only)
+
+  Indices are free running 32-bit counters, descriptor i of a ring is at
+  BASE + (i % SIZE) * 16. The station address and the rings can only be
+  changed while the board is disabled, enabling it restarts all indices
+  at 0.
+
+  Descriptor layout, big endian, 16 bytes:
+    0x00  16-bit flags, reserved
+    0x02  16-bit status: set to 0 by the driver, written by the board
+          1 done, 2 error (buffer not in memory or frame too long)
+    0x04  physical address of the buffer, contiguous main memory
+    0x08  receive: size of the buffer, transmit: length of the frame
+    0x0C  receive: length of the frame, written by the board
+*/
+
+#include "main.h"
+#include "configuration.h"
+#include "m68000.h"
+#include "cycInt.h"
+#include "log.h"
+#include "nbnet.hpp"
+
+extern "C" {
+#include "ethernet.h"
+}
+
+#define NBNET_MAGIC         0x4E424E54 /* 'NBNT' */
+#define NBNET_VERSION       1
+#define NBNET_RING_MAX      256
+#define NBNET_DESC_SIZE     16
+#define NBNET_FRAME_MIN     14
+#define NBNET_FRAME_MAX     1518
+#define NBNET_DELAY_DEFAULT 100
+#define NBNET_DELAY_MIN     10
+#define NBNET_DELAY_MAX     10000
+
+/* Registers */
+#define NBNET_ID            0x00
+#define NBNET_VER           0x04
+#define NBNET_MAC0          0x08
+#define NBNET_MAC1          0x0C
+#define NBNET_RXBASE        0x10
+#define NBNET_RXSIZE        0x14
+#define NBNET_TXBASE        0x18
+#define NBNET_TXSIZE        0x1C
+#define NBNET_CONTROL       0x20
+#define NBNET_STATUS        0x24
+#define NBNET_RXPROD        0x28
+#define NBNET_RXDONE        0x2C
+#define NBNET_TXPROD        0x30
+#define NBNET_TXDONE        0x34
+#define NBNET_INTDELAY      0x38
+#define NBNET_RXDROPS       0x3C
+
+#define NBNET_NBIC_SPACE    0x00FFFFE8
+
+/* Control and status bits */
+#define CTRL_ENABLE         0x01
+#define CTRL_RXINTR         0x02
+#define CTRL_TXINTR         0x04
+#define CTRL_PROMISC        0x08
+#define STAT_LINK           0x01
+#define STAT_RX             0x02
+#define STAT_TX             0x04
+#define STAT_RINGERR        0x08
+
+/* Descriptor status */
+#define ST_DONE             1
+#define ST_ERROR            2
+
+
+static NextBusNet* active = NULL; /* board that owns the backend */
+
+static inline uint32_t nbnet_get32(const uint8_t* p) {
+    return ((uint32_t)p[0]<<24) | ((uint32_t)p[1]<<16) | ((uint32_t)p[2]<<8) | p[3];
+}
+
+static inline void nbnet_put32(uint8_t* p, uint32_t v) {
+    p[0] = v>>24; p[1] = v>>16; p[2] = v>>8; p[3] = v;
+}
+
+static inline bool nbnet_ring_size_ok(uint32_t size) {
+    return size > 0 && size <= NBNET_RING_MAX && !(size & (size - 1));
+}
+
+
+NextBusNet::NextBusNet(int slot) :
+    NextBusBoard(slot),
+    rx_base(0),
+    rx_size(0),
+    tx_base(0),
+    tx_size(0),
+    control(0),
+    status(0),
+    delay(NBNET_DELAY_DEFAULT),
+    drops(0),
+    rx_prod(0),
+    rx_done(0),
+    tx_prod(0),
+    tx_done(0),
+    received(0),
+    nbic(slot, NBNET_NBIC_ID)
+{
+    /* NeXT prefix, the last byte tells boards in different slots apart */
+    mac[0] = 0x00;
+    mac[1] = 0x00;
+    mac[2] = 0x0F;
+    mac[3] = 0x4E;
+    mac[4] = 0x42;
+    mac[5] = slot;
+}
+
+NextBusNet::~NextBusNet() {
+    if (active == this) {
+        Ethernet_Redirect(NULL, NULL);
+        active = NULL;
+    }
+}
+
+void NextBusNet::set_enable(bool enable) {
+    if (enable) {
+        rx_prod = rx_done = 0;
+        tx_prod = tx_done = 0;
+        active  = this;
+        Ethernet_Redirect(receive, mac);
+        CycInt_AddRelativeInterruptUs(delay, 0, INTERRUPT_NBNET_IO);
+        Log_Printf(LOG_WARN, "[NBNet] Slot %i: Starting (%02x:%02x:%02x:%02x:%02x:%02x)",
+                   slot, mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+    } else if (active == this) {
+        Ethernet_Redirect(NULL, NULL);
+        active = NULL;
+        Log_Printf(LOG_WARN, "[NBNet] Slot %i: Stopping", slot);
+    }
+}
+
+
+/* Frame filter, the backend may pass on frames for other stations */
+bool NextBusNet::accept(const uint8_t* pkt) {
+    return (control & CTRL_PROMISC) || (pkt[0] & 0x01) || !memcmp(pkt, mac, 6);
+}
+
+/* Receive function for the backend, called from Ethernet_Poll */
+void NextBusNet::receive(uint8_t* pkt, int len) {
+    NextBusNet* nb = active;
+    uint8_t     desc[NBNET_DESC_SIZE];
+    uint32_t    addr;
+
+    if (!nb) {
+        return;
+    }
+    nb->received++;
+
+    if (len < NBNET_FRAME_MIN || !nb->accept(pkt)) {
+        return;
+    }
+    if (nb->rx_done == nb->rx_prod) {
+        nb->drops++;
+        return;
+    }
+    addr = nb->rx_base + (nb->rx_done % nb->rx_size) * NBNET_DESC_SIZE;
+    if (!nextbus_master_read(addr, desc, NBNET_DESC_SIZE)) {
+        nb->status |= STAT_RINGERR;
+        nb->drops++;
+        return;
+    }
+    Log_Printf(LOG_NBNET_LEVEL, "[NBNet] Slot %i: Receive %i bytes into descriptor %u", nb->slot, len, nb->rx_done);
+
+    if ((uint32_t)len <= nbnet_get32(desc+8) && nextbus_master_write(nbnet_get32(desc+4), pkt, len)) {
+        desc[3] = ST_DONE;
+        nbnet_put32(desc+12, len);
+    } else {
+        desc[3] = ST_ERROR;
+        nbnet_put32(desc+12, 0);
+    }
+    desc[2] = 0;
+    nextbus_master_write(addr + 2, desc + 2, NBNET_DESC_SIZE - 2);
+
+    nb->rx_done++;
+    nb->status |= STAT_RX;
+}
+
+/* Send all frames that are queued */
+void NextBusNet::transmit(void) {
+    uint8_t  desc[NBNET_DESC_SIZE];
+    uint8_t  frame[NBNET_FRAME_MAX];
+    uint32_t addr, len;
+
+    while (tx_done != tx_prod) {
+        addr = tx_base + (tx_done % tx_size) * NBNET_DESC_SIZE;
+        if (!nextbus_master_read(addr, desc, NBNET_DESC_SIZE)) {
+            status |= STAT_RINGERR;
+            tx_done = tx_prod;
+            break;
+        }
+        len = nbnet_get32(desc+8);
+
+        Log_Printf(LOG_NBNET_LEVEL, "[NBNet] Slot %i: Send %u bytes from descriptor %u", slot, len, tx_done);
+
+        if (len >= NBNET_FRAME_MIN && len <= NBNET_FRAME_MAX &&
+            nextbus_master_read(nbnet_get32(desc+4), frame, len)) {
+            Ethernet_Send(frame, len);
+            desc[3] = ST_DONE;
+        } else {
+            desc[3] = ST_ERROR;
+        }
+        desc[2] = 0;
+        nextbus_master_write(addr + 2, desc + 2, 2);
+
+        tx_done++;
+        status |= STAT_TX;
+    }
+}
+
+/* Move frames in both directions and update the interrupt */
+void NextBusNet::poll(void) {
+    int before;
+
+    if (!(control & CTRL_ENABLE)) {
+        return;
+    }
+    transmit();
+
+    while (rx_done != rx_prod) {
+        before = received;
+        Ethernet_Poll();
+        if (received == before) {
+            break;
+        }
+    }
+    nbic.set_intstatus(status & control & (STAT_RX | STAT_TX));
+
+    CycInt_AddRelativeInterruptUs(delay, 0, INTERRUPT_NBNET_IO);
+}
+
+
+/* Register access */
+
+uint32_t NextBusNet::slot_lget(uint32_t addr) {
+    uint32_t val;
+
+    if ((addr & 0x00FFFFFF) >= NBNET_NBIC_SPACE) {
+        return nbic.lget(addr);
+    }
+    switch (addr & 0x00FFFFFF) {
+        case NBNET_ID:       val = NBNET_MAGIC; break;
+        case NBNET_VER:      val = NBNET_VERSION; break;
+        case NBNET_MAC0:     val = nbnet_get32(mac); break;
+        case NBNET_MAC1:     val = (mac[4]<<24) | (mac[5]<<16); break;
+        case NBNET_RXBASE:   val = rx_base; break;
+        case NBNET_RXSIZE:   val = rx_size; break;
+        case NBNET_TXBASE:   val = tx_base; break;
+        case NBNET_TXSIZE:   val = tx_size; break;
+        case NBNET_CONTROL:  val = control; break;
+        case NBNET_STATUS:
+            val = status | (ConfigureParams.Ethernet.bEthernetConnected ? STAT_LINK : 0);
+            break;
+        case NBNET_RXPROD:   val = rx_prod; break;
+        case NBNET_RXDONE:   val = rx_done; break;
+        case NBNET_TXPROD:   val = tx_prod; break;
+        case NBNET_TXDONE:   val = tx_done; break;
+        case NBNET_INTDELAY: val = delay; break;
+        case NBNET_RXDROPS:  val = drops; break;
+        default:
+            return NextBusBoard::slot_lget(addr);
+    }
+    Log_Printf(LOG_NBNET_LEVEL, "[NBNet] Slot %i: Register read at %08X, val %08X", slot, addr, val);
+    return val;
+}
+
+uint16_t NextBusNet::slot_wget(uint32_t addr) {
+    if ((addr & 0x00FFFFFF) >= NBNET_NBIC_SPACE) {
+        return nbic.wget(addr);
+    }
+    return NextBusBoard::slot_wget(addr);
+}
+
+uint8_t NextBusNet::slot_bget(uint32_t addr) {
+    if ((addr & 0x00FFFFFF) >= NBNET_NBIC_SPACE) {
+        return nbic.bget(addr);
+    }
+    return NextBusBoard::slot_bget(addr);
+}
+
+void NextBusNet::slot_lput(uint32_t addr, uint32_t val) {
+    bool enabled = control & CTRL_ENABLE;
+
+    if ((addr & 0x00FFFFFF) >= NBNET_NBIC_SPACE) {
+        nbic.lput(addr, val);
+        nd_nbic_interrupt();
+        return;
+    }
+    Log_Printf(LOG_NBNET_LEVEL, "[NBNet] Slot %i: Register write at %08X, val %08X", slot, addr, val);
+
+    switch (addr & 0x00FFFFFF) {
+        case NBNET_MAC0:
+            if (!enabled) {
+                nbnet_put32(mac, val);
+            }
+            break;
+        case NBNET_MAC1:
+            if (!enabled) {
+                mac[4] = val>>24;
+                mac[5] = val>>16;
+            }
+            break;
+        case NBNET_RXBASE:
+            if (!enabled) {
+                rx_base = val;
+            }
+            break;
+        case NBNET_RXSIZE:
+            if (!enabled) {
+                rx_size = val;
+            }
+            break;
+        case NBNET_TXBASE:
+            if (!enabled) {
+                tx_base = val;
+            }
+            break;
+        case NBNET_TXSIZE:
+            if (!enabled) {
+                tx_size = val;
+            }
+            break;
+        case NBNET_CONTROL:
+            if ((val & CTRL_ENABLE) && !(nbnet_ring_size_ok(rx_size) && nbnet_ring_size_ok(tx_size))) {
+                status |= STAT_RINGERR;
+                val &= ~CTRL_ENABLE;
+            }
+            control = val & (CTRL_ENABLE | CTRL_RXINTR | CTRL_TXINTR | CTRL_PROMISC);
+            if (enabled != (bool)(control & CTRL_ENABLE)) {
+                set_enable(control & CTRL_ENABLE);
+            }
+            nbic.set_intstatus(status & control & (STAT_RX | STAT_TX));
+            nd_nbic_interrupt();
+            break;
+        case NBNET_STATUS:
+            status &= ~(val & (STAT_RX | STAT_TX | STAT_RINGERR));
+            nbic.set_intstatus(status & control & (STAT_RX | STAT_TX));
+            nd_nbic_interrupt();
+            break;
+        case NBNET_RXPROD:
+            if (val - rx_done > rx_size) {
+                status |= STAT_RINGERR;
+            } else {
+                rx_prod = val;
+            }
+            break;
+        case NBNET_TXPROD:
+            if (val - tx_done > tx_size) {
+                status |= STAT_RINGERR;
+            } else {
+                tx_prod = val;
+            }
+            break;
+        case NBNET_INTDELAY:
+            if (val < NBNET_DELAY_MIN) {
+                val = NBNET_DELAY_MIN;
+            }
+            if (val > NBNET_DELAY_MAX) {
+                val = NBNET_DELAY_MAX;
+            }
+            delay = val;
+            break;
+        case NBNET_ID:
+        case NBNET_VER:
+        case NBNET_RXDONE:
+        case NBNET_TXDONE:
+        case NBNET_RXDROPS:
+            break;
+        default:
+            NextBusBoard::slot_lput(addr, val);
+            break;
+    }
+}
+
+void NextBusNet::slot_wput(uint32_t addr, uint16_t val) {
+    if ((addr & 0x00FFFFFF) >= NBNET_NBIC_SPACE) {
+        nbic.wput(addr, val);
+        nd_nbic_interrupt();
+        return;
+    }
+    NextBusBoard::slot_wput(addr, val);
+}
+
+void NextBusNet::slot_bput(uint32_t addr, uint8_t val) {
+    if ((addr & 0x00FFFFFF) >= NBNET_NBIC_SPACE) {
+        nbic.bput(addr, val);
+        nd_nbic_interrupt();
+        return;
+    }
+    NextBusBoard::slot_bput(addr, val);
+}
+
+void NextBusNet::reset(void) {
+    set_enable(false);
+    rx_base = rx_size = 0;
+    tx_base = tx_size = 0;
+    control = 0;
+    status  = 0;
+    delay   = NBNET_DELAY_DEFAULT;
+    drops   = 0;
+    nbic.init();
+}
+
+
+/* Poll the rings, runs on the m68k thread while the board is enabled */
+extern "C" void NBNet_IO_Handler(void) {
+    CycInt_AcknowledgeInterrupt();
+
+    FOR_EACH_SLOT(slot) {
+        if (NextBusNet* net = dynamic_cast<NextBusNet*>(nextbus[slot])) {
+            net->poll();
+        }
+    }
+    nd_nbic_interrupt();
+}
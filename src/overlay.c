@@ -0,0 +1,244 @@
+/*
+  Previous - overlay.c
+
+  This file is distributed under the GNU General Public License, version 2
+  or at your option any later version. Read the file gpl.txt for details.
+
+  Copy-on-write overlay for disk images. Blocks written to a protected
+  image are stored in a separate, sparse overlay file and read back from
+  there, the base image is never modified until the overlay is committed.
+  Several instances can share one base image, each with its own overlay.
+
+  Overlay file layout (all numbers big endian):
+  0     "PRVOVL01" magic
+  8     block size in bytes
+  12    number of blocks of the base image
+  512   bitmap, one bit per block, set if the block is in the overlay
+  data  block n at data + n * block size, data is the end of the bitmap
+        rounded up to 4 KB. Blocks that were never written are holes.
+*/
+const char Overlay_fileid[] = "Previous overlay.c";
+
+#include "main.h"
+#include <unistd.h>
+#include "file.h"
+#include "log.h"
+#include "overlay.h"
+
+
+#define OVERLAY_MAGIC       "PRVOVL01"
+#define OVERLAY_BITMAP      512
+#define OVERLAY_ALIGN       4096
+
+struct OVERLAY {
+	FILE    *fp;
+	char    *tmpname;   /* Set if the temporary file must be deleted */
+	uint32_t blocksize;
+	uint32_t blocks;
+	uint64_t data;      /* Offset of block 0 */
+	uint8_t *bitmap;
+	uint32_t count;     /* Blocks in the overlay */
+};
+
+
+static void Overlay_PutLong(uint8_t *p, uint32_t v)
+{
+	p[0] = v >> 24; p[1] = v >> 16; p[2] = v >> 8; p[3] = v;
+}
+
+static uint32_t Overlay_GetLong(uint8_t *p)
+{
+	return (p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+}
+
+static uint32_t Overlay_BitmapSize(OVERLAY *ov)
+{
+	return (ov->blocks + 7) / 8;
+}
+
+static bool Overlay_Present(OVERLAY *ov, uint32_t block)
+{
+	return ov->bitmap[block >> 3] & (1 << (block & 7));
+}
+
+/**
+ * Write an empty header and bitmap.
+ */
+static bool Overlay_Init(OVERLAY *ov)
+{
+	uint8_t header[OVERLAY_BITMAP];
+
+	memset(header, 0, sizeof(header));
+	memcpy(header, OVERLAY_MAGIC, 8);
+	Overlay_PutLong(header + 8, ov->blocksize);
+	Overlay_PutLong(header + 12, ov->blocks);
+	memset(ov->bitmap, 0, Overlay_BitmapSize(ov));
+	ov->count = 0;
+
+	return File_Write(header, sizeof(header), 0, ov->fp) &&
+	       File_Write(ov->bitmap, Overlay_BitmapSize(ov), OVERLAY_BITMAP, ov->fp);
+}
+
+/**
+ * Load header and bitmap of an existing overlay. Returns false if it does
+ * not belong to an image with the given geometry.
+ */
+static bool Overlay_Load(OVERLAY *ov)
+{
+	uint8_t header[16];
+	uint32_t i;
+
+	if (!File_Read(header, sizeof(header), 0, ov->fp) ||
+	    memcmp(header, OVERLAY_MAGIC, 8) ||
+	    Overlay_GetLong(header + 8) != ov->blocksize ||
+	    Overlay_GetLong(header + 12) != ov->blocks ||
+	    !File_Read(ov->bitmap, Overlay_BitmapSize(ov), OVERLAY_BITMAP, ov->fp)) {
+		return false;
+	}
+	for (ov->count = 0, i = 0; i < ov->blocks; i++) {
+		if (Overlay_Present(ov, i)) {
+			ov->count++;
+		}
+	}
+	return true;
+}
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Open the overlay at path for an image of blocks blocks. An existing
+ * overlay is kept, a new one is created if there is none. With an empty
+ * path a temporary overlay is used, which is lost when it is closed.
+ */
+OVERLAY *Overlay_Open(const char *path, uint32_t blocksize, uint32_t blocks)
+{
+	OVERLAY *ov = calloc(1, sizeof(OVERLAY));
+	bool exists = path[0] && File_Exists(path);
+
+	if (!ov) {
+		return NULL;
+	}
+	ov->blocksize = blocksize;
+	ov->blocks    = blocks;
+	ov->data      = (OVERLAY_BITMAP + Overlay_BitmapSize(ov) + OVERLAY_ALIGN - 1) & ~(uint64_t)(OVERLAY_ALIGN - 1);
+	ov->bitmap    = malloc(Overlay_BitmapSize(ov));
+
+	if (!path[0]) {
+		ov->fp = File_OpenTempFile(&ov->tmpname);
+	} else {
+		ov->fp = File_Open(path, exists ? "rb+" : "wb+");
+	}
+	if (!ov->bitmap || !ov->fp) {
+		Log_Printf(LOG_WARN, "Overlay: Cannot open %s", path[0] ? path : "temporary file");
+		return Overlay_Close(ov);
+	}
+
+	if (exists) {
+		if (!Overlay_Load(ov)) {
+			Log_Printf(LOG_WARN, "Overlay: %s does not match the disk image", path);
+			return Overlay_Close(ov);
+		}
+		Log_Printf(LOG_WARN, "Overlay: Using %s (%u changed blocks)", path, ov->count);
+	} else if (!Overlay_Init(ov)) {
+		return Overlay_Close(ov);
+	}
+	return ov;
+}
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Close an overlay. Returns NULL.
+ */
+OVERLAY *Overlay_Close(OVERLAY *ov)
+{
+	if (ov) {
+		File_Close(ov->fp);
+		if (ov->tmpname) {
+			remove(ov->tmpname);
+		}
+		free(ov->bitmap);
+		free(ov);
+	}
+	return NULL;
+}
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Read a block from the overlay. Returns false if the block has not been
+ * written, it must then be read from the base image.
+ */
+bool Overlay_Read(OVERLAY *ov, uint32_t block, uint8_t *data)
+{
+	if (block >= ov->blocks || !Overlay_Present(ov, block)) {
+		return false;
+	}
+	return File_Read(data, ov->blocksize, ov->data + (uint64_t)block * ov->blocksize, ov->fp);
+}
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Write a block to the overlay. The data goes out before the bitmap, so an
+ * interrupted write never exposes a block that has not been stored.
+ */
+bool Overlay_Write(OVERLAY *ov, uint32_t block, uint8_t *data)
+{
+	if (block >= ov->blocks ||
+	    !File_Write(data, ov->blocksize, ov->data + (uint64_t)block * ov->blocksize, ov->fp)) {
+		return false;
+	}
+	if (!Overlay_Present(ov, block)) {
+		ov->bitmap[block >> 3] |= 1 << (block & 7);
+		ov->count++;
+		return File_Write(&ov->bitmap[block >> 3], 1, OVERLAY_BITMAP + (block >> 3), ov->fp);
+	}
+	return true;
+}
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Copy all blocks of the overlay to the base image, then empty it.
+ */
+bool Overlay_Commit(OVERLAY *ov, FILE *base)
+{
+	uint8_t *buf = malloc(ov->blocksize);
+	uint32_t i;
+
+	if (!buf) {
+		return false;
+	}
+	for (i = 0; i < ov->blocks; i++) {
+		if (Overlay_Present(ov, i) &&
+		    (!Overlay_Read(ov, i, buf) ||
+		     !File_Write(buf, ov->blocksize, (uint64_t)i * ov->blocksize, base))) {
+			Log_Printf(LOG_WARN, "Overlay: Commit failed at block %u", i);
+			free(buf);
+			return false;
+		}
+	}
+	free(buf);
+	fflush(base);
+	Overlay_Discard(ov);
+	return true;
+}
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Drop all blocks of the overlay.
+ */
+void Overlay_Discard(OVERLAY *ov)
+{
+	Overlay_Init(ov);
+	fflush(ov->fp);
+	/* Give back the space of the data area */
+	if (ftruncate(fileno(ov->fp), ov->data)) {
+		Log_Printf(LOG_WARN, "Overlay: Cannot truncate overlay file");
+	}
+}
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Return the number of blocks in the overlay.
+ */
+uint32_t Overlay_Count(OVERLAY *ov)
+{
+	return ov ? ov->count : 0;
+}
@@ -0,0 +1,127 @@
+/*
+  Previous - pktring.c
+
+  This file is distributed under the GNU General Public License, version 2
+  or at your option any later version. Read the file gpl.txt for details.
+
+  Ring of received Ethernet frames between a network backend thread and
+  the emulated controller. All buffers are allocated once when the ring is
+  created. There is one producer and one consumer, which only share the
+  head and tail indices, so no lock is needed. Producers that may run on
+  several threads must be serialized by the caller. A producer should
+  check PktRing_Free() and hold back input while the ring is full, frames
+  that arrive anyway are dropped and counted.
+*/
+const char PktRing_fileid[] = "Previous pktring.c";
+
+#include "main.h"
+#include "host.h"
+#include "pktring.h"
+
+
+typedef struct {
+	int     len;
+	uint8_t data[PKTRING_MTU];
+} PKTRING_SLOT;
+
+/* The indices run freely and wrap around, the difference is the fill level */
+#define PKTRING_USED(ring) ((uint32_t)host_atomic_get(&(ring)->head) - (uint32_t)host_atomic_get(&(ring)->tail))
+
+struct PKTRING {
+	atomic_int   head;      /* Next slot to fill, written by the producer */
+	atomic_int   tail;      /* Next slot to read, written by the consumer */
+	uint32_t     dropped;
+	PKTRING_SLOT slot[PKTRING_SLOTS];
+};
+
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Create an empty ring.
+ */
+PKTRING *PktRing_Create(void)
+{
+	PKTRING *ring = calloc(1, sizeof(PKTRING));
+
+	if (ring) {
+		host_atomic_set(&ring->head, 0);
+		host_atomic_set(&ring->tail, 0);
+	}
+	return ring;
+}
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Free a ring. Neither side may use it any more.
+ */
+void PktRing_Destroy(PKTRING *ring)
+{
+	free(ring);
+}
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Producer: Copy a frame to the ring. Returns false and drops the frame
+ * if the ring is full or the frame is too large.
+ */
+bool PktRing_Put(PKTRING *ring, const uint8_t *pkt, int len)
+{
+	uint32_t head = host_atomic_get(&ring->head);
+	PKTRING_SLOT *slot;
+
+	if (len > PKTRING_MTU || PKTRING_USED(ring) >= PKTRING_SLOTS) {
+		ring->dropped++;
+		return false;
+	}
+	slot = &ring->slot[head & (PKTRING_SLOTS - 1)];
+	slot->len = len;
+	memcpy(slot->data, pkt, len);
+	/* Publish the slot after its data */
+	host_atomic_set(&ring->head, (int)(head + 1));
+	return true;
+}
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Consumer: Return the oldest frame or NULL if the ring is empty. The
+ * frame stays valid until it is released.
+ */
+uint8_t *PktRing_Peek(PKTRING *ring, int *len)
+{
+	int tail = host_atomic_get(&ring->tail);
+	PKTRING_SLOT *slot;
+
+	if (tail == host_atomic_get(&ring->head)) {
+		return NULL;
+	}
+	slot = &ring->slot[tail & (PKTRING_SLOTS - 1)];
+	*len = slot->len;
+	return slot->data;
+}
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Consumer: Give the oldest frame back to the producer.
+ */
+void PktRing_Release(PKTRING *ring)
+{
+	host_atomic_add(&ring->tail, 1);
+}
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Producer: Return the number of free slots.
+ */
+int PktRing_Free(PKTRING *ring)
+{
+	return PKTRING_SLOTS - PKTRING_USED(ring);
+}
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Return the number of frames that have been dropped.
+ */
+uint32_t PktRing_Dropped(PKTRING *ring)
+{
+	return ring->dropped;
+}
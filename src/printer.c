@@ -4,7 +4,8 @@
   This file is distributed under the GNU General Public License, version 2
   or at your option any later version. Read the file gpl.txt for details.
 
-  This file contains a simulation of the NeXT Laser Printer.
+  This file contains a simulation of the NeXT Laser Printer. Printed pages
+  are saved as PNG or PDF files.
 */
 const char Printer_fileid[] = "Previous printer.c";
 
@@ -16,129 +17,312 @@ const char Printer_fileid[] = "Previous printer.c";
 #include "dma.h"
 #include "statusbar.h"
 
-#if HAVE_LIBPNG
+#if HAVE_LIBZ
 #include "file.h"
-#include <png.h>
+#include "host.h"
+#include "imgout.h"
 
 /* Helper function for building path and filename of output file */
-static const char *lp_get_filename(void) {
+static const char *lp_get_filename(const char *ext) {
     static const char *lp_outfile = NULL;
     static char lp_filename[32];
     static char lp_extension[16];
     static int lp_pagecount = 0;
     int lp_duplicate_count = 0;
-    
+
     if (File_DirExists(ConfigureParams.Printer.szPrintToFileName)) {
         snprintf(lp_filename, sizeof(lp_filename), "%05d_next_printer", lp_pagecount);
-        
+
         do {
             if (lp_duplicate_count) {
-                snprintf(lp_extension, sizeof(lp_extension), "%i.png",lp_duplicate_count);
+                snprintf(lp_extension, sizeof(lp_extension), "%i%s",lp_duplicate_count,ext);
             } else {
-                snprintf(lp_extension, sizeof(lp_extension), ".png");
+                snprintf(lp_extension, sizeof(lp_extension), "%s",ext);
             }
             lp_outfile = File_MakePath(ConfigureParams.Printer.szPrintToFileName,
                                        lp_filename, lp_extension);
-            
+
             lp_duplicate_count++;
         } while (File_Exists(lp_outfile) && lp_duplicate_count<1000);
     }
-    
+
     if (lp_outfile==NULL) {
         lp_outfile = "\0";
     }
-    
+
     lp_pagecount++;
     lp_pagecount %= 100000;
-    
+
     return lp_outfile;
 }
 
-/* PNG printing functions */
-const int MAX_PAGE_LEN = 400 * 14; // 14 inches is the length of US legal paper, longest paper that fits into the NeXT printer cartridge
-png_structp png_ptr          = NULL;
-png_infop   png_info_ptr     = NULL;
-png_byte**  png_row_pointers = NULL;
-int         png_width;
-int         png_height;
-int         png_count;
-int         png_page_count   = 0;
-const char* png_path;
+/* Page output
+ *
+ * Complete scanlines are passed to a worker thread through a short queue
+ * and compressed as they arrive, so a page never has to be held in memory.
+ * The height of a page is only known at its end. For PNG the height in the
+ * header is patched when the page is done, for PDF the image height and
+ * the stream length are indirect objects written after the image data.
+ * Compression is done by the shared image output in imgout.c.
+ */
+#define LP_ROW_MAX      512     /* 127 * 32 pixels */
+#define LP_QUEUE_LEN    64      /* rows in flight */
+
+enum {
+    LP_JOB_BEGIN,
+    LP_JOB_ROW,
+    LP_JOB_END,
+    LP_JOB_ABORT
+};
 
-static void lp_png_setup(uint32_t data) {
+typedef struct {
+    int      kind;
+    FILE*    fp;                /* LP_JOB_BEGIN */
+    char*    path;              /* LP_JOB_BEGIN */
+    int      format;            /* LP_JOB_BEGIN */
+    int      width;             /* LP_JOB_BEGIN, bits */
+    int      dpi;               /* LP_JOB_BEGIN */
+    uint8_t  data[LP_ROW_MAX];  /* LP_JOB_ROW */
+} LP_JOB;
+
+static LP_JOB    lp_queue[LP_QUEUE_LEN];
+static int       lp_queue_head = 0;     /* m68k thread only */
+static int       lp_queue_tail = 0;     /* worker only */
+static SDL_sem*  lp_queue_space = NULL;
+static SDL_sem*  lp_queue_items = NULL;
+static thread_t* lp_thread = NULL;
+
+/* Producer state */
+static bool      lp_page_open = false;
+static int       lp_row_bytes;
+static int       lp_row_fill;
+static LP_JOB*   lp_row_job;
+
+/* Encoder state, worker only */
+static struct {
+    FILE*    fp;
+    char*    path;
+    int      format;
+    int      width;
+    int      dpi;
+    int      rows;
+    IMGOUT_PNG* png;
+    IMGOUT_Z*   z;          /* PDF image stream */
+    uint32_t length;            /* compressed bytes */
+    long     pdf_obj[8];        /* file offsets of PDF objects */
+} lp_enc;
+
+static void lp_pdf_write(const uint8_t* data, uint32_t len, void* arg) {
+    fwrite(data, 1, len, lp_enc.fp);
+}
+
+static void lp_enc_begin(LP_JOB* job) {
+    lp_enc.fp     = job->fp;
+    lp_enc.path   = job->path;
+    lp_enc.format = job->format;
+    lp_enc.width  = job->width;
+    lp_enc.dpi    = job->dpi;
+    lp_enc.rows   = 0;
+    lp_enc.length = 0;
+    lp_enc.png    = NULL;
+    lp_enc.z      = NULL;
+
+    if (lp_enc.format == PRINT_PNG) {
+        /* height is patched at the end */
+        lp_enc.png = ImgOut_PngBegin(lp_enc.fp, lp_enc.width, 0, 1, IMGOUT_GRAY, lp_enc.dpi, NULL);
+    } else {
+        fprintf(lp_enc.fp, "%%PDF-1.4\n%%\xe2\xe3\xcf\xd3\n");
+        lp_enc.pdf_obj[4] = ftell(lp_enc.fp);
+        fprintf(lp_enc.fp, "4 0 obj\n<< /Type /XObject /Subtype /Image /Width %d /Height 6 0 R "
+                "/ColorSpace /DeviceGray /BitsPerComponent 1 /Filter /FlateDecode /Length 7 0 R >>\nstream\n",
+                lp_enc.width);
+        lp_enc.z = ImgOut_ZBegin(lp_pdf_write, NULL);
+    }
+    if (!lp_enc.png && !lp_enc.z) {
+        Log_Printf(LOG_WARN, "[Printer] Error: Out of memory");
+    }
+}
+
+static void lp_enc_row(const uint8_t* data) {
+    if (lp_enc.png) {
+        ImgOut_PngRow(lp_enc.png, data);
+    } else if (lp_enc.z) {
+        ImgOut_ZWrite(lp_enc.z, data, lp_enc.width/8);
+    } else {
+        return;
+    }
+    lp_enc.rows++;
+}
+
+static void lp_enc_pdf_end(void) {
+    double w = lp_enc.width * 72.0 / lp_enc.dpi;
+    double h = lp_enc.rows  * 72.0 / lp_enc.dpi;
+    char content[128];
+    long xref;
     int i;
-    png_width = ((data >> 16) & 0x7F) * 32;
-    
-    if (png_ptr) {
-        for (i = 0; i < MAX_PAGE_LEN; i++) {
-            png_free(png_ptr, png_row_pointers[i]);
+
+    snprintf(content, sizeof(content), "q %.3f 0 0 %.3f 0 0 cm /Im0 Do Q\n", w, h);
+
+    fprintf(lp_enc.fp, "\nendstream\nendobj\n");
+    lp_enc.pdf_obj[6] = ftell(lp_enc.fp);
+    fprintf(lp_enc.fp, "6 0 obj\n%d\nendobj\n", lp_enc.rows);
+    lp_enc.pdf_obj[7] = ftell(lp_enc.fp);
+    fprintf(lp_enc.fp, "7 0 obj\n%u\nendobj\n", lp_enc.length);
+    lp_enc.pdf_obj[5] = ftell(lp_enc.fp);
+    fprintf(lp_enc.fp, "5 0 obj\n<< /Length %d >>\nstream\n%sendstream\nendobj\n", (int)strlen(content), content);
+    lp_enc.pdf_obj[3] = ftell(lp_enc.fp);
+    fprintf(lp_enc.fp, "3 0 obj\n<< /Type /Page /Parent 2 0 R /MediaBox [0 0 %.3f %.3f] "
+            "/Resources << /XObject << /Im0 4 0 R >> >> /Contents 5 0 R >>\nendobj\n", w, h);
+    lp_enc.pdf_obj[2] = ftell(lp_enc.fp);
+    fprintf(lp_enc.fp, "2 0 obj\n<< /Type /Pages /Kids [3 0 R] /Count 1 >>\nendobj\n");
+    lp_enc.pdf_obj[1] = ftell(lp_enc.fp);
+    fprintf(lp_enc.fp, "1 0 obj\n<< /Type /Catalog /Pages 2 0 R >>\nendobj\n");
+
+    xref = ftell(lp_enc.fp);
+    fprintf(lp_enc.fp, "xref\n0 8\n0000000000 65535 f \n");
+    for (i = 1; i < 8; i++) {
+        fprintf(lp_enc.fp, "%010ld 00000 n \n", lp_enc.pdf_obj[i]);
+    }
+    fprintf(lp_enc.fp, "trailer\n<< /Size 8 /Root 1 0 R >>\nstartxref\n%ld\n%%%%EOF\n", xref);
+}
+
+static void lp_enc_end(bool abort) {
+    if (!abort && lp_enc.rows > 0) {
+        if (lp_enc.png) {
+            ImgOut_PngEnd(lp_enc.png, false);
+        } else {
+            lp_enc.length = ImgOut_ZEnd(lp_enc.z);
+            lp_enc_pdf_end();
+        }
+        File_Close(lp_enc.fp);
+    } else {
+        /* Nothing printed, don't leave an invalid file */
+        if (lp_enc.png) {
+            ImgOut_PngEnd(lp_enc.png, true);
+        } else if (lp_enc.z) {
+            ImgOut_ZEnd(lp_enc.z);
         }
-        png_free(png_ptr, png_row_pointers);
-        png_destroy_write_struct(&png_ptr, &png_info_ptr);
+        File_Close(lp_enc.fp);
+        remove(lp_enc.path);
     }
-    
-    png_ptr = png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
-    if (png_ptr == NULL) {
-        return;
+    free(lp_enc.path);
+}
+
+static int lp_worker(void* arg) {
+    LP_JOB* job;
+
+    for (;;) {
+        SDL_SemWait(lp_queue_items);
+        job = &lp_queue[lp_queue_tail];
+
+        switch (job->kind) {
+            case LP_JOB_BEGIN: lp_enc_begin(job); break;
+            case LP_JOB_ROW:   lp_enc_row(job->data); break;
+            case LP_JOB_END:   lp_enc_end(false); break;
+            case LP_JOB_ABORT: lp_enc_end(true); break;
+            default: break;
+        }
+        lp_queue_tail = (lp_queue_tail + 1) % LP_QUEUE_LEN;
+        SDL_SemPost(lp_queue_space);
     }
-    png_info_ptr = png_create_info_struct(png_ptr);
-    if (png_info_ptr == NULL) {
-        png_destroy_write_struct(&png_ptr, &png_info_ptr);
-        png_ptr = NULL;
+    return 0;
+}
+
+/* Get the next free queue entry, waits if the worker is behind */
+static LP_JOB* lp_job_get(int kind) {
+    LP_JOB* job;
+
+    SDL_SemWait(lp_queue_space);
+    job = &lp_queue[lp_queue_head];
+    job->kind = kind;
+    return job;
+}
+
+static void lp_job_put(void) {
+    lp_queue_head = (lp_queue_head + 1) % LP_QUEUE_LEN;
+    SDL_SemPost(lp_queue_items);
+}
+
+/* Pass the end of the page to the worker. The entry of an incomplete
+ * last row is reused, the row is dropped. */
+static void lp_page_close(int kind) {
+    if (!lp_row_job) {
+        lp_row_job = lp_job_get(kind);
+    }
+    lp_row_job->kind = kind;
+    lp_job_put();
+    lp_row_job   = NULL;
+    lp_page_open = false;
+}
+
+static void lp_page_begin(uint32_t data, int dpi) {
+    int format = ConfigureParams.Printer.nOutputFormat;
+    const char* path;
+    FILE* fp;
+    LP_JOB* job;
+
+    if (lp_page_open) {
+        lp_page_close(LP_JOB_ABORT);
+    }
+
+    lp_row_bytes = ((data >> 16) & 0x7F) * 4;
+    lp_row_fill  = 0;
+    if (lp_row_bytes == 0) {
         return;
     }
-    
-    png_row_pointers = png_malloc(png_ptr, MAX_PAGE_LEN * sizeof (png_byte *));
-    for (i = 0; i < MAX_PAGE_LEN; i++) {
-        png_row_pointers[i] = png_malloc(png_ptr, sizeof (uint8_t) * (png_width / 8));
+
+    if (!lp_thread) {
+        lp_queue_space = SDL_CreateSemaphore(LP_QUEUE_LEN);
+        lp_queue_items = SDL_CreateSemaphore(0);
+        lp_thread = host_thread_create(lp_worker, "PrinterThread", NULL);
+    }
+
+    path = lp_get_filename(format == PRINT_PDF ? ".pdf" : ".png");
+    fp   = File_Open(path, "wb");
+    if (!fp) {
+        Statusbar_AddMessage("Laser printer error: Could not create output file", 10000);
+        return;
     }
-    png_count  = 0;
-    png_height = 0;
+
+    job = lp_job_get(LP_JOB_BEGIN);
+    job->fp     = fp;
+    job->path   = strdup(path);
+    job->format = format;
+    job->width  = lp_row_bytes * 8;
+    job->dpi    = dpi;
+    lp_job_put();
+
+    lp_page_open = true;
+    lp_row_job   = NULL;
 }
 
-static void lp_png_print(void) {
-    if(png_ptr) {
-        int i;
-        
+static void lp_page_print(void) {
+    int i;
+
+    if (lp_page_open) {
         for (i = 0; i < lp_buffer.size; i++) {
-            png_row_pointers[png_count/png_width][(png_count%png_width)/8] = ~lp_buffer.data[i];
-            png_count += 8;
+            if (!lp_row_job) {
+                lp_row_job = lp_job_get(LP_JOB_ROW);
+            }
+            lp_row_job->data[lp_row_fill++] = ~lp_buffer.data[i];
+            if (lp_row_fill == lp_row_bytes) {
+                lp_job_put();
+                lp_row_job  = NULL;
+                lp_row_fill = 0;
+            }
         }
     }
 }
 
-static void lp_png_finish(void) {
-    if(png_ptr) {
-        png_set_IHDR(png_ptr,
-                     png_info_ptr,
-                     png_width,
-                     png_count / png_width,
-                     1,
-                     PNG_COLOR_TYPE_GRAY,
-                     PNG_INTERLACE_NONE,
-                     PNG_COMPRESSION_TYPE_DEFAULT,
-                     PNG_FILTER_TYPE_DEFAULT);
-        
-        png_path = lp_get_filename();
-        
-        FILE* png_fp = File_Open(png_path, "wb");
-        
-        if (png_fp) {
-            png_init_io(png_ptr, png_fp);
-            png_set_rows(png_ptr, png_info_ptr, png_row_pointers);
-            png_write_png(png_ptr, png_info_ptr, PNG_TRANSFORM_IDENTITY, NULL);
-        } else {
-            Statusbar_AddMessage("Laser printer error: Could not create output file", 10000);
-        }
-        
-        File_Close(png_fp);
-        png_page_count++;
+static void lp_page_finish(void) {
+    if (lp_page_open) {
+        lp_page_close(LP_JOB_END);
     }
 }
 #else
-static void lp_png_setup(uint32_t data) {}
-static void lp_png_print(void) {}
-static void lp_png_finish(void) {}
+static void lp_page_begin(uint32_t data, int dpi) {}
+static void lp_page_print(void) {}
+static void lp_page_finish(void) {}
 #endif
 
 
@@ -675,10 +859,10 @@ static void lp_command_in(uint8_t cmd, uint32_t data) {
                 if (cmd&LP_CMD_DATA_EN) {
                     Log_Printf(LOG_LP_LEVEL,"[LP] Enable printer data transfer");
                     /* Setup printing buffer */
-                    lp_png_setup(lp.margins);
+                    lp_page_begin(lp.margins, (cmd&LP_CMD_300DPI) ? 300 : 400);
                     lp_data_transfer = true;
                     if (lp_buffer.size) {
-                        lp_png_print();
+                        lp_page_print();
                         lp_buffer.size = 0;
                     }
                     Statusbar_AddMessage("Laser printer printing page", 0);
@@ -687,7 +871,7 @@ static void lp_command_in(uint8_t cmd, uint32_t data) {
                     Log_Printf(LOG_LP_LEVEL, "[LP] Disable printer data transfer");
                     if (lp_data_transfer) {
                         /* Save buffered printing data to image file */
-                        lp_png_finish();
+                        lp_page_finish();
                     }
                     lp_data_transfer = false;
                 }
@@ -724,7 +908,7 @@ void Printer_IO_Handler(void) {
             return;
         }
         /* Save data to printing buffer */
-        lp_png_print();
+        lp_page_print();
         
         lp_buffer.size = 0;
         
@@ -186,10 +186,24 @@ static uint32_t bt463_read_palette(bt463* ramdac) {
     return result;
 }
 
+/* Colour map entries 0-255 also form the true colour lookup table */
+static void bt463_update_lut(bt463* ramdac, int i, int c, uint8_t val) {
+    uint8_t x = val ^ i;
+    
+    if (ramdac->lut[c][i] != x) {
+        ramdac->lut_nonlinear += (x != 0) - (ramdac->lut[c][i] != 0);
+        ramdac->lut[c][i] = x;
+        ramdac->lut_gen++;
+    }
+}
+
 static void bt463_write_palette(bt463* ramdac, uint32_t val) {
     
     if (ramdac->addr<0x210) {
         ramdac->ram[ramdac->addr*3+ramdac->idx] = val & 0xFF;
+        if (ramdac->addr<0x100) {
+            bt463_update_lut(ramdac, ramdac->addr, ramdac->idx, val & 0xFF);
+        }
     }
     bt463_autoinc(ramdac);
 }
@@ -264,6 +278,10 @@ void bt463_bput(bt463* ramdac, uint32_t addr, uint32_t b) {
 /* BT463 Device for CPU Board */
 static bt463 ramdac68k;
 
+const bt463* RAMDAC_Get(void) {
+    return &ramdac68k;
+}
+
 void RAMDAC_Read(void) {
     Log_Printf(LOG_RAMDAC_LEVEL,"[RAMDAC] Read at $%08x val=$%02x PC=$%08x\n", IoAccessCurrentAddress, IoMem_ReadByte(IoAccessCurrentAddress), m68k_getpc());
     IoMem_WriteByte(IoAccessCurrentAddress, bt463_bget(&ramdac68k, IoAccessCurrentAddress & 3));
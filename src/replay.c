@@ -0,0 +1,330 @@
+/*
+  Previous - replay.c
+
+  This file is distributed under the GNU General Public License, version 2
+  or at your option any later version. Read the file gpl.txt for details.
+
+  Record and replay of the inputs that reach the emulated machine from the
+  host: keyboard and mouse events, received network frames, sound input
+  samples and the time of day at cold reset. Each input is logged with
+  the value of the main cycle counter when the emulator thread consumed
+  it. A replay feeds the logged inputs at the same points and ignores the
+  host, so a recorded run can be profiled again with the identical
+  workload.
+
+  Recording forces cycle time and runs the DSP and i860 on the emulator
+  thread, everything that would make the guest depend on host timing.
+  Disk read ahead and the host side of the network still run on their own
+  threads, but their results only reach the guest through logged inputs or
+  at points that are reached in the same order. A replay that runs past
+  the end of the log continues with host input.
+
+  Log layout: "PRVRPL01", then records of a type byte, the cycle counter
+  and a payload. Numbers are LEB128 varints, signed ones zigzag encoded.
+    input  three signed values (key sym, scancode, modifiers or dx, dy)
+    data   length and bytes (network frame, sound input block)
+    reset  time of day in seconds
+*/
+const char Replay_fileid[] = "Previous replay.c";
+
+#include "main.h"
+#include "configuration.h"
+#include "cycInt.h"
+#include "keymap.h"
+#include "log.h"
+#include "replay.h"
+
+#include <SDL.h>
+#include <inttypes.h>
+
+
+#define REPLAY_MAGIC    "PRVRPL01"
+#define REPLAY_DATA_MAX (64*1024)
+
+typedef struct {
+	int      type;
+	uint64_t cycles;
+	int64_t  arg[3];
+	int      len;
+	uint8_t  data[REPLAY_DATA_MAX];
+} REPLAY_REC;
+
+static FILE*      replayFile;
+static REPLAY_REC replayNext;       /* next record of a replay */
+static bool       replayInjecting;  /* set while replayed input is delivered */
+static bool       replayDiverged;
+
+int nReplayMode = REPLAY_OFF;
+
+
+/* ------------------------------------------------------------------------
+ * Encoding
+ */
+
+static void replay_put(uint64_t v) {
+	while (v >= 0x80) {
+		fputc((v & 0x7f) | 0x80, replayFile);
+		v >>= 7;
+	}
+	fputc((int)v, replayFile);
+}
+
+static void replay_put_signed(int64_t v) {
+	replay_put(((uint64_t)v << 1) ^ (uint64_t)(v >> 63));
+}
+
+static bool replay_get(uint64_t* v) {
+	int c, shift = 0;
+
+	*v = 0;
+	do {
+		if ((c = fgetc(replayFile)) == EOF || shift > 63) {
+			return false;
+		}
+		*v |= (uint64_t)(c & 0x7f) << shift;
+		shift += 7;
+	} while (c & 0x80);
+	return true;
+}
+
+static bool replay_get_signed(int64_t* v) {
+	uint64_t u;
+
+	if (!replay_get(&u)) {
+		return false;
+	}
+	*v = (int64_t)(u >> 1) ^ -(int64_t)(u & 1);
+	return true;
+}
+
+static void replay_begin(int type) {
+	fputc(type, replayFile);
+	replay_put(nCyclesMainCounter);
+}
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Read the next record of a replay. At the end of the log the replay
+ * stops and host input is used again.
+ */
+static void replay_read(void) {
+	REPLAY_REC* rec = &replayNext;
+	uint64_t len;
+	int c, i;
+	bool ok;
+
+	c  = fgetc(replayFile);
+	ok = c != EOF && replay_get(&rec->cycles);
+	rec->type = c;
+	switch (c) {
+		case REPLAY_KEY_DOWN:
+		case REPLAY_KEY_UP:
+		case REPLAY_MOUSE_MOVE:
+		case REPLAY_MOUSE_DOWN:
+		case REPLAY_MOUSE_UP:
+			for (i = 0; i < 3 && ok; i++) {
+				ok = replay_get_signed(&rec->arg[i]);
+			}
+			break;
+		case REPLAY_NET:
+		case REPLAY_SNDIN:
+			ok = ok && replay_get(&len) && len <= REPLAY_DATA_MAX &&
+			     fread(rec->data, 1, len, replayFile) == len;
+			rec->len = (int)len;
+			break;
+		case REPLAY_RESET:
+			ok = ok && replay_get_signed(&rec->arg[0]);
+			break;
+		default:
+			ok = false;
+			break;
+	}
+	if (!ok) {
+		fprintf(stderr, "Replay: end of log at cycle %" PRIu64 ", continuing with host input\n",
+		        (uint64_t)nCyclesMainCounter);
+		Replay_UnInit();
+	}
+}
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Check if the next record of a replay is of type and due. Records that
+ * should have been consumed earlier are still delivered, but the replay
+ * is reported to have diverged from the recording.
+ */
+static bool replay_due(int type) {
+	if (nReplayMode != REPLAY_PLAY || replayNext.type != type ||
+	    replayNext.cycles > (uint64_t)nCyclesMainCounter) {
+		return false;
+	}
+	if (replayNext.cycles < (uint64_t)nCyclesMainCounter && !replayDiverged) {
+		Log_Printf(LOG_WARN, "[Replay] Diverged at cycle %" PRIu64 ", input was logged at %" PRIu64,
+		           (uint64_t)nCyclesMainCounter, replayNext.cycles);
+		replayDiverged = true;
+	}
+	return true;
+}
+
+
+/* ------------------------------------------------------------------------
+ * Interface
+ */
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Open a log for recording or replay. Must be called before the
+ * configuration is applied, it turns off the sources of host timing.
+ */
+bool Replay_Init(const char* path, bool record) {
+	char magic[8];
+
+	replayFile = fopen(path, record ? "wb" : "rb");
+	if (!replayFile) {
+		fprintf(stderr, "Replay: can't open %s\n", path);
+		return false;
+	}
+	if (record) {
+		fwrite(REPLAY_MAGIC, 1, 8, replayFile);
+	} else if (fread(magic, 1, 8, replayFile) != 8 || memcmp(magic, REPLAY_MAGIC, 8)) {
+		fprintf(stderr, "Replay: %s is not a replay log\n", path);
+		fclose(replayFile);
+		replayFile = NULL;
+		return false;
+	}
+	nReplayMode    = record ? REPLAY_RECORD : REPLAY_PLAY;
+	replayDiverged = false;
+
+	ConfigureParams.System.bRealtime       = false;
+	ConfigureParams.System.bDSPThread      = false;
+	ConfigureParams.Dimension.bI860Thread  = false;
+
+	if (nReplayMode == REPLAY_PLAY) {
+		replay_read();
+	}
+	return true;
+}
+
+void Replay_UnInit(void) {
+	if (replayFile) {
+		fclose(replayFile);
+		replayFile = NULL;
+	}
+	nReplayMode = REPLAY_OFF;
+}
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Gate for host input events. Records them and returns true, or returns
+ * false during a replay unless the event comes from the log.
+ */
+bool Replay_Input(int type, int a, int b, int c) {
+	switch (nReplayMode) {
+		case REPLAY_RECORD:
+			replay_begin(type);
+			replay_put_signed(a);
+			replay_put_signed(b);
+			replay_put_signed(c);
+			return true;
+		case REPLAY_PLAY:
+			return replayInjecting;
+		default:
+			return true;
+	}
+}
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Deliver logged input events that are due. Called from the event handler,
+ * which runs at the same cycles in the recording and the replay.
+ */
+void Replay_Poll(void) {
+	REPLAY_REC* rec = &replayNext;
+	SDL_Keysym key;
+
+	while (nReplayMode == REPLAY_PLAY && rec->cycles <= (uint64_t)nCyclesMainCounter) {
+		replayInjecting = true;
+		switch (rec->type) {
+			case REPLAY_KEY_DOWN:
+			case REPLAY_KEY_UP:
+				memset(&key, 0, sizeof(key));
+				key.sym      = (SDL_Keycode)rec->arg[0];
+				key.scancode = (SDL_Scancode)rec->arg[1];
+				key.mod      = (uint16_t)rec->arg[2];
+				if (rec->type == REPLAY_KEY_DOWN) {
+					Keymap_KeyDown(&key);
+				} else {
+					Keymap_KeyUp(&key);
+				}
+				break;
+			case REPLAY_MOUSE_MOVE:
+				Keymap_MouseMove((int)rec->arg[0], (int)rec->arg[1]);
+				break;
+			case REPLAY_MOUSE_DOWN:
+				Keymap_MouseDown(rec->arg[0] != 0);
+				break;
+			case REPLAY_MOUSE_UP:
+				Keymap_MouseUp(rec->arg[0] != 0);
+				break;
+			default:
+				/* Data records are taken by their consumers */
+				replayInjecting = false;
+				return;
+		}
+		replayInjecting = false;
+		replay_read();
+	}
+}
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Exchange a block of data consumed by the emulator thread. When recording
+ * the len bytes in data are logged and len is returned. During a replay
+ * data is replaced by the logged block if one is due at this point and its
+ * length is returned, else -1. Otherwise len is returned.
+ */
+int Replay_Data(int type, void* data, int len, int size) {
+	switch (nReplayMode) {
+		case REPLAY_RECORD:
+			if (len >= 0) {
+				replay_begin(type);
+				replay_put(len);
+				fwrite(data, 1, len, replayFile);
+			}
+			return len;
+		case REPLAY_PLAY:
+			if (!replay_due(type) || replayNext.len > size) {
+				return -1;
+			}
+			len = replayNext.len;
+			memcpy(data, replayNext.data, len);
+			replay_read();
+			return len;
+		default:
+			return len;
+	}
+}
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Time of day at a cold reset, logged and replayed.
+ */
+time_t Replay_UnixTime(time_t now) {
+	switch (nReplayMode) {
+		case REPLAY_RECORD:
+			fputc(REPLAY_RESET, replayFile);
+			replay_put(0);
+			replay_put_signed(now);
+			fflush(replayFile);
+			break;
+		case REPLAY_PLAY:
+			/* The cycle counter is not reset yet, only the order counts */
+			if (replayNext.type == REPLAY_RESET) {
+				now = (time_t)replayNext.arg[0];
+				replay_read();
+			}
+			break;
+		default:
+			break;
+	}
+	return now;
+}
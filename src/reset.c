@@ -13,6 +13,7 @@ const char Reset_fileid[] = "Hatari reset.c";
 #include "host.h"
 #include "cycInt.h"
 #include "m68000.h"
+#include "ioMem.h"
 #include "reset.h"
 #include "scc.h"
 #include "screen.h"
@@ -30,6 +31,7 @@ const char Reset_fileid[] = "Hatari reset.c";
 #include "rtcnvram.h"
 #include "ethernet.h"
 #include "floppy.h"
+#include "diskcache.h"
 #include "snd.h"
 #include "printer.h"
 #include "dsp.h"
@@ -65,13 +67,13 @@ static int Reset_NeXT(bool bCold)
 	DMA_Reset();                  /* Reset DMA controller */
 	ESP_Reset();                  /* Reset SCSI controller */
 	SCSI_Reset();                 /* Reset SCSI disks */
-	MO_Reset();                   /* Reset MO disks */
 	Floppy_Reset();               /* Reset Floppy disks */
+	DiskCache_Reset();            /* Reset disk block cache */
 	SCC_Reset();                  /* Reset SCC */
 	Ethernet_Reset(true);         /* Reset Ethernet */
 	KMS_Reset();                  /* Reset KMS */
 	Sound_Reset();                /* Reset Sound */
-	Printer_Reset();              /* Reset Printer */
+	IoMem_LazyReset();            /* Reset Printer and MO disks if in use */
 	DSP_Reset();                  /* Reset DSP */
 	NextBus_Reset();              /* Reset NextBus */
 
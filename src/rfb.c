@@ -0,0 +1,974 @@
+/*
+  Previous - rfb.c
+
+  This file is distributed under the GNU General Public License, version 2
+  or at your option any later version. Read the file gpl.txt for details.
+
+  Built-in RFB (VNC) server. The guest framebuffer is read with the same
+  conversion as screen grabs, compared tile by tile with the last frame
+  sent to a client, and only changed tiles are sent, ZRLE compressed if
+  the client supports it. Every client has a thread of its own for the
+  protocol and the encoding. Keyboard and mouse input is queued and fed
+  to the keyboard and mouse emulation from the emulator thread.
+
+  There is no authentication. By default the server only listens on the
+  loopback interface, remote access should be tunneled.
+*/
+const char Rfb_fileid[] = "Previous rfb.c";
+
+#include "main.h"
+#include "configuration.h"
+#include "log.h"
+#include "host.h"
+#include "grab.h"
+#include "keymap.h"
+#include "rfb.h"
+
+#if HAVE_LIBZ && !defined(_WIN32)
+#include <zlib.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+#define LOG_RFB_LEVEL   LOG_DEBUG
+
+#define RFB_WIDTH       1120
+#define RFB_HEIGHT      832
+#define RFB_TILE        64      /* ZRLE tile size, also used to find changes */
+#define RFB_MAX_CLIENTS 4
+#define RFB_FRAME_US    33333   /* Shortest time between two updates */
+#define RFB_IDLE_US     100000
+#define RFB_EVENTS      256     /* Must be a power of 2 */
+
+#define RFB_ENC_RAW     0
+#define RFB_ENC_ZRLE    16
+
+/* Client to server messages */
+#define RFB_SET_PIXEL_FORMAT    0
+#define RFB_SET_ENCODINGS       2
+#define RFB_UPDATE_REQUEST      3
+#define RFB_KEY_EVENT           4
+#define RFB_POINTER_EVENT       5
+#define RFB_CLIENT_CUT_TEXT     6
+
+typedef struct {
+	int  bpp;
+	bool bigendian;
+	bool truecolor;
+	int  rmax, gmax, bmax;
+	int  rshift, gshift, bshift;
+} RFB_FORMAT;
+
+typedef struct {
+	uint8_t* data;
+	size_t   len;
+	size_t   size;
+} RFB_BUF;
+
+typedef struct {
+	int        fd;
+	thread_t*  thread;
+	atomic_int done;        /* Set by the client thread when it exits */
+
+	RFB_FORMAT pf;
+	int        pixel_len;   /* Bytes per pixel */
+	int        cpixel_len;  /* Bytes per compressed pixel in ZRLE */
+	int        cpixel_off;  /* First byte of the pixel used for it */
+	bool       zrle;
+	z_stream   z;
+
+	bool       request;     /* An update has been requested */
+	bool       incremental;
+	int        rx, ry, rw, rh;
+
+	uint8_t    frame[RFB_WIDTH * RFB_HEIGHT * 4];   /* RGBA */
+	uint8_t    shadow[RFB_WIDTH * RFB_HEIGHT * 4];  /* What the client has, alpha 0 if unknown */
+	uint32_t   tile[RFB_TILE * RFB_TILE];
+	RFB_BUF    out;
+	RFB_BUF    zin;
+} RFB_CLIENT;
+
+static RFB_CLIENT* rfb_client[RFB_MAX_CLIENTS];
+static int         rfb_listen_fd = -1;
+static thread_t*   rfb_thread;
+static atomic_int  rfb_running;
+
+/* Input events for the emulator thread. Client threads are serialized
+ * with a lock, the emulator thread is the only consumer. */
+enum {
+	RFB_EV_KEY,
+	RFB_EV_POINTER
+};
+
+typedef struct {
+	uint8_t  type;
+	uint8_t  down;          /* key down or button mask */
+	uint16_t x, y;
+	uint32_t key;
+} RFB_EVENT;
+
+static RFB_EVENT  rfb_event[RFB_EVENTS];
+static atomic_int rfb_event_head;
+static atomic_int rfb_event_tail;
+static lock_t     rfb_event_lock;
+
+
+/* ------------------------------------------------------------------------
+ * Buffers and socket I/O
+ */
+
+static uint8_t* rfb_buf_reserve(RFB_BUF* b, size_t n) {
+	if (b->len + n > b->size) {
+		b->size = (b->len + n) * 2;
+		b->data = realloc(b->data, b->size);
+	}
+	return b->data + b->len;
+}
+
+static void rfb_buf_put8(RFB_BUF* b, uint8_t v) {
+	*rfb_buf_reserve(b, 1) = v;
+	b->len++;
+}
+
+static void rfb_buf_put16(RFB_BUF* b, uint16_t v) {
+	uint8_t* p = rfb_buf_reserve(b, 2);
+	p[0] = v >> 8; p[1] = v;
+	b->len += 2;
+}
+
+static void rfb_buf_put32(RFB_BUF* b, uint32_t v) {
+	uint8_t* p = rfb_buf_reserve(b, 4);
+	p[0] = v >> 24; p[1] = v >> 16; p[2] = v >> 8; p[3] = v;
+	b->len += 4;
+}
+
+static bool rfb_send(int fd, const uint8_t* buf, size_t len) {
+	ssize_t n;
+
+	while (len > 0) {
+		n = send(fd, buf, len, MSG_NOSIGNAL);
+		if (n <= 0) {
+			if (n < 0 && errno == EINTR) {
+				continue;
+			}
+			return false;
+		}
+		buf += n;
+		len -= n;
+	}
+	return true;
+}
+
+/* Read exactly len bytes, gives up when the server is stopped */
+static bool rfb_recv(int fd, uint8_t* buf, size_t len) {
+	fd_set rfds;
+	struct timeval tv;
+	ssize_t n;
+
+	while (len > 0) {
+		if (!host_atomic_get(&rfb_running)) {
+			return false;
+		}
+		FD_ZERO(&rfds);
+		FD_SET(fd, &rfds);
+		tv.tv_sec  = 0;
+		tv.tv_usec = RFB_IDLE_US;
+		if (select(fd + 1, &rfds, NULL, NULL, &tv) <= 0) {
+			continue;
+		}
+		n = recv(fd, buf, len, 0);
+		if (n <= 0) {
+			if (n < 0 && errno == EINTR) {
+				continue;
+			}
+			return false;
+		}
+		buf += n;
+		len -= n;
+	}
+	return true;
+}
+
+static uint16_t rfb_get16(const uint8_t* p) {
+	return (p[0] << 8) | p[1];
+}
+
+static uint32_t rfb_get32(const uint8_t* p) {
+	return ((uint32_t)p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+}
+
+
+/* ------------------------------------------------------------------------
+ * Pixel formats
+ */
+
+/* Work out how pixels are sent in the client's format */
+static bool rfb_set_format(RFB_CLIENT* c, const uint8_t* p) {
+	uint32_t mask;
+
+	c->pf.bpp       = p[0];
+	c->pf.bigendian = p[2] != 0;
+	c->pf.truecolor = p[3] != 0;
+	c->pf.rmax      = rfb_get16(p + 4);
+	c->pf.gmax      = rfb_get16(p + 6);
+	c->pf.bmax      = rfb_get16(p + 8);
+	c->pf.rshift    = p[10];
+	c->pf.gshift    = p[11];
+	c->pf.bshift    = p[12];
+
+	if (!c->pf.truecolor || (c->pf.bpp != 8 && c->pf.bpp != 16 && c->pf.bpp != 32)) {
+		Log_Printf(LOG_WARN, "[RFB] Unsupported pixel format: %d bpp, %s", c->pf.bpp,
+		           c->pf.truecolor ? "true color" : "color map");
+		return false;
+	}
+	c->pixel_len  = c->pf.bpp / 8;
+	c->cpixel_len = c->pixel_len;
+	c->cpixel_off = 0;
+
+	/* ZRLE sends 3 bytes of 32 bit pixels that fit into 24 bits */
+	if (c->pf.bpp == 32) {
+		mask = ((uint32_t)c->pf.rmax << c->pf.rshift) | ((uint32_t)c->pf.gmax << c->pf.gshift) |
+		       ((uint32_t)c->pf.bmax << c->pf.bshift);
+		if (!(mask & 0xFF000000)) {
+			c->cpixel_len = 3;
+			c->cpixel_off = c->pf.bigendian ? 1 : 0;
+		} else if (!(mask & 0x000000FF)) {
+			c->cpixel_len = 3;
+			c->cpixel_off = c->pf.bigendian ? 0 : 1;
+		}
+	}
+	return true;
+}
+
+static uint32_t rfb_pixel(RFB_CLIENT* c, const uint8_t* rgba) {
+	return ((uint32_t)((rgba[0] * c->pf.rmax + 127) / 255) << c->pf.rshift) |
+	       ((uint32_t)((rgba[1] * c->pf.gmax + 127) / 255) << c->pf.gshift) |
+	       ((uint32_t)((rgba[2] * c->pf.bmax + 127) / 255) << c->pf.bshift);
+}
+
+/* Append a pixel value, all of it or only the bytes of a CPIXEL */
+static void rfb_put_pixel(RFB_CLIENT* c, RFB_BUF* b, uint32_t v, bool cpixel) {
+	uint8_t tmp[4];
+	int i;
+
+	for (i = 0; i < c->pixel_len; i++) {
+		int shift = 8 * (c->pf.bigendian ? c->pixel_len - 1 - i : i);
+		tmp[i] = v >> shift;
+	}
+	if (cpixel) {
+		memcpy(rfb_buf_reserve(b, c->cpixel_len), tmp + c->cpixel_off, c->cpixel_len);
+		b->len += c->cpixel_len;
+	} else {
+		memcpy(rfb_buf_reserve(b, c->pixel_len), tmp, c->pixel_len);
+		b->len += c->pixel_len;
+	}
+}
+
+
+/* ------------------------------------------------------------------------
+ * Encodings
+ */
+
+static void rfb_encode_raw(RFB_CLIENT* c, int x, int y, int w, int h) {
+	int i, j;
+
+	for (j = y; j < y + h; j++) {
+		const uint8_t* src = &c->frame[(j * RFB_WIDTH + x) * 4];
+		for (i = 0; i < w; i++, src += 4) {
+			rfb_put_pixel(c, &c->out, rfb_pixel(c, src), false);
+		}
+	}
+}
+
+/* One ZRLE tile: solid, packed palette for up to 16 colors or raw */
+static void rfb_encode_tile(RFB_CLIENT* c, int x, int y, int w, int h) {
+	uint32_t palette[16];
+	int n = 0, bits, i, j, k, idx;
+	uint8_t byte;
+
+	for (j = 0; j < h; j++) {
+		const uint8_t* src = &c->frame[((y + j) * RFB_WIDTH + x) * 4];
+		for (i = 0; i < w; i++, src += 4) {
+			c->tile[j * w + i] = rfb_pixel(c, src);
+		}
+	}
+	for (k = 0; k < w * h && n <= 16; k++) {
+		for (i = 0; i < n && palette[i] != c->tile[k]; i++) {}
+		if (i == n) {
+			if (n < 16) {
+				palette[n] = c->tile[k];
+			}
+			n++;
+		}
+	}
+
+	if (n == 1) {
+		rfb_buf_put8(&c->zin, 1);
+		rfb_put_pixel(c, &c->zin, palette[0], true);
+	} else if (n <= 16) {
+		bits = n <= 2 ? 1 : n <= 4 ? 2 : 4;
+		rfb_buf_put8(&c->zin, n);
+		for (i = 0; i < n; i++) {
+			rfb_put_pixel(c, &c->zin, palette[i], true);
+		}
+		for (j = 0; j < h; j++) {
+			byte = 0;
+			for (i = 0, k = 0; i < w; i++) {
+				for (idx = 0; palette[idx] != c->tile[j * w + i]; idx++) {}
+				byte = (byte << bits) | idx;
+				k += bits;
+				if (k == 8) {
+					rfb_buf_put8(&c->zin, byte);
+					byte = 0;
+					k = 0;
+				}
+			}
+			if (k) {
+				rfb_buf_put8(&c->zin, byte << (8 - k));
+			}
+		}
+	} else {
+		rfb_buf_put8(&c->zin, 0);
+		for (k = 0; k < w * h; k++) {
+			rfb_put_pixel(c, &c->zin, c->tile[k], true);
+		}
+	}
+}
+
+static void rfb_encode_zrle(RFB_CLIENT* c, int x, int y, int w, int h) {
+	size_t start;
+	int tx, ty;
+
+	c->zin.len = 0;
+	for (ty = y; ty < y + h; ty += RFB_TILE) {
+		for (tx = x; tx < x + w; tx += RFB_TILE) {
+			rfb_encode_tile(c, tx, ty, x + w - tx < RFB_TILE ? x + w - tx : RFB_TILE,
+			                y + h - ty < RFB_TILE ? y + h - ty : RFB_TILE);
+		}
+	}
+
+	/* Length, then the data of all tiles in the stream of this client */
+	rfb_buf_put32(&c->out, 0);
+	start = c->out.len;
+	c->z.next_in  = c->zin.data;
+	c->z.avail_in = c->zin.len;
+	do {
+		rfb_buf_reserve(&c->out, c->zin.len / 2 + 1024);
+		c->z.next_out  = c->out.data + c->out.len;
+		c->z.avail_out = c->out.size - c->out.len;
+		deflate(&c->z, Z_SYNC_FLUSH);
+		c->out.len = c->out.size - c->z.avail_out;
+	} while (c->z.avail_out == 0);
+
+	c->out.data[start - 4] = (c->out.len - start) >> 24;
+	c->out.data[start - 3] = (c->out.len - start) >> 16;
+	c->out.data[start - 2] = (c->out.len - start) >> 8;
+	c->out.data[start - 1] = (c->out.len - start);
+}
+
+
+/* ------------------------------------------------------------------------
+ * Framebuffer updates
+ */
+
+static bool rfb_tile_changed(RFB_CLIENT* c, int x, int y, int w, int h) {
+	int j;
+
+	for (j = y; j < y + h; j++) {
+		size_t off = (j * RFB_WIDTH + x) * 4;
+		if (memcmp(&c->frame[off], &c->shadow[off], w * 4)) {
+			return true;
+		}
+	}
+	return false;
+}
+
+static void rfb_rect(RFB_CLIENT* c, int x, int y, int w, int h, int* count) {
+	int j;
+
+	rfb_buf_put16(&c->out, x);
+	rfb_buf_put16(&c->out, y);
+	rfb_buf_put16(&c->out, w);
+	rfb_buf_put16(&c->out, h);
+	rfb_buf_put32(&c->out, c->zrle ? RFB_ENC_ZRLE : RFB_ENC_RAW);
+	if (c->zrle) {
+		rfb_encode_zrle(c, x, y, w, h);
+	} else {
+		rfb_encode_raw(c, x, y, w, h);
+	}
+	for (j = y; j < y + h; j++) {
+		size_t off = (j * RFB_WIDTH + x) * 4;
+		memcpy(&c->shadow[off], &c->frame[off], w * 4);
+	}
+	(*count)++;
+}
+
+/* Send all tiles of the requested area that have changed, or all of them
+ * for a full update. Changed tiles next to each other in a row of tiles
+ * are sent as one rectangle. Returns false if the client is gone. */
+static bool rfb_update(RFB_CLIENT* c, bool* sent) {
+	int x0 = c->rx, y0 = c->ry, x1 = c->rx + c->rw, y1 = c->ry + c->rh;
+	int tx, ty, th, run, i, count = 0;
+	bool full = !c->incremental;
+
+	if (!Grab_GetFrame(c->frame)) {
+		for (i = 0; i < RFB_WIDTH * RFB_HEIGHT * 4; i += 4) {
+			c->frame[i + 0] = c->frame[i + 1] = c->frame[i + 2] = 0;
+			c->frame[i + 3] = 0xff;
+		}
+	}
+
+	c->out.len = 0;
+	rfb_buf_put8(&c->out, 0);
+	rfb_buf_put8(&c->out, 0);
+	rfb_buf_put16(&c->out, 0);  /* number of rectangles, set below */
+
+	for (ty = y0 - y0 % RFB_TILE; ty < y1; ty += RFB_TILE) {
+		int y = ty < y0 ? y0 : ty;
+		th = (ty + RFB_TILE < y1 ? ty + RFB_TILE : y1) - y;
+		run = -1;
+		for (tx = x0 - x0 % RFB_TILE; tx < x1; tx += RFB_TILE) {
+			int x = tx < x0 ? x0 : tx;
+			int tw = (tx + RFB_TILE < x1 ? tx + RFB_TILE : x1) - x;
+			if (full || rfb_tile_changed(c, x, y, tw, th)) {
+				if (run < 0) {
+					run = x;
+				}
+			} else if (run >= 0) {
+				rfb_rect(c, run, y, x - run, th, &count);
+				run = -1;
+			}
+		}
+		if (run >= 0) {
+			rfb_rect(c, run, y, x1 - run, th, &count);
+		}
+	}
+
+	*sent = count > 0;
+	if (count == 0) {
+		return true;
+	}
+	c->out.data[2] = count >> 8;
+	c->out.data[3] = count;
+	return rfb_send(c->fd, c->out.data, c->out.len);
+}
+
+
+/* ------------------------------------------------------------------------
+ * Protocol
+ */
+
+static void rfb_put_event(const RFB_EVENT* ev) {
+	int head;
+
+	host_lock(&rfb_event_lock);
+	head = host_atomic_get(&rfb_event_head);
+	if (((head + 1) & (RFB_EVENTS - 1)) != host_atomic_get(&rfb_event_tail)) {
+		rfb_event[head] = *ev;
+		host_atomic_set(&rfb_event_head, (head + 1) & (RFB_EVENTS - 1));
+	} else {
+		Log_Printf(LOG_WARN, "[RFB] Input queue overflow");
+	}
+	host_unlock(&rfb_event_lock);
+}
+
+static bool rfb_handshake(RFB_CLIENT* c) {
+	static const uint8_t pixel_format[16] = {
+		32, 24, 0, 1, 0, 255, 0, 255, 0, 255, 16, 8, 0, 0, 0, 0
+	};
+	static const char name[] = "Previous";
+	uint8_t buf[32];
+	int minor;
+	RFB_BUF init = { NULL, 0, 0 };
+	bool ok;
+
+	if (!rfb_send(c->fd, (const uint8_t*)"RFB 003.008\n", 12) || !rfb_recv(c->fd, buf, 12)) {
+		return false;
+	}
+	buf[11] = 0;
+	minor = atoi((char*)buf + 8);
+
+	if (minor >= 7) {
+		/* One security type: none */
+		buf[0] = 1;
+		buf[1] = 1;
+		if (!rfb_send(c->fd, buf, 2) || !rfb_recv(c->fd, buf, 1) || buf[0] != 1) {
+			return false;
+		}
+		if (minor >= 8) {
+			memset(buf, 0, 4);
+			if (!rfb_send(c->fd, buf, 4)) {
+				return false;
+			}
+		}
+	} else {
+		buf[0] = buf[1] = buf[2] = 0;
+		buf[3] = 1;
+		if (!rfb_send(c->fd, buf, 4)) {
+			return false;
+		}
+	}
+
+	/* ClientInit, the shared flag is ignored: all clients share the screen */
+	if (!rfb_recv(c->fd, buf, 1)) {
+		return false;
+	}
+
+	rfb_buf_put16(&init, RFB_WIDTH);
+	rfb_buf_put16(&init, RFB_HEIGHT);
+	memcpy(rfb_buf_reserve(&init, 16), pixel_format, 16);
+	init.len += 16;
+	rfb_buf_put32(&init, strlen(name));
+	memcpy(rfb_buf_reserve(&init, strlen(name)), name, strlen(name));
+	init.len += strlen(name);
+	ok = rfb_send(c->fd, init.data, init.len);
+	free(init.data);
+
+	return ok && rfb_set_format(c, pixel_format);
+}
+
+static bool rfb_message(RFB_CLIENT* c) {
+	uint8_t buf[20];
+	RFB_EVENT ev;
+	uint32_t n;
+
+	if (!rfb_recv(c->fd, buf, 1)) {
+		return false;
+	}
+	switch (buf[0]) {
+		case RFB_SET_PIXEL_FORMAT:
+			if (!rfb_recv(c->fd, buf, 19) || !rfb_set_format(c, buf + 3)) {
+				return false;
+			}
+			memset(c->shadow, 0, sizeof(c->shadow));
+			break;
+		case RFB_SET_ENCODINGS:
+			if (!rfb_recv(c->fd, buf, 3)) {
+				return false;
+			}
+			c->zrle = false;
+			for (n = rfb_get16(buf + 1); n > 0; n--) {
+				if (!rfb_recv(c->fd, buf, 4)) {
+					return false;
+				}
+				if (rfb_get32(buf) == RFB_ENC_ZRLE) {
+					c->zrle = true;
+				}
+			}
+			Log_Printf(LOG_RFB_LEVEL, "[RFB] Using %s encoding", c->zrle ? "ZRLE" : "raw");
+			break;
+		case RFB_UPDATE_REQUEST:
+			if (!rfb_recv(c->fd, buf, 9)) {
+				return false;
+			}
+			c->request     = true;
+			c->incremental = buf[0] != 0;
+			c->rx = rfb_get16(buf + 1);
+			c->ry = rfb_get16(buf + 3);
+			c->rw = rfb_get16(buf + 5);
+			c->rh = rfb_get16(buf + 7);
+			if (c->rx > RFB_WIDTH)  c->rx = RFB_WIDTH;
+			if (c->ry > RFB_HEIGHT) c->ry = RFB_HEIGHT;
+			if (c->rx + c->rw > RFB_WIDTH)  c->rw = RFB_WIDTH - c->rx;
+			if (c->ry + c->rh > RFB_HEIGHT) c->rh = RFB_HEIGHT - c->ry;
+			break;
+		case RFB_KEY_EVENT:
+			if (!rfb_recv(c->fd, buf, 7)) {
+				return false;
+			}
+			ev.type = RFB_EV_KEY;
+			ev.down = buf[0];
+			ev.key  = rfb_get32(buf + 3);
+			rfb_put_event(&ev);
+			break;
+		case RFB_POINTER_EVENT:
+			if (!rfb_recv(c->fd, buf, 5)) {
+				return false;
+			}
+			ev.type = RFB_EV_POINTER;
+			ev.down = buf[0];
+			ev.x    = rfb_get16(buf + 1);
+			ev.y    = rfb_get16(buf + 3);
+			rfb_put_event(&ev);
+			break;
+		case RFB_CLIENT_CUT_TEXT:
+			if (!rfb_recv(c->fd, buf, 7)) {
+				return false;
+			}
+			for (n = rfb_get32(buf + 3); n > 0; n--) {
+				if (!rfb_recv(c->fd, buf, 1)) {
+					return false;
+				}
+			}
+			break;
+		default:
+			Log_Printf(LOG_WARN, "[RFB] Unknown message type %d", buf[0]);
+			return false;
+	}
+	return true;
+}
+
+static int rfb_client_thread(void* arg) {
+	RFB_CLIENT* c = (RFB_CLIENT*)arg;
+	uint64_t next_frame = 0, now;
+	fd_set rfds;
+	struct timeval tv;
+	int64_t wait;
+	bool sent;
+
+	if (rfb_handshake(c)) {
+		Log_Printf(LOG_WARN, "[RFB] Client connected");
+
+		while (host_atomic_get(&rfb_running)) {
+			now  = host_time_us();
+			wait = RFB_IDLE_US;
+			if (c->request) {
+				wait = next_frame > now ? (int64_t)(next_frame - now) : 0;
+			}
+			FD_ZERO(&rfds);
+			FD_SET(c->fd, &rfds);
+			tv.tv_sec  = 0;
+			tv.tv_usec = wait;
+			if (select(c->fd + 1, &rfds, NULL, NULL, &tv) > 0) {
+				if (!rfb_message(c)) {
+					break;
+				}
+				continue;
+			}
+			if (c->request && host_time_us() >= next_frame) {
+				if (!rfb_update(c, &sent)) {
+					break;
+				}
+				if (sent || !c->incremental) {
+					c->request = false;
+				}
+				next_frame = host_time_us() + RFB_FRAME_US;
+			}
+		}
+		Log_Printf(LOG_WARN, "[RFB] Client disconnected");
+	}
+	close(c->fd);
+	host_atomic_set(&c->done, 1);
+	return 0;
+}
+
+
+/* ------------------------------------------------------------------------
+ * Server
+ */
+
+static void rfb_client_free(int i) {
+	RFB_CLIENT* c = rfb_client[i];
+
+	host_thread_wait(c->thread);
+	deflateEnd(&c->z);
+	free(c->out.data);
+	free(c->zin.data);
+	free(c);
+	rfb_client[i] = NULL;
+}
+
+static void rfb_accept(void) {
+	RFB_CLIENT* c;
+	int on = 1;
+	int fd = accept(rfb_listen_fd, NULL, NULL);
+	int i;
+
+	if (fd < 0) {
+		return;
+	}
+	for (i = 0; i < RFB_MAX_CLIENTS; i++) {
+		if (rfb_client[i] && host_atomic_get(&rfb_client[i]->done)) {
+			rfb_client_free(i);
+		}
+		if (!rfb_client[i]) {
+			break;
+		}
+	}
+	if (i == RFB_MAX_CLIENTS || !(c = calloc(1, sizeof(RFB_CLIENT)))) {
+		Log_Printf(LOG_WARN, "[RFB] Too many clients");
+		close(fd);
+		return;
+	}
+	setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+	c->fd = fd;
+	deflateInit(&c->z, Z_DEFAULT_COMPRESSION);
+	host_atomic_set(&c->done, 0);
+	rfb_client[i] = c;
+	c->thread = host_thread_create(rfb_client_thread, "RFBClientThread", c);
+}
+
+static int rfb_server_thread(void* arg) {
+	fd_set rfds;
+	struct timeval tv;
+
+	while (host_atomic_get(&rfb_running)) {
+		FD_ZERO(&rfds);
+		FD_SET(rfb_listen_fd, &rfds);
+		tv.tv_sec  = 0;
+		tv.tv_usec = RFB_IDLE_US;
+		if (select(rfb_listen_fd + 1, &rfds, NULL, NULL, &tv) > 0) {
+			rfb_accept();
+		}
+	}
+	return 0;
+}
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Start the server if it is enabled.
+ */
+void Rfb_Init(void) {
+	struct sockaddr_in addr;
+	int on = 1;
+
+	if (!ConfigureParams.Screen.bRfbServer || host_atomic_get(&rfb_running)) {
+		return;
+	}
+	rfb_listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+	if (rfb_listen_fd < 0) {
+		Log_Printf(LOG_WARN, "[RFB] Error: Couldn't create socket: %s", strerror(errno));
+		return;
+	}
+	setsockopt(rfb_listen_fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family      = AF_INET;
+	addr.sin_addr.s_addr = htonl(ConfigureParams.Screen.bRfbLocalOnly ? INADDR_LOOPBACK : INADDR_ANY);
+	addr.sin_port        = htons(ConfigureParams.Screen.nRfbPort);
+
+	if (bind(rfb_listen_fd, (struct sockaddr*)&addr, sizeof(addr)) < 0 || listen(rfb_listen_fd, 4) < 0) {
+		Log_Printf(LOG_WARN, "[RFB] Error: Couldn't listen on port %d: %s",
+		           ConfigureParams.Screen.nRfbPort, strerror(errno));
+		close(rfb_listen_fd);
+		rfb_listen_fd = -1;
+		return;
+	}
+	Log_Printf(LOG_WARN, "[RFB] Server listening on port %d", ConfigureParams.Screen.nRfbPort);
+
+	host_atomic_set(&rfb_event_head, 0);
+	host_atomic_set(&rfb_event_tail, 0);
+	host_atomic_set(&rfb_running, 1);
+	rfb_thread = host_thread_create(rfb_server_thread, "RFBServerThread", NULL);
+}
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Stop the server and disconnect all clients.
+ */
+void Rfb_UnInit(void) {
+	int i;
+
+	if (!host_atomic_get(&rfb_running)) {
+		return;
+	}
+	host_atomic_set(&rfb_running, 0);
+	host_thread_wait(rfb_thread);
+	for (i = 0; i < RFB_MAX_CLIENTS; i++) {
+		if (rfb_client[i]) {
+			shutdown(rfb_client[i]->fd, SHUT_RDWR);
+			rfb_client_free(i);
+		}
+	}
+	close(rfb_listen_fd);
+	rfb_listen_fd = -1;
+}
+
+
+/* ------------------------------------------------------------------------
+ * Input, runs on the emulator thread
+ */
+
+/* Map an X11 keysym to the SDL key code of the unshifted key (US layout) */
+static SDL_Keycode rfb_keycode(uint32_t ks) {
+	static const char shifted[]   = "!@#$%^&*()_+{}|:\"<>?~";
+	static const char unshifted[] = "1234567890-=[]\\;',./`";
+	const char* p;
+
+	if (ks >= 'A' && ks <= 'Z') {
+		return ks + ('a' - 'A');
+	}
+	if (ks > ' ' && ks < 0x7F && (p = strchr(shifted, (int)ks))) {
+		return unshifted[p - shifted];
+	}
+	if (ks >= ' ' && ks < 0x7F) {
+		return ks;
+	}
+	if (ks >= 0xFFB1 && ks <= 0xFFB9) {
+		return SDLK_KP_1 + (ks - 0xFFB1);
+	}
+	if (ks >= 0xFFBE && ks <= 0xFFC9) {
+		return SDLK_F1 + (ks - 0xFFBE);
+	}
+	switch (ks) {
+		case 0xFF08: return SDLK_BACKSPACE;
+		case 0xFF09: return SDLK_TAB;
+		case 0xFF0D: return SDLK_RETURN;
+		case 0xFF1B: return SDLK_ESCAPE;
+		case 0xFFFF: return SDLK_DELETE;
+		case 0xFF50: return SDLK_HOME;
+		case 0xFF51: return SDLK_LEFT;
+		case 0xFF52: return SDLK_UP;
+		case 0xFF53: return SDLK_RIGHT;
+		case 0xFF54: return SDLK_DOWN;
+		case 0xFF55: return SDLK_PAGEUP;
+		case 0xFF56: return SDLK_PAGEDOWN;
+		case 0xFF57: return SDLK_END;
+		case 0xFF63: return SDLK_INSERT;
+		case 0xFF7F: return SDLK_NUMLOCKCLEAR;
+		case 0xFF8D: return SDLK_KP_ENTER;
+		case 0xFFAA: return SDLK_KP_MULTIPLY;
+		case 0xFFAB: return SDLK_KP_PLUS;
+		case 0xFFAD: return SDLK_KP_MINUS;
+		case 0xFFAE: return SDLK_KP_PERIOD;
+		case 0xFFAF: return SDLK_KP_DIVIDE;
+		case 0xFFB0: return SDLK_KP_0;
+		case 0xFFBD: return SDLK_KP_EQUALS;
+		case 0xFFE1: return SDLK_LSHIFT;
+		case 0xFFE2: return SDLK_RSHIFT;
+		case 0xFFE3: return SDLK_LCTRL;
+		case 0xFFE4: return SDLK_RCTRL;
+		case 0xFFE5: return SDLK_CAPSLOCK;
+		case 0xFFE7:
+		case 0xFFEB: return SDLK_LGUI;
+		case 0xFFE8:
+		case 0xFFEC: return SDLK_RGUI;
+		case 0xFFE9: return SDLK_LALT;
+		case 0xFFEA: return SDLK_RALT;
+		default:     return SDLK_UNKNOWN;
+	}
+}
+
+/* Scan code of a key on a US keyboard, the host keymap may not be loaded */
+static SDL_Scancode rfb_scancode(SDL_Keycode sym) {
+	static const char keys[] = " -=[]\\;'`,./";
+	static const SDL_Scancode codes[] = {
+		SDL_SCANCODE_SPACE, SDL_SCANCODE_MINUS, SDL_SCANCODE_EQUALS, SDL_SCANCODE_LEFTBRACKET,
+		SDL_SCANCODE_RIGHTBRACKET, SDL_SCANCODE_BACKSLASH, SDL_SCANCODE_SEMICOLON,
+		SDL_SCANCODE_APOSTROPHE, SDL_SCANCODE_GRAVE, SDL_SCANCODE_COMMA, SDL_SCANCODE_PERIOD,
+		SDL_SCANCODE_SLASH
+	};
+	const char* p;
+
+	if (sym & SDLK_SCANCODE_MASK) {
+		return sym & ~SDLK_SCANCODE_MASK;
+	}
+	if (sym >= 'a' && sym <= 'z') {
+		return SDL_SCANCODE_A + (sym - 'a');
+	}
+	if (sym >= '1' && sym <= '9') {
+		return SDL_SCANCODE_1 + (sym - '1');
+	}
+	switch (sym) {
+		case '0':           return SDL_SCANCODE_0;
+		case SDLK_RETURN:   return SDL_SCANCODE_RETURN;
+		case SDLK_TAB:      return SDL_SCANCODE_TAB;
+		case SDLK_BACKSPACE:return SDL_SCANCODE_BACKSPACE;
+		case SDLK_ESCAPE:   return SDL_SCANCODE_ESCAPE;
+		case SDLK_DELETE:   return SDL_SCANCODE_DELETE;
+		default:
+			if (sym > 0 && sym < 0x7F && (p = strchr(keys, (int)sym))) {
+				return codes[p - keys];
+			}
+			return SDL_SCANCODE_UNKNOWN;
+	}
+}
+
+static uint16_t rfb_modifier(SDL_Keycode sym) {
+	switch (sym) {
+		case SDLK_LSHIFT:   return KMOD_LSHIFT;
+		case SDLK_RSHIFT:   return KMOD_RSHIFT;
+		case SDLK_LCTRL:    return KMOD_LCTRL;
+		case SDLK_RCTRL:    return KMOD_RCTRL;
+		case SDLK_LALT:     return KMOD_LALT;
+		case SDLK_RALT:     return KMOD_RALT;
+		case SDLK_LGUI:     return KMOD_LGUI;
+		case SDLK_RGUI:     return KMOD_RGUI;
+		default:            return 0;
+	}
+}
+
+static void rfb_key(const RFB_EVENT* ev) {
+	static uint16_t mod = 0;
+	SDL_Keysym key;
+
+	memset(&key, 0, sizeof(key));
+	key.sym = rfb_keycode(ev->key);
+	if (key.sym == SDLK_UNKNOWN) {
+		return;
+	}
+	key.scancode = rfb_scancode(key.sym);
+	if (ev->down) {
+		mod |= rfb_modifier(key.sym);
+	} else {
+		mod &= ~rfb_modifier(key.sym);
+	}
+	key.mod = mod;
+
+	if (ev->down) {
+		Keymap_KeyDown(&key);
+	} else {
+		Keymap_KeyUp(&key);
+	}
+}
+
+/* The guest mouse is relative, absolute positions are sent as movements */
+static void rfb_pointer(const RFB_EVENT* ev) {
+	static int x = -1, y = -1;
+	static uint8_t buttons = 0;
+	SDL_MouseWheelEvent wheel;
+	uint8_t changed = ev->down ^ buttons;
+
+	if (x >= 0 && (ev->x != x || ev->y != y)) {
+		Keymap_MouseMove(ev->x - x, ev->y - y);
+	}
+	x = ev->x;
+	y = ev->y;
+
+	if (changed & 0x01) {
+		(ev->down & 0x01) ? Keymap_MouseDown(true) : Keymap_MouseUp(true);
+	}
+	if (changed & 0x04) {
+		(ev->down & 0x04) ? Keymap_MouseDown(false) : Keymap_MouseUp(false);
+	}
+	if ((changed & ev->down) & 0x18) {
+		memset(&wheel, 0, sizeof(wheel));
+		wheel.y         = (ev->down & 0x08) ? 1 : -1;
+		wheel.direction = SDL_MOUSEWHEEL_NORMAL;
+		Keymap_MouseWheel(&wheel);
+	}
+	buttons = ev->down;
+}
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Pass queued input to the keyboard and mouse emulation.
+ */
+void Rfb_Poll(void) {
+	int tail = host_atomic_get(&rfb_event_tail);
+
+	while (tail != host_atomic_get(&rfb_event_head)) {
+		if (rfb_event[tail].type == RFB_EV_KEY) {
+			rfb_key(&rfb_event[tail]);
+		} else {
+			rfb_pointer(&rfb_event[tail]);
+		}
+		tail = (tail + 1) & (RFB_EVENTS - 1);
+		host_atomic_set(&rfb_event_tail, tail);
+	}
+}
+
+#else /* HAVE_LIBZ && !_WIN32 */
+
+void Rfb_Init(void) {
+	if (ConfigureParams.Screen.bRfbServer) {
+		Log_Printf(LOG_WARN, "[RFB] Server is not supported on this platform");
+	}
+}
+void Rfb_UnInit(void) {}
+void Rfb_Poll(void) {}
+
+#endif /* HAVE_LIBZ && !_WIN32 */
@@ -5,6 +5,7 @@
   or at your option any later version. Read the file gpl.txt for details.
 
   Load ROM from a file. TMS27C512 or AM27C010 were used as ROM chip.
+  For fast booting the long delays of known ROMs are patched after loading.
 */
 const char Rom_fileid[] = "Previous rom.c";
 
@@ -38,6 +39,64 @@ static void rom_config(uint8_t* buf) {
     }
 }
 
+/* Shorten long ROM delays for fast booting. All known ROMs use a common
+ * delay(us) function whose argument is pushed with MOVE.L #imm,-(A7)
+ * before BSR.L. Calls that wait for 100 ms or more (SCSI bus settling,
+ * drive ready loops, RTC start-up, ...) are patched to wait 1 ms. */
+#define ROM_DELAY_MIN   100000
+#define ROM_DELAY_FAST  1000
+
+typedef struct {
+    const char* name;
+    uint32_t    delay;      /* offset of the delay function */
+    uint8_t     code[12];   /* first bytes of the delay function */
+} ROM_PATCHINFO;
+
+static const ROM_PATCHINFO rom_patchinfo[] = {
+    { "Rev_1.0_v41", 0x2178, { 0x57,0xaf,0x00,0x04,0x6f,0x2a,0x4e,0x7a,0x80,0x02,0x20,0x08 } },
+    { "Rev_2.5_v66", 0x24cc, { 0x57,0xaf,0x00,0x04,0x6f,0x2a,0x4e,0x7a,0x80,0x02,0x20,0x08 } },
+    { "Rev_3.3_v74", 0x8936, { 0x4e,0x56,0x00,0x00,0x48,0xe7,0x30,0x00,0x61,0xff,0xff,0xff } }
+};
+
+static uint32_t rom_get_long(uint8_t* p) {
+    return ((uint32_t)p[0]<<24) | (p[1]<<16) | (p[2]<<8) | p[3];
+}
+
+static void rom_patch(uint8_t* buf, int len) {
+    const ROM_PATCHINFO* info = NULL;
+    uint32_t i, target, delay;
+    int n = 0;
+    
+    for (i = 0; i < sizeof(rom_patchinfo)/sizeof(rom_patchinfo[0]); i++) {
+        if (rom_patchinfo[i].delay + sizeof(rom_patchinfo[i].code) <= (uint32_t)len &&
+            !memcmp(buf + rom_patchinfo[i].delay, rom_patchinfo[i].code, sizeof(rom_patchinfo[i].code))) {
+            info = &rom_patchinfo[i];
+            break;
+        }
+    }
+    if (info == NULL) {
+        Log_Printf(LOG_WARN, "Fast boot: Unknown ROM, not patching");
+        return;
+    }
+    
+    /* MOVE.L #imm,-(A7) = 2f3c iiii iiii, BSR.L = 61ff dddd dddd */
+    for (i = 0; i + 12 <= (uint32_t)len; i += 2) {
+        if (buf[i] != 0x2f || buf[i+1] != 0x3c || buf[i+6] != 0x61 || buf[i+7] != 0xff) {
+            continue;
+        }
+        target = i + 8 + rom_get_long(buf + i + 8);
+        delay  = rom_get_long(buf + i + 2);
+        if (target == info->delay && delay >= ROM_DELAY_MIN) {
+            buf[i+2] = (ROM_DELAY_FAST >> 24) & 0xFF;
+            buf[i+3] = (ROM_DELAY_FAST >> 16) & 0xFF;
+            buf[i+4] = (ROM_DELAY_FAST >> 8) & 0xFF;
+            buf[i+5] = ROM_DELAY_FAST & 0xFF;
+            n++;
+        }
+    }
+    Log_Printf(LOG_WARN, "Fast boot: Shortened %d delays in %s ROM", n, info->name);
+}
+
 /* Load a file to the ROM buffer */
 int rom_load(uint8_t* buf, int len) {
     FILE* romfile;
@@ -70,5 +129,9 @@ int rom_load(uint8_t* buf, int len) {
     
     rom_config(buf);
     
+    if (ConfigureParams.Boot.bFastBoot) {
+        rom_patch(buf, size);
+    }
+    
     return 0;
 }
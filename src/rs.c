@@ -8,11 +8,24 @@
   used by the magento-optical disk drive controller of the NeXT Computer. 
 
   This implementation has been written by Olivier Galibert.
+
+  The 32 column strings of a sector are independent of each other, they
+  are computed side by side with SIMD instructions where available. The
+  multiplications in GF(2**8) are done with two 16 entry tables for the
+  low and high nibble of each byte, which are looked up with a shuffle.
 */
 const char Rs_fileid[] = "Previous rs.c";
 
 #include <string.h>
 
+#if defined(__SSSE3__)
+#include <tmmintrin.h>
+#define RS_SIMD 1
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define RS_SIMD 1
+#endif
+
 #include "rs.h"
 
 
@@ -142,6 +155,81 @@ static uint32_t ecc_block(const uint8_t *s, int ss)
 	return r;
 }
 
+#ifdef RS_SIMD
+/* Nibble tables for the multiplications by the coefficients of the
+ * generator polynomial. They are the bytes of t_rem. */
+static uint8_t t_nib[4][2][16];
+static int t_nib_ready;
+
+static void rs_init_nibbles(void)
+{
+	int c, n;
+	
+	for(c=0; c<4; c++) {
+		for(n=0; n<16; n++) {
+			t_nib[c][0][n] = t_rem[n]      >> (24 - 8*c);
+			t_nib[c][1][n] = t_rem[n << 4] >> (24 - 8*c);
+		}
+	}
+	t_nib_ready = 1;
+}
+
+#if defined(__SSSE3__)
+typedef __m128i rs_vec;
+#define rs_load(p)      _mm_loadu_si128((const __m128i *)(p))
+#define rs_store(p, v)  _mm_storeu_si128((__m128i *)(p), v)
+#define rs_xor(a, b)    _mm_xor_si128(a, b)
+#define rs_zero()       _mm_setzero_si128()
+
+static inline rs_vec rs_mul(rs_vec v, const uint8_t t[2][16])
+{
+	rs_vec mask = _mm_set1_epi8(0x0f);
+	rs_vec lo = _mm_shuffle_epi8(rs_load(t[0]), _mm_and_si128(v, mask));
+	rs_vec hi = _mm_shuffle_epi8(rs_load(t[1]), _mm_and_si128(_mm_srli_epi64(v, 4), mask));
+	return rs_xor(lo, hi);
+}
+#else
+typedef uint8x16_t rs_vec;
+#define rs_load(p)      vld1q_u8(p)
+#define rs_store(p, v)  vst1q_u8(p, v)
+#define rs_xor(a, b)    veorq_u8(a, b)
+#define rs_zero()       vdupq_n_u8(0)
+
+static inline rs_vec rs_mul(rs_vec v, const uint8_t t[2][16])
+{
+	rs_vec lo = vqtbl1q_u8(vld1q_u8(t[0]), vandq_u8(v, vdupq_n_u8(0x0f)));
+	rs_vec hi = vqtbl1q_u8(vld1q_u8(t[1]), vshrq_n_u8(v, 4));
+	return rs_xor(lo, hi);
+}
+#endif
+
+/* Compute the check bytes of all column strings, ecc[k] receives the
+ * k-th check byte of each column */
+static void rs_columns(const uint8_t *sector, uint8_t ecc[4][32])
+{
+	int i, j;
+	rs_vec r0, r1, r2, r3, f;
+	
+	if(!t_nib_ready)
+		rs_init_nibbles();
+	
+	for(i=0; i<32; i+=16) {
+		r0 = r1 = r2 = r3 = rs_zero();
+		for(j=0; j<32; j++) {
+			f  = rs_xor(r3, rs_load(sector + 36*j + i));
+			r3 = rs_xor(r2, rs_mul(f, t_nib[0]));
+			r2 = rs_xor(r1, rs_mul(f, t_nib[1]));
+			r1 = rs_xor(r0, rs_mul(f, t_nib[2]));
+			r0 = rs_mul(f, t_nib[3]);
+		}
+		rs_store(ecc[0] + i, r3);
+		rs_store(ecc[1] + i, r2);
+		rs_store(ecc[2] + i, r1);
+		rs_store(ecc[3] + i, r0);
+	}
+}
+#endif
+
 static void rs_encode_string(uint8_t *sector, int off, int step)
 {
 	uint32_t ecc = ecc_block(sector+off, step);
@@ -340,8 +428,15 @@ void rs_encode(uint8_t *sector)
 	for(i=31; i>0; i--)
 		memmove(sector+36*i, sector+32*i, 32);
 	/* Encode columns */
+#ifdef RS_SIMD
+	uint8_t ecc[4][32];
+	rs_columns(sector, ecc);
+	for(i=0; i<4; i++)
+		memcpy(sector+36*(32+i), ecc[i], 32);
+#else
 	for(i=0; i<32; i++)
 		rs_encode_string(sector, i, 36);
+#endif
 	/* Encode rows */
 	for(i=0; i<36; i++)
 		rs_encode_string(sector, 36*i, 1);
@@ -359,7 +454,17 @@ int rs_decode(uint8_t *sector)
 		}
 	}
 	/* Decode columns */
+#ifdef RS_SIMD
+	/* Only strings with wrong check bytes need to be corrected */
+	uint8_t ecc[4][32];
+	rs_columns(sector, ecc);
+#endif
 	for(i=0; i<32; i++) {
+#ifdef RS_SIMD
+		if(sector[36*32+i] == ecc[0][i] && sector[36*33+i] == ecc[1][i] &&
+		   sector[36*34+i] == ecc[2][i] && sector[36*35+i] == ecc[3][i])
+			continue;
+#endif
 		e = rs_decode_string(sector, i, 36);
 		if(e==-1) {
 			return -1; /* Uncorrectable */
@@ -368,8 +473,15 @@ int rs_decode(uint8_t *sector)
 		}
 	}
 	/* Build decoded sector structure */
-	for(i=1; i<32; i++)
-		memmove(sector+i*32, sector+i*36, 32);
+	rs_strip(sector);
 	
 	return ecount;
 }
+
+/* Remove the check bytes of a sector without decoding it */
+void rs_strip(uint8_t *sector)
+{
+	int i;
+	for(i=1; i<32; i++)
+		memmove(sector+i*32, sector+i*36, 32);
+}
@@ -24,14 +24,21 @@ const char Rtcnvram_fileid[] = "Previous rtcnvram.c";
 #define LOG_RTC_LEVEL   LOG_DEBUG
 
 
-/* ---------------- RTC serial interface ---------------- */
+/* ---------------- RTC serial interface ---------------- *
+ *
+ * The guest clocks the interface one bit at a time. The bits only
+ * move through a shift register, the chip is accessed once per byte:
+ * a register is read when the first bit of its value is clocked out
+ * and written when the last bit of the new value is clocked in.
+ */
 #define RTC_ADDR_WRITE  0x80
 #define RTC_ADDR_CLOCK  0x20
 #define RTC_ADDR_MASK   0x7F
-static uint8_t rtc_addr = 0;
-static uint8_t rtc_val  = 0;
-static uint8_t rtc_data = 0;
-static int     phase    = 0;
+static uint8_t rtc_addr  = 0;
+static uint8_t rtc_shift = 0;   /* Bits being shifted in or out */
+static int     rtc_bits  = 0;   /* Bits of the current byte done */
+static bool    rtc_cmd   = true;/* Current byte is the address */
+static uint8_t rtc_data  = 0;
 
 
 /* --------------------- MC68HC68T1 --------------------- *
@@ -384,56 +391,29 @@ static void oldrtc_stop_pdown_request(void) {
 }
 
 
-static int oldrtc_interface_io(uint8_t rtdatabit) {
-    
-    phase++;
-    
-    if (phase<=8) {
-        rtc_addr = (rtc_addr<<1)|(rtdatabit?1:0);
+static uint8_t oldrtc_read(uint8_t addr) {
+    if (addr&RTC_ADDR_CLOCK) {
+        return oldrtc_get_clock(addr);
+    }
+    return rtc.ram[addr&RTC_ADDR_MASK];
+}
+
+static void oldrtc_write(uint8_t addr, uint8_t val) {
+    if (addr&RTC_ADDR_CLOCK) {
+        oldrtc_put_clock(addr, val);
     } else {
-        
-        if (phase==9) {
-            if (!(rtc_addr&RTC_ADDR_WRITE)) {
-                if (rtc_addr&RTC_ADDR_CLOCK) {
-                    rtc_val = oldrtc_get_clock(rtc_addr);
-                } else {
-                    rtc_val = rtc.ram[rtc_addr&RTC_ADDR_MASK];
-                }
-                
-                Log_Printf(LOG_RTC_LEVEL,"[RTC] reading val $%02X from addr $%02X",rtc_val,rtc_addr);
-            }
-        }
-        
-        if (rtc_addr&RTC_ADDR_WRITE) {
-            rtc_val = (rtc_val<<1)|(rtdatabit?1:0);
-        } else {
-            rtdatabit = (rtc_val&(1<<(16-phase)))?1:0;
-        }
-        
-        if (phase==16) {
-            if (rtc_addr&RTC_ADDR_WRITE) {
-                Log_Printf(LOG_RTC_LEVEL,"[RTC] writing val $%02X to addr $%02X",rtc_val,rtc_addr);
-                
-                if (rtc_addr&RTC_ADDR_CLOCK) {
-                    oldrtc_put_clock(rtc_addr, rtc_val);
-                } else {
-                    rtc.ram[rtc_addr&RTC_ADDR_MASK] = rtc_val;
-                }
-            }
-            
-            switch (rtc_addr) {
-                case 0x1F:
-                case 0x9F: rtc_addr = 0x00; break;
-                case 0x32:
-                case 0xB2: rtc_addr = 0x20; break;
-                default: rtc_addr++; break;
-            }
-            phase-=8;
-        }
+        rtc.ram[addr&RTC_ADDR_MASK] = val;
+    }
+}
+
+static uint8_t oldrtc_next_addr(uint8_t addr) {
+    switch (addr) {
+        case 0x1F:
+        case 0x9F: return 0x00;
+        case 0x32:
+        case 0xB2: return 0x20;
+        default:   return addr+1;
     }
-    
-    /* RTC returns 0 or 1 */
-    return rtdatabit;
 }
 
 /* Time counter is freezed while serial interface is active */
@@ -690,62 +670,32 @@ static void newrtc_request_power_down(void) {
 static void newrtc_stop_pdown_request(void) {}
 
 
-static int newrtc_interface_io(uint8_t rtdatabit) {
-    
-    phase++;
-    
-    if (phase<=8) {
-        rtc_addr = (rtc_addr<<1)|(rtdatabit?1:0);
+static uint8_t newrtc_read(uint8_t addr) {
+    if (addr&RTC_ADDR_CLOCK) {
+        return newrtc_get_clock(addr);
+    }
+    if (addr&RTC_ADDR_NEWRAM) {
+        return newrtc.ram2[addr&0x1F];
+    }
+    return rtc.ram[addr&0x1F];
+}
+
+static void newrtc_write(uint8_t addr, uint8_t val) {
+    if (addr&RTC_ADDR_CLOCK) {
+        newrtc_put_clock(addr, val);
+    } else if (addr&RTC_ADDR_NEWRAM) {
+        newrtc.ram2[addr&0x1F] = val;
     } else {
-        
-        if (phase==9) {
-            if (!(rtc_addr&RTC_ADDR_WRITE)) {
-                if (rtc_addr&RTC_ADDR_CLOCK) {
-                    rtc_val = newrtc_get_clock(rtc_addr);
-                } else {
-                    if (rtc_addr&RTC_ADDR_NEWRAM) {
-                        rtc_val = newrtc.ram2[rtc_addr&0x1F];
-                    } else {
-                        rtc_val = rtc.ram[rtc_addr&0x1F];
-                    }
-                }
-                
-                Log_Printf(LOG_RTC_LEVEL,"[RTC] reading val $%02X from addr $%02X",rtc_val,rtc_addr);
-            }
-        }
-        
-        if (rtc_addr&RTC_ADDR_WRITE) {
-            rtc_val = (rtc_val<<1)|(rtdatabit?1:0);
-        } else {
-            rtdatabit = (rtc_val&(1<<(16-phase)))?1:0;
-        }
-        
-        if (phase==16) {
-            if (rtc_addr&RTC_ADDR_WRITE) {
-                Log_Printf(LOG_RTC_LEVEL,"[RTC] writing val $%02X to addr $%02X",rtc_val,rtc_addr);
-                
-                if (rtc_addr&RTC_ADDR_CLOCK) {
-                    newrtc_put_clock(rtc_addr, rtc_val);
-                } else {
-                    if (rtc_addr&RTC_ADDR_NEWRAM) {
-                        newrtc.ram2[rtc_addr&0x1F] = rtc_val;
-                    } else {
-                        rtc.ram[rtc_addr&0x1F] = rtc_val;
-                    }
-                }
-            }
-            
-            switch (rtc_addr) {
-                case 0x7F: rtc_addr = 0x00; break;
-                case 0xFF: rtc_addr = 0x80; break;
-                default: rtc_addr++; break;
-            }
-            phase-=8;
-        }
+        rtc.ram[addr&0x1F] = val;
+    }
+}
+
+static uint8_t newrtc_next_addr(uint8_t addr) {
+    switch (addr) {
+        case 0x7F: return 0x00;
+        case 0xFF: return 0x80;
+        default:   return addr+1;
     }
-    
-    /* RTC returns 0 or 1 */
-    return rtdatabit;
 }
 
 /* Data sheet is wrong about when the time counter latch is loaded. But is this correct? */
@@ -757,11 +707,65 @@ static void newrtc_interface_start(void) {
 
 
 /* ----------------- Common RTC interface ---------------- */
-void rtc_interface_write(uint8_t rtdatabit) {
+static uint8_t rtc_read_byte(uint8_t addr) {
+    uint8_t val;
+    
+    if (ConfigureParams.System.nRTC == MCCS1850) {
+        val = newrtc_read(addr);
+    } else {
+        val = oldrtc_read(addr);
+    }
+    Log_Printf(LOG_RTC_LEVEL,"[RTC] reading val $%02X from addr $%02X",val,addr);
+    return val;
+}
+
+static void rtc_write_byte(uint8_t addr, uint8_t val) {
+    Log_Printf(LOG_RTC_LEVEL,"[RTC] writing val $%02X to addr $%02X",val,addr);
+    if (ConfigureParams.System.nRTC == MCCS1850) {
+        newrtc_write(addr, val);
+    } else {
+        oldrtc_write(addr, val);
+    }
+}
+
+static uint8_t rtc_next_addr(uint8_t addr) {
     if (ConfigureParams.System.nRTC == MCCS1850) {
-        rtc_data = newrtc_interface_io(rtdatabit);
+        return newrtc_next_addr(addr);
+    }
+    return oldrtc_next_addr(addr);
+}
+
+void rtc_interface_write(uint8_t rtdatabit) {
+    rtdatabit = rtdatabit?1:0;
+    
+    if (rtc_cmd) {
+        rtc_addr = (rtc_addr<<1)|rtdatabit;
+        if (++rtc_bits==8) {
+            rtc_cmd  = false;
+            rtc_bits = 0;
+        }
+        rtc_data = rtdatabit;
+        return;
+    }
+    
+    if (rtc_addr&RTC_ADDR_WRITE) {
+        rtc_shift = (rtc_shift<<1)|rtdatabit;
+        rtc_data  = rtdatabit;
     } else {
-        rtc_data = oldrtc_interface_io(rtdatabit);
+        if (rtc_bits==0) {
+            rtc_shift = rtc_read_byte(rtc_addr);
+        }
+        rtc_data    = rtc_shift>>7;
+        rtc_shift <<= 1;
+    }
+    
+    /* Consecutive registers follow without a new address */
+    if (++rtc_bits==8) {
+        if (rtc_addr&RTC_ADDR_WRITE) {
+            rtc_write_byte(rtc_addr, rtc_shift);
+        }
+        rtc_addr = rtc_next_addr(rtc_addr);
+        rtc_bits = 0;
     }
 }
 
@@ -780,9 +784,10 @@ void rtc_interface_start(void) {
 void rtc_interface_reset(void) {
     Log_Printf(LOG_RTC_LEVEL, "[RTC] interface reset");
     
-    phase    = 0;
-    rtc_addr = 0;
-    rtc_val  = 0;
+    rtc_cmd   = true;
+    rtc_bits  = 0;
+    rtc_addr  = 0;
+    rtc_shift = 0;
     if (ConfigureParams.System.bTurbo) {
         rtc_data = 0;
     } else {
@@ -943,6 +948,8 @@ uint8_t nvram_default[32]={
     0x0F,0x13 // byte 30, 31: checksum
 };
 
+static uint16_t lastSIMMconfig = 0xFFFF;
+
 void nvram_init(void) {
     /* Reset RTC RAM */
     memset(rtc.ram, 0, 32);
@@ -1030,10 +1037,12 @@ void nvram_init(void) {
     rtc.ram[10] = (SIMMconfig>>8)&0xFF;
     rtc.ram[11] = SIMMconfig&0xFF;
     
-    /* Build POT byte[0] */
+    /* Build POT byte[0], fast boot only tests memory if it has changed */
     rtc.ram[14] = 0x00;
-    if (ConfigureParams.Boot.bEnableDRAMTest)
+    if (ConfigureParams.Boot.bEnableDRAMTest &&
+        !(ConfigureParams.Boot.bFastBoot && SIMMconfig == lastSIMMconfig))
         rtc.ram[14] |= TEST_DRAM_POT;
+    lastSIMMconfig = SIMMconfig;
     if (ConfigureParams.Boot.bEnablePot)
         rtc.ram[14] |= POT_ON;
     if (ConfigureParams.Boot.bEnableSoundTest)
@@ -6,6 +6,11 @@
 
   This file contains a simulation of the AMD AM8530H Serial Communication
   Controller. Incomplete.
+
+  One channel can be bridged to the host (see serial.c). Received bytes are
+  polled from the host at the character rate of the programmed baud rate,
+  or as fast as the guest reads them in high speed mode. Transmit DMA moves
+  all bytes the host buffer can take in one event.
 */
 const char Scc_fileid[] = "Previous scc.c";
 
@@ -16,6 +21,7 @@ const char Scc_fileid[] = "Previous scc.c";
 #include "scc.h"
 #include "sysReg.h"
 #include "dma.h"
+#include "serial.h"
 
 #define LOG_SCC_LEVEL     LOG_DEBUG
 #define LOG_SCC_IO_LEVEL  LOG_DEBUG
@@ -254,6 +260,11 @@ uint8_t scc_register_pointer = 0;
 #define PCLK_HZ 3684000
 #define RTXC_HZ 4000000
 
+/* Host bridge timing */
+#define SCC_CHAR_US     1042        /* 9600 baud, 10 bit per character */
+#define SCC_FAST_US     20          /* High speed receive poll */
+#define SCC_DMA_CHUNK   256         /* Bytes per transmit DMA event */
+
 
 /* Interrupts */
 static void scc_check_interrupt(void) {
@@ -333,8 +344,8 @@ static void scc_send(int ch, uint8_t val) {
 
     if (scc[ch].wreg[W_MISC]&WR14_LOOPBACK) {
         scc_receive(ch, val);
-    } else {
-        /* send to real world */
+    } else if (Serial_Active(ch)) {
+        Serial_Write(&val, 1);
     }
     
     if (scc[ch].wreg[W_MODE]&WR1_TXIE) {
@@ -347,8 +358,61 @@ static void scc_send_dma(int ch, uint8_t val) {
     
     if (scc[ch].wreg[W_MISC]&WR14_LOOPBACK) {
         scc_receive(ch, val);
-    } else {
-        /* send to real world */
+    } else if (Serial_Active(ch)) {
+        Serial_Write(&val, 1);
+    }
+}
+
+static void scc_send_dma_bulk(int ch) {
+    uint8_t buf[SCC_DMA_CHUNK];
+    int len = 0;
+    int max = Serial_WriteFree();
+    
+    if (max > SCC_DMA_CHUNK) {
+        max = SCC_DMA_CHUNK;
+    }
+    while (len < max && dma_scc_ready()) {
+        buf[len++] = dma_scc_read_memory();
+    }
+    Log_Printf(LOG_SCC_IO_LEVEL,"[SCC] Channel %c: Sending %i bytes via DMA\n", ch?'B':'A', len);
+    
+    Serial_Write(buf, len);
+}
+
+/* Time for one character at the programmed baud rate */
+static int scc_char_time_us(int ch) {
+    int tc, clk, mult, baud;
+    
+    if (!(scc[ch].wreg[W_MISC]&WR14_BRENABLE)) {
+        return SCC_CHAR_US;
+    }
+    tc  = scc[ch].wreg[W_BRG_LOW]|(scc[ch].wreg[W_BRG_HIGH]<<8);
+    clk = (scc[ch].wreg[W_MISC]&WR14_BRPCLK) ? PCLK_HZ : RTXC_HZ;
+    switch (scc[ch].wreg[W_MISCMODE]&0xC0) {
+        case WR4_X16CLOCK: mult = 16; break;
+        case WR4_X32CLOCK: mult = 32; break;
+        case WR4_X64CLOCK: mult = 64; break;
+        default:           mult = 1;  break;
+    }
+    baud = clk/(2*(tc+2)*mult);
+    
+    return baud > 0 ? (10*1000000+baud-1)/baud : SCC_CHAR_US;
+}
+
+void SCC_RX_Handler(void) {
+    int ch = ConfigureParams.Serial.nChannel;
+    uint8_t val;
+    
+    CycInt_AcknowledgeInterrupt();
+    
+    if (Serial_Active(ch)) {
+        if (!(scc[ch].rreg[R_STATUS]&RR0_RXAVAIL) && !(scc[ch].wreg[W_MISC]&WR14_LOOPBACK)) {
+            if (Serial_Read(&val, 1)) {
+                scc_receive(ch, val);
+            }
+        }
+        CycInt_AddRelativeInterruptUs(ConfigureParams.Serial.bHighSpeed ? SCC_FAST_US : scc_char_time_us(ch),
+                                      0, INTERRUPT_SCC_RX);
     }
 }
 
@@ -371,7 +435,11 @@ void SCC_IO_Handler(void) {
             if (scc[i].wreg[W_MODE]&WR1_REQENABLE) {
                 if (scc[i].wreg[W_MODE]&WR1_REQFUNC) {
                     if (dma_scc_ready() && !(scc[i].rreg[R_STATUS]&RR0_RXAVAIL)) {
-                        scc_send_dma(i, dma_scc_read_memory());
+                        if (Serial_Active(i) && !(scc[i].wreg[W_MISC]&WR14_LOOPBACK)) {
+                            scc_send_dma_bulk(i);
+                        } else {
+                            scc_send_dma(i, dma_scc_read_memory());
+                        }
                     }
                 }
                 CycInt_AddRelativeInterruptCycles(50, INTERRUPT_SCC_IO);
@@ -636,6 +704,12 @@ static void scc_clock_write(uint8_t val) {
 void SCC_Reset(void) {
     scc_hard_reset();
     scc[0].clock = 0;
+    
+    Serial_Reset();
+    CycInt_RemovePendingInterrupt(INTERRUPT_SCC_RX);
+    if (Serial_Active(ConfigureParams.Serial.nChannel)) {
+        CycInt_AddRelativeInterruptUs(SCC_CHAR_US, 0, INTERRUPT_SCC_RX);
+    }
 }
 
 
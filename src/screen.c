@@ -50,6 +50,8 @@ static MONITORTYPE   saveMonitorType;  /* Save monitor type to restore on return
 static uint32_t      mask;             /* green screen mask for transparent UI areas */
 static void*         uiBuffer;         /* uiBuffer used for user interface texture */
 static SDL_SpinLock  uiBufferLock;     /* Lock for concurrent access to UI buffer between m68k thread and repainter */
+static int           uiDirtyTop;       /* Rows of uiBuffer changed since the last upload, */
+static int           uiDirtyBottom;    /* none if top >= bottom. Protected by uiBufferLock. */
 #ifdef ENABLE_RENDERING_THREAD
 static void*         uiBufferTmp;      /* Temporary uiBuffer used by repainter */
 static volatile bool doRepaint = true; /* Repaint thread runs while true */
@@ -57,8 +59,24 @@ static SDL_Thread*   repaintThread;
 #endif
 
 
+static uint64_t frameCount;  /* Frames presented in the main window since start */
+
+/* NeXTdimension screens shown right of the main screen in dual monitor
+ * mode, painted by the main repainter with the main renderer */
+static struct {
+	SDL_Texture* tex;
+	int          board;
+	bool         full;   /* texture does not hold VRAM contents */
+	int          lutGen; /* RAMDAC palette the texture holds */
+} ndPanel[ND_MAX_BOARDS];
+static volatile int ndPanels;
+static int      prescale = 1; /* Texels per pixel and direction in fbTexture */
+
 static uint32_t BW2RGB[0x400];
-static uint32_t COL2RGB[0x10000];
+/* Color pixels are converted per byte: RRRRGGGG and BBBBXXXX. Channels
+ * occupy disjoint bits of the host pixel, so the two halves are OR'ed. */
+static uint32_t COL2RGB_RG[0x100];
+static uint32_t COL2RGB_BX[0x100];
 
 static uint32_t bw2rgb(SDL_PixelFormat* format, int bw) {
 	switch(bw & 3) {
@@ -70,79 +88,348 @@ static uint32_t bw2rgb(SDL_PixelFormat* format, int bw) {
 	}
 }
 
-static uint32_t col2rgb(SDL_PixelFormat* format, int col) {
+static uint32_t col2rgb(SDL_PixelFormat* format, const bt463* ramdac, int col) {
 	int r = col & 0xF000; r >>= 12; r |= r << 4;
 	int g = col & 0x0F00; g >>= 8;  g |= g << 4;
 	int b = col & 0x00F0; b >>= 4;  b |= b << 4;
-	return SDL_MapRGB(format, r, g, b);
+	return SDL_MapRGB(format, BT463_LUT(ramdac, 0, r), BT463_LUT(ramdac, 1, g), BT463_LUT(ramdac, 2, b));
 }
 
 /*
- BW format is 2 bit per pixel
+ Fold the palette of the CPU board RAMDAC into the color lookup tables.
+ Returns true if the tables have changed since the last call.
  */
-static void blitBW(SDL_Texture* tex) {
-	void* pixels;
-	uint32_t* dst;
-	int src, idx, src_pitch, dst_pitch, x, y;
+static bool colorTables(void) {
+	static int lutGen = -1;
+	const bt463* ramdac = RAMDAC_Get();
+	SDL_PixelFormat* pformat;
+	int i, gen = ramdac->lut_gen;
+
+	if (gen == lutGen) {
+		return false;
+	}
+	lutGen  = gen;
+	pformat = SDL_AllocFormat(SDL_PIXELFORMAT_BGRA32);
+	for (i = 0; i < 0x100; i++) {
+		COL2RGB_RG[i] = col2rgb(pformat, ramdac, i << 8);
+		COL2RGB_BX[i] = col2rgb(pformat, ramdac, i);
+	}
+	SDL_FreeFormat(pformat);
+	return true;
+}
+
+/*
+ Collect the scanlines covered by dirty VRAM blocks into lines and clear
+ the blocks. All lines are returned if full is set.
+ */
+static void dirtyLines(int src_pitch, bool full, uint8_t* lines) {
+	int y, b, first, last;
 
-	src_pitch = (NeXT_SCRN_WIDTH + (ConfigureParams.System.bTurbo ? 0 : 32)) / 4;
-	SDL_LockTexture(tex, NULL, &pixels, &dst_pitch);
 	for (y = 0; y < NeXT_SCRN_HEIGHT; y++) {
-		src = y * src_pitch;
-		dst = (uint32_t*)((uint8_t*)pixels + (y * dst_pitch));
-		for (x = 0; x < NeXT_SCRN_WIDTH / 4; x++) {
-			idx = NEXTVideo[src++] * 4;
-			*dst++ = BW2RGB[idx+0];
-			*dst++ = BW2RGB[idx+1];
-			*dst++ = BW2RGB[idx+2];
-			*dst++ = BW2RGB[idx+3];
+		first = (y * src_pitch) >> NEXT_VRAM_DIRTY_SHIFT;
+		last  = ((y + 1) * src_pitch - 1) >> NEXT_VRAM_DIRTY_SHIFT;
+		lines[y] = full;
+		for (b = first; b <= last; b++) {
+			lines[y] |= NEXTVideo_dirty[b];
 		}
 	}
-	SDL_UnlockTexture(tex);
+	/* Clear blocks before converting, writes from now on show up next time */
+	memset(NEXTVideo_dirty, 0, ((NeXT_SCRN_HEIGHT * src_pitch) >> NEXT_VRAM_DIRTY_SHIFT) + 1);
+}
+
+/*
+ BW format is 2 bit per pixel
+ */
+static void convBW(const uint8_t* src, uint32_t* dst, const bt463* ramdac) {
+	int x;
+
+	for (x = 0; x < NeXT_SCRN_WIDTH / 4; x++) {
+		/* One 16 byte copy for four pixels */
+		memcpy(dst, &BW2RGB[*src++ * 4], 4 * sizeof(uint32_t));
+		dst += 4;
+	}
 }
 
 /*
  Color format is 4 bit per pixel, big-endian: RGBX
  */
-static void blitColor(SDL_Texture* tex) {
-	void* pixels;
-	uint16_t* src;
+static void convColor(const uint8_t* src, uint32_t* dst, const bt463* ramdac) {
+	int x;
+
+	for (x = 0; x < NeXT_SCRN_WIDTH; x++, src += 2) {
+		*dst++ = COL2RGB_RG[src[0]] | COL2RGB_BX[src[1]];
+	}
+}
+
+/*
+ Dimension format is 8 bit per pixel, big-endian: BBGGRRAA
+ Each channel goes through the RAMDAC lookup table, see ramdac.h.
+ */
+static void convDimension(const uint8_t* src, uint32_t* dst32, const bt463* ramdac) {
+	const uint8_t* r = ramdac->lut[0];
+	const uint8_t* g = ramdac->lut[1];
+	const uint8_t* b = ramdac->lut[2];
+	uint8_t* dst = (uint8_t*)dst32;
+	int x;
+
+	for (x = 0; x < NeXT_SCRN_WIDTH; x++, src += 4, dst += 4) {
+		dst[0] = b[src[0]] ^ src[0];
+		dst[1] = g[src[1]] ^ src[1];
+		dst[2] = r[src[2]] ^ src[2];
+		dst[3] = src[3];
+	}
+}
+
+/*
+ Dimension VRAM has the texture format while the palette is a linear ramp
+ */
+static void convCopy(const uint8_t* src, uint32_t* dst, const bt463* ramdac) {
+	memcpy(dst, src, NeXT_SCRN_WIDTH * 4);
+}
+
+/*
+ A run of scanlines to convert into a locked texture area. With a scale
+ above one every pixel is expanded to a square of scale by scale texels,
+ so the renderer only has to scale by what is left and the picture stays
+ sharp on high-dpi displays.
+ */
+typedef struct {
+	void (*conv)(const uint8_t*, uint32_t*, const bt463*);
+	const bt463*   ramdac;
+	const uint8_t* src;
+	int            src_pitch;
+	uint8_t*       dst;
+	int            dst_pitch;
+	int            rows;
+	int            scale;
+} BLIT_RUN;
+
+static void blitRows(const BLIT_RUN* run, int first, int last) {
 	uint32_t* dst;
-	int src_pitch, dst_pitch, x, y;
+	uint32_t  pixel;
+	int y, x, i;
+
+	for (y = first; y < last; y++) {
+		dst = (uint32_t*)(run->dst + y * run->scale * run->dst_pitch);
+		run->conv(run->src + y * run->src_pitch, dst, run->ramdac);
+		if (run->scale > 1) {
+			/* Expand from the end, so no pixel is overwritten before it is read */
+			for (x = NeXT_SCRN_WIDTH - 1; x >= 0; x--) {
+				pixel = dst[x];
+				for (i = 0; i < run->scale; i++) {
+					dst[x * run->scale + i] = pixel;
+				}
+			}
+			for (i = 1; i < run->scale; i++) {
+				memcpy((uint8_t*)dst + i * run->dst_pitch, dst, NeXT_SCRN_WIDTH * run->scale * 4);
+			}
+		}
+	}
+}
 
-	src_pitch = NeXT_SCRN_WIDTH + (ConfigureParams.System.bTurbo ? 0 : 32);
-	SDL_LockTexture(tex, NULL, &pixels, &dst_pitch);
-	for (y = 0; y < NeXT_SCRN_HEIGHT; y++) {
-		src = (uint16_t*)NEXTVideo + (y * src_pitch);
-		dst = (uint32_t*)((uint8_t*)pixels + (y * dst_pitch));
-		for (x = 0; x < NeXT_SCRN_WIDTH; x++) {
-			*dst++ = COL2RGB[*src++];
+/*
+ Large runs are split into horizontal bands that a few helper threads
+ convert next to the calling thread. The pool serves one run at a time,
+ a caller that finds it busy (the repainter of another window) converts
+ its run alone.
+ */
+#define BLIT_THREADS    3           /* helpers besides the caller */
+#define BLIT_MIN_TEXELS (128*1120)  /* smaller runs are not split */
+
+static SDL_Thread*   blitThread[BLIT_THREADS];
+static SDL_sem*      blitStart[BLIT_THREADS];
+static SDL_sem*      blitDone;
+static int           blitHelpers;
+static SDL_SpinLock  blitPoolLock;
+static const BLIT_RUN* blitPoolRun;
+static volatile bool blitQuit;
+
+static void blitBand(const BLIT_RUN* run, int band) {
+	int bands = blitHelpers + 1;
+
+	blitRows(run, run->rows * band / bands, run->rows * (band + 1) / bands);
+}
+
+static int blitHelper(void* arg) {
+	int band = (int)(intptr_t)arg;
+
+	for (;;) {
+		SDL_SemWait(blitStart[band - 1]);
+		if (blitQuit) {
+			break;
 		}
+		blitBand(blitPoolRun, band);
+		SDL_SemPost(blitDone);
+	}
+	return 0;
+}
+
+static void blitRun(const BLIT_RUN* run) {
+	int i;
+
+	if (blitHelpers == 0 || run->rows * run->scale * run->scale * NeXT_SCRN_WIDTH < BLIT_MIN_TEXELS ||
+	    !SDL_AtomicTryLock(&blitPoolLock)) {
+		blitRows(run, 0, run->rows);
+		return;
+	}
+	blitPoolRun = run;
+	for (i = 0; i < blitHelpers; i++) {
+		SDL_SemPost(blitStart[i]);
+	}
+	blitBand(run, 0);
+	for (i = 0; i < blitHelpers; i++) {
+		SDL_SemWait(blitDone);
+	}
+	SDL_AtomicUnlock(&blitPoolLock);
+}
+
+static void blitStartHelpers(void) {
+	char name[64];
+	int i, n = SDL_GetCPUCount() - 2; /* leave the m68k thread and the caller alone */
+
+	if (n > BLIT_THREADS) {
+		n = BLIT_THREADS;
+	}
+	blitQuit = false;
+	blitDone = SDL_CreateSemaphore(0);
+	for (i = 0; i < n; i++) {
+		snprintf(name, sizeof(name), "[Previous] Blit %d", i + 1);
+		blitStart[i]  = SDL_CreateSemaphore(0);
+		blitThread[i] = SDL_CreateThread(blitHelper, name, (void*)(intptr_t)(i + 1));
+	}
+	blitHelpers = n > 0 ? n : 0;
+}
+
+static void blitStopHelpers(void) {
+	int i, s;
+
+	blitQuit = true;
+	for (i = 0; i < blitHelpers; i++) {
+		SDL_SemPost(blitStart[i]);
+		SDL_WaitThread(blitThread[i], &s);
+		SDL_DestroySemaphore(blitStart[i]);
+	}
+	blitHelpers = 0;
+	if (blitDone) {
+		SDL_DestroySemaphore(blitDone);
+		blitDone = NULL;
 	}
-	SDL_UnlockTexture(tex);
 }
 
 /*
- Dimension format is 8 bit per pixel, big-endian: BBGGRRAA
+ Pixel expansion stays on the CPU: the SDL2 render API has no shader
+ hook and none of its texture formats matches the 2 bit or the
+ byte-swapped 4 bit VRAM layout. Scaling is done by the renderer in
+ SDL_RenderCopy. Only runs of scanlines with writes since the last call
+ are converted, all of them if full is set. Returns true if anything has
+ been written to the texture.
+ */
+static bool blitNeXT(SDL_Texture* tex, bool full) {
+	static uint8_t lines[832];
+	BLIT_RUN run;
+	void* pixels;
+	int y, n;
+	SDL_Rect rect;
+	bool updated = false;
+
+	run.src_pitch = NeXT_SCRN_WIDTH + (ConfigureParams.System.bTurbo ? 0 : 32);
+	if (ConfigureParams.System.bColor) {
+		run.src_pitch *= 2;
+		run.conv = convColor;
+		full |= colorTables();
+	} else {
+		run.src_pitch /= 4;
+		run.conv = convBW;
+	}
+	run.ramdac = NULL;
+	run.scale  = prescale;
+	dirtyLines(run.src_pitch, full, lines);
+
+	for (y = 0; y < NeXT_SCRN_HEIGHT; y += n) {
+		for (n = 0; y + n < NeXT_SCRN_HEIGHT && lines[y + n]; n++) {}
+		if (n == 0) {
+			n = 1;
+			continue;
+		}
+		rect.x = 0;
+		rect.y = y * prescale;
+		rect.w = NeXT_SCRN_WIDTH * prescale;
+		rect.h = n * prescale;
+		SDL_LockTexture(tex, &rect, &pixels, &run.dst_pitch);
+		run.src  = NEXTVideo + y * run.src_pitch;
+		run.dst  = pixels;
+		run.rows = n;
+		blitRun(&run);
+		SDL_UnlockTexture(tex);
+		updated = true;
+	}
+	return updated;
+}
+
+/*
+ The texture has the VRAM pixel format, lines are copied as they are while
+ the RAMDAC palette is a linear ramp. A palette change since lut_gen forces
+ a full blit. Only runs of scanlines marked in dirty are converted, all of
+ them if full is set. Returns true if anything has been written to the
+ texture.
  */
-void Screen_BlitDimension(uint32_t* vram, SDL_Texture* tex) {
-	void* src;
+static bool blitDimension(uint32_t* vram, uint8_t* dirty, bool full, SDL_Texture* tex, const bt463* ramdac, int* lut_gen, int scale) {
+	BLIT_RUN run;
+	uint8_t* src;
 	void* dst;
-	int src_pitch, dst_pitch;
-	uint32_t src_format, dst_format;
+	int y, n, gen;
+	SDL_Rect rect;
+	bool updated = false;
 
 #if ND_STEP
-	src = &vram[0];
+	src = (uint8_t*)&vram[0];
 #else
-	src = &vram[4];
+	src = (uint8_t*)&vram[4];
 #endif
-	src_pitch  = (NeXT_SCRN_WIDTH + 32) * 4;
-	src_format = SDL_PIXELFORMAT_BGRA32;
-	SDL_QueryTexture(tex, &dst_format, NULL, NULL, NULL);
+	run.src_pitch = ND_VRAM_PITCH;
 
-	SDL_LockTexture(tex, NULL, &dst, &dst_pitch);
-	SDL_ConvertPixels(NeXT_SCRN_WIDTH, NeXT_SCRN_HEIGHT, src_format, src, src_pitch, dst_format, dst, dst_pitch);
-	SDL_UnlockTexture(tex);
+	gen = ramdac->lut_gen;
+	if (gen != *lut_gen) {
+		*lut_gen = gen;
+		full = true;
+	}
+	run.conv   = ramdac->lut_nonlinear ? convDimension : convCopy;
+	run.ramdac = ramdac;
+	run.scale  = scale;
+
+	for (y = 0; y < NeXT_SCRN_HEIGHT; y += n) {
+		/* Clear flags before converting, writes from now on show up next time */
+		for (n = 0; y + n < NeXT_SCRN_HEIGHT && (full || !dirty || dirty[y + n]); n++) {
+			if (dirty) dirty[y + n] = 0;
+		}
+		if (n == 0) {
+			n = 1;
+			continue;
+		}
+		rect.x = 0;
+		rect.y = y * scale;
+		rect.w = NeXT_SCRN_WIDTH * scale;
+		rect.h = n * scale;
+		SDL_LockTexture(tex, &rect, &dst, &run.dst_pitch);
+		run.src  = src + y * run.src_pitch;
+		run.dst  = dst;
+		run.rows = n;
+		blitRun(&run);
+		SDL_UnlockTexture(tex);
+		updated = true;
+	}
+	return updated;
+}
+
+bool Screen_BlitDimension(uint32_t* vram, uint8_t* dirty, bool full, SDL_Texture* tex, const bt463* ramdac, int* lut_gen) {
+	return blitDimension(vram, dirty, full, tex, ramdac, lut_gen, 1);
+}
+
+/*
+ Frames presented in the main window since start. Can be read from any thread.
+ */
+uint64_t Screen_FrameCount(void) {
+	return frameCount;
 }
 
 /*
@@ -150,71 +437,182 @@ void Screen_BlitDimension(uint32_t* vram, SDL_Texture* tex) {
  */
 void Screen_Blank(SDL_Texture* tex) {
 	void* pixels;
-	int   pitch;
+	int   pitch, w, scale;
+
+	SDL_QueryTexture(tex, NULL, NULL, &w, NULL);
+	scale = w / NeXT_SCRN_WIDTH;
 	SDL_LockTexture(tex, NULL, &pixels, &pitch);
-	SDL_memset4(pixels, COL2RGB[0], pitch * NeXT_SCRN_HEIGHT / 4);
+	SDL_memset4(pixels, COL2RGB_RG[0] | COL2RGB_BX[0], pitch * NeXT_SCRN_HEIGHT * scale / 4);
 	SDL_UnlockTexture(tex);
 }
 
+/*
+ Frame rate cap. Returns 0 and sets lastFrame if a new frame may be shown,
+ else the time in microseconds until the next one is due.
+ */
+uint64_t Screen_FrameWait(uint64_t* lastFrame) {
+	uint64_t now, interval;
+
+	if (ConfigureParams.Screen.nFrameRateCap <= 0) {
+		return 0;
+	}
+	now      = host_time_us();
+	interval = 1000000 / ConfigureParams.Screen.nFrameRateCap;
+	if (now - *lastFrame < interval) {
+		return interval - (now - *lastFrame);
+	}
+	*lastFrame = now;
+	return 0;
+}
+
+/*
+ Mark rows of the UI buffer for upload. Called with uiBufferLock held.
+ */
+static void uiMarkRows(int top, int bottom) {
+	if (top < uiDirtyTop)       uiDirtyTop    = top;
+	if (bottom > uiDirtyBottom) uiDirtyBottom = bottom;
+}
+
+/*
+ Take the rows of the UI buffer to upload. All of them if blitUI has been
+ set without marking any rows. Called with uiBufferLock held.
+ */
+static void uiTakeRows(int* top, int* bottom) {
+	if (uiDirtyTop < uiDirtyBottom) {
+		*top    = uiDirtyTop;
+		*bottom = uiDirtyBottom;
+	} else {
+		*top    = 0;
+		*bottom = sdlscrn->h;
+	}
+	uiDirtyTop    = sdlscrn->h;
+	uiDirtyBottom = 0;
+}
+
 /*
  Blit NeXT framebuffer to texture.
  */
 static bool blitScreen(SDL_Texture* tex) {
+	static void* fbSource = NULL; /* Framebuffer the texture holds, NULL if none */
+	static int   ndLutGen = 0;      /* RAMDAC palette the texture holds */
+
 	if (ConfigureParams.Screen.nMonitorType==MONITOR_TYPE_DIMENSION) {
-		uint32_t* vram = nd_vram_for_slot(ND_SLOT(ConfigureParams.Screen.nMonitorNum));
+		uint32_t* vram  = nd_vram_for_slot(ND_SLOT(ConfigureParams.Screen.nMonitorNum));
+		uint8_t*  dirty = nd_vram_dirty_for_slot(ND_SLOT(ConfigureParams.Screen.nMonitorNum));
 		if (vram) {
 			if (nd_video_enabled(ND_SLOT(ConfigureParams.Screen.nMonitorNum))) {
-				Screen_BlitDimension(vram, tex);
+				bool full = fbSource != vram;
+				fbSource = vram;
+				return blitDimension(vram, dirty, full, tex, nd_ramdac_for_slot(ND_SLOT(ConfigureParams.Screen.nMonitorNum)), &ndLutGen, prescale);
 			} else {
 				Screen_Blank(tex);
 			}
+			fbSource = NULL;
 			return true;
 		}
 	} else {
 		if (NEXTVideo) {
 			if (Video_Enabled()) {
-				if (ConfigureParams.System.bColor) {
-					blitColor(tex);
-				} else {
-					blitBW(tex);
-				}
+				bool full = fbSource != NEXTVideo;
+				fbSource = NEXTVideo;
+				return blitNeXT(tex, full);
 			} else {
 				Screen_Blank(tex);
 			}
+			fbSource = NULL;
 			return true;
 		}
 	}
 	return false;
 }
 
+/*
+ Blit NeXTdimension framebuffers to the panel textures.
+ */
+static bool blitPanels(void) {
+	bool updated = false;
+	int  i, slot;
+
+	for (i = 0; i < ndPanels; i++) {
+		slot = ND_SLOT(ndPanel[i].board);
+		if (nd_vram_for_slot(slot) && nd_video_enabled(slot)) {
+			if (blitDimension(nd_vram_for_slot(slot), nd_vram_dirty_for_slot(slot), ndPanel[i].full,
+			                  ndPanel[i].tex, nd_ramdac_for_slot(slot), &ndPanel[i].lutGen, 1)) {
+				ndPanel[i].full = false;
+				updated = true;
+			}
+		} else if (!ndPanel[i].full) {
+			Screen_Blank(ndPanel[i].tex);
+			ndPanel[i].full = true;
+			updated = true;
+		}
+	}
+	return updated;
+}
+
+/*
+ Render the panel textures next to the main screen.
+ */
+static void renderPanels(void) {
+	SDL_Rect rect = { 0, 0, NeXT_SCRN_WIDTH, NeXT_SCRN_HEIGHT };
+	int i;
+
+	for (i = 0; i < ndPanels; i++) {
+		rect.x = width * (i + 1);
+		SDL_RenderCopy(sdlRenderer, ndPanel[i].tex, NULL, &rect);
+	}
+}
+
+/*
+ Width of the renderer's logical size, the main screen and the panels.
+ */
+static int logicalWidth(void) {
+	return width * (1 + ndPanels);
+}
+
 /*
  Blits the NeXT framebuffer to the fbTexture, blends with the GUI surface and shows it.
  */
 #ifdef ENABLE_RENDERING_THREAD
 static int repainter(void* unused) {
+	uint64_t lastFrame = 0;
+	uint64_t wait;
+
 	SDL_SetThreadPriority(SDL_THREAD_PRIORITY_NORMAL);
 
 	/* Enter repaint loop */
 	while(doRepaint) {
 		bool updateFB = false;
 		bool updateUI = false;
+		int  top = 0, bottom = 0, offset = 0;
+
+		// Changes in VRAM accumulate until the next frame is due
+		if ((wait = Screen_FrameWait(&lastFrame))) {
+			host_sleep_us(wait);
+			continue;
+		}
 
 		if (SDL_AtomicGet(&blitFB)) {
 			// Blit the NeXT framebuffer to texture
+			uint64_t start = host_prof_now();
 			updateFB = blitScreen(fbTexture);
+			updateFB |= blitPanels();
+			host_prof_end(HOST_PROF_BLIT, start);
 		}
 
-		// Copy UI surface to texture
+		// Copy changed rows of UI surface to texture
 		SDL_AtomicLock(&uiBufferLock);
 		if(SDL_AtomicSet(&blitUI, 0)) {
-			// update full UI texture
-			memcpy(uiBufferTmp, uiBuffer, sdlscrn->h * sdlscrn->pitch);
+			uiTakeRows(&top, &bottom);
+			offset = top * sdlscrn->pitch;
+			memcpy((uint8_t*)uiBufferTmp + offset, (uint8_t*)uiBuffer + offset, (bottom - top) * sdlscrn->pitch);
 			updateUI = true;
 		}
 		SDL_AtomicUnlock(&uiBufferLock);
 
 		if(updateUI) {
-			SDL_UpdateTexture(uiTexture, NULL, uiBufferTmp, sdlscrn->pitch);
+			SDL_Rect rect = { 0, top, sdlscrn->w, bottom - top };
+			SDL_UpdateTexture(uiTexture, &rect, (uint8_t*)uiBufferTmp + offset, sdlscrn->pitch);
 		}
 
 		// Update and render UI texture
@@ -223,8 +621,10 @@ static int repainter(void* unused) {
 			// Render NeXT framebuffer texture
 			SDL_RenderCopy(sdlRenderer, fbTexture, NULL, &screenRect);
 			SDL_RenderCopy(sdlRenderer, uiTexture, NULL, &screenRect);
+			renderPanels();
 			// SDL_RenderPresent sleeps until next VSYNC because of SDL_RENDERER_PRESENTVSYNC in ScreenInit
 			SDL_RenderPresent(sdlRenderer);
+			frameCount++;
 		} else {
 			host_sleep_ms(10);
 		}
@@ -233,17 +633,34 @@ static int repainter(void* unused) {
 }
 #else // !ENABLE_RENDERING_THREAD
 void Screen_Repaint(void) {
+	static uint64_t lastFrame = 0;
 	bool updateFB = false;
 
+	if (!sdlRenderer || Screen_FrameWait(&lastFrame)) {
+		return;
+	}
+
 	// Blit the NeXT framebuffer to texture
 	if (bEmulationActive) {
+		uint64_t start = host_prof_now();
 		updateFB = blitScreen(fbTexture);
+		updateFB |= blitPanels();
+		host_prof_end(HOST_PROF_BLIT, start);
 	}
 
-	// Copy UI surface to texture
+	// Copy changed rows of UI surface to texture
 	if (SDL_AtomicSet(&blitUI, 0)) {
-		// update full UI texture
-		SDL_UpdateTexture(uiTexture, NULL, uiBuffer, sdlscrn->pitch);
+		int top, bottom;
+		SDL_Rect rect;
+
+		SDL_AtomicLock(&uiBufferLock);
+		uiTakeRows(&top, &bottom);
+		SDL_AtomicUnlock(&uiBufferLock);
+		rect.x = 0;
+		rect.y = top;
+		rect.w = sdlscrn->w;
+		rect.h = bottom - top;
+		SDL_UpdateTexture(uiTexture, &rect, (uint8_t*)uiBuffer + top * sdlscrn->pitch, sdlscrn->pitch);
 		updateFB = true;
 	}
 
@@ -252,7 +669,9 @@ void Screen_Repaint(void) {
 		// Render NeXT framebuffer texture
 		SDL_RenderCopy(sdlRenderer, fbTexture, NULL, &screenRect);
 		SDL_RenderCopy(sdlRenderer, uiTexture, NULL, &screenRect);
+		renderPanels();
 		SDL_RenderPresent(sdlRenderer);
+		frameCount++;
 	}
 }
 #endif // !ENABLE_RENDERING_THREAD
@@ -273,12 +692,10 @@ void Screen_Pause(bool pause) {
 
 /*-----------------------------------------------------------------------*/
 /**
- * Init Screen, creates window, renderer and textures
+ * Create main window, renderer and textures
  */
-void Screen_Init(void) {
-	uint32_t format;
-	uint32_t r, g, b, a;
-	int      d, i, n, x;
+static void Screen_CreateWindow(uint32_t format) {
+	int i, n, x;
 
 #ifdef ENABLE_RENDERING_THREAD
 	SDL_RendererFlags vsync_flag = SDL_RENDERER_PRESENTVSYNC;
@@ -286,29 +703,6 @@ void Screen_Init(void) {
 	uint32_t vsync_flag = 0;
 #endif
 
-	/* Set initial window resolution */
-	width  = NeXT_SCRN_WIDTH;
-	height = NeXT_SCRN_HEIGHT;
-	bInFullScreen = false;
-
-	/* Statusbar */
-	Statusbar_SetHeight(width, height);
-	statusBar.x = 0;
-	statusBar.y = height;
-	statusBar.w = width;
-	statusBar.h = Statusbar_GetHeight();
-	/* Grow to fit statusbar */
-	height += Statusbar_GetHeight();
-
-	/* Screen */
-	screenRect.x = 0;
-	screenRect.y = 0;
-	screenRect.h = height;
-	screenRect.w = width;
-
-	/* Set new video mode */
-	SDL_SetHint(SDL_HINT_RENDER_SCALE_QUALITY, "linear");
-
 	fprintf(stderr, "SDL screen request: %d x %d (%s)\n", width, height, bInFullScreen ? "fullscreen" : "windowed");
 
 	x = SDL_WINDOWPOS_UNDEFINED;
@@ -351,14 +745,110 @@ void Screen_Init(void) {
 
 	SDL_RenderSetLogicalSize(sdlRenderer, width, height);
 
-	format = SDL_PIXELFORMAT_BGRA32;
-
 	uiTexture = SDL_CreateTexture(sdlRenderer, format, SDL_TEXTUREACCESS_STREAMING, width, height);
 	SDL_SetTextureBlendMode(uiTexture, SDL_BLENDMODE_BLEND);
 
-	fbTexture = SDL_CreateTexture(sdlRenderer, format, SDL_TEXTUREACCESS_STREAMING, width, height);
+	fbTexture = SDL_CreateTexture(sdlRenderer, format, SDL_TEXTUREACCESS_STREAMING, width * prescale, height * prescale);
 	SDL_SetTextureBlendMode(fbTexture, SDL_BLENDMODE_NONE);
 
+	if (ConfigureParams.Screen.bNDInMainWindow) {
+		for (i = 0; i < ND_MAX_BOARDS; i++) {
+			ndPanel[i].tex = SDL_CreateTexture(sdlRenderer, format, SDL_TEXTUREACCESS_STREAMING, NeXT_SCRN_WIDTH, NeXT_SCRN_HEIGHT);
+			SDL_SetTextureBlendMode(ndPanel[i].tex, SDL_BLENDMODE_NONE);
+		}
+	}
+}
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Show the NeXTdimension screens next to the main screen if they are
+ * wanted there, else shrink the main window back to the main screen.
+ */
+static void Screen_SetPanels(void) {
+	float scale;
+	int   i, n = 0;
+
+	if (!sdlRenderer) {
+		return;
+	}
+	if (ndPanel[0].tex && ConfigureParams.Screen.nMonitorType == MONITOR_TYPE_DUAL && !bInFullScreen) {
+		for (i = 0; i < ND_MAX_BOARDS; i++) {
+			if (ConfigureParams.Dimension.board[i].bEnabled) {
+				ndPanel[n].board  = i;
+				ndPanel[n].full   = true;
+				ndPanel[n].lutGen = 0;
+				n++;
+			}
+		}
+	}
+	if (n == ndPanels) {
+		return;
+	}
+	ndPanels = n;
+
+	if (bInFullScreen) {
+		SDL_RenderSetLogicalSize(sdlRenderer, logicalWidth(), height);
+	} else {
+		SDL_RenderGetScale(sdlRenderer, &scale, &scale);
+		SDL_SetWindowSize(sdlWindow, logicalWidth()*scale*dpiFactor, height*scale*dpiFactor);
+		SDL_RenderSetLogicalSize(sdlRenderer, logicalWidth(), height);
+		SDL_RenderSetScale(sdlRenderer, scale, scale);
+	}
+
+	/* Make sure screen is painted in case emulation is paused */
+	SDL_AtomicSet(&blitUI, 1);
+}
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Return true if the NeXTdimension screens are shown in the main window.
+ */
+bool Screen_NDInMainWindow(void) {
+	return ndPanels > 0;
+}
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Init Screen, creates window, renderer and textures
+ */
+void Screen_Init(void) {
+	uint32_t format;
+	uint32_t r, g, b, a;
+	int      d, i;
+
+	/* Set initial window resolution */
+	prescale = ConfigureParams.Screen.nPrescale;
+	width  = NeXT_SCRN_WIDTH;
+	height = NeXT_SCRN_HEIGHT;
+	bInFullScreen = false;
+
+	/* Statusbar */
+	Statusbar_SetHeight(width, height);
+	statusBar.x = 0;
+	statusBar.y = height;
+	statusBar.w = width;
+	statusBar.h = Statusbar_GetHeight();
+	/* Grow to fit statusbar */
+	height += Statusbar_GetHeight();
+
+	/* Screen */
+	screenRect.x = 0;
+	screenRect.y = 0;
+	screenRect.h = height;
+	screenRect.w = width;
+
+	/* Set new video mode */
+	SDL_SetHint(SDL_HINT_RENDER_SCALE_QUALITY, "linear");
+
+	format = SDL_PIXELFORMAT_BGRA32;
+
+	if (ConfigureParams.Screen.bHeadless) {
+		fprintf(stderr, "SDL screen request: %d x %d (headless)\n", width, height);
+		dpiFactor = 1.0;
+	} else {
+		Screen_CreateWindow(format);
+	}
+
 	SDL_PixelFormatEnumToMasks(format, &d, &r, &g, &b, &a);
 
 	sdlscrn = SDL_CreateRGBSurface(SDL_SWSURFACE, width, height, d, r, g, b, a);
@@ -392,12 +882,18 @@ void Screen_Init(void) {
 		BW2RGB[i*4+2] = bw2rgb(pformat, i>>2);
 		BW2RGB[i*4+3] = bw2rgb(pformat, i>>0);
 	}
-	/* initialize color lookup table */
-	for (i = 0; i < 0x10000; i++)
-		COL2RGB[SDL_BYTEORDER == SDL_BIG_ENDIAN ? i : SDL_Swap16(i)] = col2rgb(pformat, i);
+	/* initialize color lookup tables */
+	colorTables();
 
 	SDL_FreeFormat(pformat);
 
+	/* Without a window there is nothing to paint, Grab_Screen reads VRAM directly */
+	if (ConfigureParams.Screen.bHeadless) {
+		return;
+	}
+
+	blitStartHelpers();
+
 #ifdef ENABLE_RENDERING_THREAD
 	/* Start repaint thread with framebuffer blit disabled */
 	SDL_AtomicSet(&blitFB, 0);
@@ -418,12 +914,22 @@ void Screen_Init(void) {
  * Free screen bitmap and allocated resources
  */
 void Screen_UnInit(void) {
+	if (!sdlWindow) {
+		nd_sdl_destroy();
+		return;
+	}
 #ifdef ENABLE_RENDERING_THREAD
 	doRepaint = false; // stop repaint thread
 	int s;
 	SDL_WaitThread(repaintThread, &s);
 #endif
 	nd_sdl_destroy();
+	blitStopHelpers();
+	for (int i = 0; i < ND_MAX_BOARDS; i++) {
+		if (ndPanel[i].tex) {
+			SDL_DestroyTexture(ndPanel[i].tex);
+		}
+	}
 	SDL_DestroyTexture(uiTexture);
 	SDL_DestroyTexture(fbTexture);
 	SDL_DestroyRenderer(sdlRenderer);
@@ -437,7 +943,7 @@ void Screen_UnInit(void) {
 void Screen_EnterFullScreen(void) {
 	bool bWasRunning;
 
-	if (!bInFullScreen) {
+	if (!bInFullScreen && sdlWindow) {
 		/* Hold things... */
 		bWasRunning = Main_PauseEmulation(false);
 		bInFullScreen = true;
@@ -508,7 +1014,7 @@ void Screen_ReturnFromFullScreen(void) {
  * Show main window
  */
 void Screen_ShowMainWindow(void) {
-	if (!bInFullScreen) {
+	if (!bInFullScreen && sdlWindow) {
 		SDL_RestoreWindow(sdlWindow);
 		SDL_RaiseWindow(sdlWindow);
 	}
@@ -521,9 +1027,9 @@ void Screen_ShowMainWindow(void) {
 void Screen_SizeChanged(void) {
 	float scale;
 
-	if (!bInFullScreen) {
+	if (!bInFullScreen && sdlRenderer) {
 		SDL_RenderGetScale(sdlRenderer, &scale, &scale);
-		SDL_SetWindowSize(sdlWindow, width*scale*dpiFactor, height*scale*dpiFactor);
+		SDL_SetWindowSize(sdlWindow, logicalWidth()*scale*dpiFactor, height*scale*dpiFactor);
 
 		nd_sdl_resize(scale*dpiFactor);
 	}
@@ -548,6 +1054,7 @@ void Screen_ModeChanged(void) {
 		saveMonitorType = ConfigureParams.Screen.nMonitorType;
 		ConfigureParams.Screen.nMonitorType = MONITOR_TYPE_CPU;
 	}
+	Screen_SetPanels();
 	if (ConfigureParams.Screen.nMonitorType == MONITOR_TYPE_DUAL && !bInFullScreen) {
 		nd_sdl_show();
 	} else {
@@ -571,13 +1078,18 @@ void Screen_StatusbarChanged(void) {
 	/* Get new heigt for our window */
 	height = NeXT_SCRN_HEIGHT + Statusbar_SetHeight(NeXT_SCRN_WIDTH, NeXT_SCRN_HEIGHT);
 
+	if (!sdlRenderer) {
+		/* headless */
+		return;
+	}
+
 	if (bInFullScreen) {
-		saveWindowBounds.h = (height * saveWindowBounds.w) / width;
-		SDL_RenderSetLogicalSize(sdlRenderer, width, height);
+		saveWindowBounds.h = (height * saveWindowBounds.w) / logicalWidth();
+		SDL_RenderSetLogicalSize(sdlRenderer, logicalWidth(), height);
 	} else {
 		SDL_RenderGetScale(sdlRenderer, &scale, &scale);
-		SDL_SetWindowSize(sdlWindow, width*scale*dpiFactor, height*scale*dpiFactor);
-		SDL_RenderSetLogicalSize(sdlRenderer, width, height);
+		SDL_SetWindowSize(sdlWindow, logicalWidth()*scale*dpiFactor, height*scale*dpiFactor);
+		SDL_RenderSetLogicalSize(sdlRenderer, logicalWidth(), height);
 		SDL_RenderSetScale(sdlRenderer, scale, scale);
 	}
 
@@ -590,10 +1102,23 @@ void Screen_StatusbarChanged(void) {
 /**
  * Draw screen to window/full-screen - (SC) Just status bar updates. Screen redraw is done in repaint thread.
  */
-static void statusBarUpdate(void) {
+/*
+ Copy the part of the statusbar covered by rect to uiBuffer.
+ */
+static void statusBarUpdate(const SDL_Rect* rect) {
+	int top    = rect->y > statusBar.y ? rect->y : statusBar.y;
+	int bottom = rect->y + rect->h < statusBar.y + statusBar.h ? rect->y + rect->h : statusBar.y + statusBar.h;
+	int left   = rect->x > 0 ? rect->x : 0;
+	int right  = rect->x + rect->w < sdlscrn->w ? rect->x + rect->w : sdlscrn->w;
+	if (top >= bottom || left >= right) return;
+
 	SDL_LockSurface(sdlscrn);
 	SDL_AtomicLock(&uiBufferLock);
-	memcpy(&((uint8_t*)uiBuffer)[statusBar.y*sdlscrn->pitch], &((uint8_t*)sdlscrn->pixels)[statusBar.y*sdlscrn->pitch], statusBar.h * sdlscrn->pitch);
+	for (int y = top; y < bottom; y++) {
+		int offset = y * sdlscrn->pitch + left * 4;
+		memcpy(&((uint8_t*)uiBuffer)[offset], &((uint8_t*)sdlscrn->pixels)[offset], (right - left) * 4);
+	}
+	uiMarkRows(top, bottom);
 	SDL_AtomicSet(&blitUI, 1);
 	SDL_AtomicUnlock(&uiBufferLock);
 	SDL_UnlockSurface(sdlscrn);
@@ -612,13 +1137,14 @@ static void uiUpdate(void) {
 	// poor man's green-screen - would be nice if SDL had more blending modes...
 	for(int i = count; --i >= 0; src++)
 		*dst++ = *src == mask ? 0 : *src;
+	uiMarkRows(0, sdlscrn->h);
 	SDL_AtomicSet(&blitUI, 1);
 	SDL_AtomicUnlock(&uiBufferLock);
 	SDL_UnlockSurface(sdlscrn);
 }
 
 void Screen_UpdateRects(SDL_Surface *screen, int numrects, SDL_Rect *rects) {
-	while(numrects--) {
+	for(; numrects > 0; numrects--, rects++) {
 		if(rects->y < NeXT_SCRN_HEIGHT) {
 			uiUpdate();
 			doUIblit = true;
@@ -627,7 +1153,7 @@ void Screen_UpdateRects(SDL_Surface *screen, int numrects, SDL_Rect *rects) {
 				uiUpdate();
 				doUIblit = false;
 			} else {
-				statusBarUpdate();
+				statusBarUpdate(rects);
 			}
 		}
 	}
@@ -9,6 +9,7 @@
 const char Scsi_fileid[] = "Previous scsi.c";
 
 #include "main.h"
+#include "host.h"
 #include "ioMem.h"
 #include "ioMemTables.h"
 #include "configuration.h"
@@ -17,6 +18,10 @@ const char Scsi_fileid[] = "Previous scsi.c";
 #include "statusbar.h"
 #include "scsi.h"
 #include "file.h"
+#include "diskcache.h"
+#include "overlay.h"
+
+#include <sys/stat.h>
 
 #define LOG_SCSI_LEVEL  LOG_DEBUG    /* Print debugging messages */
 
@@ -129,10 +134,189 @@ struct {
     uint32_t lastlba;
     
     int known;
-    uint8_t** shadow;
+    OVERLAY* overlay;
+    
+    /* Configuration and image file at insert, to keep it open on reset */
+    SCSIDISK config;
+    int writeprot;
+    bool mapped;
+    uint64_t fdev;
+    uint64_t fino;
+    uint64_t fsize;
 } SCSIdisk[ESP_MAX_DEVS];
 
 
+/* Sequential transfers are staged in a window of whole blocks, so the disk
+ * image is accessed with one File_Read or File_Write per window instead of
+ * one per block. Read windows only live for one command. Written blocks are
+ * collected until the window is full, the command ends or a new command
+ * arrives. */
+#define SCSI_WINDOW_SIZE    (64*1024)
+
+static struct {
+    uint8_t data[SCSI_WINDOW_SIZE];
+    uint8_t target;
+    uint32_t lba;       /* first block in data */
+    uint32_t count;     /* number of blocks read or waiting to be written */
+    bool write;         /* blocks are waiting to be written */
+} scsi_window;
+
+/* Disk images are accessed by a worker thread, so a slow host disk does
+ * not stall the emulation. The worker handles one window at a time in the
+ * order the windows are handed over. Written windows are written behind,
+ * sequential reads are followed by a read ahead of the next window. The
+ * m68k thread waits for the worker before it accesses an image itself. */
+static struct {
+    thread_t* thread;
+    SDL_sem* request;
+    SDL_sem* done;
+    atomic_int busy;    /* set while the worker executes a request */
+    bool pending;       /* a request has been issued and not been waited for */
+    bool deferred;      /* a read command waits for read ahead data */
+    bool quit;
+    bool valid;         /* data holds blocks that have been read ahead */
+    uint8_t data[SCSI_WINDOW_SIZE];
+    uint8_t target;
+    uint32_t lba;
+    uint32_t count;
+    bool write;
+} scsi_io;
+
+static void scsi_io_execute(void) {
+    uint8_t target = scsi_io.target;
+    uint32_t size = scsi_io.count*SCSIdisk[target].blocksize;
+    uint64_t offset = ((uint64_t)scsi_io.lba)*SCSIdisk[target].blocksize;
+    
+    if (scsi_io.write) {
+        DiskCache_Write(DISKCACHE_SCSI(target), scsi_io.data, size, offset, SCSIdisk[target].dsk);
+    } else {
+        scsi_io.valid = DiskCache_Read(DISKCACHE_SCSI(target), scsi_io.data, size, offset, SCSIdisk[target].dsk);
+    }
+}
+
+static int scsi_io_thread(void* arg) {
+    for (;;) {
+        SDL_SemWait(scsi_io.request);
+        if (scsi_io.quit) {
+            break;
+        }
+        scsi_io_execute();
+        host_atomic_set(&scsi_io.busy, 0);
+        SDL_SemPost(scsi_io.done);
+    }
+    return 0;
+}
+
+/* Wait until the worker has finished the last request */
+static void scsi_io_wait(void) {
+    if (scsi_io.pending) {
+        SDL_SemWait(scsi_io.done);
+        scsi_io.pending = false;
+    }
+}
+
+static bool scsi_io_ready(void) {
+    return !scsi_io.pending || host_atomic_get(&scsi_io.busy) == 0;
+}
+
+/* Hand the window in scsi_io.data over to the worker */
+static void scsi_io_submit(uint8_t target, uint32_t lba, uint32_t count, bool write) {
+    scsi_io.target = target;
+    scsi_io.lba = lba;
+    scsi_io.count = count;
+    scsi_io.write = write;
+    scsi_io.valid = false;
+    
+    if (!scsi_io.thread) {
+        scsi_io.request = SDL_CreateSemaphore(0);
+        scsi_io.done = SDL_CreateSemaphore(0);
+        scsi_io.quit = false;
+        scsi_io.thread = host_thread_create(scsi_io_thread, "SCSIThread", NULL);
+    }
+    if (scsi_io.thread) {
+        host_atomic_set(&scsi_io.busy, 1);
+        scsi_io.pending = true;
+        SDL_SemPost(scsi_io.request);
+    } else {
+        scsi_io_execute();
+    }
+}
+
+/* Return true if the worker reads or has read ahead the given block */
+static bool scsi_io_has(uint8_t target, uint32_t lba) {
+    return !scsi_io.write && scsi_io.count && scsi_io.target == target &&
+           lba - scsi_io.lba < scsi_io.count && (scsi_io.pending || scsi_io.valid);
+}
+
+/* Wait for the worker and forget read ahead data of a target */
+static void scsi_io_drop(uint8_t target) {
+    scsi_io_wait();
+    if (scsi_io.target == target) {
+        scsi_io.count = 0;
+        scsi_io.valid = false;
+    }
+}
+
+static void scsi_io_stop(void) {
+    scsi_io_wait();
+    if (scsi_io.thread) {
+        scsi_io.quit = true;
+        SDL_SemPost(scsi_io.request);
+        host_thread_wait(scsi_io.thread);
+        scsi_io.thread = NULL;
+        SDL_DestroySemaphore(scsi_io.request);
+        SDL_DestroySemaphore(scsi_io.done);
+    }
+}
+
+static void scsi_window_flush(void) {
+    uint8_t target = scsi_window.target;
+    
+    if (scsi_window.write && scsi_window.count) {
+        Log_Printf(LOG_SCSI_LEVEL, "[SCSI] Writing %i blocks at offset %i.", scsi_window.count, scsi_window.lba);
+        scsi_io_wait();
+        memcpy(scsi_io.data, scsi_window.data, scsi_window.count*SCSIdisk[target].blocksize);
+        scsi_io_submit(target, scsi_window.lba, scsi_window.count, true);
+    }
+    scsi_window.count = 0;
+    scsi_window.write = false;
+}
+
+/* Move read ahead data to the window if it holds the given block */
+static bool scsi_window_take(uint8_t target, uint32_t lba) {
+    if (!scsi_io_has(target, lba)) {
+        return false;
+    }
+    scsi_io_wait();
+    if (!scsi_io.valid) {
+        return false;
+    }
+    memcpy(scsi_window.data, scsi_io.data, scsi_io.count*SCSIdisk[target].blocksize);
+    scsi_window.target = target;
+    scsi_window.lba = scsi_io.lba;
+    scsi_window.count = scsi_io.count;
+    scsi_window.write = false;
+    scsi_io.count = 0;
+    scsi_io.valid = false;
+    return true;
+}
+
+/* Read the window after the current one, if the disk is read sequentially */
+static void scsi_window_read_ahead(uint8_t target, bool sequential) {
+    uint32_t next = scsi_window.lba + scsi_window.count;
+    uint32_t count = SCSI_WINDOW_SIZE / SCSIdisk[target].blocksize;
+    uint64_t blocks = SCSIdisk[target].size / SCSIdisk[target].blocksize;
+    
+    if (next >= blocks || (!sequential && next - SCSIdisk[target].lba >= SCSIdisk[target].blockcounter)) {
+        return;
+    }
+    if (count > blocks - next) count = blocks - next;
+    
+    scsi_io_wait();
+    scsi_io_submit(target, next, count, false);
+}
+
+
 /* INQUIRY response data */
 #define DEVTYPE_DISK        0x00    /* read/write disks */
 #define DEVTYPE_TAPE        0x01    /* tapes and other sequential devices */
@@ -286,6 +470,11 @@ static int64_t SCSI_GetTime(uint8_t target) {
     int64_t seektime, sectortime;
     int64_t seekoffset, disksize, sectors;
     
+    /* Complete as soon as the DMA can take the data */
+    if (ConfigureParams.System.nIOTiming == IO_TIMING_INSTANT) {
+        return 0;
+    }
+    
     switch (SCSIdisk[target].devtype) {
         case SD_HARDDISK:
             seektime = SCSI_SEEK_TIME_HD;
@@ -491,18 +680,22 @@ static void scsi_write_sector(void) {
     
     if (offset < SCSIdisk[target].size) {
         if (ConfigureParams.SCSI.nWriteProtection != WRITEPROT_ON) {
-            File_Write(scsi_buffer.data, SCSIdisk[target].blocksize, offset, SCSIdisk[target].dsk);
+            if (scsi_window.count == 0) {
+                scsi_window.target = target;
+                scsi_window.lba = SCSIdisk[target].lba;
+                scsi_window.write = true;
+            }
+            memcpy(scsi_window.data + scsi_window.count*SCSIdisk[target].blocksize, scsi_buffer.data, SCSIdisk[target].blocksize);
+            scsi_window.count++;
+            if (SCSIdisk[target].blockcounter == 1 ||
+                (scsi_window.count+1)*SCSIdisk[target].blocksize > SCSI_WINDOW_SIZE) {
+                scsi_window_flush();
+            }
         } else {
             Log_Printf(LOG_SCSI_LEVEL, "[SCSI] WARNING: File write disabled!");
-            if(SCSIdisk[target].shadow) {
-                if(!(SCSIdisk[target].shadow[SCSIdisk[target].lba]))
-                    SCSIdisk[target].shadow[SCSIdisk[target].lba] = malloc(SCSIdisk[target].blocksize);
-                memcpy(SCSIdisk[target].shadow[SCSIdisk[target].lba], scsi_buffer.data, SCSIdisk[target].blocksize);
-            } else {
-                uint32_t blocks = SCSIdisk[target].size / SCSIdisk[target].blocksize;
-                SCSIdisk[target].shadow = malloc(sizeof(uint8_t*) * blocks);
-                for(int i = blocks; --i >= 0;)
-                    SCSIdisk[target].shadow[i] = NULL;
+            if (!SCSIdisk[target].overlay ||
+                !Overlay_Write(SCSIdisk[target].overlay, SCSIdisk[target].lba, scsi_buffer.data)) {
+                Log_Printf(LOG_WARN, "[SCSI] Block %i lost, no overlay.", SCSIdisk[target].lba);
             }
         }
         scsi_buffer.size = 0;
@@ -514,6 +707,8 @@ static void scsi_write_sector(void) {
             SCSIbus.phase = PHASE_ST;
         }
     } else {
+        scsi_window_flush();
+        
         SCSIdisk[target].status = STAT_CHECK_COND;
         SCSIdisk[target].sense.key = SK_ILLEGAL_REQ;
         SCSIdisk[target].sense.code = SC_INVALID_LBA;
@@ -570,10 +765,39 @@ static void scsi_read_sector(void) {
     offset = ((uint64_t)SCSIdisk[target].lba)*SCSIdisk[target].blocksize;
     
     if (offset < SCSIdisk[target].size) {
-        if (SCSIdisk[target].shadow && SCSIdisk[target].shadow[SCSIdisk[target].lba]) {
-            memcpy(scsi_buffer.data, SCSIdisk[target].shadow[SCSIdisk[target].lba], SCSIdisk[target].blocksize);
+        if (SCSIdisk[target].overlay && Overlay_Read(SCSIdisk[target].overlay, SCSIdisk[target].lba, scsi_buffer.data)) {
+            /* Block has been written to the overlay */
         } else {
-            File_Read(scsi_buffer.data, SCSIdisk[target].blocksize, offset, SCSIdisk[target].dsk);
+            if (scsi_window.count == 0 || scsi_window.target != target ||
+                SCSIdisk[target].lba - scsi_window.lba >= scsi_window.count) {
+                if (scsi_window_take(target, SCSIdisk[target].lba)) {
+                    /* Data has been read ahead, continue with the next window */
+                    scsi_window_read_ahead(target, true);
+                } else {
+                    /* Read as much of the remaining transfer as fits */
+                    uint32_t count = SCSI_WINDOW_SIZE / SCSIdisk[target].blocksize;
+                    uint64_t left  = (SCSIdisk[target].size - offset) / SCSIdisk[target].blocksize;
+                    
+                    if (count > SCSIdisk[target].blockcounter) count = SCSIdisk[target].blockcounter;
+                    if (count > left) count = left;
+                    if (count == 0) count = 1;
+                    
+                    scsi_io_drop(target);
+                    scsi_window.target = target;
+                    scsi_window.lba = SCSIdisk[target].lba;
+                    scsi_window.count = count;
+                    if (!DiskCache_Read(DISKCACHE_SCSI(target), scsi_window.data, count*SCSIdisk[target].blocksize, offset, SCSIdisk[target].dsk)) {
+                        scsi_window.count = 0;
+                    } else {
+                        scsi_window_read_ahead(target, SCSIdisk[target].lba == SCSIdisk[target].lastlba);
+                    }
+                }
+            }
+            if (scsi_window.count) {
+                memcpy(scsi_buffer.data, scsi_window.data + (SCSIdisk[target].lba - scsi_window.lba)*SCSIdisk[target].blocksize, SCSIdisk[target].blocksize);
+            } else {
+                DiskCache_Read(DISKCACHE_SCSI(target), scsi_buffer.data, SCSIdisk[target].blocksize, offset, SCSIdisk[target].dsk);
+            }
         }
         scsi_buffer.size = scsi_buffer.limit = SCSIdisk[target].blocksize;
         
@@ -609,6 +833,11 @@ static void SCSI_ReadSector(uint8_t *cdb) {
     Log_Printf(LOG_SCSI_LEVEL, "[SCSI] Read sector: %i block(s) at offset %i (blocksize: %i byte)",
                SCSIdisk[target].blockcounter, SCSIdisk[target].lba, SCSIdisk[target].blocksize);
     
+    if (SCSIdisk[target].blockcounter && !scsi_io_ready() && scsi_io_has(target, SCSIdisk[target].lba)) {
+        /* Let the transfer wait until the data has been read ahead */
+        scsi_io.deferred = true;
+        return;
+    }
     scsi_read_sector();
 }
 
@@ -916,6 +1145,10 @@ static void SCSI_Command(uint8_t *cdb) {
     uint8_t opcode = cdb[0];
     uint8_t target = SCSIbus.target;
     
+    /* Finish writes of an interrupted transfer, drop read ahead data */
+    scsi_window_flush();
+    scsi_io.deferred = false;
+    
     /* First check for lun-independent commands */
     switch (opcode) {
         case CMD_INQUIRY:
@@ -1034,10 +1267,21 @@ void SCSIdisk_Receive_Data(uint8_t val) {
     }
 }
 
-uint8_t SCSIdisk_Send_Data(void) {
-    /* Send one byte. If the transfer is complete, set status phase */
-    uint8_t val=scsi_buffer.data[scsi_buffer.limit-scsi_buffer.size];
-    scsi_buffer.size--;
+bool SCSIdisk_Busy(void) {
+    /* Check if a deferred read still waits for the worker */
+    if (scsi_io.deferred) {
+        if (!scsi_io_ready()) {
+            return true;
+        }
+        scsi_io.deferred = false;
+        scsi_read_sector();
+    }
+    return false;
+}
+
+/* Load the next block if the buffer has been sent. If the transfer is
+ * complete, set status phase */
+static void scsi_send_next(void) {
     if (scsi_buffer.size==0) {
         if (scsi_buffer.disk==true) {
             scsi_read_sector(); /* sets status phase if done or error */
@@ -1045,9 +1289,36 @@ uint8_t SCSIdisk_Send_Data(void) {
             SCSIbus.phase = PHASE_ST;
         }
     }
+}
+
+uint8_t SCSIdisk_Send_Data(void) {
+    if (scsi_io.deferred) {
+        scsi_io.deferred = false;
+        scsi_read_sector(); /* waits for the worker */
+    }
+    /* Send one byte */
+    uint8_t val=scsi_buffer.data[scsi_buffer.limit-scsi_buffer.size];
+    scsi_buffer.size--;
+    scsi_send_next();
     return val;
 }
 
+/* Burst transfers: return the data that is left in the buffer, which
+ * is then sent with SCSIdisk_Send_Span */
+uint8_t* SCSIdisk_Send_Span(int* size) {
+    if (scsi_io.deferred) {
+        scsi_io.deferred = false;
+        scsi_read_sector(); /* waits for the worker */
+    }
+    *size = (SCSIbus.phase == PHASE_DI) ? scsi_buffer.size : 0;
+    return scsi_buffer.data + scsi_buffer.limit - scsi_buffer.size;
+}
+
+void SCSIdisk_Send_Consume(int size) {
+    scsi_buffer.size -= size;
+    scsi_send_next();
+}
+
 uint8_t SCSIdisk_Send_Status(void) {
     SCSIbus.phase = PHASE_MI;
     return SCSIdisk[SCSIbus.target].status;
@@ -1087,6 +1358,49 @@ int64_t SCSIdisk_Time(void) {
 }
 
 
+/* Remember the configuration and the image file of an inserted disk */
+static void SCSI_Fingerprint(uint8_t i) {
+    struct stat st;
+    
+    SCSIdisk[i].config    = ConfigureParams.SCSI.target[i];
+    SCSIdisk[i].writeprot = ConfigureParams.SCSI.nWriteProtection;
+    SCSIdisk[i].mapped    = ConfigureParams.System.bMapDiskImages;
+    if (stat(ConfigureParams.SCSI.target[i].szImageName, &st) == 0) {
+        SCSIdisk[i].fdev  = st.st_dev;
+        SCSIdisk[i].fino  = st.st_ino;
+        SCSIdisk[i].fsize = st.st_size;
+    } else {
+        SCSIdisk[i].fsize = 0;
+    }
+}
+
+/* Check if an open disk still has the same configuration and image file.
+ * The file is identified by device, inode and size, so a replaced or
+ * resized image is opened again. */
+static bool SCSI_Unchanged(uint8_t i) {
+    struct stat st;
+    
+    if (SCSIdisk[i].dsk == NULL ||
+        memcmp(&SCSIdisk[i].config, &ConfigureParams.SCSI.target[i], sizeof(SCSIDISK)) ||
+        SCSIdisk[i].writeprot != ConfigureParams.SCSI.nWriteProtection ||
+        SCSIdisk[i].mapped != ConfigureParams.System.bMapDiskImages) {
+        return false;
+    }
+    return stat(ConfigureParams.SCSI.target[i].szImageName, &st) == 0 &&
+           (uint64_t)st.st_dev == SCSIdisk[i].fdev &&
+           (uint64_t)st.st_ino == SCSIdisk[i].fino &&
+           (uint64_t)st.st_size == SCSIdisk[i].fsize;
+}
+
+/* Reset the command state of a disk */
+static void SCSI_ResetState(uint8_t i) {
+    SCSIdisk[i].lun = SCSIdisk[i].status = SCSIdisk[i].message = 0;
+    SCSIdisk[i].sense.code = SCSIdisk[i].sense.key = SCSIdisk[i].sense.info = 0;
+    SCSIdisk[i].sense.valid = false;
+    SCSIdisk[i].lba = SCSIdisk[i].lastlba = SCSIdisk[i].blockcounter = 0;
+}
+
+
 /* Insert/Eject SCSI disks */
 void SCSI_Insert(uint8_t i) {
     SCSIdisk[i].devtype = ConfigureParams.SCSI.target[i].nDeviceType;
@@ -1094,14 +1408,11 @@ void SCSI_Insert(uint8_t i) {
         ConfigureParams.SCSI.target[i].bDiskInserted = true;
     }
     
-    SCSIdisk[i].lun = SCSIdisk[i].status = SCSIdisk[i].message = 0;
-    SCSIdisk[i].sense.code = SCSIdisk[i].sense.key = SCSIdisk[i].sense.info = 0;
-    SCSIdisk[i].sense.valid = false;
-    SCSIdisk[i].lba = SCSIdisk[i].lastlba = SCSIdisk[i].blockcounter = 0;
+    SCSI_ResetState(i);
     SCSIdisk[i].blocksize = SCSI_BLOCKSIZE;
     SCSIdisk[i].known = -1;
     
-    SCSIdisk[i].shadow = NULL;
+    SCSIdisk[i].overlay = NULL;
     
     if (SCSIdisk[i].devtype != SD_NONE && ConfigureParams.SCSI.target[i].bDiskInserted) {
         Log_Printf(LOG_WARN, "SCSI disk %i: Insert %s", i, ConfigureParams.SCSI.target[i].szImageName);
@@ -1127,27 +1438,71 @@ void SCSI_Insert(uint8_t i) {
                 SCSIdisk[i].devtype = SD_NONE;
             }
             Statusbar_AddMessage("Cannot open SCSI disk", 0);
+        } else {
+            if (File_OpenCompressed(SCSIdisk[i].dsk)) {
+                /* Compressed images can only be written through an overlay */
+                Log_Printf(LOG_WARN, "SCSI disk %i: Compressed image", i);
+                SCSIdisk[i].readonly = (ConfigureParams.SCSI.nWriteProtection != WRITEPROT_ON) ||
+                                       ConfigureParams.SCSI.target[i].bWriteProtected;
+            } else if (ConfigureParams.System.bMapDiskImages) {
+                File_Map(SCSIdisk[i].dsk, !SCSIdisk[i].readonly);
+            }
+            if (ConfigureParams.SCSI.nWriteProtection == WRITEPROT_ON) {
+                SCSIdisk[i].overlay = Overlay_Open(ConfigureParams.SCSI.target[i].szOverlayName,
+                                                   SCSIdisk[i].blocksize, SCSIdisk[i].size / SCSIdisk[i].blocksize);
+            }
+            SCSI_Fingerprint(i);
         }
     }
 }
 
 void SCSI_Eject(uint8_t i) {    
+    if (scsi_window.target == i) {
+        scsi_window_flush();
+    }
+    scsi_io_drop(i);
+    if (SCSIbus.target == i) {
+        scsi_io.deferred = false;
+    }
+    DiskCache_Drop(DISKCACHE_SCSI(i));
+    SCSIdisk[i].overlay = Overlay_Close(SCSIdisk[i].overlay);
     SCSIdisk[i].dsk = File_Close(SCSIdisk[i].dsk);
     SCSIdisk[i].size = 0;
     SCSIdisk[i].readonly = false;
 }
 
 
-/* Initialize/Uninitialize SCSI disks */
-static void SCSI_Init(void) {
-    Log_Printf(LOG_WARN, "Loading SCSI disks:");
-    
-    int i;
-    for (i = 0; i < ESP_MAX_DEVS; i++) {
-        SCSI_Insert(i);
+/* Commit or discard the overlay of a write protected disk */
+bool SCSI_OverlayCommit(uint8_t i) {
+    if (!SCSIdisk[i].overlay) {
+        return false;
+    }
+    if (SCSIdisk[i].readonly) {
+        Log_Printf(LOG_WARN, "SCSI disk %i: Cannot commit overlay, image is read-only", i);
+        return false;
+    }
+    Log_Printf(LOG_WARN, "SCSI disk %i: Committing %u blocks to %s", i,
+               Overlay_Count(SCSIdisk[i].overlay), ConfigureParams.SCSI.target[i].szImageName);
+    scsi_io_drop(i);
+    DiskCache_Drop(DISKCACHE_SCSI(i));
+    return Overlay_Commit(SCSIdisk[i].overlay, SCSIdisk[i].dsk);
+}
+
+bool SCSI_OverlayDiscard(uint8_t i) {
+    if (!SCSIdisk[i].overlay) {
+        return false;
     }
+    Log_Printf(LOG_WARN, "SCSI disk %i: Discarding %u blocks", i, Overlay_Count(SCSIdisk[i].overlay));
+    Overlay_Discard(SCSIdisk[i].overlay);
+    return true;
 }
 
+int SCSI_OverlayCount(uint8_t i) {
+    return SCSIdisk[i].overlay ? (int)Overlay_Count(SCSIdisk[i].overlay) : -1;
+}
+
+
+/* Uninitialize SCSI disks */
 static void SCSI_Uninit(void) {
     int i;
     for (i = 0; i < ESP_MAX_DEVS; i++) {
@@ -1155,7 +1510,35 @@ static void SCSI_Uninit(void) {
     }
 }
 
+/* Disks whose configuration and image file did not change stay open, only
+ * their pending data is written and their command state is reset. A
+ * temporary overlay is emptied, as if the disk had been opened again. */
 void SCSI_Reset(void) {
+    Log_Printf(LOG_WARN, "Loading SCSI disks:");
+    
+    int i;
+    for (i = 0; i < ESP_MAX_DEVS; i++) {
+        if (SCSI_Unchanged(i)) {
+            if (scsi_window.target == i) {
+                scsi_window_flush();
+            }
+            scsi_io_drop(i);
+            if (SCSIbus.target == i) {
+                scsi_io.deferred = false;
+            }
+            if (SCSIdisk[i].overlay && !ConfigureParams.SCSI.target[i].szOverlayName[0]) {
+                Overlay_Discard(SCSIdisk[i].overlay);
+            }
+            SCSI_ResetState(i);
+        } else {
+            SCSI_Eject(i);
+            SCSI_Insert(i);
+        }
+    }
+}
+
+/* Write back pending data and stop the disk I/O thread */
+void SCSI_Exit(void) {
     SCSI_Uninit();
-    SCSI_Init();
+    scsi_io_stop();
 }
@@ -0,0 +1,426 @@
+/*
+  Previous - serial.c
+
+  This file is distributed under the GNU General Public License, version 2
+  or at your option any later version. Read the file gpl.txt for details.
+
+  Host side of one SCC channel. The channel is bridged to a pseudo
+  terminal or to a TCP socket on the loopback interface, which accepts
+  one client at a time. A host thread moves data between the descriptor
+  and two byte rings, so the emulation never blocks on the host. Bytes
+  the guest sends while nobody is connected are discarded, like on a
+  serial line without a cable.
+*/
+const char Serial_fileid[] = "Previous serial.c";
+
+/* For posix_openpt() and friends, needs to come before any system header */
+#define _GNU_SOURCE
+
+#include "main.h"
+#include "configuration.h"
+#include "host.h"
+#include "log.h"
+#include "serial.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <termios.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+#define LOG_SERIAL_LEVEL    LOG_DEBUG
+
+#define SERIAL_RING_SIZE    65536   /* Must be a power of 2 */
+#define SERIAL_IDLE_US      10000
+
+typedef struct {
+	atomic_int head;    /* Next byte to fill, written by the producer */
+	atomic_int tail;    /* Next byte to read, written by the consumer */
+	uint8_t    data[SERIAL_RING_SIZE];
+} SERIAL_RING;
+
+#define SERIAL_USED(r) ((uint32_t)host_atomic_get(&(r)->head) - (uint32_t)host_atomic_get(&(r)->tail))
+#define SERIAL_FREE(r) (SERIAL_RING_SIZE - SERIAL_USED(r))
+
+static SERIAL_RING *rx_ring;    /* host to guest */
+static SERIAL_RING *tx_ring;    /* guest to host */
+
+static CNF_SERIAL serial_cnf;   /* Settings the bridge was started with */
+static atomic_int serial_started;
+static thread_t  *serial_thread;
+static int        serial_fd = -1;   /* PTY master or connected client */
+static int        listen_fd = -1;
+static int        wake_fd[2] = { -1, -1 };
+static uint32_t   serial_dropped;
+
+
+/* Copy up to len bytes into a ring, returns the number of bytes copied */
+static int ring_put(SERIAL_RING *r, const uint8_t *buf, int len)
+{
+	uint32_t head = host_atomic_get(&r->head);
+	int i;
+
+	if ((uint32_t)len > SERIAL_FREE(r)) {
+		len = SERIAL_FREE(r);
+	}
+	for (i = 0; i < len; i++) {
+		r->data[(head + i) & (SERIAL_RING_SIZE - 1)] = buf[i];
+	}
+	/* Publish the bytes after their data */
+	host_atomic_set(&r->head, (int)(head + len));
+	return len;
+}
+
+/* Copy up to len bytes out of a ring, returns the number of bytes copied */
+static int ring_get(SERIAL_RING *r, uint8_t *buf, int len)
+{
+	uint32_t tail = host_atomic_get(&r->tail);
+	int i;
+
+	if ((uint32_t)len > SERIAL_USED(r)) {
+		len = SERIAL_USED(r);
+	}
+	for (i = 0; i < len; i++) {
+		buf[i] = r->data[(tail + i) & (SERIAL_RING_SIZE - 1)];
+	}
+	host_atomic_set(&r->tail, (int)(tail + len));
+	return len;
+}
+
+/* Drop everything the guest has sent so far */
+static void ring_discard(SERIAL_RING *r)
+{
+	host_atomic_set(&r->tail, host_atomic_get(&r->head));
+}
+
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Open a pseudo terminal in raw mode. The slave name is logged and linked
+ * to szPtyLink if one is configured.
+ */
+static int serial_open_pty(void)
+{
+	struct termios tio;
+	const char *name;
+	int fd = posix_openpt(O_RDWR | O_NOCTTY);
+
+	if (fd < 0) {
+		Log_Printf(LOG_WARN, "[Serial] Error: Couldn't open pseudo terminal: %s", strerror(errno));
+		return -1;
+	}
+	if (grantpt(fd) < 0 || unlockpt(fd) < 0 || !(name = ptsname(fd))) {
+		Log_Printf(LOG_WARN, "[Serial] Error: Couldn't unlock pseudo terminal: %s", strerror(errno));
+		close(fd);
+		return -1;
+	}
+	if (tcgetattr(fd, &tio) == 0) {
+		cfmakeraw(&tio);
+		tcsetattr(fd, TCSANOW, &tio);
+	}
+	fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+	Log_Printf(LOG_WARN, "[Serial] Channel %c on %s", serial_cnf.nChannel ? 'B' : 'A', name);
+	if (serial_cnf.szPtyLink[0]) {
+		unlink(serial_cnf.szPtyLink);
+		if (symlink(name, serial_cnf.szPtyLink) < 0) {
+			Log_Printf(LOG_WARN, "[Serial] Error: Couldn't link %s: %s", serial_cnf.szPtyLink, strerror(errno));
+		}
+	}
+	return fd;
+}
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Listen on the loopback interface for a client.
+ */
+static int serial_open_tcp(void)
+{
+	struct sockaddr_in addr;
+	int on = 1;
+	int fd = socket(AF_INET, SOCK_STREAM, 0);
+
+	if (fd < 0) {
+		Log_Printf(LOG_WARN, "[Serial] Error: Couldn't create socket: %s", strerror(errno));
+		return -1;
+	}
+	setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family      = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	addr.sin_port        = htons(serial_cnf.nTcpPort);
+
+	if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(fd, 1) < 0) {
+		Log_Printf(LOG_WARN, "[Serial] Error: Couldn't listen on port %d: %s", serial_cnf.nTcpPort, strerror(errno));
+		close(fd);
+		return -1;
+	}
+	fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+	Log_Printf(LOG_WARN, "[Serial] Channel %c on TCP port %d", serial_cnf.nChannel ? 'B' : 'A', serial_cnf.nTcpPort);
+	return fd;
+}
+
+/* Take a waiting client, if there is one */
+static void serial_accept(void)
+{
+	int on = 1;
+	int fd = accept(listen_fd, NULL, NULL);
+
+	if (fd >= 0) {
+		fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+		setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+		ring_discard(tx_ring);
+		serial_fd = fd;
+		Log_Printf(LOG_WARN, "[Serial] Client connected");
+	}
+}
+
+/* The peer is gone. A TCP client is closed, a PTY stays open for the next one. */
+static void serial_hangup(void)
+{
+	ring_discard(tx_ring);
+	if (serial_cnf.nHost == SERIAL_TCP) {
+		Log_Printf(LOG_WARN, "[Serial] Client disconnected");
+		close(serial_fd);
+		serial_fd = -1;
+	} else {
+		/* Reads fail until a slave is opened, don't spin */
+		host_sleep_us(SERIAL_IDLE_US);
+	}
+}
+
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Move bytes between the descriptor and the rings. Waits in select() for
+ * data from the host, for room to send and for the wake pipe, which is
+ * written when the guest sends into an empty ring.
+ */
+static int serial_func(void *arg)
+{
+	uint8_t buf[4096];
+	fd_set rfds, wfds;
+	struct timeval tv;
+	ssize_t len;
+	uint32_t tail;
+	int maxfd;
+
+	while (host_atomic_get(&serial_started)) {
+		FD_ZERO(&rfds);
+		FD_ZERO(&wfds);
+		FD_SET(wake_fd[0], &rfds);
+		maxfd = wake_fd[0];
+		if (serial_fd < 0) {
+			FD_SET(listen_fd, &rfds);
+			maxfd = listen_fd > maxfd ? listen_fd : maxfd;
+		} else {
+			if (SERIAL_FREE(rx_ring) > 0) {
+				FD_SET(serial_fd, &rfds);
+			}
+			if (SERIAL_USED(tx_ring) > 0) {
+				FD_SET(serial_fd, &wfds);
+			}
+			maxfd = serial_fd > maxfd ? serial_fd : maxfd;
+		}
+		tv.tv_sec  = 0;
+		tv.tv_usec = SERIAL_IDLE_US;
+		if (select(maxfd + 1, &rfds, &wfds, NULL, &tv) <= 0) {
+			continue;
+		}
+
+		if (FD_ISSET(wake_fd[0], &rfds)) {
+			while (read(wake_fd[0], buf, sizeof(buf)) > 0) {}
+		}
+		if (serial_fd < 0) {
+			if (FD_ISSET(listen_fd, &rfds)) {
+				serial_accept();
+			} else {
+				ring_discard(tx_ring);
+			}
+			continue;
+		}
+
+		if (FD_ISSET(serial_fd, &rfds)) {
+			len = read(serial_fd, buf, SERIAL_FREE(rx_ring) < sizeof(buf) ? SERIAL_FREE(rx_ring) : sizeof(buf));
+			if (len > 0) {
+				ring_put(rx_ring, buf, (int)len);
+				Log_Printf(LOG_SERIAL_LEVEL, "[Serial] Received %d bytes", (int)len);
+			} else if (len == 0 || (errno != EAGAIN && errno != EINTR)) {
+				serial_hangup();
+				continue;
+			}
+		}
+		if (FD_ISSET(serial_fd, &wfds)) {
+			/* Write the contiguous part, the rest follows in the next round */
+			tail = host_atomic_get(&tx_ring->tail) & (SERIAL_RING_SIZE - 1);
+			len  = SERIAL_USED(tx_ring);
+			if (len > SERIAL_RING_SIZE - tail) {
+				len = SERIAL_RING_SIZE - tail;
+			}
+			len = write(serial_fd, &tx_ring->data[tail], len);
+			if (len > 0) {
+				host_atomic_add(&tx_ring->tail, (int)len);
+			} else if (len < 0 && errno != EAGAIN && errno != EINTR) {
+				serial_hangup();
+			}
+		}
+	}
+	return 0;
+}
+
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Stop the bridge and close all descriptors.
+ */
+void Serial_Stop(void)
+{
+	if (host_atomic_get(&serial_started)) {
+		Log_Printf(LOG_WARN, "Stopping serial bridge");
+		host_atomic_set(&serial_started, 0);
+		host_thread_wait(serial_thread);
+
+		if (serial_fd >= 0) {
+			close(serial_fd);
+		}
+		if (listen_fd >= 0) {
+			close(listen_fd);
+		}
+		close(wake_fd[0]);
+		close(wake_fd[1]);
+		serial_fd = listen_fd = wake_fd[0] = wake_fd[1] = -1;
+		if (serial_cnf.nHost == SERIAL_PTY && serial_cnf.szPtyLink[0]) {
+			unlink(serial_cnf.szPtyLink);
+		}
+		free(rx_ring);
+		free(tx_ring);
+		rx_ring = tx_ring = NULL;
+	}
+}
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Start the bridge as configured. A running bridge is kept across guest
+ * resets, so connected clients stay connected, unless the settings have
+ * changed. Buffered input is dropped either way.
+ */
+void Serial_Reset(void)
+{
+	CNF_SERIAL *cnf = &ConfigureParams.Serial;
+
+	if (host_atomic_get(&serial_started)) {
+		if (cnf->nHost == serial_cnf.nHost && cnf->nTcpPort == serial_cnf.nTcpPort &&
+		    !strcmp(cnf->szPtyLink, serial_cnf.szPtyLink)) {
+			serial_cnf = *cnf;
+			host_atomic_set(&rx_ring->tail, host_atomic_get(&rx_ring->head));
+			return;
+		}
+		Serial_Stop();
+	}
+	serial_cnf = *cnf;
+	if (serial_cnf.nHost == SERIAL_NONE) {
+		return;
+	}
+
+	rx_ring = calloc(1, sizeof(SERIAL_RING));
+	tx_ring = calloc(1, sizeof(SERIAL_RING));
+	if (!rx_ring || !tx_ring || pipe(wake_fd) < 0) {
+		Log_Printf(LOG_WARN, "[Serial] Error: Cannot allocate buffers");
+		goto fail;
+	}
+	fcntl(wake_fd[0], F_SETFL, fcntl(wake_fd[0], F_GETFL) | O_NONBLOCK);
+	fcntl(wake_fd[1], F_SETFL, fcntl(wake_fd[1], F_GETFL) | O_NONBLOCK);
+
+	if (serial_cnf.nHost == SERIAL_PTY) {
+		if ((serial_fd = serial_open_pty()) < 0) {
+			goto fail;
+		}
+	} else {
+		if ((listen_fd = serial_open_tcp()) < 0) {
+			goto fail;
+		}
+	}
+	serial_dropped = 0;
+	host_atomic_set(&serial_started, 1);
+	serial_thread = host_thread_create(serial_func, "SerialThread", NULL);
+	return;
+
+fail:
+	if (wake_fd[0] >= 0) {
+		close(wake_fd[0]);
+		close(wake_fd[1]);
+		wake_fd[0] = wake_fd[1] = -1;
+	}
+	free(rx_ring);
+	free(tx_ring);
+	rx_ring = tx_ring = NULL;
+}
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Returns true if the given SCC channel is bridged to the host.
+ */
+bool Serial_Active(int channel)
+{
+	return host_atomic_get(&serial_started) && serial_cnf.nChannel == channel;
+}
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Get up to len bytes received from the host.
+ */
+int Serial_Read(uint8_t *buf, int len)
+{
+	return ring_get(rx_ring, buf, len);
+}
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Send bytes to the host. Bytes that don't fit are dropped and counted.
+ */
+int Serial_Write(const uint8_t *buf, int len)
+{
+	bool empty = SERIAL_USED(tx_ring) == 0;
+	int n = ring_put(tx_ring, buf, len);
+
+	if (n < len) {
+		if (serial_dropped++ == 0) {
+			Log_Printf(LOG_WARN, "[Serial] Output buffer full, dropping data");
+		}
+	}
+	if (empty && n > 0 && write(wake_fd[1], "", 1) < 0) {
+		/* The pipe is full, the thread is awake anyway */
+	}
+	return n;
+}
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Returns the number of bytes that can be sent without dropping data.
+ */
+int Serial_WriteFree(void)
+{
+	return SERIAL_FREE(tx_ring);
+}
+
+#else /* _WIN32 */
+
+void Serial_Reset(void)
+{
+	if (ConfigureParams.Serial.nHost != SERIAL_NONE) {
+		Log_Printf(LOG_WARN, "[Serial] Host bridge is not supported on this platform");
+	}
+}
+void Serial_Stop(void) {}
+bool Serial_Active(int channel) { return false; }
+int  Serial_Read(uint8_t *buf, int len) { return 0; }
+int  Serial_Write(const uint8_t *buf, int len) { return 0; }
+int  Serial_WriteFree(void) { return 0; }
+
+#endif /* _WIN32 */
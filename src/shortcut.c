@@ -184,6 +184,7 @@ void ShortCut_ActKey(void)
 		break;
 	 case SHORTCUT_RECORD:
 		Grab_SoundToggle();            /* Enable/disable sound recording */
+		Grab_VideoToggle();            /* Enable/disable video recording */
 		break;
 	 case SHORTCUT_SOUND:
 		ShortCut_SoundOnOff();         /* Enable/disable sound */
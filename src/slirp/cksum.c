@@ -82,22 +82,27 @@ int cksum(struct mbuf *m, int len)
 		byte_swapped = 1;
 	}
 	/*
-	 * Unroll the loop to make overhead from
-	 * branches &c small.
+	 * Add 32-bit words into a 64-bit accumulator and fold the carries
+	 * afterwards, 2^16 == 1 in one's complement arithmetic (RFC 1071).
+	 * The loop has no carry dependencies, so the compiler can vectorize it.
 	 */
-	while ((mlen -= 32) >= 0) {
-		sum += w[0]; sum += w[1]; sum += w[2]; sum += w[3];
-		sum += w[4]; sum += w[5]; sum += w[6]; sum += w[7];
-		sum += w[8]; sum += w[9]; sum += w[10]; sum += w[11];
-		sum += w[12]; sum += w[13]; sum += w[14]; sum += w[15];
-		w += 16;
-	}
-	mlen += 32;
-	while ((mlen -= 8) >= 0) {
-		sum += w[0]; sum += w[1]; sum += w[2]; sum += w[3];
-		w += 4;
+	if (mlen >= 4) {
+		u_int64_t sum64 = sum;
+		u_int32_t d;
+		int i, n = mlen >> 2;
+
+		for (i = 0; i < n; i++) {
+			memcpy(&d, (u_int8_t *)w + i * 4, 4);
+			sum64 += d;
+		}
+		w += n * 2;
+		mlen -= n * 4;
+		sum64 = (sum64 & 0xffffffff) + (sum64 >> 32);
+		sum64 = (sum64 & 0xffffffff) + (sum64 >> 32);
+		sum64 = (sum64 & 0xffff) + (sum64 >> 16);
+		sum64 = (sum64 & 0xffff) + (sum64 >> 16);
+		sum = (int)sum64;
 	}
-	mlen += 8;
 	if (mlen == 0 && byte_swapped == 0)
 	   goto cont;
 	REDUCE;
@@ -228,14 +228,17 @@ struct ipovly {
 #endif
 
 /*
- * Ip reassembly queue structure.  Each fragment
- * being reassembled is attached to one of these structures.
- * They are timed out after ipq_ttl drops to 0, and may also
- * be reclaimed if memory becomes tight.
- * size 28 bytes
+ * Ip reassembly structure.  Fragments are copied into one
+ * contiguous mbuf as they arrive, with room for the header of
+ * the first fragment in front of the data.  In order fragments
+ * only advance ipq_contig, once a fragment arrives out of order
+ * the bitmap records which 8 byte units have been received.
+ * They are timed out after ipq_ttl drops to 0.
  */
+#define IPQ_HDR		60		/* largest ip header */
+#define IPQ_PREALLOC	9216		/* 8 KB NFS datagrams fit */
+
 struct ipq {
-	struct qlink frag_link;			/* to ip headers of fragments */
 	struct qlink ip_link;				/* to other reass headers */
 
 	u_int8_t	ipq_ttl;		/* time for reass q to live */
@@ -243,24 +246,16 @@ struct ipq {
 	u_int16_t	ipq_id;			/* sequence id for reassembly */
 
 	struct	in_addr ipq_src,ipq_dst;
-};
 
-/*
- * Ip header, when holding a fragment.
- *
- * Note: ipf_next must be at same offset as ipq_next above
- */
-struct	ipasfrag {
-	struct qlink ipf_link;
- 	struct ip ipf_ip;
+	struct	mbuf *ipq_m;		/* datagram being reassembled */
+	int	ipq_hlen;		/* header length, 0 until first fragment arrived */
+	int	ipq_len;		/* data length, -1 until last fragment arrived */
+	int	ipq_contig;		/* data received in order */
+	int	ipq_sparse;		/* out of order data, use bitmap */
+	int	ipq_units;		/* 8 byte units set in bitmap */
+	u_int32_t ipq_map[(IP_MAXPACKET / 8 + 31) / 32];
 };
 
-#define ipf_off      ipf_ip.ip_off
-#define ipf_tos      ipf_ip.ip_tos
-#define ipf_len      ipf_ip.ip_len
-#define ipf_next     ipf_link.next
-#define ipf_prev     ipf_link.prev 
-
 /*
  * Structure stored in mbuf in inpcb.ip_options
  * and passed to ip_output when ip options are in use.
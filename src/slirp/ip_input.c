@@ -41,6 +41,7 @@
 #include <stdarg.h>
 #include <stddef.h>
 #include <stdbool.h>
+#include <stdlib.h>
 #include <sys/types.h>
 
 #define container_of(ptr, type, member) ({                      \
@@ -200,11 +201,12 @@ ip_input(struct mbuf *m)
 		 */
 		if (ip->ip_tos & 1 || ip->ip_off) {	
 			ipstat.ips_fragments++;
-			ip = ip_reass(ip, fp);
-			if (ip == 0)
+			m = ip_reass(m, fp);
+			if (m == 0)
 				return;
 			ipstat.ips_reassembled++;
-			m = dtom(ip);
+			ip = mtod(m, struct ip *);
+			hlen = ip->ip_hl << 2;
 		} else
 			if (fp)
 		   	   ip_freef(fp);
@@ -236,161 +238,141 @@ bad:
 	return;
 }
 
-#define iptofrag(P) ((struct ipasfrag *)(((char*)(P)) - sizeof(struct qlink)))
-#define fragtoip(P) ((struct ip*)(((char*)(P)) + sizeof(struct qlink)))
+/*
+ * Mark the 8 byte units of a fragment as received
+ */
+static void
+ip_reass_mark(struct ipq *fp, int off, int len)
+{
+	int i;
+
+	for (i = off / 8; i < (off + len + 7) / 8; i++) {
+		if (!(fp->ipq_map[i / 32] & (1u << (i % 32)))) {
+			fp->ipq_map[i / 32] |= 1u << (i % 32);
+			fp->ipq_units++;
+		}
+	}
+}
+
 /*
  * Take incoming datagram fragment and try to
- * reassemble it into whole datagram.  If a chain for
- * reassembly of this datagram already exists, then it
- * is given as fp; otherwise have to make a chain.
+ * reassemble it into whole datagram.  If a reassembly
+ * of this datagram already exists, then it is given
+ * as fp; otherwise have to start one.  The fragment
+ * is always consumed.
  */
-struct ip *
-ip_reass(register struct ip *ip, register struct ipq *fp)
+struct mbuf *
+ip_reass(struct mbuf *m, struct ipq *fp)
 {
-	register struct mbuf *m = dtom(ip);
-	register struct ipasfrag *q;
+	struct ip *ip = mtod(m, struct ip *);
+	struct mbuf *r;
 	int hlen = ip->ip_hl << 2;
-	int i, next;
+	int off = ip->ip_off;
+	int len = ip->ip_len;
+	int more = ip->ip_tos & 1;
+	int need, room;
 	
 	DEBUG_CALL("ip_reass");
-	DEBUG_ARG("ip = %lx", (long)ip);
-	DEBUG_ARG("fp = %lx", (long)fp);
 	DEBUG_ARG("m = %lx", (long)m);
+	DEBUG_ARG("fp = %lx", (long)fp);
 
 	/*
-	 * Presence of header sizes in mbufs
-	 * would confuse code below.
-         * Fragment m_data is concatenated.
+	 * All but the last fragment carry a multiple of 8 bytes.
 	 */
-	m->m_data += hlen;
-	m->m_len -= hlen;
+	if (off + len > IP_MAXPACKET || (more && (len & 7)))
+		goto dropfrag;
 
 	/*
-	 * If first fragment to arrive, create a reassembly queue.
+	 * If first fragment to arrive, start a reassembly.
 	 */
 	if (fp == 0) {
-	  struct mbuf *t;
-	  if ((t = m_get()) == NULL) goto dropfrag;
-	  fp = mtod(t, struct ipq *);
+	  if ((fp = (struct ipq *)malloc(sizeof(struct ipq))) == NULL)
+	    goto dropfrag;
+	  memset(fp, 0, sizeof(struct ipq));
+	  if ((fp->ipq_m = m_get()) == NULL) {
+	    free(fp);
+	    goto dropfrag;
+	  }
+	  fp->ipq_m->m_data += if_maxlinkhdr;
 	  insque(&fp->ip_link, &ipq.ip_link);
 	  fp->ipq_ttl = IPFRAGTTL;
 	  fp->ipq_p = ip->ip_p;
 	  fp->ipq_id = ip->ip_id;
-	  fp->frag_link.next = fp->frag_link.prev = &fp->frag_link;
 	  fp->ipq_src = ip->ip_src;
 	  fp->ipq_dst = ip->ip_dst;
-	  q = (struct ipasfrag *)fp;
-	  goto insert;
+	  fp->ipq_len = -1;
 	}
-	
-	/*
-	 * Find a segment which begins after this one does.
-	 */
-	for (q = fp->frag_link.next; q != (struct ipasfrag *)&fp->frag_link;
-            q = q->ipf_next)
-		if (q->ipf_off > ip->ip_off)
-			break;
 
 	/*
-	 * If there is a preceding segment, it may provide some of
-	 * our data already.  If so, drop the data from the incoming
-	 * segment.  If it provides all of our data, drop us.
+	 * The last fragment tells the size of the datagram,
+	 * nothing may lie beyond it.
 	 */
-	if (q->ipf_prev != &fp->frag_link) {
-        struct ipasfrag *pq = q->ipf_prev;
-		i = pq->ipf_off + pq->ipf_len - ip->ip_off;
-		if (i > 0) {
-			if (i >= ip->ip_len)
-				goto dropfrag;
-			m_adj(dtom(ip), i);
-			ip->ip_off += i;
-			ip->ip_len -= i;
-		}
+	if (!more) {
+		if (fp->ipq_len >= 0 && fp->ipq_len != off + len)
+			goto dropall;
+		fp->ipq_len = off + len;
 	}
+	if (fp->ipq_len >= 0 && off + len > fp->ipq_len)
+		goto dropall;
 
 	/*
-	 * While we overlap succeeding segments trim them or,
-	 * if they are completely covered, dequeue them.
+	 * Make room for the data, the buffer only grows.
 	 */
-	while (q != (struct ipasfrag*)&fp->frag_link &&
-            ip->ip_off + ip->ip_len > q->ipf_off) {
-		i = (ip->ip_off + ip->ip_len) - q->ipf_off;
-		if (i < q->ipf_len) {
-			q->ipf_len -= i;
-			q->ipf_off += i;
-			m_adj(dtom(q), i);
-			break;
-		}
-		q = q->ipf_next;
-		m_freem(dtom(q->ipf_prev));
-		ip_deq(q->ipf_prev);
+	r = fp->ipq_m;
+	need = IPQ_HDR + off + len;
+	if (M_ROOM(r) < need) {
+		room = need < IPQ_PREALLOC ? IPQ_PREALLOC : 2 * need;
+		if (room > IPQ_HDR + IP_MAXPACKET)
+			room = IPQ_HDR + IP_MAXPACKET;
+		m_inc(r, (r->m_data - ((r->m_flags & M_EXT) ? r->m_ext : r->m_dat)) + room);
+		if (M_ROOM(r) < need)
+			goto dropall;
 	}
 
-insert:
-	/*
-	 * Stick new segment in its place;
-	 * check for complete reassembly.
-	 */
-	ip_enq(iptofrag(ip), q->ipf_prev);
-	next = 0;
-	for (q = fp->frag_link.next; q != (struct ipasfrag*)&fp->frag_link;
-            q = q->ipf_next) {
-		if (q->ipf_off != next)
-			return (0);
-		next += q->ipf_len;
+	memcpy(r->m_data + IPQ_HDR + off, (char *)ip + hlen, len);
+	if (off == 0) {
+		fp->ipq_hlen = hlen;
+		memcpy(r->m_data + IPQ_HDR - hlen, ip, hlen);
 	}
-	if (((struct ipasfrag *)(q->ipf_prev))->ipf_tos & 1)
-		return (0);
+	m_freem(m);
 
 	/*
-	 * Reassembly is complete; concatenate fragments.
+	 * Fragments arriving in order need no bookkeeping.
 	 */
-    q = fp->frag_link.next;
-	m = dtom(q);
-
-	q = (struct ipasfrag *) q->ipf_next;
-	while (q != (struct ipasfrag*)&fp->frag_link) {
-	  struct mbuf *t = dtom(q);
-	  q = (struct ipasfrag *) q->ipf_next;
-	  m_cat(m, t);
+	if (!fp->ipq_sparse && off == fp->ipq_contig) {
+		fp->ipq_contig += len;
+	} else {
+		if (!fp->ipq_sparse) {
+			ip_reass_mark(fp, 0, fp->ipq_contig);
+			fp->ipq_sparse = 1;
+		}
+		ip_reass_mark(fp, off, len);
 	}
 
-	/*
-	 * Create header for new ip packet by
-	 * modifying header of first packet;
-	 * dequeue and discard fragment reassembly header.
-	 * Make header visible.
-	 */
-	q = fp->frag_link.next;
+	if (fp->ipq_len < 0 || fp->ipq_hlen == 0)
+		return (0);
+	if (fp->ipq_sparse ? fp->ipq_units != (fp->ipq_len + 7) / 8
+	                   : fp->ipq_contig != fp->ipq_len)
+		return (0);
 
 	/*
-	 * If the fragments concatenated to an mbuf that's
-	 * bigger than the total size of the fragment, then and
-	 * m_ext buffer was alloced. But fp->ipq_next points to
-	 * the old buffer (in the mbuf), so we must point ip
-	 * into the new buffer.
+	 * Reassembly is complete; make the header of the
+	 * first fragment the header of the datagram.
 	 */
-	if (m->m_flags & M_EXT) {
-	  int delta;
-	  delta = (char *)q - m->m_dat;
-	  q = (struct ipasfrag *)(m->m_ext + delta);
-	}
-
-	/* DEBUG_ARG("ip = %lx", (long)ip); 
-	 * ip=(struct ipasfrag *)m->m_data; */
-
-	ip = fragtoip(q);
-	ip->ip_len = next;
+	r->m_data += IPQ_HDR - fp->ipq_hlen;
+	r->m_len = fp->ipq_hlen + fp->ipq_len;
+	ip = mtod(r, struct ip *);
+	ip->ip_len = fp->ipq_len;
 	ip->ip_tos &= ~1;
 	ip->ip_src = fp->ipq_src;
 	ip->ip_dst = fp->ipq_dst;
-	remque(&fp->ip_link);
-	(void) m_free(dtom(fp));
-	m->m_len += (ip->ip_hl << 2);
-	m->m_data -= (ip->ip_hl << 2);
+	fp->ipq_m = NULL;
+	ip_freef(fp);
 
-	return ip;
+	return r;
 
+dropall:
+	ip_freef(fp);
 dropfrag:
 	ipstat.ips_fragdropped++;
 	m_freem(m);
@@ -398,46 +380,16 @@ dropfrag:
 }
 
 /*
- * Free a fragment reassembly header and all
- * associated datagrams.
+ * Free a fragment reassembly and the
+ * datagram being assembled.
  */
 void
 ip_freef(struct ipq *fp)
 {
-	register struct ipasfrag *q, *p;
-
-	for (q = fp->frag_link.next; q != (struct ipasfrag*)&fp->frag_link; q = p) {
-		p = q->ipf_next;
-		ip_deq(q);
-		m_freem(dtom(q));
-	}
+	if (fp->ipq_m)
+		m_free(fp->ipq_m);
 	remque(&fp->ip_link);
-	(void) m_free(dtom(fp));
-}
-
-/*
- * Put an ip fragment on a reassembly chain.
- * Like insque, but pointers in middle of structure.
- */
-void
-ip_enq(register struct ipasfrag *p, register struct ipasfrag *prev)
-{
-	DEBUG_CALL("ip_enq");
-	DEBUG_ARG("prev = %lx", (long)prev);
-	p->ipf_prev =  prev;
-	p->ipf_next = prev->ipf_next;
-	((struct ipasfrag *)(prev->ipf_next))->ipf_prev = p;
-	prev->ipf_next = p;
-}
-
-/*
- * To ip_enq as remque is to insque.
- */
-void
-ip_deq(register struct ipasfrag *p)
-{
-	((struct ipasfrag *)(p->ipf_prev))->ipf_next = p->ipf_next;
-	((struct ipasfrag *)(p->ipf_next))->ipf_prev = p->ipf_prev;
+	free(fp);
 }
 
 /*
@@ -21,9 +21,12 @@ int slirp_select_fill(int *pnfds,
 void slirp_select_poll(fd_set *readfds, fd_set *writefds, fd_set *xfds);
 
 void slirp_input(const uint8_t *pkt, int pkt_len);
+uint8_t *slirp_input_buffer(int *size);
     
 void slirp_rip_broadcast(void);
 
+void slirp_tcp_config(int bufsize, int nodelay);
+
 /* you must provide the following functions: */
 int slirp_can_output(void);
 void slirp_output(const uint8_t *pkt, int pkt_len);
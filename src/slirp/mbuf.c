@@ -26,6 +26,90 @@ int mbuf_thresh = 30;
 int mbuf_max = 0;
 size_t msize;
 
+/*
+ * Extended data (M_EXT) comes from a pool with a few size classes.
+ * Freed buffers are kept on a list per class, so that large TCP segments
+ * do not malloc and free all the time. Buffers larger than the largest
+ * class are malloced. SLiRP only runs with slirp_mutex held, the pool is
+ * not locked.
+ */
+#define M_EXT_CLASSES	4
+#define M_EXT_KEEP	32	/* free buffers kept per class */
+
+struct m_ext_free {
+	struct m_ext_free *next;
+};
+
+static const size_t m_ext_size[M_EXT_CLASSES] = { 4096, 8192, 16384, 65536 };
+
+static struct {
+	struct m_ext_free *free;
+	int nfree;
+	int inuse;
+	unsigned long gets;	/* buffers taken from the class */
+	unsigned long hits;	/* ... of them found on the free list */
+} m_ext_pool[M_EXT_CLASSES];
+
+static int m_ext_class(size_t size)
+{
+	int i;
+
+	for (i = 0; i < M_EXT_CLASSES; i++)
+		if (size <= m_ext_size[i])
+			return i;
+	return -1;
+}
+
+/* Get a buffer of at least *size bytes, *size is rounded up to its class */
+static char *m_ext_get(size_t *size)
+{
+	struct m_ext_free *f;
+	int c = m_ext_class(*size);
+
+	if (c < 0)
+		return (char *)malloc(*size);
+
+	*size = m_ext_size[c];
+	m_ext_pool[c].gets++;
+	m_ext_pool[c].inuse++;
+	if ((f = m_ext_pool[c].free) != NULL) {
+		m_ext_pool[c].free = f->next;
+		m_ext_pool[c].nfree--;
+		m_ext_pool[c].hits++;
+		return (char *)f;
+	}
+	return (char *)malloc(*size);
+}
+
+static void m_ext_put(char *ext, size_t size)
+{
+	struct m_ext_free *f = (struct m_ext_free *)ext;
+	int c = m_ext_class(size);
+
+	if (c < 0 || m_ext_size[c] != size) {
+		free(ext);
+		return;
+	}
+	m_ext_pool[c].inuse--;
+	if (m_ext_pool[c].nfree >= M_EXT_KEEP) {
+		free(ext);
+		return;
+	}
+	f->next = m_ext_pool[c].free;
+	m_ext_pool[c].free = f;
+	m_ext_pool[c].nfree++;
+}
+
+void m_ext_stats(void)
+{
+	int i;
+
+	for (i = 0; i < M_EXT_CLASSES; i++)
+		lprint("  %6d %5d byte buffers in use, %d free, %lu of %lu reused\r\n",
+		       m_ext_pool[i].inuse, (int)m_ext_size[i], m_ext_pool[i].nfree,
+		       m_ext_pool[i].hits, m_ext_pool[i].gets);
+}
+
 void m_init(void)
 {
 	m_freelist.m_next = m_freelist.m_prev = &m_freelist;
@@ -97,9 +181,9 @@ void m_free(struct mbuf *m)
 	if (m->m_flags & M_USEDLIST)
 	   remque(m);
 	
-	/* If it's M_EXT, free() it */
+	/* If it's M_EXT, give it back to the pool */
 	if (m->m_flags & M_EXT)
-	   free(m->m_ext);
+	   m_ext_put(m->m_ext, m->m_size);
 
 	/*
 	 * Either free() it or put it on the free list
@@ -137,34 +221,30 @@ void m_cat(register struct mbuf *m, register struct mbuf *n)
 /* make m size bytes large */
 void m_inc(struct mbuf *m, u_int size)
 {
-       int datasize;
+	int datasize;
+	size_t newsize = size;
+	char *dat;
 
 	/* some compiles throw up on gotos.  This one we can fake. */
-        if(m->m_size>size) return;
-
-        if (m->m_flags & M_EXT) {
-         datasize = m->m_data - m->m_ext;
-	  m->m_ext = (char *)realloc(m->m_ext,size);
-/*		if (m->m_ext == NULL)
- *			return (struct mbuf *)NULL;
- */		
-         m->m_data = m->m_ext + datasize;
-        } else {
-	  char *dat;
+	if(m->m_size>size) return;
+
+	dat = m_ext_get(&newsize);
+	if (dat == NULL)
+		return;
+
+	if (m->m_flags & M_EXT) {
+	  datasize = m->m_data - m->m_ext;
+	  memcpy(dat, m->m_ext, m->m_size);
+	  m_ext_put(m->m_ext, m->m_size);
+	} else {
 	  datasize = m->m_data - m->m_dat;
-	  dat = (char *)malloc(size);
-/*		if (dat == NULL)
- *			return (struct mbuf *)NULL;
- */
 	  memcpy(dat, m->m_dat, m->m_size);
-	  
-	  m->m_ext = dat;
-	  m->m_data = m->m_ext + datasize;
-	  m->m_flags |= M_EXT;
-        }
- 
-        m->m_size = size;
+	}
 
+	m->m_ext = dat;
+	m->m_data = m->m_ext + datasize;
+	m->m_flags |= M_EXT;
+	m->m_size = newsize;
 }
 
 
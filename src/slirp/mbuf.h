@@ -139,6 +139,7 @@ struct mbuf * m_get(void);
 void m_free(struct mbuf *);
 void m_cat(struct mbuf *, struct mbuf *);
 void m_inc(struct mbuf *, u_int);
+void m_ext_stats(void);
 void m_adj(struct mbuf *, int);
 int m_copy(struct mbuf *, struct mbuf *, u_int, u_int);
 struct mbuf * dtom(void *);
@@ -8,21 +8,121 @@
 #include "FileTableNFSD.h"
 #include "compat.h"
 #include <unistd.h>
+#include <inttypes.h>
+#include <string.h>
+
+extern "C" {
+#include "paths.h"
+}
 
 using namespace std;
 
+// File handles are derived from device and inode numbers, so they stay
+// valid across emulator restarts. Their paths are kept in a database in
+// the configuration directory, one per exported directory, so a guest that
+// still holds handles from an earlier session does not get stale handle
+// errors. The database is a log of "handle path" and "handle" (removed)
+// records, it is compacted when the file table is created and destroyed.
+
+static const size_t DB_COMPACT_RECORDS = 65536;
+
 FileTableNFSD::FileTableNFSD(const HostPath& basePath, const VFSPath& basePathAlias)
 : VirtualFS(basePath, basePathAlias)
-, mutex(host_mutex_create()) {}
+, dbFile(NULL)
+, dbRecords(0)
+, mutex(host_mutex_create()) {
+    // FNV-1a of the exported directory names the database
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    string   base = basePath.string();
+    for(size_t i = 0; i < base.size(); i++)
+        hash = (hash ^ static_cast<uint8_t>(base[i])) * 0x100000001b3ULL;
+
+    char name[64];
+    snprintf(name, sizeof(name), "/nfsd_handles_%016" PRIx64 ".db", hash);
+    dbPath = string(Paths_GetHatariHome()) + name;
+
+    loadDB();
+    saveDB();
+}
 
 FileTableNFSD::~FileTableNFSD(void) {
+    saveDB();
+    if(dbFile) fclose(dbFile);
     host_mutex_destroy(mutex);
 }
 
+void FileTableNFSD::loadDB(void) {
+    FILE* file = fopen(dbPath.c_str(), "r");
+    if(!(file)) return;
+
+    char line[PATH_MAX + 32];
+    while(fgets(line, sizeof(line), file)) {
+        size_t len = strlen(line);
+        if(len && line[len-1] == '\n') line[--len] = '\0';
+
+        char*    end;
+        uint64_t handle = strtoull(line, &end, 16);
+        if(end == line || handle == 0) continue;
+        if(*end == ' ') {
+            handle2path[handle] = string(end + 1);
+            unverified.insert(handle);
+        } else {
+            handle2path.erase(handle);
+            unverified.erase(handle);
+        }
+    }
+    fclose(file);
+}
+
+void FileTableNFSD::saveDB(void) {
+    if(dbFile) fclose(dbFile);
+    dbFile = NULL;
+
+    string tmpPath = dbPath + ".tmp";
+    FILE*  file    = fopen(tmpPath.c_str(), "w");
+    if(!(file)) return;
+    for(unordered_map<uint64_t, string>::iterator it = handle2path.begin(); it != handle2path.end(); it++)
+        fprintf(file, "%016" PRIx64 " %s\n", it->first, it->second.c_str());
+    if(fclose(file) != 0 || rename(tmpPath.c_str(), dbPath.c_str()) != 0) {
+        ::remove(tmpPath.c_str());
+        return;
+    }
+    dbRecords = handle2path.size();
+    dbFile    = fopen(dbPath.c_str(), "a");
+}
+
+void FileTableNFSD::logDB(uint64_t handle, const string* path) {
+    if(!(dbFile)) return;
+    if(path) fprintf(dbFile, "%016" PRIx64 " %s\n", handle, path->c_str());
+    else     fprintf(dbFile, "%016" PRIx64 "\n", handle);
+    fflush(dbFile);
+    if(++dbRecords > DB_COMPACT_RECORDS + 2 * handle2path.size())
+        saveDB();
+}
+
+void FileTableNFSD::setPath(uint64_t handle, const string& path) {
+    unverified.erase(handle);
+    unordered_map<uint64_t, string>::iterator iter(handle2path.find(handle));
+    if(iter != handle2path.end() && iter->second == path)
+        return;
+    handle2path[handle] = path;
+    logDB(handle, &path);
+}
+
 bool FileTableNFSD::getCanonicalPath(uint64_t fhandle, std::string& result) {
     NFSDLock lock(mutex);
-    map<uint64_t, string>::iterator iter(handle2path.find(fhandle));
+    unordered_map<uint64_t, string>::iterator iter(handle2path.find(fhandle));
     if(iter != handle2path.end()) {
+        if(unverified.count(fhandle)) {
+            // the file may have been changed while the emulator was not running
+            if(lookupHandle(iter->second) != fhandle) {
+                handle2path.erase(iter);
+                unverified.erase(fhandle);
+                logDB(fhandle, NULL);
+                return false;
+            }
+            unverified.erase(fhandle);
+        }
         result = iter->second;
         return true;
     }
@@ -37,18 +137,22 @@ int FileTableNFSD::stat(const VFSPath& absoluteVFSpath, struct stat& fstat) {
 void FileTableNFSD::move(uint64_t fileHandleFrom, const VFSPath& absoluteVFSpathTo) {
     NFSDLock lock(mutex);
     handle2path.erase(fileHandleFrom);
-    handle2path[VirtualFS::getFileHandle(absoluteVFSpathTo)] = absoluteVFSpathTo.canonicalize().string();
+    unverified.erase(fileHandleFrom);
+    logDB(fileHandleFrom, NULL);
+    setPath(lookupHandle(absoluteVFSpathTo), absoluteVFSpathTo.canonicalize().string());
 }
 
 void FileTableNFSD::remove(uint64_t fileHandle) {
     NFSDLock lock(mutex);
-    handle2path.erase(fileHandle);
+    if(handle2path.erase(fileHandle))
+        logDB(fileHandle, NULL);
+    unverified.erase(fileHandle);
 }
 
 uint64_t FileTableNFSD::getFileHandle(const VFSPath& absoluteVFSpath) {
     NFSDLock lock(mutex);
-    uint64_t result(VirtualFS::getFileHandle(absoluteVFSpath));
-    handle2path[result] = absoluteVFSpath.canonicalize().string();
+    uint64_t result(lookupHandle(absoluteVFSpath));
+    if(result) setPath(result, absoluteVFSpath.canonicalize().string());
     return result;
 }
 
@@ -61,3 +165,16 @@ FileAttrs FileTableNFSD::getFileAttrs(const VFSPath& absoluteVFSpath) {
     NFSDLock lock(mutex);
     return VirtualFS::getFileAttrs(absoluteVFSpath);
 }
+
+uint64_t FileTableNFSD::lookupHandle(const VFSPath& absoluteVFSpath) {
+    return VirtualFS::getFileHandle(absoluteVFSpath);
+}
+
+// The mutex is recursive, the cache may be used while it is held
+void FileTableNFSD::cacheLock(void) {
+    host_mutex_lock(mutex);
+}
+
+void FileTableNFSD::cacheUnlock(void) {
+    host_mutex_unlock(mutex);
+}
@@ -8,13 +8,24 @@
 #ifndef FileTableNFSD_hpp
 #define FileTableNFSD_hpp
 
+#include <unordered_map>
+#include <unordered_set>
+
 #include "../../ditool/VirtualFS.h"
 #include "XDRStream.h"
 #include "host.h"
 
 class FileTableNFSD : public VirtualFS {
-    mutex_t*                        mutex;
-    std::map<uint64_t, std::string> handle2path;
+    std::unordered_map<uint64_t, std::string> handle2path;
+    std::unordered_set<uint64_t>              unverified; // loaded from the database
+    std::string                               dbPath;
+    FILE*                                     dbFile;
+    size_t                                    dbRecords;
+
+    void                loadDB          (void);
+    void                saveDB          (void);
+    void                logDB           (uint64_t handle, const std::string* path);
+    void                setPath         (uint64_t handle, const std::string& path);
 public:
     FileTableNFSD(const HostPath& basePath, const VFSPath& basePathAlias);
     virtual ~FileTableNFSD(void);
@@ -27,6 +38,13 @@ public:
     virtual FileAttrs   getFileAttrs    (const VFSPath& absoluteVFSpath);
     
     bool                getCanonicalPath(uint64_t handle, std::string& result);
+protected:
+    mutex_t*            mutex;
+
+    // The handle of an existing file, 0 if there is none
+    virtual uint64_t    lookupHandle    (const VFSPath& absoluteVFSpath);
+    virtual void        cacheLock       (void);
+    virtual void        cacheUnlock     (void);
 };
 
 #endif /* FileTableNFSD_hpp */
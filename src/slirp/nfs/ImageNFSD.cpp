@@ -0,0 +1,245 @@
+//
+//  ImageNFSD.cpp
+//  Previous
+//
+//  Exports the UFS partition of a NeXT disk image read-only.
+//
+
+#include <cstring>
+#include <errno.h>
+#include <unistd.h>
+
+#include "config.h"
+#include "ImageNFSD.h"
+#include "compat.h"
+
+#ifndef _WIN32
+
+#if !HAVE_STRUCT_STAT_ST_ATIMESPEC
+#define st_atimespec st_atim
+#endif
+
+#if !HAVE_STRUCT_STAT_ST_MTIMESPEC
+#define st_mtimespec st_mtim
+#endif
+
+#endif
+
+using namespace std;
+
+// Files are read straight from the image, nothing is extracted to the host.
+// File handles are the inode numbers of the partition, they never change
+// as the image is not written. Inodes and resolved paths are cached, the
+// UFS reader keeps the indirect blocks of recently read files.
+
+ImageNFSD::ImageNFSD(const HostPath& imagePath, const VFSPath& basePathAlias)
+: FileTableNFSD(imagePath, basePathAlias)
+, im(imagePath.string())
+, ufs(NULL)
+, partIdx(0) {
+    if(!(im.valid())) {
+        error = im.error;
+        return;
+    }
+    for(size_t p = 0; p < im.parts.size(); p++) {
+        if(im.parts[p].isUFS()) {
+            ufs     = new UFS(im.parts[p], IMAGE_CACHE_BLOCKS);
+            partIdx = static_cast<uint32_t>(p);
+            break;
+        }
+    }
+    if(!(ufs)) error = "no UFS partition found";
+}
+
+ImageNFSD::~ImageNFSD(void) {
+    delete ufs;
+}
+
+int ImageNFSD::readInode(icommon& inode, uint32_t ino) {
+    unordered_map<uint32_t, icommon>::iterator it = inodes.find(ino);
+    if(it != inodes.end()) {
+        inode = it->second;
+        return ERR_NO;
+    }
+    if(int err = ufs->readInode(inode, ino))
+        return err;
+    if(inodes.size() >= IMAGE_CACHE_INODES)
+        inodes.clear();
+    inodes[ino] = inode;
+    return ERR_NO;
+}
+
+// Returns the inode number of a path or 0 if it does not exist. Symbolic
+// links are not followed, the client resolves them with READLINK.
+uint32_t ImageNFSD::findIno(const VFSPath& absoluteVFSpath) {
+    if(!(ufs)) return 0;
+
+    VFSPath path("/");
+    path /= VFSPath::relative(absoluteVFSpath, getBasePathAlias());
+    path  = path.canonicalize();
+
+    unordered_map<string, uint32_t>::iterator it = paths.find(path.string());
+    if(it != paths.end())
+        return it->second;
+
+    uint32_t ino = ROOTINO;
+    string   dirPath;
+    for(size_t seg = 0; seg < path.size(); seg++) {
+        if(path[seg].empty()) continue;
+        string entryPath = dirPath + "/" + path[seg];
+        it = paths.find(entryPath);
+        if(it == paths.end()) {
+            // remember all entries, the guest usually looks up the siblings next
+            vector<direct> entries = ufs->list(ino);
+            if(paths.size() + entries.size() >= IMAGE_CACHE_INODES)
+                paths.clear();
+            for(size_t i = 0; i < entries.size(); i++) {
+                string name(entries[i].d_name);
+                if(name == "." || name == "..") continue;
+                paths[dirPath + "/" + name] = fsv(entries[i].d_inonum);
+            }
+            it = paths.find(entryPath);
+            if(it == paths.end())
+                return 0;
+        }
+        ino     = it->second;
+        dirPath = entryPath;
+    }
+    return ino;
+}
+
+bool ImageNFSD::findInode(const VFSPath& absoluteVFSpath, icommon& inode, uint32_t& ino) {
+    ino = findIno(absoluteVFSpath);
+    return ino && readInode(inode, ino) == ERR_NO;
+}
+
+int ImageNFSD::stat(const VFSPath& absoluteVFSpath, struct stat& fstat) {
+    NFSDLock lock(mutex);
+    icommon  inode;
+    uint32_t ino;
+    if(!(findInode(absoluteVFSpath, inode, ino)))
+        return ENOENT;
+
+    memset(&fstat, 0, sizeof(fstat));
+    fstat.st_mode  = fsv(inode.ic_mode);
+    fstat.st_nlink = fsv(inode.ic_nlink);
+    fstat.st_uid   = fsv(inode.ic_uid);
+    fstat.st_gid   = fsv(inode.ic_gid);
+    fstat.st_size  = fsv(inode.ic_size);
+    fstat.st_ino   = ino;
+    fstat.st_dev   = partIdx;
+    switch(fsv(inode.ic_mode) & IFMT) {
+        case IFCHR:
+        case IFBLK:
+            fstat.st_rdev = fsv(inode.ic_db[0]);
+            break;
+    }
+#ifdef _WIN32
+    fstat.st_atime = fsv(inode.ic_atime.tv_sec);
+    fstat.st_mtime = fsv(inode.ic_mtime.tv_sec);
+#else
+    fstat.st_blksize           = fsv(ufs->superBlock.fs_bsize);
+    fstat.st_blocks            = fsv(inode.ic_blocks);
+    fstat.st_atimespec.tv_sec  = fsv(inode.ic_atime.tv_sec);
+    fstat.st_atimespec.tv_nsec = fsv(inode.ic_atime.tv_usec) * 1000;
+    fstat.st_mtimespec.tv_sec  = fsv(inode.ic_mtime.tv_sec);
+    fstat.st_mtimespec.tv_nsec = fsv(inode.ic_mtime.tv_usec) * 1000;
+#endif
+    return 0;
+}
+
+void ImageNFSD::setFileAttrs(const VFSPath& /*absoluteVFSpath*/, const FileAttrs& /*fstat*/) {}
+
+FileAttrs ImageNFSD::getFileAttrs(const VFSPath& absoluteVFSpath) {
+    struct stat fstat;
+    memset(&fstat, 0, sizeof(fstat));
+    stat(absoluteVFSpath, fstat);
+    return FileAttrs(fstat);
+}
+
+int ImageNFSD::vfsAccess(const VFSPath& absoluteVFSpath, int mode) {
+    NFSDLock lock(mutex);
+    if(!(findIno(absoluteVFSpath)))
+        return ENOENT;
+    return (mode & W_OK) ? EROFS : 0;
+}
+
+int ImageNFSD::vfsReaddir(const VFSPath& absoluteVFSpath, vector<VFSDirEntry>& entries) {
+    NFSDLock lock(mutex);
+    icommon  inode;
+    uint32_t ino;
+    if(!(findInode(absoluteVFSpath, inode, ino)))
+        return ENOENT;
+    if((fsv(inode.ic_mode) & IFMT) != IFDIR)
+        return ENOTDIR;
+
+    vector<direct> dirEnts = ufs->list(ino);
+    for(size_t i = 0; i < dirEnts.size(); i++) {
+        VFSDirEntry entry;
+        entry.name = dirEnts[i].d_name;
+        entry.ino  = fsv(dirEnts[i].d_inonum);
+        entries.push_back(entry);
+    }
+    return 0;
+}
+
+int ImageNFSD::vfsRead(const VFSPath& absoluteVFSpath, size_t fileOffset, void* dst, size_t& count) {
+    NFSDLock lock(mutex);
+    icommon  inode;
+    uint32_t ino;
+    if(!(findInode(absoluteVFSpath, inode, ino))) {
+        count = 0;
+        return ENOENT;
+    }
+    if((fsv(inode.ic_mode) & IFMT) == IFDIR) {
+        count = 0;
+        return EISDIR;
+    }
+
+    size_t size = ufs->fileSize(inode);
+    if(fileOffset >= size)
+        count = 0;
+    else if(count > size - fileOffset)
+        count = size - fileOffset;
+    if(count && ufs->readFile(inode, static_cast<uint32_t>(fileOffset), static_cast<uint32_t>(count), static_cast<uint8_t*>(dst))) {
+        count = 0;
+        return EIO;
+    }
+    return 0;
+}
+
+int ImageNFSD::vfsReadlink(const VFSPath& absoluteVFSpath, VFSPath& result) {
+    NFSDLock lock(mutex);
+    icommon  inode;
+    uint32_t ino;
+    if(!(findInode(absoluteVFSpath, inode, ino)))
+        return ENOENT;
+    if((fsv(inode.ic_mode) & IFMT) != IFLNK)
+        return EINVAL;
+    result = ufs->readlink(inode);
+    return 0;
+}
+
+int ImageNFSD::vfsStatvfs(const VFSPath& absoluteVFSpath, struct statvfs& fsstat) {
+    NFSDLock lock(mutex);
+    if(!(findIno(absoluteVFSpath)))
+        return ENOENT;
+
+    const ufs_super_block& sb = ufs->superBlock;
+    memset(&fsstat, 0, sizeof(fsstat));
+    fsstat.f_bsize   = fsv(sb.fs_fsize);
+    fsstat.f_frsize  = fsv(sb.fs_fsize);
+    fsstat.f_blocks  = fsv(sb.fs_dsize);
+    fsstat.f_bfree   = fsv(sb.fs_cstotal.cs_nbfree) * fsv(sb.fs_frag) + fsv(sb.fs_cstotal.cs_nffree);
+    fsstat.f_bavail  = 0; // nothing can be written
+    fsstat.f_files   = fsv(sb.fs_ncg) * fsv(sb.fs_ipg);
+    fsstat.f_ffree   = fsv(sb.fs_cstotal.cs_nifree);
+    fsstat.f_favail  = 0;
+    fsstat.f_namemax = MAXNAMLEN;
+    return 0;
+}
+
+uint64_t ImageNFSD::lookupHandle(const VFSPath& absoluteVFSpath) {
+    NFSDLock lock(mutex);
+    return findIno(absoluteVFSpath);
+}
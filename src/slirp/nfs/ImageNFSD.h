@@ -0,0 +1,52 @@
+//
+//  ImageNFSD.h
+//  Previous
+//
+//  Exports the UFS partition of a NeXT disk image read-only.
+//
+
+#ifndef ImageNFSD_hpp
+#define ImageNFSD_hpp
+
+#include <unordered_map>
+
+#include "FileTableNFSD.h"
+#include "../../ditool/DiskImage.h"
+#include "../../ditool/UFS.h"
+
+const uint32_t IMAGE_CACHE_BLOCKS = 4096;  // cached indirect blocks (32 MB)
+const size_t   IMAGE_CACHE_INODES = 16384; // cached inodes and resolved paths
+
+class ImageNFSD : public FileTableNFSD {
+    DiskImage                                  im;
+    UFS*                                       ufs;
+    uint32_t                                   partIdx;
+    std::string                                error;
+    std::unordered_map<uint32_t, icommon>      inodes;
+    std::unordered_map<std::string, uint32_t>  paths;
+
+    int                 readInode       (icommon& inode, uint32_t ino);
+    uint32_t            findIno         (const VFSPath& absoluteVFSpath);
+    bool                findInode       (const VFSPath& absoluteVFSpath, icommon& inode, uint32_t& ino);
+public:
+    ImageNFSD(const HostPath& imagePath, const VFSPath& basePathAlias);
+    virtual ~ImageNFSD(void);
+
+    bool                valid           (void) const {return error.empty();}
+    const std::string&  getError        (void) const {return error;}
+
+    virtual int         stat            (const VFSPath& absoluteVFSpath, struct stat& stat);
+    virtual void        setFileAttrs    (const VFSPath& absoluteVFSpath, const FileAttrs& fstat);
+    virtual FileAttrs   getFileAttrs    (const VFSPath& absoluteVFSpath);
+    virtual bool        readOnly        (void) {return true;}
+
+    virtual int         vfsAccess       (const VFSPath& absoluteVFSpath, int mode);
+    virtual int         vfsReaddir      (const VFSPath& absoluteVFSpath, std::vector<VFSDirEntry>& entries);
+    virtual int         vfsRead         (const VFSPath& absoluteVFSpath, size_t fileOffset, void* dst, size_t& count);
+    virtual int         vfsReadlink     (const VFSPath& absoluteVFSpath, VFSPath& result);
+    virtual int         vfsStatvfs      (const VFSPath& absoluteVFSpath, struct statvfs& fsstat);
+protected:
+    virtual uint64_t    lookupHandle    (const VFSPath& absoluteVFSpath);
+};
+
+#endif /* ImageNFSD_hpp */
@@ -1,21 +1,22 @@
-#ifndef _NFSPROG_H_
-#define _NFSPROG_H_
-
-#include "RPCProg.h"
-#include "NFS2Prog.h"
-
-class CNFSProg : public CRPCProg
-{
-    public:
-    CNFSProg();
-    ~CNFSProg();
-    
-    void         setUserID(unsigned int nUID, unsigned int nGID);
-    virtual int  process(void);
-    void         setLogOn(bool bLogOn);
-
-private:
-    CNFS2Prog  m_NFS2Prog;
-};
-
-#endif
+#ifndef _NFSPROG_H_
+#define _NFSPROG_H_
+
+#include "RPCProg.h"
+#include "NFS2Prog.h"
+
+class CNFSProg : public CRPCProg
+{
+    public:
+    CNFSProg();
+    ~CNFSProg();
+    
+    void         setUserID(unsigned int nUID, unsigned int nGID);
+    virtual int  process(void);
+    void         setLogOn(bool bLogOn);
+    virtual void getStatsProgs(std::vector<const CRPCProg*>& progs) const;
+
+private:
+    CNFS2Prog  m_NFS2Prog;
+};
+
+#endif
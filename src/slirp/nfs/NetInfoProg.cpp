@@ -94,20 +94,32 @@ static string to_string(const vector<string>& strs) {
     return result;
 }
 
-static void write_ni_namelist(XDROutput* m_out, vector<string> names) {
+static void write_ni_namelist(XDROutput* m_out, const vector<string>& names) {
     m_out->write(names.size());
     for(size_t i = 0; i < names.size(); i++)
         m_out->write(names[i]);
 }
 
-static void write_ni_proplist(XDROutput* m_out, map<string, string> props) {
+static void write_ni_proplist(XDROutput* m_out, const map<string, string>& props) {
     m_out->write(props.size());
-    for (map<string, string>::iterator it = props.begin(); it != props.end(); it++) {
+    for (map<string, string>::const_iterator it = props.begin(); it != props.end(); it++) {
         m_out->write(it->first);
         write_ni_namelist(m_out, NetInfoNode::getPropValues(props, it->first));
     }
 }
 
+// The property list of a node is encoded once and then copied to replies
+static void write_ni_proplist(XDROutput* m_out, const NetInfoNode& node) {
+    if(node.mPropsXDR.empty()) {
+        size_t start = m_out->getPosition();
+        write_ni_proplist(m_out, node.mProps);
+        if(m_out->getPosition() < m_out->getCapacity())
+            node.mPropsXDR.assign(m_out->data() + start, m_out->data() + m_out->getPosition());
+    } else {
+        m_out->write(&node.mPropsXDR[0], node.mPropsXDR.size());
+    }
+}
+
 static string to_string(const map<string, string>& m) {
     string result;
     for(map<string,string>::const_iterator it = m.begin(); it != m.end(); it++) {
@@ -219,7 +231,7 @@ int CNetInfoProg::procedureREAD() {
     m_out->write(status);
     if(status == NI_OK) {
         write_ni_id(m_out, ni_id);
-        write_ni_proplist(m_out, node->mProps);
+        write_ni_proplist(m_out, *node);
 #if DBG
         dbg << to_string(node->mProps);
 #endif
@@ -288,17 +300,17 @@ int CNetInfoProg::procedureLOOKUP() {
     dbg << key << ":" << value << " =";
 #endif
 
-    if(node && node->find(key, value).empty())
+    const vector<NetInfoNode*>* nodes = node ? &node->lookup(key, value) : nullptr;
+    if(nodes && nodes->empty())
         status = NI_NODIR;
     
     m_out->write(status);
     if(status == NI_OK) {
-        vector<NetInfoNode*> nodes = node->find(key, value);
-        m_out->write(nodes.size());
-        for(size_t i = 0; i < nodes.size(); i++) {
-            m_out->write(nodes[i]->mId.object);
+        m_out->write(nodes->size());
+        for(size_t i = 0; i < nodes->size(); i++) {
+            m_out->write((*nodes)[i]->mId.object);
 #if DBG
-            dbg << " " << nodes[i]->mId.object;
+            dbg << " " << (*nodes)[i]->mId.object;
 #endif
         }
         write_ni_id(m_out, ni_id);
@@ -494,29 +506,37 @@ int CNetInfoProg::procedureLOOKUPREAD() {
     dbg << key << ":" << value << " =";
 #endif
 
-    if(node && node->find(key, value).empty())
+    const vector<NetInfoNode*>* nodes = node ? &node->lookup(key, value) : nullptr;
+    if(nodes && nodes->empty())
         status = NI_NODIR;
         
     m_out->write(status);
     if(status == NI_OK) {
-        map<string, string> result;
-        vector<NetInfoNode*> nodes = node->find(key, value);
-        for(size_t i = 0; i < nodes.size(); i++) {
-            for(map<string,string>::const_iterator it = nodes[i]->mProps.begin(); it != nodes[i]->mProps.end(); it++) {
-                if(result.find(it->first) == result.end())
-                    result[it->first] = it->second;
-                else {
-                    result[it->first] += ",";
-                    result[it->first] += it->second;
+        write_ni_id(m_out, ni_id);
+        if(nodes->size() == 1) {
+            write_ni_proplist(m_out, *(*nodes)[0]);
+#if DBG
+            dbg << to_string((*nodes)[0]->mProps);
+#endif
+        } else {
+            map<string, string> result;
+            for(size_t i = 0; i < nodes->size(); i++) {
+                const map<string, string>& props = (*nodes)[i]->mProps;
+                for(map<string,string>::const_iterator it = props.begin(); it != props.end(); it++) {
+                    map<string,string>::iterator found = result.find(it->first);
+                    if(found == result.end())
+                        result[it->first] = it->second;
+                    else {
+                        found->second += ",";
+                        found->second += it->second;
+                    }
                 }
             }
-        }
-
-        write_ni_id(m_out, ni_id);
-        write_ni_proplist(m_out, result);
+            write_ni_proplist(m_out, result);
 #if DBG
-        dbg << to_string(result);
+            dbg << to_string(result);
 #endif
+        }
     }
     
 #if DBG
@@ -528,6 +548,7 @@ int CNetInfoProg::procedureLOOKUPREAD() {
 NetInfoNode* NetInfoNode::add(const map<string, string>& props) {
     NetInfoNode* result = new NetInfoNode(mIdmap, this, props);
     mChildren.push_back(result);
+    mIndexValid = false;
     return result;
 }
 
@@ -540,6 +561,7 @@ NetInfoNode* NetInfoNode::addEx(const map<string, string>& props) {
     if(nodes.empty()) {
         result = new NetInfoNode(mIdmap, this, props);
         mChildren.push_back(result);
+        mIndexValid = false;
     } else
         result = nodes[0];
     return result;
@@ -547,6 +569,8 @@ NetInfoNode* NetInfoNode::addEx(const map<string, string>& props) {
 
 void NetInfoNode::add(const string& key, const string& value) {
     mProps[key] = value;
+    mPropsXDR.clear();
+    if(mParent) mParent->mIndexValid = false;
 }
 
 NetInfoNode* NetInfoNode::find(struct ni_id& ni_id, ni_status& status, bool forWrite) const {
@@ -562,20 +586,30 @@ NetInfoNode* NetInfoNode::find(struct ni_id& ni_id, ni_status& status, bool forW
 }
 
 vector<NetInfoNode*> NetInfoNode::find(const string& key, const string& value) const {
-    vector<NetInfoNode*> result;
-    for(size_t i = 0; i < mChildren.size(); i++) {
-        if(mChildren[i]->mProps.find(key) != mChildren[i]->mProps.end() &&
-           mChildren[i]->mProps[key] == value)
-            result.push_back(mChildren[i]);
+    return lookup(key, value);
+}
+
+const vector<NetInfoNode*>& NetInfoNode::lookup(const string& key, const string& value) const {
+    static const vector<NetInfoNode*> none;
+    if(!(mIndexValid)) {
+        mIndex.clear();
+        for(size_t i = 0; i < mChildren.size(); i++) {
+            const map<string, string>& props = mChildren[i]->mProps;
+            for(map<string,string>::const_iterator it = props.begin(); it != props.end(); it++)
+                mIndex[make_pair(it->first, it->second)].push_back(mChildren[i]);
+        }
+        mIndexValid = true;
     }
-    return result;
+    NIIndex::const_iterator it = mIndex.find(make_pair(key, value));
+    return it == mIndex.end() ? none : it->second;
 }
 
 void NetInfoNode::remove(NetInfoNode* node) {
-    for(vector<NetInfoNode*>::const_iterator it = mChildren.begin(); it != mChildren.end(); it++) {
+    for(vector<NetInfoNode*>::iterator it = mChildren.begin(); it != mChildren.end(); it++) {
         if(*it == node) {
             mChildren.erase(it);
-            delete *it;
+            mIndexValid = false;
+            delete node;
             return;
         }
     }
@@ -632,7 +666,7 @@ string NetInfoNode::getPath() {
     string result;
     if(mParent) {
         result += mParent->getPath();
-        result += mProps["name"];
+        result += getPropValue("name");
     }
     result += "/";
     return result;
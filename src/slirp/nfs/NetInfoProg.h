@@ -55,6 +55,8 @@ struct ni_id {
     ni_id(uint32_t object) : object(object), instance(1) {}
 };
 
+typedef std::map<std::pair<std::string, std::string>, std::vector<NetInfoNode*> > NIIndex;
+
 class NetInfoNode {
 public:
     ni_id                              mId;
@@ -62,16 +64,23 @@ public:
     NetInfoNode*                       mParent;
     std::map<std::string, std::string> mProps;
     std::vector<NetInfoNode*>          mChildren;
+    // Children by (property, value) and the XDR encoded property list, both
+    // are built on first use and dropped when the node or a child changes.
+    mutable NIIndex                    mIndex;
+    mutable bool                       mIndexValid;
+    mutable std::vector<uint8_t>       mPropsXDR;
     NetInfoNode(NIIDMap& idmap, NetInfoNode* parent, const std::map<std::string, std::string>& props)
     : mId(idmap.size())
     , mIdmap(idmap)
     , mParent(parent)
     , mProps(props)
+    , mIndexValid(false)
     {idmap[mId.object] = this;}
     NetInfoNode(NIIDMap& idmap, NetInfoNode* parent)
     : mId(idmap.size())
     , mIdmap(idmap)
     , mParent(parent)
+    , mIndexValid(false)
     {idmap[mId.object] = this;}
     NetInfoNode*              add(const std::map<std::string, std::string>& props);
     NetInfoNode*              addEx(const std::map<std::string, std::string>& props);
@@ -79,6 +88,7 @@ public:
     void                      remove(NetInfoNode* node);
     NetInfoNode*              find(struct ni_id& ni_id, ni_status& status, bool forWrite = false) const;
     std::vector<NetInfoNode*> find(const std::string& key, const std::string& value) const;
+    const std::vector<NetInfoNode*>& lookup(const std::string& key, const std::string& value) const;
     int                       checksum(void);
     std::string               getPath(void);
     std::string               getPropValue(const std::string& key) const;
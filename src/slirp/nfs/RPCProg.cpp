@@ -1,96 +1,154 @@
-#include <stdarg.h>
-#include <stdio.h>
-
-#include "RPCProg.h"
-#include "TCPServerSocket.h"
-#include "UDPServerSocket.h"
-
-using namespace std;
-
-CRPCProg::CRPCProg(int progNum, int version, const string& name) : m_bLogOn(true), m_progNum(progNum), m_version(version), m_name(name), m_portTCP(0), m_portUDP(0) {
-    #define RPC_PROG_CLASS CRPCProg
-    SET_PROC(0, NULL);
-}
-
-CRPCProg::~CRPCProg() {}
-
-void CRPCProg::init(uint16_t portTCP, uint16_t portUDP) {
-    m_portTCP = portTCP;
-    m_portUDP = portUDP;
-    log(" init tcp:%d->%d udp:%d->%d",
-        getPortTCP(), TCPServerSocket::toLocalPort(getPortTCP()),
-        getPortUDP(), UDPServerSocket::toLocalPort(getPortUDP()));
-}
-
-void CRPCProg::setup(XDRInput* xin, XDROutput* xout, ProcessParam* param) {
-    m_in     = xin;
-    m_out    = xout;
-    m_param = param;
-}
-
-int CRPCProg::process(void) {
-    PPROC  proc = &CRPCProg::procedureNOTIMPL;
-    string name("NOTIMPL");
-    if(m_param->proc < m_procs.size() && m_procs[m_param->proc]) {
-        proc = m_procs[m_param->proc]->m_proc;
-        name = m_procs[m_param->proc]->m_name;
-    }
-    int result = (this->*proc)();
-    if(result == PRC_NOTIMP) log(" %d(...) = %d", m_param->proc, result);
-    else                     log(" %s(...) = %d", name.c_str(),  result);
-    return result;
-}
-
-void CRPCProg::setProc(int procNum, const string& name, PPROC proc) {
-    while(m_procs.size() <= procNum)
-        m_procs.push_back(nullptr);
-    m_procs[procNum] = new RPCProc(proc, name);
-}
-
-void CRPCProg::setLogOn(bool bLogOn) {
-	m_bLogOn = bLogOn;
-}
-
-int CRPCProg::getProgNum(void) const {
-    return m_progNum;
-}
-
-int CRPCProg::getVersion(void) const {
-    return m_version;
-}
-
-string CRPCProg::getName(void) const {
-    return m_name;
-}
-
-uint16_t CRPCProg::getPortTCP(void) const {
-    return m_portTCP;
-}
-
-uint16_t CRPCProg::getPortUDP(void) const {
-    return m_portUDP;
-}
-
-int CRPCProg::procedureNULL(void) {
-    return PRC_OK;
-}
-
-int CRPCProg::procedureNOTIMPL(void) {
-    return PRC_NOTIMP;
-}
-
-size_t CRPCProg::log(const char *format, ...) const {
-	va_list vargs;
-	int nResult;
-
-	nResult = 0;
-	if (m_bLogOn)
-	{
-		va_start(vargs, format);
-        printf("[NFSD:%s:%d] ", m_name.c_str(), getProgNum());
-		nResult = vprintf(format, vargs);
-        printf("\n");
-		va_end(vargs);
-	}
-	return nResult;
-}
+#include <stdarg.h>
+#include <stdio.h>
+#include <inttypes.h>
+
+#include "RPCProg.h"
+#include "host.h"
+#include "TCPServerSocket.h"
+#include "UDPServerSocket.h"
+
+using namespace std;
+
+CRPCProg::CRPCProg(int progNum, int version, const string& name) : m_bLogOn(true), m_progNum(progNum), m_version(version), m_name(name), m_portTCP(0), m_portUDP(0) {
+    #define RPC_PROG_CLASS CRPCProg
+    SET_PROC(0, NULL);
+}
+
+CRPCProg::~CRPCProg() {}
+
+void CRPCProg::init(uint16_t portTCP, uint16_t portUDP) {
+    m_portTCP = portTCP;
+    m_portUDP = portUDP;
+    log(" init tcp:%d->%d udp:%d->%d",
+        getPortTCP(), TCPServerSocket::toLocalPort(getPortTCP()),
+        getPortUDP(), UDPServerSocket::toLocalPort(getPortUDP()));
+}
+
+void CRPCProg::setup(XDRInput* xin, XDROutput* xout, ProcessParam* param) {
+    m_in     = xin;
+    m_out    = xout;
+    m_param = param;
+}
+
+int CRPCProg::process(void) {
+    PPROC     proc  = &CRPCProg::procedureNOTIMPL;
+    string    name("NOTIMPL");
+    RPCStats* stats = NULL;
+    if(m_param->proc < m_procs.size() && m_procs[m_param->proc]) {
+        proc  = m_procs[m_param->proc]->m_proc;
+        name  = m_procs[m_param->proc]->m_name;
+        stats = &m_procs[m_param->proc]->m_stats;
+    }
+    uint64_t start    = host_time_us();
+    size_t   bytesIn  = m_in->size()  - m_in->getPosition();
+    size_t   bytesOut = m_out->getPosition();
+    int result = (this->*proc)();
+    if(stats) {
+        uint64_t time   = host_time_us() - start;
+        int      bucket = 0;
+        while(bucket < RPC_HIST_BUCKETS - 1 && time >= (uint64_t)RPC_HIST_MIN_US << bucket)
+            bucket++;
+        stats->calls++;
+        stats->bytesIn  += bytesIn;
+        stats->bytesOut += m_out->getPosition() - bytesOut;
+        stats->timeUs   += time;
+        stats->hist[bucket]++;
+        if(time > stats->maxUs) stats->maxUs = time;
+    }
+    if(result == PRC_NOTIMP) log(" %d(...) = %d", m_param->proc, result);
+    else                     log(" %s(...) = %d", name.c_str(),  result);
+    return result;
+}
+
+void CRPCProg::setProc(int procNum, const string& name, PPROC proc) {
+    while(m_procs.size() <= procNum)
+        m_procs.push_back(nullptr);
+    m_procs[procNum] = new RPCProc(proc, name);
+}
+
+void CRPCProg::setLogOn(bool bLogOn) {
+	m_bLogOn = bLogOn;
+}
+
+int CRPCProg::getProgNum(void) const {
+    return m_progNum;
+}
+
+int CRPCProg::getVersion(void) const {
+    return m_version;
+}
+
+string CRPCProg::getName(void) const {
+    return m_name;
+}
+
+uint16_t CRPCProg::getPortTCP(void) const {
+    return m_portTCP;
+}
+
+uint16_t CRPCProg::getPortUDP(void) const {
+    return m_portUDP;
+}
+
+// Programs that forward calls to other programs report those too
+void CRPCProg::getStatsProgs(vector<const CRPCProg*>& progs) const {
+    progs.push_back(this);
+}
+
+void CRPCProg::getStatsTotal(uint64_t& calls, uint64_t& timeUs) const {
+    for(size_t i = 0; i < m_procs.size(); i++) {
+        if(m_procs[i]) {
+            calls  += m_procs[i]->m_stats.calls;
+            timeUs += m_procs[i]->m_stats.timeUs;
+        }
+    }
+}
+
+// Upper latency bound of the given fraction of calls
+static uint64_t percentile(const RPCStats& stats, double fraction) {
+    uint64_t count = 0;
+    for(int i = 0; i < RPC_HIST_BUCKETS - 1; i++) {
+        count += stats.hist[i];
+        if(count >= stats.calls * fraction)
+            return (uint64_t)RPC_HIST_MIN_US << i;
+    }
+    return stats.maxUs;
+}
+
+// The counters are updated under the program lock and read without it,
+// so a report taken while calls are running may be slightly off.
+void CRPCProg::printStats(FILE* f) const {
+    fprintf(f, "%s (program %u version %u)\n", m_name.c_str(), m_progNum, m_version);
+    for(size_t i = 0; i < m_procs.size(); i++) {
+        if(!(m_procs[i]) || m_procs[i]->m_stats.calls == 0) continue;
+        const RPCStats& s = m_procs[i]->m_stats;
+        fprintf(f, "  %-12s %9" PRIu64 " calls %11" PRIu64 " bytes in %11" PRIu64 " bytes out, "
+                "avg %6" PRIu64 " us, p50 <%6" PRIu64 " us, p99 <%6" PRIu64 " us, max %7" PRIu64 " us\n",
+                m_procs[i]->m_name.c_str(), s.calls, s.bytesIn, s.bytesOut, s.timeUs / s.calls,
+                percentile(s, 0.5), percentile(s, 0.99), s.maxUs);
+    }
+}
+
+int CRPCProg::procedureNULL(void) {
+    return PRC_OK;
+}
+
+int CRPCProg::procedureNOTIMPL(void) {
+    return PRC_NOTIMP;
+}
+
+size_t CRPCProg::log(const char *format, ...) const {
+	va_list vargs;
+	int nResult;
+
+	nResult = 0;
+	if (m_bLogOn)
+	{
+		va_start(vargs, format);
+        printf("[NFSD:%s:%d] ", m_name.c_str(), getProgNum());
+		nResult = vprintf(format, vargs);
+        printf("\n");
+		va_end(vargs);
+	}
+	return nResult;
+}
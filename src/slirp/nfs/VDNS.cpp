@@ -14,6 +14,8 @@
 #include <iomanip>
 #include <string>
 #include <sstream>
+#include <map>
+#include <time.h>
 
 #ifdef _WIN32
 #include <Winsock2.h>
@@ -26,6 +28,130 @@ using namespace std;
 vector<vdns_record> VDNS::sDB;
 vdns_record         VDNS::errNoSuchName;
 
+static uint32_t get16(const uint8_t* p) {return (p[0] << 8) | p[1];}
+static uint32_t get32(const uint8_t* p) {return (get16(p) << 16) | get16(p + 2);}
+
+// Returns the offset behind a possibly compressed name or 0 if it is invalid
+static size_t skip_name(const uint8_t* msg, size_t off, size_t size) {
+    while(off < size) {
+        if(msg[off] == 0)           return off + 1;
+        if((msg[off] & 0xC0) == 0xC0) return off + 2 <= size ? off + 2 : 0;
+        if(msg[off] > 63)           return 0;
+        off += msg[off] + 1;
+    }
+    return 0;
+}
+
+// Length of the question (name, type and class) at the start of 'q'
+static size_t question_size(const uint8_t* q, size_t size) {
+    size_t off = skip_name(q, 0, size);
+    return (off && off + 4 <= size) ? off + 4 : 0;
+}
+
+// Answers of the host's DNS server are kept for their TTL, repeated
+// queries of the guest are then answered by VDNS without going upstream.
+// Entries are looked up by their question, the name is compared without
+// case. The SLiRP thread adds entries and checks for them, the VDNS
+// server thread sends them.
+class VDNSCache {
+    struct Entry {
+        vector<uint8_t> msg;
+        vector<size_t>  ttlOffsets;
+        time_t          expires;
+        uint32_t        ttl;
+    };
+    static const size_t   LIMIT   = 256;
+    static const uint32_t MAX_TTL = 3600;
+
+    mutex_t*            mutex;
+    map<string, Entry>  entries;
+
+    static string key(const uint8_t* q, size_t qsize) {
+        string result;
+        for(size_t i = 0; i < qsize; i++)
+            result.push_back(tolower(q[i]));
+        return result;
+    }
+public:
+    VDNSCache(void) : mutex(host_mutex_create()) {}
+    ~VDNSCache(void) {host_mutex_destroy(mutex);}
+
+    void store(const uint8_t* msg, size_t size) {
+        // only complete, successful responses to a single question
+        if(size < 12 || !(msg[2] & 0x80) || (msg[2] & 0x02) || (msg[3] & 0x0F)) return;
+        if(get16(&msg[4]) != 1 || get16(&msg[6]) == 0) return;
+        size_t qsize = question_size(&msg[12], size - 12);
+        if(!(qsize)) return;
+
+        Entry    entry;
+        uint32_t ttl     = MAX_TTL;
+        uint32_t records = get16(&msg[6]) + get16(&msg[8]) + get16(&msg[10]);
+        size_t   off     = 12 + qsize;
+        for(uint32_t i = 0; i < records; i++) {
+            off = skip_name(msg, off, size);
+            if(!(off) || off + 10 > size) return;
+            if(get16(&msg[off]) != 41) { // the TTL of OPT records holds flags
+                entry.ttlOffsets.push_back(off + 4);
+                if(get32(&msg[off + 4]) < ttl) ttl = get32(&msg[off + 4]);
+            }
+            off += 10 + get16(&msg[off + 8]);
+            if(off > size) return;
+        }
+        if(ttl == 0) return;
+
+        entry.msg.assign(msg, msg + size);
+        entry.ttl     = ttl;
+        entry.expires = time(NULL) + ttl;
+
+        NFSDLock lock(mutex);
+        if(entries.size() >= LIMIT) {
+            time_t now = time(NULL);
+            for(map<string, Entry>::iterator it = entries.begin(); it != entries.end();) {
+                if(it->second.expires <= now) entries.erase(it++);
+                else                          it++;
+            }
+            if(entries.size() >= LIMIT) entries.clear();
+        }
+        entries[key(&msg[12], qsize)] = entry;
+    }
+
+    bool has(const uint8_t* q, size_t size) {
+        size_t qsize = question_size(q, size);
+        if(!(qsize)) return false;
+        NFSDLock lock(mutex);
+        map<string, Entry>::const_iterator it = entries.find(key(q, qsize));
+        return it != entries.end() && it->second.expires > time(NULL);
+    }
+
+    // Write the cached answer for the query 'msg' with its ID and question
+    // and the remaining TTLs. An entry that expired after has() said yes
+    // is still used.
+    bool answer(const uint8_t* msg, size_t size, XDROutput* out) {
+        size_t qsize = size > 12 ? question_size(&msg[12], size - 12) : 0;
+        if(!(qsize)) return false;
+        NFSDLock lock(mutex);
+        map<string, Entry>::const_iterator it = entries.find(key(&msg[12], qsize));
+        if(it == entries.end()) return false;
+
+        vector<uint8_t> reply(it->second.msg);
+        memcpy(&reply[0],  &msg[0],  2);     // ID
+        memcpy(&reply[12], &msg[12], qsize); // question in the case of the query
+        reply[2] = (reply[2] & ~0x01) | (msg[2] & 0x01); // RD
+        time_t   left = it->second.expires - time(NULL);
+        uint32_t ttl  = left > 0 ? static_cast<uint32_t>(left) : 1;
+        for(size_t i = 0; i < it->second.ttlOffsets.size(); i++) {
+            uint8_t* p = &reply[it->second.ttlOffsets[i]];
+            if(get32(p) > ttl) {
+                p[0] = ttl >> 24; p[1] = ttl >> 16; p[2] = ttl >> 8; p[3] = ttl;
+            }
+        }
+        out->write(&reply[0], reply.size());
+        return true;
+    }
+};
+
+static VDNSCache s_cache;
+
 static size_t domain_name(uint8_t* dst, const char* src) {
     size_t   result = strlen(src) + 2;
     uint8_t* len    = dst++;
@@ -157,11 +283,16 @@ extern "C" int vdns_match(struct mbuf *m, uint32_t addr, int dport) {
     if(m->m_len > 40 &&
        dport == PORT_DNS &&
        addr == (CTL_NET | CTL_DNS))
-        return VDNS::query(reinterpret_cast<uint8_t*>(&m->m_data[40]), m->m_len-40) != NULL;
+        return VDNS::query(reinterpret_cast<uint8_t*>(&m->m_data[40]), m->m_len-40) != NULL ||
+               s_cache.has(reinterpret_cast<uint8_t*>(&m->m_data[40]), m->m_len-40);
     else
         return false;
 }
 
+extern "C" void vdns_cache_answer(const uint8_t* msg, size_t size) {
+    s_cache.store(msg, size);
+}
+
 extern "C" void vdns_udp_map_to_local_port(uint32_t* ipNBO, uint16_t* dportNBO) {
     switch(ntohs(*dportNBO)) {
         case PORT_DNS:
@@ -184,6 +315,12 @@ void VDNS::socketReceived(CSocket* pSocket, uint32_t header) {
     size_t       off = 12;
     vdns_record* rec = query(&msg[off], in->size()-(in->getPosition()+off));
 
+    if(!(rec) && s_cache.answer(msg, in->size()-in->getPosition(), out)) {
+        printf("[VDNS] reply from cache.\n");
+        pSocket->send();
+        return;
+    }
+
     if(rec == &errNoSuchName) {
         /*
         1... .... .... .... = Response: Message is a response
@@ -55,10 +55,12 @@ public:
     void   socketReceived(CSocket* pSocket, uint32_t header);
 };
 
-extern "C" int vdns_match(struct mbuf *m, uint32_t addr, int dport);
+extern "C" int  vdns_match(struct mbuf *m, uint32_t addr, int dport);
+extern "C" void vdns_cache_answer(const uint8_t* msg, size_t size);
 #else
     int  vdns_match(struct mbuf *m, uint32_t addr, int dport);
     void vdns_udp_map_to_local_port(uint32_t* ipNBO, uint16_t* dportNBO);
+    void vdns_cache_answer(const uint8_t* msg, size_t size);
 #endif /* __cplusplus */
 
 #endif /* VDNS_h */
@@ -39,13 +39,16 @@ extern "C" {
 #endif
     
     void nfsd_start(void);
+    void nfsd_tick(void);
     int  nfsd_match_addr(uint32_t addr);
 
 #ifdef __cplusplus
 }
 #else
     int  nfsd_read(const char* path, size_t fileOffset, void* dst, size_t count);
+    int  nfsd_file_info(const char* path, size_t* size, time_t* mtime);
     void nfsd_udp_map_to_local_port(uint32_t* ip, uint16_t* dport);
+    const uint8_t* nfsd_udp_call(uint16_t port, uint8_t* data, size_t size, size_t* replySize);
     void udp_map_from_local_port(uint16_t port, uint32_t* saddrNBO, uint16_t* sin_portNBO);
     void nfsd_tcp_map_to_local_port(uint16_t port, uint32_t* saddrNBO, uint16_t* sin_portNBO);
 #endif
@@ -341,9 +341,10 @@ int slirp_select_fill(int *pnfds,
 
 	/*
 	 * Adjust the timeout to make the minimum timeout
-	 * 2ms (XXX?) to lessen the CPU load
+	 * 2ms (XXX?) to lessen the CPU load. Keep -1 if no
+	 * timer is pending, the caller decides how long to wait.
 	 */
-	if (timeout < (FAST_TIMO * 1000))
+	if (timeout >= 0 && timeout < (FAST_TIMO * 1000))
 		timeout = FAST_TIMO * 1000;
 
 	return timeout;
@@ -609,6 +610,23 @@ static void arp_input(const uint8_t *pkt, int pkt_len)
     }
 }
 
+/* mbuf that the next packet from the guest can be written to */
+static struct mbuf *input_mbuf;
+
+/* Return a buffer of *size bytes for the next packet. If that packet is
+ * passed to slirp_input() it is used without copying. */
+uint8_t *slirp_input_buffer(int *size)
+{
+    if (!input_mbuf) {
+        input_mbuf = m_get();
+        if (!input_mbuf)
+            return NULL;
+    }
+    /* Note: we add to align the IP header */
+    *size = input_mbuf->m_size - 2;
+    return (uint8_t *)input_mbuf->m_data + 2;
+}
+
 void slirp_input(const uint8_t *pkt, int pkt_len)
 {
     struct mbuf *m;
@@ -623,12 +641,19 @@ void slirp_input(const uint8_t *pkt, int pkt_len)
         arp_input(pkt, pkt_len);
         break;
     case ETH_P_IP:
-        m = m_get();
-        if (!m)
-            return;
-        /* Note: we add to align the IP header */
-        m->m_len = pkt_len + 2;
-        memcpy(m->m_data + 2, pkt, pkt_len);
+        if (input_mbuf && pkt == (uint8_t *)input_mbuf->m_data + 2) {
+            /* The packet is already in the mbuf */
+            m = input_mbuf;
+            input_mbuf = NULL;
+            m->m_len = pkt_len + 2;
+        } else {
+            m = m_get();
+            if (!m)
+                return;
+            /* Note: we add to align the IP header */
+            m->m_len = pkt_len + 2;
+            memcpy(m->m_data + 2, pkt, pkt_len);
+        }
 
         m->m_data += 2 + ETH_HLEN;
         m->m_len -= 2 + ETH_HLEN;
@@ -311,10 +311,8 @@ void if_output(struct socket *, struct mbuf *);
 /* ip_input.c */
 void ip_init(void);
 void ip_input(struct mbuf *);
-struct ip * ip_reass(register struct ip *ip, register struct ipq *);
+struct mbuf * ip_reass(struct mbuf *, struct ipq *);
 void ip_freef(struct ipq *);
-void ip_enq(register struct ipasfrag *, register struct ipasfrag *);
-void ip_deq(register struct ipasfrag *);
 void ip_slowtimo(void);
 void ip_stripoptions(register struct mbuf *, struct mbuf *);
 
@@ -12,6 +12,11 @@
 /* Define to 1 if you want KEEPALIVE timers */
 #define DO_KEEPALIVE 0
 
+/* Define to 1 to skip verifying TCP and UDP checksums of packets sent by
+ * the guest. They come straight from the emulated network interface and
+ * can't be damaged on the way. */
+#define TRUST_GUEST_CKSUM 1
+
 /* Define to MAX interfaces you expect to use at once */
 /* MAX_INTERFACES determines the max. TOTAL number of interfaces (SLIP and PPP) */
 /* MAX_PPP_INTERFACES determines max. number of PPP interfaces */
@@ -59,6 +64,9 @@
 
 /* Define if you have readv */
 #undef HAVE_READV
+#ifndef _WIN32
+#define HAVE_READV
+#endif
 
 /* Define if iovec needs to be declared */
 #undef DECLARE_IOVEC
@@ -284,7 +284,9 @@ mbufstats(void)
 	for (m = m_usedlist.m_next; m != &m_usedlist; m = m->m_next)
 		i++;
 	lprint("  %6d mbufs on used list\r\n",  i);
-        lprint("  %6d mbufs queued as packets\r\n\r\n", if_queued);
+        lprint("  %6d mbufs queued as packets\r\n", if_queued);
+	m_ext_stats();
+	lprint("\r\n");
 }
 
 void
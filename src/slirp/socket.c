@@ -29,12 +29,67 @@ so_init(void)
 }
 
 
+/*
+ * Sockets are found through a hash table per list. TCP sockets are
+ * hashed on all four addresses and ports, UDP sockets only on the
+ * local (guest) side, as that is how udp_input() matches them.
+ */
+static struct socket *tcb_hash[SO_HASH_SIZE];
+static struct socket *udb_hash[SO_HASH_SIZE];
+
+static struct socket **
+sohash_bucket(struct socket *head, struct in_addr laddr, u_int lport, struct in_addr faddr, u_int fport)
+{
+	u_int32_t h;
+
+	if (head == &udb) {
+		h = laddr.s_addr ^ lport;
+	} else {
+		h = laddr.s_addr ^ faddr.s_addr ^ ((u_int32_t)lport << 16) ^ fport;
+	}
+	h ^= h >> 16;
+	h *= 0x45d9f3b;
+	h ^= h >> 16;
+
+	return &(head == &udb ? udb_hash : tcb_hash)[h & (SO_HASH_SIZE - 1)];
+}
+
+static void
+sohash_remove(struct socket *so)
+{
+	if (so->so_hprev) {
+		*so->so_hprev = so->so_hnext;
+		if (so->so_hnext)
+		   so->so_hnext->so_hprev = so->so_hprev;
+		so->so_hnext = NULL;
+		so->so_hprev = NULL;
+	}
+}
+
+/*
+ * (Re)hash a socket of list head, must be called whenever
+ * the addresses or ports of the socket are changed
+ */
+void
+sohash(struct socket *head, struct socket *so)
+{
+	struct socket **bucket;
+
+	sohash_remove(so);
+	bucket = sohash_bucket(head, so->so_laddr, so->so_lport, so->so_faddr, so->so_fport);
+	so->so_hnext = *bucket;
+	so->so_hprev = bucket;
+	if (*bucket)
+	   (*bucket)->so_hprev = &so->so_hnext;
+	*bucket = so;
+}
+
 struct socket *
 solookup(struct socket *head, struct in_addr laddr, u_int lport, struct in_addr faddr, u_int fport)
 {
 	struct socket *so;
 	
-	for (so = head->so_next; so != head; so = so->so_next) {
+	for (so = *sohash_bucket(head, laddr, lport, faddr, fport); so; so = so->so_hnext) {
 		if (so->so_lport == lport && 
 		    so->so_laddr.s_addr == laddr.s_addr &&
 		    so->so_faddr.s_addr == faddr.s_addr &&
@@ -42,10 +97,24 @@ solookup(struct socket *head, struct in_addr laddr, u_int lport, struct in_addr
 		   break;
 	}
 	
-	if (so == head)
-	   return (struct socket *)NULL;
 	return so;
+}
+
+/*
+ * Find a UDP socket by its local address and port only
+ */
+struct socket *
+solookup_local(struct socket *head, struct in_addr laddr, u_int lport)
+{
+	struct socket *so;
+	
+	for (so = *sohash_bucket(head, laddr, lport, laddr, lport); so; so = so->so_hnext) {
+		if (so->so_lport == lport && 
+		    so->so_laddr.s_addr == laddr.s_addr)
+		   break;
+	}
 	
+	return so;
 }
 
 /*
@@ -84,6 +153,7 @@ sofree(struct socket *so)
 	
   m_free(so->so_m);
 	
+  sohash_remove(so);
   if(so->so_next && so->so_prev) 
     remque(so);  /* crashes if so is not in a queue */
 
@@ -470,6 +540,8 @@ sorecvfrom(struct socket *so)
 	      else
 		so->so_expire = curtime + SO_EXPIRE;
 	    }
+	    if (so->so_fport == htons(53))
+	      vdns_cache_answer((uint8_t *)m->m_data, m->m_len);
 
 	    /*		if (m->m_len == len) {
 	     *			m_inc(m, MINCSIZE);
@@ -574,6 +646,7 @@ solisten(u_int port, u_int32_t laddr, u_int lport, int flags)
 	so->so_state = (SS_FACCEPTCONN|flags);
 	so->so_lport = lport; /* Kept in network format */
 	so->so_laddr.s_addr = laddr; /* Ditto */
+	sohash(&tcb, so);
 	
 	memset(&addr, 0, sizeof(struct sockaddr_in));
 	addr.sin_family = AF_INET;
@@ -600,6 +673,7 @@ solisten(u_int port, u_int32_t laddr, u_int lport, int flags)
 	   so->so_faddr = alias_addr;
 	else
 	   so->so_faddr = addr.sin_addr;
+	sohash(&tcb, so);
 
 	so->s = s;
 	return so;
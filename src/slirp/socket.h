@@ -20,6 +20,8 @@
 #define SO_EXPIRE 240000
 #define SO_EXPIREFAST 10000
 
+#define SO_HASH_SIZE 256	/* Must be a power of 2 */
+
 #ifdef _WIN32
 #include <stdint.h>
 typedef uint8_t u_int8_t;
@@ -33,6 +35,7 @@ typedef uint32_t u_int32_t;
 
 struct socket {
   struct socket *so_next,*so_prev;      /* For a linked list of sockets */
+  struct socket *so_hnext,**so_hprev;   /* For the lookup hash table */
 
   int s;                           /* The actual socket */
 
@@ -100,6 +103,8 @@ extern "C" {
 #endif
 void so_init(void);
 struct socket * solookup(struct socket *, struct in_addr, u_int, struct in_addr, u_int);
+struct socket * solookup_local(struct socket *, struct in_addr, u_int);
+void sohash(struct socket *, struct socket *);
 struct socket * socreate(void);
 void sofree(struct socket *);
 int soread(struct socket *);
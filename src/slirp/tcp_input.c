@@ -295,6 +295,7 @@ void tcp_input(register struct mbuf *m, int iphlen, struct socket *inso)
     memset(&ti->ti_i.ih_mbuf, 0 , sizeof(struct mbuf_ptr));
 	ti->ti_x1 = 0;
 	ti->ti_len = htons((u_int16_t)tlen);
+#if !TRUST_GUEST_CKSUM
 	len = sizeof(struct ip) + tlen;
 	/* keep checksum for ICMP reply
 	 * ti->ti_sum = cksum(m, len);
@@ -303,6 +304,7 @@ void tcp_input(register struct mbuf *m, int iphlen, struct socket *inso)
 		tcpstat.tcps_rcvbadsum++;
 		goto drop;
 	}
+#endif
 
 	/*
 	 * Check that TCP offset makes sense,
@@ -404,6 +406,7 @@ findso:
 		so->so_lport = ti->ti_sport;
 		so->so_faddr = ti->ti_dst;
 		so->so_fport = ti->ti_dport;
+		sohash(&tcb, so);
 
 		if ((so->so_iptos = tcp_tos(so)) == 0)
 			so->so_iptos = ((struct ip *)ti)->ip_tos;
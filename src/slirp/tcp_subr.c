@@ -52,6 +52,21 @@ int	tcp_do_rfc1323 = 0;	/* Don't do rfc1323 performance enhancements */
 size_t	tcp_rcvspace;	/* You may want to change this */
 size_t	tcp_sndspace;	/* Keep small if you have an error prone link */
 
+/* Set TCP_NODELAY on host sockets */
+int tcp_nodelay = 1;
+
+/*
+ * Set the socket buffer size for new connections and whether host
+ * sockets send small segments at once
+ */
+void slirp_tcp_config(int bufsize, int nodelay)
+{
+	size_t minsize = 2*(min(if_mtu, if_mru) - sizeof(struct tcpiphdr));
+
+	tcp_rcvspace = tcp_sndspace = max((size_t)bufsize, minsize);
+	tcp_nodelay = nodelay;
+}
+
 /*
  * Tcp initialization
  */
@@ -391,6 +406,8 @@ int tcp_fconnect(struct socket *so)
     setsockopt(s,SOL_SOCKET,SO_REUSEADDR,(char *)&opt,sizeof(opt ));
     opt = 1;
     setsockopt(s,SOL_SOCKET,SO_OOBINLINE,(char *)&opt,sizeof(opt ));
+    opt = tcp_nodelay;
+    setsockopt(s,IPPROTO_TCP,TCP_NODELAY,(char *)&opt,sizeof(opt ));
     
     addr.sin_family = AF_INET;
     if ((so->so_faddr.s_addr & htonl(0xffffff00)) == special_addr.s_addr) {
@@ -484,7 +501,7 @@ void tcp_connect(struct socket *inso)
 	setsockopt(s,SOL_SOCKET,SO_REUSEADDR,(char *)&opt,sizeof(int));
 	opt = 1;
 	setsockopt(s,SOL_SOCKET,SO_OOBINLINE,(char *)&opt,sizeof(int));
-	opt = 1;
+	opt = tcp_nodelay;
 	setsockopt(s,IPPROTO_TCP,TCP_NODELAY,(char *)&opt,sizeof(int));
 	
 	so->so_fport = addr.sin_port;
@@ -492,6 +509,7 @@ void tcp_connect(struct socket *inso)
 	/* Translate connections from localhost to the real hostname */
 	if (so->so_faddr.s_addr == 0 || so->so_faddr.s_addr == loopback_addr.s_addr)
 	   so->so_faddr = alias_addr;
+	sohash(&tcb, so);
 	
 	/* Close the accept() socket, set right state */
 	if (inso->so_state & SS_FACCEPTONCE) {
@@ -821,6 +839,7 @@ int tcp_emu(struct socket *so, struct mbuf *m)
 				if (ns->so_faddr.s_addr == 0 || 
 					ns->so_faddr.s_addr == loopback_addr.s_addr)
                   ns->so_faddr = alias_addr;
+				sohash(&tcb, ns);
 
 				ns->so_iptos = tcp_tos(ns);
 				tp = sototcpcb(ns);
@@ -22,13 +22,31 @@
  * THE SOFTWARE.
  */
 
+#include <stdlib.h>
 #include <slirp.h>
 #include "configuration.h"
 #include "nfs/nfsd.h"
 
+/* Boot files are read once and then served from memory to all sessions */
+struct tftp_file {
+    char filename[TFTP_FILENAME_MAX];
+    u_int8_t *data;
+    size_t size;
+    time_t mtime;
+    int users;
+    int timestamp;
+};
+
 struct tftp_session {
     int in_use;
     char filename[TFTP_FILENAME_MAX];
+    struct tftp_file *file;     /* NULL if the file is read block by block */
+    size_t size;
+
+    u_int16_t blksize;
+    u_int16_t windowsize;
+    u_int32_t block_nr;         /* highest block sent */
+    u_int32_t last_block;
     
     struct in_addr client_ip;
     u_int16_t client_port;
@@ -38,8 +56,82 @@ struct tftp_session {
 
 struct tftp_session tftp_sessions[TFTP_SESSIONS_MAX];
 
+static struct tftp_file tftp_cache[TFTP_CACHE_MAX];
+
 const char *tftp_prefix = "/";
 
+static struct tftp_file *tftp_cache_get(const char *filename, size_t size, time_t mtime)
+{
+  struct tftp_file *f, *victim = NULL;
+  int k;
+
+  if (size > TFTP_CACHE_FILE_MAX) {
+    return NULL;
+  }
+
+  for (k = 0; k < TFTP_CACHE_MAX; k++) {
+    f = &tftp_cache[k];
+
+    if (f->data && !strcmp(f->filename, filename)) {
+      if (f->size == size && f->mtime == mtime) {
+        f->users++;
+        f->timestamp = curtime;
+        return f;
+      }
+      if (f->users) {
+        /* changed on disk while being served, read the new one per block */
+        return NULL;
+      }
+      free(f->data);
+      f->data = NULL;
+    }
+  }
+
+  /* take a free entry or the least recently used one */
+  for (k = 0; k < TFTP_CACHE_MAX; k++) {
+    f = &tftp_cache[k];
+
+    if (!f->data) {
+      victim = f;
+      break;
+    }
+    if (!f->users && (!victim || (int)(f->timestamp - victim->timestamp) < 0)) {
+      victim = f;
+    }
+  }
+
+  if (!victim) {
+    return NULL;
+  }
+
+  free(victim->data);
+  victim->data = malloc(size ? size : 1);
+  if (!victim->data) {
+    return NULL;
+  }
+  if (nfsd_read(filename, 0, victim->data, size) != (int)size) {
+    free(victim->data);
+    victim->data = NULL;
+    return NULL;
+  }
+  strncpy(victim->filename, filename, sizeof(victim->filename) - 1);
+  victim->filename[sizeof(victim->filename) - 1] = 0;
+  victim->size = size;
+  victim->mtime = mtime;
+  victim->users = 1;
+  victim->timestamp = curtime;
+
+  return victim;
+}
+
+static void tftp_cache_release(struct tftp_session *spt)
+{
+  if (spt->file) {
+    spt->file->users--;
+    spt->file = NULL;
+  }
+}
+
 static void tftp_session_update(struct tftp_session *spt)
 {
     spt->timestamp = curtime;
@@ -48,6 +140,7 @@ static void tftp_session_update(struct tftp_session *spt)
 
 static void tftp_session_terminate(struct tftp_session *spt)
 {
+  tftp_cache_release(spt);
   spt->in_use = 0;
 }
 
@@ -70,9 +163,12 @@ static int tftp_session_allocate(struct tftp_t *tp)
   return -1;
 
  found:
+  tftp_cache_release(spt);
   memset(spt, 0, sizeof(*spt));
   memcpy(&spt->client_ip, &tp->ip.ip_src, sizeof(spt->client_ip));
   spt->client_port = tp->udp.uh_sport;
+  spt->blksize = TFTP_BLKSIZE_DEFAULT;
+  spt->windowsize = 1;
 
   tftp_session_update(spt);
 
@@ -99,59 +195,116 @@ static int tftp_session_find(struct tftp_t *tp)
   return -1;
 }
 
-static int tftp_read_data(struct tftp_session *spt, u_int16_t block_nr,
-			  u_int8_t *buf, int len)
+static int tftp_read_data(struct tftp_session *spt, u_int32_t block_nr,
+			  u_int8_t *buf)
 {
-    int bytes_read = nfsd_read(spt->filename, block_nr * 512, buf, len);
-    return bytes_read < 0 ? -1 : bytes_read;
+    size_t offset = (size_t)block_nr * spt->blksize;
+    size_t len = 0;
+
+    if (offset < spt->size) {
+        len = spt->size - offset;
+        if (len > spt->blksize) {
+            len = spt->blksize;
+        }
+    }
+    if (spt->file) {
+        memcpy(buf, spt->file->data + offset, len);
+        return len;
+    }
+    if (len == 0) {
+        return 0;
+    }
+    return nfsd_read(spt->filename, offset, buf, len) == (int)len ? (int)len : -1;
+}
+
+static struct mbuf *tftp_prepare(struct tftp_t **tp)
+{
+  struct mbuf *m = m_get();
+
+  if (!m) {
+    return NULL;
+  }
+
+  memset(m->m_data, 0, m->m_size);
+
+  m->m_data += if_maxlinkhdr;
+  *tp = (void *)m->m_data;
+  m->m_data += sizeof(struct udpiphdr);
+
+  return m;
+}
+
+static void tftp_output(struct tftp_session *spt, struct mbuf *m,
+			struct tftp_t *recv_tp)
+{
+  struct sockaddr_in saddr, daddr;
+
+  saddr.sin_addr = recv_tp->ip.ip_dst;
+  saddr.sin_port = recv_tp->udp.uh_dport;
+
+  daddr.sin_addr = spt->client_ip;
+  daddr.sin_port = spt->client_port;
+
+  udp_output2(NULL, m, &saddr, &daddr, IPTOS_LOWDELAY);
 }
 
 static int tftp_send_error(struct tftp_session *spt, 
 			   u_int16_t errorcode, const char *msg,
 			   struct tftp_t *recv_tp)
 {
-  struct sockaddr_in saddr, daddr;
   struct mbuf *m;
   struct tftp_t *tp;
 
-  m = m_get();
+  m = tftp_prepare(&tp);
 
   if (!m) {
     return -1;
   }
 
-  memset(m->m_data, 0, m->m_size);
-
-  m->m_data += if_maxlinkhdr;
-  tp = (void *)m->m_data;
-  m->m_data += sizeof(struct udpiphdr);
-  
   tp->tp_op = htons(TFTP_ERROR);
   tp->x.tp_error.tp_error_code = htons(errorcode);
   strncpy((char *)tp->x.tp_error.tp_msg, msg, sizeof(tp->x.tp_error.tp_msg));
   tp->x.tp_error.tp_msg[sizeof(tp->x.tp_error.tp_msg)-1] = 0;
 
-  saddr.sin_addr = recv_tp->ip.ip_dst;
-  saddr.sin_port = recv_tp->udp.uh_dport;
+  m->m_len = 2 + 2 + strlen((char *)tp->x.tp_error.tp_msg) + 1;
 
-  daddr.sin_addr = spt->client_ip;
-  daddr.sin_port = spt->client_port;
+  tftp_output(spt, m, recv_tp);
 
-  m->m_len = sizeof(struct tftp_t) - 514 + 3 + strlen(msg) - 
-        sizeof(struct ip) - sizeof(struct udphdr);
+  tftp_session_terminate(spt);
 
-  udp_output2(NULL, m, &saddr, &daddr, IPTOS_LOWDELAY);
+  return 0;
+}
 
-  tftp_session_terminate(spt);
+/* acknowledge the options we accepted (RFC 2347) */
+static int tftp_send_oack(struct tftp_session *spt,
+			  const char *options, int len,
+			  struct tftp_t *recv_tp)
+{
+  struct mbuf *m;
+  struct tftp_t *tp;
+
+  m = tftp_prepare(&tp);
+
+  if (!m) {
+    return -1;
+  }
+
+  tp->tp_op = htons(TFTP_OACK);
+  memcpy(tp->x.tp_buf, options, len);
+
+  m->m_len = 2 + len;
+
+  tftp_output(spt, m, recv_tp);
+
+  tftp_session_update(spt);
 
   return 0;
 }
 
 static int tftp_send_data(struct tftp_session *spt, 
-			  u_int16_t block_nr,
+			  u_int32_t block_nr,
 			  struct tftp_t *recv_tp)
 {
-  struct sockaddr_in saddr, daddr;
   struct mbuf *m;
   struct tftp_t *tp;
   int nobytes;
@@ -160,59 +313,62 @@ static int tftp_send_data(struct tftp_session *spt,
     return -1;
   }
 
-  m = m_get();
+  m = tftp_prepare(&tp);
 
   if (!m) {
     return -1;
   }
 
-  memset(m->m_data, 0, m->m_size);
-
-  m->m_data += if_maxlinkhdr;
-  tp = (void *)m->m_data;
-  m->m_data += sizeof(struct udpiphdr);
-  
   tp->tp_op = htons(TFTP_DATA);
-  tp->x.tp_data.tp_block_nr = htons(block_nr);
-
-  saddr.sin_addr = recv_tp->ip.ip_dst;
-  saddr.sin_port = recv_tp->udp.uh_dport;
-
-  daddr.sin_addr = spt->client_ip;
-  daddr.sin_port = spt->client_port;
+  tp->x.tp_data.tp_block_nr = htons(block_nr & 0xffff);
 
-  nobytes = tftp_read_data(spt, block_nr - 1, tp->x.tp_data.tp_buf, 512);
+  nobytes = tftp_read_data(spt, block_nr - 1, tp->x.tp_data.tp_buf);
 
   if (nobytes < 0) {
     m_free(m);
 
     /* send "file not found" error back */
 
-    tftp_send_error(spt, 1, "File not found", tp);
+    tftp_send_error(spt, 1, "File not found", recv_tp);
 
     return -1;
   }
 
-  m->m_len = sizeof(struct tftp_t) - (512 - nobytes) - 
-        sizeof(struct ip) - sizeof(struct udphdr);
+  m->m_len = 2 + 2 + nobytes;
 
-  udp_output2(NULL, m, &saddr, &daddr, IPTOS_LOWDELAY);
+  tftp_output(spt, m, recv_tp);
 
-  if (nobytes == 512) {
-    tftp_session_update(spt);
-  }
-  else {
-    tftp_session_terminate(spt);
+  if (block_nr > spt->block_nr) {
+    spt->block_nr = block_nr;
   }
+  tftp_session_update(spt);
 
   return 0;
 }
 
+/* send up to windowsize blocks (RFC 7440) starting with block_nr */
+static void tftp_send_window(struct tftp_session *spt,
+			     u_int32_t block_nr,
+			     struct tftp_t *recv_tp)
+{
+  u_int32_t end = block_nr + spt->windowsize;
+
+  for (; block_nr < end && block_nr <= spt->last_block; block_nr++) {
+    if (tftp_send_data(spt, block_nr, recv_tp) < 0) {
+      return;
+    }
+  }
+}
+
 static void tftp_handle_rrq(struct tftp_t *tp, int pktlen)
 {
   struct tftp_session *spt;
-  int s, k, n;
-  u_int8_t *src, *dst;
+  int s, k, n, v;
+  u_int8_t *src, *dst, *end;
+  char *key, *value;
+  char oack[128];
+  int oack_len = 0;
+  time_t mtime;
 
   s = tftp_session_allocate(tp);
 
@@ -257,6 +413,8 @@ static void tftp_handle_rrq(struct tftp_t *tp, int pktlen)
       return;
   }
 
+  k += 6;
+
   /* do sanity checks on the filename */
 
   if ((spt->filename[0] != '/')
@@ -276,16 +434,60 @@ static void tftp_handle_rrq(struct tftp_t *tp, int pktlen)
 
   /* check if the file exists */
   
-  if (tftp_read_data(spt, 0, (u_int8_t *)spt->filename, 0) < 0) {
+  if (nfsd_file_info(spt->filename, &spt->size, &mtime) < 0) {
       tftp_send_error(spt, 1, "File not found", tp);
       return;
   }
 
-  tftp_send_data(spt, 1, tp);
+  /* options, unknown ones are ignored */
+
+  while (k < n) {
+    key = (char *)&src[k];
+    end = memchr(key, 0, n - k);
+    if (!end || end + 1 >= src + n) {
+      break;
+    }
+    value = (char *)end + 1;
+    end = memchr(value, 0, src + n - (u_int8_t *)value);
+    if (!end) {
+      break;
+    }
+    k = end + 1 - src;
+
+    if (!strcasecmp(key, "blksize") && (v = atoi(value)) >= 8) {
+      spt->blksize = v > TFTP_BLKSIZE_MAX ? TFTP_BLKSIZE_MAX : v;
+      oack_len += snprintf(oack + oack_len, sizeof(oack) - oack_len,
+                           "blksize%c%d", 0, spt->blksize) + 1;
+    } else if (!strcasecmp(key, "tsize")) {
+      oack_len += snprintf(oack + oack_len, sizeof(oack) - oack_len,
+                           "tsize%c%lu", 0, (unsigned long)spt->size) + 1;
+    } else if (!strcasecmp(key, "windowsize") && (v = atoi(value)) >= 1) {
+      spt->windowsize = v > TFTP_WINDOW_MAX ? TFTP_WINDOW_MAX : v;
+      oack_len += snprintf(oack + oack_len, sizeof(oack) - oack_len,
+                           "windowsize%c%d", 0, spt->windowsize) + 1;
+    }
+    if (oack_len >= (int)sizeof(oack)) {
+      oack_len = 0;
+      break;
+    }
+  }
+
+  /* the last block is shorter than blksize, maybe empty */
+  spt->last_block = spt->size / spt->blksize + 1;
+  spt->file = tftp_cache_get(spt->filename, spt->size, mtime);
+
+  if (oack_len) {
+    /* the client acknowledges with block 0 */
+    tftp_send_oack(spt, oack, oack_len, tp);
+  } else {
+    tftp_send_window(spt, 1, tp);
+  }
 }
 
 static void tftp_handle_ack(struct tftp_t *tp, int pktlen)
 {
+  struct tftp_session *spt;
+  u_int32_t block_nr;
   int s;
 
   s = tftp_session_find(tp);
@@ -294,11 +496,23 @@ static void tftp_handle_ack(struct tftp_t *tp, int pktlen)
     return;
   }
 
-  if (tftp_send_data(&tftp_sessions[s], 
-		     ntohs(tp->x.tp_data.tp_block_nr) + 1, 
-		     tp) < 0) {
+  spt = &tftp_sessions[s];
+
+  /* block numbers wrap around after 65535 blocks */
+  block_nr = (spt->block_nr & ~0xffffu) | ntohs(tp->x.tp_data.tp_block_nr);
+  if (block_nr > spt->block_nr) {
+    if (block_nr < 0x10000) {
+      return;
+    }
+    block_nr -= 0x10000;
+  }
+
+  if (block_nr >= spt->last_block) {
+    tftp_session_terminate(spt);
     return;
   }
+
+  tftp_send_window(spt, block_nr + 1, tp);
 }
 
 void tftp_input(struct mbuf *m)
@@ -9,9 +9,17 @@
 #define TFTP_DATA   3
 #define TFTP_ACK    4
 #define TFTP_ERROR  5
+#define TFTP_OACK   6
 
 #define TFTP_FILENAME_MAX 512
 
+#define TFTP_BLKSIZE_DEFAULT 512
+#define TFTP_BLKSIZE_MAX     1468   /* largest block in one unfragmented packet */
+#define TFTP_WINDOW_MAX      16
+
+#define TFTP_CACHE_MAX       4      /* boot files kept in memory */
+#define TFTP_CACHE_FILE_MAX  (32 * 1024 * 1024)
+
 #ifdef PRAGMA_PACK_SUPPORTED
 #pragma pack(1)
 #endif
@@ -23,13 +31,13 @@ struct tftp_t {
   union {
     struct { 
       u_int16_t tp_block_nr;
-      u_int8_t tp_buf[512];
+      u_int8_t tp_buf[TFTP_BLKSIZE_MAX];
     } tp_data;
     struct { 
       u_int16_t tp_error_code;
       u_int8_t tp_msg[512];
     } tp_error;
-    u_int8_t tp_buf[512 + 2];
+    u_int8_t tp_buf[TFTP_BLKSIZE_MAX + 2];
   } x;
 } PACKED__;
 
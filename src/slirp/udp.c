@@ -65,6 +65,43 @@ udp_init(void)
 {
 	udb.so_next = udb.so_prev = &udb;
 }
+/*
+ * Calls to the RPC programs of the built-in NFS server are answered
+ * in-process, the reply is sent back as if it came from the server
+ */
+static int
+udp_rpc_input(struct ip *ip, struct udphdr *uh, int len)
+{
+	struct sockaddr_in saddr, daddr;
+	const u_int8_t *reply;
+	size_t reply_len;
+	struct mbuf *m;
+
+	reply = nfsd_udp_call(ntohs(uh->uh_dport), (u_int8_t *)(uh + 1),
+	                      len - sizeof(struct udphdr), &reply_len);
+	if (reply == NULL)
+		return 0;
+
+	if ((m = m_get()) == NULL)
+		return 1;
+	m_inc(m, if_maxlinkhdr + sizeof(struct udpiphdr) + reply_len);
+	m->m_data += if_maxlinkhdr + sizeof(struct udpiphdr);
+	if (M_FREEROOM(m) < reply_len) {
+		m_free(m);
+		return 1;
+	}
+	memcpy(m->m_data, reply, reply_len);
+	m->m_len = reply_len;
+
+	saddr.sin_addr.s_addr = special_addr.s_addr | htonl(CTL_NFSD);
+	saddr.sin_port = uh->uh_dport;
+	daddr.sin_addr = ip->ip_src;
+	daddr.sin_port = uh->uh_sport;
+	udp_output2(NULL, m, &saddr, &daddr, IPTOS_LOWDELAY);
+
+	return 1;
+}
+
 /* m->m_data  points at ip packet header 
  * m->m_len   length ip packet 
  * ip->ip_len length data (IPDU)
@@ -127,7 +164,7 @@ udp_input(register struct mbuf *m, int iphlen)
 	/*
 	 * Checksum extended UDP header and data.
 	 */
-	if (udpcksum && uh->uh_sum) {
+	if (!TRUST_GUEST_CKSUM && udpcksum && uh->uh_sum) {
 	  memset(&((struct ipovly *)ip)->ih_mbuf, 0, sizeof(struct mbuf_ptr));
 	  ((struct ipovly *)ip)->ih_x1 = 0;
 	  ((struct ipovly *)ip)->ih_len = uh->uh_ulen;
@@ -147,6 +184,8 @@ udp_input(register struct mbuf *m, int iphlen)
     u_int16_t      dst_port = uh->uh_dport;
     
     if(nfsd_match_addr(ntohl(save_ip.ip_dst.s_addr))) {
+        if(udp_rpc_input(ip, uh, len))
+            goto done;
         nfsd_udp_map_to_local_port(&dst_addr.s_addr, &dst_port);
     } else if(vdns_match(m, ntohl(save_ip.ip_dst.s_addr), dport)) {
         vdns_udp_map_to_local_port(&dst_addr.s_addr, &dst_port);
@@ -178,20 +217,8 @@ udp_input(register struct mbuf *m, int iphlen)
 	so = udp_last_so;
 	if (so->so_lport != uh->uh_sport ||
 	    so->so_laddr.s_addr != ip->ip_src.s_addr) {
-		struct socket *tmp;
-		
-		for (tmp = udb.so_next; tmp != &udb; tmp = tmp->so_next) {
-			if (tmp->so_lport == uh->uh_sport &&
-			    tmp->so_laddr.s_addr == ip->ip_src.s_addr) {
-				tmp->so_faddr.s_addr = ip->ip_dst.s_addr;
-				tmp->so_fport = uh->uh_dport;
-				so = tmp;
-				break;
-			}
-		}
-		if (tmp == &udb) {
-		  so = NULL;
-		} else {
+		so = solookup_local(&udb, ip->ip_src, uh->uh_sport);
+		if (so) {
 		  udpstat.udpps_pcbcachemiss++;
 		  udp_last_so = so;
 		}
@@ -216,6 +243,7 @@ udp_input(register struct mbuf *m, int iphlen)
 	  /* udp_last_so = so; */
 	  so->so_laddr = ip->ip_src;
 	  so->so_lport = uh->uh_sport;
+	  sohash(&udb, so);
 	  
 	  if ((so->so_iptos = udp_tos(so)) == 0)
 	    so->so_iptos = ip->ip_tos;
@@ -674,6 +702,7 @@ udp_listen(u_int port, u_int32_t laddr, u_int lport, int flags)
 	
 	so->so_lport = lport;
 	so->so_laddr.s_addr = laddr;
+	sohash(&udb, so);
 	if (flags != SS_FACCEPTONCE)
 	   so->so_expire = 0;
 	
@@ -16,12 +16,16 @@ const char Snd_fileid[] = "Previous snd.c";
 #include "audio.h"
 #include "snd.h"
 #include "kms.h"
+#include "replay.h"
 
 #define LOG_SND_LEVEL   LOG_DEBUG
 #define LOG_VOL_LEVEL   LOG_DEBUG
 
 #define ENABLE_LOWPASS  1 /* experimental */
 
+/* Unity gain for the fixed-point volume factors (1.15) */
+#define SND_UNITY_GAIN  (1<<15)
+
 
 uint8_t snd_buffer[SND_BUFFER_SIZE];
 int     snd_buffer_len = 0;
@@ -31,7 +35,8 @@ static struct {
     uint8_t mute;
     uint8_t lowpass;
     uint8_t volume[2]; /* 0 = left, 1 = right */
-} sndout_state;
+    int32_t gain[2];   /* volume as fixed-point factor */
+} sndout_state = { .gain = { SND_UNITY_GAIN, SND_UNITY_GAIN } };
 
 /* Maximum volume (really is attenuation) */
 #define SND_MAX_VOL 43
@@ -83,86 +88,132 @@ static uint8_t snd_make_ulaw(int16_t sample) {
     return ulawbyte;
 }
 
-/* These functions apply repeat, zero-fill or nothing on samples */
-static void snd_make_double_samples(uint8_t *buffer, int len, bool repeat) {
-    for (int i=len - 4; i >= 0; i -= 4) {
-        buffer[i*2+7] = repeat ? buffer[i+3] : 0; /* repeat or zero-fill */
-        buffer[i*2+6] = repeat ? buffer[i+2] : 0; /* repeat or zero-fill */
-        buffer[i*2+5] = repeat ? buffer[i+1] : 0; /* repeat or zero-fill */
-        buffer[i*2+4] = repeat ? buffer[i+0] : 0; /* repeat or zero-fill */
-        buffer[i*2+3] =          buffer[i+3];
-        buffer[i*2+2] =          buffer[i+2];
-        buffer[i*2+1] =          buffer[i+1];
-        buffer[i*2+0] =          buffer[i+0];
+/* Samples are processed in blocks of deinterleaved 16-bit channels */
+#define SND_BLOCK_FRAMES 256
+
+static int16_t snd_block[2][2*SND_BLOCK_FRAMES];
+static uint8_t snd_output[SND_BUFFER_SIZE];
+
+/* These functions split big-endian stereo frames into one block per channel
+ * and join them again. With upsampling each frame is repeated or followed
+ * by a zero frame. */
+static int snd_deinterleave(const uint8_t *buffer, int frames, bool upsample, bool repeat) {
+    int i;
+    int16_t *l = snd_block[0], *r = snd_block[1];
+    
+    if (!upsample) {
+        for (i=0; i<frames; i++) {
+            l[i] = (int16_t)((buffer[i*4+0]<<8)|buffer[i*4+1]);
+            r[i] = (int16_t)((buffer[i*4+2]<<8)|buffer[i*4+3]);
+        }
+        return frames;
     }
+    for (i=0; i<frames; i++) {
+        l[i*2] = (int16_t)((buffer[i*4+0]<<8)|buffer[i*4+1]);
+        r[i*2] = (int16_t)((buffer[i*4+2]<<8)|buffer[i*4+3]);
+        l[i*2+1] = repeat ? l[i*2] : 0; /* repeat or zero-fill */
+        r[i*2+1] = repeat ? r[i*2] : 0; /* repeat or zero-fill */
+    }
+    return 2*frames;
 }
-static void snd_make_normal_samples(uint8_t *buffer, int len) {
-    /* do nothing */
+
+static void snd_interleave(uint8_t *buffer, int frames) {
+    int i;
+    const int16_t *l = snd_block[0], *r = snd_block[1];
+    
+    for (i=0; i<frames; i++) {
+        buffer[i*4+0] = l[i]>>8;
+        buffer[i*4+1] = l[i];
+        buffer[i*4+2] = r[i]>>8;
+        buffer[i*4+3] = r[i];
+    }
 }
 
 #if ENABLE_LOWPASS
-/* This is a third-order Butterworth low-pass filter (alpha value 0.1) */
-static int16_t snd_lowpass_filter(int16_t sample, int channel) {
-    static double v[2][4] = { {0.0,0.0,0.0,0.0}, {0.0,0.0,0.0,0.0} };
-    double result;
-    
-    v[channel][0] = v[channel][1];
-    v[channel][1] = v[channel][2];
-    v[channel][2] = v[channel][3];
-    v[channel][3] = ( 0.01809893300751444500 * sample)
-                  + ( 0.27805991763454640520 * v[channel][0])
-                  + (-1.18289326203783096148 * v[channel][1])
-                  + ( 1.76004188034316899625 * v[channel][2]);
-    result = (v[channel][0] + v[channel][3]) + 3 * (v[channel][1] + v[channel][2]);
-    
-    if (result > (double)INT16_MAX) return INT16_MAX;
-    if (result < (double)INT16_MIN) return INT16_MIN;
-    
-    return (int16_t)result;
+/* This is a third-order Butterworth low-pass filter (alpha value 0.1).
+ * Coefficients are 4.28 fixed-point, the filter state is 16.16. */
+#define LP_B    4858395LL    /*  0.01809893300751444500 */
+#define LP_A0   74641141LL   /*  0.27805991763454640520 */
+#define LP_A1  -317530492LL  /* -1.18289326203783096148 */
+#define LP_A2   472457645LL  /*  1.76004188034316899625 */
+
+static int64_t lowpass_state[2][3];
+
+static void snd_lowpass_filter(int16_t *samples, int len, int channel) {
+    int i;
+    int64_t v0, v1, v2, v3, result;
+    
+    v1 = lowpass_state[channel][0];
+    v2 = lowpass_state[channel][1];
+    v3 = lowpass_state[channel][2];
+    for (i=0; i<len; i++) {
+        v0 = v1;
+        v1 = v2;
+        v2 = v3;
+        v3 = (LP_B * ((int64_t)samples[i]<<16) + LP_A0 * v0 + LP_A1 * v1 + LP_A2 * v2 + (1<<27)) >> 28;
+        result = ((v0 + v3) + 3 * (v1 + v2)) / 65536;
+        
+        if (result > INT16_MAX) result = INT16_MAX;
+        if (result < INT16_MIN) result = INT16_MIN;
+        samples[i] = (int16_t)result;
+    }
+    lowpass_state[channel][0] = v1;
+    lowpass_state[channel][1] = v2;
+    lowpass_state[channel][2] = v3;
 }
 #endif
 
 /* This function returns a factor for adding volume adjustment to samples */
-static double snd_get_volume_factor(int channel) {
+static int32_t snd_get_volume_factor(int channel) {
     double gain = sndout_state.volume[channel] * -2.0;
     
     switch (sndout_state.volume[channel]) {
-        case 0:           return 1.0;
-        case SND_MAX_VOL: return 0.0;
-        default:          return pow(10.0, gain*0.05);
+        case 0:           return SND_UNITY_GAIN;
+        case SND_MAX_VOL: return 0;
+        default:          return (int32_t)(pow(10.0, gain*0.05) * SND_UNITY_GAIN + 0.5);
     }
 }
 
-/* This function adjusts sound output volume */
-static void snd_adjust_volume_and_lowpass(uint8_t *buf, int len) {
+static void snd_adjust_volume(int16_t *samples, int len, int32_t factor) {
     int i;
-    int16_t ldata, rdata;
-    double ladjust, radjust;
+    
+    for (i=0; i<len; i++) {
+        samples[i] = (samples[i] * factor) / SND_UNITY_GAIN;
+    }
+}
+
+/* This function upsamples, filters and adjusts the volume of the samples.
+ * Returns the processed samples, either in buffer or in snd_output. */
+static uint8_t* snd_process_samples(uint8_t *buffer, int len, bool upsample, bool repeat) {
+    int i, c, frames, outlen;
+    
+    outlen = upsample ? 2*len : len;
     if (sndout_state.mute) {
-        for (i=0; i<len; i++) {
-            buf[i] = 0;
-        }
-    } else if (sndout_state.volume[0] || sndout_state.volume[1] || sndout_state.lowpass) {
-        ladjust = snd_get_volume_factor(0);
-        radjust = snd_get_volume_factor(1);
-        
-        for (i=0; i<len; i+=4) {
-            ldata = ((int16_t)buf[i+0]<<8)|buf[i+1];
-            rdata = ((int16_t)buf[i+2]<<8)|buf[i+3];
+        memset(snd_output, 0, outlen);
+        return snd_output;
+    }
+    if (!upsample && sndout_state.gain[0] == SND_UNITY_GAIN &&
+        sndout_state.gain[1] == SND_UNITY_GAIN && !sndout_state.lowpass) {
+        return buffer;
+    }
+    
+    for (i=0; i<len/4; i+=SND_BLOCK_FRAMES) {
+        frames = len/4 - i;
+        if (frames > SND_BLOCK_FRAMES) frames = SND_BLOCK_FRAMES;
+        frames = snd_deinterleave(buffer + i*4, frames, upsample, repeat);
+        for (c=0; c<2; c++) {
 #if ENABLE_LOWPASS
             if (sndout_state.lowpass) {
-                ldata = snd_lowpass_filter(ldata, 0);
-                rdata = snd_lowpass_filter(rdata, 1);
+                snd_lowpass_filter(snd_block[c], frames, c);
             }
 #endif
-            ldata *= ladjust;
-            rdata *= radjust;
-            buf[i+0] = ldata>>8;
-            buf[i+1] = ldata;
-            buf[i+2] = rdata>>8;
-            buf[i+3] = rdata;
+            if (sndout_state.gain[c] != SND_UNITY_GAIN) {
+                snd_adjust_volume(snd_block[c], frames, sndout_state.gain[c]);
+            }
         }
+        snd_interleave(snd_output + (upsample ? i*8 : i*4), frames);
     }
+    return snd_output;
 }
 
 /* This function processes and sends multiple samples */
@@ -175,21 +226,13 @@ static void snd_adjust_volume_and_lowpass(uint8_t *buf, int len) {
 static int snd_send_samples(uint8_t* buffer, int len) {
     switch (sndout_state.mode) {
         case SND_MODE_NORMAL:
-            snd_make_normal_samples(buffer, len);
-            snd_adjust_volume_and_lowpass(buffer, len);
-            Audio_Output_Queue_Put(buffer, len);
+            Audio_Output_Queue_Put(snd_process_samples(buffer, len, false, false), len);
             return len;
         case SND_MODE_DBL_RP:
-            snd_make_double_samples(buffer, len, true);
-            snd_adjust_volume_and_lowpass(buffer, 2*len);
-            Audio_Output_Queue_Put(buffer, len);
-            Audio_Output_Queue_Put(buffer+len, len);
+            Audio_Output_Queue_Put(snd_process_samples(buffer, len, true, true), 2*len);
             return 2*len;
         case SND_MODE_DBL_ZF:
-            snd_make_double_samples(buffer, len, false);
-            snd_adjust_volume_and_lowpass(buffer, 2*len);
-            Audio_Output_Queue_Put(buffer, len);
-            Audio_Output_Queue_Put(buffer+len, len);
+            Audio_Output_Queue_Put(snd_process_samples(buffer, len, true, false), 2*len);
             return 2*len;
         default:
             Log_Printf(LOG_WARN, "[Sound] Error: Unknown sound output mode!");
@@ -255,10 +298,12 @@ static void snd_save_volume_reg(void) {
     if (chan_lr&1) {
         Log_Printf(LOG_WARN, "[Sound] Setting gain of left channel to -%d dB",vol_data*2);
         sndout_state.volume[0] = vol_data;
+        sndout_state.gain[0] = snd_get_volume_factor(0);
     }
     if (chan_lr&2) {
         Log_Printf(LOG_WARN, "[Sound] Setting gain of right channel to -%d dB",vol_data*2);
         sndout_state.volume[1] = vol_data;
+        sndout_state.gain[1] = snd_get_volume_factor(1);
     }
 }
 
@@ -305,12 +350,15 @@ static bool sound_output_active = false;
 static bool sound_input_active  = false;
 
 static void sound_init(void) {
-    if (!sndout_inited && ConfigureParams.Sound.bEnableSound) {
+    /* In fast forward mode the host audio device would pace the emulation */
+    if (!sndout_inited && ConfigureParams.Sound.bEnableSound && !ConfigureParams.System.bFastForward &&
+        !ConfigureParams.Screen.bHeadless) {
         Log_Printf(LOG_WARN, "[Sound] Initializing output device.");
         Audio_Output_Init();
         sndout_inited = true;
     }
-    if (!sndin_inited && sound_input_active && ConfigureParams.Sound.bEnableSound) {
+    if (!sndin_inited && sound_input_active && ConfigureParams.Sound.bEnableSound &&
+        !ConfigureParams.Screen.bHeadless) {
         Log_Printf(LOG_WARN, "[Sound] Initializing input device.");
         Audio_Input_Init();
         sndin_inited = true;
@@ -455,9 +503,11 @@ void SND_Out_Handler(void) {
 #define SNDIN_SAMPLE_TIME 124
 
 void SND_In_Handler(void) {
-    int16_t sample;
-    uint32_t foursamples = 0;
-    int size = 0;
+    int16_t samples[256];
+    uint8_t block[sizeof(samples) + 1];
+    uint32_t foursamples;
+    int i, n, size;
+    bool fast;
     
     CycInt_AcknowledgeInterrupt();
     
@@ -468,37 +518,51 @@ void SND_In_Handler(void) {
         return;
     }
     
-    Audio_Input_Lock();
+    /* Process 256 samples at a time and then sync, only whole groups of 4 */
+    if (nReplayMode == REPLAY_PLAY) {
+        /* Samples and buffer state come from the log */
+        n = Replay_Data(REPLAY_SNDIN, block, 0, sizeof(block));
+        fast = n > 0 && block[n - 1];
+        n = n > 0 ? (n - 1) / 2 : 0;
+        memcpy(samples, block, n * 2);
+    } else {
+        n = Audio_Input_Buffer_Get(samples, 256) & ~3;
+    }
     
-    /* Process 256 samples at a time and then sync */
-    while (size<256) {
-        if (Audio_Input_Buffer_Get(&sample) < 0) {
-            Log_Printf(LOG_WARN, "[Sound] Waiting for sound input data");
-            size = 256;
-            break;
-        }
-        
-        /* Shift in sample (oldest first) */
-        foursamples = (foursamples<<8) | snd_make_ulaw(sample);
-        
-        size++;
+    for (i = 0; i < n;) {
+        /* Shift in samples (oldest first) */
+        foursamples  = snd_make_ulaw(samples[i++]) << 24;
+        foursamples |= snd_make_ulaw(samples[i++]) << 16;
+        foursamples |= snd_make_ulaw(samples[i++]) << 8;
+        foursamples |= snd_make_ulaw(samples[i++]);
         
         /* After accumulating 4 samples, send them to KMS */
-        if ((size&3)==0) {
-            if (kms_send_codec_receive(foursamples)) {
-                break;
-            }
+        if (kms_send_codec_receive(foursamples)) {
+            break;
         }
     }
+    if (nReplayMode != REPLAY_PLAY) {
+        Audio_Input_Buffer_Advance(i);
+        fast = Audio_Input_Buffer_Size() > 4096; /* this is 4096 ulaw samples equaling about 0.5 seconds */
+        if (nReplayMode == REPLAY_RECORD) {
+            memcpy(block, samples, n * 2);
+            block[n * 2] = fast;
+            Replay_Data(REPLAY_SNDIN, block, n * 2 + 1, sizeof(block));
+        }
+    }
+    size = i;
+    
+    if (n < 256 && i == n) {
+        Log_Printf(LOG_WARN, "[Sound] Waiting for sound input data");
+        size = 256;
+    }
     
     /* If we accumulated too much data write it fast */
-    if (Audio_Input_Buffer_Size() > 8192) { /* this is 4096 ulaw samples equaling about 0.5 seconds */
+    if (fast) {
         Log_Printf(LOG_WARN, "[Sound] Writing input data fast");
         size = 16; /* Short delay */
     }
     
-    Audio_Input_Unlock();
-    
     if (kms_can_receive_codec()) {
         CycInt_AddRelativeInterruptUs(size*SNDIN_SAMPLE_TIME, 0, INTERRUPT_SND_IN);
     }
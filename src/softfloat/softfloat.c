@@ -3,6 +3,9 @@
 
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <float.h>
 #include "softfloat.h"
 
 
@@ -2464,6 +2467,63 @@ static floatx80 subFloatx80Sigs(floatx80 a, floatx80 b, flag zSign,
                                          zSign, zExp, zSig0, zSig1, status);
 }
 
+/*----------------------------------------------------------------------------
+| Fast paths for operands that are exactly representable as host doubles.
+| If the host result of an operation is exact, it is also the correctly
+| rounded extended double-precision result and no exception flags are
+| raised. Exactness is checked with an error-free transformation (the
+| rounding error of a sum, or the residual computed with fma), all other
+| cases take the full emulation. Operand exponents are limited, so that
+| the host operations can neither overflow nor underflow. Zero results are
+| left to the emulation, because their sign depends on the rounding mode.
+*----------------------------------------------------------------------------*/
+
+#if defined(FLT_EVAL_METHOD) && FLT_EVAL_METHOD == 0
+#define FLOATX80_HOST_FAST 1
+#define FLOATX80_HOST_MAX_EXP 500
+
+static inline flag floatx80_to_host(floatx80 a, double *d)
+{
+    int32_t aExp = extractFloatx80Exp( a );
+    uint64_t aSig = extractFloatx80Frac( a );
+    uint64_t u;
+
+    if ( aExp < 0x3FFF - FLOATX80_HOST_MAX_EXP || 0x3FFF + FLOATX80_HOST_MAX_EXP < aExp ) return 0;
+    if ( ! ( aSig & LIT64( 0x8000000000000000 ) ) || ( aSig & 0x7FF ) ) return 0;
+    u = ( (uint64_t) extractFloatx80Sign( a )<<63 ) | ( (uint64_t) ( aExp - 0x3FFF + 0x3FF )<<52 )
+        | ( ( aSig>>11 ) & LIT64( 0x000FFFFFFFFFFFFF ) );
+    memcpy( d, &u, sizeof(u) );
+    return 1;
+}
+
+static inline flag floatx80_from_host(double d, floatx80 *z, float_status *status)
+{
+    uint64_t u;
+    int32_t exp;
+
+    memcpy( &u, &d, sizeof(u) );
+    exp = ( u>>52 ) & 0x7FF;
+    if ( exp == 0 || exp == 0x7FF ) return 0;
+    if ( status->floatx80_rounding_precision == 32 &&
+         ( exp < 0x3FF - 126 || 0x3FF + 127 < exp || ( u & 0x1FFFFFFF ) ) ) return 0;
+    *z = packFloatx80( u>>63, exp - 0x3FF + 0x3FFF,
+                       ( ( u & LIT64( 0x000FFFFFFFFFFFFF ) ) | LIT64( 0x0010000000000000 ) )<<11 );
+    return 1;
+}
+
+static inline flag floatx80_add_host(floatx80 a, floatx80 b, flag negB, floatx80 *z, float_status *status)
+{
+    double x, y, s, t;
+
+    if ( ! floatx80_to_host( a, &x ) || ! floatx80_to_host( b, &y ) ) return 0;
+    if ( negB ) y = -y;
+    s = x + y;
+    t = s - x;
+    if ( ( x - ( s - t ) ) + ( y - t ) != 0 ) return 0;
+    return floatx80_from_host( s, z, status );
+}
+#endif
+
 /*----------------------------------------------------------------------------
 | Returns the result of adding the extended double-precision floating-point
 | values `a' and `b'.  The operation is performed according to the IEC/IEEE
@@ -2473,6 +2533,11 @@ static floatx80 subFloatx80Sigs(floatx80 a, floatx80 b, flag zSign,
 floatx80 floatx80_add(floatx80 a, floatx80 b, float_status *status)
 {
     flag aSign, bSign;
+#ifdef FLOATX80_HOST_FAST
+    floatx80 z;
+
+    if ( floatx80_add_host( a, b, 0, &z, status ) ) return z;
+#endif
 
     if (floatx80_invalid_encoding(a) || floatx80_invalid_encoding(b)) {
         float_raise(float_flag_invalid, status);
@@ -2498,6 +2563,11 @@ floatx80 floatx80_add(floatx80 a, floatx80 b, float_status *status)
 floatx80 floatx80_sub(floatx80 a, floatx80 b, float_status *status)
 {
     flag aSign, bSign;
+#ifdef FLOATX80_HOST_FAST
+    floatx80 z;
+
+    if ( floatx80_add_host( a, b, 1, &z, status ) ) return z;
+#endif
 
     if (floatx80_invalid_encoding(a) || floatx80_invalid_encoding(b)) {
         float_raise(float_flag_invalid, status);
@@ -2525,6 +2595,15 @@ floatx80 floatx80_mul(floatx80 a, floatx80 b, float_status *status)
     flag aSign, bSign, zSign;
     int32_t aExp, bExp, zExp;
     uint64_t aSig, bSig, zSig0, zSig1;
+#ifdef FLOATX80_HOST_FAST
+    floatx80 z;
+    double x, y, p;
+
+    if ( floatx80_to_host( a, &x ) && floatx80_to_host( b, &y ) ) {
+        p = x * y;
+        if ( fma( x, y, -p ) == 0 && floatx80_from_host( p, &z, status ) ) return z;
+    }
+#endif
 
     if (floatx80_invalid_encoding(a) || floatx80_invalid_encoding(b)) {
         float_raise(float_flag_invalid, status);
@@ -2643,6 +2722,15 @@ floatx80 floatx80_div(floatx80 a, floatx80 b, float_status *status)
     int32_t aExp, bExp, zExp;
     uint64_t aSig, bSig, zSig0, zSig1;
     uint64_t rem0, rem1, rem2, term0, term1, term2;
+#ifdef FLOATX80_HOST_FAST
+    floatx80 z;
+    double x, y, q;
+
+    if ( floatx80_to_host( a, &x ) && floatx80_to_host( b, &y ) ) {
+        q = x / y;
+        if ( fma( q, y, -x ) == 0 && floatx80_from_host( q, &z, status ) ) return z;
+    }
+#endif
 
     if (floatx80_invalid_encoding(a) || floatx80_invalid_encoding(b)) {
         float_raise(float_flag_invalid, status);
@@ -3095,6 +3183,15 @@ floatx80 floatx80_sqrt(floatx80 a, float_status *status)
     int32_t aExp, zExp;
     uint64_t aSig0, aSig1, zSig0, zSig1, doubleZSig0;
     uint64_t rem0, rem1, rem2, rem3, term0, term1, term2, term3;
+#ifdef FLOATX80_HOST_FAST
+    floatx80 z;
+    double x, r;
+
+    if ( floatx80_to_host( a, &x ) && x > 0 ) {
+        r = sqrt( x );
+        if ( fma( r, r, -x ) == 0 && floatx80_from_host( r, &z, status ) ) return z;
+    }
+#endif
 
     if (floatx80_invalid_encoding(a)) {
         float_raise(float_flag_invalid, status);
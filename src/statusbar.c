@@ -32,6 +32,7 @@ const char Statusbar_fileid[] = "Hatari statusbar.c";
 #include <assert.h>
 #include "main.h"
 #include "configuration.h"
+#include "host.h"
 #include "sdlgui.h"
 #include "statusbar.h"
 #include "screen.h"
@@ -105,6 +106,13 @@ static msg_item_t DefaultMessage;
 static msg_item_t *MessageList = &DefaultMessage;
 static SDL_Rect MessageRect;
 
+/* message text currently on screen and the part of it redrawn last */
+static char MessageShown[MAX_MESSAGE_LEN+1];
+static SDL_Rect MessageDirty;
+
+/* leds, message and overlay changed in one update */
+#define MAX_DIRTY_RECTS (NUM_DEVICE_LEDS + 4)
+
 /* screen height above statusbar and height of statusbar below screen */
 static int ScreenHeight;
 static int StatusbarHeight;
@@ -324,6 +332,7 @@ void Statusbar_Init(SDL_Surface *surf)
 	for (item = MessageList; item; item = item->next) {
 		item->shown = false;
 	}
+	MessageShown[0] = '\0';
 
 	/* draw i860 led box */
 	NdLedRect = LedRect;
@@ -405,6 +414,31 @@ static char *Statusbar_AddString(char *buffer, const char *more)
 	return buffer;
 }
 
+/*-----------------------------------------------------------------------*/
+/**
+ * Return the i860 speed of the board in slot measured since the last call,
+ * or an empty string if it is halted or has no counters.
+ */
+static const char *Statusbar_NdSpeedMsg(int slot)
+{
+	static char msg[16];
+	static uint64_t lastInsns, lastTime;
+	uint64_t rt, vt;
+	ND_STATS s;
+
+	msg[0] = '\0';
+	if (!nd_stats(slot, &s)) {
+		return msg;
+	}
+	host_time(&rt, &vt);
+	if (!s.halted && lastTime && vt > lastTime && s.insns >= lastInsns) {
+		snprintf(msg, sizeof(msg), "%.1fMIPS/", (double)(s.insns - lastInsns) / (vt - lastTime));
+	}
+	lastInsns = s.insns;
+	lastTime  = vt;
+	return msg;
+}
+
 /*-----------------------------------------------------------------------*/
 /**
  * Retrieve/update default statusbar information
@@ -414,6 +448,9 @@ void Statusbar_UpdateInfo(void)
 	char *end = DefaultMessage.msg;
 	char memsize[16];
 	char slot[16];
+	char prof[16];
+	const char *busiest;
+	int percent;
 	
 	/* Recording in progress */
 	if (bRecordingAiff)
@@ -429,6 +466,7 @@ void Statusbar_UpdateInfo(void)
 	if (ConfigureParams.Screen.nMonitorType==MONITOR_TYPE_DIMENSION)
 	{
 		end = Statusbar_AddString(end, "33MHz/i860XR/");
+		end = Statusbar_AddString(end, Statusbar_NdSpeedMsg(ND_SLOT(ConfigureParams.Screen.nMonitorNum)));
 		snprintf(memsize, sizeof(memsize), "%iMB/",
 		         Configuration_CheckDimensionMemory(ConfigureParams.Dimension.board[ConfigureParams.Screen.nMonitorNum].nMemoryBankSize));
 		end = Statusbar_AddString(end, memsize);
@@ -495,6 +533,14 @@ void Statusbar_UpdateInfo(void)
 		end = Statusbar_AddString(end, " Color");
 	}
 
+	/* subsystem that takes most host time besides the CPU core */
+	busiest = host_prof_busiest(&percent);
+	if (percent >= 10)
+	{
+		snprintf(prof, sizeof(prof), " %s:%d%%", busiest, percent);
+		end = Statusbar_AddString(end, prof);
+	}
+
 	*end = '\0';
 
 	assert(end - DefaultMessage.msg < MAX_MESSAGE_LEN);
@@ -505,20 +551,66 @@ void Statusbar_UpdateInfo(void)
 
 /*-----------------------------------------------------------------------*/
 /**
- * Draw 'msg' centered to the message area
+ * Draw 'msg' centered to the message area. Only the characters that
+ * differ from the message on screen are redrawn.
+ *
+ * Return updated area, or NULL if the message didn't change
  */
 static SDL_Rect* Statusbar_DrawMessage(SDL_Surface *surf, const char *msg)
 {
-	int fontw, fonth, offset;
-	SDL_FillRect(surf, &MessageRect, GrayBg);
-	if (*msg)
+	int fontw, fonth, first, last, len, oldlen, i;
+	char part[MAX_MESSAGE_LEN+1];
+
+	if (!strcmp(msg, MessageShown))
 	{
-		SDLGui_GetFontSize(&fontw, &fonth);
-		offset = (MessageRect.w - strlen(msg) * fontw) / 2;
-		SDLGui_Text(MessageRect.x + offset, MessageRect.y, msg);
+		return NULL;
 	}
+	SDLGui_GetFontSize(&fontw, &fonth);
+	len = strlen(msg);
+	oldlen = strlen(MessageShown);
+
+	if (len == oldlen)
+	{
+		/* same position, redraw only the changed characters unless
+		 * there are multibyte characters that don't map 1:1 to glyphs
+		 */
+		for (first = 0; msg[first] == MessageShown[first]; first++)
+			;
+		for (last = len - 1; msg[last] == MessageShown[last]; last--)
+			;
+		for (i = 0; i < len; i++)
+		{
+			if ((msg[i] | MessageShown[i]) & 0x80)
+			{
+				first = 0;
+				last = len - 1;
+				break;
+			}
+		}
+	}
+	else
+	{
+		/* centered, so the longer text covers the shorter one */
+		first = 0;
+		last = (len > oldlen ? len : oldlen) - 1;
+		len = last + 1;
+	}
+
+	MessageDirty = MessageRect;
+	MessageDirty.x += (MessageRect.w - len * fontw) / 2 + first * fontw;
+	MessageDirty.w = (last - first + 1) * fontw;
+	SDL_FillRect(surf, &MessageDirty, GrayBg);
+
+	len = strlen(msg);
+	if (first < len)
+	{
+		Str_Copy(part, msg + first, last - first + 2);
+		SDLGui_Text(MessageRect.x + (MessageRect.w - len * fontw) / 2 + first * fontw,
+		            MessageRect.y, part);
+	}
+	Str_Copy(MessageShown, msg, sizeof(MessageShown));
 	DEBUGPRINT(("Draw message: '%s'\n", msg));
-	return &MessageRect;
+	return &MessageDirty;
 }
 
 /*-----------------------------------------------------------------------*/
@@ -690,9 +782,9 @@ static SDL_Rect* Statusbar_OverlayDraw(SDL_Surface *surf)
 void Statusbar_Update(SDL_Surface *surf)
 {
 	uint32_t color, currentticks;
-	static SDL_Rect rect;
+	SDL_Rect rect, rects[MAX_DIRTY_RECTS];
 	SDL_Rect *last_rect;
-	int i, updates;
+	int i, updates = 0;
 
 	assert(surf);
 	if (!(StatusbarHeight && ConfigureParams.Screen.bShowStatusbar))
@@ -722,7 +814,10 @@ void Statusbar_Update(SDL_Surface *surf)
 
 	currentticks = SDL_GetTicks();
 	last_rect = Statusbar_ShowMessage(surf, currentticks);
-	updates = last_rect ? 1 : 0;
+	if (last_rect)
+	{
+		rects[updates++] = *last_rect;
+	}
 
 	rect = LedRect;
 	for (i = 0; i < NUM_DEVICE_LEDS; i++)
@@ -740,12 +835,9 @@ void Statusbar_Update(SDL_Surface *surf)
 		rect.x = Led[i].offset;
 		SDL_FillRect(surf, &rect, color);
 		DEBUGPRINT(("LED[%d] = %d\n", i, Led[i].state));
-		last_rect = &rect;
-		updates++;
+		rects[updates++] = rect;
 	}
 
-	Statusbar_ShowMessage(surf, currentticks);
-
 	/* Draw DSP LED */
 	if (bDspLed != bOldDspLed)
 	{
@@ -759,8 +851,7 @@ void Statusbar_Update(SDL_Surface *surf)
 			color = DspColorOff;
 		}
 		SDL_FillRect(surf, &DspLedRect, color);
-		last_rect = &DspLedRect;
-		updates++;
+		rects[updates++] = DspLedRect;
 	}
 	
 	/* Draw SCR2 LED */
@@ -776,8 +867,7 @@ void Statusbar_Update(SDL_Surface *surf)
 			color = SysColorOff;
 		}
 		SDL_FillRect(surf, &SystemLedRect, color);
-		last_rect = &SystemLedRect;
-		updates++;
+		rects[updates++] = SystemLedRect;
 	}
 
 	/* Draw NeXTdimension LED */
@@ -792,18 +882,13 @@ void Statusbar_Update(SDL_Surface *surf)
 			default: color = NdColorOff; break;
 		}
 		SDL_FillRect(surf, &NdLedRect, color);
-		last_rect = &NdLedRect;
-		updates++;
+		rects[updates++] = NdLedRect;
 	}
 
-	if (updates > 1)
+	/* only the changed items are copied to the screen */
+	assert(updates <= MAX_DIRTY_RECTS);
+	if (updates)
 	{
-		/* multiple items updated -> update whole statusbar */
-		last_rect = &FullRect;
-	}
-	if (last_rect)
-	{
-		Screen_UpdateRects(surf, 1, last_rect);
-		last_rect = NULL;
+		Screen_UpdateRects(surf, updates, rects);
 	}
 }
@@ -104,6 +104,7 @@ static uint8_t col_vid_intr   = 0;
 static uint8_t bright_reg     = 0;
 
 static uint8_t hardclock_csr  = 0;
+static bool    hardclock_held = false;
 
 static uint8_t scr_local_only = 0;
 
@@ -117,6 +118,10 @@ uint32_t scrIntMask = 0x00000000;
 
 int scrIntLevel = 0;
 
+static void scr_check_dsp_interrupt_turbo(void);
+static void scr_check_dsp_interrupt_030(void);
+static void scr_check_dsp_interrupt_040(void);
+
 /* System Control Register 1
  *
  * These values are valid for all non-Turbo systems:
@@ -183,8 +188,17 @@ void SCR_Reset(void) {
     uint8_t cpu_speed = 0;
     uint8_t memory_speed = 0;
     
+    if (ConfigureParams.System.bTurbo) {
+        scr_check_dsp_interrupt = scr_check_dsp_interrupt_turbo;
+    } else if (ConfigureParams.System.nMachineType == NEXT_CUBE030) {
+        scr_check_dsp_interrupt = scr_check_dsp_interrupt_030;
+    } else {
+        scr_check_dsp_interrupt = scr_check_dsp_interrupt_040;
+    }
+    
     scr_local_only = 1;
     hardclock_csr = 0;
+    hardclock_held = false;
     col_vid_intr = 0;
     bright_reg = 0;
     dsp_intr_at_block_end = 0;
@@ -283,6 +297,11 @@ void SCR1_Read(void)
     IoMem_WriteLong(IoAccessCurrentAddress, scr1);
 }
 
+uint32_t SCR1_lget(uint32_t addr)
+{
+    return scr1;
+}
+
 
 /* System Control Register 2 
  
@@ -401,16 +420,19 @@ void SCR2_Read0(void)
 
 void SCR2_Write1(void)
 {
-    uint8_t changed_bits=scr2_1;
     Log_Printf(LOG_SCR_LEVEL,"SCR2 write at $%08x val=$%02x PC=$%08x\n", IoAccessCurrentAddress,IoMem_ReadByte(IoAccessCurrentAddress),m68k_getpc());
     scr2_1 = IoMem_ReadByte(IoAccessCurrentAddress);
+}
+
+void SCR2_Write1Turbo(void)
+{
+    uint8_t changed_bits=scr2_1;
+    SCR2_Write1();
     changed_bits^=scr2_1;
     
-    if (ConfigureParams.System.bTurbo) {
-        if (changed_bits&SCR2_DSP_TXD_EN) {
-            Log_Printf(LOG_WARN,"[SCR2] %s DSP TXD interrupt",(scr2_1&SCR2_DSP_TXD_EN)?"enable":"disable");
-            scr_check_dsp_interrupt();
-        }
+    if (changed_bits&SCR2_DSP_TXD_EN) {
+        Log_Printf(LOG_WARN,"[SCR2] %s DSP TXD interrupt",(scr2_1&SCR2_DSP_TXD_EN)?"enable":"disable");
+        scr_check_dsp_interrupt();
     }
 }
 
@@ -445,61 +467,77 @@ void SCR2_Write2(void)
     }
 }
 
-void SCR2_Read2(void)
+static void scr2_update_rtdata(void)
 {
-    Log_Printf(LOG_SCR_LEVEL,"SCR2 read at $%08x PC=$%08x\n", IoAccessCurrentAddress,m68k_getpc());
     if (rtc_interface_read()) {
         scr2_2 |= SCR2_RTDATA;
     } else {
         scr2_2 &= ~SCR2_RTDATA;
     }
+}
+
+void SCR2_Read2(void)
+{
+    Log_Printf(LOG_SCR_LEVEL,"SCR2 read at $%08x PC=$%08x\n", IoAccessCurrentAddress,m68k_getpc());
+    scr2_update_rtdata();
     IoMem_WriteByte(IoAccessCurrentAddress, scr2_2);
 }
 
-void SCR2_Write3(void)
-{    
+/* Write byte 3 and handle the bits common to all machines, returns the changed bits */
+static uint8_t scr2_write3(void)
+{
     uint8_t changed_bits=scr2_3;
     Log_Printf(LOG_SCR_LEVEL,"SCR2 write at $%08x val=$%02x PC=$%08x\n", IoAccessCurrentAddress,IoMem_ReadByte(IoAccessCurrentAddress),m68k_getpc());
     scr2_3 = IoMem_ReadByte(IoAccessCurrentAddress);
     changed_bits^=scr2_3;
     
-    if (changed_bits&SCR2_ROM) {
-        scr_local_only=scr2_3&SCR2_ROM;
-        if (!ConfigureParams.System.bTurbo) {
-            scr_local_only^=SCR2_ROM;
-        }
-        Log_Printf(LOG_WARN,"[SCR2] %s local only",scr_local_only?"Enable":"Disable");
-    }
     if (changed_bits&SCR2_LED) {
         Log_Printf(LOG_DEBUG,"[SCR2] %s LED",(scr2_3&SCR2_LED)?"Enable":"Disable");
         Statusbar_SetSystemLed(scr2_3&SCR2_LED);
     }
+    return changed_bits;
+}
+
+void SCR2_Write3(void)
+{
+    uint8_t changed_bits=scr2_write3();
     
-    if (!ConfigureParams.System.bTurbo) {
-        if (changed_bits&SCR2_DSP_INT_EN) {
-            Log_Printf(LOG_DSP_LEVEL,"[SCR2] DSP interrupt at level %i",(scr2_3&SCR2_DSP_INT_EN)?4:3);
-            if (scrIntStat&(INT_DSP_L3|INT_DSP_L4)) {
-                Log_Printf(LOG_DSP_LEVEL,"[SCR2] Switching DSP interrupt to level %i",(scr2_3&SCR2_DSP_INT_EN)?4:3);
-                set_interrupt(INT_DSP_L3|INT_DSP_L4, RELEASE_INT);
-                scr_check_dsp_interrupt();
-            }
+    if (changed_bits&SCR2_ROM) {
+        scr_local_only=(scr2_3&SCR2_ROM)^SCR2_ROM;
+        Log_Printf(LOG_WARN,"[SCR2] %s local only",scr_local_only?"Enable":"Disable");
+    }
+    if (changed_bits&SCR2_DSP_INT_EN) {
+        Log_Printf(LOG_DSP_LEVEL,"[SCR2] DSP interrupt at level %i",(scr2_3&SCR2_DSP_INT_EN)?4:3);
+        if (scrIntStat&(INT_DSP_L3|INT_DSP_L4)) {
+            Log_Printf(LOG_DSP_LEVEL,"[SCR2] Switching DSP interrupt to level %i",(scr2_3&SCR2_DSP_INT_EN)?4:3);
+            set_interrupt(INT_DSP_L3|INT_DSP_L4, RELEASE_INT);
+            scr_check_dsp_interrupt();
         }
     }
+    if ((changed_bits&SCR2_DSP_MEM_EN) && scr_have_dsp_memreset) {
+        Log_Printf(LOG_WARN,"[SCR2] %s DSP memory",(scr2_3&SCR2_DSP_MEM_EN)?"disable":"enable");
+        if (scr2_3&SCR2_DSP_MEM_EN) {
+            DSP_DisableMemory();
+        } else {
+            DSP_EnableMemory();
+        }
+    }
+}
+
+void SCR2_Write3Turbo(void)
+{
+    uint8_t changed_bits=scr2_write3();
+    
+    if (changed_bits&SCR2_ROM) {
+        scr_local_only=scr2_3&SCR2_ROM;
+        Log_Printf(LOG_WARN,"[SCR2] %s local only",scr_local_only?"Enable":"Disable");
+    }
     if (changed_bits&SCR2_DSP_MEM_EN) {
-        if (ConfigureParams.System.bTurbo) {
-            Log_Printf(LOG_WARN,"[SCR2] %s DSP memory",(scr2_3&SCR2_DSP_MEM_EN)?"enable":"disable");
-            if (scr2_3&SCR2_DSP_MEM_EN) {
-                DSP_EnableMemory();
-            } else {
-                DSP_DisableMemory();
-            }
-       } else if (scr_have_dsp_memreset) {
-            Log_Printf(LOG_WARN,"[SCR2] %s DSP memory",(scr2_3&SCR2_DSP_MEM_EN)?"disable":"enable");
-            if (scr2_3&SCR2_DSP_MEM_EN) {
-                DSP_DisableMemory();
-            } else {
-                DSP_EnableMemory();
-            }
+        Log_Printf(LOG_WARN,"[SCR2] %s DSP memory",(scr2_3&SCR2_DSP_MEM_EN)?"enable":"disable");
+        if (scr2_3&SCR2_DSP_MEM_EN) {
+            DSP_EnableMemory();
+        } else {
+            DSP_DisableMemory();
         }
     }
 }
@@ -510,6 +548,23 @@ void SCR2_Read3(void)
     IoMem_WriteByte(IoAccessCurrentAddress, scr2_3);
 }
 
+/* Direct access for polling, writes go through the handlers above */
+uint32_t SCR2_bget(uint32_t addr)
+{
+    switch (addr&3) {
+        case 0: return scr2_0;
+        case 1: return scr2_1;
+        case 2: scr2_update_rtdata(); return scr2_2;
+        default: return scr2_3;
+    }
+}
+
+uint32_t SCR2_lget(uint32_t addr)
+{
+    scr2_update_rtdata();
+    return (scr2_0<<24)|(scr2_1<<16)|(scr2_2<<8)|scr2_3;
+}
+
 
 /* Interrupt Status Register */
 
@@ -521,32 +576,39 @@ void IntRegStatWrite(void) {
     Log_Printf(LOG_WARN, "[INT] Interrupt status register is read-only.");
 }
 
+uint32_t IntRegStat_lget(uint32_t addr) {
+    return scrIntStat;
+}
+
 
-/* DSP interrupt */
-void scr_check_dsp_interrupt(void) {
-    uint8_t state = RELEASE_INT;
+/* DSP interrupt, routing depends on the machine and is selected in SCR_Reset */
+static void scr_check_dsp_interrupt_turbo(void) {
+    uint8_t state = dsp_hreq_intr;
     
-    if (ConfigureParams.System.bTurbo) {
-        state = dsp_hreq_intr;
-        if (scr2_1&SCR2_DSP_TXD_EN) {
-            state |= dsp_txdn_intr;
-        }
-        set_interrupt(INT_DSP_L4, state);
+    if (scr2_1&SCR2_DSP_TXD_EN) {
+        state |= dsp_txdn_intr;
+    }
+    set_interrupt(INT_DSP_L4, state);
+}
+
+static void scr_check_dsp_interrupt_030(void) {
+    if (scr2_3&SCR2_DSP_INT_EN) {
+        set_interrupt(INT_DSP_L4, dsp_hreq_intr | dsp_txdn_intr);
     } else {
-        if (scr2_3&SCR2_DSP_INT_EN) {
-            if (ConfigureParams.System.nMachineType == NEXT_CUBE030) {
-                state = dsp_hreq_intr | dsp_txdn_intr;
-            } else {
-                state = (dsp_hreq_intr & bmap_hreq_enable) | (dsp_txdn_intr & bmap_txdn_enable);
-            }
-            set_interrupt(INT_DSP_L4, state);
-        } else {
-            state = dsp_hreq_intr; /* diagnostics expect this */
-            set_interrupt(INT_DSP_L3, state);
-        }
+        set_interrupt(INT_DSP_L3, dsp_hreq_intr); /* diagnostics expect this */
+    }
+}
+
+static void scr_check_dsp_interrupt_040(void) {
+    if (scr2_3&SCR2_DSP_INT_EN) {
+        set_interrupt(INT_DSP_L4, (dsp_hreq_intr & bmap_hreq_enable) | (dsp_txdn_intr & bmap_txdn_enable));
+    } else {
+        set_interrupt(INT_DSP_L3, dsp_hreq_intr); /* diagnostics expect this */
     }
 }
 
+void (*scr_check_dsp_interrupt)(void) = scr_check_dsp_interrupt_030;
+
 /* Set interrupt level from interrupt status and mask registers */
 static inline void scr_get_interrupt_level(void) {
     uint32_t interrupt = scrIntStat&scrIntMask;
@@ -590,20 +652,39 @@ void set_interrupt(uint32_t intr, uint8_t state) {
 #define INT_ZEROBITS    0xC22E7600 // Turbo
 
 void IntRegMaskRead(void) {
-    if (ConfigureParams.System.bTurbo) {
-        IoMem_WriteLong(IoAccessCurrentAddress, scrIntMask&~INT_ZEROBITS);
-    } else {
-        IoMem_WriteLong(IoAccessCurrentAddress, scrIntMask);
-    }
+    IoMem_WriteLong(IoAccessCurrentAddress, scrIntMask);
+}
+
+uint32_t IntRegMask_lget(uint32_t addr) {
+    return scrIntMask;
 }
 
 void IntRegMaskWrite(void) {
-    scrIntMask = IoMem_ReadLong(IoAccessCurrentAddress);
-    if (ConfigureParams.System.bTurbo) {
-        scrIntMask |= INT_ZEROBITS;
-    } else {
-        scrIntMask |= INT_NONMASKABLE;
-    }
+    IntRegMask_lput(IoAccessCurrentAddress, IoMem_ReadLong(IoAccessCurrentAddress));
+}
+
+void IntRegMask_lput(uint32_t addr, uint32_t val) {
+    scrIntMask = val | INT_NONMASKABLE;
+    scr_get_interrupt_level();
+    
+    Log_Printf(LOG_DEBUG, "Interrupt mask: %08x", scrIntMask);
+}
+
+/* Turbo variants, bits without a source always read as zero */
+void IntRegMaskReadTurbo(void) {
+    IoMem_WriteLong(IoAccessCurrentAddress, IntRegMaskTurbo_lget(IoAccessCurrentAddress));
+}
+
+uint32_t IntRegMaskTurbo_lget(uint32_t addr) {
+    return scrIntMask&~INT_ZEROBITS;
+}
+
+void IntRegMaskWriteTurbo(void) {
+    IntRegMaskTurbo_lput(IoAccessCurrentAddress, IoMem_ReadLong(IoAccessCurrentAddress));
+}
+
+void IntRegMaskTurbo_lput(uint32_t addr, uint32_t val) {
+    scrIntMask = val | INT_ZEROBITS;
     scr_get_interrupt_level();
     
     Log_Printf(LOG_DEBUG, "Interrupt mask: %08x", scrIntMask);
@@ -621,7 +702,12 @@ static uint8_t hardclock0=0;
 static int latch_hardclock=0;
 
 static uint64_t hardClockLastLatch;
+static uint64_t hardClockNext;
 
+/* While the timer interrupt is pending, further ticks would only set it
+ * again. The timer is held until the interrupt is released and then
+ * continues with the next tick in phase. This saves the ticks during
+ * long periods where the interrupt is masked. */
 void Hardclock_InterruptHandler ( void )
 {
     CycInt_AcknowledgeInterrupt();
@@ -631,7 +717,27 @@ void Hardclock_InterruptHandler ( void )
         uint64_t now = host_time_us();
         host_hardclock(latch_hardclock, now - hardClockLastLatch);
         hardClockLastLatch = now;
-        CycInt_AddRelativeInterruptUs(latch_hardclock, 0, INTERRUPT_HARDCLOCK);
+        hardClockNext = now + latch_hardclock;
+        hardclock_held = true;
+    }
+}
+
+static void hardclock_release(void) {
+    uint64_t now;
+    
+    set_interrupt(INT_TIMER,RELEASE_INT);
+    
+    if (hardclock_held) {
+        hardclock_held = false;
+        if ((hardclock_csr&HARDCLOCK_ENABLE) && (latch_hardclock>0)) {
+            now = host_time_us();
+            if (hardClockNext <= now) {
+                /* Skip the ticks that happened while the interrupt was pending */
+                hardClockNext += ((now - hardClockNext) / latch_hardclock + 1) * latch_hardclock;
+                hardClockLastLatch = hardClockNext - latch_hardclock;
+            }
+            CycInt_AddRelativeInterruptUs(hardClockNext - now, 0, INTERRUPT_HARDCLOCK);
+        }
     }
 }
 
@@ -662,6 +768,7 @@ void HardclockWriteCSR(void) {
         latch_hardclock=(hardclock0<<8)|hardclock1;
         hardClockLastLatch = host_time_us();
     }
+    hardclock_held = false;
     if ((hardclock_csr&HARDCLOCK_ENABLE) && (latch_hardclock>0)) {
         Log_Printf(LOG_HARDCLOCK_LEVEL,"[hardclock] enable periodic interrupt (%i microseconds).", latch_hardclock);
         CycInt_AddRelativeInterruptUs(latch_hardclock, 0, INTERRUPT_HARDCLOCK);
@@ -673,7 +780,7 @@ void HardclockWriteCSR(void) {
 void HardclockReadCSR(void) {
     IoMem_WriteByte(IoAccessCurrentAddress, hardclock_csr);
 //  Log_Printf(LOG_WARN,"[hardclock] read at $%08x val=%02x PC=$%08x", IoAccessCurrentAddress,IoMem_ReadByte(IoAccessCurrentAddress),m68k_getpc());
-    set_interrupt(INT_TIMER,RELEASE_INT);
+    hardclock_release();
 }
 
 
@@ -19,6 +19,7 @@ const char Video_fileid[] = "Previous video.c";
 #include "sysReg.h"
 #include "tmc.h"
 #include "nd_sdl.hpp"
+#include "grab.h"
 
 
 #define NEXT_VBL_FREQ 68
@@ -36,6 +37,8 @@ void Video_Reset(void) {
  * Generate vertical video retrace interrupt.
  */
 static void Video_Interrupt(void) {
+	Grab_VideoFrame();
+
 	if (ConfigureParams.System.bTurbo) {
 		tmc_video_interrupt();
 	} else if (ConfigureParams.System.bColor) {
@@ -74,13 +77,18 @@ void Video_InterruptHandler(void) {
 	CycInt_AddRelativeInterruptUs((1000*1000)/NEXT_VBL_FREQ, 0, INTERRUPT_VIDEO_VBL);
 #else
 	static bool bBlankToggle = false;
+	static int nFrameSkip = 0;
 
 	CycInt_AcknowledgeInterrupt();
 	host_blank_count(MAIN_DISPLAY, bBlankToggle);
 	if (bBlankToggle) {
 		Video_Interrupt();
 	} else if (ConfigureParams.Screen.nMonitorType != MONITOR_TYPE_DIMENSION) {
-		Main_SendSpecialEvent(MAIN_REPAINT);
+		/* In fast forward mode only every nFrameSkips+1-th frame is shown */
+		if (!ConfigureParams.System.bFastForward || --nFrameSkip < 0) {
+			nFrameSkip = ConfigureParams.Screen.nFrameSkips;
+			Main_SendSpecialEvent(MAIN_REPAINT);
+		}
 	}
 	bBlankToggle = !bBlankToggle;
 	CycInt_AddRelativeInterruptUs((1000*1000)/(2*NEXT_VBL_FREQ), 0, INTERRUPT_VIDEO_VBL);
@@ -0,0 +1,731 @@
+/*
+  Previous - zimage.c
+
+  This file is distributed under the GNU General Public License, version 2
+  or at your option any later version. Read the file gpl.txt for details.
+
+  Compressed, seekable disk images. The image is split into chunks of
+  equal size which are compressed one by one with zlib, an index of chunk
+  offsets allows random access. Recently used chunks are kept decompressed
+  in a small cache, so sequential reads and hot blocks do not hit zlib.
+  Compressed images are read-only, writes can go to an overlay.
+
+  File layout (all numbers big endian):
+  0     "PRVZIMG1" magic
+  8     chunk size in bytes
+  12    number of chunks
+  16    uncompressed size in bytes (64 bit)
+  24    index, number of chunks + 1 file offsets (64 bit), the last one
+        is the end of the data. A chunk whose compressed length equals
+        the chunk size is stored uncompressed.
+
+  Plain gzip files and zip archives (the first file, stored or deflated)
+  are read in place as well. Their deflate stream is decompressed on
+  demand and access points, each with the 32 kB history needed to resume
+  inflating there, are recorded along the way. A read behind the current
+  stream position resumes from the nearest access point instead of the
+  start of the stream.
+
+  This file only depends on stdio and zlib, it is shared with ditool.
+*/
+const char ZImage_fileid[] = "Previous zimage.c";
+
+#include <stdlib.h>
+#include <string.h>
+#include <zlib.h>
+#include "zimage.h"
+
+#ifdef _WIN32
+#define fseeko _fseeki64
+#define ftello _ftelli64
+#endif
+
+
+#define ZIMAGE_MAGIC        "PRVZIMG1"
+#define ZIMAGE_HEADER       24
+#define ZIMAGE_CACHE        8
+#define ZIMAGE_WINDOW       32768           /* Deflate history size */
+#define ZIMAGE_SPAN         (1024*1024)     /* Min. distance of access points */
+#define ZIMAGE_POINTS       256             /* Spread them further on larger images */
+
+enum {
+	ZIMAGE_CHUNKED,     /* Our own format */
+	ZIMAGE_STORED,      /* Uncompressed file in a zip archive */
+	ZIMAGE_DEFLATE      /* Deflate stream from a gzip file or zip archive */
+};
+
+typedef struct {
+	int      format;
+	uint32_t chunksize;
+	uint32_t chunks;
+	uint64_t size;
+	uint64_t data;      /* Start and end of the stored or deflated data */
+	uint64_t end;
+} ZIMAGE_INFO;
+
+typedef struct {
+	uint32_t chunk;
+	uint32_t stamp;     /* Last use, 0 if the entry is empty */
+	uint8_t *data;
+} ZIMAGE_CHUNK;
+
+typedef struct {
+	uint64_t out;       /* Uncompressed offset */
+	uint64_t in;        /* File offset of the next compressed byte */
+	int      bits;      /* Bits of the byte before in that are still unused */
+	uint8_t *window;    /* History before out, NULL at the stream start */
+} ZIMAGE_POINT;
+
+struct ZIMAGE {
+	FILE    *fp;
+	int      format;
+	uint32_t chunksize;
+	uint32_t chunks;
+	uint64_t size;
+	uint64_t *index;
+	uint8_t *inbuf;     /* Compressed data of the chunk being loaded */
+	uint32_t clock;
+	ZIMAGE_CHUNK cache[ZIMAGE_CACHE];
+
+	/* Stored and deflated data */
+	uint64_t data;
+	uint64_t end;
+	z_stream strm;
+	bool     strm_init;
+	bool     strm_valid;
+	uint64_t pos;       /* Uncompressed offset of strm */
+	uint64_t in;        /* File offset of the input after inbuf */
+	uint8_t *window;    /* Ring buffer with the last output of strm */
+	uint32_t wpos;
+	uint64_t span;
+	ZIMAGE_POINT *points;
+	uint32_t npoints;
+};
+
+
+static void ZImage_PutLong(uint8_t *p, uint32_t v)
+{
+	p[0] = v >> 24; p[1] = v >> 16; p[2] = v >> 8; p[3] = v;
+}
+
+static uint32_t ZImage_GetLong(const uint8_t *p)
+{
+	return ((uint32_t)p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+}
+
+static void ZImage_PutQuad(uint8_t *p, uint64_t v)
+{
+	ZImage_PutLong(p, v >> 32);
+	ZImage_PutLong(p + 4, (uint32_t)v);
+}
+
+static uint64_t ZImage_GetQuad(const uint8_t *p)
+{
+	return ((uint64_t)ZImage_GetLong(p) << 32) | ZImage_GetLong(p + 4);
+}
+
+static bool ZImage_ReadAt(FILE *fp, void *data, size_t size, uint64_t offset)
+{
+	return fseeko(fp, offset, SEEK_SET) == 0 && fread(data, size, 1, fp) == 1;
+}
+
+static uint32_t ZImage_GetLe16(const uint8_t *p)
+{
+	return p[0] | (p[1] << 8);
+}
+
+static uint32_t ZImage_GetLe32(const uint8_t *p)
+{
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint64_t ZImage_FileSize(FILE *fp)
+{
+	if (fseeko(fp, 0, SEEK_END)) {
+		return 0;
+	}
+	return ftello(fp);
+}
+
+/**
+ * Read and check the header. Returns the number of chunks or 0 if fp is
+ * not a compressed image.
+ */
+static uint32_t ZImage_Header(FILE *fp, uint32_t *chunksize, uint64_t *size)
+{
+	uint8_t header[ZIMAGE_HEADER];
+	uint32_t chunks;
+
+	if (!ZImage_ReadAt(fp, header, sizeof(header), 0) || memcmp(header, ZIMAGE_MAGIC, 8)) {
+		return 0;
+	}
+	*chunksize = ZImage_GetLong(header + 8);
+	chunks     = ZImage_GetLong(header + 12);
+	*size      = ZImage_GetQuad(header + 16);
+
+	if (*chunksize == 0 || chunks != (*size + *chunksize - 1) / *chunksize) {
+		return 0;
+	}
+	return chunks;
+}
+
+/**
+ * Find the deflate stream of a gzip file. The uncompressed size is taken
+ * from the trailer, so only single member files up to 4 GB are supported.
+ */
+static bool ZImage_ProbeGzip(FILE *fp, ZIMAGE_INFO *info)
+{
+	uint8_t header[10], trailer[4];
+	uint64_t filesize;
+	int flag, c;
+
+	if (!ZImage_ReadAt(fp, header, sizeof(header), 0) ||
+	    header[0] != 0x1f || header[1] != 0x8b || header[2] != Z_DEFLATED) {
+		return false;
+	}
+	if ((header[3] & 0x04) && (fread(trailer, 2, 1, fp) != 1 ||
+	                           fseeko(fp, ZImage_GetLe16(trailer), SEEK_CUR))) {
+		return false;   /* FEXTRA */
+	}
+	for (flag = 0x08; flag <= 0x10; flag <<= 1) {
+		if (header[3] & flag) {
+			do {
+				c = fgetc(fp);  /* FNAME, FCOMMENT */
+			} while (c != 0 && c != EOF);
+			if (c == EOF) {
+				return false;
+			}
+		}
+	}
+	if ((header[3] & 0x02) && fseeko(fp, 2, SEEK_CUR)) {
+		return false;   /* FHCRC */
+	}
+	info->data = ftello(fp);
+
+	filesize = ZImage_FileSize(fp);
+	if (filesize < info->data + 8 || !ZImage_ReadAt(fp, trailer, 4, filesize - 4)) {
+		return false;
+	}
+	info->format = ZIMAGE_DEFLATE;
+	info->end    = filesize - 8;
+	info->size   = ZImage_GetLe32(trailer);
+	return true;
+}
+
+/**
+ * Find the data of the first file in a zip archive. Zip64 archives are
+ * not supported.
+ */
+static bool ZImage_ProbeZip(FILE *fp, ZIMAGE_INFO *info)
+{
+	uint8_t header[46], *tail;
+	uint64_t filesize, offset;
+	uint32_t taillen, count, method, csize, namelen;
+	int i;
+	char last;
+
+	if (!ZImage_ReadAt(fp, header, 4, 0) || memcmp(header, "PK\3\4", 4)) {
+		return false;
+	}
+
+	/* Find the end of central directory record */
+	filesize = ZImage_FileSize(fp);
+	taillen  = filesize < 65535 + 22 ? filesize : 65535 + 22;
+	if (taillen < 22 || !(tail = malloc(taillen))) {
+		return false;
+	}
+	if (!ZImage_ReadAt(fp, tail, taillen, filesize - taillen)) {
+		free(tail);
+		return false;
+	}
+	for (i = taillen - 22; i >= 0; i--) {
+		if (!memcmp(tail + i, "PK\5\6", 4)) {
+			break;
+		}
+	}
+	if (i < 0) {
+		free(tail);
+		return false;
+	}
+	count  = ZImage_GetLe16(tail + i + 10);
+	offset = ZImage_GetLe32(tail + i + 16);
+	free(tail);
+
+	/* Skip directories */
+	for (; count > 0; count--) {
+		if (!ZImage_ReadAt(fp, header, sizeof(header), offset) || memcmp(header, "PK\1\2", 4)) {
+			return false;
+		}
+		namelen = ZImage_GetLe16(header + 28);
+		if (namelen && ZImage_ReadAt(fp, &last, 1, offset + 46 + namelen - 1) && last != '/') {
+			break;
+		}
+		offset += 46 + namelen + ZImage_GetLe16(header + 30) + ZImage_GetLe16(header + 32);
+	}
+	if (count == 0) {
+		return false;
+	}
+	method     = ZImage_GetLe16(header + 10);
+	csize      = ZImage_GetLe32(header + 20);
+	info->size = ZImage_GetLe32(header + 24);
+	offset     = ZImage_GetLe32(header + 42);
+	if ((method != 0 && method != Z_DEFLATED) ||
+	    csize == 0xffffffff || info->size == 0xffffffff || offset == 0xffffffff) {
+		return false;
+	}
+
+	/* The local header may have a different extra field */
+	if (!ZImage_ReadAt(fp, header, 30, offset) || memcmp(header, "PK\3\4", 4)) {
+		return false;
+	}
+	info->format = method ? ZIMAGE_DEFLATE : ZIMAGE_STORED;
+	info->data   = offset + 30 + ZImage_GetLe16(header + 26) + ZImage_GetLe16(header + 28);
+	info->end    = info->data + csize;
+	return info->end <= filesize;
+}
+
+/**
+ * Check if fp holds a compressed image in one of the supported formats.
+ */
+static bool ZImage_Probe(FILE *fp, ZIMAGE_INFO *info)
+{
+	memset(info, 0, sizeof(*info));
+
+	if ((info->chunks = ZImage_Header(fp, &info->chunksize, &info->size))) {
+		info->format = ZIMAGE_CHUNKED;
+		return true;
+	}
+	if (!ZImage_ProbeGzip(fp, info) && !ZImage_ProbeZip(fp, info)) {
+		return false;
+	}
+	info->chunksize = ZIMAGE_CHUNKSIZE;
+	info->chunks    = (info->size + info->chunksize - 1) / info->chunksize;
+	return info->size > 0;
+}
+
+/**
+ * Append output of the stream to the history ring buffer.
+ */
+static void ZImage_Window(ZIMAGE *zi, const uint8_t *data, uint32_t size)
+{
+	uint32_t part;
+
+	if (size > ZIMAGE_WINDOW) {
+		data += size - ZIMAGE_WINDOW;
+		size  = ZIMAGE_WINDOW;
+	}
+	part = ZIMAGE_WINDOW - zi->wpos;
+	if (part > size) {
+		part = size;
+	}
+	memcpy(zi->window + zi->wpos, data, part);
+	memcpy(zi->window, data + part, size - part);
+	zi->wpos = (zi->wpos + size) % ZIMAGE_WINDOW;
+}
+
+/**
+ * Record an access point at the current position of the stream, which
+ * must be at a deflate block boundary.
+ */
+static void ZImage_AddPoint(ZIMAGE *zi)
+{
+	ZIMAGE_POINT *points, *pt;
+
+	if (zi->pos < zi->points[zi->npoints - 1].out + zi->span) {
+		return;
+	}
+	if (!(points = realloc(zi->points, (zi->npoints + 1) * sizeof(ZIMAGE_POINT)))) {
+		return;
+	}
+	zi->points = points;
+	pt = &points[zi->npoints];
+	if (!(pt->window = malloc(ZIMAGE_WINDOW))) {
+		return;
+	}
+	memcpy(pt->window, zi->window + zi->wpos, ZIMAGE_WINDOW - zi->wpos);
+	memcpy(pt->window + ZIMAGE_WINDOW - zi->wpos, zi->window, zi->wpos);
+	pt->out  = zi->pos;
+	pt->in   = zi->in - zi->strm.avail_in;
+	pt->bits = zi->strm.data_type & 7;
+	zi->npoints++;
+}
+
+/**
+ * Position the stream at or before offset. Keeps going from the current
+ * position if no access point is closer.
+ */
+static bool ZImage_Seek(ZIMAGE *zi, uint64_t offset)
+{
+	ZIMAGE_POINT *pt = &zi->points[0];
+	uint32_t i;
+	uint8_t c;
+
+	for (i = 1; i < zi->npoints && zi->points[i].out <= offset; i++) {
+		pt = &zi->points[i];
+	}
+	if (zi->strm_valid && zi->pos <= offset && zi->pos >= pt->out) {
+		return true;
+	}
+
+	zi->strm_valid = false;
+	if (inflateReset(&zi->strm) != Z_OK) {
+		return false;
+	}
+	zi->strm.avail_in = 0;
+	zi->in   = pt->in;
+	zi->pos  = pt->out;
+	zi->wpos = 0;
+	if (pt->bits) {
+		if (!ZImage_ReadAt(zi->fp, &c, 1, pt->in - 1) ||
+		    inflatePrime(&zi->strm, pt->bits, c >> (8 - pt->bits)) != Z_OK) {
+			return false;
+		}
+	}
+	if (pt->window) {
+		memcpy(zi->window, pt->window, ZIMAGE_WINDOW);
+		if (inflateSetDictionary(&zi->strm, pt->window, ZIMAGE_WINDOW) != Z_OK) {
+			return false;
+		}
+	}
+	zi->strm_valid = true;
+	return true;
+}
+
+/**
+ * Decompress size bytes at offset from the deflate stream.
+ */
+static bool ZImage_Inflate(ZIMAGE *zi, uint8_t *data, uint32_t size, uint64_t offset)
+{
+	z_stream *strm = &zi->strm;
+	uint8_t *out;
+	uint64_t len;
+	int ret;
+
+	if (!ZImage_Seek(zi, offset)) {
+		goto fail;
+	}
+	while (zi->pos < offset + size) {
+		if (zi->pos < offset) {
+			/* Skip output before offset, data is used as scratch buffer */
+			len = offset - zi->pos;
+			out = data;
+			if (len > zi->chunksize) {
+				len = zi->chunksize;
+			}
+		} else {
+			len = offset + size - zi->pos;
+			out = data + (zi->pos - offset);
+		}
+		if (!strm->avail_in) {
+			uint64_t in = zi->end - zi->in;
+			if (in > zi->chunksize) {
+				in = zi->chunksize;
+			}
+			if (!in || !ZImage_ReadAt(zi->fp, zi->inbuf, in, zi->in)) {
+				goto fail;
+			}
+			strm->next_in  = zi->inbuf;
+			strm->avail_in = in;
+			zi->in += in;
+		}
+		strm->next_out  = out;
+		strm->avail_out = len;
+
+		/* Stop at block boundaries to record access points */
+		ret = inflate(strm, Z_BLOCK);
+		len = strm->next_out - out;
+		ZImage_Window(zi, out, len);
+		zi->pos += len;
+
+		if (ret == Z_STREAM_END) {
+			zi->strm_valid = false;
+			if (zi->pos < offset + size) {
+				goto fail;
+			}
+			break;
+		}
+		if (ret != Z_OK) {
+			goto fail;
+		}
+		if ((strm->data_type & 128) && !(strm->data_type & 64)) {
+			ZImage_AddPoint(zi);
+		}
+	}
+	return true;
+
+fail:
+	fprintf(stderr, "Compressed image: Cannot decompress data at offset %llu\n",
+	        (unsigned long long)offset);
+	zi->strm_valid = false;
+	return false;
+}
+
+/**
+ * Load the decompressed data of a chunk. The last chunk is padded with zeros.
+ */
+static bool ZImage_Load(ZIMAGE *zi, uint8_t *data, uint32_t chunk)
+{
+	uint64_t offset = (uint64_t)chunk * zi->chunksize;
+	uint64_t length;
+	uLongf size = zi->chunksize;
+
+	if (zi->format != ZIMAGE_CHUNKED) {
+		length = zi->size - offset;
+		if (length < zi->chunksize) {
+			memset(data + length, 0, zi->chunksize - length);
+		} else {
+			length = zi->chunksize;
+		}
+		if (zi->format == ZIMAGE_STORED) {
+			return ZImage_ReadAt(zi->fp, data, length, zi->data + offset);
+		}
+		return ZImage_Inflate(zi, data, length, offset);
+	}
+
+	length = zi->index[chunk + 1] - zi->index[chunk];
+	if (length > zi->chunksize) {
+		fprintf(stderr, "Compressed image: Bad index at chunk %u\n", chunk);
+		return false;
+	}
+	if (length == zi->chunksize) {
+		return ZImage_ReadAt(zi->fp, data, length, zi->index[chunk]);
+	}
+	if (!ZImage_ReadAt(zi->fp, zi->inbuf, length, zi->index[chunk]) ||
+	    uncompress(data, &size, zi->inbuf, length) != Z_OK) {
+		fprintf(stderr, "Compressed image: Cannot decompress chunk %u\n", chunk);
+		return false;
+	}
+	return true;
+}
+
+/**
+ * Return the cached, decompressed data of a chunk. Loads the chunk into
+ * the least recently used entry on a miss.
+ */
+static uint8_t *ZImage_Chunk(ZIMAGE *zi, uint32_t chunk)
+{
+	ZIMAGE_CHUNK *c, *lru = &zi->cache[0];
+	int i;
+
+	for (i = 0; i < ZIMAGE_CACHE; i++) {
+		c = &zi->cache[i];
+		if (c->stamp && c->chunk == chunk) {
+			c->stamp = ++zi->clock;
+			return c->data;
+		}
+		if (c->stamp < lru->stamp) {
+			lru = c;
+		}
+	}
+
+	if (!lru->data && !(lru->data = malloc(zi->chunksize))) {
+		return NULL;
+	}
+	lru->stamp = 0;
+	if (!ZImage_Load(zi, lru->data, chunk)) {
+		return NULL;
+	}
+	lru->chunk = chunk;
+	lru->stamp = ++zi->clock;
+	return lru->data;
+}
+
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Return the uncompressed size of the image in fp, 0 if it is not a
+ * compressed image.
+ */
+uint64_t ZImage_Length(FILE *fp)
+{
+	ZIMAGE_INFO info;
+
+	return ZImage_Probe(fp, &info) ? info.size : 0;
+}
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Open the compressed image in fp. Returns NULL if fp does not hold a
+ * compressed image. fp must stay open until the image is closed.
+ */
+ZIMAGE *ZImage_Open(FILE *fp)
+{
+	ZIMAGE *zi;
+	ZIMAGE_INFO info;
+	uint8_t *index;
+	uint32_t i, chunks;
+
+	if (!fp || !ZImage_Probe(fp, &info)) {
+		return NULL;
+	}
+	if (!(zi = calloc(1, sizeof(ZIMAGE)))) {
+		return NULL;
+	}
+	chunks        = info.chunks;
+	zi->fp        = fp;
+	zi->format    = info.format;
+	zi->chunksize = info.chunksize;
+	zi->chunks    = chunks;
+	zi->size      = info.size;
+	zi->data      = info.data;
+	zi->end       = info.end;
+	zi->inbuf     = malloc(info.chunksize);
+	if (!zi->inbuf) {
+		return ZImage_Close(zi);
+	}
+
+	if (zi->format == ZIMAGE_DEFLATE) {
+		zi->window  = malloc(ZIMAGE_WINDOW);
+		zi->points  = calloc(1, sizeof(ZIMAGE_POINT));
+		zi->span    = zi->size / ZIMAGE_POINTS > ZIMAGE_SPAN ? zi->size / ZIMAGE_POINTS : ZIMAGE_SPAN;
+		if (!zi->window || !zi->points || inflateInit2(&zi->strm, -MAX_WBITS) != Z_OK) {
+			return ZImage_Close(zi);
+		}
+		zi->strm_init    = true;
+		zi->points[0].in = zi->data;
+		zi->npoints      = 1;
+		return zi;
+	}
+	if (zi->format == ZIMAGE_STORED) {
+		return zi;
+	}
+
+	index     = malloc((chunks + 1) * 8);
+	zi->index = malloc((chunks + 1) * sizeof(uint64_t));
+	if (!index || !zi->index || !ZImage_ReadAt(fp, index, (chunks + 1) * 8, ZIMAGE_HEADER)) {
+		free(index);
+		return ZImage_Close(zi);
+	}
+	for (i = 0; i <= chunks; i++) {
+		zi->index[i] = ZImage_GetQuad(index + i * 8);
+	}
+	free(index);
+	return zi;
+}
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Free a compressed image. Does not close its file. Returns NULL.
+ */
+ZIMAGE *ZImage_Close(ZIMAGE *zi)
+{
+	int i;
+
+	if (zi) {
+		for (i = 0; i < ZIMAGE_CACHE; i++) {
+			free(zi->cache[i].data);
+		}
+		for (i = 0; i < (int)zi->npoints; i++) {
+			free(zi->points[i].window);
+		}
+		if (zi->strm_init) {
+			inflateEnd(&zi->strm);
+		}
+		free(zi->points);
+		free(zi->window);
+		free(zi->inbuf);
+		free(zi->index);
+		free(zi);
+	}
+	return NULL;
+}
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Read uncompressed data from the image.
+ */
+bool ZImage_Read(ZIMAGE *zi, uint8_t *data, uint32_t size, uint64_t offset)
+{
+	uint32_t pos, len;
+	uint8_t *chunk;
+
+	if (offset + size > zi->size) {
+		return false;
+	}
+	while (size) {
+		pos = offset % zi->chunksize;
+		len = zi->chunksize - pos;
+		if (len > size) {
+			len = size;
+		}
+		if (!(chunk = ZImage_Chunk(zi, offset / zi->chunksize))) {
+			return false;
+		}
+		memcpy(data, chunk + pos, len);
+		data   += len;
+		offset += len;
+		size   -= len;
+	}
+	return true;
+}
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Return the uncompressed size of the image.
+ */
+uint64_t ZImage_Size(ZIMAGE *zi)
+{
+	return zi->size;
+}
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Compress the raw image in to out. The last chunk is padded with zeros.
+ */
+bool ZImage_Compress(FILE *in, FILE *out, uint32_t chunksize)
+{
+	uint8_t header[ZIMAGE_HEADER];
+	uint8_t *raw, *comp, *index;
+	uint32_t i, chunks;
+	uint64_t size, offset;
+	uLongf len;
+	bool ok = false;
+
+	if (fseeko(in, 0, SEEK_END)) {
+		return false;
+	}
+	size   = ftello(in);
+	chunks = (size + chunksize - 1) / chunksize;
+	offset = ZIMAGE_HEADER + (uint64_t)(chunks + 1) * 8;
+
+	raw   = malloc(chunksize);
+	comp  = malloc(compressBound(chunksize));
+	index = calloc(chunks + 1, 8);
+	if (!raw || !comp || !index || fseeko(in, 0, SEEK_SET) || fseeko(out, offset, SEEK_SET)) {
+		goto done;
+	}
+
+	for (i = 0; i < chunks; i++) {
+		memset(raw, 0, chunksize);
+		if (fread(raw, 1, chunksize, in) == 0) {
+			goto done;
+		}
+		len = compressBound(chunksize);
+		if (compress2(comp, &len, raw, chunksize, Z_BEST_COMPRESSION) != Z_OK ||
+		    len >= chunksize) {
+			/* Store chunks that do not get smaller */
+			len = chunksize;
+			memcpy(comp, raw, chunksize);
+		}
+		if (fwrite(comp, len, 1, out) != 1) {
+			goto done;
+		}
+		ZImage_PutQuad(index + i * 8, offset);
+		offset += len;
+	}
+	ZImage_PutQuad(index + chunks * 8, offset);
+
+	memcpy(header, ZIMAGE_MAGIC, 8);
+	ZImage_PutLong(header + 8, chunksize);
+	ZImage_PutLong(header + 12, chunks);
+	ZImage_PutQuad(header + 16, size);
+	ok = fseeko(out, 0, SEEK_SET) == 0 &&
+	     fwrite(header, sizeof(header), 1, out) == 1 &&
+	     fwrite(index, (chunks + 1) * 8, 1, out) == 1 &&
+	     fflush(out) == 0;
+done:
+	free(index);
+	free(comp);
+	free(raw);
+	return ok;
+}